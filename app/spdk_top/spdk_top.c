@@ -0,0 +1,731 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/event.h"
+#include "spdk/jsonrpc.h"
+#include "spdk/string.h"
+#include "spdk/util.h"
+
+#include <ncurses.h>
+
+/*
+ * Live view of an SPDK application's reactors, threads and pollers, refreshed
+ * from the thread_get_stats and thread_get_pollers RPCs. Rates and percentages
+ * are computed over the last refresh interval.
+ */
+
+#define RPC_TIMEOUT_MS		5000
+
+enum top_tab {
+	TAB_REACTORS,
+	TAB_THREADS,
+	TAB_POLLERS,
+};
+
+struct top_poller {
+	char			*name;
+	uint64_t		period_ticks;
+	uint64_t		run_count;
+	uint64_t		busy_count;
+	uint64_t		run_tsc;
+	uint64_t		busy_tsc;
+};
+
+struct top_poller_list {
+	size_t			count;
+	struct top_poller	*pollers;
+};
+
+struct top_thread {
+	char			*name;
+	uint64_t		id;
+	uint32_t		lcore;
+	uint64_t		busy;
+	uint64_t		idle;
+	struct top_poller_list	active_pollers;
+	struct top_poller_list	timed_pollers;
+};
+
+struct top_thread_list {
+	size_t			count;
+	struct top_thread	*threads;
+};
+
+struct top_thread_stats {
+	char			*name;
+	uint64_t		id;
+	uint32_t		lcore;
+	uint64_t		busy;
+	uint64_t		idle;
+};
+
+struct top_thread_stats_list {
+	size_t			count;
+	struct top_thread_stats	*stats;
+};
+
+struct top_sample {
+	uint64_t			tick_rate;
+	uint64_t			time_usec;
+	struct top_thread_list		threads;
+	struct top_thread_stats_list	stats;
+};
+
+/* A row of the current tab, with the values it is sorted and displayed by. */
+struct top_row {
+	const char		*name;
+	const char		*thread_name;
+	uint32_t		lcore;
+	uint64_t		id;
+	uint64_t		period_ticks;
+	uint64_t		threads;
+	uint64_t		active_pollers;
+	uint64_t		timed_pollers;
+	uint64_t		runs;
+	uint64_t		busy_runs;
+	uint64_t		busy;
+	uint64_t		total;
+};
+
+static const char *g_rpc_addr = SPDK_DEFAULT_RPC_ADDR;
+static int g_delay_sec = 1;
+static struct spdk_jsonrpc_client *g_client;
+static struct top_sample *g_prev;
+static struct top_sample *g_cur;
+static struct top_row *g_rows;
+static size_t g_max_rows;
+static enum top_tab g_tab = TAB_THREADS;
+static char g_error[256];
+
+/* Decodes an array into a buffer sized from the number of elements in the RPC result. */
+static int
+decode_alloc_array(const struct spdk_json_val *val, spdk_json_decode_fn decode_func, void **out,
+		   size_t *out_size, size_t stride)
+{
+	size_t i, count = 0;
+
+	if (val->type != SPDK_JSON_VAL_ARRAY_BEGIN) {
+		return -1;
+	}
+
+	for (i = 0; i < val->len; i += spdk_json_val_len(&val[i + 1])) {
+		count++;
+	}
+
+	*out_size = 0;
+	if (count == 0) {
+		return 0;
+	}
+
+	*out = calloc(count, stride);
+	if (*out == NULL) {
+		return -1;
+	}
+
+	return spdk_json_decode_array(val, decode_func, *out, count, out_size, stride);
+}
+
+static const struct spdk_json_object_decoder top_poller_decoders[] = {
+	{"name", offsetof(struct top_poller, name), spdk_json_decode_string},
+	{"period_ticks", offsetof(struct top_poller, period_ticks), spdk_json_decode_uint64, true},
+	{"run_count", offsetof(struct top_poller, run_count), spdk_json_decode_uint64},
+	{"busy_count", offsetof(struct top_poller, busy_count), spdk_json_decode_uint64},
+	{"run_tsc", offsetof(struct top_poller, run_tsc), spdk_json_decode_uint64},
+	{"busy_tsc", offsetof(struct top_poller, busy_tsc), spdk_json_decode_uint64},
+};
+
+static int
+decode_poller(const struct spdk_json_val *val, void *out)
+{
+	return spdk_json_decode_object(val, top_poller_decoders, SPDK_COUNTOF(top_poller_decoders), out);
+}
+
+static int
+decode_poller_list(const struct spdk_json_val *val, void *out)
+{
+	struct top_poller_list *list = out;
+
+	return decode_alloc_array(val, decode_poller, (void **)&list->pollers, &list->count,
+				  sizeof(struct top_poller));
+}
+
+static const struct spdk_json_object_decoder top_thread_decoders[] = {
+	{"name", offsetof(struct top_thread, name), spdk_json_decode_string},
+	{"id", offsetof(struct top_thread, id), spdk_json_decode_uint64},
+	{"lcore", offsetof(struct top_thread, lcore), spdk_json_decode_uint32},
+	{"active_pollers", offsetof(struct top_thread, active_pollers), decode_poller_list},
+	{"timed_pollers", offsetof(struct top_thread, timed_pollers), decode_poller_list},
+};
+
+static int
+decode_thread(const struct spdk_json_val *val, void *out)
+{
+	return spdk_json_decode_object(val, top_thread_decoders, SPDK_COUNTOF(top_thread_decoders), out);
+}
+
+static int
+decode_thread_list(const struct spdk_json_val *val, void *out)
+{
+	struct top_thread_list *list = out;
+
+	return decode_alloc_array(val, decode_thread, (void **)&list->threads, &list->count,
+				  sizeof(struct top_thread));
+}
+
+static const struct spdk_json_object_decoder top_pollers_result_decoders[] = {
+	{"tick_rate", offsetof(struct top_sample, tick_rate), spdk_json_decode_uint64},
+	{"threads", offsetof(struct top_sample, threads), decode_thread_list},
+};
+
+static const struct spdk_json_object_decoder top_thread_stats_decoders[] = {
+	{"name", offsetof(struct top_thread_stats, name), spdk_json_decode_string},
+	{"id", offsetof(struct top_thread_stats, id), spdk_json_decode_uint64},
+	{"lcore", offsetof(struct top_thread_stats, lcore), spdk_json_decode_uint32},
+	{"busy", offsetof(struct top_thread_stats, busy), spdk_json_decode_uint64},
+	{"idle", offsetof(struct top_thread_stats, idle), spdk_json_decode_uint64},
+};
+
+static int
+decode_thread_stats(const struct spdk_json_val *val, void *out)
+{
+	return spdk_json_decode_object(val, top_thread_stats_decoders,
+				       SPDK_COUNTOF(top_thread_stats_decoders), out);
+}
+
+static int
+decode_thread_stats_list(const struct spdk_json_val *val, void *out)
+{
+	struct top_thread_stats_list *list = out;
+
+	return decode_alloc_array(val, decode_thread_stats, (void **)&list->stats, &list->count,
+				  sizeof(struct top_thread_stats));
+}
+
+static const struct spdk_json_object_decoder top_stats_result_decoders[] = {
+	{"tick_rate", offsetof(struct top_sample, tick_rate), spdk_json_decode_uint64},
+	{"threads", offsetof(struct top_sample, stats), decode_thread_stats_list},
+};
+
+static void
+free_poller_list(struct top_poller_list *list)
+{
+	size_t i;
+
+	for (i = 0; i < list->count; i++) {
+		free(list->pollers[i].name);
+	}
+	free(list->pollers);
+}
+
+static void
+free_sample(struct top_sample *sample)
+{
+	size_t i;
+
+	for (i = 0; i < sample->threads.count; i++) {
+		free(sample->threads.threads[i].name);
+		free_poller_list(&sample->threads.threads[i].active_pollers);
+		free_poller_list(&sample->threads.threads[i].timed_pollers);
+	}
+	free(sample->threads.threads);
+
+	for (i = 0; i < sample->stats.count; i++) {
+		free(sample->stats.stats[i].name);
+	}
+	free(sample->stats.stats);
+
+	memset(sample, 0, sizeof(*sample));
+}
+
+static uint64_t
+get_time_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static int
+rpc_call(const char *method, const struct spdk_json_object_decoder *decoders, size_t num_decoders,
+	 void *out)
+{
+	struct spdk_jsonrpc_client_request *request;
+	struct spdk_jsonrpc_client_response *response;
+	struct spdk_json_write_ctx *w;
+	uint64_t deadline;
+	int rc;
+
+	request = spdk_jsonrpc_client_create_request();
+	if (request == NULL) {
+		return -ENOMEM;
+	}
+
+	w = spdk_jsonrpc_begin_request(request, 1, method);
+	spdk_jsonrpc_end_request(request, w);
+
+	rc = spdk_jsonrpc_client_send_request(g_client, request);
+	if (rc != 0) {
+		spdk_jsonrpc_client_free_request(request);
+		return rc;
+	}
+
+	/* The first poll returns as soon as the request is sent, so keep polling until the
+	 *  response arrives or the deadline passes. */
+	deadline = get_time_usec() + RPC_TIMEOUT_MS * 1000ULL;
+	do {
+		rc = spdk_jsonrpc_client_poll(g_client, 1);
+	} while ((rc == 0 || rc == -ENOTCONN) && get_time_usec() < deadline);
+
+	if (rc <= 0) {
+		return rc == 0 || rc == -ENOTCONN ? -ETIMEDOUT : rc;
+	}
+
+	response = spdk_jsonrpc_client_get_response(g_client);
+	if (response == NULL) {
+		return -EIO;
+	}
+
+	if (response->error != NULL || response->result == NULL) {
+		rc = -EINVAL;
+	} else if (spdk_json_decode_object(response->result, decoders, num_decoders, out) != 0) {
+		rc = -EBADMSG;
+	} else {
+		rc = 0;
+	}
+
+	spdk_jsonrpc_client_free_response(response);
+
+	return rc;
+}
+
+static int
+get_sample(struct top_sample *sample)
+{
+	int rc;
+
+	free_sample(sample);
+
+	rc = rpc_call("thread_get_pollers", top_pollers_result_decoders,
+		      SPDK_COUNTOF(top_pollers_result_decoders), sample);
+	if (rc != 0) {
+		snprintf(g_error, sizeof(g_error), "thread_get_pollers failed: %s", spdk_strerror(-rc));
+		return rc;
+	}
+
+	rc = rpc_call("thread_get_stats", top_stats_result_decoders,
+		      SPDK_COUNTOF(top_stats_result_decoders), sample);
+	if (rc != 0) {
+		snprintf(g_error, sizeof(g_error), "thread_get_stats failed: %s", spdk_strerror(-rc));
+		return rc;
+	}
+
+	sample->time_usec = get_time_usec();
+	g_error[0] = '\0';
+
+	return 0;
+}
+
+static struct top_thread *
+find_thread(struct top_sample *sample, uint64_t id)
+{
+	size_t i;
+
+	for (i = 0; i < sample->threads.count; i++) {
+		if (sample->threads.threads[i].id == id) {
+			return &sample->threads.threads[i];
+		}
+	}
+
+	return NULL;
+}
+
+static struct top_thread_stats *
+find_thread_stats(struct top_sample *sample, uint64_t id)
+{
+	size_t i;
+
+	for (i = 0; i < sample->stats.count; i++) {
+		if (sample->stats.stats[i].id == id) {
+			return &sample->stats.stats[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Pollers keep their position unless others were registered or unregistered in between. */
+static struct top_poller *
+find_poller(struct top_poller_list *list, size_t index, const char *name)
+{
+	size_t i;
+
+	if (index < list->count && strcmp(list->pollers[index].name, name) == 0) {
+		return &list->pollers[index];
+	}
+
+	for (i = 0; i < list->count; i++) {
+		if (strcmp(list->pollers[i].name, name) == 0) {
+			return &list->pollers[i];
+		}
+	}
+
+	return NULL;
+}
+
+static inline uint64_t
+delta(uint64_t cur, uint64_t prev)
+{
+	return cur > prev ? cur - prev : 0;
+}
+
+static void
+thread_delta(struct top_thread *thread, uint64_t *busy, uint64_t *idle)
+{
+	struct top_thread_stats *cur, *prev;
+
+	cur = find_thread_stats(g_cur, thread->id);
+	prev = find_thread_stats(g_prev, thread->id);
+	if (cur == NULL) {
+		*busy = *idle = 0;
+		return;
+	}
+
+	*busy = delta(cur->busy, prev ? prev->busy : 0);
+	*idle = delta(cur->idle, prev ? prev->idle : 0);
+}
+
+static size_t
+fill_poller_rows(struct top_thread *thread, struct top_poller_list *list,
+		 struct top_poller_list *prev_list, uint64_t interval_ticks, size_t count)
+{
+	struct top_poller *poller, *prev;
+	struct top_row *row;
+	size_t i;
+
+	for (i = 0; i < list->count; i++) {
+		poller = &list->pollers[i];
+		prev = prev_list ? find_poller(prev_list, i, poller->name) : NULL;
+
+		row = &g_rows[count++];
+		row->name = poller->name;
+		row->thread_name = thread->name;
+		row->lcore = thread->lcore;
+		row->period_ticks = poller->period_ticks;
+		row->runs = delta(poller->run_count, prev ? prev->run_count : 0);
+		row->busy_runs = delta(poller->busy_count, prev ? prev->busy_count : 0);
+		row->busy = delta(poller->run_tsc, prev ? prev->run_tsc : 0);
+		row->total = interval_ticks;
+	}
+
+	return count;
+}
+
+static size_t
+fill_rows(void)
+{
+	struct top_thread *thread, *prev;
+	struct top_row *row;
+	uint64_t busy, idle, interval_ticks;
+	size_t i, j, count = 0, max_rows;
+
+	max_rows = g_cur->threads.count;
+	if (g_tab == TAB_POLLERS) {
+		max_rows = 0;
+		for (i = 0; i < g_cur->threads.count; i++) {
+			thread = &g_cur->threads.threads[i];
+			max_rows += thread->active_pollers.count + thread->timed_pollers.count;
+		}
+	}
+
+	if (max_rows > g_max_rows) {
+		row = realloc(g_rows, max_rows * sizeof(*row));
+		if (row == NULL) {
+			snprintf(g_error, sizeof(g_error), "Unable to allocate memory for %zu rows",
+				 max_rows);
+			return 0;
+		}
+		g_rows = row;
+		g_max_rows = max_rows;
+	}
+
+	interval_ticks = delta(g_cur->time_usec, g_prev->time_usec) * g_cur->tick_rate / 1000000;
+
+	for (i = 0; i < g_cur->threads.count; i++) {
+		thread = &g_cur->threads.threads[i];
+		thread_delta(thread, &busy, &idle);
+
+		switch (g_tab) {
+		case TAB_REACTORS:
+			for (j = 0; j < count; j++) {
+				if (g_rows[j].lcore == thread->lcore) {
+					break;
+				}
+			}
+			row = &g_rows[j];
+			if (j == count) {
+				memset(row, 0, sizeof(*row));
+				row->lcore = thread->lcore;
+				count++;
+			}
+			row->threads++;
+			row->active_pollers += thread->active_pollers.count;
+			row->timed_pollers += thread->timed_pollers.count;
+			row->busy += busy;
+			row->total += busy + idle;
+			break;
+		case TAB_THREADS:
+			row = &g_rows[count++];
+			memset(row, 0, sizeof(*row));
+			row->name = thread->name;
+			row->id = thread->id;
+			row->lcore = thread->lcore;
+			row->active_pollers = thread->active_pollers.count;
+			row->timed_pollers = thread->timed_pollers.count;
+			row->busy = busy;
+			row->total = busy + idle;
+			break;
+		case TAB_POLLERS:
+			prev = find_thread(g_prev, thread->id);
+			count = fill_poller_rows(thread, &thread->active_pollers,
+						 prev ? &prev->active_pollers : NULL, interval_ticks, count);
+			count = fill_poller_rows(thread, &thread->timed_pollers,
+						 prev ? &prev->timed_pollers : NULL, interval_ticks, count);
+			break;
+		}
+	}
+
+	return count;
+}
+
+static int
+row_cmp(const void *a, const void *b)
+{
+	const struct top_row *ra = a, *rb = b;
+
+	if (g_tab == TAB_REACTORS) {
+		return ra->lcore < rb->lcore ? -1 : ra->lcore > rb->lcore;
+	}
+
+	return ra->busy > rb->busy ? -1 : ra->busy < rb->busy;
+}
+
+static double
+percent(uint64_t part, uint64_t total)
+{
+	return total ? part * 100.0 / total : 0.0;
+}
+
+static void
+draw(void)
+{
+	struct top_row *row;
+	size_t i, count;
+	int line = 0;
+
+	erase();
+
+	attron(A_BOLD);
+	mvprintw(line++, 0, "spdk_top - %s", g_rpc_addr);
+	attroff(A_BOLD);
+	mvprintw(line++, 0, "%s[1] Reactors%s  %s[2] Threads%s  %s[3] Pollers%s    q: quit",
+		 g_tab == TAB_REACTORS ? ">" : " ", g_tab == TAB_REACTORS ? "<" : " ",
+		 g_tab == TAB_THREADS ? ">" : " ", g_tab == TAB_THREADS ? "<" : " ",
+		 g_tab == TAB_POLLERS ? ">" : " ", g_tab == TAB_POLLERS ? "<" : " ");
+
+	if (g_error[0] != '\0') {
+		mvprintw(line + 1, 0, "%s", g_error);
+		refresh();
+		return;
+	}
+
+	count = fill_rows();
+	if (g_error[0] != '\0') {
+		mvprintw(line + 1, 0, "%s", g_error);
+		refresh();
+		return;
+	}
+	qsort(g_rows, count, sizeof(g_rows[0]), row_cmp);
+
+	line++;
+	attron(A_REVERSE);
+	switch (g_tab) {
+	case TAB_REACTORS:
+		mvprintw(line++, 0, "%-8s %8s %8s %8s %8s", "Core", "Threads", "Active", "Timed", "Busy %");
+		break;
+	case TAB_THREADS:
+		mvprintw(line++, 0, "%-32s %8s %6s %8s %8s %8s", "Thread", "ID", "Core", "Active",
+			 "Timed", "Busy %");
+		break;
+	case TAB_POLLERS:
+		mvprintw(line++, 0, "%-32s %-24s %6s %10s %10s %8s %8s", "Poller", "Thread", "Core",
+			 "Period us", "Runs", "Work %", "CPU %");
+		break;
+	}
+	attroff(A_REVERSE);
+
+	for (i = 0; i < count && line < LINES; i++) {
+		row = &g_rows[i];
+
+		switch (g_tab) {
+		case TAB_REACTORS:
+			mvprintw(line++, 0, "%-8u %8" PRIu64 " %8" PRIu64 " %8" PRIu64 " %8.2f", row->lcore,
+				 row->threads, row->active_pollers, row->timed_pollers,
+				 percent(row->busy, row->total));
+			break;
+		case TAB_THREADS:
+			mvprintw(line++, 0, "%-32.32s %8" PRIu64 " %6u %8" PRIu64 " %8" PRIu64 " %8.2f",
+				 row->name, row->id, row->lcore, row->active_pollers, row->timed_pollers,
+				 percent(row->busy, row->total));
+			break;
+		case TAB_POLLERS:
+			mvprintw(line++, 0, "%-32.32s %-24.24s %6u %10" PRIu64 " %10" PRIu64 " %8.2f %8.2f",
+				 row->name, row->thread_name, row->lcore,
+				 g_cur->tick_rate ? row->period_ticks * 1000000 / g_cur->tick_rate : 0,
+				 row->runs, percent(row->busy_runs, row->runs),
+				 percent(row->busy, row->total));
+			break;
+		}
+	}
+
+	refresh();
+}
+
+static void
+usage(const char *program_name)
+{
+	printf("%s options\n", program_name);
+	printf("\t[-r RPC listen address (default: %s)]\n", SPDK_DEFAULT_RPC_ADDR);
+	printf("\t[-d refresh interval in seconds (default: 1)]\n");
+	printf("\t[-h show this usage]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	struct top_sample *tmp;
+	bool quit = false;
+	long int val;
+	int op, rc = 0;
+
+	while ((op = getopt(argc, argv, "d:hr:")) != -1) {
+		switch (op) {
+		case 'd':
+			val = spdk_strtol(optarg, 10);
+			if (val <= 0) {
+				fprintf(stderr, "Invalid refresh interval\n");
+				return 1;
+			}
+			g_delay_sec = val;
+			break;
+		case 'r':
+			g_rpc_addr = optarg;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	g_client = spdk_jsonrpc_client_connect(g_rpc_addr, g_rpc_addr[0] == '/' ? AF_UNIX : AF_INET);
+	if (g_client == NULL) {
+		fprintf(stderr, "Unable to connect to %s: %s\n", g_rpc_addr, spdk_strerror(errno));
+		return 1;
+	}
+
+	g_prev = calloc(1, sizeof(*g_prev));
+	g_cur = calloc(1, sizeof(*g_cur));
+	if (g_prev == NULL || g_cur == NULL) {
+		fprintf(stderr, "Unable to allocate memory\n");
+		rc = 1;
+		goto out;
+	}
+
+	get_sample(g_prev);
+
+	initscr();
+	cbreak();
+	noecho();
+	curs_set(0);
+	timeout(g_delay_sec * 1000);
+
+	while (!quit) {
+		if (get_sample(g_cur) == 0) {
+			draw();
+			tmp = g_prev;
+			g_prev = g_cur;
+			g_cur = tmp;
+		} else {
+			draw();
+		}
+
+		switch (getch()) {
+		case '1':
+			g_tab = TAB_REACTORS;
+			break;
+		case '2':
+			g_tab = TAB_THREADS;
+			break;
+		case '3':
+			g_tab = TAB_POLLERS;
+			break;
+		case 'q':
+			quit = true;
+			break;
+		default:
+			break;
+		}
+	}
+
+	endwin();
+
+out:
+	if (g_prev != NULL) {
+		free_sample(g_prev);
+	}
+	if (g_cur != NULL) {
+		free_sample(g_cur);
+	}
+	free(g_prev);
+	free(g_cur);
+	free(g_rows);
+	spdk_jsonrpc_client_close(g_client);
+
+	return rc;
+}
@@ -0,0 +1,310 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Compares how the software copy engine affects the rest of a reactor when it copies
+ * large buffers inline with memcpy() and when it copies them in chunks from a poller
+ * with non-temporal stores. For each mode it reports the copy bandwidth, the longest
+ * time the thread spent in a single submission or poll during a copy (averaged over all
+ * copies), and how long it takes to read back a working set that was in cache before
+ * the copy.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/copy_engine.h"
+#include "spdk/env.h"
+#include "spdk/string.h"
+#include "spdk/thread.h"
+#include "spdk/util.h"
+
+struct user_config {
+	long long xfer_size_bytes;
+	long long working_set_bytes;
+	long long chunk_size_bytes;
+	int iterations;
+};
+
+static struct user_config g_user_config;
+
+static struct spdk_thread *g_thread;
+static uint8_t *g_src;
+static uint8_t *g_dst;
+static uint8_t *g_working_set;
+static uint64_t g_sum;
+static bool g_done;
+static int g_status;
+
+static void
+construct_user_config(struct user_config *self)
+{
+	self->xfer_size_bytes = 4 * 1024 * 1024;
+	self->working_set_bytes = 1024 * 1024;
+	self->chunk_size_bytes = 64 * 1024;
+	self->iterations = 100;
+}
+
+static void
+dump_user_config(struct user_config *self)
+{
+	printf("User configuration:\n");
+	printf("Transfer size:    %lld bytes\n", self->xfer_size_bytes);
+	printf("Working set size: %lld bytes\n", self->working_set_bytes);
+	printf("Chunk size:       %lld bytes\n", self->chunk_size_bytes);
+	printf("Iterations:       %d\n\n", self->iterations);
+}
+
+static void
+usage(char *program_name)
+{
+	printf("%s options\n", program_name);
+	printf("\t[-h help message]\n");
+	printf("\t[-o transfer size in bytes]\n");
+	printf("\t[-w working set size in bytes]\n");
+	printf("\t[-c chunk size in bytes]\n");
+	printf("\t[-n number of iterations]\n");
+}
+
+static int
+parse_args(int argc, char **argv)
+{
+	int op;
+
+	construct_user_config(&g_user_config);
+	while ((op = getopt(argc, argv, "c:hn:o:w:")) != -1) {
+		switch (op) {
+		case 'o':
+			g_user_config.xfer_size_bytes = spdk_strtoll(optarg, 10);
+			break;
+		case 'w':
+			g_user_config.working_set_bytes = spdk_strtoll(optarg, 10);
+			break;
+		case 'c':
+			g_user_config.chunk_size_bytes = spdk_strtoll(optarg, 10);
+			break;
+		case 'n':
+			g_user_config.iterations = spdk_strtol(optarg, 10);
+			break;
+		case 'h':
+			usage(argv[0]);
+			exit(0);
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (g_user_config.xfer_size_bytes <= 0 || g_user_config.working_set_bytes <= 0 ||
+	    g_user_config.chunk_size_bytes <= 0 || g_user_config.iterations <= 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	return 0;
+}
+
+static void
+copy_done(void *ref, int status)
+{
+	g_status = status;
+	g_done = true;
+}
+
+/* Reads one byte of each cache line of the working set and returns the ticks it took */
+static uint64_t
+read_working_set(void)
+{
+	uint64_t start = spdk_get_ticks();
+	uint64_t sum = 0;
+	long long i;
+
+	for (i = 0; i < g_user_config.working_set_bytes; i += 64) {
+		sum += ((volatile uint8_t *)g_working_set)[i];
+	}
+	g_sum += sum;
+
+	return spdk_get_ticks() - start;
+}
+
+static int
+run_mode(const char *name, uint64_t large_threshold, struct spdk_io_channel *ch,
+	 struct spdk_copy_task *task)
+{
+	struct spdk_copy_sw_opts opts;
+	uint64_t copy_ticks = 0, working_set_ticks = 0, stall_ticks = 0, max_stall;
+	uint64_t start, now, hz = spdk_get_ticks_hz();
+	int i, rc;
+
+	spdk_copy_engine_get_sw_opts(&opts);
+	opts.large_threshold = large_threshold;
+	opts.chunk_size = g_user_config.chunk_size_bytes;
+	rc = spdk_copy_engine_set_sw_opts(&opts);
+	if (rc != 0) {
+		fprintf(stderr, "Failed to set copy engine options\n");
+		return rc;
+	}
+
+	for (i = 0; i < g_user_config.iterations; i++) {
+		read_working_set();
+
+		g_done = false;
+		start = spdk_get_ticks();
+		rc = spdk_copy_submit(task, ch, g_dst, g_src, g_user_config.xfer_size_bytes, copy_done);
+		if (rc != 0) {
+			fprintf(stderr, "Copy submission failed: %d\n", rc);
+			return rc;
+		}
+		now = spdk_get_ticks();
+		max_stall = now - start;
+
+		while (!g_done) {
+			uint64_t poll_start = spdk_get_ticks();
+
+			spdk_thread_poll(g_thread, 0, 0);
+			now = spdk_get_ticks();
+			max_stall = spdk_max(max_stall, now - poll_start);
+		}
+		if (g_status != 0) {
+			fprintf(stderr, "Copy failed: %d\n", g_status);
+			return g_status;
+		}
+		copy_ticks += now - start;
+		stall_ticks += max_stall;
+
+		working_set_ticks += read_working_set();
+	}
+
+	printf("%-18s %12.2f %16.1f %20.1f\n", name,
+	       (double)g_user_config.xfer_size_bytes * g_user_config.iterations * hz /
+	       copy_ticks / (1024 * 1024),
+	       (double)stall_ticks * 1000 * 1000 / hz / g_user_config.iterations,
+	       (double)working_set_ticks * 1000 * 1000 / hz / g_user_config.iterations);
+
+	return 0;
+}
+
+static void
+copy_engine_fini_done(void *cb_arg)
+{
+	*(bool *)cb_arg = true;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct spdk_env_opts opts;
+	struct spdk_io_channel *ch;
+	struct spdk_copy_task *task = NULL;
+	uint64_t hz, working_set_ticks = 0;
+	bool done = false;
+	int i, rc;
+
+	if (parse_args(argc, argv) != 0) {
+		return 1;
+	}
+
+	spdk_env_opts_init(&opts);
+	opts.name = "copy_perf";
+	opts.core_mask = "0x1";
+	if (spdk_env_init(&opts) < 0) {
+		fprintf(stderr, "Unable to initialize SPDK env\n");
+		return 1;
+	}
+
+	dump_user_config(&g_user_config);
+
+	g_src = spdk_dma_malloc(g_user_config.xfer_size_bytes, 64, NULL);
+	g_dst = spdk_dma_malloc(g_user_config.xfer_size_bytes, 64, NULL);
+	g_working_set = spdk_dma_malloc(g_user_config.working_set_bytes, 64, NULL);
+	if (g_src == NULL || g_dst == NULL || g_working_set == NULL) {
+		fprintf(stderr, "Unable to allocate buffers\n");
+		rc = 1;
+		goto free_bufs;
+	}
+	memset(g_src, 0x5a, g_user_config.xfer_size_bytes);
+	memset(g_dst, 0, g_user_config.xfer_size_bytes);
+	memset(g_working_set, 1, g_user_config.working_set_bytes);
+
+	spdk_thread_lib_init(NULL, 0);
+	g_thread = spdk_thread_create("copy_perf", NULL);
+	if (g_thread == NULL) {
+		fprintf(stderr, "Unable to create thread\n");
+		rc = 1;
+		goto fini_thread_lib;
+	}
+	spdk_set_thread(g_thread);
+
+	spdk_copy_engine_initialize();
+	ch = spdk_copy_engine_get_io_channel();
+	task = calloc(1, spdk_copy_task_size());
+	if (ch == NULL || task == NULL) {
+		fprintf(stderr, "Unable to set up the copy engine\n");
+		rc = 1;
+		goto fini_copy_engine;
+	}
+
+	hz = spdk_get_ticks_hz();
+	for (i = 0; i < g_user_config.iterations; i++) {
+		read_working_set();
+		working_set_ticks += read_working_set();
+	}
+	printf("Working set read without copies: %.1f us\n\n",
+	       (double)working_set_ticks * 1000 * 1000 / hz / g_user_config.iterations);
+
+	printf("%-18s %12s %16s %20s\n", "Mode", "MiB/s", "Stall (us)", "Working set (us)");
+	rc = run_mode("inline memcpy", 0, ch, task);
+	if (rc == 0) {
+		rc = run_mode("chunked NT stores", 1, ch, task);
+	}
+
+fini_copy_engine:
+	free(task);
+	if (ch != NULL) {
+		spdk_put_io_channel(ch);
+	}
+	spdk_copy_engine_finish(copy_engine_fini_done, &done);
+	while (!done) {
+		spdk_thread_poll(g_thread, 0, 0);
+	}
+	while (spdk_thread_poll(g_thread, 0, 0) > 0) {
+	}
+	spdk_thread_exit(g_thread);
+	spdk_thread_destroy(g_thread);
+fini_thread_lib:
+	spdk_thread_lib_fini();
+free_bufs:
+	spdk_dma_free(g_src);
+	spdk_dma_free(g_dst);
+	spdk_dma_free(g_working_set);
+
+	return rc == 0 ? 0 : 1;
+}
@@ -63,6 +63,8 @@ struct config {
 	struct nvme_io write;
 	struct cmb_t   cmb;
 	size_t         copy_size;
+	unsigned       iterations;
+	bool           host_buf;
 };
 
 static struct config g_config;
@@ -107,6 +109,9 @@ cmb_copy(void)
 {
 	int rc = 0, rw;
 	void *buf;
+	unsigned i;
+	uint64_t start_tsc, elapsed_tsc;
+	double seconds;
 
 	/* Allocate QPs for the read and write controllers */
 	g_config.read.qpair = spdk_nvme_ctrlr_alloc_io_qpair(g_config.read.ctrlr, NULL, 0);
@@ -116,52 +121,81 @@ cmb_copy(void)
 		return -ENOMEM;
 	}
 
-	/* Allocate a buffer from our CMB */
-	buf = spdk_nvme_ctrlr_alloc_cmb_io_buffer(g_config.cmb.ctrlr, g_config.copy_size);
-	if (buf == NULL) {
-		printf("ERROR: buffer allocation failed\n");
-		printf("Are you sure %s has a valid CMB?\n",
-		       g_config.cmb.trid.traddr);
-		return -ENOMEM;
+	if (g_config.host_buf) {
+		/* Stage the data in host memory to compare against */
+		buf = spdk_zmalloc(g_config.copy_size, 0x1000, NULL, SPDK_ENV_SOCKET_ID_ANY,
+				   SPDK_MALLOC_DMA);
+		if (buf == NULL) {
+			printf("ERROR: buffer allocation failed\n");
+			return -ENOMEM;
+		}
+	} else {
+		/* Allocate a buffer from our CMB */
+		buf = spdk_nvme_ctrlr_alloc_cmb_io_buffer(g_config.cmb.ctrlr, g_config.copy_size);
+		if (buf == NULL) {
+			printf("ERROR: buffer allocation failed\n");
+			printf("Are you sure %s has a valid CMB?\n",
+			       g_config.cmb.trid.traddr);
+			return -ENOMEM;
+		}
 	}
 
-	/* Clear the done flags */
-	g_config.read.done = 0;
-	g_config.write.done = 0;
+	start_tsc = spdk_get_ticks();
 
-	rw = CMB_COPY_READ;
-	/* Do the read to the CMB IO buffer */
-	rc = spdk_nvme_ns_cmd_read(g_config.read.ns, g_config.read.qpair, buf,
-				   g_config.read.slba, g_config.read.nlbas,
-				   check_io, &rw, 0);
-	if (rc != 0) {
-		fprintf(stderr, "starting read I/O failed\n");
-		return -EIO;
-	}
-	while (!g_config.read.done) {
-		spdk_nvme_qpair_process_completions(g_config.read.qpair, 0);
-	}
+	for (i = 0; i < g_config.iterations; i++) {
+		/* Clear the done flags */
+		g_config.read.done = 0;
+		g_config.write.done = 0;
+
+		rw = CMB_COPY_READ;
+		/* Do the read to the IO buffer */
+		rc = spdk_nvme_ns_cmd_read(g_config.read.ns, g_config.read.qpair, buf,
+					   g_config.read.slba, g_config.read.nlbas,
+					   check_io, &rw, 0);
+		if (rc != 0) {
+			fprintf(stderr, "starting read I/O failed\n");
+			rc = -EIO;
+			break;
+		}
+		while (!g_config.read.done) {
+			spdk_nvme_qpair_process_completions(g_config.read.qpair, 0);
+		}
 
-	/* Do the write from the CMB IO buffer */
-	rw = CMB_COPY_WRITE;
-	rc = spdk_nvme_ns_cmd_write(g_config.write.ns, g_config.write.qpair, buf,
-				    g_config.write.slba, g_config.write.nlbas,
-				    check_io, &rw, 0);
-	if (rc != 0) {
-		fprintf(stderr, "starting write I/O failed\n");
-		return -EIO;
+		/* Do the write from the IO buffer */
+		rw = CMB_COPY_WRITE;
+		rc = spdk_nvme_ns_cmd_write(g_config.write.ns, g_config.write.qpair, buf,
+					    g_config.write.slba, g_config.write.nlbas,
+					    check_io, &rw, 0);
+		if (rc != 0) {
+			fprintf(stderr, "starting write I/O failed\n");
+			rc = -EIO;
+			break;
+		}
+		while (!g_config.write.done) {
+			spdk_nvme_qpair_process_completions(g_config.write.qpair, 0);
+		}
 	}
-	while (!g_config.write.done) {
-		spdk_nvme_qpair_process_completions(g_config.write.qpair, 0);
+
+	elapsed_tsc = spdk_get_ticks() - start_tsc;
+	if (rc == 0 && elapsed_tsc != 0) {
+		seconds = (double)elapsed_tsc / spdk_get_ticks_hz();
+		printf("Copied %zu bytes %u times through %s memory: %.2f us per copy, %.2f MiB/s\n",
+		       g_config.copy_size, g_config.iterations, g_config.host_buf ? "host" : "CMB",
+		       seconds * 1000 * 1000 / g_config.iterations,
+		       (double)g_config.copy_size * g_config.iterations / seconds / (1024 * 1024));
 	}
 
 	/* Clear the done flags */
 	g_config.read.done = 0;
 	g_config.write.done = 0;
 
-	/* Free CMB buffer */
-	spdk_nvme_ctrlr_free_cmb_io_buffer(g_config.cmb.ctrlr, buf,
-					   g_config.copy_size);
+	/* Free the buffer */
+	if (g_config.host_buf) {
+		spdk_free(buf);
+	} else {
+		spdk_nvme_ctrlr_free_cmb_io_buffer(g_config.cmb.ctrlr, buf,
+						   g_config.copy_size);
+	}
 
 	/* Free the queues */
 	spdk_nvme_ctrlr_free_io_qpair(g_config.read.qpair);
@@ -214,11 +248,15 @@ attach_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
 static void
 usage(char *program_name)
 {
-	printf("%s options (all mandatory)", program_name);
+	printf("%s options", program_name);
 	printf("\n");
 	printf("\t[-r NVMe read parameters]\n");
 	printf("\t[-w NVMe write parameters]\n");
 	printf("\t[-c CMB to use for data buffers]\n");
+	printf("\t[-H use a host memory data buffer instead of a CMB to compare against]\n");
+	printf("\t[-n number of times to copy the data, default: 1]\n");
+	printf("\n");
+	printf("-r and -w are mandatory, and so is -c unless -H is given.\n");
 	printf("\n");
 	printf("Read/Write params:\n");
 	printf("  <pci id>-<namespace>-<start LBA>-<number of LBAs>\n");
@@ -284,8 +322,11 @@ parse_args(int argc, char **argv)
 {
 	int op;
 	unsigned read = 0, write = 0, cmb = 0;
+	long int val;
 
-	while ((op = getopt(argc, argv, "r:w:c:")) != -1) {
+	g_config.iterations = 1;
+
+	while ((op = getopt(argc, argv, "r:w:c:Hn:")) != -1) {
 		switch (op) {
 		case 'r':
 			parse(optarg, &g_config.read);
@@ -300,13 +341,24 @@ parse_args(int argc, char **argv)
 				 "%s", optarg);
 			cmb = 1;
 			break;
+		case 'H':
+			g_config.host_buf = true;
+			break;
+		case 'n':
+			val = spdk_strtol(optarg, 10);
+			if (val <= 0) {
+				fprintf(stderr, "Invalid number of copies %s\n", optarg);
+				return 1;
+			}
+			g_config.iterations = (unsigned)val;
+			break;
 		default:
 			usage(argv[0]);
 			return 1;
 		}
 	}
 
-	if ((!read || !write || !cmb)) {
+	if ((!read || !write || (!cmb && !g_config.host_buf))) {
 		usage(argv[0]);
 		return 1;
 	}
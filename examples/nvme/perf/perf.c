@@ -129,6 +129,11 @@ struct ns_worker_ctx {
 	uint64_t		offset_in_ios;
 	bool			is_draining;
 
+	/* MMIO doorbell writes of the qpairs, only gathered for PCIe */
+	bool			has_doorbell_stats;
+	uint64_t		sq_doorbell_writes;
+	uint64_t		cq_doorbell_writes;
+
 	union {
 		struct {
 			int			num_qpairs;
@@ -219,6 +224,7 @@ static bool g_header_digest;
 static bool g_data_digest;
 static bool g_no_shn_notification = false;
 static uint32_t g_keep_alive_timeout_in_ms = 0;
+static int g_doorbell_budget_us = -1;
 
 static const char *g_core_mask;
 
@@ -595,6 +601,10 @@ nvme_init_ns_worker_ctx(struct ns_worker_ctx *ns_ctx)
 		opts.io_queue_requests = entry->num_io_requests;
 	}
 	opts.delay_pcie_doorbell = true;
+	if (g_doorbell_budget_us >= 0) {
+		opts.adaptive_pcie_doorbell = true;
+		opts.pcie_doorbell_budget_us = g_doorbell_budget_us;
+	}
 
 	for (i = 0; i < ns_ctx->u.nvme.num_qpairs; i++) {
 		ns_ctx->u.nvme.qpair[i] = spdk_nvme_ctrlr_alloc_io_qpair(entry->u.nvme.ctrlr, &opts,
@@ -611,9 +621,15 @@ nvme_init_ns_worker_ctx(struct ns_worker_ctx *ns_ctx)
 static void
 nvme_cleanup_ns_worker_ctx(struct ns_worker_ctx *ns_ctx)
 {
+	struct spdk_nvme_qpair_doorbell_stats stats;
 	int i;
 
 	for (i = 0; i < ns_ctx->u.nvme.num_qpairs; i++) {
+		if (spdk_nvme_qpair_get_doorbell_stats(ns_ctx->u.nvme.qpair[i], &stats) == 0) {
+			ns_ctx->has_doorbell_stats = true;
+			ns_ctx->sq_doorbell_writes += stats.sq_doorbell_writes;
+			ns_ctx->cq_doorbell_writes += stats.cq_doorbell_writes;
+		}
 		spdk_nvme_ctrlr_free_io_qpair(ns_ctx->u.nvme.qpair[i]);
 	}
 
@@ -1123,6 +1139,8 @@ static void usage(char *program_name)
 	printf("\t          -e 'PRACT=1,PRCHK=GUARD'\n");
 	printf("\t[-k keep alive timeout period in millisecond]\n");
 	printf("\t[-s DPDK huge memory size in MB.]\n");
+	printf("\t[-A enable adaptive PCIe doorbells with the given latency budget in us]\n");
+	printf("\t\t(0 - ring once per completion poll, default: disabled)\n");
 	printf("\t[-m max completions per poll]\n");
 	printf("\t\t(default: 0 - unlimited)\n");
 	printf("\t[-i shared memory group ID]\n");
@@ -1171,6 +1189,37 @@ print_bucket(void *ctx, uint64_t start, uint64_t end, uint64_t count,
 	       so_far_pct, count);
 }
 
+static void
+print_doorbell_stats(void)
+{
+	struct worker_thread	*worker;
+	struct ns_worker_ctx	*ns_ctx;
+	bool			header = false;
+
+	for (worker = g_workers; worker != NULL; worker = worker->next) {
+		for (ns_ctx = worker->ns_ctx; ns_ctx != NULL; ns_ctx = ns_ctx->next) {
+			if (!ns_ctx->has_doorbell_stats || ns_ctx->io_completed == 0) {
+				continue;
+			}
+
+			if (!header) {
+				printf("Doorbell writes per I/O:\n");
+				printf("%-43s %10s %10s\n", "", "SQ", "CQ");
+				header = true;
+			}
+
+			printf("%-28.28s from core %2u: %10.3f %10.3f\n",
+			       ns_ctx->entry->name, worker->lcore,
+			       (double)ns_ctx->sq_doorbell_writes / ns_ctx->io_completed,
+			       (double)ns_ctx->cq_doorbell_writes / ns_ctx->io_completed);
+		}
+	}
+
+	if (header) {
+		printf("\n");
+	}
+}
+
 static void
 print_performance(void)
 {
@@ -1249,6 +1298,8 @@ print_performance(void)
 		printf("\n");
 	}
 
+	print_doorbell_stats();
+
 	if (g_latency_sw_tracking_level == 0 || total_io_completed == 0) {
 		return;
 	}
@@ -1547,8 +1598,9 @@ parse_args(int argc, char **argv)
 	g_core_mask = NULL;
 	g_max_completions = 0;
 
-	while ((op = getopt(argc, argv, "c:e:i:lm:n:o:q:r:k:s:t:w:DGHILM:NT:U:V")) != -1) {
+	while ((op = getopt(argc, argv, "A:c:e:i:lm:n:o:q:r:k:s:t:w:DGHILM:NT:U:V")) != -1) {
 		switch (op) {
+		case 'A':
 		case 'i':
 		case 'm':
 		case 'n':
@@ -1565,6 +1617,9 @@ parse_args(int argc, char **argv)
 				return val;
 			}
 			switch (op) {
+			case 'A':
+				g_doorbell_budget_us = val;
+				break;
 			case 'i':
 				g_shm_id = val;
 				break;
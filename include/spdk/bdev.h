@@ -51,8 +51,13 @@
 extern "C" {
 #endif
 
+#define SPDK_BDEV_TINY_BUF_MAX_SIZE 4096
 #define SPDK_BDEV_SMALL_BUF_MAX_SIZE 8192
 #define SPDK_BDEV_LARGE_BUF_MAX_SIZE (64 * 1024)
+#define SPDK_BDEV_HUGE_BUF_MAX_SIZE (128 * 1024)
+
+/** Number of data buffer size classes (tiny, small, large and huge). */
+#define SPDK_BDEV_NUM_BUF_CLASSES 4
 
 /* Increase the buffer size to store interleaved metadata.  Increment is the
  *  amount necessary to store metadata per data block.  16 byte metadata per
@@ -147,6 +152,46 @@ enum spdk_bdev_qos_rate_limit_type {
 	SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES
 };
 
+/** bdev QoS priority class of a descriptor */
+enum spdk_bdev_qos_priority {
+	/**
+	 * Latency sensitive I/O. Its latency is measured against the bdev's
+	 * latency target and it is never throttled to meet it. This is the
+	 * priority of newly opened descriptors.
+	 */
+	SPDK_BDEV_QOS_PRIORITY_HIGH = 0,
+	/** Best effort I/O, throttled while the bdev's latency target is exceeded. */
+	SPDK_BDEV_QOS_PRIORITY_LOW,
+	/** Keep last */
+	SPDK_BDEV_QOS_NUM_PRIORITIES
+};
+
+/** Latency target controller statistics of a bdev */
+struct spdk_bdev_qos_latency_stat {
+	/** Target p99 latency of high priority I/O in microseconds, 0 if none is set. */
+	uint64_t latency_target_usec;
+	/** p99 latency of high priority I/O in the last measurement window, in microseconds. */
+	uint64_t p99_latency_usec;
+	/** IOPS limit currently applied to low priority I/O, 0 if it is not throttled. */
+	uint64_t low_priority_ios_per_sec;
+	/** Number of measurement windows completed. */
+	uint64_t windows;
+	/** Number of measurement windows in which the latency target was exceeded. */
+	uint64_t violations;
+};
+
+/** Information about a descriptor opened on a bdev */
+struct spdk_bdev_desc_info {
+	/** Identifier of the descriptor, unique among the descriptors of the bdev. */
+	uint32_t id;
+	/** True if the descriptor was opened for writing. */
+	bool write;
+	/** Thread the descriptor was opened on. */
+	struct spdk_thread *thread;
+	/** QoS priority class of the descriptor. */
+	enum spdk_bdev_qos_priority qos_priority;
+};
+
 /**
  * Block device completion callback.
  *
@@ -176,6 +221,28 @@ struct spdk_bdev_io_stat {
 struct spdk_bdev_opts {
 	uint32_t bdev_io_pool_size;
 	uint32_t bdev_io_cache_size;
+
+	/**
+	 * Number of data buffers in the pool of each size class. 0 selects the
+	 * default for that class.
+	 */
+	uint32_t tiny_buf_pool_size;
+	uint32_t small_buf_pool_size;
+	uint32_t large_buf_pool_size;
+	uint32_t huge_buf_pool_size;
+
+	/**
+	 * Enforce QoS rate limits on every channel from a shared budget instead of
+	 * funneling all I/O of a rate limited bdev through one QoS thread.
+	 */
+	bool qos_distributed;
+
+	/**
+	 * With distributed QoS, how far in percent the I/O issued within a timeslice
+	 * may stray from the rate limit. Larger values let channels draw quota in
+	 * bigger batches. 0 selects the default.
+	 */
+	uint32_t qos_tolerance_pct;
 };
 
 void spdk_bdev_get_opts(struct spdk_bdev_opts *opts);
@@ -326,6 +393,60 @@ void spdk_bdev_close(struct spdk_bdev_desc *desc);
  */
 struct spdk_bdev *spdk_bdev_desc_get_bdev(struct spdk_bdev_desc *desc);
 
+/**
+ * Set the QoS priority class of a bdev descriptor.
+ *
+ * The priority applies to I/O submitted through the descriptor afterwards.
+ * It only has an effect while a latency target is set on the bdev with
+ * spdk_bdev_set_qos_latency_target().
+ *
+ * \param desc Open block device descriptor.
+ * \param priority QoS priority class.
+ * \return 0 on success, -EINVAL if the priority is not valid.
+ */
+int spdk_bdev_desc_set_qos_priority(struct spdk_bdev_desc *desc,
+				    enum spdk_bdev_qos_priority priority);
+
+/**
+ * Get the QoS priority class of a bdev descriptor.
+ *
+ * \param desc Open block device descriptor.
+ * \return QoS priority class of the descriptor.
+ */
+enum spdk_bdev_qos_priority spdk_bdev_desc_get_qos_priority(struct spdk_bdev_desc *desc);
+
+/**
+ * Called for each descriptor opened on a bdev by spdk_bdev_get_desc_info().
+ *
+ * \param ctx Context passed to spdk_bdev_get_desc_info().
+ * \param info Information about the descriptor.
+ */
+typedef void (*spdk_bdev_desc_info_cb)(void *ctx, const struct spdk_bdev_desc_info *info);
+
+/**
+ * Get information about the descriptors opened on a bdev.
+ *
+ * The callback is called synchronously for each descriptor, with the bdev
+ * lock held. It must not open or close descriptors.
+ *
+ * \param bdev Block device to query.
+ * \param cb_fn Function called for each descriptor.
+ * \param ctx Context passed to cb_fn.
+ */
+void spdk_bdev_get_desc_info(struct spdk_bdev *bdev, spdk_bdev_desc_info_cb cb_fn, void *ctx);
+
+/**
+ * Set the QoS priority class of the descriptor with the given identifier.
+ *
+ * \param bdev Block device the descriptor was opened on.
+ * \param desc_id Identifier of the descriptor, as reported by spdk_bdev_get_desc_info().
+ * \param priority QoS priority class.
+ * \return 0 on success, -ENOENT if no such descriptor is open, -EINVAL if the
+ * priority is not valid.
+ */
+int spdk_bdev_set_qos_priority_by_desc_id(struct spdk_bdev *bdev, uint32_t desc_id,
+		enum spdk_bdev_qos_priority priority);
+
 /**
  * Check whether the block device supports the I/O type.
  *
@@ -428,6 +549,36 @@ void spdk_bdev_get_qos_rate_limits(struct spdk_bdev *bdev, uint64_t *limits);
 void spdk_bdev_set_qos_rate_limits(struct spdk_bdev *bdev, uint64_t *limits,
 				   void (*cb_fn)(void *cb_arg, int status), void *cb_arg);
 
+/**
+ * Set the latency target of a bdev.
+ *
+ * The p99 latency of I/O from high priority descriptors is measured over
+ * fixed windows. While it exceeds the target, I/O from low priority
+ * descriptors is throttled with an IOPS limit that is decreased every window
+ * the target is missed and raised again once it is met. The latency target
+ * works in addition to the rate limits set with spdk_bdev_set_qos_rate_limits().
+ *
+ * The latency target needs all I/O of the bdev to pass through one thread, so
+ * it is not supported when the qos_distributed bdev option is set. cb_fn is
+ * then called with -ENOTSUP.
+ *
+ * \param bdev Block device.
+ * \param latency_target_usec Target p99 latency in microseconds. 0 removes the target.
+ * \param cb_fn Callback function to be called when the latency target has been updated.
+ * \param cb_arg Argument to pass to cb_fn.
+ */
+void spdk_bdev_set_qos_latency_target(struct spdk_bdev *bdev, uint64_t latency_target_usec,
+				      void (*cb_fn)(void *cb_arg, int status), void *cb_arg);
+
+/**
+ * Get the latency target controller statistics of a bdev.
+ *
+ * \param bdev Block device to query.
+ * \param stat Statistics filled in by this call.
+ */
+void spdk_bdev_get_qos_latency_stat(struct spdk_bdev *bdev,
+				    struct spdk_bdev_qos_latency_stat *stat);
+
 /**
  * Get minimum I/O buffer address alignment for a bdev.
  *
@@ -1358,6 +1509,76 @@ void spdk_bdev_get_io_stat(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 void spdk_bdev_get_device_stat(struct spdk_bdev *bdev, struct spdk_bdev_io_stat *stat,
 			       spdk_bdev_get_device_stat_cb cb, void *cb_arg);
 
+/**
+ * Statistics of the per-thread spdk_bdev_io cache.
+ */
+struct spdk_bdev_buf_cache_stat {
+	/** Maximum data size of the buffers in this class. */
+	uint32_t buf_size;
+	/** Number of buffers currently held in the cache. */
+	uint32_t cache_count;
+	/** Number of buffer allocations served from the cache. */
+	uint64_t hits;
+	/** Number of buffer allocations that had to refill the cache from the pool. */
+	uint64_t misses;
+	/** Number of I/O that had to wait for a buffer. */
+	uint64_t waits;
+};
+
+struct spdk_bdev_io_cache_stat {
+	/** Number of spdk_bdev_io the cache may currently hold. */
+	uint32_t cache_size;
+	/** Number of spdk_bdev_io currently held in the cache. */
+	uint32_t cache_count;
+	/** Highest number of outstanding spdk_bdev_io in the current sampling period. */
+	uint32_t peak_outstanding;
+	/** NUMA socket of the thread. The cache is refilled from the pool on this socket. */
+	uint32_t socket_id;
+	/** Number of spdk_bdev_io allocations served from the cache. */
+	uint64_t hits;
+	/** Number of spdk_bdev_io allocations that had to refill the cache from a pool. */
+	uint64_t misses;
+	/** Number of refills served from a pool on another NUMA socket. */
+	uint64_t remote_refills;
+	/** Number of spdk_bdev_io allocations that failed because all pools were empty. */
+	uint64_t pool_empty;
+	/** Number of times the cache size was increased. */
+	uint64_t grows;
+	/** Number of times the cache size was decreased. */
+	uint64_t shrinks;
+	/** Statistics of the data buffer cache of each size class, smallest first. */
+	struct spdk_bdev_buf_cache_stat buf[SPDK_BDEV_NUM_BUF_CLASSES];
+};
+
+/**
+ * Called on each thread with the statistics of its spdk_bdev_io cache.
+ *
+ * \param stat Statistics of the spdk_bdev_io cache of the current thread.
+ * \param cb_arg Callback argument.
+ */
+typedef void (*spdk_bdev_io_cache_stat_cb)(const struct spdk_bdev_io_cache_stat *stat,
+		void *cb_arg);
+
+/**
+ * Called when spdk_bdev_get_io_cache_stats() has visited all threads.
+ *
+ * \param cb_arg Callback argument.
+ * \param rc 0 on success, negative errno on failure.
+ */
+typedef void (*spdk_bdev_get_io_cache_stats_cb)(void *cb_arg, int rc);
+
+/**
+ * Collect statistics of the spdk_bdev_io cache of every thread that has used
+ * the bdev layer. stat_cb is called on each of those threads in turn and cb
+ * is called on the calling thread once all of them have been visited.
+ *
+ * \param stat_cb Called on each thread with the statistics of its cache.
+ * \param cb Called when this operation completes.
+ * \param cb_arg Argument passed to both callback functions.
+ */
+void spdk_bdev_get_io_cache_stats(spdk_bdev_io_cache_stat_cb stat_cb,
+				  spdk_bdev_get_io_cache_stats_cb cb, void *cb_arg);
+
 /**
  * Get the status of bdev_io as an NVMe status code.
  *
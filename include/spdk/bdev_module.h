@@ -394,6 +394,9 @@ struct spdk_bdev {
 		/** List of open descriptors for this block device. */
 		TAILQ_HEAD(, spdk_bdev_desc) open_descs;
 
+		/** Identifier of the next descriptor opened on this block device. */
+		uint32_t next_desc_id;
+
 		TAILQ_ENTRY(spdk_bdev) link;
 
 		/** points to a reset bdev_io if one is in progress. */
@@ -610,6 +613,9 @@ struct spdk_bdev_io {
 
 		/** Enables queuing parent I/O when no bdev_ios available for split children. */
 		struct spdk_bdev_io_wait_entry waitq_entry;
+
+		/** The mempool this bdev_io was allocated from. */
+		struct spdk_mempool *pool;
 	} internal;
 
 	/**
@@ -781,7 +787,7 @@ const struct spdk_bdev_aliases_list *spdk_bdev_get_aliases(const struct spdk_bde
  * or the bdev_io has an SGL assigned already.
  * \param len size of the buffer to allocate. In case the bdev_io
  * doesn't have an SGL assigned this field must be no bigger than
- * \c SPDK_BDEV_LARGE_BUF_MAX_SIZE.
+ * \c SPDK_BDEV_HUGE_BUF_MAX_SIZE.
  */
 void spdk_bdev_io_get_buf(struct spdk_bdev_io *bdev_io, spdk_bdev_io_get_buf_cb cb, uint64_t len);
 
@@ -59,10 +59,54 @@ typedef void (*spdk_copy_completion_cb)(void *ref, int status);
  */
 typedef void (*spdk_copy_fini_cb)(void *cb_arg);
 
+/**
+ * Batch completion callback.
+ *
+ * \param cb_arg Callback argument passed to spdk_copy_batch_submit().
+ * \param status 0 if all operations of the batch completed successfully, or the
+ * status of the first one that failed.
+ */
+typedef void (*spdk_copy_batch_cb)(void *cb_arg, int status);
+
 struct spdk_io_channel;
 
 struct spdk_copy_task;
 
+struct spdk_copy_batch;
+struct spdk_json_write_ctx;
+
+/**
+ * Options of the software copy engine.
+ */
+struct spdk_copy_sw_opts {
+	/**
+	 * Copies and fills of at least this many bytes are carried out in chunks from
+	 * a poller, with non-temporal stores so they don't evict the cache. 0 disables
+	 * this and all copies and fills are done inline with memcpy() and memset().
+	 */
+	uint64_t large_threshold;
+
+	/** Bytes of large copies and fills processed by each run of the poller. */
+	uint64_t chunk_size;
+};
+
+/**
+ * Get the options of the software copy engine.
+ *
+ * \param opts Filled with the current options.
+ */
+void spdk_copy_engine_get_sw_opts(struct spdk_copy_sw_opts *opts);
+
+/**
+ * Set the options of the software copy engine. They apply to operations submitted
+ * afterwards.
+ *
+ * \param opts Options to set.
+ *
+ * \return 0 on success, -EINVAL if chunk_size is 0.
+ */
+int spdk_copy_engine_set_sw_opts(const struct spdk_copy_sw_opts *opts);
+
 /**
  * Initialize the copy engine.
  *
@@ -85,6 +129,13 @@ void spdk_copy_engine_finish(spdk_copy_fini_cb cb_fn, void *cb_arg);
  */
 void spdk_copy_engine_config_text(FILE *fp);
 
+/**
+ * Write the configuration of the copy engine as a JSON array of RPC calls.
+ *
+ * \param w JSON write context.
+ */
+void spdk_copy_engine_write_config_json(struct spdk_json_write_ctx *w);
+
 /**
  * Close the copy engine module and perform any necessary cleanup.
  */
@@ -133,6 +184,169 @@ int spdk_copy_submit(struct spdk_copy_task *copy_req, struct spdk_io_channel *ch
 int spdk_copy_submit_fill(struct spdk_copy_task *copy_req, struct spdk_io_channel *ch,
 			  void *dst, uint8_t fill, uint64_t nbytes, spdk_copy_completion_cb cb);
 
+/**
+ * Submit a CRC32C request.
+ *
+ * This operation computes the CRC32C of the source buffer the way
+ * spdk_crc32c_update() does, without inverting the seed or the result.
+ *
+ * \param copy_req Copy request task.
+ * \param ch I/O channel to submit request to the copy engine. This channel can
+ * be obtained by the function spdk_copy_engine_get_io_channel().
+ * \param dst Where to store the CRC32C. Must stay valid until cb is called.
+ * \param src Source buffer.
+ * \param seed Initial CRC32C value.
+ * \param nbytes Length in bytes of the source buffer.
+ * \param cb Called when this operation completes.
+ *
+ * \return 0 on success, negative errno on failure.
+ */
+int spdk_copy_submit_crc32c(struct spdk_copy_task *copy_req, struct spdk_io_channel *ch,
+			    uint32_t *dst, void *src, uint32_t seed, uint64_t nbytes,
+			    spdk_copy_completion_cb cb);
+
+/**
+ * Submit a copy request that also computes the CRC32C of the data copied.
+ *
+ * \param copy_req Copy request task.
+ * \param ch I/O channel to submit request to the copy engine. This channel can
+ * be obtained by the function spdk_copy_engine_get_io_channel().
+ * \param dst Destination to copy to.
+ * \param src Source to copy from.
+ * \param crc_dst Where to store the CRC32C. Must stay valid until cb is called.
+ * \param seed Initial CRC32C value.
+ * \param nbytes Length in bytes to copy.
+ * \param cb Called when this operation completes.
+ *
+ * \return 0 on success, negative errno on failure.
+ */
+int spdk_copy_submit_copy_crc32c(struct spdk_copy_task *copy_req, struct spdk_io_channel *ch,
+				 void *dst, void *src, uint32_t *crc_dst, uint32_t seed,
+				 uint64_t nbytes, spdk_copy_completion_cb cb);
+
+/**
+ * Submit a compare request.
+ *
+ * \param copy_req Copy request task.
+ * \param ch I/O channel to submit request to the copy engine. This channel can
+ * be obtained by the function spdk_copy_engine_get_io_channel().
+ * \param src1 First buffer to compare.
+ * \param src2 Second buffer to compare.
+ * \param nbytes Length in bytes to compare.
+ * \param cb Called when this operation completes, with status -EILSEQ if the
+ * buffers differ.
+ *
+ * \return 0 on success, negative errno on failure.
+ */
+int spdk_copy_submit_compare(struct spdk_copy_task *copy_req, struct spdk_io_channel *ch,
+			     void *src1, void *src2, uint64_t nbytes, spdk_copy_completion_cb cb);
+
+/**
+ * Submit a dualcast request.
+ *
+ * This operation copies the source buffer to two destinations.
+ *
+ * \param copy_req Copy request task.
+ * \param ch I/O channel to submit request to the copy engine. This channel can
+ * be obtained by the function spdk_copy_engine_get_io_channel().
+ * \param dst1 First destination to copy to.
+ * \param dst2 Second destination to copy to.
+ * \param src Source to copy from.
+ * \param nbytes Length in bytes to copy.
+ * \param cb Called when this operation completes.
+ *
+ * \return 0 on success, negative errno on failure.
+ */
+int spdk_copy_submit_dualcast(struct spdk_copy_task *copy_req, struct spdk_io_channel *ch,
+			      void *dst1, void *dst2, void *src, uint64_t nbytes,
+			      spdk_copy_completion_cb cb);
+
+/**
+ * Get a batch to submit several operations at once.
+ *
+ * Operations are added to the batch with the spdk_copy_batch_prep_*() functions
+ * and handed to the engine together by spdk_copy_batch_submit(), which lets
+ * hardware engines post all of their descriptors with a single doorbell.
+ *
+ * \param ch I/O channel the batch will be submitted to.
+ *
+ * \return a batch, or NULL if all batches of the channel are in use.
+ */
+struct spdk_copy_batch *spdk_copy_batch_create(struct spdk_io_channel *ch);
+
+/**
+ * Add a copy to a batch. The arguments are those of spdk_copy_submit().
+ *
+ * \param batch Batch to add the operation to.
+ *
+ * \return 0 on success, negative errno on failure.
+ */
+int spdk_copy_batch_prep_copy(struct spdk_copy_batch *batch, struct spdk_copy_task *copy_req,
+			      void *dst, void *src, uint64_t nbytes, spdk_copy_completion_cb cb);
+
+/**
+ * Add a fill to a batch. The arguments are those of spdk_copy_submit_fill().
+ *
+ * \param batch Batch to add the operation to.
+ *
+ * \return 0 on success, negative errno on failure.
+ */
+int spdk_copy_batch_prep_fill(struct spdk_copy_batch *batch, struct spdk_copy_task *copy_req,
+			      void *dst, uint8_t fill, uint64_t nbytes, spdk_copy_completion_cb cb);
+
+/**
+ * Add a CRC32C to a batch. The arguments are those of spdk_copy_submit_crc32c().
+ *
+ * \param batch Batch to add the operation to.
+ *
+ * \return 0 on success, negative errno on failure.
+ */
+int spdk_copy_batch_prep_crc32c(struct spdk_copy_batch *batch, struct spdk_copy_task *copy_req,
+				uint32_t *dst, void *src, uint32_t seed, uint64_t nbytes,
+				spdk_copy_completion_cb cb);
+
+/**
+ * Add a compare to a batch. The arguments are those of spdk_copy_submit_compare().
+ *
+ * \param batch Batch to add the operation to.
+ *
+ * \return 0 on success, negative errno on failure.
+ */
+int spdk_copy_batch_prep_compare(struct spdk_copy_batch *batch, struct spdk_copy_task *copy_req,
+				 void *src1, void *src2, uint64_t nbytes, spdk_copy_completion_cb cb);
+
+/**
+ * Add a dualcast to a batch. The arguments are those of spdk_copy_submit_dualcast().
+ *
+ * \param batch Batch to add the operation to.
+ *
+ * \return 0 on success, negative errno on failure.
+ */
+int spdk_copy_batch_prep_dualcast(struct spdk_copy_batch *batch, struct spdk_copy_task *copy_req,
+				  void *dst1, void *dst2, void *src, uint64_t nbytes,
+				  spdk_copy_completion_cb cb);
+
+/**
+ * Submit all operations of a batch.
+ *
+ * The callback of every operation is called when it completes, then cb_fn once
+ * all of them completed. The batch is released before cb_fn is called.
+ *
+ * \param batch Batch to submit.
+ * \param cb_fn Called when all operations of the batch completed.
+ * \param cb_arg Argument passed to cb_fn.
+ *
+ * \return 0 on success, -EINVAL if the batch is empty.
+ */
+int spdk_copy_batch_submit(struct spdk_copy_batch *batch, spdk_copy_batch_cb cb_fn, void *cb_arg);
+
+/**
+ * Release a batch without submitting its operations. Their callbacks are not called.
+ *
+ * \param batch Batch to release.
+ */
+void spdk_copy_batch_cancel(struct spdk_copy_batch *batch);
+
 /**
  * Get the size of copy task.
  *
@@ -298,6 +298,123 @@ void spdk_reactor_enable_framework_monitor_context_switch(bool enabled);
  */
 bool spdk_reactor_framework_monitor_context_switch_enabled(void);
 
+/**
+ * Select the policy that places lightweight threads on reactors.
+ *
+ * "static" leaves every thread on the reactor it was first scheduled on.
+ * "balanced" samples the busy time of each thread every period and moves
+ * threads from the busiest reactors to the least busy ones. "work_stealing"
+ * balances the same way and also lets idle reactors take threads from busy
+ * ones in between.
+ *
+ * \param name Name of the scheduler.
+ * \param period_usec How often thread load is sampled, in microseconds. 0 keeps
+ * the current period.
+ *
+ * \return 0 on success, -ENOENT if there is no scheduler with that name.
+ */
+int spdk_reactor_set_scheduler(const char *name, uint64_t period_usec);
+
+/** Scheduler state and counters. */
+struct spdk_reactor_scheduler_info {
+	/** Name of the scheduler in use. */
+	const char *name;
+
+	/** Sampling period in microseconds. */
+	uint64_t period_usec;
+
+	/** Threads moved by the periodic balancing. */
+	uint64_t migrations;
+
+	/** Threads taken by idle reactors. */
+	uint64_t steals;
+};
+
+/**
+ * Get the scheduler in use and how many threads it has moved.
+ *
+ * \param info Filled in by this call.
+ */
+void spdk_reactor_get_scheduler_info(struct spdk_reactor_scheduler_info *info);
+
+/** A move of a lightweight thread from one reactor to another. */
+struct spdk_reactor_migration {
+	/** Name of the thread at the time it was moved. */
+	char		thread_name[64];
+
+	/** Reactor the thread was taken from. */
+	uint32_t	src_lcore;
+
+	/** Reactor the thread was moved to. */
+	uint32_t	dst_lcore;
+
+	/** True if an idle reactor stole the thread, false if it was moved by balancing. */
+	bool		stolen;
+
+	/** Time of the move in ticks. */
+	uint64_t	tsc;
+};
+
+/**
+ * Get the most recent thread migrations, newest first.
+ *
+ * \param migrations Array filled in by this call.
+ * \param max_migrations Number of entries in the array.
+ *
+ * \return the number of entries filled in.
+ */
+uint32_t spdk_reactor_get_migrations(struct spdk_reactor_migration *migrations,
+				     uint32_t max_migrations);
+
+/**
+ * Enable or disable interrupt mode.
+ *
+ * In interrupt mode, a reactor whose threads did no work for the idle period
+ * stops polling and blocks until an event is sent to it, a message is sent to
+ * one of its threads, a timed poller expires or the wakeup fd of a poller
+ * becomes readable. Reactors with threads that have a poller registered with
+ * a period of 0 and without a wakeup fd keep polling. See
+ * spdk_poller_set_wakeup_fd().
+ *
+ * \param enabled True to enable, false to disable.
+ * \param idle_usec How long a reactor must be idle before it blocks, in
+ * microseconds. 0 keeps the current period.
+ *
+ * \return 0 on success, -ENOTSUP if interrupt mode is not supported on this platform.
+ */
+int spdk_reactor_set_interrupt_mode(bool enabled, uint64_t idle_usec);
+
+/**
+ * Return whether interrupt mode is enabled.
+ *
+ * \param idle_usec If not NULL, set to the idle period in microseconds.
+ *
+ * \return true if enabled or false otherwise.
+ */
+bool spdk_reactor_get_interrupt_mode(uint64_t *idle_usec);
+
+/** Interrupt mode statistics of a reactor. */
+struct spdk_reactor_interrupt_stats {
+	/** Whether the reactor is currently blocked. */
+	bool		sleeping;
+
+	/** Number of times the reactor blocked. */
+	uint64_t	sleep_count;
+
+	/** Total time the reactor spent blocked, in ticks. */
+	uint64_t	sleep_tsc;
+};
+
+/**
+ * Get the interrupt mode statistics of a reactor.
+ *
+ * \param lcore Core of the reactor.
+ * \param stats Filled in by this call.
+ *
+ * \return 0 on success, -EINVAL if there is no reactor on lcore.
+ */
+int spdk_reactor_get_interrupt_stats(uint32_t lcore, struct spdk_reactor_interrupt_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
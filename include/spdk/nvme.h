@@ -1009,6 +1009,32 @@ struct spdk_nvme_io_qpair_opts {
 		uint64_t paddr;
 		uint64_t buffer_size;
 	} cq;
+
+	/**
+	 * Only create the qpair, without connecting it to the controller. The qpair
+	 * must then be connected with spdk_nvme_ctrlr_connect_io_qpair() before it is
+	 * used. This allows adding the qpair to a poll group first, so that transports
+	 * which share resources across a group can set the qpair up with them.
+	 */
+	bool create_only;
+
+	/**
+	 * Ring the submission queue doorbell right away only while the queue is idle.
+	 * Otherwise, ring it once per batch inside spdk_nvme_qpair_process_completions(),
+	 * or once pcie_doorbell_budget_us expired since the first submission waiting for it.
+	 * Completion queue head doorbell writes are also coalesced while the completion
+	 * queue has room.
+	 *
+	 * This keeps the latency of lone I/O, and reduces MMIO writes at high queue depths.
+	 * Overrides delay_pcie_doorbell. This only applies to local PCIe devices.
+	 */
+	bool adaptive_pcie_doorbell;
+
+	/**
+	 * Longest time in microseconds a submission waits for the doorbell with
+	 * adaptive_pcie_doorbell. 0 waits until completions are processed.
+	 */
+	uint32_t pcie_doorbell_budget_us;
 };
 
 /**
@@ -1041,9 +1067,25 @@ struct spdk_nvme_qpair *spdk_nvme_ctrlr_alloc_io_qpair(struct spdk_nvme_ctrlr *c
 		const struct spdk_nvme_io_qpair_opts *opts,
 		size_t opts_size);
 
+/**
+ * Connect an I/O queue pair that was allocated with spdk_nvme_io_qpair_opts::create_only.
+ *
+ * \param ctrlr NVMe controller the I/O queue pair was allocated on.
+ * \param qpair I/O queue pair to connect.
+ *
+ * \return 0 on success, -EISCONN if the qpair is already connected, or a negated
+ * errno if connecting failed.
+ */
+int spdk_nvme_ctrlr_connect_io_qpair(struct spdk_nvme_ctrlr *ctrlr,
+				     struct spdk_nvme_qpair *qpair);
+
 /**
  * Free an I/O queue pair that was allocated by spdk_nvme_ctrlr_alloc_io_qpair().
  *
+ * If the qpair is in a poll group, it is removed from the group first. This may
+ * be called from a completion callback of any qpair in the group; the qpair is
+ * then freed once spdk_nvme_poll_group_process_completions() returns.
+ *
  * \param qpair I/O queue pair to free.
  *
  * \return 0 on success, -1 on failure.
@@ -1181,6 +1223,136 @@ int spdk_nvme_ctrlr_cmd_io_raw_with_md(struct spdk_nvme_ctrlr *ctrlr,
 int32_t spdk_nvme_qpair_process_completions(struct spdk_nvme_qpair *qpair,
 		uint32_t max_completions);
 
+/**
+ * Doorbell statistics of a queue pair.
+ */
+struct spdk_nvme_qpair_doorbell_stats {
+	/** Number of commands submitted to the submission queue. */
+	uint64_t submitted;
+
+	/** Number of completions processed from the completion queue. */
+	uint64_t completed;
+
+	/** Number of MMIO writes to the submission queue tail doorbell. */
+	uint64_t sq_doorbell_writes;
+
+	/** Number of MMIO writes to the completion queue head doorbell. */
+	uint64_t cq_doorbell_writes;
+};
+
+/**
+ * Get the doorbell statistics of a queue pair since it was allocated.
+ *
+ * \param qpair The queue pair.
+ * \param[out] stats Will be filled with the statistics.
+ *
+ * \return 0 on success, or -ENOTSUP if the transport has no doorbells.
+ */
+int spdk_nvme_qpair_get_doorbell_stats(struct spdk_nvme_qpair *qpair,
+				       struct spdk_nvme_qpair_doorbell_stats *stats);
+
+/**
+ * Opaque handle to a group of I/O queue pairs that are polled together.
+ */
+struct spdk_nvme_poll_group;
+
+/**
+ * Signature for the callback invoked by spdk_nvme_poll_group_process_completions()
+ * for each qpair of the group that failed at the transport layer or whose
+ * controller failed.
+ *
+ * \param qpair The failed qpair. It stays in the poll group.
+ * \param poll_group_ctx Context passed to spdk_nvme_poll_group_create().
+ */
+typedef void (*spdk_nvme_disconnected_qpair_cb)(struct spdk_nvme_qpair *qpair,
+		void *poll_group_ctx);
+
+/**
+ * Create a poll group.
+ *
+ * A poll group owns I/O queue pairs of any number of controllers and transports
+ * and reaps their completions in a single call. Qpairs of the same transport
+ * share the resources of that transport: the RDMA qpairs of a group share one
+ * completion queue per RDMA device and the TCP qpairs share one socket group, so
+ * a poll costs one CQ poll or one socket group poll instead of one per qpair.
+ *
+ * A poll group and its qpairs must only be used from one thread at a time.
+ *
+ * \param ctx User context passed to the disconnected qpair callback.
+ *
+ * \return a pointer to the poll group, or NULL if it could not be allocated.
+ */
+struct spdk_nvme_poll_group *spdk_nvme_poll_group_create(void *ctx);
+
+/**
+ * Add an I/O queue pair to a poll group.
+ *
+ * RDMA qpairs only share the completion queue of the group if they are added
+ * before they are connected, see spdk_nvme_io_qpair_opts::create_only. A qpair
+ * that is already connected keeps its own completion queue, which is polled
+ * along with the others.
+ *
+ * \param group The poll group.
+ * \param qpair The I/O queue pair to add. It must not be in a poll group yet.
+ *
+ * \return 0 on success, -EINVAL if the qpair is already in a poll group or is
+ * an admin queue pair, or -ENOMEM.
+ */
+int spdk_nvme_poll_group_add(struct spdk_nvme_poll_group *group, struct spdk_nvme_qpair *qpair);
+
+/**
+ * Remove an I/O queue pair from a poll group.
+ *
+ * Qpairs are removed from their group automatically when they are freed.
+ *
+ * \param group The poll group.
+ * \param qpair The I/O queue pair to remove.
+ *
+ * \return 0 on success, -ENOENT if the qpair is not in this group, or -EBUSY if
+ * called from a completion callback of the group or if the qpair is an RDMA
+ * qpair connected on the completion queue of the group. Such a qpair only leaves
+ * the group when it is freed.
+ */
+int spdk_nvme_poll_group_remove(struct spdk_nvme_poll_group *group,
+				struct spdk_nvme_qpair *qpair);
+
+/**
+ * Process the completions of all the qpairs in a poll group.
+ *
+ * For each completed command, the request's callback function is called, as
+ * with spdk_nvme_qpair_process_completions(). The group must not be destroyed
+ * and spdk_nvme_ctrlr_reset() must not be called from within these callbacks.
+ *
+ * \param group The poll group.
+ * \param completions_per_qpair Limit the number of completions processed for
+ * each qpair, or 0 for unlimited. Qpairs sharing an RDMA completion queue are
+ * limited as a whole, to the sum of their limits.
+ * \param disconnected_qpair_cb Called for each qpair of the group that failed. Must
+ * not be NULL.
+ *
+ * \return the number of completions processed across all the qpairs (may be 0).
+ */
+int64_t spdk_nvme_poll_group_process_completions(struct spdk_nvme_poll_group *group,
+		uint32_t completions_per_qpair, spdk_nvme_disconnected_qpair_cb disconnected_qpair_cb);
+
+/**
+ * Get the context passed to spdk_nvme_poll_group_create().
+ *
+ * \param group The poll group.
+ *
+ * \return the user context of the group.
+ */
+void *spdk_nvme_poll_group_get_ctx(struct spdk_nvme_poll_group *group);
+
+/**
+ * Destroy an empty poll group.
+ *
+ * \param group The poll group to destroy.
+ *
+ * \return 0 on success, or -EBUSY if the group still has qpairs.
+ */
+int spdk_nvme_poll_group_destroy(struct spdk_nvme_poll_group *group);
+
 /**
  * Send the given admin command to the NVMe controller.
  *
@@ -1607,8 +1779,8 @@ void *spdk_nvme_ctrlr_alloc_cmb_io_buffer(struct spdk_nvme_ctrlr *ctrlr, size_t
 /**
  * Free a controller memory I/O buffer (Experimental).
  *
- * Note this function is currently a NOP which is one reason why this and
- * spdk_nvme_ctrlr_alloc_cmb_io_buffer() are currently marked as experimental.
+ * The space is reused by later allocations of I/O buffers and of submission
+ * queues placed in the CMB.
  *
  * \param ctrlr Controller from which the buffer was allocated.
  * \param buf Buffer previously allocated by spdk_nvme_ctrlr_alloc_cmb_io_buffer().
@@ -676,6 +676,9 @@ enum spdk_nvme_media_error_status_code {
  */
 enum spdk_nvme_path_status_code {
 	SPDK_NVME_SC_INTERNAL_PATH_ERROR		= 0x00,
+	SPDK_NVME_SC_ASYMMETRIC_ACCESS_PERSISTENT_LOSS	= 0x01,
+	SPDK_NVME_SC_ASYMMETRIC_ACCESS_INACCESSIBLE	= 0x02,
+	SPDK_NVME_SC_ASYMMETRIC_ACCESS_TRANSITION	= 0x03,
 
 	SPDK_NVME_SC_CONTROLLER_PATH_ERROR		= 0x60,
 
@@ -964,7 +967,8 @@ struct __attribute__((packed)) __attribute__((aligned)) spdk_nvme_ctrlr_data {
 		uint8_t multi_port	: 1;
 		uint8_t multi_host	: 1;
 		uint8_t sr_iov		: 1;
-		uint8_t reserved	: 5;
+		uint8_t ana_reporting	: 1;
+		uint8_t reserved	: 4;
 	} cmic;
 
 	/** maximum data transfer size */
@@ -992,7 +996,12 @@ struct __attribute__((packed)) __attribute__((aligned)) spdk_nvme_ctrlr_data {
 		/** Supports sending Firmware Activation Notices. */
 		uint32_t	fw_activation_notices : 1;
 
-		uint32_t	reserved2 : 22;
+		uint32_t	reserved2 : 1;
+
+		/** Supports sending Asymmetric Namespace Access Change Notices. */
+		uint32_t	ana_change_notices : 1;
+
+		uint32_t	reserved3 : 20;
 	} oaes;
 
 	/** controller attributes */
@@ -1192,7 +1201,53 @@ struct __attribute__((packed)) __attribute__((aligned)) spdk_nvme_ctrlr_data {
 		} bits;
 	} sanicap;
 
-	uint8_t			reserved3[180];
+	/** host memory buffer minimum descriptor entry size */
+	uint32_t		hmminds;
+
+	/** host memory maximum descriptors entries */
+	uint16_t		hmmaxd;
+
+	/** NVM set identifier maximum */
+	uint16_t		nsetidmax;
+
+	/** endurance group identifier maximum */
+	uint16_t		endgidmax;
+
+	/** ANA transition time in seconds */
+	uint8_t			anatt;
+
+	/** asymmetric namespace access capabilities */
+	union {
+		uint8_t		raw;
+		struct {
+			/** reports ANA optimized state */
+			uint8_t	ana_optimized_state : 1;
+			/** reports ANA non-optimized state */
+			uint8_t	ana_non_optimized_state : 1;
+			/** reports ANA inaccessible state */
+			uint8_t	ana_inaccessible_state : 1;
+			/** reports ANA persistent loss state */
+			uint8_t	ana_persistent_loss_state : 1;
+			/** reports ANA change state */
+			uint8_t	ana_change_state : 1;
+			uint8_t	reserved : 1;
+			/** ANAGRPID does not change while the namespace is attached */
+			uint8_t	no_change_anagrpid : 1;
+			/** supports non-zero ANAGRPID */
+			uint8_t	non_zero_anagrpid : 1;
+		} bits;
+	} anacap;
+
+	/** ANA group identifier maximum */
+	uint32_t		anagrpmax;
+
+	/** number of ANA group identifiers */
+	uint32_t		nanagrpid;
+
+	/** persistent event log size in 64 KiB units */
+	uint32_t		pels;
+
+	uint8_t			reserved356[156];
 
 	/* bytes 512-703: nvm command set attributes */
 
@@ -1310,6 +1365,8 @@ struct __attribute__((packed)) __attribute__((aligned)) spdk_nvme_ctrlr_data {
 	uint8_t			vs[1024];
 };
 SPDK_STATIC_ASSERT(sizeof(struct spdk_nvme_ctrlr_data) == 4096, "Incorrect size");
+SPDK_STATIC_ASSERT(offsetof(struct spdk_nvme_ctrlr_data, anatt) == 342, "Incorrect offset");
+SPDK_STATIC_ASSERT(offsetof(struct spdk_nvme_ctrlr_data, nanagrpid) == 348, "Incorrect offset");
 
 struct __attribute__((packed)) spdk_nvme_primary_ctrl_capabilities {
 	/**  controller id */
@@ -1554,7 +1611,12 @@ struct spdk_nvme_ns_data {
 	/** NVM capacity */
 	uint64_t		nvmcap[2];
 
-	uint8_t			reserved64[40];
+	uint8_t			reserved64[28];
+
+	/** ANA group identifier */
+	uint32_t		anagrpid;
+
+	uint8_t			reserved96[8];
 
 	/** namespace globally unique identifier */
 	uint8_t			nguid[16];
@@ -1581,6 +1643,7 @@ struct spdk_nvme_ns_data {
 	uint8_t			vendor_specific[3712];
 };
 SPDK_STATIC_ASSERT(sizeof(struct spdk_nvme_ns_data) == 4096, "Incorrect size");
+SPDK_STATIC_ASSERT(offsetof(struct spdk_nvme_ns_data, anagrpid) == 92, "Incorrect offset");
 
 /**
  * Deallocated logical block features - read value
@@ -1798,7 +1861,12 @@ enum spdk_nvme_log_page {
 	/** Controller initiated telemetry log (optional) */
 	SPDK_NVME_LOG_TELEMETRY_CTRLR_INITIATED	= 0x08,
 
-	/* 0x09-0x6F - reserved */
+	/* 0x09-0x0B - reserved */
+
+	/** Asymmetric namespace access (optional) */
+	SPDK_NVME_LOG_ASYMMETRIC_NAMESPACE_ACCESS	= 0x0C,
+
+	/* 0x0D-0x6F - reserved */
 
 	/** Discovery(refer to the NVMe over Fabrics specification) */
 	SPDK_NVME_LOG_DISCOVERY		= 0x70,
@@ -1998,6 +2066,52 @@ struct spdk_nvme_sanitize_status_log_page {
 };
 SPDK_STATIC_ASSERT(sizeof(struct spdk_nvme_sanitize_status_log_page) == 512, "Incorrect size");
 
+/**
+ * Asymmetric namespace access states
+ */
+enum spdk_nvme_ana_state {
+	SPDK_NVME_ANA_OPTIMIZED_STATE		= 0x1,
+	SPDK_NVME_ANA_NON_OPTIMIZED_STATE	= 0x2,
+	SPDK_NVME_ANA_INACCESSIBLE_STATE	= 0x3,
+	SPDK_NVME_ANA_PERSISTENT_LOSS_STATE	= 0x4,
+	SPDK_NVME_ANA_CHANGE_STATE		= 0xF,
+};
+
+/**
+ * ANA group descriptor of the asymmetric namespace access log page
+ * (\ref SPDK_NVME_LOG_ASYMMETRIC_NAMESPACE_ACCESS)
+ */
+struct spdk_nvme_ana_group_descriptor {
+	/* ANA group identifier */
+	uint32_t		ana_group_id;
+	/* Number of NSID values in the nsid array */
+	uint32_t		num_of_nsid;
+	/* Change count of this group */
+	uint64_t		change_count;
+	/* \ref spdk_nvme_ana_state */
+	uint8_t			ana_state : 4;
+	uint8_t			reserved0 : 4;
+	uint8_t			reserved1[15];
+	uint32_t		nsid[];
+};
+SPDK_STATIC_ASSERT(sizeof(struct spdk_nvme_ana_group_descriptor) == 32, "Incorrect size");
+
+/**
+ * Asymmetric namespace access log page header
+ * (\ref SPDK_NVME_LOG_ASYMMETRIC_NAMESPACE_ACCESS)
+ *
+ * The header is followed by num_ana_group_desc variable length
+ * \ref spdk_nvme_ana_group_descriptor entries.
+ */
+struct spdk_nvme_ana_page {
+	/* Change count of the log page */
+	uint64_t		change_count;
+	/* Number of ANA group descriptors */
+	uint16_t		num_ana_group_desc;
+	uint8_t			reserved[6];
+};
+SPDK_STATIC_ASSERT(sizeof(struct spdk_nvme_ana_page) == 16, "Incorrect size");
+
 /**
  * Asynchronous Event Type
  */
@@ -2060,8 +2174,10 @@ enum spdk_nvme_async_event_info_notice {
 	SPDK_NVME_ASYNC_EVENT_FW_ACTIVATION_START	= 0x1,
 	/* Telemetry Log Changed */
 	SPDK_NVME_ASYNC_EVENT_TELEMETRY_LOG_CHANGED	= 0x2,
+	/* Asymmetric Namespace Access Change */
+	SPDK_NVME_ASYNC_EVENT_ANA_CHANGE		= 0x3,
 
-	/* 0x3 - 0xFF Reserved */
+	/* 0x4 - 0xFF Reserved */
 };
 
 /**
@@ -2270,7 +2386,8 @@ union spdk_nvme_feat_async_event_configuration {
 		uint32_t ns_attr_notice		: 1;
 		uint32_t fw_activation_notice	: 1;
 		uint32_t telemetry_log_notice	: 1;
-		uint32_t reserved		: 21;
+		uint32_t ana_change_notice	: 1;
+		uint32_t reserved		: 20;
 	} bits;
 };
 SPDK_STATIC_ASSERT(sizeof(union spdk_nvme_feat_async_event_configuration) == 4, "Incorrect size");
@@ -272,6 +272,18 @@ int spdk_sock_group_poll(struct spdk_sock_group *group);
  */
 int spdk_sock_group_poll_count(struct spdk_sock_group *group, int max_events);
 
+/**
+ * Get a file descriptor that is readable while polling the group would return
+ * events. It can be used to wait for the sockets of the group instead of
+ * polling them.
+ *
+ * \param group Group to get the file descriptor of.
+ *
+ * \return the file descriptor, or -ENOTSUP if the sockets of the group are not
+ * all handled by a single implementation that provides one.
+ */
+int spdk_sock_group_get_fd(struct spdk_sock_group *group);
+
 /**
  * Close all registered sockets of the group and then remove the group.
  *
@@ -199,6 +199,17 @@ int spdk_thread_lib_init(spdk_new_thread_fn new_thread_fn, size_t ctx_sz);
  */
 void spdk_thread_lib_fini(void);
 
+/**
+ * Enable or disable message lanes. Messages sent from one SPDK thread to another
+ * go through a lock-free queue dedicated to that pair of threads instead of the
+ * shared message ring of the destination. Enabled by default.
+ *
+ * Changing this only affects pairs of threads that haven't exchanged a message yet.
+ *
+ * \param enabled True to enable message lanes, false to disable them.
+ */
+void spdk_thread_lib_set_msg_lanes(bool enabled);
+
 /**
  * Creates a new SPDK thread object.
  *
@@ -315,6 +326,17 @@ int spdk_thread_has_active_pollers(struct spdk_thread *thread);
  */
 bool spdk_thread_has_pollers(struct spdk_thread *thread);
 
+/**
+ * Returns whether the thread still holds any I/O channels. Putting a channel
+ * releases it asynchronously, so a thread that is about to exit can poll this
+ * to know when all of its channels are gone.
+ *
+ * \param thread The thread to check.
+ *
+ * \return true if there is at least one I/O channel, false otherwise.
+ */
+bool spdk_thread_has_io_channels(struct spdk_thread *thread);
+
 /**
  * Returns whether there are scheduled operations to be run on the thread.
  *
@@ -324,6 +346,37 @@ bool spdk_thread_has_pollers(struct spdk_thread *thread);
  */
 bool spdk_thread_is_idle(struct spdk_thread *thread);
 
+/**
+ * Get a file descriptor that becomes readable when a waiting thread has work
+ * to do. That is the case when a message is sent to it, or when the wakeup fd
+ * of one of its pollers becomes readable. See spdk_thread_wait_begin().
+ *
+ * \param thread The thread to get the file descriptor of.
+ *
+ * \return the file descriptor, or negated errno if the thread cannot be woken up.
+ */
+int spdk_thread_get_wakeup_fd(struct spdk_thread *thread);
+
+/**
+ * Start waiting for work on the thread instead of polling it. Messages sent
+ * to the thread from now on make its wakeup fd readable.
+ *
+ * spdk_thread_wait_end() must be called afterwards whatever this returns.
+ *
+ * \param thread The thread to wait on.
+ *
+ * \return true if the thread can wait. false if it has messages queued or an
+ * active poller without a wakeup fd, in which case it must be kept polled.
+ */
+bool spdk_thread_wait_begin(struct spdk_thread *thread);
+
+/**
+ * Stop waiting for work on the thread and clear its wakeup fd.
+ *
+ * \param thread The thread that was waited on.
+ */
+void spdk_thread_wait_end(struct spdk_thread *thread);
+
 /**
  * Get count of allocated threads.
  */
@@ -350,6 +403,15 @@ struct spdk_thread *spdk_get_thread(void);
  */
 const char *spdk_thread_get_name(const struct spdk_thread *thread);
 
+/**
+ * Get a thread's id.
+ *
+ * \param thread Thread to query.
+ *
+ * \return the id of the thread, unique for the lifetime of the process.
+ */
+uint64_t spdk_thread_get_id(const struct spdk_thread *thread);
+
 struct spdk_thread_stats {
 	uint64_t busy_tsc;
 	uint64_t idle_tsc;
@@ -370,12 +432,33 @@ int spdk_thread_get_stats(struct spdk_thread_stats *stats);
  * The message may be sent asynchronously - i.e. spdk_thread_send_msg may return
  * prior to `fn` being called.
  *
+ * Messages to a thread are run in the order they were sent. That includes messages
+ * from different threads when sending one happened before sending the other, e.g.
+ * when the second is sent from a message that the first one's sender sent after it.
+ *
  * \param thread The target thread.
  * \param fn This function will be called on the given thread.
  * \param ctx This context will be passed to fn when called.
  */
 void spdk_thread_send_msg(const struct spdk_thread *thread, spdk_msg_fn fn, void *ctx);
 
+/**
+ * Send several messages calling the same function to the given thread.
+ *
+ * This is equivalent to calling spdk_thread_send_msg() for each context in order,
+ * but the cost of queueing and of waking up the thread is shared by the messages.
+ *
+ * \param thread The target thread.
+ * \param fn This function will be called on the given thread once per context.
+ * \param ctxs Array of contexts, each passed to one call of fn.
+ * \param count Number of contexts in ctxs.
+ *
+ * \return the number of messages sent, the first ones of ctxs. Less than count only
+ * if no more memory was available for messages.
+ */
+uint32_t spdk_thread_send_msg_bulk(const struct spdk_thread *thread, spdk_msg_fn fn,
+				   void **ctxs, uint32_t count);
+
 /**
  * Send a message to each thread, serially.
  *
@@ -406,6 +489,32 @@ struct spdk_poller *spdk_poller_register(spdk_poller_fn fn,
 		void *arg,
 		uint64_t period_microseconds);
 
+/**
+ * Register a poller on the current thread with a given name.
+ *
+ * Same as spdk_poller_register(), but the poller is reported under name by
+ * spdk_poller_get_name() instead of the address of fn.
+ *
+ * \param fn This function will be called every `period_microseconds`.
+ * \param arg Argument passed to fn.
+ * \param period_microseconds How often to call `fn`. If 0, call `fn` as often
+ *  as possible.
+ * \param name Human-readable name for the poller. The string is copied.
+ *
+ * \return a pointer to the poller registered on the current thread on success
+ * or NULL on failure.
+ */
+struct spdk_poller *spdk_poller_register_named(spdk_poller_fn fn,
+		void *arg,
+		uint64_t period_microseconds,
+		const char *name);
+
+/**
+ * Register a poller on the current thread, named after its function.
+ */
+#define SPDK_POLLER_REGISTER(fn, arg, period_microseconds)	\
+	spdk_poller_register_named(fn, arg, period_microseconds, #fn)
+
 /**
  * Unregister a poller on the current thread.
  *
@@ -413,6 +522,79 @@ struct spdk_poller *spdk_poller_register(spdk_poller_fn fn,
  */
 void spdk_poller_unregister(struct spdk_poller **ppoller);
 
+/**
+ * Set a file descriptor that becomes readable when the poller has work to do.
+ *
+ * A thread can only wait for work while every poller registered with a period
+ * of 0 has a wakeup fd. The file descriptor must stay open until the poller is
+ * unregistered. Must be called on the thread the poller was registered on.
+ *
+ * \param poller The poller.
+ * \param fd The file descriptor.
+ *
+ * \return 0 on success, negated errno on failure.
+ */
+int spdk_poller_set_wakeup_fd(struct spdk_poller *poller, int fd);
+
+struct spdk_poller_stats {
+	/* Number of times the poller ran. */
+	uint64_t run_count;
+	/* Number of runs that did work, i.e. returned a positive value. */
+	uint64_t busy_count;
+	/* Ticks spent in all runs. */
+	uint64_t run_tsc;
+	/* Ticks spent in the runs that did work. */
+	uint64_t busy_tsc;
+};
+
+/**
+ * Get the first poller registered on a thread.
+ *
+ * Pollers running as often as possible come first, followed by timed pollers.
+ * Must be called on the thread itself, and the pollers may only be iterated over
+ * until the thread is polled again.
+ *
+ * \param thread Thread to query.
+ *
+ * \return the first poller or NULL if the thread has no pollers.
+ */
+struct spdk_poller *spdk_thread_get_first_poller(struct spdk_thread *thread);
+
+/**
+ * Get the next poller registered on the same thread.
+ *
+ * \param prev Previous poller.
+ *
+ * \return the next poller or NULL if prev was the last one.
+ */
+struct spdk_poller *spdk_thread_get_next_poller(struct spdk_poller *prev);
+
+/**
+ * Get a poller's name.
+ *
+ * \param poller Poller to query.
+ *
+ * \return the name given at registration, or the address of the poller's function.
+ */
+const char *spdk_poller_get_name(const struct spdk_poller *poller);
+
+/**
+ * Get a poller's period.
+ *
+ * \param poller Poller to query.
+ *
+ * \return the period in ticks, 0 if the poller runs as often as possible.
+ */
+uint64_t spdk_poller_get_period_ticks(const struct spdk_poller *poller);
+
+/**
+ * Get statistics about a poller.
+ *
+ * \param poller Poller to query.
+ * \param stats Filled with the cumulative statistics of the poller.
+ */
+void spdk_poller_get_stats(const struct spdk_poller *poller, struct spdk_poller_stats *stats);
+
 /**
  * Register the opaque io_device context as an I/O device.
  *
@@ -39,16 +39,64 @@
 #include "spdk/copy_engine.h"
 #include "spdk/queue.h"
 
+enum spdk_copy_op {
+	SPDK_COPY_OP_COPY,
+	SPDK_COPY_OP_FILL,
+	SPDK_COPY_OP_CRC32C,
+	SPDK_COPY_OP_COPY_CRC32C,
+	SPDK_COPY_OP_COMPARE,
+	SPDK_COPY_OP_DUALCAST,
+};
+
 struct spdk_copy_task {
 	spdk_copy_completion_cb	cb;
+
+	/* Batch the task was prepared in, NULL if it was submitted on its own */
+	struct spdk_copy_batch	*batch;
+
+	/*
+	 * Operation of a batched task, kept until the batch is submitted. A compare
+	 * keeps its buffers in dst and src.
+	 */
+	enum spdk_copy_op	op;
+	void			*dst;
+	void			*dst2;
+	void			*src;
+	uint32_t		*crc_dst;
+	uint32_t		seed;
+	uint8_t			fill;
+	uint64_t		nbytes;
+	TAILQ_ENTRY(spdk_copy_task)	link;
+
 	uint8_t			offload_ctx[0];
 };
 
+/* Operations an engine leaves NULL are carried out by the software engine. */
 struct spdk_copy_engine {
 	int	(*copy)(void *cb_arg, struct spdk_io_channel *ch, void *dst, void *src,
 			uint64_t nbytes, spdk_copy_completion_cb cb);
 	int	(*fill)(void *cb_arg, struct spdk_io_channel *ch, void *dst, uint8_t fill,
 			uint64_t nbytes, spdk_copy_completion_cb cb);
+	int	(*crc32c)(void *cb_arg, struct spdk_io_channel *ch, uint32_t *dst, void *src,
+			  uint32_t seed, uint64_t nbytes, spdk_copy_completion_cb cb);
+	int	(*copy_crc32c)(void *cb_arg, struct spdk_io_channel *ch, void *dst, void *src,
+			       uint32_t *crc_dst, uint32_t seed, uint64_t nbytes,
+			       spdk_copy_completion_cb cb);
+	int	(*compare)(void *cb_arg, struct spdk_io_channel *ch, void *src1, void *src2,
+			   uint64_t nbytes, spdk_copy_completion_cb cb);
+	int	(*dualcast)(void *cb_arg, struct spdk_io_channel *ch, void *dst1, void *dst2,
+			    void *src, uint64_t nbytes, spdk_copy_completion_cb cb);
+
+	/*
+	 * Optional. Queue a copy or fill like the functions above but don't hand it
+	 * to the hardware until flush is called. Used to submit batches.
+	 */
+	int	(*build_copy)(void *cb_arg, struct spdk_io_channel *ch, void *dst, void *src,
+			      uint64_t nbytes, spdk_copy_completion_cb cb);
+	int	(*build_fill)(void *cb_arg, struct spdk_io_channel *ch, void *dst, uint8_t fill,
+			      uint64_t nbytes, spdk_copy_completion_cb cb);
+	void	(*flush)(struct spdk_io_channel *ch);
+
 	struct spdk_io_channel *(*get_io_channel)(void);
 };
 
@@ -57,6 +57,48 @@ void spdk_reactors_fini(void);
 void spdk_reactors_start(void);
 void spdk_reactors_stop(void *arg1);
 
+/* Load of a reactor over the last scheduler period. */
+struct spdk_scheduler_core_info {
+	uint32_t		lcore;
+	uint64_t		busy_tsc;
+	uint64_t		idle_tsc;
+
+	/* Index of the first of the reactor's threads in the thread array, and their number. */
+	uint32_t		threads_start;
+	uint32_t		thread_count;
+};
+
+/* Load of a lightweight thread over the last scheduler period. */
+struct spdk_scheduler_thread_info {
+	uint64_t		id;
+	uint32_t		lcore;
+	uint64_t		busy_tsc;
+	uint64_t		idle_tsc;
+	struct spdk_cpuset	cpumask;
+
+	/* Reactor the thread should run on, set by the scheduler. Starts out as lcore. */
+	uint32_t		new_lcore;
+};
+
+struct spdk_scheduler {
+	const char *name;
+
+	/**
+	 * Called on the master reactor once every period with the load of all reactors
+	 *  and threads. Sets new_lcore of the threads that should be moved. NULL if
+	 *  the scheduler never moves threads periodically.
+	 */
+	void (*balance)(struct spdk_scheduler_core_info *cores, uint32_t core_count,
+			struct spdk_scheduler_thread_info *threads, uint32_t thread_count);
+
+	/* Whether reactors that were idle for a period take threads from busy ones. */
+	bool work_stealing;
+
+	TAILQ_ENTRY(spdk_scheduler) link;
+};
+
+void spdk_scheduler_register(struct spdk_scheduler *scheduler);
+
 struct spdk_subsystem {
 	const char *name;
 	/* User must call spdk_subsystem_init_next() when they are done with their initialization. */
@@ -120,6 +162,15 @@ void spdk_rpc_finish(void);
 		spdk_add_subsystem(&_name);					\
 	}
 
+/**
+ * \brief Register a new scheduler
+ */
+#define SPDK_SCHEDULER_REGISTER(_name) \
+	__attribute__((constructor)) static void _name ## _register(void)	\
+	{									\
+		spdk_scheduler_register(&_name);				\
+	}
+
 /**
  * \brief Declare that a subsystem depends on another subsystem.
  */
@@ -97,6 +97,9 @@ struct spdk_net_impl {
 			       struct spdk_sock **socks);
 	int (*group_impl_close)(struct spdk_sock_group_impl *group);
 
+	/* Optional. Returns a file descriptor that is readable while poll would return events. */
+	int (*group_impl_get_fd)(struct spdk_sock_group_impl *group);
+
 	STAILQ_ENTRY(spdk_net_impl) link;
 };
 
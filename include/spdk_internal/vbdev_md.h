@@ -0,0 +1,236 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Metadata of virtual bdevs that keep it on a bdev they own, like the cache and
+ * dedup vbdevs: a superblock in block 0 and an array of one block pages after it.
+ * All functions must be called on the thread that owns the vbdev.
+ */
+
+#ifndef SPDK_INTERNAL_VBDEV_MD_H
+#define SPDK_INTERNAL_VBDEV_MD_H
+
+#include "spdk/stdinc.h"
+
+#include "spdk/bdev_module.h"
+#include "spdk/queue.h"
+#include "spdk/thread.h"
+
+/* Page writes in progress at most */
+#define SPDK_VBDEV_MD_BUFS		64
+/* Size of the I/O used to read or write all pages */
+#define SPDK_VBDEV_MD_IO_SIZE		(1024 * 1024)
+
+/* Start of every superblock */
+struct spdk_vbdev_md_sb {
+	char			magic[8];
+	uint32_t		version;
+	/* CRC32C of the superblock with this field set to 0 */
+	uint32_t		crc;
+};
+
+typedef void (*spdk_vbdev_md_cb)(void *ctx, int status);
+
+struct spdk_vbdev_md_wait {
+	spdk_vbdev_md_cb			cb_fn;
+	void					*ctx;
+	TAILQ_ENTRY(spdk_vbdev_md_wait)		link;
+};
+
+struct spdk_vbdev_md_page {
+	bool					writing;
+	bool					queued;
+	/* Waiting for the next write of the page, and for the one in progress */
+	TAILQ_HEAD(, spdk_vbdev_md_wait)	waiting;
+	TAILQ_HEAD(, spdk_vbdev_md_wait)	inflight;
+	TAILQ_ENTRY(spdk_vbdev_md_page)		link;
+};
+
+struct spdk_vbdev_md;
+
+struct spdk_vbdev_md_buf {
+	struct spdk_vbdev_md			*md;
+	struct spdk_vbdev_md_page		*page;
+	void					*buf;
+	struct spdk_bdev_io_wait_entry		bdev_io_wait;
+	TAILQ_ENTRY(spdk_vbdev_md_buf)		link;
+};
+
+struct spdk_vbdev_md_ops {
+	/* Superblock identification, and the size its CRC covers */
+	const char	*magic;
+	uint32_t	version;
+	size_t		sb_size;
+
+	/* Fill buf with the content of a page. */
+	void		(*serialize_page)(void *ctx, uint64_t page_idx, void *buf);
+	/* Load a page read from the bdev. Returns 0 or a negated errno. */
+	int		(*parse_page)(void *ctx, uint64_t page_idx, void *buf);
+	/* Optional, called once a page is written, before its waiters are called. */
+	void		(*page_written)(void *ctx, uint64_t page_idx);
+};
+
+struct spdk_vbdev_md {
+	const struct spdk_vbdev_md_ops		*ops;
+	void					*ctx;
+	/* Name of the vbdev, for log messages */
+	const char				*name;
+	/* Thread that owns the vbdev */
+	struct spdk_thread			*thread;
+
+	/* Bdev the metadata is on */
+	struct spdk_bdev			*bdev;
+	struct spdk_bdev_desc			*desc;
+	struct spdk_io_channel			*ch;
+	uint32_t				block_size;
+
+	/* Block size buffer for the superblock */
+	void					*sb;
+
+	/* First block of the pages */
+	uint64_t				offset;
+	struct spdk_vbdev_md_page		*pages;
+	uint64_t				num_pages;
+	struct spdk_vbdev_md_buf		bufs[SPDK_VBDEV_MD_BUFS];
+	TAILQ_HEAD(, spdk_vbdev_md_buf)		free_bufs;
+	TAILQ_HEAD(, spdk_vbdev_md_page)	pages_waiting;
+	/* Page writes in progress, and completed */
+	uint64_t				outstanding;
+	uint64_t				writes;
+
+	/* Reading or writing all pages, or the superblock */
+	void					*io_buf;
+	uint64_t				io_page;
+	bool					io_write;
+	spdk_vbdev_md_cb			io_cb;
+
+	/* Waiting for the I/O of the vbdev to finish */
+	const uint64_t				*drain_outstanding;
+	spdk_vbdev_md_cb			drain_cb;
+	struct spdk_poller			*drain_poller;
+};
+
+/**
+ * Set up the metadata of a vbdev on the bdev opened with desc and allocate the
+ * superblock buffer. The owning thread is the current one.
+ *
+ * \param md Metadata, zeroed by the caller.
+ * \param ops Layout of the metadata.
+ * \param ctx Context passed to the ops and to the completion callbacks.
+ * \param name Name of the vbdev.
+ * \param desc Descriptor of the bdev holding the metadata.
+ * \param ch I/O channel of desc on the current thread.
+ *
+ * \return 0 on success, -ENOMEM if the buffer could not be allocated.
+ */
+int spdk_vbdev_md_init(struct spdk_vbdev_md *md, const struct spdk_vbdev_md_ops *ops,
+		       void *ctx, const char *name, struct spdk_bdev_desc *desc,
+		       struct spdk_io_channel *ch);
+
+/**
+ * Allocate the pages and the buffers to write them.
+ *
+ * \param md Metadata.
+ * \param offset First block of the pages.
+ * \param num_pages Number of pages.
+ *
+ * \return 0 on success, -ENOMEM on failure.
+ */
+int spdk_vbdev_md_alloc_pages(struct spdk_vbdev_md *md, uint64_t offset, uint64_t num_pages);
+
+/**
+ * Free everything allocated for md. Also works on a zeroed md, or one that is
+ * only partially set up.
+ *
+ * \param md Metadata.
+ */
+void spdk_vbdev_md_free(struct spdk_vbdev_md *md);
+
+/**
+ * Write a page, then call wait->cb_fn. Writes of a page are serialized, so that
+ * the last one always carries its latest content.
+ *
+ * \param md Metadata.
+ * \param page_idx Page to write.
+ * \param wait Callback, queued until the write completes.
+ */
+void spdk_vbdev_md_update(struct spdk_vbdev_md *md, uint64_t page_idx,
+			  struct spdk_vbdev_md_wait *wait);
+
+/**
+ * Read and parse, or serialize and write all pages.
+ *
+ * \param md Metadata.
+ * \param write True to write the pages, false to read them.
+ * \param cb Called with 0 or a negated errno once done.
+ */
+void spdk_vbdev_md_io(struct spdk_vbdev_md *md, bool write, spdk_vbdev_md_cb cb);
+
+/**
+ * Read the superblock into md->sb and check its CRC and version.
+ *
+ * \param md Metadata.
+ * \param cb Called with 0, -ENOENT if the bdev does not start with the magic,
+ * -EILSEQ if the superblock is corrupted or of another version, or another
+ * negated errno if it could not be read.
+ */
+void spdk_vbdev_md_sb_read(struct spdk_vbdev_md *md, spdk_vbdev_md_cb cb);
+
+/**
+ * Write md->sb, filled by the caller after the common part, which is set here.
+ *
+ * \param md Metadata.
+ * \param cb Called with 0 or a negated errno once done.
+ */
+void spdk_vbdev_md_sb_write(struct spdk_vbdev_md *md, spdk_vbdev_md_cb cb);
+
+/**
+ * Call fn on the thread owning the vbdev, directly when already on it.
+ *
+ * \param md Metadata.
+ * \param fn Function to call.
+ * \param arg Argument of fn.
+ */
+void spdk_vbdev_md_call(struct spdk_vbdev_md *md, spdk_msg_fn fn, void *arg);
+
+/**
+ * Wait for the I/O of the vbdev and the page writes to finish.
+ *
+ * \param md Metadata.
+ * \param outstanding I/O of the vbdev in progress, polled until it is 0.
+ * \param cb Called with 0 once nothing is in progress anymore.
+ */
+void spdk_vbdev_md_drain(struct spdk_vbdev_md *md, const uint64_t *outstanding,
+			 spdk_vbdev_md_cb cb);
+
+#endif /* SPDK_INTERNAL_VBDEV_MD_H */
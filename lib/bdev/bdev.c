@@ -62,8 +62,16 @@ int __itt_init_ittlib(const char *, __itt_group_id);
 
 #define SPDK_BDEV_IO_POOL_SIZE			(64 * 1024 - 1)
 #define SPDK_BDEV_IO_CACHE_SIZE			256
+#define SPDK_BDEV_IO_CACHE_MAX_GROWTH		8
+#define SPDK_BDEV_IO_CACHE_REFILL_BATCH		32
+#define SPDK_BDEV_IO_CACHE_ADJUST_PERIOD_USEC	(100 * 1000)
+#define SPDK_BDEV_IO_POOL_MAX_SOCKETS		8
+#define BUF_TINY_POOL_SIZE			8191
 #define BUF_SMALL_POOL_SIZE			8191
 #define BUF_LARGE_POOL_SIZE			1023
+#define BUF_HUGE_POOL_SIZE			127
+#define BUF_CACHE_BATCH				16
+#define BUF_RETRY_PERIOD_USEC			100
 #define NOMEM_THRESHOLD_COUNT			8
 #define ZERO_BUFFER_SIZE			0x100000
 
@@ -81,9 +89,16 @@ int __itt_init_ittlib(const char *, __itt_group_id);
 #define SPDK_BDEV_QOS_MIN_IOS_PER_SEC		1000
 #define SPDK_BDEV_QOS_MIN_BYTES_PER_SEC		(1024 * 1024)
 #define SPDK_BDEV_QOS_LIMIT_NOT_DEFINED		UINT64_MAX
+#define SPDK_BDEV_QOS_LATENCY_WINDOW_IN_USEC	(100 * 1000)
+#define SPDK_BDEV_QOS_LATENCY_PERCENTILE	99
+#define SPDK_BDEV_QOS_LATENCY_HISTOGRAM_SHIFT	4
+#define SPDK_BDEV_QOS_TOLERANCE_PCT		10
 
 #define SPDK_BDEV_POOL_ALIGNMENT 512
 
+/* Initial number of buckets in the bdev name index. Must be a power of 2. */
+#define SPDK_BDEV_NAME_HASH_MIN_BUCKETS		64
+
 static const char *qos_conf_type[] = {"Limit_IOPS",
 				      "Limit_BPS", "Limit_Read_BPS", "Limit_Write_BPS"
 				     };
@@ -93,11 +108,37 @@ static const char *qos_rpc_type[] = {"rw_ios_per_sec",
 
 TAILQ_HEAD(spdk_bdev_list, spdk_bdev);
 
+/* Entry in the name index. Each registered bdev has one entry for its
+ * name and one for each of its aliases. The name string is not owned
+ * by the entry.
+ */
+struct spdk_bdev_name {
+	const char			*name;
+	struct spdk_bdev		*bdev;
+	TAILQ_ENTRY(spdk_bdev_name)	link;
+};
+
+TAILQ_HEAD(spdk_bdev_name_list, spdk_bdev_name);
+
+struct spdk_bdev_name_index {
+	struct spdk_bdev_name_list	*buckets;
+	uint32_t			num_buckets;
+	uint32_t			count;
+	pthread_mutex_t			mutex;
+};
+
 struct spdk_bdev_mgr {
-	struct spdk_mempool *bdev_io_pool;
+	/*
+	 * bdev_io pools indexed by NUMA socket. If all cores are on one socket,
+	 *  there is a single pool which is not bound to any socket.
+	 */
+	struct spdk_mempool *bdev_io_pools[SPDK_BDEV_IO_POOL_MAX_SOCKETS];
+	uint32_t bdev_io_pool_sizes[SPDK_BDEV_IO_POOL_MAX_SOCKETS];
 
-	struct spdk_mempool *buf_small_pool;
-	struct spdk_mempool *buf_large_pool;
+	/* Data buffer pools, one per size class. */
+	struct spdk_mempool *buf_pools[SPDK_BDEV_NUM_BUF_CLASSES];
+	uint32_t buf_pool_sizes[SPDK_BDEV_NUM_BUF_CLASSES];
+	uint32_t buf_cache_sizes[SPDK_BDEV_NUM_BUF_CLASSES];
 
 	void *zero_buffer;
 
@@ -105,6 +146,9 @@ struct spdk_bdev_mgr {
 
 	struct spdk_bdev_list bdevs;
 
+	/* Hashed index of names and aliases of all registered bdevs. */
+	struct spdk_bdev_name_index names;
+
 	bool init_complete;
 	bool module_init_complete;
 
@@ -118,6 +162,7 @@ struct spdk_bdev_mgr {
 static struct spdk_bdev_mgr g_bdev_mgr = {
 	.bdev_modules = TAILQ_HEAD_INITIALIZER(g_bdev_mgr.bdev_modules),
 	.bdevs = TAILQ_HEAD_INITIALIZER(g_bdev_mgr.bdevs),
+	.names.mutex = PTHREAD_MUTEX_INITIALIZER,
 	.init_complete = false,
 	.module_init_complete = false,
 	.mutex = PTHREAD_MUTEX_INITIALIZER,
@@ -127,6 +172,24 @@ static struct spdk_bdev_mgr g_bdev_mgr = {
 static struct spdk_bdev_opts	g_bdev_opts = {
 	.bdev_io_pool_size = SPDK_BDEV_IO_POOL_SIZE,
 	.bdev_io_cache_size = SPDK_BDEV_IO_CACHE_SIZE,
+	.tiny_buf_pool_size = BUF_TINY_POOL_SIZE,
+	.small_buf_pool_size = BUF_SMALL_POOL_SIZE,
+	.large_buf_pool_size = BUF_LARGE_POOL_SIZE,
+	.huge_buf_pool_size = BUF_HUGE_POOL_SIZE,
+	.qos_distributed = false,
+	.qos_tolerance_pct = SPDK_BDEV_QOS_TOLERANCE_PCT,
+};
+
+/* Maximum data size of the buffers in each class, in ascending order. */
+static const uint32_t g_bdev_buf_class_size[SPDK_BDEV_NUM_BUF_CLASSES] = {
+	SPDK_BDEV_TINY_BUF_MAX_SIZE,
+	SPDK_BDEV_SMALL_BUF_MAX_SIZE,
+	SPDK_BDEV_LARGE_BUF_MAX_SIZE,
+	SPDK_BDEV_HUGE_BUF_MAX_SIZE,
+};
+
+static const char *g_bdev_buf_class_name[SPDK_BDEV_NUM_BUF_CLASSES] = {
+	"tiny", "small", "large", "huge"
 };
 
 static spdk_bdev_init_cb	g_init_cb_fn = NULL;
@@ -153,6 +216,9 @@ struct spdk_bdev_qos_limit {
 	/** Maximum allowed IOs or bytes to be issued in one timeslice (e.g., 1ms). */
 	uint32_t max_per_timeslice;
 
+	/** IOs or bytes a channel takes from the shared budget at once with distributed QoS. */
+	uint32_t batch;
+
 	/** Function to check whether to queue the IO. */
 	bool (*queue_io)(const struct spdk_bdev_qos_limit *limit, struct spdk_bdev_io *io);
 
@@ -160,11 +226,51 @@ struct spdk_bdev_qos_limit {
 	void (*update_quota)(struct spdk_bdev_qos_limit *limit, struct spdk_bdev_io *io);
 };
 
+struct spdk_bdev_qos_latency {
+	/** Target p99 latency of high priority I/O in microseconds, 0 if none is set. */
+	uint64_t target_usec;
+
+	/** Latencies of high priority I/O completed in the current window. */
+	struct spdk_histogram_data *histogram;
+
+	/** Queue of low priority I/O waiting to be issued. */
+	bdev_io_tailq_t queued;
+
+	/** Low priority IOs allowed per second, 0 if low priority I/O is not throttled. */
+	uint64_t limit;
+
+	/** Remaining low priority IOs allowed in current timeslice. */
+	int64_t remaining_this_timeslice;
+
+	/** Maximum low priority IOs allowed in one timeslice, 0 if not throttled. */
+	uint32_t max_per_timeslice;
+
+	/** Number of low priority IOs issued in the current window. */
+	uint64_t window_ios;
+
+	/** Timestamp of start of current window. */
+	uint64_t window_start;
+
+	/** Statistics, updated with bdev->internal.mutex held at the end of each window. */
+	struct spdk_bdev_qos_latency_stat stat;
+};
+
 struct spdk_bdev_qos {
 	/** Types of structure of rate limits. */
 	struct spdk_bdev_qos_limit rate_limits[SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES];
 
-	/** The channel that all I/O are funneled through. */
+	/** Latency target controller. */
+	struct spdk_bdev_qos_latency latency;
+
+	/**
+	 * True if each channel enforces the rate limits on its own I/O. The
+	 *  remaining_this_timeslice member of each rate limit is then a budget
+	 *  shared by all channels, which take quota from it in batches with
+	 *  atomic operations. Only the refill each timeslice is done by the poller.
+	 */
+	bool distributed;
+
+	/** The channel that all I/O are funneled through, or the poller's channel if distributed. */
 	struct spdk_bdev_channel *ch;
 
 	/** The thread on which the poller is running. */
@@ -183,9 +289,31 @@ struct spdk_bdev_qos {
 	struct spdk_poller *poller;
 };
 
+/* Free data buffers held in a per-thread cache are linked through their own memory. */
+struct spdk_bdev_buf {
+	STAILQ_ENTRY(spdk_bdev_buf) link;
+};
+
+struct spdk_bdev_buf_cache {
+	STAILQ_HEAD(, spdk_bdev_buf)	bufs;
+	uint32_t			count;
+
+	/* I/O waiting for a buffer of this class. */
+	bdev_io_stailq_t		need_buf;
+
+	struct spdk_bdev_buf_cache_stat	stat;
+};
+
 struct spdk_bdev_mgmt_channel {
-	bdev_io_stailq_t need_buf_small;
-	bdev_io_stailq_t need_buf_large;
+	/*
+	 * Each thread keeps a cache of data buffers for every size class.  It is
+	 *  refilled from and drained to the global pools in batches, so that the
+	 *  pools are only touched once every BUF_CACHE_BATCH buffers.
+	 */
+	struct spdk_bdev_buf_cache buf_cache[SPDK_BDEV_NUM_BUF_CLASSES];
+
+	/* Retries I/O waiting for buffers that were returned to the pools by other threads. */
+	struct spdk_poller *buf_retry_poller;
 
 	/*
 	 * Each thread keeps a cache of bdev_io - this allows
@@ -193,10 +321,23 @@ struct spdk_bdev_mgmt_channel {
 	 *  benefit from a per-thread bdev_io cache.  Without
 	 *  this, non-DPDK threads fetching from the mempool
 	 *  incur a cmpxchg on get and put.
+	 *
+	 * The cache never holds less than the bdev_io_cache_size
+	 *  option, but grows up to SPDK_BDEV_IO_CACHE_MAX_GROWTH
+	 *  times that to fit the peak number of outstanding
+	 *  bdev_io seen by this thread, and shrinks back when
+	 *  the load goes away.  It is refilled in batches from
+	 *  the pool on the local NUMA socket.
 	 */
 	bdev_io_stailq_t per_thread_cache;
 	uint32_t	per_thread_cache_count;
 	uint32_t	bdev_io_cache_size;
+	uint32_t	outstanding_io_count;
+	uint32_t	peak_outstanding_io_count;
+	struct spdk_mempool *bdev_io_pool;
+	uint32_t	socket_id;
+	struct spdk_poller *cache_adjust_poller;
+	struct spdk_bdev_io_cache_stat cache_stat;
 
 	TAILQ_HEAD(, spdk_bdev_shared_resource)	shared_resources;
 	TAILQ_HEAD(, spdk_bdev_io_wait_entry)	io_wait_queue;
@@ -239,6 +380,7 @@ struct spdk_bdev_shared_resource {
 
 #define BDEV_CH_RESET_IN_PROGRESS	(1 << 0)
 #define BDEV_CH_QOS_ENABLED		(1 << 1)
+#define BDEV_CH_QOS_DISTRIBUTED		(1 << 2)
 
 struct spdk_bdev_channel {
 	struct spdk_bdev	*bdev;
@@ -261,6 +403,15 @@ struct spdk_bdev_channel {
 
 	uint32_t		flags;
 
+	/*
+	 * Distributed QoS: quota taken from the shared budget of each rate limit
+	 *  that this channel has not used yet, and the I/O waiting for more.
+	 *  Only remaining_this_timeslice and max_per_timeslice of each limit are used.
+	 */
+	struct spdk_bdev_qos_limit qos_local[SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES];
+	bdev_io_tailq_t		qos_queued;
+	struct spdk_poller	*qos_poller;
+
 	struct spdk_histogram_data *histogram;
 
 #ifdef SPDK_CONFIG_VTUNE
@@ -285,6 +436,8 @@ struct spdk_bdev_desc {
 	}				callback;
 	bool				closed;
 	bool				write;
+	uint32_t			id;
+	enum spdk_bdev_qos_priority	qos_priority;
 	pthread_mutex_t			mutex;
 	uint32_t			refs;
 	TAILQ_ENTRY(spdk_bdev_desc)	link;
@@ -347,7 +500,31 @@ spdk_bdev_set_opts(struct spdk_bdev_opts *opts)
 		return -1;
 	}
 
+	if (opts->qos_tolerance_pct > 100) {
+		SPDK_ERRLOG("qos_tolerance_pct %" PRIu32 " is larger than 100\n", opts->qos_tolerance_pct);
+		return -1;
+	}
+
 	g_bdev_opts = *opts;
+
+	if (g_bdev_opts.qos_tolerance_pct == 0) {
+		g_bdev_opts.qos_tolerance_pct = SPDK_BDEV_QOS_TOLERANCE_PCT;
+	}
+
+	/* A buffer pool size of 0 selects the default. */
+	if (g_bdev_opts.tiny_buf_pool_size == 0) {
+		g_bdev_opts.tiny_buf_pool_size = BUF_TINY_POOL_SIZE;
+	}
+	if (g_bdev_opts.small_buf_pool_size == 0) {
+		g_bdev_opts.small_buf_pool_size = BUF_SMALL_POOL_SIZE;
+	}
+	if (g_bdev_opts.large_buf_pool_size == 0) {
+		g_bdev_opts.large_buf_pool_size = BUF_LARGE_POOL_SIZE;
+	}
+	if (g_bdev_opts.huge_buf_pool_size == 0) {
+		g_bdev_opts.huge_buf_pool_size = BUF_HUGE_POOL_SIZE;
+	}
+
 	return 0;
 }
 
@@ -419,27 +596,157 @@ spdk_bdev_next_leaf(struct spdk_bdev *prev)
 	return bdev;
 }
 
-struct spdk_bdev *
-spdk_bdev_get_by_name(const char *bdev_name)
+static uint32_t
+_spdk_bdev_name_hash(const char *name)
 {
-	struct spdk_bdev_alias *tmp;
-	struct spdk_bdev *bdev = spdk_bdev_first();
+	uint32_t hash = 2166136261u;
 
-	while (bdev != NULL) {
-		if (strcmp(bdev_name, bdev->name) == 0) {
-			return bdev;
+	/* 32-bit FNV-1a */
+	while (*name != '\0') {
+		hash ^= (uint8_t)*name++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static struct spdk_bdev_name *
+_spdk_bdev_name_find(const char *name, uint32_t hash)
+{
+	struct spdk_bdev_name_index *names = &g_bdev_mgr.names;
+	struct spdk_bdev_name *entry;
+
+	if (names->buckets == NULL) {
+		return NULL;
+	}
+
+	TAILQ_FOREACH(entry, &names->buckets[hash & (names->num_buckets - 1)], link) {
+		if (strcmp(name, entry->name) == 0) {
+			return entry;
 		}
+	}
 
-		TAILQ_FOREACH(tmp, &bdev->aliases, tailq) {
-			if (strcmp(bdev_name, tmp->alias) == 0) {
-				return bdev;
-			}
+	return NULL;
+}
+
+static int
+_spdk_bdev_name_index_resize(uint32_t num_buckets)
+{
+	struct spdk_bdev_name_index *names = &g_bdev_mgr.names;
+	struct spdk_bdev_name_list *buckets;
+	struct spdk_bdev_name *entry;
+	uint32_t i;
+
+	buckets = calloc(num_buckets, sizeof(*buckets));
+	if (buckets == NULL) {
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < num_buckets; i++) {
+		TAILQ_INIT(&buckets[i]);
+	}
+
+	for (i = 0; i < names->num_buckets; i++) {
+		while ((entry = TAILQ_FIRST(&names->buckets[i])) != NULL) {
+			TAILQ_REMOVE(&names->buckets[i], entry, link);
+			TAILQ_INSERT_TAIL(&buckets[_spdk_bdev_name_hash(entry->name) & (num_buckets - 1)],
+					  entry, link);
 		}
+	}
 
-		bdev = spdk_bdev_next(bdev);
+	free(names->buckets);
+	names->buckets = buckets;
+	names->num_buckets = num_buckets;
+
+	return 0;
+}
+
+static int
+spdk_bdev_name_add(const char *name, struct spdk_bdev *bdev)
+{
+	struct spdk_bdev_name_index *names = &g_bdev_mgr.names;
+	struct spdk_bdev_name *entry;
+	uint32_t hash = _spdk_bdev_name_hash(name);
+	int rc = 0;
+
+	pthread_mutex_lock(&names->mutex);
+
+	if (_spdk_bdev_name_find(name, hash) != NULL) {
+		rc = -EEXIST;
+		goto end;
 	}
 
-	return NULL;
+	/* Keep the average chain length at most 2. A failure to grow only makes
+	 * lookups slower, so it is not fatal once the index exists.
+	 */
+	if (names->buckets == NULL) {
+		rc = _spdk_bdev_name_index_resize(SPDK_BDEV_NAME_HASH_MIN_BUCKETS);
+		if (rc != 0) {
+			goto end;
+		}
+	} else if (names->count >= names->num_buckets * 2) {
+		_spdk_bdev_name_index_resize(names->num_buckets * 2);
+	}
+
+	entry = calloc(1, sizeof(*entry));
+	if (entry == NULL) {
+		rc = -ENOMEM;
+		goto end;
+	}
+
+	entry->name = name;
+	entry->bdev = bdev;
+	TAILQ_INSERT_TAIL(&names->buckets[hash & (names->num_buckets - 1)], entry, link);
+	names->count++;
+
+end:
+	pthread_mutex_unlock(&names->mutex);
+	return rc;
+}
+
+/* Removes name from the index only if it refers to the given bdev. */
+static void
+spdk_bdev_name_del(const char *name, struct spdk_bdev *bdev)
+{
+	struct spdk_bdev_name_index *names = &g_bdev_mgr.names;
+	struct spdk_bdev_name *entry;
+	uint32_t hash = _spdk_bdev_name_hash(name);
+
+	pthread_mutex_lock(&names->mutex);
+
+	entry = _spdk_bdev_name_find(name, hash);
+	if (entry == NULL || entry->bdev != bdev) {
+		pthread_mutex_unlock(&names->mutex);
+		return;
+	}
+
+	TAILQ_REMOVE(&names->buckets[hash & (names->num_buckets - 1)], entry, link);
+	free(entry);
+
+	if (--names->count == 0) {
+		free(names->buckets);
+		names->buckets = NULL;
+		names->num_buckets = 0;
+	}
+
+	pthread_mutex_unlock(&names->mutex);
+}
+
+struct spdk_bdev *
+spdk_bdev_get_by_name(const char *bdev_name)
+{
+	struct spdk_bdev_name_index *names = &g_bdev_mgr.names;
+	struct spdk_bdev_name *entry;
+	struct spdk_bdev *bdev = NULL;
+
+	pthread_mutex_lock(&names->mutex);
+	entry = _spdk_bdev_name_find(bdev_name, _spdk_bdev_name_hash(bdev_name));
+	if (entry != NULL) {
+		bdev = entry->bdev;
+	}
+	pthread_mutex_unlock(&names->mutex);
+
+	return bdev;
 }
 
 void
@@ -592,15 +899,86 @@ _bdev_io_set_buf(struct spdk_bdev_io *bdev_io, void *buf, uint64_t len)
 	bdev_io->internal.get_buf_cb(spdk_bdev_io_get_io_channel(bdev_io), bdev_io, true);
 }
 
+/*
+ * Returns the smallest buffer class that fits len bytes of data plus the
+ *  alignment slack and separate metadata, or SPDK_BDEV_NUM_BUF_CLASSES if
+ *  none of them does.
+ */
+static uint32_t
+_bdev_buf_class(uint64_t len)
+{
+	uint32_t i;
+
+	for (i = 0; i < SPDK_BDEV_NUM_BUF_CLASSES; i++) {
+		if (len <= SPDK_BDEV_BUF_SIZE_WITH_MD(g_bdev_buf_class_size[i]) + SPDK_BDEV_POOL_ALIGNMENT) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+static void *
+_bdev_buf_cache_get(struct spdk_bdev_mgmt_channel *ch, uint32_t buf_class)
+{
+	struct spdk_bdev_buf_cache *cache = &ch->buf_cache[buf_class];
+	struct spdk_mempool *pool = g_bdev_mgr.buf_pools[buf_class];
+	void *bufs[BUF_CACHE_BATCH];
+	struct spdk_bdev_buf *buf;
+	uint32_t count, i;
+
+	buf = STAILQ_FIRST(&cache->bufs);
+	if (spdk_likely(buf != NULL)) {
+		STAILQ_REMOVE_HEAD(&cache->bufs, link);
+		cache->count--;
+		cache->stat.hits++;
+		return buf;
+	}
+
+	cache->stat.misses++;
+
+	count = spdk_min(BUF_CACHE_BATCH, g_bdev_mgr.buf_cache_sizes[buf_class] + 1);
+	if (spdk_mempool_get_bulk(pool, bufs, count) != 0) {
+		return spdk_mempool_get(pool);
+	}
+
+	for (i = 1; i < count; i++) {
+		buf = bufs[i];
+		STAILQ_INSERT_HEAD(&cache->bufs, buf, link);
+		cache->count++;
+	}
+
+	return bufs[0];
+}
+
+static void
+_bdev_buf_cache_release(struct spdk_bdev_mgmt_channel *ch, uint32_t buf_class, uint32_t count)
+{
+	struct spdk_bdev_buf_cache *cache = &ch->buf_cache[buf_class];
+	void *bufs[BUF_CACHE_BATCH];
+	uint32_t i;
+
+	while (count > 0 && cache->count > 0) {
+		for (i = 0; i < spdk_min(count, BUF_CACHE_BATCH) && !STAILQ_EMPTY(&cache->bufs); i++) {
+			bufs[i] = STAILQ_FIRST(&cache->bufs);
+			STAILQ_REMOVE_HEAD(&cache->bufs, link);
+			cache->count--;
+		}
+
+		spdk_mempool_put_bulk(g_bdev_mgr.buf_pools[buf_class], bufs, i);
+		count -= i;
+	}
+}
+
 static void
 spdk_bdev_io_put_buf(struct spdk_bdev_io *bdev_io)
 {
 	struct spdk_bdev *bdev = bdev_io->bdev;
-	struct spdk_mempool *pool;
+	struct spdk_bdev_buf_cache *cache;
 	struct spdk_bdev_io *tmp;
-	bdev_io_stailq_t *stailq;
 	struct spdk_bdev_mgmt_channel *ch;
 	uint64_t buf_len, md_len, alignment;
+	uint32_t buf_class;
 	void *buf;
 
 	buf = bdev_io->internal.buf;
@@ -611,20 +989,21 @@ spdk_bdev_io_put_buf(struct spdk_bdev_io *bdev_io)
 
 	bdev_io->internal.buf = NULL;
 
-	if (buf_len + alignment + md_len <= SPDK_BDEV_BUF_SIZE_WITH_MD(SPDK_BDEV_SMALL_BUF_MAX_SIZE) +
-	    SPDK_BDEV_POOL_ALIGNMENT) {
-		pool = g_bdev_mgr.buf_small_pool;
-		stailq = &ch->need_buf_small;
-	} else {
-		pool = g_bdev_mgr.buf_large_pool;
-		stailq = &ch->need_buf_large;
-	}
-
-	if (STAILQ_EMPTY(stailq)) {
-		spdk_mempool_put(pool, buf);
+	buf_class = _bdev_buf_class(buf_len + alignment + md_len);
+	assert(buf_class < SPDK_BDEV_NUM_BUF_CLASSES);
+	cache = &ch->buf_cache[buf_class];
+
+	if (STAILQ_EMPTY(&cache->need_buf)) {
+		STAILQ_INSERT_HEAD(&cache->bufs, (struct spdk_bdev_buf *)buf, link);
+		if (++cache->count > g_bdev_mgr.buf_cache_sizes[buf_class]) {
+			/* Drain at most a batch, and never below half of the cache size. */
+			_bdev_buf_cache_release(ch, buf_class,
+						spdk_min(BUF_CACHE_BATCH,
+							 cache->count - g_bdev_mgr.buf_cache_sizes[buf_class] / 2));
+		}
 	} else {
-		tmp = STAILQ_FIRST(stailq);
-		STAILQ_REMOVE_HEAD(stailq, internal.buf_link);
+		tmp = STAILQ_FIRST(&cache->need_buf);
+		STAILQ_REMOVE_HEAD(&cache->need_buf, internal.buf_link);
 		_bdev_io_set_buf(tmp, buf, tmp->internal.buf_len);
 	}
 }
@@ -669,14 +1048,55 @@ _bdev_io_unset_bounce_buf(struct spdk_bdev_io *bdev_io)
 	spdk_bdev_io_put_buf(bdev_io);
 }
 
+/*
+ * I/O waiting for a buffer is normally resumed when another I/O on the same
+ *  thread returns one.  This poller also hands out buffers that were returned
+ *  to the global pools by other threads, so a thread with no buffers of its
+ *  own in flight cannot be starved.
+ */
+static int
+spdk_bdev_buf_retry(void *ctx)
+{
+	struct spdk_bdev_mgmt_channel *ch = ctx;
+	struct spdk_bdev_buf_cache *cache;
+	struct spdk_bdev_io *bdev_io;
+	bool waiting = false;
+	uint32_t i;
+	int count = 0;
+	void *buf;
+
+	for (i = 0; i < SPDK_BDEV_NUM_BUF_CLASSES; i++) {
+		cache = &ch->buf_cache[i];
+
+		while (!STAILQ_EMPTY(&cache->need_buf)) {
+			buf = spdk_mempool_get(g_bdev_mgr.buf_pools[i]);
+			if (buf == NULL) {
+				waiting = true;
+				break;
+			}
+
+			bdev_io = STAILQ_FIRST(&cache->need_buf);
+			STAILQ_REMOVE_HEAD(&cache->need_buf, internal.buf_link);
+			_bdev_io_set_buf(bdev_io, buf, bdev_io->internal.buf_len);
+			count++;
+		}
+	}
+
+	if (!waiting) {
+		spdk_poller_unregister(&ch->buf_retry_poller);
+	}
+
+	return count;
+}
+
 void
 spdk_bdev_io_get_buf(struct spdk_bdev_io *bdev_io, spdk_bdev_io_get_buf_cb cb, uint64_t len)
 {
 	struct spdk_bdev *bdev = bdev_io->bdev;
-	struct spdk_mempool *pool;
-	bdev_io_stailq_t *stailq;
+	struct spdk_bdev_buf_cache *cache;
 	struct spdk_bdev_mgmt_channel *mgmt_ch;
 	uint64_t alignment, md_len;
+	uint32_t buf_class;
 	void *buf;
 
 	assert(cb != NULL);
@@ -691,8 +1111,8 @@ spdk_bdev_io_get_buf(struct spdk_bdev_io *bdev_io, spdk_bdev_io_get_buf_cb cb, u
 		return;
 	}
 
-	if (len + alignment + md_len > SPDK_BDEV_BUF_SIZE_WITH_MD(SPDK_BDEV_LARGE_BUF_MAX_SIZE) +
-	    SPDK_BDEV_POOL_ALIGNMENT) {
+	buf_class = _bdev_buf_class(len + alignment + md_len);
+	if (buf_class == SPDK_BDEV_NUM_BUF_CLASSES) {
 		SPDK_ERRLOG("Length + alignment %" PRIu64 " is larger than allowed\n",
 			    len + alignment);
 		cb(spdk_bdev_io_get_io_channel(bdev_io), bdev_io, false);
@@ -700,22 +1120,20 @@ spdk_bdev_io_get_buf(struct spdk_bdev_io *bdev_io, spdk_bdev_io_get_buf_cb cb, u
 	}
 
 	mgmt_ch = bdev_io->internal.ch->shared_resource->mgmt_ch;
+	cache = &mgmt_ch->buf_cache[buf_class];
 
 	bdev_io->internal.buf_len = len;
 	bdev_io->internal.get_buf_cb = cb;
 
-	if (len + alignment + md_len <= SPDK_BDEV_BUF_SIZE_WITH_MD(SPDK_BDEV_SMALL_BUF_MAX_SIZE) +
-	    SPDK_BDEV_POOL_ALIGNMENT) {
-		pool = g_bdev_mgr.buf_small_pool;
-		stailq = &mgmt_ch->need_buf_small;
-	} else {
-		pool = g_bdev_mgr.buf_large_pool;
-		stailq = &mgmt_ch->need_buf_large;
-	}
-
-	buf = spdk_mempool_get(pool);
+	/* Don't let this I/O jump ahead of the ones already waiting. */
+	buf = STAILQ_EMPTY(&cache->need_buf) ? _bdev_buf_cache_get(mgmt_ch, buf_class) : NULL;
 	if (!buf) {
-		STAILQ_INSERT_TAIL(stailq, bdev_io, internal.buf_link);
+		cache->stat.waits++;
+		STAILQ_INSERT_TAIL(&cache->need_buf, bdev_io, internal.buf_link);
+		if (mgmt_ch->buf_retry_poller == NULL) {
+			mgmt_ch->buf_retry_poller = SPDK_POLLER_REGISTER(spdk_bdev_buf_retry, mgmt_ch,
+						    BUF_RETRY_PERIOD_USEC);
+		}
 	} else {
 		_bdev_io_set_buf(bdev_io, buf, len);
 	}
@@ -759,8 +1177,29 @@ spdk_bdev_qos_config_json(struct spdk_bdev *bdev, struct spdk_json_write_ctx *w)
 		return;
 	}
 
+	if (qos->latency.target_usec != 0) {
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_string(w, "method", "bdev_set_qos_latency_target");
+
+		spdk_json_write_named_object_begin(w, "params");
+		spdk_json_write_named_string(w, "name", bdev->name);
+		spdk_json_write_named_uint64(w, "latency_target_usec", qos->latency.target_usec);
+		spdk_json_write_object_end(w);
+
+		spdk_json_write_object_end(w);
+	}
+
 	spdk_bdev_get_qos_rate_limits(bdev, limits);
 
+	for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
+		if (limits[i] > 0) {
+			break;
+		}
+	}
+	if (i == SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES) {
+		return;
+	}
+
 	spdk_json_write_object_begin(w);
 	spdk_json_write_named_string(w, "method", "bdev_set_qos_limit");
 
@@ -791,6 +1230,12 @@ spdk_bdev_subsystem_config_json(struct spdk_json_write_ctx *w)
 	spdk_json_write_named_object_begin(w, "params");
 	spdk_json_write_named_uint32(w, "bdev_io_pool_size", g_bdev_opts.bdev_io_pool_size);
 	spdk_json_write_named_uint32(w, "bdev_io_cache_size", g_bdev_opts.bdev_io_cache_size);
+	spdk_json_write_named_uint32(w, "tiny_buf_pool_size", g_bdev_opts.tiny_buf_pool_size);
+	spdk_json_write_named_uint32(w, "small_buf_pool_size", g_bdev_opts.small_buf_pool_size);
+	spdk_json_write_named_uint32(w, "large_buf_pool_size", g_bdev_opts.large_buf_pool_size);
+	spdk_json_write_named_uint32(w, "huge_buf_pool_size", g_bdev_opts.huge_buf_pool_size);
+	spdk_json_write_named_bool(w, "qos_distributed", g_bdev_opts.qos_distributed);
+	spdk_json_write_named_uint32(w, "qos_tolerance_pct", g_bdev_opts.qos_tolerance_pct);
 	spdk_json_write_object_end(w);
 	spdk_json_write_object_end(w);
 
@@ -815,6 +1260,123 @@ spdk_bdev_subsystem_config_json(struct spdk_json_write_ctx *w)
 	spdk_json_write_array_end(w);
 }
 
+static struct spdk_mempool *
+_spdk_bdev_io_pool_get_local(uint32_t socket_id)
+{
+	uint32_t i;
+
+	if (socket_id < SPDK_BDEV_IO_POOL_MAX_SOCKETS && g_bdev_mgr.bdev_io_pools[socket_id] != NULL) {
+		return g_bdev_mgr.bdev_io_pools[socket_id];
+	}
+
+	for (i = 0; i < SPDK_BDEV_IO_POOL_MAX_SOCKETS; i++) {
+		if (g_bdev_mgr.bdev_io_pools[i] != NULL) {
+			return g_bdev_mgr.bdev_io_pools[i];
+		}
+	}
+
+	return NULL;
+}
+
+static uint32_t
+_spdk_bdev_io_pool_get(struct spdk_mempool *pool, struct spdk_bdev_io **bdev_ios, uint32_t count)
+{
+	uint32_t i;
+
+	if (spdk_mempool_get_bulk(pool, (void **)bdev_ios, count) != 0) {
+		/* Not enough left for a whole batch, settle for a single one. */
+		if (count == 1 || (bdev_ios[0] = spdk_mempool_get(pool)) == NULL) {
+			return 0;
+		}
+		count = 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		bdev_ios[i]->internal.pool = pool;
+	}
+
+	return count;
+}
+
+/*
+ * Get up to count bdev_ios from the pool on the local socket, falling back to
+ *  the pools on other sockets only if the local one is empty.  Returns the
+ *  number of bdev_ios obtained.
+ */
+static uint32_t
+_spdk_bdev_io_pool_get_bulk(struct spdk_bdev_mgmt_channel *ch, struct spdk_bdev_io **bdev_ios,
+			    uint32_t count)
+{
+	struct spdk_mempool *pool;
+	uint32_t got, socket;
+
+	got = _spdk_bdev_io_pool_get(ch->bdev_io_pool, bdev_ios, count);
+	if (spdk_likely(got > 0)) {
+		return got;
+	}
+
+	for (socket = 0; socket < SPDK_BDEV_IO_POOL_MAX_SOCKETS; socket++) {
+		pool = g_bdev_mgr.bdev_io_pools[socket];
+		if (pool == NULL || pool == ch->bdev_io_pool) {
+			continue;
+		}
+
+		got = _spdk_bdev_io_pool_get(pool, bdev_ios, count);
+		if (got > 0) {
+			ch->cache_stat.remote_refills++;
+			return got;
+		}
+	}
+
+	return 0;
+}
+
+static void
+_spdk_bdev_io_cache_release(struct spdk_bdev_mgmt_channel *ch, uint32_t count)
+{
+	struct spdk_bdev_io *bdev_io;
+
+	while (count-- > 0 && !STAILQ_EMPTY(&ch->per_thread_cache)) {
+		bdev_io = STAILQ_FIRST(&ch->per_thread_cache);
+		STAILQ_REMOVE_HEAD(&ch->per_thread_cache, internal.buf_link);
+		ch->per_thread_cache_count--;
+		spdk_mempool_put(bdev_io->internal.pool, (void *)bdev_io);
+	}
+}
+
+static int
+spdk_bdev_io_cache_adjust(void *ctx)
+{
+	struct spdk_bdev_mgmt_channel *ch = ctx;
+	uint32_t min_size = g_bdev_opts.bdev_io_cache_size;
+	uint32_t max_size = min_size * SPDK_BDEV_IO_CACHE_MAX_GROWTH;
+	uint32_t target;
+	int rc = 0;
+
+	/*
+	 * Size the cache so that it can take back every bdev_io that was outstanding
+	 *  at the peak of the last period.  Grow right away, but only shrink halfway
+	 *  towards the target each period so short lulls do not flush the cache.
+	 */
+	target = spdk_max(spdk_min(ch->peak_outstanding_io_count, max_size), min_size);
+	if (target > ch->bdev_io_cache_size) {
+		ch->bdev_io_cache_size = target;
+		ch->cache_stat.grows++;
+		rc = 1;
+	} else if (target < ch->bdev_io_cache_size) {
+		ch->bdev_io_cache_size -= (ch->bdev_io_cache_size - target + 1) / 2;
+		ch->cache_stat.shrinks++;
+		if (ch->per_thread_cache_count > ch->bdev_io_cache_size) {
+			_spdk_bdev_io_cache_release(ch, ch->per_thread_cache_count - ch->bdev_io_cache_size);
+		}
+		rc = 1;
+	}
+
+	ch->peak_outstanding_io_count = ch->outstanding_io_count;
+
+	return rc;
+}
+
 static int
 spdk_bdev_mgmt_channel_create(void *io_device, void *ctx_buf)
 {
@@ -822,17 +1384,29 @@ spdk_bdev_mgmt_channel_create(void *io_device, void *ctx_buf)
 	struct spdk_bdev_io *bdev_io;
 	uint32_t i;
 
-	STAILQ_INIT(&ch->need_buf_small);
-	STAILQ_INIT(&ch->need_buf_large);
+	for (i = 0; i < SPDK_BDEV_NUM_BUF_CLASSES; i++) {
+		STAILQ_INIT(&ch->buf_cache[i].bufs);
+		ch->buf_cache[i].count = 0;
+		STAILQ_INIT(&ch->buf_cache[i].need_buf);
+		memset(&ch->buf_cache[i].stat, 0, sizeof(ch->buf_cache[i].stat));
+	}
+	ch->buf_retry_poller = NULL;
 
 	STAILQ_INIT(&ch->per_thread_cache);
 	ch->bdev_io_cache_size = g_bdev_opts.bdev_io_cache_size;
+	ch->outstanding_io_count = 0;
+	ch->peak_outstanding_io_count = 0;
+	memset(&ch->cache_stat, 0, sizeof(ch->cache_stat));
+	ch->socket_id = spdk_env_get_socket_id(spdk_env_get_current_core());
+	ch->bdev_io_pool = _spdk_bdev_io_pool_get_local(ch->socket_id);
 
 	/* Pre-populate bdev_io cache to ensure this thread cannot be starved. */
 	ch->per_thread_cache_count = 0;
 	for (i = 0; i < ch->bdev_io_cache_size; i++) {
-		bdev_io = spdk_mempool_get(g_bdev_mgr.bdev_io_pool);
-		assert(bdev_io != NULL);
+		if (_spdk_bdev_io_pool_get_bulk(ch, &bdev_io, 1) == 0) {
+			assert(false);
+			break;
+		}
 		ch->per_thread_cache_count++;
 		STAILQ_INSERT_HEAD(&ch->per_thread_cache, bdev_io, internal.buf_link);
 	}
@@ -840,6 +1414,9 @@ spdk_bdev_mgmt_channel_create(void *io_device, void *ctx_buf)
 	TAILQ_INIT(&ch->shared_resources);
 	TAILQ_INIT(&ch->io_wait_queue);
 
+	ch->cache_adjust_poller = SPDK_POLLER_REGISTER(spdk_bdev_io_cache_adjust, ch,
+				  SPDK_BDEV_IO_CACHE_ADJUST_PERIOD_USEC);
+
 	return 0;
 }
 
@@ -847,22 +1424,26 @@ static void
 spdk_bdev_mgmt_channel_destroy(void *io_device, void *ctx_buf)
 {
 	struct spdk_bdev_mgmt_channel *ch = ctx_buf;
-	struct spdk_bdev_io *bdev_io;
+	uint32_t i;
+
+	for (i = 0; i < SPDK_BDEV_NUM_BUF_CLASSES; i++) {
+		if (!STAILQ_EMPTY(&ch->buf_cache[i].need_buf)) {
+			SPDK_ERRLOG("Pending I/O list wasn't empty on mgmt channel free\n");
+		}
 
-	if (!STAILQ_EMPTY(&ch->need_buf_small) || !STAILQ_EMPTY(&ch->need_buf_large)) {
-		SPDK_ERRLOG("Pending I/O list wasn't empty on mgmt channel free\n");
+		_bdev_buf_cache_release(ch, i, ch->buf_cache[i].count);
+		assert(ch->buf_cache[i].count == 0);
 	}
 
+	spdk_poller_unregister(&ch->buf_retry_poller);
+
 	if (!TAILQ_EMPTY(&ch->shared_resources)) {
 		SPDK_ERRLOG("Module channel list wasn't empty on mgmt channel free\n");
 	}
 
-	while (!STAILQ_EMPTY(&ch->per_thread_cache)) {
-		bdev_io = STAILQ_FIRST(&ch->per_thread_cache);
-		STAILQ_REMOVE_HEAD(&ch->per_thread_cache, internal.buf_link);
-		ch->per_thread_cache_count--;
-		spdk_mempool_put(g_bdev_mgr.bdev_io_pool, (void *)bdev_io);
-	}
+	spdk_poller_unregister(&ch->cache_adjust_poller);
+
+	_spdk_bdev_io_cache_release(ch, ch->per_thread_cache_count);
 
 	assert(ch->per_thread_cache_count == 0);
 }
@@ -983,15 +1564,106 @@ spdk_bdev_modules_init(void)
 	return 0;
 }
 
+/*
+ * Create one bdev_io pool per NUMA socket that has cores on it, sized in
+ *  proportion to the number of cores on that socket.
+ */
+static int
+spdk_bdev_io_pools_create(void)
+{
+	uint32_t num_cores[SPDK_BDEV_IO_POOL_MAX_SOCKETS] = {};
+	uint32_t core, socket, total_cores = 0, num_sockets = 0;
+	size_t ele_size = sizeof(struct spdk_bdev_io) + spdk_bdev_module_get_max_ctx_size();
+	char mempool_name[32];
+
+	SPDK_ENV_FOREACH_CORE(core) {
+		socket = spdk_env_get_socket_id(core);
+		if (socket >= SPDK_BDEV_IO_POOL_MAX_SOCKETS) {
+			socket = 0;
+		}
+		if (num_cores[socket]++ == 0) {
+			num_sockets++;
+		}
+		total_cores++;
+	}
+
+	if (num_sockets <= 1) {
+		socket = 0;
+		while (socket < SPDK_BDEV_IO_POOL_MAX_SOCKETS - 1 && num_cores[socket] == 0) {
+			socket++;
+		}
+
+		snprintf(mempool_name, sizeof(mempool_name), "bdev_io_%d", getpid());
+		g_bdev_mgr.bdev_io_pool_sizes[socket] = g_bdev_opts.bdev_io_pool_size;
+		g_bdev_mgr.bdev_io_pools[socket] = spdk_mempool_create(mempool_name,
+						   g_bdev_opts.bdev_io_pool_size,
+						   ele_size, 0, SPDK_ENV_SOCKET_ID_ANY);
+
+		return g_bdev_mgr.bdev_io_pools[socket] == NULL ? -ENOMEM : 0;
+	}
+
+	for (socket = 0; socket < SPDK_BDEV_IO_POOL_MAX_SOCKETS; socket++) {
+		if (num_cores[socket] == 0) {
+			continue;
+		}
+
+		snprintf(mempool_name, sizeof(mempool_name), "bdev_io_%d_%u", getpid(), socket);
+		g_bdev_mgr.bdev_io_pool_sizes[socket] = spdk_divide_round_up(
+				(uint64_t)g_bdev_opts.bdev_io_pool_size * num_cores[socket], total_cores);
+		g_bdev_mgr.bdev_io_pools[socket] = spdk_mempool_create(mempool_name,
+						   g_bdev_mgr.bdev_io_pool_sizes[socket],
+						   ele_size, 0, socket);
+		if (g_bdev_mgr.bdev_io_pools[socket] == NULL) {
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+static int
+spdk_bdev_buf_pools_create(void)
+{
+	uint32_t i;
+	char mempool_name[32];
+
+	g_bdev_mgr.buf_pool_sizes[0] = g_bdev_opts.tiny_buf_pool_size;
+	g_bdev_mgr.buf_pool_sizes[1] = g_bdev_opts.small_buf_pool_size;
+	g_bdev_mgr.buf_pool_sizes[2] = g_bdev_opts.large_buf_pool_size;
+	g_bdev_mgr.buf_pool_sizes[3] = g_bdev_opts.huge_buf_pool_size;
+
+	for (i = 0; i < SPDK_BDEV_NUM_BUF_CLASSES; i++) {
+		/**
+		 * Ensure no more than half of the total buffers end up in per-thread caches, by
+		 *   using spdk_thread_get_count() to determine how many caches we need
+		 *   to account for.
+		 */
+		g_bdev_mgr.buf_cache_sizes[i] = g_bdev_mgr.buf_pool_sizes[i] / (2 * spdk_thread_get_count());
+		snprintf(mempool_name, sizeof(mempool_name), "buf_%s_pool_%d", g_bdev_buf_class_name[i],
+			 getpid());
+
+		g_bdev_mgr.buf_pools[i] = spdk_mempool_create(mempool_name,
+					  g_bdev_mgr.buf_pool_sizes[i],
+					  SPDK_BDEV_BUF_SIZE_WITH_MD(g_bdev_buf_class_size[i]) +
+					  SPDK_BDEV_POOL_ALIGNMENT,
+					  0,
+					  SPDK_ENV_SOCKET_ID_ANY);
+		if (!g_bdev_mgr.buf_pools[i]) {
+			SPDK_ERRLOG("create %s buffer pool failed\n", g_bdev_buf_class_name[i]);
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
 void
 spdk_bdev_initialize(spdk_bdev_init_cb cb_fn, void *cb_arg)
 {
 	struct spdk_conf_section *sp;
 	struct spdk_bdev_opts bdev_opts;
 	int32_t bdev_io_pool_size, bdev_io_cache_size;
-	int cache_size;
 	int rc = 0;
-	char mempool_name[32];
 
 	assert(cb_fn != NULL);
 
@@ -1023,52 +1695,13 @@ spdk_bdev_initialize(spdk_bdev_init_cb cb_fn, void *cb_arg)
 	spdk_notify_type_register("bdev_register");
 	spdk_notify_type_register("bdev_unregister");
 
-	snprintf(mempool_name, sizeof(mempool_name), "bdev_io_%d", getpid());
-
-	g_bdev_mgr.bdev_io_pool = spdk_mempool_create(mempool_name,
-				  g_bdev_opts.bdev_io_pool_size,
-				  sizeof(struct spdk_bdev_io) +
-				  spdk_bdev_module_get_max_ctx_size(),
-				  0,
-				  SPDK_ENV_SOCKET_ID_ANY);
-
-	if (g_bdev_mgr.bdev_io_pool == NULL) {
+	if (spdk_bdev_io_pools_create() != 0) {
 		SPDK_ERRLOG("could not allocate spdk_bdev_io pool\n");
 		spdk_bdev_init_complete(-1);
 		return;
 	}
 
-	/**
-	 * Ensure no more than half of the total buffers end up local caches, by
-	 *   using spdk_thread_get_count() to determine how many local caches we need
-	 *   to account for.
-	 */
-	cache_size = BUF_SMALL_POOL_SIZE / (2 * spdk_thread_get_count());
-	snprintf(mempool_name, sizeof(mempool_name), "buf_small_pool_%d", getpid());
-
-	g_bdev_mgr.buf_small_pool = spdk_mempool_create(mempool_name,
-				    BUF_SMALL_POOL_SIZE,
-				    SPDK_BDEV_BUF_SIZE_WITH_MD(SPDK_BDEV_SMALL_BUF_MAX_SIZE) +
-				    SPDK_BDEV_POOL_ALIGNMENT,
-				    cache_size,
-				    SPDK_ENV_SOCKET_ID_ANY);
-	if (!g_bdev_mgr.buf_small_pool) {
-		SPDK_ERRLOG("create rbuf small pool failed\n");
-		spdk_bdev_init_complete(-1);
-		return;
-	}
-
-	cache_size = BUF_LARGE_POOL_SIZE / (2 * spdk_thread_get_count());
-	snprintf(mempool_name, sizeof(mempool_name), "buf_large_pool_%d", getpid());
-
-	g_bdev_mgr.buf_large_pool = spdk_mempool_create(mempool_name,
-				    BUF_LARGE_POOL_SIZE,
-				    SPDK_BDEV_BUF_SIZE_WITH_MD(SPDK_BDEV_LARGE_BUF_MAX_SIZE) +
-				    SPDK_BDEV_POOL_ALIGNMENT,
-				    cache_size,
-				    SPDK_ENV_SOCKET_ID_ANY);
-	if (!g_bdev_mgr.buf_large_pool) {
-		SPDK_ERRLOG("create rbuf large pool failed\n");
+	if (spdk_bdev_buf_pools_create() != 0) {
 		spdk_bdev_init_complete(-1);
 		return;
 	}
@@ -1104,30 +1737,38 @@ static void
 spdk_bdev_mgr_unregister_cb(void *io_device)
 {
 	spdk_bdev_fini_cb cb_fn = g_fini_cb_fn;
+	uint32_t i;
 
-	if (spdk_mempool_count(g_bdev_mgr.bdev_io_pool) != g_bdev_opts.bdev_io_pool_size) {
-		SPDK_ERRLOG("bdev IO pool count is %zu but should be %u\n",
-			    spdk_mempool_count(g_bdev_mgr.bdev_io_pool),
-			    g_bdev_opts.bdev_io_pool_size);
-	}
+	for (i = 0; i < SPDK_BDEV_IO_POOL_MAX_SOCKETS; i++) {
+		if (g_bdev_mgr.bdev_io_pools[i] == NULL) {
+			continue;
+		}
 
-	if (spdk_mempool_count(g_bdev_mgr.buf_small_pool) != BUF_SMALL_POOL_SIZE) {
-		SPDK_ERRLOG("Small buffer pool count is %zu but should be %u\n",
-			    spdk_mempool_count(g_bdev_mgr.buf_small_pool),
-			    BUF_SMALL_POOL_SIZE);
-		assert(false);
+		if (spdk_mempool_count(g_bdev_mgr.bdev_io_pools[i]) != g_bdev_mgr.bdev_io_pool_sizes[i]) {
+			SPDK_ERRLOG("bdev IO pool %u count is %zu but should be %u\n", i,
+				    spdk_mempool_count(g_bdev_mgr.bdev_io_pools[i]),
+				    g_bdev_mgr.bdev_io_pool_sizes[i]);
+		}
 	}
 
-	if (spdk_mempool_count(g_bdev_mgr.buf_large_pool) != BUF_LARGE_POOL_SIZE) {
-		SPDK_ERRLOG("Large buffer pool count is %zu but should be %u\n",
-			    spdk_mempool_count(g_bdev_mgr.buf_large_pool),
-			    BUF_LARGE_POOL_SIZE);
-		assert(false);
+	for (i = 0; i < SPDK_BDEV_NUM_BUF_CLASSES; i++) {
+		if (spdk_mempool_count(g_bdev_mgr.buf_pools[i]) != g_bdev_mgr.buf_pool_sizes[i]) {
+			SPDK_ERRLOG("%s buffer pool count is %zu but should be %" PRIu32 "\n",
+				    g_bdev_buf_class_name[i],
+				    spdk_mempool_count(g_bdev_mgr.buf_pools[i]),
+				    g_bdev_mgr.buf_pool_sizes[i]);
+			assert(false);
+		}
 	}
 
-	spdk_mempool_free(g_bdev_mgr.bdev_io_pool);
-	spdk_mempool_free(g_bdev_mgr.buf_small_pool);
-	spdk_mempool_free(g_bdev_mgr.buf_large_pool);
+	for (i = 0; i < SPDK_BDEV_IO_POOL_MAX_SOCKETS; i++) {
+		spdk_mempool_free(g_bdev_mgr.bdev_io_pools[i]);
+		g_bdev_mgr.bdev_io_pools[i] = NULL;
+	}
+	for (i = 0; i < SPDK_BDEV_NUM_BUF_CLASSES; i++) {
+		spdk_mempool_free(g_bdev_mgr.buf_pools[i]);
+		g_bdev_mgr.buf_pools[i] = NULL;
+	}
 	spdk_free(g_bdev_mgr.zero_buffer);
 
 	cb_fn(g_fini_cb_arg);
@@ -1281,24 +1922,59 @@ spdk_bdev_finish(spdk_bdev_fini_cb cb_fn, void *cb_arg)
 	_spdk_bdev_finish_unregister_bdevs_iter(NULL, 0);
 }
 
+/*
+ * Called when the cache is empty.  Fetches a batch of bdev_ios from the pools,
+ *  returns the first one and keeps the rest in the cache.
+ */
+static struct spdk_bdev_io *
+_spdk_bdev_io_cache_refill(struct spdk_bdev_mgmt_channel *ch)
+{
+	struct spdk_bdev_io *bdev_ios[SPDK_BDEV_IO_CACHE_REFILL_BATCH];
+	uint32_t count, i;
+
+	ch->cache_stat.misses++;
+
+	count = spdk_min(SPDK_BDEV_IO_CACHE_REFILL_BATCH, ch->bdev_io_cache_size + 1);
+	count = _spdk_bdev_io_pool_get_bulk(ch, bdev_ios, count);
+	if (count == 0) {
+		ch->cache_stat.pool_empty++;
+		return NULL;
+	}
+
+	for (i = 1; i < count; i++) {
+		ch->per_thread_cache_count++;
+		STAILQ_INSERT_HEAD(&ch->per_thread_cache, bdev_ios[i], internal.buf_link);
+	}
+
+	return bdev_ios[0];
+}
+
 struct spdk_bdev_io *
 spdk_bdev_get_io(struct spdk_bdev_channel *channel)
 {
 	struct spdk_bdev_mgmt_channel *ch = channel->shared_resource->mgmt_ch;
 	struct spdk_bdev_io *bdev_io;
 
-	if (ch->per_thread_cache_count > 0) {
+	if (spdk_likely(ch->per_thread_cache_count > 0)) {
 		bdev_io = STAILQ_FIRST(&ch->per_thread_cache);
 		STAILQ_REMOVE_HEAD(&ch->per_thread_cache, internal.buf_link);
 		ch->per_thread_cache_count--;
+		ch->cache_stat.hits++;
 	} else if (spdk_unlikely(!TAILQ_EMPTY(&ch->io_wait_queue))) {
 		/*
 		 * Don't try to look for bdev_ios in the global pool if there are
 		 * waiters on bdev_ios - we don't want this caller to jump the line.
 		 */
-		bdev_io = NULL;
+		return NULL;
 	} else {
-		bdev_io = spdk_mempool_get(g_bdev_mgr.bdev_io_pool);
+		bdev_io = _spdk_bdev_io_cache_refill(ch);
+		if (bdev_io == NULL) {
+			return NULL;
+		}
+	}
+
+	if (++ch->outstanding_io_count > ch->peak_outstanding_io_count) {
+		ch->peak_outstanding_io_count = ch->outstanding_io_count;
 	}
 
 	return bdev_io;
@@ -1318,6 +1994,9 @@ spdk_bdev_free_io(struct spdk_bdev_io *bdev_io)
 		spdk_bdev_io_put_buf(bdev_io);
 	}
 
+	assert(ch->outstanding_io_count > 0);
+	ch->outstanding_io_count--;
+
 	if (ch->per_thread_cache_count < ch->bdev_io_cache_size) {
 		ch->per_thread_cache_count++;
 		STAILQ_INSERT_HEAD(&ch->per_thread_cache, bdev_io, internal.buf_link);
@@ -1331,10 +2010,73 @@ spdk_bdev_free_io(struct spdk_bdev_io *bdev_io)
 	} else {
 		/* We should never have a full cache with entries on the io wait queue. */
 		assert(TAILQ_EMPTY(&ch->io_wait_queue));
-		spdk_mempool_put(g_bdev_mgr.bdev_io_pool, (void *)bdev_io);
+		spdk_mempool_put(bdev_io->internal.pool, (void *)bdev_io);
 	}
 }
 
+struct spdk_bdev_io_cache_stats_ctx {
+	spdk_bdev_io_cache_stat_cb stat_cb;
+	spdk_bdev_get_io_cache_stats_cb cb;
+	void *cb_arg;
+};
+
+static void
+_spdk_bdev_get_io_cache_stats_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct spdk_bdev_io_cache_stats_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	ctx->cb(ctx->cb_arg, status);
+	free(ctx);
+}
+
+static void
+_spdk_bdev_get_each_io_cache_stat(struct spdk_io_channel_iter *i)
+{
+	struct spdk_bdev_io_cache_stats_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
+	struct spdk_bdev_mgmt_channel *ch = spdk_io_channel_get_ctx(_ch);
+	struct spdk_bdev_io_cache_stat stat;
+	uint32_t buf_class;
+
+	stat = ch->cache_stat;
+	stat.cache_size = ch->bdev_io_cache_size;
+	stat.cache_count = ch->per_thread_cache_count;
+	stat.peak_outstanding = ch->peak_outstanding_io_count;
+	stat.socket_id = ch->socket_id;
+	for (buf_class = 0; buf_class < SPDK_BDEV_NUM_BUF_CLASSES; buf_class++) {
+		stat.buf[buf_class] = ch->buf_cache[buf_class].stat;
+		stat.buf[buf_class].buf_size = g_bdev_buf_class_size[buf_class];
+		stat.buf[buf_class].cache_count = ch->buf_cache[buf_class].count;
+	}
+
+	ctx->stat_cb(&stat, ctx->cb_arg);
+	spdk_for_each_channel_continue(i, 0);
+}
+
+void
+spdk_bdev_get_io_cache_stats(spdk_bdev_io_cache_stat_cb stat_cb,
+			     spdk_bdev_get_io_cache_stats_cb cb, void *cb_arg)
+{
+	struct spdk_bdev_io_cache_stats_ctx *ctx;
+
+	assert(stat_cb != NULL);
+	assert(cb != NULL);
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		SPDK_ERRLOG("Unable to allocate memory for spdk_bdev_io_cache_stats_ctx\n");
+		cb(cb_arg, -ENOMEM);
+		return;
+	}
+
+	ctx->stat_cb = stat_cb;
+	ctx->cb = cb;
+	ctx->cb_arg = cb_arg;
+
+	spdk_for_each_channel(&g_bdev_mgr, _spdk_bdev_get_each_io_cache_stat, ctx,
+			      _spdk_bdev_get_io_cache_stats_done);
+}
+
 static bool
 _spdk_bdev_qos_is_iops_rate_limit(enum spdk_bdev_qos_rate_limit_type limit)
 {
@@ -1518,38 +2260,199 @@ _spdk_bdev_io_do_submit(struct spdk_bdev_channel *bdev_ch, struct spdk_bdev_io *
 	}
 }
 
+/*
+ * Returns true if the I/O has to stay queued because of the rate limits, otherwise
+ *  charges it against them.
+ */
+static bool
+_spdk_bdev_qos_rate_limit_io(struct spdk_bdev_qos *qos, struct spdk_bdev_io *bdev_io)
+{
+	int i;
+
+	if (_spdk_bdev_qos_io_to_limit(bdev_io) == false) {
+		return false;
+	}
+
+	for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
+		if (!qos->rate_limits[i].queue_io) {
+			continue;
+		}
+
+		if (qos->rate_limits[i].queue_io(&qos->rate_limits[i],
+						 bdev_io) == true) {
+			return true;
+		}
+	}
+	for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
+		if (!qos->rate_limits[i].update_quota) {
+			continue;
+		}
+
+		qos->rate_limits[i].update_quota(&qos->rate_limits[i], bdev_io);
+	}
+
+	return false;
+}
+
+static inline bool
+_spdk_bdev_io_is_low_priority(struct spdk_bdev_io *bdev_io)
+{
+	struct spdk_bdev_desc *desc = bdev_io->internal.desc;
+
+	return desc != NULL && desc->qos_priority == SPDK_BDEV_QOS_PRIORITY_LOW;
+}
+
+static inline bdev_io_tailq_t *
+_spdk_bdev_qos_get_queue(struct spdk_bdev_qos *qos, struct spdk_bdev_io *bdev_io)
+{
+	if (qos->latency.target_usec != 0 && _spdk_bdev_io_is_low_priority(bdev_io)) {
+		return &qos->latency.queued;
+	}
+
+	return &qos->queued;
+}
+
+static int
+_spdk_bdev_qos_io_submit(struct spdk_bdev_channel *ch, struct spdk_bdev_qos *qos)
+{
+	struct spdk_bdev_io		*bdev_io = NULL, *tmp = NULL;
+	int				submitted_ios = 0;
+
+	TAILQ_FOREACH_SAFE(bdev_io, &qos->queued, internal.link, tmp) {
+		if (_spdk_bdev_qos_rate_limit_io(qos, bdev_io)) {
+			return submitted_ios;
+		}
+
+		TAILQ_REMOVE(&qos->queued, bdev_io, internal.link);
+		_spdk_bdev_io_do_submit(ch, bdev_io);
+		submitted_ios++;
+	}
+
+	/*
+	 * Low priority I/O is only issued once nothing else is waiting, and no faster
+	 *  than the latency target controller allows.
+	 */
+	TAILQ_FOREACH_SAFE(bdev_io, &qos->latency.queued, internal.link, tmp) {
+		if (qos->latency.max_per_timeslice != 0 &&
+		    qos->latency.remaining_this_timeslice <= 0) {
+			break;
+		}
+
+		if (_spdk_bdev_qos_rate_limit_io(qos, bdev_io)) {
+			break;
+		}
+
+		qos->latency.remaining_this_timeslice--;
+		qos->latency.window_ios++;
+		TAILQ_REMOVE(&qos->latency.queued, bdev_io, internal.link);
+		_spdk_bdev_io_do_submit(ch, bdev_io);
+		submitted_ios++;
+	}
+
+	return submitted_ios;
+}
+
+static int spdk_bdev_channel_poll_qos_local(void *arg);
+
+/*
+ * Moves up to one batch of quota from the shared budget of a rate limit to the
+ *  channel. Returns false if the shared budget is used up for this timeslice.
+ */
+static bool
+_spdk_bdev_qos_take_quota(struct spdk_bdev_qos_limit *shared, struct spdk_bdev_qos_limit *local)
+{
+	int64_t remaining, quota;
+
+	remaining = __atomic_load_n(&shared->remaining_this_timeslice, __ATOMIC_RELAXED);
+	do {
+		if (remaining <= 0) {
+			return false;
+		}
+		quota = spdk_min(remaining, (int64_t)shared->batch);
+	} while (!__atomic_compare_exchange_n(&shared->remaining_this_timeslice, &remaining,
+					      remaining - quota, true,
+					      __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	local->remaining_this_timeslice += quota;
+	return true;
+}
+
+/*
+ * Distributed counterpart of _spdk_bdev_qos_rate_limit_io(). The I/O is checked and
+ *  charged against the quota held by the channel, which is topped up from the
+ *  shared budget when it runs out.
+ */
+static bool
+_spdk_bdev_qos_local_rate_limit_io(struct spdk_bdev_channel *ch, struct spdk_bdev_qos *qos,
+				   struct spdk_bdev_io *bdev_io)
+{
+	int i;
+
+	if (_spdk_bdev_qos_io_to_limit(bdev_io) == false) {
+		return false;
+	}
+
+	for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
+		if (!qos->rate_limits[i].queue_io) {
+			continue;
+		}
+
+		/* The limit may have been updated on the QoS thread since this channel last looked. */
+		ch->qos_local[i].max_per_timeslice = qos->rate_limits[i].max_per_timeslice;
+		while (qos->rate_limits[i].queue_io(&ch->qos_local[i], bdev_io) == true) {
+			if (!_spdk_bdev_qos_take_quota(&qos->rate_limits[i], &ch->qos_local[i])) {
+				return true;
+			}
+		}
+	}
+	for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
+		if (!qos->rate_limits[i].update_quota) {
+			continue;
+		}
+
+		qos->rate_limits[i].update_quota(&ch->qos_local[i], bdev_io);
+	}
+
+	return false;
+}
+
 static int
-_spdk_bdev_qos_io_submit(struct spdk_bdev_channel *ch, struct spdk_bdev_qos *qos)
+_spdk_bdev_qos_local_io_submit(struct spdk_bdev_channel *ch, struct spdk_bdev_qos *qos)
 {
 	struct spdk_bdev_io		*bdev_io = NULL, *tmp = NULL;
-	int				i, submitted_ios = 0;
-
-	TAILQ_FOREACH_SAFE(bdev_io, &qos->queued, internal.link, tmp) {
-		if (_spdk_bdev_qos_io_to_limit(bdev_io) == true) {
-			for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
-				if (!qos->rate_limits[i].queue_io) {
-					continue;
-				}
-
-				if (qos->rate_limits[i].queue_io(&qos->rate_limits[i],
-								 bdev_io) == true) {
-					return submitted_ios;
-				}
-			}
-			for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
-				if (!qos->rate_limits[i].update_quota) {
-					continue;
-				}
+	int				submitted_ios = 0;
 
-				qos->rate_limits[i].update_quota(&qos->rate_limits[i], bdev_io);
-			}
+	TAILQ_FOREACH_SAFE(bdev_io, &ch->qos_queued, internal.link, tmp) {
+		/* The budget is not refilled while the QoS poller is being torn down. */
+		if (qos->thread != NULL && _spdk_bdev_qos_local_rate_limit_io(ch, qos, bdev_io)) {
+			break;
 		}
 
-		TAILQ_REMOVE(&qos->queued, bdev_io, internal.link);
+		TAILQ_REMOVE(&ch->qos_queued, bdev_io, internal.link);
 		_spdk_bdev_io_do_submit(ch, bdev_io);
 		submitted_ios++;
 	}
 
+	if (!TAILQ_EMPTY(&ch->qos_queued) && ch->qos_poller == NULL) {
+		ch->qos_poller = SPDK_POLLER_REGISTER(spdk_bdev_channel_poll_qos_local, ch,
+						      SPDK_BDEV_QOS_TIMESLICE_IN_USEC);
+	}
+
+	return submitted_ios;
+}
+
+/* Retries the I/O queued on a channel once the shared budget has been refilled. */
+static int
+spdk_bdev_channel_poll_qos_local(void *arg)
+{
+	struct spdk_bdev_channel *ch = arg;
+	int submitted_ios;
+
+	submitted_ios = _spdk_bdev_qos_local_io_submit(ch, ch->bdev->internal.qos);
+	if (TAILQ_EMPTY(&ch->qos_queued)) {
+		spdk_poller_unregister(&ch->qos_poller);
+	}
+
 	return submitted_ios;
 }
 
@@ -1850,8 +2753,14 @@ _spdk_bdev_io_submit(void *ctx)
 	} else if (bdev_ch->flags & BDEV_CH_QOS_ENABLED) {
 		bdev_ch->io_outstanding--;
 		shared_resource->io_outstanding--;
-		TAILQ_INSERT_TAIL(&bdev->internal.qos->queued, bdev_io, internal.link);
+		TAILQ_INSERT_TAIL(_spdk_bdev_qos_get_queue(bdev->internal.qos, bdev_io), bdev_io,
+				  internal.link);
 		_spdk_bdev_qos_io_submit(bdev_ch, bdev->internal.qos);
+	} else if (bdev_ch->flags & BDEV_CH_QOS_DISTRIBUTED) {
+		bdev_ch->io_outstanding--;
+		shared_resource->io_outstanding--;
+		TAILQ_INSERT_TAIL(&bdev_ch->qos_queued, bdev_io, internal.link);
+		_spdk_bdev_qos_local_io_submit(bdev_ch, bdev->internal.qos);
 	} else {
 		SPDK_ERRLOG("unknown bdev_ch flag %x found\n", bdev_ch->flags);
 		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
@@ -1963,6 +2872,7 @@ static void
 spdk_bdev_qos_update_max_quota_per_timeslice(struct spdk_bdev_qos *qos)
 {
 	uint32_t max_per_timeslice = 0;
+	uint64_t batch;
 	int i;
 
 	for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
@@ -1977,12 +2887,191 @@ spdk_bdev_qos_update_max_quota_per_timeslice(struct spdk_bdev_qos *qos)
 		qos->rate_limits[i].max_per_timeslice = spdk_max(max_per_timeslice,
 							qos->rate_limits[i].min_per_timeslice);
 
-		qos->rate_limits[i].remaining_this_timeslice = qos->rate_limits[i].max_per_timeslice;
+		/*
+		 * Quota taken by a channel but not used yet is unavailable to the others,
+		 *  so keep the sum of the batches held by all threads within the tolerance.
+		 */
+		batch = (uint64_t)qos->rate_limits[i].max_per_timeslice * g_bdev_opts.qos_tolerance_pct /
+			100 / spdk_max(spdk_thread_get_count(), 1);
+		qos->rate_limits[i].batch = spdk_max(batch, qos->rate_limits[i].min_per_timeslice);
+
+		/* Channels take quota from here concurrently in distributed mode. */
+		__atomic_store_n(&qos->rate_limits[i].remaining_this_timeslice,
+				 qos->rate_limits[i].max_per_timeslice, __ATOMIC_RELAXED);
 	}
 
 	_spdk_bdev_qos_set_ops(qos);
 }
 
+struct spdk_bdev_qos_percentile_ctx {
+	uint64_t percentile;
+	uint64_t total;
+	uint64_t value;
+};
+
+static void
+_spdk_bdev_qos_percentile_cb(void *cb_arg, uint64_t start, uint64_t end, uint64_t count,
+			     uint64_t total, uint64_t so_far)
+{
+	struct spdk_bdev_qos_percentile_ctx *ctx = cb_arg;
+
+	ctx->total = total;
+	if (ctx->value != 0 || count == 0) {
+		return;
+	}
+
+	if (so_far * 100 >= total * ctx->percentile) {
+		ctx->value = end;
+	}
+}
+
+static void
+_spdk_bdev_qos_latency_set_limit(struct spdk_bdev_qos *qos, uint64_t limit)
+{
+	uint32_t max_per_timeslice = 0;
+
+	if (limit != 0) {
+		max_per_timeslice = limit * SPDK_BDEV_QOS_TIMESLICE_IN_USEC / SPDK_SEC_TO_USEC;
+		max_per_timeslice = spdk_max(max_per_timeslice, SPDK_BDEV_QOS_MIN_IO_PER_TIMESLICE);
+	}
+
+	qos->latency.limit = limit;
+	qos->latency.max_per_timeslice = max_per_timeslice;
+	qos->latency.remaining_this_timeslice = max_per_timeslice;
+}
+
+/*
+ * Latency target controller, run by the QoS poller.  At the end of each window it
+ *  compares the p99 latency of the high priority I/O completed in that window with
+ *  the target.  While the target is missed, the IOPS allowed for low priority I/O
+ *  is cut by a quarter each window, starting from the rate it was running at.
+ *  Once the target is met again, the limit is raised by an eighth each window until
+ *  low priority I/O no longer uses what it is given, at which point it is lifted.
+ */
+static void
+_spdk_bdev_qos_latency_update(struct spdk_bdev_qos *qos, uint64_t now)
+{
+	struct spdk_bdev_qos_latency *latency = &qos->latency;
+	struct spdk_bdev *bdev = qos->ch->bdev;
+	struct spdk_bdev_qos_percentile_ctx ctx = {};
+	uint64_t window_size, target_ticks, ios_per_sec, limit;
+	bool violated;
+
+	if (latency->target_usec == 0) {
+		if (latency->limit != 0) {
+			_spdk_bdev_qos_latency_set_limit(qos, 0);
+		}
+		return;
+	}
+
+	if (latency->histogram == NULL) {
+		latency->histogram = spdk_histogram_data_alloc_sized(SPDK_BDEV_QOS_LATENCY_HISTOGRAM_SHIFT);
+		if (latency->histogram == NULL) {
+			SPDK_ERRLOG("Could not allocate latency histogram for bdev %s\n", bdev->name);
+			return;
+		}
+		latency->window_start = now;
+		latency->window_ios = 0;
+		return;
+	}
+
+	window_size = SPDK_BDEV_QOS_LATENCY_WINDOW_IN_USEC * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
+	if (now < latency->window_start + window_size) {
+		return;
+	}
+
+	ctx.percentile = SPDK_BDEV_QOS_LATENCY_PERCENTILE;
+	spdk_histogram_data_iterate(latency->histogram, _spdk_bdev_qos_percentile_cb, &ctx);
+
+	target_ticks = latency->target_usec * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
+	violated = ctx.total > 0 && ctx.value > target_ticks;
+	ios_per_sec = latency->window_ios * spdk_get_ticks_hz() / (now - latency->window_start);
+
+	limit = latency->limit;
+	if (violated) {
+		if (limit == 0) {
+			limit = ios_per_sec;
+		}
+		if (limit != 0) {
+			limit = spdk_max(limit * 3 / 4, SPDK_BDEV_QOS_MIN_IOS_PER_SEC);
+		}
+	} else if (limit != 0) {
+		if (TAILQ_EMPTY(&latency->queued) && ios_per_sec < limit / 2) {
+			limit = 0;
+		} else {
+			limit += spdk_max(limit / 8, SPDK_BDEV_QOS_MIN_IOS_PER_SEC);
+		}
+	}
+
+	if (limit != latency->limit) {
+		_spdk_bdev_qos_latency_set_limit(qos, limit);
+	}
+
+	pthread_mutex_lock(&bdev->internal.mutex);
+	latency->stat.p99_latency_usec = ctx.value * SPDK_SEC_TO_USEC / spdk_get_ticks_hz();
+	latency->stat.low_priority_ios_per_sec = limit;
+	latency->stat.windows++;
+	if (violated) {
+		latency->stat.violations++;
+	}
+	pthread_mutex_unlock(&bdev->internal.mutex);
+
+	spdk_histogram_data_reset(latency->histogram);
+	latency->window_ios = 0;
+	latency->window_start = now;
+}
+
+/* Called on the QoS thread when an I/O funneled through the QoS channel completes. */
+static inline void
+_spdk_bdev_qos_latency_tally(struct spdk_bdev_qos *qos, struct spdk_bdev_io *bdev_io)
+{
+	uint64_t tsc_diff;
+
+	if (qos->latency.histogram == NULL || qos->ch != bdev_io->internal.ch ||
+	    _spdk_bdev_io_is_low_priority(bdev_io)) {
+		return;
+	}
+
+	if (bdev_io->type != SPDK_BDEV_IO_TYPE_READ && bdev_io->type != SPDK_BDEV_IO_TYPE_WRITE) {
+		return;
+	}
+
+	tsc_diff = spdk_get_ticks() - bdev_io->internal.submit_tsc;
+	spdk_histogram_data_tally(qos->latency.histogram, spdk_max(tsc_diff, 1));
+}
+
+/*
+ * Refills the shared budget of each rate limit for distributed QoS. The budget is
+ *  reset the same way as in funneled mode, but with atomic operations since the
+ *  channels keep taking quota from it meanwhile.
+ */
+static void
+_spdk_bdev_qos_refill_shared(struct spdk_bdev_qos *qos, uint64_t now)
+{
+	struct spdk_bdev_qos_limit *limit;
+	int64_t remaining, quota;
+	uint64_t timeslices = 0;
+	int i;
+
+	while (now >= (qos->last_timeslice + qos->timeslice_size)) {
+		qos->last_timeslice += qos->timeslice_size;
+		timeslices++;
+	}
+
+	for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
+		limit = &qos->rate_limits[i];
+		if (limit->max_per_timeslice == 0) {
+			continue;
+		}
+
+		remaining = __atomic_load_n(&limit->remaining_this_timeslice, __ATOMIC_RELAXED);
+		do {
+			quota = spdk_min(remaining, 0) + (int64_t)(timeslices * limit->max_per_timeslice);
+		} while (!__atomic_compare_exchange_n(&limit->remaining_this_timeslice, &remaining, quota,
+						      true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	}
+}
+
 static int
 spdk_bdev_channel_poll_qos(void *arg)
 {
@@ -1999,6 +3088,11 @@ spdk_bdev_channel_poll_qos(void *arg)
 		return 0;
 	}
 
+	if (qos->distributed) {
+		_spdk_bdev_qos_refill_shared(qos, now);
+		return 0;
+	}
+
 	/* Reset for next round of rate limiting */
 	for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
 		/* We may have allowed the IOs or bytes to slightly overrun in the last
@@ -2010,6 +3104,9 @@ spdk_bdev_channel_poll_qos(void *arg)
 			qos->rate_limits[i].remaining_this_timeslice = 0;
 		}
 	}
+	if (qos->latency.remaining_this_timeslice > 0) {
+		qos->latency.remaining_this_timeslice = 0;
+	}
 
 	while (now >= (qos->last_timeslice + qos->timeslice_size)) {
 		qos->last_timeslice += qos->timeslice_size;
@@ -2017,8 +3114,11 @@ spdk_bdev_channel_poll_qos(void *arg)
 			qos->rate_limits[i].remaining_this_timeslice +=
 				qos->rate_limits[i].max_per_timeslice;
 		}
+		qos->latency.remaining_this_timeslice += qos->latency.max_per_timeslice;
 	}
 
+	_spdk_bdev_qos_latency_update(qos, now);
+
 	return _spdk_bdev_qos_io_submit(qos->ch, qos);
 }
 
@@ -2067,6 +3167,8 @@ _spdk_bdev_enable_qos(struct spdk_bdev *bdev, struct spdk_bdev_channel *ch)
 			qos->thread = spdk_io_channel_get_thread(io_ch);
 
 			TAILQ_INIT(&qos->queued);
+			TAILQ_INIT(&qos->latency.queued);
+			qos->distributed = g_bdev_opts.qos_distributed;
 
 			for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
 				if (_spdk_bdev_qos_is_iops_rate_limit(i) == true) {
@@ -2085,12 +3187,19 @@ _spdk_bdev_enable_qos(struct spdk_bdev *bdev, struct spdk_bdev_channel *ch)
 			qos->timeslice_size =
 				SPDK_BDEV_QOS_TIMESLICE_IN_USEC * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
 			qos->last_timeslice = spdk_get_ticks();
-			qos->poller = spdk_poller_register(spdk_bdev_channel_poll_qos,
+			qos->poller = SPDK_POLLER_REGISTER(spdk_bdev_channel_poll_qos,
 							   qos,
 							   SPDK_BDEV_QOS_TIMESLICE_IN_USEC);
 		}
 
-		ch->flags |= BDEV_CH_QOS_ENABLED;
+		if (qos->distributed) {
+			for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
+				ch->qos_local[i].remaining_this_timeslice = 0;
+			}
+			ch->flags |= BDEV_CH_QOS_DISTRIBUTED;
+		} else {
+			ch->flags |= BDEV_CH_QOS_ENABLED;
+		}
 	}
 }
 
@@ -2153,6 +3262,8 @@ spdk_bdev_channel_create(void *io_device, void *ctx_buf)
 	ch->stat.ticks_rate = spdk_get_ticks_hz();
 	ch->io_outstanding = 0;
 	TAILQ_INIT(&ch->queued_resets);
+	TAILQ_INIT(&ch->qos_queued);
+	ch->qos_poller = NULL;
 	ch->flags = 0;
 	ch->shared_resource = shared_resource;
 
@@ -2239,6 +3350,7 @@ spdk_bdev_qos_channel_destroy(void *cb_arg)
 
 	spdk_put_io_channel(spdk_io_channel_from_ctx(qos->ch));
 	spdk_poller_unregister(&qos->poller);
+	spdk_histogram_data_free(qos->latency.histogram);
 
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV, "Free QoS %p.\n", qos);
 
@@ -2278,6 +3390,11 @@ spdk_bdev_qos_destroy(struct spdk_bdev *bdev)
 	new_qos->thread = NULL;
 	new_qos->poller = NULL;
 	TAILQ_INIT(&new_qos->queued);
+	new_qos->latency.histogram = NULL;
+	TAILQ_INIT(&new_qos->latency.queued);
+	new_qos->latency.limit = 0;
+	new_qos->latency.max_per_timeslice = 0;
+	new_qos->latency.remaining_this_timeslice = 0;
 	/*
 	 * The limit member of spdk_bdev_qos_limit structure is not zeroed.
 	 * It will be used later for the new QoS structure.
@@ -2324,6 +3441,7 @@ spdk_bdev_channel_destroy(void *io_device, void *ctx_buf)
 	struct spdk_bdev_channel	*ch = ctx_buf;
 	struct spdk_bdev_mgmt_channel	*mgmt_ch;
 	struct spdk_bdev_shared_resource *shared_resource = ch->shared_resource;
+	uint32_t			i;
 
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV, "Destroying channel %p for bdev %s on thread %p\n", ch, ch->bdev->name,
 		      spdk_get_thread());
@@ -2337,8 +3455,11 @@ spdk_bdev_channel_destroy(void *io_device, void *ctx_buf)
 
 	_spdk_bdev_abort_queued_io(&ch->queued_resets, ch);
 	_spdk_bdev_abort_queued_io(&shared_resource->nomem_io, ch);
-	_spdk_bdev_abort_buf_io(&mgmt_ch->need_buf_small, ch);
-	_spdk_bdev_abort_buf_io(&mgmt_ch->need_buf_large, ch);
+	for (i = 0; i < SPDK_BDEV_NUM_BUF_CLASSES; i++) {
+		_spdk_bdev_abort_buf_io(&mgmt_ch->buf_cache[i].need_buf, ch);
+	}
+	_spdk_bdev_abort_queued_io(&ch->qos_queued, ch);
+	spdk_poller_unregister(&ch->qos_poller);
 
 	if (ch->histogram) {
 		spdk_histogram_data_free(ch->histogram);
@@ -2351,6 +3472,7 @@ int
 spdk_bdev_alias_add(struct spdk_bdev *bdev, const char *alias)
 {
 	struct spdk_bdev_alias *tmp;
+	int rc;
 
 	if (alias == NULL) {
 		SPDK_ERRLOG("Empty alias passed\n");
@@ -2375,6 +3497,17 @@ spdk_bdev_alias_add(struct spdk_bdev *bdev, const char *alias)
 		return -ENOMEM;
 	}
 
+	/* Aliases only become visible to lookups while the bdev itself is. */
+	if (spdk_bdev_get_by_name(bdev->name) == bdev) {
+		rc = spdk_bdev_name_add(tmp->alias, bdev);
+		if (rc != 0) {
+			SPDK_ERRLOG("Unable to add alias %s to name index\n", alias);
+			free(tmp->alias);
+			free(tmp);
+			return rc;
+		}
+	}
+
 	TAILQ_INSERT_TAIL(&bdev->aliases, tmp, tailq);
 
 	return 0;
@@ -2388,6 +3521,7 @@ spdk_bdev_alias_del(struct spdk_bdev *bdev, const char *alias)
 	TAILQ_FOREACH(tmp, &bdev->aliases, tailq) {
 		if (strcmp(alias, tmp->alias) == 0) {
 			TAILQ_REMOVE(&bdev->aliases, tmp, tailq);
+			spdk_bdev_name_del(tmp->alias, bdev);
 			free(tmp->alias);
 			free(tmp);
 			return 0;
@@ -2406,6 +3540,7 @@ spdk_bdev_alias_del_all(struct spdk_bdev *bdev)
 
 	TAILQ_FOREACH_SAFE(p, &bdev->aliases, tailq, tmp) {
 		TAILQ_REMOVE(&bdev->aliases, p, tailq);
+		spdk_bdev_name_del(p->alias, bdev);
 		free(p->alias);
 		free(p);
 	}
@@ -2658,7 +3793,7 @@ spdk_bdev_set_qd_sampling_period(struct spdk_bdev *bdev, uint64_t period)
 	}
 
 	if (period != 0) {
-		bdev->internal.qd_poller = spdk_poller_register(spdk_bdev_calculate_measured_queue_depth, bdev,
+		bdev->internal.qd_poller = SPDK_POLLER_REGISTER(spdk_bdev_calculate_measured_queue_depth, bdev,
 					   period);
 	}
 }
@@ -3399,6 +4534,7 @@ _spdk_bdev_reset_freeze_channel(struct spdk_io_channel_iter *i)
 	struct spdk_bdev_mgmt_channel	*mgmt_channel;
 	struct spdk_bdev_shared_resource *shared_resource;
 	bdev_io_tailq_t			tmp_queued;
+	uint32_t			buf_class;
 
 	TAILQ_INIT(&tmp_queued);
 
@@ -3417,13 +4553,16 @@ _spdk_bdev_reset_freeze_channel(struct spdk_io_channel_iter *i)
 		pthread_mutex_lock(&channel->bdev->internal.mutex);
 		if (channel->bdev->internal.qos->ch == channel) {
 			TAILQ_SWAP(&channel->bdev->internal.qos->queued, &tmp_queued, spdk_bdev_io, internal.link);
+			TAILQ_CONCAT(&tmp_queued, &channel->bdev->internal.qos->latency.queued, internal.link);
 		}
 		pthread_mutex_unlock(&channel->bdev->internal.mutex);
 	}
+	TAILQ_CONCAT(&tmp_queued, &channel->qos_queued, internal.link);
 
 	_spdk_bdev_abort_queued_io(&shared_resource->nomem_io, channel);
-	_spdk_bdev_abort_buf_io(&mgmt_channel->need_buf_small, channel);
-	_spdk_bdev_abort_buf_io(&mgmt_channel->need_buf_large, channel);
+	for (buf_class = 0; buf_class < SPDK_BDEV_NUM_BUF_CLASSES; buf_class++) {
+		_spdk_bdev_abort_buf_io(&mgmt_channel->buf_cache[buf_class].need_buf, channel);
+	}
 	_spdk_bdev_abort_queued_io(&tmp_queued, channel);
 
 	spdk_for_each_channel_continue(i, 0);
@@ -3871,6 +5010,10 @@ spdk_bdev_io_complete(struct spdk_bdev_io *bdev_io, enum spdk_bdev_io_status sta
 			return;
 		}
 
+		if (spdk_unlikely(bdev_ch->flags & BDEV_CH_QOS_ENABLED)) {
+			_spdk_bdev_qos_latency_tally(bdev->internal.qos, bdev_io);
+		}
+
 		if (spdk_unlikely(!TAILQ_EMPTY(&shared_resource->nomem_io))) {
 			_spdk_bdev_ch_retry_io(bdev_ch);
 		}
@@ -4083,6 +5226,7 @@ static int
 spdk_bdev_init(struct spdk_bdev *bdev)
 {
 	char *bdev_name;
+	int rc;
 
 	assert(bdev->module != NULL);
 
@@ -4109,6 +5253,13 @@ spdk_bdev_init(struct spdk_bdev *bdev)
 		return -ENOMEM;
 	}
 
+	rc = spdk_bdev_name_add(bdev->name, bdev);
+	if (rc != 0) {
+		SPDK_ERRLOG("Unable to add bdev name:%s to name index\n", bdev->name);
+		free(bdev_name);
+		return rc;
+	}
+
 	bdev->internal.status = SPDK_BDEV_STATUS_READY;
 	bdev->internal.measured_queue_depth = UINT64_MAX;
 	bdev->internal.claim_module = NULL;
@@ -4181,6 +5332,9 @@ spdk_bdev_fini(struct spdk_bdev *bdev)
 {
 	pthread_mutex_destroy(&bdev->internal.mutex);
 
+	if (bdev->internal.qos) {
+		spdk_histogram_data_free(bdev->internal.qos->latency.histogram);
+	}
 	free(bdev->internal.qos);
 
 	spdk_io_device_unregister(__bdev_to_io_dev(bdev), spdk_bdev_destroy_cb);
@@ -4287,6 +5441,7 @@ static int
 spdk_bdev_unregister_unsafe(struct spdk_bdev *bdev)
 {
 	struct spdk_bdev_desc	*desc, *tmp;
+	struct spdk_bdev_alias	*alias;
 	int			rc = 0;
 
 	/* Notify each descriptor about hotremoval */
@@ -4307,6 +5462,10 @@ spdk_bdev_unregister_unsafe(struct spdk_bdev *bdev)
 	/* If there are no descriptors, proceed removing the bdev */
 	if (rc == 0) {
 		TAILQ_REMOVE(&g_bdev_mgr.bdevs, bdev, internal.link);
+		TAILQ_FOREACH(alias, &bdev->aliases, tailq) {
+			spdk_bdev_name_del(alias->alias, bdev);
+		}
+		spdk_bdev_name_del(bdev->name, bdev);
 		SPDK_DEBUGLOG(SPDK_LOG_BDEV, "Removing bdev %s from list done\n", bdev->name);
 		spdk_notify_send("bdev_unregister", spdk_bdev_get_name(bdev));
 	}
@@ -4408,6 +5567,8 @@ _spdk_bdev_open(struct spdk_bdev *bdev, bool write, struct spdk_bdev_desc *desc)
 				      _spdk_bdev_enable_qos_done);
 	}
 
+	desc->id = bdev->internal.next_desc_id++;
+	desc->qos_priority = SPDK_BDEV_QOS_PRIORITY_HIGH;
 	TAILQ_INSERT_TAIL(&bdev->internal.open_descs, desc, link);
 
 	pthread_mutex_unlock(&bdev->internal.mutex);
@@ -4584,6 +5745,62 @@ spdk_bdev_desc_get_bdev(struct spdk_bdev_desc *desc)
 	return desc->bdev;
 }
 
+int
+spdk_bdev_desc_set_qos_priority(struct spdk_bdev_desc *desc, enum spdk_bdev_qos_priority priority)
+{
+	assert(desc != NULL);
+
+	if (priority >= SPDK_BDEV_QOS_NUM_PRIORITIES) {
+		return -EINVAL;
+	}
+
+	desc->qos_priority = priority;
+	return 0;
+}
+
+enum spdk_bdev_qos_priority
+spdk_bdev_desc_get_qos_priority(struct spdk_bdev_desc *desc)
+{
+	assert(desc != NULL);
+	return desc->qos_priority;
+}
+
+void
+spdk_bdev_get_desc_info(struct spdk_bdev *bdev, spdk_bdev_desc_info_cb cb_fn, void *ctx)
+{
+	struct spdk_bdev_desc *desc;
+	struct spdk_bdev_desc_info info;
+
+	pthread_mutex_lock(&bdev->internal.mutex);
+	TAILQ_FOREACH(desc, &bdev->internal.open_descs, link) {
+		info.id = desc->id;
+		info.write = desc->write;
+		info.thread = desc->thread;
+		info.qos_priority = desc->qos_priority;
+		cb_fn(ctx, &info);
+	}
+	pthread_mutex_unlock(&bdev->internal.mutex);
+}
+
+int
+spdk_bdev_set_qos_priority_by_desc_id(struct spdk_bdev *bdev, uint32_t desc_id,
+				      enum spdk_bdev_qos_priority priority)
+{
+	struct spdk_bdev_desc *desc;
+	int rc = -ENOENT;
+
+	pthread_mutex_lock(&bdev->internal.mutex);
+	TAILQ_FOREACH(desc, &bdev->internal.open_descs, link) {
+		if (desc->id == desc_id) {
+			rc = spdk_bdev_desc_set_qos_priority(desc, priority);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&bdev->internal.mutex);
+
+	return rc;
+}
+
 void
 spdk_bdev_io_get_iovec(struct spdk_bdev_io *bdev_io, struct iovec **iovp, int *iovcntp)
 {
@@ -4751,6 +5968,7 @@ _spdk_bdev_disable_qos_done(void *cb_arg)
 	bdev->internal.qos = NULL;
 	pthread_mutex_unlock(&bdev->internal.mutex);
 
+	TAILQ_CONCAT(&qos->queued, &qos->latency.queued, internal.link);
 	while (!TAILQ_EMPTY(&qos->queued)) {
 		/* Send queued I/O back to their original thread for resubmission. */
 		bdev_io = TAILQ_FIRST(&qos->queued);
@@ -4774,6 +5992,7 @@ _spdk_bdev_disable_qos_done(void *cb_arg)
 		spdk_poller_unregister(&qos->poller);
 	}
 
+	spdk_histogram_data_free(qos->latency.histogram);
 	free(qos);
 
 	_spdk_bdev_set_qos_limit_done(ctx, 0);
@@ -4803,8 +6022,20 @@ _spdk_bdev_disable_qos_msg(struct spdk_io_channel_iter *i)
 {
 	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
 	struct spdk_bdev_channel *bdev_ch = spdk_io_channel_get_ctx(ch);
+	struct spdk_bdev_io *bdev_io;
+	bdev_io_tailq_t queued;
 
-	bdev_ch->flags &= ~BDEV_CH_QOS_ENABLED;
+	bdev_ch->flags &= ~(BDEV_CH_QOS_ENABLED | BDEV_CH_QOS_DISTRIBUTED);
+
+	/* I/O held back by distributed QoS is already on its own thread, so resubmit it here. */
+	spdk_poller_unregister(&bdev_ch->qos_poller);
+	TAILQ_INIT(&queued);
+	TAILQ_SWAP(&bdev_ch->qos_queued, &queued, spdk_bdev_io, internal.link);
+	while (!TAILQ_EMPTY(&queued)) {
+		bdev_io = TAILQ_FIRST(&queued);
+		TAILQ_REMOVE(&queued, bdev_io, internal.link);
+		_spdk_bdev_io_submit(bdev_io);
+	}
 
 	spdk_for_each_channel_continue(i, 0);
 }
@@ -4919,6 +6150,11 @@ spdk_bdev_set_qos_rate_limits(struct spdk_bdev *bdev, uint64_t *limits,
 	bdev->internal.qos_mod_in_progress = true;
 
 	if (disable_rate_limit == true && bdev->internal.qos) {
+		/* Keep QoS enabled for the latency target. */
+		if (bdev->internal.qos->latency.target_usec != 0) {
+			disable_rate_limit = false;
+		}
+
 		for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
 			if (limits[i] == SPDK_BDEV_QOS_LIMIT_NOT_DEFINED &&
 			    (bdev->internal.qos->rate_limits[i].limit > 0 &&
@@ -4973,6 +6209,112 @@ spdk_bdev_set_qos_rate_limits(struct spdk_bdev *bdev, uint64_t *limits,
 	pthread_mutex_unlock(&bdev->internal.mutex);
 }
 
+void
+spdk_bdev_set_qos_latency_target(struct spdk_bdev *bdev, uint64_t latency_target_usec,
+				 void (*cb_fn)(void *cb_arg, int status), void *cb_arg)
+{
+	struct set_qos_limit_ctx	*ctx;
+	struct spdk_bdev_qos		*qos;
+	int				i;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+	ctx->bdev = bdev;
+
+	pthread_mutex_lock(&bdev->internal.mutex);
+	if (bdev->internal.qos_mod_in_progress) {
+		pthread_mutex_unlock(&bdev->internal.mutex);
+		free(ctx);
+		cb_fn(cb_arg, -EAGAIN);
+		return;
+	}
+	bdev->internal.qos_mod_in_progress = true;
+
+	if (g_bdev_opts.qos_distributed && latency_target_usec != 0) {
+		pthread_mutex_unlock(&bdev->internal.mutex);
+		SPDK_ERRLOG("Latency target is not supported with distributed QoS\n");
+		_spdk_bdev_set_qos_limit_done(ctx, -ENOTSUP);
+		return;
+	}
+
+	qos = bdev->internal.qos;
+	if (latency_target_usec != 0) {
+		if (qos == NULL) {
+			qos = calloc(1, sizeof(*qos));
+			if (qos == NULL) {
+				pthread_mutex_unlock(&bdev->internal.mutex);
+				SPDK_ERRLOG("Unable to allocate memory for QoS tracking\n");
+				_spdk_bdev_set_qos_limit_done(ctx, -ENOMEM);
+				return;
+			}
+			for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
+				qos->rate_limits[i].limit = SPDK_BDEV_QOS_LIMIT_NOT_DEFINED;
+			}
+			bdev->internal.qos = qos;
+		}
+
+		qos->latency.target_usec = latency_target_usec;
+		qos->latency.stat.latency_target_usec = latency_target_usec;
+
+		if (qos->thread == NULL) {
+			/* Enabling */
+			spdk_for_each_channel(__bdev_to_io_dev(bdev),
+					      _spdk_bdev_enable_qos_msg, ctx,
+					      _spdk_bdev_enable_qos_done);
+			pthread_mutex_unlock(&bdev->internal.mutex);
+			return;
+		}
+
+		/* Updating - the QoS poller picks the new target up in its next timeslice. */
+		pthread_mutex_unlock(&bdev->internal.mutex);
+		_spdk_bdev_set_qos_limit_done(ctx, 0);
+		return;
+	}
+
+	if (qos == NULL) {
+		pthread_mutex_unlock(&bdev->internal.mutex);
+		_spdk_bdev_set_qos_limit_done(ctx, 0);
+		return;
+	}
+
+	qos->latency.target_usec = 0;
+	qos->latency.stat.latency_target_usec = 0;
+
+	for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
+		if (qos->rate_limits[i].limit != 0 &&
+		    qos->rate_limits[i].limit != SPDK_BDEV_QOS_LIMIT_NOT_DEFINED) {
+			/* Rate limits are still set, so keep QoS enabled. */
+			pthread_mutex_unlock(&bdev->internal.mutex);
+			_spdk_bdev_set_qos_limit_done(ctx, 0);
+			return;
+		}
+	}
+
+	/* Disabling */
+	spdk_for_each_channel(__bdev_to_io_dev(bdev),
+			      _spdk_bdev_disable_qos_msg, ctx,
+			      _spdk_bdev_disable_qos_msg_done);
+	pthread_mutex_unlock(&bdev->internal.mutex);
+}
+
+void
+spdk_bdev_get_qos_latency_stat(struct spdk_bdev *bdev, struct spdk_bdev_qos_latency_stat *stat)
+{
+	memset(stat, 0, sizeof(*stat));
+
+	pthread_mutex_lock(&bdev->internal.mutex);
+	if (bdev->internal.qos) {
+		*stat = bdev->internal.qos->latency.stat;
+	}
+	pthread_mutex_unlock(&bdev->internal.mutex);
+}
+
 struct spdk_bdev_histogram_ctx {
 	spdk_bdev_histogram_status_cb cb_fn;
 	void *cb_arg;
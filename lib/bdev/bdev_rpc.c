@@ -42,11 +42,23 @@
 struct spdk_rpc_set_bdev_opts {
 	uint32_t bdev_io_pool_size;
 	uint32_t bdev_io_cache_size;
+	uint32_t tiny_buf_pool_size;
+	uint32_t small_buf_pool_size;
+	uint32_t large_buf_pool_size;
+	uint32_t huge_buf_pool_size;
+	bool qos_distributed;
+	uint32_t qos_tolerance_pct;
 };
 
 static const struct spdk_json_object_decoder rpc_set_bdev_opts_decoders[] = {
 	{"bdev_io_pool_size", offsetof(struct spdk_rpc_set_bdev_opts, bdev_io_pool_size), spdk_json_decode_uint32, true},
 	{"bdev_io_cache_size", offsetof(struct spdk_rpc_set_bdev_opts, bdev_io_cache_size), spdk_json_decode_uint32, true},
+	{"tiny_buf_pool_size", offsetof(struct spdk_rpc_set_bdev_opts, tiny_buf_pool_size), spdk_json_decode_uint32, true},
+	{"small_buf_pool_size", offsetof(struct spdk_rpc_set_bdev_opts, small_buf_pool_size), spdk_json_decode_uint32, true},
+	{"large_buf_pool_size", offsetof(struct spdk_rpc_set_bdev_opts, large_buf_pool_size), spdk_json_decode_uint32, true},
+	{"huge_buf_pool_size", offsetof(struct spdk_rpc_set_bdev_opts, huge_buf_pool_size), spdk_json_decode_uint32, true},
+	{"qos_distributed", offsetof(struct spdk_rpc_set_bdev_opts, qos_distributed), spdk_json_decode_bool, true},
+	{"qos_tolerance_pct", offsetof(struct spdk_rpc_set_bdev_opts, qos_tolerance_pct), spdk_json_decode_uint32, true},
 };
 
 static void
@@ -57,8 +69,16 @@ spdk_rpc_bdev_set_options(struct spdk_jsonrpc_request *request, const struct spd
 	struct spdk_json_write_ctx *w;
 	int rc;
 
+	spdk_bdev_get_opts(&bdev_opts);
+
 	rpc_opts.bdev_io_pool_size = UINT32_MAX;
 	rpc_opts.bdev_io_cache_size = UINT32_MAX;
+	rpc_opts.tiny_buf_pool_size = 0;
+	rpc_opts.small_buf_pool_size = 0;
+	rpc_opts.large_buf_pool_size = 0;
+	rpc_opts.huge_buf_pool_size = 0;
+	rpc_opts.qos_distributed = bdev_opts.qos_distributed;
+	rpc_opts.qos_tolerance_pct = 0;
 
 	if (params != NULL) {
 		if (spdk_json_decode_object(params, rpc_set_bdev_opts_decoders,
@@ -70,13 +90,35 @@ spdk_rpc_bdev_set_options(struct spdk_jsonrpc_request *request, const struct spd
 		}
 	}
 
-	spdk_bdev_get_opts(&bdev_opts);
+	if (rpc_opts.qos_tolerance_pct > 100) {
+		spdk_jsonrpc_send_error_response_fmt(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						     "QoS tolerance %" PRIu32 "%% is larger than 100%%",
+						     rpc_opts.qos_tolerance_pct);
+		return;
+	}
+
 	if (rpc_opts.bdev_io_pool_size != UINT32_MAX) {
 		bdev_opts.bdev_io_pool_size = rpc_opts.bdev_io_pool_size;
 	}
 	if (rpc_opts.bdev_io_cache_size != UINT32_MAX) {
 		bdev_opts.bdev_io_cache_size = rpc_opts.bdev_io_cache_size;
 	}
+	if (rpc_opts.tiny_buf_pool_size != 0) {
+		bdev_opts.tiny_buf_pool_size = rpc_opts.tiny_buf_pool_size;
+	}
+	if (rpc_opts.small_buf_pool_size != 0) {
+		bdev_opts.small_buf_pool_size = rpc_opts.small_buf_pool_size;
+	}
+	if (rpc_opts.large_buf_pool_size != 0) {
+		bdev_opts.large_buf_pool_size = rpc_opts.large_buf_pool_size;
+	}
+	if (rpc_opts.huge_buf_pool_size != 0) {
+		bdev_opts.huge_buf_pool_size = rpc_opts.huge_buf_pool_size;
+	}
+	bdev_opts.qos_distributed = rpc_opts.qos_distributed;
+	if (rpc_opts.qos_tolerance_pct != 0) {
+		bdev_opts.qos_tolerance_pct = rpc_opts.qos_tolerance_pct;
+	}
 	rc = spdk_bdev_set_opts(&bdev_opts);
 
 	if (rc != 0) {
@@ -0,0 +1,416 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Common metadata code of virtual bdevs that keep their metadata on a bdev.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/crc32.h"
+#include "spdk/env.h"
+#include "spdk/log.h"
+#include "spdk/util.h"
+
+#include "spdk_internal/vbdev_md.h"
+
+int
+spdk_vbdev_md_init(struct spdk_vbdev_md *md, const struct spdk_vbdev_md_ops *ops, void *ctx,
+		   const char *name, struct spdk_bdev_desc *desc, struct spdk_io_channel *ch)
+{
+	md->ops = ops;
+	md->ctx = ctx;
+	md->name = name;
+	md->thread = spdk_get_thread();
+	md->bdev = spdk_bdev_desc_get_bdev(desc);
+	md->desc = desc;
+	md->ch = ch;
+	md->block_size = spdk_bdev_get_block_size(md->bdev);
+	TAILQ_INIT(&md->free_bufs);
+	TAILQ_INIT(&md->pages_waiting);
+
+	assert(ops->sb_size >= sizeof(struct spdk_vbdev_md_sb) && ops->sb_size <= md->block_size);
+	md->sb = spdk_dma_zmalloc(md->block_size, spdk_bdev_get_buf_align(md->bdev), NULL);
+	if (md->sb == NULL) {
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+int
+spdk_vbdev_md_alloc_pages(struct spdk_vbdev_md *md, uint64_t offset, uint64_t num_pages)
+{
+	size_t align = spdk_bdev_get_buf_align(md->bdev);
+	uint64_t i;
+
+	md->offset = offset;
+	md->num_pages = num_pages;
+	md->pages = calloc(num_pages, sizeof(*md->pages));
+	if (md->pages == NULL) {
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < num_pages; i++) {
+		TAILQ_INIT(&md->pages[i].waiting);
+		TAILQ_INIT(&md->pages[i].inflight);
+	}
+
+	for (i = 0; i < SPDK_VBDEV_MD_BUFS; i++) {
+		md->bufs[i].md = md;
+		md->bufs[i].buf = spdk_dma_malloc(md->block_size, align, NULL);
+		if (md->bufs[i].buf == NULL) {
+			return -ENOMEM;
+		}
+		TAILQ_INSERT_TAIL(&md->free_bufs, &md->bufs[i], link);
+	}
+
+	md->io_buf = spdk_dma_malloc(SPDK_VBDEV_MD_IO_SIZE, align, NULL);
+	if (md->io_buf == NULL) {
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+void
+spdk_vbdev_md_free(struct spdk_vbdev_md *md)
+{
+	uint32_t i;
+
+	for (i = 0; i < SPDK_VBDEV_MD_BUFS; i++) {
+		spdk_dma_free(md->bufs[i].buf);
+	}
+	spdk_dma_free(md->io_buf);
+	spdk_dma_free(md->sb);
+	free(md->pages);
+}
+
+static void
+vbdev_md_queue_retry(struct spdk_vbdev_md *md, struct spdk_bdev_io_wait_entry *wait,
+		     spdk_bdev_io_wait_cb cb_fn, void *cb_arg)
+{
+	int rc;
+
+	wait->bdev = md->bdev;
+	wait->cb_fn = cb_fn;
+	wait->cb_arg = cb_arg;
+
+	rc = spdk_bdev_queue_io_wait(md->bdev, md->ch, wait);
+	if (rc != 0) {
+		SPDK_ERRLOG("Could not queue I/O to %s: %d\n", spdk_bdev_get_name(md->bdev), rc);
+		assert(false);
+	}
+}
+
+/* Page writes */
+
+static void vbdev_md_page_write(struct spdk_vbdev_md *md, struct spdk_vbdev_md_page *page);
+
+static void
+vbdev_md_write_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct spdk_vbdev_md_buf *md_buf = cb_arg;
+	struct spdk_vbdev_md *md = md_buf->md;
+	struct spdk_vbdev_md_page *page = md_buf->page;
+	uint64_t page_idx = page - md->pages;
+	TAILQ_HEAD(, spdk_vbdev_md_wait) done = TAILQ_HEAD_INITIALIZER(done);
+	struct spdk_vbdev_md_wait *wait;
+
+	spdk_bdev_free_io(bdev_io);
+
+	if (!success) {
+		SPDK_ERRLOG("Writing metadata page %" PRIu64 " of %s failed\n", page_idx, md->name);
+	} else if (md->ops->page_written != NULL) {
+		md->ops->page_written(md->ctx, page_idx);
+	}
+
+	md->writes++;
+	md->outstanding--;
+	page->writing = false;
+	TAILQ_CONCAT(&done, &page->inflight, link);
+	TAILQ_INSERT_TAIL(&md->free_bufs, md_buf, link);
+
+	while ((wait = TAILQ_FIRST(&done))) {
+		TAILQ_REMOVE(&done, wait, link);
+		wait->cb_fn(wait->ctx, success ? 0 : -EIO);
+	}
+
+	vbdev_md_page_write(md, page);
+	while (!TAILQ_EMPTY(&md->pages_waiting) && !TAILQ_EMPTY(&md->free_bufs)) {
+		page = TAILQ_FIRST(&md->pages_waiting);
+		TAILQ_REMOVE(&md->pages_waiting, page, link);
+		page->queued = false;
+		vbdev_md_page_write(md, page);
+	}
+}
+
+static void
+vbdev_md_write_submit(void *arg)
+{
+	struct spdk_vbdev_md_buf *md_buf = arg;
+	struct spdk_vbdev_md *md = md_buf->md;
+	int rc;
+
+	rc = spdk_bdev_write_blocks(md->desc, md->ch, md_buf->buf,
+				    md->offset + (md_buf->page - md->pages), 1,
+				    vbdev_md_write_done, md_buf);
+	if (rc == -ENOMEM) {
+		vbdev_md_queue_retry(md, &md_buf->bdev_io_wait, vbdev_md_write_submit, md_buf);
+	} else if (rc != 0) {
+		SPDK_ERRLOG("Could not write metadata of %s: %d\n", md->name, rc);
+		assert(false);
+	}
+}
+
+/*
+ * Write a page if anyone waits for it. Everyone waiting while a write is in
+ * progress is served by the next one.
+ */
+static void
+vbdev_md_page_write(struct spdk_vbdev_md *md, struct spdk_vbdev_md_page *page)
+{
+	struct spdk_vbdev_md_buf *md_buf;
+
+	if (page->writing || page->queued || TAILQ_EMPTY(&page->waiting)) {
+		return;
+	}
+
+	md_buf = TAILQ_FIRST(&md->free_bufs);
+	if (md_buf == NULL) {
+		page->queued = true;
+		TAILQ_INSERT_TAIL(&md->pages_waiting, page, link);
+		return;
+	}
+
+	TAILQ_REMOVE(&md->free_bufs, md_buf, link);
+	md_buf->page = page;
+	page->writing = true;
+	TAILQ_CONCAT(&page->inflight, &page->waiting, link);
+	md->ops->serialize_page(md->ctx, page - md->pages, md_buf->buf);
+
+	md->outstanding++;
+	vbdev_md_write_submit(md_buf);
+}
+
+void
+spdk_vbdev_md_update(struct spdk_vbdev_md *md, uint64_t page_idx,
+		     struct spdk_vbdev_md_wait *wait)
+{
+	struct spdk_vbdev_md_page *page = &md->pages[page_idx];
+
+	assert(page_idx < md->num_pages);
+	TAILQ_INSERT_TAIL(&page->waiting, wait, link);
+	vbdev_md_page_write(md, page);
+}
+
+/* All pages */
+
+static void vbdev_md_io_next(struct spdk_vbdev_md *md);
+
+static void
+vbdev_md_io_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct spdk_vbdev_md *md = cb_arg;
+	uint64_t num = spdk_min(SPDK_VBDEV_MD_IO_SIZE / md->block_size,
+				md->num_pages - md->io_page);
+	uint64_t i;
+	int rc;
+
+	spdk_bdev_free_io(bdev_io);
+
+	if (!success) {
+		md->io_cb(md->ctx, -EIO);
+		return;
+	}
+
+	if (!md->io_write) {
+		for (i = 0; i < num; i++) {
+			rc = md->ops->parse_page(md->ctx, md->io_page + i,
+						 (uint8_t *)md->io_buf + i * md->block_size);
+			if (rc != 0) {
+				md->io_cb(md->ctx, rc);
+				return;
+			}
+		}
+	}
+
+	md->io_page += num;
+	vbdev_md_io_next(md);
+}
+
+static void
+vbdev_md_io_next(struct spdk_vbdev_md *md)
+{
+	uint64_t num = spdk_min(SPDK_VBDEV_MD_IO_SIZE / md->block_size,
+				md->num_pages - md->io_page);
+	uint64_t i;
+	int rc;
+
+	if (num == 0) {
+		md->io_cb(md->ctx, 0);
+		return;
+	}
+
+	if (md->io_write) {
+		for (i = 0; i < num; i++) {
+			md->ops->serialize_page(md->ctx, md->io_page + i,
+						(uint8_t *)md->io_buf + i * md->block_size);
+		}
+		rc = spdk_bdev_write_blocks(md->desc, md->ch, md->io_buf, md->offset + md->io_page,
+					    num, vbdev_md_io_done, md);
+	} else {
+		rc = spdk_bdev_read_blocks(md->desc, md->ch, md->io_buf, md->offset + md->io_page,
+					   num, vbdev_md_io_done, md);
+	}
+
+	if (rc != 0) {
+		md->io_cb(md->ctx, rc);
+	}
+}
+
+void
+spdk_vbdev_md_io(struct spdk_vbdev_md *md, bool write, spdk_vbdev_md_cb cb)
+{
+	md->io_write = write;
+	md->io_page = 0;
+	md->io_cb = cb;
+	vbdev_md_io_next(md);
+}
+
+/* Superblock */
+
+static void
+vbdev_md_sb_read_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct spdk_vbdev_md *md = cb_arg;
+	struct spdk_vbdev_md_sb *sb = md->sb;
+	uint32_t crc;
+
+	spdk_bdev_free_io(bdev_io);
+
+	if (!success) {
+		md->io_cb(md->ctx, -EIO);
+		return;
+	}
+
+	if (memcmp(sb->magic, md->ops->magic, sizeof(sb->magic)) != 0) {
+		md->io_cb(md->ctx, -ENOENT);
+		return;
+	}
+
+	crc = sb->crc;
+	sb->crc = 0;
+	if (crc != spdk_crc32c_update(sb, md->ops->sb_size, 0) || sb->version != md->ops->version) {
+		SPDK_ERRLOG("The superblock of %s on %s is corrupted or of an unknown version\n",
+			    md->name, spdk_bdev_get_name(md->bdev));
+		md->io_cb(md->ctx, -EILSEQ);
+		return;
+	}
+
+	md->io_cb(md->ctx, 0);
+}
+
+void
+spdk_vbdev_md_sb_read(struct spdk_vbdev_md *md, spdk_vbdev_md_cb cb)
+{
+	int rc;
+
+	md->io_cb = cb;
+	rc = spdk_bdev_read_blocks(md->desc, md->ch, md->sb, 0, 1, vbdev_md_sb_read_done, md);
+	if (rc != 0) {
+		cb(md->ctx, rc);
+	}
+}
+
+static void
+vbdev_md_sb_write_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct spdk_vbdev_md *md = cb_arg;
+
+	spdk_bdev_free_io(bdev_io);
+	md->io_cb(md->ctx, success ? 0 : -EIO);
+}
+
+void
+spdk_vbdev_md_sb_write(struct spdk_vbdev_md *md, spdk_vbdev_md_cb cb)
+{
+	struct spdk_vbdev_md_sb *sb = md->sb;
+	int rc;
+
+	memcpy(sb->magic, md->ops->magic, sizeof(sb->magic));
+	sb->version = md->ops->version;
+	sb->crc = 0;
+	sb->crc = spdk_crc32c_update(sb, md->ops->sb_size, 0);
+
+	md->io_cb = cb;
+	rc = spdk_bdev_write_blocks(md->desc, md->ch, sb, 0, 1, vbdev_md_sb_write_done, md);
+	if (rc != 0) {
+		cb(md->ctx, rc);
+	}
+}
+
+/* Threading and shutdown */
+
+void
+spdk_vbdev_md_call(struct spdk_vbdev_md *md, spdk_msg_fn fn, void *arg)
+{
+	if (spdk_get_thread() != md->thread) {
+		spdk_thread_send_msg(md->thread, fn, arg);
+	} else {
+		fn(arg);
+	}
+}
+
+static int
+vbdev_md_drain_poll(void *arg)
+{
+	struct spdk_vbdev_md *md = arg;
+
+	if (*md->drain_outstanding > 0 || md->outstanding > 0) {
+		return 0;
+	}
+
+	spdk_poller_unregister(&md->drain_poller);
+	md->drain_cb(md->ctx, 0);
+
+	return 1;
+}
+
+void
+spdk_vbdev_md_drain(struct spdk_vbdev_md *md, const uint64_t *outstanding, spdk_vbdev_md_cb cb)
+{
+	md->drain_outstanding = outstanding;
+	md->drain_cb = cb;
+	md->drain_poller = SPDK_POLLER_REGISTER(vbdev_md_drain_poll, md, 1000);
+}
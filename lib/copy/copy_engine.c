@@ -35,11 +35,18 @@
 
 #include "spdk_internal/copy_engine.h"
 
+#include "spdk/crc32.h"
 #include "spdk/env.h"
 #include "spdk/event.h"
+#include "spdk/json.h"
 #include "spdk/log.h"
 #include "spdk/thread.h"
 
+#if defined(__x86_64__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define SPDK_HAVE_SSE2
+#endif
+
 static size_t g_max_copy_module_size = 0;
 
 static struct spdk_copy_engine *hw_copy_engine = NULL;
@@ -49,9 +56,60 @@ static struct spdk_copy_engine *mem_copy_engine = NULL;
 static TAILQ_HEAD(, spdk_copy_module_if) spdk_copy_module_list =
 	TAILQ_HEAD_INITIALIZER(spdk_copy_module_list);
 
+/* Number of batches per channel */
+#define COPY_CHANNEL_BATCHES	32
+
+/* The software engine computes the CRC32C of a copy while the chunk just copied is in cache */
+#define MEM_COPY_CRC32C_CHUNK	(16 * 1024)
+
+#define MEM_COPY_DEFAULT_CHUNK_SIZE	(64 * 1024)
+
+static struct spdk_copy_sw_opts g_sw_opts = {
+	.large_threshold = 0,
+	.chunk_size = MEM_COPY_DEFAULT_CHUNK_SIZE,
+};
+
+/* Large copy or fill the software engine carries out from its poller */
+struct mem_copy_task {
+	spdk_copy_completion_cb		cb;
+	uint8_t				*dst;
+	uint8_t				*src;
+	uint8_t				fill;
+	uint64_t			nbytes;
+	uint64_t			offset;
+	TAILQ_ENTRY(mem_copy_task)	link;
+};
+
+struct mem_io_channel {
+	TAILQ_HEAD(, mem_copy_task)	tasks;
+	struct spdk_poller		*poller;
+};
+
+struct copy_io_channel;
+
+struct spdk_copy_batch {
+	struct copy_io_channel		*copy_ch;
+	TAILQ_HEAD(, spdk_copy_task)	tasks;
+
+	/* Tasks submitted and not completed yet */
+	uint32_t			outstanding;
+	bool				submitting;
+	int				status;
+
+	spdk_copy_batch_cb		cb_fn;
+	void				*cb_arg;
+	TAILQ_ENTRY(spdk_copy_batch)	link;
+};
+
 struct copy_io_channel {
 	struct spdk_copy_engine	*engine;
 	struct spdk_io_channel	*ch;
+
+	/* Channel of the software engine, for operations the engine doesn't offer */
+	struct spdk_io_channel	*sw_ch;
+
+	struct spdk_copy_batch		batches[COPY_CHANNEL_BATCHES];
+	TAILQ_HEAD(, spdk_copy_batch)	free_batches;
 };
 
 static struct spdk_copy_module_if *g_copy_engine_module = NULL;
@@ -78,50 +136,439 @@ spdk_memcpy_unregister(void)
 	mem_copy_engine = NULL;
 }
 
+static void
+copy_batch_complete(struct spdk_copy_batch *batch)
+{
+	struct copy_io_channel	*copy_ch = batch->copy_ch;
+	spdk_copy_batch_cb	cb_fn = batch->cb_fn;
+	void			*cb_arg = batch->cb_arg;
+	int			status = batch->status;
+
+	TAILQ_INSERT_HEAD(&copy_ch->free_batches, batch, link);
+	cb_fn(cb_arg, status);
+}
+
 static void
 copy_engine_done(void *ref, int status)
 {
 	struct spdk_copy_task *req = (struct spdk_copy_task *)ref;
+	struct spdk_copy_batch *batch = req->batch;
 
+	/* The callback may reuse the task */
 	req->cb(req, status);
+
+	if (batch == NULL) {
+		return;
+	}
+
+	if (status != 0 && batch->status == 0) {
+		batch->status = status;
+	}
+	assert(batch->outstanding > 0);
+	batch->outstanding--;
+	if (batch->outstanding == 0 && !batch->submitting) {
+		copy_batch_complete(batch);
+	}
+}
+
+/*
+ * Hands a task to the engine of the channel, or to the software engine if the
+ * engine doesn't offer the operation. With build set, copies and fills are only
+ * queued by engines that can do so and *built tells whether this happened.
+ */
+static int
+copy_task_submit(struct copy_io_channel *copy_ch, struct spdk_copy_task *req, bool build,
+		 bool *built)
+{
+	struct spdk_copy_engine	*engine = copy_ch->engine;
+	struct spdk_io_channel	*ch = copy_ch->ch;
+
+	switch (req->op) {
+	case SPDK_COPY_OP_COPY:
+		if (build && engine->build_copy != NULL) {
+			*built = true;
+			return engine->build_copy(req->offload_ctx, ch, req->dst, req->src, req->nbytes,
+						  copy_engine_done);
+		}
+		return engine->copy(req->offload_ctx, ch, req->dst, req->src, req->nbytes,
+				    copy_engine_done);
+	case SPDK_COPY_OP_FILL:
+		if (build && engine->build_fill != NULL) {
+			*built = true;
+			return engine->build_fill(req->offload_ctx, ch, req->dst, req->fill, req->nbytes,
+						  copy_engine_done);
+		}
+		return engine->fill(req->offload_ctx, ch, req->dst, req->fill, req->nbytes,
+				    copy_engine_done);
+	case SPDK_COPY_OP_CRC32C:
+		if (engine->crc32c == NULL) {
+			engine = mem_copy_engine;
+			ch = copy_ch->sw_ch;
+		}
+		return engine->crc32c(req->offload_ctx, ch, req->crc_dst, req->src, req->seed,
+				      req->nbytes, copy_engine_done);
+	case SPDK_COPY_OP_COPY_CRC32C:
+		if (engine->copy_crc32c == NULL) {
+			engine = mem_copy_engine;
+			ch = copy_ch->sw_ch;
+		}
+		return engine->copy_crc32c(req->offload_ctx, ch, req->dst, req->src, req->crc_dst,
+					   req->seed, req->nbytes, copy_engine_done);
+	case SPDK_COPY_OP_COMPARE:
+		if (engine->compare == NULL) {
+			engine = mem_copy_engine;
+			ch = copy_ch->sw_ch;
+		}
+		return engine->compare(req->offload_ctx, ch, req->dst, req->src, req->nbytes,
+				       copy_engine_done);
+	case SPDK_COPY_OP_DUALCAST:
+		if (engine->dualcast == NULL) {
+			engine = mem_copy_engine;
+			ch = copy_ch->sw_ch;
+		}
+		return engine->dualcast(req->offload_ctx, ch, req->dst, req->dst2, req->src,
+					req->nbytes, copy_engine_done);
+	default:
+		assert(false);
+		return -EINVAL;
+	}
+}
+
+static void
+copy_task_init(struct spdk_copy_task *req, enum spdk_copy_op op, void *dst, void *dst2,
+	       void *src, uint64_t nbytes, spdk_copy_completion_cb cb)
+{
+	req->cb = cb;
+	req->batch = NULL;
+	req->op = op;
+	req->dst = dst;
+	req->dst2 = dst2;
+	req->src = src;
+	req->nbytes = nbytes;
+}
+
+static int
+copy_submit(struct spdk_io_channel *ch, struct spdk_copy_task *req)
+{
+	struct copy_io_channel	*copy_ch = spdk_io_channel_get_ctx(ch);
+	bool			built = false;
+
+	return copy_task_submit(copy_ch, req, false, &built);
 }
 
 int
 spdk_copy_submit(struct spdk_copy_task *copy_req, struct spdk_io_channel *ch,
 		 void *dst, void *src, uint64_t nbytes, spdk_copy_completion_cb cb)
 {
-	struct spdk_copy_task *req = copy_req;
-	struct copy_io_channel *copy_ch = spdk_io_channel_get_ctx(ch);
-
-	req->cb = cb;
-	return copy_ch->engine->copy(req->offload_ctx, copy_ch->ch, dst, src, nbytes,
-				     copy_engine_done);
+	copy_task_init(copy_req, SPDK_COPY_OP_COPY, dst, NULL, src, nbytes, cb);
+	return copy_submit(ch, copy_req);
 }
 
 int
 spdk_copy_submit_fill(struct spdk_copy_task *copy_req, struct spdk_io_channel *ch,
 		      void *dst, uint8_t fill, uint64_t nbytes, spdk_copy_completion_cb cb)
 {
-	struct spdk_copy_task *req = copy_req;
-	struct copy_io_channel *copy_ch = spdk_io_channel_get_ctx(ch);
+	copy_task_init(copy_req, SPDK_COPY_OP_FILL, dst, NULL, NULL, nbytes, cb);
+	copy_req->fill = fill;
+	return copy_submit(ch, copy_req);
+}
+
+int
+spdk_copy_submit_crc32c(struct spdk_copy_task *copy_req, struct spdk_io_channel *ch,
+			uint32_t *dst, void *src, uint32_t seed, uint64_t nbytes,
+			spdk_copy_completion_cb cb)
+{
+	copy_task_init(copy_req, SPDK_COPY_OP_CRC32C, NULL, NULL, src, nbytes, cb);
+	copy_req->crc_dst = dst;
+	copy_req->seed = seed;
+	return copy_submit(ch, copy_req);
+}
 
-	req->cb = cb;
-	return copy_ch->engine->fill(req->offload_ctx, copy_ch->ch, dst, fill, nbytes,
-				     copy_engine_done);
+int
+spdk_copy_submit_copy_crc32c(struct spdk_copy_task *copy_req, struct spdk_io_channel *ch,
+			     void *dst, void *src, uint32_t *crc_dst, uint32_t seed,
+			     uint64_t nbytes, spdk_copy_completion_cb cb)
+{
+	copy_task_init(copy_req, SPDK_COPY_OP_COPY_CRC32C, dst, NULL, src, nbytes, cb);
+	copy_req->crc_dst = crc_dst;
+	copy_req->seed = seed;
+	return copy_submit(ch, copy_req);
+}
+
+int
+spdk_copy_submit_compare(struct spdk_copy_task *copy_req, struct spdk_io_channel *ch,
+			 void *src1, void *src2, uint64_t nbytes, spdk_copy_completion_cb cb)
+{
+	copy_task_init(copy_req, SPDK_COPY_OP_COMPARE, src1, NULL, src2, nbytes, cb);
+	return copy_submit(ch, copy_req);
+}
+
+int
+spdk_copy_submit_dualcast(struct spdk_copy_task *copy_req, struct spdk_io_channel *ch,
+			  void *dst1, void *dst2, void *src, uint64_t nbytes,
+			  spdk_copy_completion_cb cb)
+{
+	copy_task_init(copy_req, SPDK_COPY_OP_DUALCAST, dst1, dst2, src, nbytes, cb);
+	return copy_submit(ch, copy_req);
+}
+
+struct spdk_copy_batch *
+spdk_copy_batch_create(struct spdk_io_channel *ch)
+{
+	struct copy_io_channel	*copy_ch = spdk_io_channel_get_ctx(ch);
+	struct spdk_copy_batch	*batch;
+
+	batch = TAILQ_FIRST(&copy_ch->free_batches);
+	if (batch == NULL) {
+		return NULL;
+	}
+
+	TAILQ_REMOVE(&copy_ch->free_batches, batch, link);
+	TAILQ_INIT(&batch->tasks);
+	batch->outstanding = 0;
+	batch->submitting = false;
+	batch->status = 0;
+
+	return batch;
+}
+
+static int
+copy_batch_add(struct spdk_copy_batch *batch, struct spdk_copy_task *req)
+{
+	if (batch == NULL || batch->submitting) {
+		return -EINVAL;
+	}
+
+	req->batch = batch;
+	TAILQ_INSERT_TAIL(&batch->tasks, req, link);
+	return 0;
+}
+
+int
+spdk_copy_batch_prep_copy(struct spdk_copy_batch *batch, struct spdk_copy_task *copy_req,
+			  void *dst, void *src, uint64_t nbytes, spdk_copy_completion_cb cb)
+{
+	copy_task_init(copy_req, SPDK_COPY_OP_COPY, dst, NULL, src, nbytes, cb);
+	return copy_batch_add(batch, copy_req);
+}
+
+int
+spdk_copy_batch_prep_fill(struct spdk_copy_batch *batch, struct spdk_copy_task *copy_req,
+			  void *dst, uint8_t fill, uint64_t nbytes, spdk_copy_completion_cb cb)
+{
+	copy_task_init(copy_req, SPDK_COPY_OP_FILL, dst, NULL, NULL, nbytes, cb);
+	copy_req->fill = fill;
+	return copy_batch_add(batch, copy_req);
+}
+
+int
+spdk_copy_batch_prep_crc32c(struct spdk_copy_batch *batch, struct spdk_copy_task *copy_req,
+			    uint32_t *dst, void *src, uint32_t seed, uint64_t nbytes,
+			    spdk_copy_completion_cb cb)
+{
+	copy_task_init(copy_req, SPDK_COPY_OP_CRC32C, NULL, NULL, src, nbytes, cb);
+	copy_req->crc_dst = dst;
+	copy_req->seed = seed;
+	return copy_batch_add(batch, copy_req);
+}
+
+int
+spdk_copy_batch_prep_compare(struct spdk_copy_batch *batch, struct spdk_copy_task *copy_req,
+			     void *src1, void *src2, uint64_t nbytes, spdk_copy_completion_cb cb)
+{
+	copy_task_init(copy_req, SPDK_COPY_OP_COMPARE, src1, NULL, src2, nbytes, cb);
+	return copy_batch_add(batch, copy_req);
+}
+
+int
+spdk_copy_batch_prep_dualcast(struct spdk_copy_batch *batch, struct spdk_copy_task *copy_req,
+			      void *dst1, void *dst2, void *src, uint64_t nbytes,
+			      spdk_copy_completion_cb cb)
+{
+	copy_task_init(copy_req, SPDK_COPY_OP_DUALCAST, dst1, dst2, src, nbytes, cb);
+	return copy_batch_add(batch, copy_req);
+}
+
+int
+spdk_copy_batch_submit(struct spdk_copy_batch *batch, spdk_copy_batch_cb cb_fn, void *cb_arg)
+{
+	struct copy_io_channel	*copy_ch = batch->copy_ch;
+	struct spdk_copy_task	*req;
+	bool			built = false;
+	int			rc;
+
+	if (TAILQ_EMPTY(&batch->tasks)) {
+		return -EINVAL;
+	}
+
+	batch->cb_fn = cb_fn;
+	batch->cb_arg = cb_arg;
+	batch->submitting = true;
+
+	while ((req = TAILQ_FIRST(&batch->tasks)) != NULL) {
+		TAILQ_REMOVE(&batch->tasks, req, link);
+		batch->outstanding++;
+		rc = copy_task_submit(copy_ch, req, true, &built);
+		if (rc != 0) {
+			copy_engine_done(req, rc);
+		}
+	}
+
+	/* Hand everything that was queued to the hardware at once */
+	if (built) {
+		copy_ch->engine->flush(copy_ch->ch);
+	}
+
+	batch->submitting = false;
+	if (batch->outstanding == 0) {
+		copy_batch_complete(batch);
+	}
+
+	return 0;
+}
+
+void
+spdk_copy_batch_cancel(struct spdk_copy_batch *batch)
+{
+	struct copy_io_channel *copy_ch = batch->copy_ch;
+
+	assert(!batch->submitting && batch->outstanding == 0);
+	TAILQ_INIT(&batch->tasks);
+	TAILQ_INSERT_HEAD(&copy_ch->free_batches, batch, link);
 }
 
 /* memcpy default copy engine */
+static inline struct spdk_copy_task *
+mem_copy_task(void *cb_arg)
+{
+	return (struct spdk_copy_task *)((uintptr_t)cb_arg - offsetof(struct spdk_copy_task, offload_ctx));
+}
+
+/*
+ * Copy with stores that bypass the cache, so a large copy doesn't evict the working
+ * set of everything else running on the core.
+ */
+static void
+mem_copy_nt(uint8_t *dst, const uint8_t *src, uint64_t nbytes)
+{
+#ifdef SPDK_HAVE_SSE2
+	uint64_t head = spdk_min((16 - ((uintptr_t)dst & 15)) & 15, nbytes);
+	__m128i x0, x1, x2, x3;
+
+	memcpy(dst, src, head);
+	dst += head;
+	src += head;
+	nbytes -= head;
+
+	for (; nbytes >= 64; nbytes -= 64, dst += 64, src += 64) {
+		x0 = _mm_loadu_si128((const __m128i *)src);
+		x1 = _mm_loadu_si128((const __m128i *)(src + 16));
+		x2 = _mm_loadu_si128((const __m128i *)(src + 32));
+		x3 = _mm_loadu_si128((const __m128i *)(src + 48));
+		_mm_stream_si128((__m128i *)dst, x0);
+		_mm_stream_si128((__m128i *)(dst + 16), x1);
+		_mm_stream_si128((__m128i *)(dst + 32), x2);
+		_mm_stream_si128((__m128i *)(dst + 48), x3);
+	}
+
+	memcpy(dst, src, nbytes);
+	_mm_sfence();
+#else
+	memcpy(dst, src, nbytes);
+#endif
+}
+
+static void
+mem_fill_nt(uint8_t *dst, uint8_t fill, uint64_t nbytes)
+{
+#ifdef SPDK_HAVE_SSE2
+	uint64_t head = spdk_min((16 - ((uintptr_t)dst & 15)) & 15, nbytes);
+	__m128i x = _mm_set1_epi8((char)fill);
+
+	memset(dst, fill, head);
+	dst += head;
+	nbytes -= head;
+
+	for (; nbytes >= 64; nbytes -= 64, dst += 64) {
+		_mm_stream_si128((__m128i *)dst, x);
+		_mm_stream_si128((__m128i *)(dst + 16), x);
+		_mm_stream_si128((__m128i *)(dst + 32), x);
+		_mm_stream_si128((__m128i *)(dst + 48), x);
+	}
+
+	memset(dst, fill, nbytes);
+	_mm_sfence();
+#else
+	memset(dst, fill, nbytes);
+#endif
+}
+
+static int
+mem_copy_poll(void *arg)
+{
+	struct mem_io_channel	*mem_ch = arg;
+	struct mem_copy_task	*task;
+	uint64_t		budget = g_sw_opts.chunk_size;
+	uint64_t		len;
+
+	while (budget > 0 && (task = TAILQ_FIRST(&mem_ch->tasks)) != NULL) {
+		len = spdk_min(task->nbytes - task->offset, budget);
+		if (task->src != NULL) {
+			mem_copy_nt(task->dst + task->offset, task->src + task->offset, len);
+		} else {
+			mem_fill_nt(task->dst + task->offset, task->fill, len);
+		}
+		task->offset += len;
+		budget -= len;
+
+		if (task->offset == task->nbytes) {
+			TAILQ_REMOVE(&mem_ch->tasks, task, link);
+			task->cb(mem_copy_task(task), 0);
+		}
+	}
+
+	if (TAILQ_EMPTY(&mem_ch->tasks)) {
+		spdk_poller_unregister(&mem_ch->poller);
+	}
+
+	return 1;
+}
+
+static void
+mem_copy_queue(struct spdk_io_channel *ch, struct mem_copy_task *task)
+{
+	struct mem_io_channel *mem_ch = spdk_io_channel_get_ctx(ch);
+
+	task->offset = 0;
+	TAILQ_INSERT_TAIL(&mem_ch->tasks, task, link);
+	if (mem_ch->poller == NULL) {
+		mem_ch->poller = SPDK_POLLER_REGISTER(mem_copy_poll, mem_ch, 0);
+	}
+}
+
+static inline bool
+mem_copy_is_large(uint64_t nbytes)
+{
+	return g_sw_opts.large_threshold != 0 && nbytes >= g_sw_opts.large_threshold;
+}
+
 static int
 mem_copy_submit(void *cb_arg, struct spdk_io_channel *ch, void *dst, void *src, uint64_t nbytes,
 		spdk_copy_completion_cb cb)
 {
-	struct spdk_copy_task *copy_req;
+	struct mem_copy_task *task = cb_arg;
+
+	if (mem_copy_is_large(nbytes)) {
+		task->cb = cb;
+		task->dst = dst;
+		task->src = src;
+		task->nbytes = nbytes;
+		mem_copy_queue(ch, task);
+		return 0;
+	}
 
 	memcpy(dst, src, (size_t)nbytes);
-
-	copy_req = (struct spdk_copy_task *)((uintptr_t)cb_arg -
-					     offsetof(struct spdk_copy_task, offload_ctx));
-	cb(copy_req, 0);
+	cb(mem_copy_task(cb_arg), 0);
 	return 0;
 }
 
@@ -129,12 +576,67 @@ static int
 mem_copy_fill(void *cb_arg, struct spdk_io_channel *ch, void *dst, uint8_t fill, uint64_t nbytes,
 	      spdk_copy_completion_cb cb)
 {
-	struct spdk_copy_task *copy_req;
+	struct mem_copy_task *task = cb_arg;
+
+	if (mem_copy_is_large(nbytes)) {
+		task->cb = cb;
+		task->dst = dst;
+		task->src = NULL;
+		task->fill = fill;
+		task->nbytes = nbytes;
+		mem_copy_queue(ch, task);
+		return 0;
+	}
 
 	memset(dst, fill, nbytes);
-	copy_req = (struct spdk_copy_task *)((uintptr_t)cb_arg -
-					     offsetof(struct spdk_copy_task, offload_ctx));
-	cb(copy_req, 0);
+	cb(mem_copy_task(cb_arg), 0);
+	return 0;
+}
+
+static int
+mem_copy_crc32c(void *cb_arg, struct spdk_io_channel *ch, uint32_t *dst, void *src,
+		uint32_t seed, uint64_t nbytes, spdk_copy_completion_cb cb)
+{
+	*dst = spdk_crc32c_update(src, nbytes, seed);
+	cb(mem_copy_task(cb_arg), 0);
+
+	return 0;
+}
+
+static int
+mem_copy_copy_crc32c(void *cb_arg, struct spdk_io_channel *ch, void *dst, void *src,
+		     uint32_t *crc_dst, uint32_t seed, uint64_t nbytes, spdk_copy_completion_cb cb)
+{
+	uint32_t	crc = seed;
+	uint64_t	offset, len;
+
+	for (offset = 0; offset < nbytes; offset += len) {
+		len = spdk_min(nbytes - offset, MEM_COPY_CRC32C_CHUNK);
+		memcpy((uint8_t *)dst + offset, (uint8_t *)src + offset, len);
+		crc = spdk_crc32c_update((uint8_t *)dst + offset, len, crc);
+	}
+	*crc_dst = crc;
+	cb(mem_copy_task(cb_arg), 0);
+
+	return 0;
+}
+
+static int
+mem_copy_compare(void *cb_arg, struct spdk_io_channel *ch, void *src1, void *src2,
+		 uint64_t nbytes, spdk_copy_completion_cb cb)
+{
+	cb(mem_copy_task(cb_arg), memcmp(src1, src2, nbytes) == 0 ? 0 : -EILSEQ);
+
+	return 0;
+}
+
+static int
+mem_copy_dualcast(void *cb_arg, struct spdk_io_channel *ch, void *dst1, void *dst2, void *src,
+		  uint64_t nbytes, spdk_copy_completion_cb cb)
+{
+	memcpy(dst1, src, nbytes);
+	memcpy(dst2, src, nbytes);
+	cb(mem_copy_task(cb_arg), 0);
 
 	return 0;
 }
@@ -144,18 +646,30 @@ static struct spdk_io_channel *mem_get_io_channel(void);
 static struct spdk_copy_engine memcpy_copy_engine = {
 	.copy		= mem_copy_submit,
 	.fill		= mem_copy_fill,
+	.crc32c		= mem_copy_crc32c,
+	.copy_crc32c	= mem_copy_copy_crc32c,
+	.compare	= mem_copy_compare,
+	.dualcast	= mem_copy_dualcast,
 	.get_io_channel	= mem_get_io_channel,
 };
 
 static int
 memcpy_create_cb(void *io_device, void *ctx_buf)
 {
+	struct mem_io_channel *mem_ch = ctx_buf;
+
+	TAILQ_INIT(&mem_ch->tasks);
+	mem_ch->poller = NULL;
 	return 0;
 }
 
 static void
 memcpy_destroy_cb(void *io_device, void *ctx_buf)
 {
+	struct mem_io_channel *mem_ch = ctx_buf;
+
+	assert(TAILQ_EMPTY(&mem_ch->tasks));
+	spdk_poller_unregister(&mem_ch->poller);
 }
 
 static struct spdk_io_channel *mem_get_io_channel(void)
@@ -166,7 +680,7 @@ static struct spdk_io_channel *mem_get_io_channel(void)
 static size_t
 copy_engine_mem_get_ctx_size(void)
 {
-	return sizeof(struct spdk_copy_task);
+	return sizeof(struct mem_copy_task) + sizeof(struct spdk_copy_task);
 }
 
 size_t
@@ -187,6 +701,16 @@ static int
 copy_create_cb(void *io_device, void *ctx_buf)
 {
 	struct copy_io_channel	*copy_ch = ctx_buf;
+	int			i;
+
+	TAILQ_INIT(&copy_ch->free_batches);
+	for (i = 0; i < COPY_CHANNEL_BATCHES; i++) {
+		copy_ch->batches[i].copy_ch = copy_ch;
+		TAILQ_INSERT_TAIL(&copy_ch->free_batches, &copy_ch->batches[i], link);
+	}
+
+	copy_ch->sw_ch = mem_copy_engine->get_io_channel();
+	assert(copy_ch->sw_ch != NULL);
 
 	if (hw_copy_engine != NULL) {
 		copy_ch->ch = hw_copy_engine->get_io_channel();
@@ -196,8 +720,7 @@ copy_create_cb(void *io_device, void *ctx_buf)
 		}
 	}
 
-	copy_ch->ch = mem_copy_engine->get_io_channel();
-	assert(copy_ch->ch != NULL);
+	copy_ch->ch = copy_ch->sw_ch;
 	copy_ch->engine = mem_copy_engine;
 	return 0;
 }
@@ -207,7 +730,10 @@ copy_destroy_cb(void *io_device, void *ctx_buf)
 {
 	struct copy_io_channel	*copy_ch = ctx_buf;
 
-	spdk_put_io_channel(copy_ch->ch);
+	if (copy_ch->ch != copy_ch->sw_ch) {
+		spdk_put_io_channel(copy_ch->ch);
+	}
+	spdk_put_io_channel(copy_ch->sw_ch);
 }
 
 struct spdk_io_channel *
@@ -220,8 +746,8 @@ static int
 copy_engine_mem_init(void)
 {
 	spdk_memcpy_register(&memcpy_copy_engine);
-	spdk_io_device_register(&memcpy_copy_engine, memcpy_create_cb, memcpy_destroy_cb, 0,
-				"memcpy_engine");
+	spdk_io_device_register(&memcpy_copy_engine, memcpy_create_cb, memcpy_destroy_cb,
+				sizeof(struct mem_io_channel), "memcpy_engine");
 
 	return 0;
 }
@@ -302,6 +828,39 @@ spdk_copy_engine_finish(spdk_copy_fini_cb cb_fn, void *cb_arg)
 	spdk_copy_engine_module_finish();
 }
 
+void
+spdk_copy_engine_get_sw_opts(struct spdk_copy_sw_opts *opts)
+{
+	*opts = g_sw_opts;
+}
+
+int
+spdk_copy_engine_set_sw_opts(const struct spdk_copy_sw_opts *opts)
+{
+	if (opts->chunk_size == 0) {
+		return -EINVAL;
+	}
+
+	g_sw_opts = *opts;
+	return 0;
+}
+
+void
+spdk_copy_engine_write_config_json(struct spdk_json_write_ctx *w)
+{
+	spdk_json_write_array_begin(w);
+
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_string(w, "method", "copy_set_sw_options");
+	spdk_json_write_named_object_begin(w, "params");
+	spdk_json_write_named_uint64(w, "large_threshold", g_sw_opts.large_threshold);
+	spdk_json_write_named_uint64(w, "chunk_size", g_sw_opts.chunk_size);
+	spdk_json_write_object_end(w);
+	spdk_json_write_object_end(w);
+
+	spdk_json_write_array_end(w);
+}
+
 void
 spdk_copy_engine_config_text(FILE *fp)
 {
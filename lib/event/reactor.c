@@ -41,10 +41,14 @@
 #include "spdk/log.h"
 #include "spdk/thread.h"
 #include "spdk/env.h"
+#include "spdk/string.h"
 #include "spdk/util.h"
 
 #ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/prctl.h>
+#include <sys/timerfd.h>
 #endif
 
 #ifdef __FreeBSD__
@@ -52,6 +56,10 @@
 #endif
 
 #define SPDK_EVENT_BATCH_SIZE		8
+#define SPDK_SCHEDULER_PERIOD_USEC	(1000 * 1000)
+#define SPDK_REACTOR_IDLE_PCT		10
+#define SPDK_REACTOR_MIGRATION_HISTORY	64
+#define SPDK_REACTOR_INTERRUPT_IDLE_USEC	1000
 
 enum spdk_reactor_state {
 	SPDK_REACTOR_STATE_UNINITIALIZED = 0,
@@ -63,6 +71,16 @@ enum spdk_reactor_state {
 
 struct spdk_lw_thread {
 	TAILQ_ENTRY(spdk_lw_thread)	link;
+
+	/* Identifies the thread in the load reports passed to the scheduler. */
+	uint64_t			id;
+
+	/* Cumulative stats of the thread at the last sample. */
+	struct spdk_thread_stats	last_stats;
+
+	/* Busy and idle time of the thread in the period before the last sample. */
+	uint64_t			busy_tsc;
+	uint64_t			idle_tsc;
 };
 
 struct spdk_reactor {
@@ -81,8 +99,52 @@ struct spdk_reactor {
 
 	/* The last known rusage values */
 	struct rusage					rusage;
+
+	/*
+	 * Time of the last load sample, and the busy and idle time of the threads
+	 *  on this reactor in the period before it. Other reactors read busy_tsc
+	 *  and busy_threads without synchronization when looking for threads to
+	 *  steal, so they are only a hint to them.
+	 */
+	uint64_t					last_sample_tsc;
+	uint64_t					busy_tsc;
+	uint64_t					idle_tsc;
+	uint32_t					busy_threads;
+
+	/*
+	 * In interrupt mode, a reactor whose threads did no work since last_busy_tsc
+	 *  for the idle period blocks on epoll_fd. That holds events_fd, signaled
+	 *  by spdk_event_call() while sleeping is set, timer_fd, armed for the next
+	 *  timed poller, and the wakeup fds of its threads. The fds are -1 if they
+	 *  could not be created, and the reactor then never sleeps.
+	 */
+	bool						sleeping;
+	int						epoll_fd;
+	int						events_fd;
+	int						timer_fd;
+	uint64_t					last_busy_tsc;
+	uint64_t					sleep_count;
+	uint64_t					sleep_tsc;
 } __attribute__((aligned(64)));
 
+/* A load sample of all reactors and threads, passed from reactor to reactor. */
+struct spdk_scheduler_ctx {
+	struct spdk_scheduler			*scheduler;
+
+	struct spdk_scheduler_core_info		*cores;
+	uint32_t				core_count;
+
+	struct spdk_scheduler_thread_info	*threads;
+	uint32_t				thread_count;
+	uint32_t				max_threads;
+
+	/* Set if memory for the sample could not be allocated. */
+	bool					failed;
+
+	/* Number of reactors that have not applied the decisions yet. */
+	uint32_t				outstanding;
+};
+
 static struct spdk_reactor *g_reactors;
 static struct spdk_cpuset *g_reactor_core_mask;
 static enum spdk_reactor_state	g_reactor_state = SPDK_REACTOR_STATE_UNINITIALIZED;
@@ -91,6 +153,81 @@ static bool g_framework_monitor_context_switch_enabled = true;
 
 static struct spdk_mempool *g_spdk_event_mempool = NULL;
 
+static pthread_mutex_t g_scheduler_mtx = PTHREAD_MUTEX_INITIALIZER;
+static TAILQ_HEAD(, spdk_scheduler) g_scheduler_list = TAILQ_HEAD_INITIALIZER(g_scheduler_list);
+
+/* NULL selects the static policy, even if the "static" scheduler is not linked in. */
+static struct spdk_scheduler *g_scheduler = NULL;
+static uint64_t g_scheduler_period_usec = SPDK_SCHEDULER_PERIOD_USEC;
+static uint64_t g_scheduler_period_tsc;
+
+/* The reactor that starts balancing every period, and whether it is in progress. */
+static uint32_t g_scheduling_lcore = UINT32_MAX;
+static bool g_scheduling_in_progress = false;
+
+static bool g_interrupt_mode = false;
+static uint64_t g_interrupt_idle_usec = SPDK_REACTOR_INTERRUPT_IDLE_USEC;
+static uint64_t g_interrupt_idle_tsc;
+
+/* Protected by g_scheduler_mtx. */
+static uint64_t g_next_thread_id = 0;
+static uint64_t g_scheduler_migrations = 0;
+static uint64_t g_scheduler_steals = 0;
+static struct spdk_reactor_migration g_migrations[SPDK_REACTOR_MIGRATION_HISTORY];
+static uint32_t g_migrations_count = 0;
+static uint32_t g_migrations_next = 0;
+
+static void
+spdk_reactor_interrupt_fini(struct spdk_reactor *reactor)
+{
+	if (reactor->timer_fd >= 0) {
+		close(reactor->timer_fd);
+		reactor->timer_fd = -1;
+	}
+	if (reactor->events_fd >= 0) {
+		close(reactor->events_fd);
+		reactor->events_fd = -1;
+	}
+	if (reactor->epoll_fd >= 0) {
+		close(reactor->epoll_fd);
+		reactor->epoll_fd = -1;
+	}
+}
+
+static void
+spdk_reactor_interrupt_init(struct spdk_reactor *reactor)
+{
+#ifdef __linux__
+	struct epoll_event event = {};
+#endif
+
+	reactor->epoll_fd = -1;
+	reactor->events_fd = -1;
+	reactor->timer_fd = -1;
+
+#ifdef __linux__
+	reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	reactor->events_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	reactor->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (reactor->epoll_fd < 0 || reactor->events_fd < 0 || reactor->timer_fd < 0) {
+		goto err;
+	}
+
+	event.events = EPOLLIN;
+	if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->events_fd, &event) != 0 ||
+	    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, reactor->timer_fd, &event) != 0) {
+		goto err;
+	}
+
+	return;
+
+err:
+	SPDK_WARNLOG("Unable to set up interrupt mode for reactor %u: %s\n", reactor->lcore,
+		     spdk_strerror(errno));
+	spdk_reactor_interrupt_fini(reactor);
+#endif
+}
+
 static void
 spdk_reactor_construct(struct spdk_reactor *reactor, uint32_t lcore)
 {
@@ -101,6 +238,8 @@ spdk_reactor_construct(struct spdk_reactor *reactor, uint32_t lcore)
 
 	reactor->events = spdk_ring_create(SPDK_RING_TYPE_MP_SC, 65536, SPDK_ENV_SOCKET_ID_ANY);
 	assert(reactor->events != NULL);
+
+	spdk_reactor_interrupt_init(reactor);
 }
 
 static struct spdk_reactor *
@@ -156,6 +295,9 @@ spdk_reactors_init(void)
 
 	memset(g_reactors, 0, (last_core + 1) * sizeof(struct spdk_reactor));
 
+	g_scheduler_period_tsc = g_scheduler_period_usec * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
+	g_interrupt_idle_tsc = g_interrupt_idle_usec * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
+
 	spdk_thread_lib_init(spdk_reactor_schedule_thread, sizeof(struct spdk_lw_thread));
 
 	SPDK_ENV_FOREACH_CORE(i) {
@@ -184,6 +326,9 @@ spdk_reactors_fini(void)
 		if (spdk_likely(reactor != NULL) && reactor->events != NULL) {
 			spdk_ring_free(reactor->events);
 		}
+		if (spdk_likely(reactor != NULL)) {
+			spdk_reactor_interrupt_fini(reactor);
+		}
 	}
 
 	spdk_mempool_free(g_spdk_event_mempool);
@@ -192,6 +337,51 @@ spdk_reactors_fini(void)
 	g_reactors = NULL;
 }
 
+static void
+_spdk_reactor_wakeup(struct spdk_reactor *reactor)
+{
+	uint64_t count = 1;
+
+	if (reactor->events_fd >= 0 && write(reactor->events_fd, &count, sizeof(count)) < 0) {
+		SPDK_ERRLOG("Unable to wake up reactor %u: %s\n", reactor->lcore, spdk_strerror(errno));
+	}
+}
+
+static void
+_spdk_reactor_add_thread(struct spdk_reactor *reactor, struct spdk_lw_thread *lw_thread)
+{
+#ifdef __linux__
+	struct epoll_event event = {};
+	int fd;
+
+	fd = spdk_thread_get_wakeup_fd(spdk_thread_get_from_ctx(lw_thread));
+	if (reactor->epoll_fd >= 0 && fd >= 0) {
+		event.events = EPOLLIN;
+		if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+			SPDK_ERRLOG("Unable to add thread wakeup fd to reactor %u: %s\n", reactor->lcore,
+				    spdk_strerror(errno));
+		}
+	}
+#endif
+
+	TAILQ_INSERT_TAIL(&reactor->threads, lw_thread, link);
+}
+
+static void
+_spdk_reactor_remove_thread(struct spdk_reactor *reactor, struct spdk_lw_thread *lw_thread)
+{
+#ifdef __linux__
+	int fd;
+
+	fd = spdk_thread_get_wakeup_fd(spdk_thread_get_from_ctx(lw_thread));
+	if (reactor->epoll_fd >= 0 && fd >= 0) {
+		epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+	}
+#endif
+
+	TAILQ_REMOVE(&reactor->threads, lw_thread, link);
+}
+
 struct spdk_event *
 spdk_event_allocate(uint32_t lcore, spdk_event_fn fn, void *arg1, void *arg2)
 {
@@ -232,6 +422,11 @@ spdk_event_call(struct spdk_event *event)
 	if (rc != 1) {
 		assert(false);
 	}
+
+	/* Pairs with the check in _spdk_reactor_sleep(). */
+	if (spdk_unlikely(__atomic_load_n(&reactor->sleeping, __ATOMIC_SEQ_CST))) {
+		_spdk_reactor_wakeup(reactor);
+	}
 }
 
 static inline uint32_t
@@ -320,6 +515,539 @@ spdk_reactor_framework_monitor_context_switch_enabled(void)
 	return g_framework_monitor_context_switch_enabled;
 }
 
+void
+spdk_scheduler_register(struct spdk_scheduler *scheduler)
+{
+	TAILQ_INSERT_TAIL(&g_scheduler_list, scheduler, link);
+}
+
+int
+spdk_reactor_set_scheduler(const char *name, uint64_t period_usec)
+{
+	struct spdk_scheduler *scheduler;
+
+	TAILQ_FOREACH(scheduler, &g_scheduler_list, link) {
+		if (strcmp(scheduler->name, name) == 0) {
+			break;
+		}
+	}
+
+	if (scheduler == NULL) {
+		SPDK_ERRLOG("Scheduler %s not found\n", name);
+		return -ENOENT;
+	}
+
+	/* Reactors read these without a lock, but a stale value for one period does no harm. */
+	if (period_usec != 0) {
+		g_scheduler_period_usec = period_usec;
+		g_scheduler_period_tsc = period_usec * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
+	}
+	g_scheduler = scheduler;
+
+	SPDK_NOTICELOG("Using %s scheduler with a period of %" PRIu64 " us\n", scheduler->name,
+		       g_scheduler_period_usec);
+
+	return 0;
+}
+
+void
+spdk_reactor_get_scheduler_info(struct spdk_reactor_scheduler_info *info)
+{
+	struct spdk_scheduler *scheduler = g_scheduler;
+
+	info->name = scheduler != NULL ? scheduler->name : "static";
+	info->period_usec = g_scheduler_period_usec;
+
+	pthread_mutex_lock(&g_scheduler_mtx);
+	info->migrations = g_scheduler_migrations;
+	info->steals = g_scheduler_steals;
+	pthread_mutex_unlock(&g_scheduler_mtx);
+}
+
+uint32_t
+spdk_reactor_get_migrations(struct spdk_reactor_migration *migrations, uint32_t max_migrations)
+{
+	uint32_t i, count, idx;
+
+	pthread_mutex_lock(&g_scheduler_mtx);
+	count = spdk_min(max_migrations, g_migrations_count);
+	for (i = 0; i < count; i++) {
+		idx = (g_migrations_next + SPDK_REACTOR_MIGRATION_HISTORY - 1 - i) %
+		      SPDK_REACTOR_MIGRATION_HISTORY;
+		migrations[i] = g_migrations[idx];
+	}
+	pthread_mutex_unlock(&g_scheduler_mtx);
+
+	return count;
+}
+
+static void _schedule_thread(void *arg1, void *arg2);
+
+/* Moves a thread off this reactor. Must be called on the reactor the thread runs on. */
+static void
+_spdk_reactor_migrate_thread(struct spdk_reactor *reactor, struct spdk_lw_thread *lw_thread,
+			     uint32_t lcore, bool stolen)
+{
+	struct spdk_thread *thread = spdk_thread_get_from_ctx(lw_thread);
+	struct spdk_reactor_migration *migration;
+	struct spdk_event *evt;
+
+	if (g_reactor_state != SPDK_REACTOR_STATE_RUNNING || spdk_reactor_get(lcore) == NULL ||
+	    !spdk_cpuset_get_cpu(spdk_thread_get_cpumask(thread), lcore)) {
+		return;
+	}
+
+	evt = spdk_event_allocate(lcore, _schedule_thread, lw_thread, NULL);
+	if (evt == NULL) {
+		return;
+	}
+
+	_spdk_reactor_remove_thread(reactor, lw_thread);
+
+	SPDK_DEBUGLOG(SPDK_LOG_REACTOR, "Moving thread %s from reactor %u to %u\n",
+		      spdk_thread_get_name(thread), reactor->lcore, lcore);
+
+	pthread_mutex_lock(&g_scheduler_mtx);
+	if (stolen) {
+		g_scheduler_steals++;
+	} else {
+		g_scheduler_migrations++;
+	}
+	migration = &g_migrations[g_migrations_next];
+	snprintf(migration->thread_name, sizeof(migration->thread_name), "%s",
+		 spdk_thread_get_name(thread));
+	migration->src_lcore = reactor->lcore;
+	migration->dst_lcore = lcore;
+	migration->stolen = stolen;
+	migration->tsc = spdk_get_ticks();
+	g_migrations_next = (g_migrations_next + 1) % SPDK_REACTOR_MIGRATION_HISTORY;
+	g_migrations_count = spdk_min(g_migrations_count + 1, SPDK_REACTOR_MIGRATION_HISTORY);
+	pthread_mutex_unlock(&g_scheduler_mtx);
+
+	spdk_event_call(evt);
+}
+
+static void
+_spdk_scheduler_ctx_free(struct spdk_scheduler_ctx *ctx)
+{
+	free(ctx->cores);
+	free(ctx->threads);
+	free(ctx);
+}
+
+static void
+_spdk_reactors_balance_done(void *arg1, void *arg2)
+{
+	_spdk_scheduler_ctx_free(arg1);
+	g_scheduling_in_progress = false;
+}
+
+/* Runs on each reactor to move the threads that the scheduler placed elsewhere. */
+static void
+_spdk_reactors_apply(void *arg1, void *arg2)
+{
+	struct spdk_scheduler_ctx *ctx = arg1;
+	struct spdk_scheduler_core_info *core = arg2;
+	struct spdk_scheduler_thread_info *info;
+	struct spdk_reactor *reactor;
+	struct spdk_lw_thread *lw_thread, *tmp;
+	struct spdk_event *evt;
+	uint32_t i;
+
+	reactor = spdk_reactor_get(core->lcore);
+	assert(reactor != NULL);
+
+	TAILQ_FOREACH_SAFE(lw_thread, &reactor->threads, link, tmp) {
+		for (i = core->threads_start; i < core->threads_start + core->thread_count; i++) {
+			info = &ctx->threads[i];
+			if (info->id == lw_thread->id) {
+				if (info->new_lcore != reactor->lcore) {
+					_spdk_reactor_migrate_thread(reactor, lw_thread, info->new_lcore, false);
+				}
+				break;
+			}
+		}
+	}
+
+	if (__atomic_sub_fetch(&ctx->outstanding, 1, __ATOMIC_SEQ_CST) == 0) {
+		evt = spdk_event_allocate(g_scheduling_lcore, _spdk_reactors_balance_done, ctx, NULL);
+		spdk_event_call(evt);
+	}
+}
+
+/* Runs on the scheduling reactor once every reactor has reported its load. */
+static void
+_spdk_reactors_balance(void *arg1, void *arg2)
+{
+	struct spdk_scheduler_ctx *ctx = arg1;
+	struct spdk_event *evt;
+	uint32_t i, moves = 0;
+
+	if (!ctx->failed) {
+		ctx->scheduler->balance(ctx->cores, ctx->core_count, ctx->threads, ctx->thread_count);
+		for (i = 0; i < ctx->thread_count; i++) {
+			if (ctx->threads[i].new_lcore != ctx->threads[i].lcore) {
+				moves++;
+			}
+		}
+	}
+
+	if (moves == 0) {
+		_spdk_reactors_balance_done(ctx, NULL);
+		return;
+	}
+
+	ctx->outstanding = ctx->core_count;
+	for (i = 0; i < ctx->core_count; i++) {
+		evt = spdk_event_allocate(ctx->cores[i].lcore, _spdk_reactors_apply, ctx, &ctx->cores[i]);
+		spdk_event_call(evt);
+	}
+}
+
+/* Runs on each reactor in turn to add the load of its threads to the sample. */
+static void
+_spdk_reactors_gather(void *arg1, void *arg2)
+{
+	struct spdk_scheduler_ctx *ctx = arg1;
+	struct spdk_scheduler_core_info *core;
+	struct spdk_scheduler_thread_info *info, *threads;
+	struct spdk_reactor *reactor;
+	struct spdk_lw_thread *lw_thread;
+	struct spdk_thread *thread;
+	struct spdk_event *evt;
+	uint32_t lcore, max_threads;
+
+	lcore = spdk_env_get_current_core();
+	reactor = spdk_reactor_get(lcore);
+	assert(reactor != NULL);
+
+	core = &ctx->cores[ctx->core_count++];
+	core->lcore = lcore;
+	core->busy_tsc = reactor->busy_tsc;
+	core->idle_tsc = reactor->idle_tsc;
+	core->threads_start = ctx->thread_count;
+	core->thread_count = 0;
+
+	TAILQ_FOREACH(lw_thread, &reactor->threads, link) {
+		if (ctx->failed) {
+			break;
+		}
+
+		if (ctx->thread_count == ctx->max_threads) {
+			max_threads = spdk_max(ctx->max_threads * 2, 64);
+			threads = realloc(ctx->threads, max_threads * sizeof(*threads));
+			if (threads == NULL) {
+				SPDK_ERRLOG("Unable to allocate memory for scheduler\n");
+				ctx->failed = true;
+				break;
+			}
+			ctx->threads = threads;
+			ctx->max_threads = max_threads;
+		}
+
+		thread = spdk_thread_get_from_ctx(lw_thread);
+		info = &ctx->threads[ctx->thread_count++];
+		info->id = lw_thread->id;
+		info->lcore = lcore;
+		info->new_lcore = lcore;
+		info->busy_tsc = lw_thread->busy_tsc;
+		info->idle_tsc = lw_thread->idle_tsc;
+		spdk_cpuset_copy(&info->cpumask, spdk_thread_get_cpumask(thread));
+		core->thread_count++;
+	}
+
+	lcore = spdk_env_get_next_core(lcore);
+	while (lcore <= spdk_env_get_last_core() && spdk_reactor_get(lcore) == NULL) {
+		lcore = spdk_env_get_next_core(lcore);
+	}
+
+	if (lcore > spdk_env_get_last_core()) {
+		evt = spdk_event_allocate(g_scheduling_lcore, _spdk_reactors_balance, ctx, NULL);
+	} else {
+		evt = spdk_event_allocate(lcore, _spdk_reactors_gather, ctx, NULL);
+	}
+	spdk_event_call(evt);
+}
+
+static void
+_spdk_reactors_start_balance(struct spdk_scheduler *scheduler)
+{
+	struct spdk_scheduler_ctx *ctx;
+	struct spdk_event *evt;
+
+	if (g_scheduling_in_progress) {
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		SPDK_ERRLOG("Unable to allocate memory for scheduler\n");
+		return;
+	}
+
+	ctx->scheduler = scheduler;
+	ctx->cores = calloc(spdk_env_get_core_count(), sizeof(*ctx->cores));
+	if (ctx->cores == NULL) {
+		SPDK_ERRLOG("Unable to allocate memory for scheduler\n");
+		free(ctx);
+		return;
+	}
+
+	g_scheduling_in_progress = true;
+	evt = spdk_event_allocate(spdk_env_get_first_core(), _spdk_reactors_gather, ctx, NULL);
+	spdk_event_call(evt);
+}
+
+/* Runs on the reactor that an idle reactor asked for a thread. */
+static void
+_spdk_reactor_give_thread(void *arg1, void *arg2)
+{
+	uint32_t thief_lcore = (uint32_t)(uintptr_t)arg1;
+	struct spdk_reactor *reactor;
+	struct spdk_lw_thread *lw_thread, *candidate = NULL;
+	struct spdk_thread *thread;
+
+	reactor = spdk_reactor_get(spdk_env_get_current_core());
+	assert(reactor != NULL);
+
+	/* Never give away the only thread that has work. */
+	if (reactor->busy_threads < 2) {
+		return;
+	}
+
+	TAILQ_FOREACH(lw_thread, &reactor->threads, link) {
+		thread = spdk_thread_get_from_ctx(lw_thread);
+		if (lw_thread->busy_tsc == 0 ||
+		    !spdk_cpuset_get_cpu(spdk_thread_get_cpumask(thread), thief_lcore)) {
+			continue;
+		}
+
+		if (candidate == NULL || lw_thread->busy_tsc < candidate->busy_tsc) {
+			candidate = lw_thread;
+		}
+	}
+
+	if (candidate == NULL) {
+		return;
+	}
+
+	reactor->busy_threads--;
+	reactor->busy_tsc -= candidate->busy_tsc;
+	_spdk_reactor_migrate_thread(reactor, candidate, thief_lcore, true);
+}
+
+/* Asks the busiest reactor with more than one busy thread to hand one over. */
+static void
+_spdk_reactor_steal(struct spdk_reactor *thief)
+{
+	struct spdk_reactor *reactor, *victim = NULL;
+	struct spdk_event *evt;
+	uint32_t i;
+
+	SPDK_ENV_FOREACH_CORE(i) {
+		reactor = spdk_reactor_get(i);
+		if (reactor == NULL || reactor == thief || reactor->busy_threads < 2) {
+			continue;
+		}
+
+		if (victim == NULL || reactor->busy_tsc > victim->busy_tsc) {
+			victim = reactor;
+		}
+	}
+
+	if (victim == NULL) {
+		return;
+	}
+
+	evt = spdk_event_allocate(victim->lcore, _spdk_reactor_give_thread,
+				  (void *)(uintptr_t)thief->lcore, NULL);
+	spdk_event_call(evt);
+}
+
+/* Samples the load of the threads on this reactor once every scheduler period. */
+static void
+_spdk_reactor_sample(struct spdk_reactor *reactor, struct spdk_scheduler *scheduler, uint64_t now)
+{
+	struct spdk_lw_thread *lw_thread;
+	struct spdk_thread_stats stats;
+	uint64_t elapsed = now - reactor->last_sample_tsc;
+
+	reactor->busy_tsc = 0;
+	reactor->idle_tsc = 0;
+	reactor->busy_threads = 0;
+
+	TAILQ_FOREACH(lw_thread, &reactor->threads, link) {
+		spdk_set_thread(spdk_thread_get_from_ctx(lw_thread));
+		spdk_thread_get_stats(&stats);
+
+		lw_thread->busy_tsc = stats.busy_tsc - lw_thread->last_stats.busy_tsc;
+		lw_thread->idle_tsc = stats.idle_tsc - lw_thread->last_stats.idle_tsc;
+		lw_thread->last_stats = stats;
+
+		reactor->busy_tsc += lw_thread->busy_tsc;
+		reactor->idle_tsc += lw_thread->idle_tsc;
+		if (lw_thread->busy_tsc != 0) {
+			reactor->busy_threads++;
+		}
+	}
+	spdk_set_thread(NULL);
+
+	reactor->last_sample_tsc = now;
+
+	if (reactor->lcore == g_scheduling_lcore && scheduler->balance != NULL) {
+		_spdk_reactors_start_balance(scheduler);
+	}
+
+	if (scheduler->work_stealing &&
+	    reactor->busy_tsc * 100 < elapsed * SPDK_REACTOR_IDLE_PCT) {
+		_spdk_reactor_steal(reactor);
+	}
+}
+
+/*
+ * Blocks until the reactor has an event, one of its threads has a message or
+ *  a poller with work to do, or a timed poller expires.
+ */
+static void
+_spdk_reactor_sleep(struct spdk_reactor *reactor, uint64_t now)
+{
+#ifdef __linux__
+	struct spdk_lw_thread *lw_thread;
+	struct spdk_thread *thread;
+	struct epoll_event events[8];
+	struct itimerspec timeout = {};
+	uint64_t expiration, next = 0, ticks, ticks_hz, start, count;
+	bool can_sleep = true;
+
+	if (reactor->epoll_fd < 0) {
+		return;
+	}
+
+	/* Pairs with the check in spdk_event_call(). */
+	__atomic_store_n(&reactor->sleeping, true, __ATOMIC_SEQ_CST);
+	if (spdk_ring_count(reactor->events) != 0) {
+		can_sleep = false;
+	}
+
+	TAILQ_FOREACH(lw_thread, &reactor->threads, link) {
+		thread = spdk_thread_get_from_ctx(lw_thread);
+		if (!spdk_thread_wait_begin(thread)) {
+			can_sleep = false;
+		}
+
+		expiration = spdk_thread_next_poller_expiration(thread);
+		if (expiration != 0 && (next == 0 || expiration < next)) {
+			next = expiration;
+		}
+	}
+
+	if (can_sleep && next != 0) {
+		if (next <= now) {
+			can_sleep = false;
+		} else {
+			ticks = next - now;
+			ticks_hz = spdk_get_ticks_hz();
+			timeout.it_value.tv_sec = ticks / ticks_hz;
+			timeout.it_value.tv_nsec = (ticks % ticks_hz) * SPDK_SEC_TO_NSEC / ticks_hz;
+			timerfd_settime(reactor->timer_fd, 0, &timeout, NULL);
+		}
+	}
+
+	if (can_sleep) {
+		start = spdk_get_ticks();
+		epoll_wait(reactor->epoll_fd, events, SPDK_COUNTOF(events), -1);
+		reactor->sleep_count++;
+		reactor->sleep_tsc += spdk_get_ticks() - start;
+
+		if (next != 0) {
+			memset(&timeout, 0, sizeof(timeout));
+			timerfd_settime(reactor->timer_fd, 0, &timeout, NULL);
+		}
+	} else {
+		/*
+		 * A thread has work that cannot wake the reactor up. Keep polling for
+		 *  another idle period before trying again.
+		 */
+		reactor->last_busy_tsc = now;
+	}
+
+	TAILQ_FOREACH(lw_thread, &reactor->threads, link) {
+		spdk_thread_wait_end(spdk_thread_get_from_ctx(lw_thread));
+	}
+
+	__atomic_store_n(&reactor->sleeping, false, __ATOMIC_SEQ_CST);
+
+	/* Clear the doorbells. EAGAIN only means they were not signaled. */
+	if (read(reactor->events_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+		SPDK_ERRLOG("Unable to read events fd of reactor %u\n", reactor->lcore);
+	}
+	if (read(reactor->timer_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+		SPDK_ERRLOG("Unable to read timer fd of reactor %u\n", reactor->lcore);
+	}
+#endif
+}
+
+int
+spdk_reactor_set_interrupt_mode(bool enabled, uint64_t idle_usec)
+{
+	uint32_t i;
+	struct spdk_reactor *reactor;
+
+#ifndef __linux__
+	if (enabled) {
+		return -ENOTSUP;
+	}
+#endif
+
+	if (idle_usec != 0) {
+		g_interrupt_idle_usec = idle_usec;
+		g_interrupt_idle_tsc = idle_usec * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
+	}
+	g_interrupt_mode = enabled;
+
+	if (!enabled && g_reactors != NULL) {
+		SPDK_ENV_FOREACH_CORE(i) {
+			reactor = spdk_reactor_get(i);
+			if (reactor != NULL) {
+				_spdk_reactor_wakeup(reactor);
+			}
+		}
+	}
+
+	return 0;
+}
+
+bool
+spdk_reactor_get_interrupt_mode(uint64_t *idle_usec)
+{
+	if (idle_usec != NULL) {
+		*idle_usec = g_interrupt_idle_usec;
+	}
+
+	return g_interrupt_mode;
+}
+
+int
+spdk_reactor_get_interrupt_stats(uint32_t lcore, struct spdk_reactor_interrupt_stats *stats)
+{
+	struct spdk_reactor *reactor;
+
+	if (g_reactors == NULL || lcore > spdk_env_get_last_core()) {
+		return -EINVAL;
+	}
+
+	reactor = spdk_reactor_get(lcore);
+	if (reactor == NULL) {
+		return -EINVAL;
+	}
+
+	stats->sleeping = __atomic_load_n(&reactor->sleeping, __ATOMIC_RELAXED);
+	stats->sleep_count = reactor->sleep_count;
+	stats->sleep_tsc = reactor->sleep_tsc;
+
+	return 0;
+}
+
 static void
 _set_thread_name(const char *thread_name)
 {
@@ -339,6 +1067,7 @@ _spdk_reactor_run(void *arg)
 	struct spdk_thread	*thread;
 	uint64_t		last_rusage = 0;
 	struct spdk_lw_thread	*lw_thread, *tmp;
+	struct spdk_scheduler	*scheduler;
 	char			thread_name[32];
 
 	SPDK_NOTICELOG("Reactor started on core %u\n", reactor->lcore);
@@ -349,23 +1078,28 @@ _spdk_reactor_run(void *arg)
 	snprintf(thread_name, sizeof(thread_name), "reactor_%u", reactor->lcore);
 	_set_thread_name(thread_name);
 
+	reactor->last_busy_tsc = spdk_get_ticks();
+
 	while (1) {
 		uint64_t now;
+		bool busy;
 		int rc;
 
 		/* For each loop through the reactor, capture the time. This time
 		 * is used for all threads. */
 		now = spdk_get_ticks();
 
-		_spdk_event_queue_run_batch(reactor);
+		busy = _spdk_event_queue_run_batch(reactor) > 0;
 
 		TAILQ_FOREACH_SAFE(lw_thread, &reactor->threads, link, tmp) {
 			thread = spdk_thread_get_from_ctx(lw_thread);
 
 			rc = spdk_thread_poll(thread, 0, now);
 			if (rc < 0) {
-				TAILQ_REMOVE(&reactor->threads, lw_thread, link);
+				_spdk_reactor_remove_thread(reactor, lw_thread);
 				spdk_thread_destroy(thread);
+			} else if (rc > 0) {
+				busy = true;
 			}
 		}
 
@@ -373,17 +1107,29 @@ _spdk_reactor_run(void *arg)
 			break;
 		}
 
+		scheduler = g_scheduler;
+		if (scheduler != NULL && (scheduler->balance != NULL || scheduler->work_stealing) &&
+		    now - reactor->last_sample_tsc >= g_scheduler_period_tsc) {
+			_spdk_reactor_sample(reactor, scheduler, now);
+		}
+
 		if (g_framework_monitor_context_switch_enabled) {
 			if ((last_rusage + CONTEXT_SWITCH_MONITOR_PERIOD) < now) {
 				get_rusage(reactor);
 				last_rusage = now;
 			}
 		}
+
+		if (busy) {
+			reactor->last_busy_tsc = now;
+		} else if (g_interrupt_mode && now - reactor->last_busy_tsc >= g_interrupt_idle_tsc) {
+			_spdk_reactor_sleep(reactor, now);
+		}
 	}
 
 	TAILQ_FOREACH_SAFE(lw_thread, &reactor->threads, link, tmp) {
 		thread = spdk_thread_get_from_ctx(lw_thread);
-		TAILQ_REMOVE(&reactor->threads, lw_thread, link);
+		_spdk_reactor_remove_thread(reactor, lw_thread);
 		spdk_set_thread(thread);
 		spdk_thread_exit(thread);
 		spdk_thread_destroy(thread);
@@ -435,6 +1181,7 @@ spdk_reactors_start(void)
 	g_reactor_core_mask = spdk_cpuset_alloc();
 
 	current_core = spdk_env_get_current_core();
+	g_scheduling_lcore = current_core;
 	SPDK_ENV_FOREACH_CORE(i) {
 		if (i != current_core) {
 			reactor = spdk_reactor_get(i);
@@ -477,10 +1224,19 @@ spdk_reactors_start(void)
 void
 spdk_reactors_stop(void *arg1)
 {
+	uint32_t i;
+	struct spdk_reactor *reactor;
+
 	g_reactor_state = SPDK_REACTOR_STATE_EXITING;
+
+	SPDK_ENV_FOREACH_CORE(i) {
+		reactor = spdk_reactor_get(i);
+		if (reactor != NULL) {
+			_spdk_reactor_wakeup(reactor);
+		}
+	}
 }
 
-static pthread_mutex_t g_scheduler_mtx = PTHREAD_MUTEX_INITIALIZER;
 static uint32_t g_next_core = UINT32_MAX;
 
 static void
@@ -492,7 +1248,7 @@ _schedule_thread(void *arg1, void *arg2)
 	reactor = spdk_reactor_get(spdk_env_get_current_core());
 	assert(reactor != NULL);
 
-	TAILQ_INSERT_TAIL(&reactor->threads, lw_thread, link);
+	_spdk_reactor_add_thread(reactor, lw_thread);
 }
 
 static int
@@ -511,6 +1267,7 @@ spdk_reactor_schedule_thread(struct spdk_thread *thread)
 	memset(lw_thread, 0, sizeof(*lw_thread));
 
 	pthread_mutex_lock(&g_scheduler_mtx);
+	lw_thread->id = ++g_next_thread_id;
 	for (i = 0; i < spdk_env_get_core_count(); i++) {
 		if (g_next_core > spdk_env_get_last_core()) {
 			g_next_core = spdk_env_get_first_core();
@@ -0,0 +1,112 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk_internal/event.h"
+
+/*
+ * Moves threads from the busiest reactor to the least busy one for as long as
+ *  that narrows the gap between the two. Core busy times are updated in place
+ *  to reflect the moves.
+ */
+static void
+balance(struct spdk_scheduler_core_info *cores, uint32_t core_count,
+	struct spdk_scheduler_thread_info *threads, uint32_t thread_count)
+{
+	struct spdk_scheduler_core_info *busiest, *idlest, *core;
+	struct spdk_scheduler_thread_info *thread, *candidate;
+	uint64_t gap;
+	uint32_t i, moves;
+
+	for (moves = 0; moves < thread_count; moves++) {
+		busiest = idlest = &cores[0];
+		for (i = 1; i < core_count; i++) {
+			core = &cores[i];
+			if (core->busy_tsc > busiest->busy_tsc) {
+				busiest = core;
+			}
+			if (core->busy_tsc < idlest->busy_tsc) {
+				idlest = core;
+			}
+		}
+
+		if (busiest == idlest) {
+			return;
+		}
+
+		gap = busiest->busy_tsc - idlest->busy_tsc;
+		candidate = NULL;
+		for (i = 0; i < thread_count; i++) {
+			thread = &threads[i];
+			if (thread->new_lcore != busiest->lcore || thread->busy_tsc == 0 ||
+			    thread->busy_tsc >= gap ||
+			    !spdk_cpuset_get_cpu(&thread->cpumask, idlest->lcore)) {
+				continue;
+			}
+
+			if (candidate == NULL || thread->busy_tsc > candidate->busy_tsc) {
+				candidate = thread;
+			}
+		}
+
+		if (candidate == NULL) {
+			return;
+		}
+
+		candidate->new_lcore = idlest->lcore;
+		busiest->busy_tsc -= candidate->busy_tsc;
+		idlest->busy_tsc += candidate->busy_tsc;
+	}
+}
+
+static struct spdk_scheduler scheduler_static = {
+	.name = "static",
+};
+
+SPDK_SCHEDULER_REGISTER(scheduler_static);
+
+static struct spdk_scheduler scheduler_balanced = {
+	.name = "balanced",
+	.balance = balance,
+};
+
+SPDK_SCHEDULER_REGISTER(scheduler_balanced);
+
+static struct spdk_scheduler scheduler_work_stealing = {
+	.name = "work_stealing",
+	.balance = balance,
+	.work_stealing = true,
+};
+
+SPDK_SCHEDULER_REGISTER(scheduler_work_stealing);
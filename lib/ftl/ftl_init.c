@@ -1354,7 +1354,7 @@ ftl_add_halt_poller(void *ctx)
 	_ftl_halt_defrag(dev);
 
 	assert(!dev->fini_ctx.poller);
-	dev->fini_ctx.poller = spdk_poller_register(ftl_halt_poller, dev, 100);
+	dev->fini_ctx.poller = SPDK_POLLER_REGISTER(ftl_halt_poller, dev, 100);
 }
 
 static int
@@ -1186,14 +1186,20 @@ static int
 iscsi_poll_group_create(void *io_device, void *ctx_buf)
 {
 	struct spdk_iscsi_poll_group *pg = ctx_buf;
+	int fd;
 
 	STAILQ_INIT(&pg->connections);
 	pg->sock_group = spdk_sock_group_create(NULL);
 	assert(pg->sock_group != NULL);
 
-	pg->poller = spdk_poller_register(iscsi_poll_group_poll, pg, 0);
+	pg->poller = SPDK_POLLER_REGISTER(iscsi_poll_group_poll, pg, 0);
+	/* Let the reactor sleep while no connection has data to read. */
+	fd = spdk_sock_group_get_fd(pg->sock_group);
+	if (fd >= 0) {
+		spdk_poller_set_wakeup_fd(pg->poller, fd);
+	}
 	/* set the period to 1 sec */
-	pg->nop_poller = spdk_poller_register(iscsi_poll_group_handle_nop, pg, 1000000);
+	pg->nop_poller = SPDK_POLLER_REGISTER(iscsi_poll_group_handle_nop, pg, 1000000);
 
 	return 0;
 }
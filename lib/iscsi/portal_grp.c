@@ -87,7 +87,7 @@ iscsi_acceptor_start(struct spdk_iscsi_portal *p)
 {
 	struct spdk_io_channel *ch;
 
-	p->acceptor_poller = spdk_poller_register(iscsi_portal_accept, p, ACCEPT_TIMEOUT_US);
+	p->acceptor_poller = SPDK_POLLER_REGISTER(iscsi_portal_accept, p, ACCEPT_TIMEOUT_US);
 
 	ch = spdk_get_io_channel(&g_spdk_iscsi);
 	assert(ch != NULL);
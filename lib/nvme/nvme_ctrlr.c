@@ -280,6 +280,18 @@ spdk_nvme_ctrlr_get_default_io_qpair_opts(struct spdk_nvme_ctrlr *ctrlr,
 		opts->cq.buffer_size = 0;
 	}
 
+	if (FIELD_OK(create_only)) {
+		opts->create_only = false;
+	}
+
+	if (FIELD_OK(adaptive_pcie_doorbell)) {
+		opts->adaptive_pcie_doorbell = false;
+	}
+
+	if (FIELD_OK(pcie_doorbell_budget_us)) {
+		opts->pcie_doorbell_budget_us = 0;
+	}
+
 #undef FIELD_OK
 }
 
@@ -364,7 +376,17 @@ spdk_nvme_ctrlr_alloc_io_qpair(struct spdk_nvme_ctrlr *ctrlr,
 		nvme_robust_mutex_unlock(&ctrlr->ctrlr_lock);
 		return NULL;
 	}
-	nvme_qpair_set_state(qpair, NVME_QPAIR_CONNECTED);
+
+	if (!opts.create_only) {
+		if (nvme_transport_ctrlr_connect_qpair(ctrlr, qpair) != 0) {
+			SPDK_ERRLOG("I/O queue creation failed\n");
+			nvme_qpair_set_state(qpair, NVME_QPAIR_DISABLED);
+			nvme_transport_ctrlr_delete_io_qpair(ctrlr, qpair);
+			nvme_robust_mutex_unlock(&ctrlr->ctrlr_lock);
+			return NULL;
+		}
+		nvme_qpair_set_state(qpair, NVME_QPAIR_CONNECTED);
+	}
 	spdk_bit_array_clear(ctrlr->free_io_qids, qid);
 	TAILQ_INSERT_TAIL(&ctrlr->active_io_qpairs, qpair, tailq);
 
@@ -379,6 +401,38 @@ spdk_nvme_ctrlr_alloc_io_qpair(struct spdk_nvme_ctrlr *ctrlr,
 	return qpair;
 }
 
+int
+spdk_nvme_ctrlr_connect_io_qpair(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_qpair *qpair)
+{
+	int rc;
+
+	if (!ctrlr || !qpair || nvme_qpair_is_admin_queue(qpair)) {
+		return -EINVAL;
+	}
+
+	if (!nvme_qpair_state_equals(qpair, NVME_QPAIR_DISABLED)) {
+		return -EISCONN;
+	}
+
+	nvme_robust_mutex_lock(&ctrlr->ctrlr_lock);
+	rc = nvme_transport_ctrlr_connect_qpair(ctrlr, qpair);
+	if (rc != 0) {
+		SPDK_ERRLOG("Failed to connect I/O qpair %u\n", qpair->id);
+		nvme_transport_ctrlr_disconnect_qpair(ctrlr, qpair);
+		nvme_qpair_set_state(qpair, NVME_QPAIR_DISABLED);
+		nvme_robust_mutex_unlock(&ctrlr->ctrlr_lock);
+		return rc < 0 ? rc : -EIO;
+	}
+	nvme_qpair_set_state(qpair, NVME_QPAIR_CONNECTED);
+	nvme_robust_mutex_unlock(&ctrlr->ctrlr_lock);
+
+	if (ctrlr->quirks & NVME_QUIRK_DELAY_AFTER_QUEUE_ALLOC) {
+		spdk_delay_us(100);
+	}
+
+	return 0;
+}
+
 int
 spdk_nvme_ctrlr_free_io_qpair(struct spdk_nvme_qpair *qpair)
 {
@@ -401,6 +455,21 @@ spdk_nvme_ctrlr_free_io_qpair(struct spdk_nvme_qpair *qpair)
 		return 0;
 	}
 
+	if (qpair->poll_group != NULL) {
+		if (qpair->poll_group->group->in_completion_context) {
+			/*
+			 * Other qpairs of the group may still have completions in flight, so
+			 *  the group deletes this one once it is done polling.
+			 */
+			qpair->delete_after_completion_context = 1;
+			qpair->poll_group->group->has_deferred_deletes = true;
+			return 0;
+		}
+
+		nvme_transport_ctrlr_disconnect_qpair(ctrlr, qpair);
+		nvme_poll_group_remove_qpair(qpair);
+	}
+
 	nvme_robust_mutex_lock(&ctrlr->ctrlr_lock);
 
 	nvme_ctrlr_proc_remove_io_qpair(qpair);
@@ -1812,6 +1881,9 @@ nvme_ctrlr_configure_aer(struct spdk_nvme_ctrlr *ctrlr)
 		if (ctrlr->cdata.oaes.fw_activation_notices) {
 			config.bits.fw_activation_notice = 1;
 		}
+		if (ctrlr->cdata.oaes.ana_change_notices) {
+			config.bits.ana_change_notice = 1;
+		}
 	}
 	if (ctrlr->vs.raw >= SPDK_NVME_VERSION(1, 3, 0) && ctrlr->cdata.lpa.telemetry) {
 		config.bits.telemetry_log_notice = 1;
@@ -382,9 +382,39 @@ struct spdk_nvme_qpair {
 
 	struct spdk_nvme_ctrlr_process	*active_proc;
 
+	/* Transport part of the poll group this qpair is in, if any */
+	struct nvme_transport_poll_group	*poll_group;
+
+	/* List entry for nvme_transport_poll_group::qpairs */
+	TAILQ_ENTRY(spdk_nvme_qpair)	poll_group_tailq;
+
 	void				*req_buf;
 };
 
+struct spdk_nvme_poll_group {
+	void						*ctx;
+
+	/*
+	 * Set while the group reaps completions. Qpairs of the group freed meanwhile
+	 *  are only deleted once the group is done.
+	 */
+	bool						in_completion_context;
+	bool						has_deferred_deletes;
+
+	STAILQ_HEAD(, nvme_transport_poll_group)	tgroups;
+};
+
+/*
+ * Qpairs of one transport within a poll group. Transports embed it in their
+ *  own poll group structure, to hold the resources their qpairs share.
+ */
+struct nvme_transport_poll_group {
+	struct spdk_nvme_poll_group			*group;
+	enum spdk_nvme_transport_type			trtype;
+	TAILQ_HEAD(, spdk_nvme_qpair)			qpairs;
+	STAILQ_ENTRY(nvme_transport_poll_group)		link;
+};
+
 struct spdk_nvme_ns {
 	struct spdk_nvme_ctrlr		*ctrlr;
 	uint32_t			sector_size;
@@ -860,6 +890,9 @@ void	nvme_qpair_deinit(struct spdk_nvme_qpair *qpair);
 void	nvme_qpair_complete_error_reqs(struct spdk_nvme_qpair *qpair);
 int	nvme_qpair_submit_request(struct spdk_nvme_qpair *qpair,
 				  struct nvme_request *req);
+int	nvme_qpair_completions_prepare(struct spdk_nvme_qpair *qpair);
+int32_t	nvme_qpair_completions_done(struct spdk_nvme_qpair *qpair, int32_t ret);
+int	nvme_poll_group_remove_qpair(struct spdk_nvme_qpair *qpair);
 
 int	nvme_ctrlr_identify_active_ns(struct spdk_nvme_ctrlr *ctrlr);
 void	nvme_ns_set_identify_data(struct spdk_nvme_ns *ns);
@@ -1110,7 +1143,14 @@ struct spdk_nvme_ctrlr *spdk_nvme_get_ctrlr_by_trid_unsafe(
 	int nvme_ ## name ## _qpair_reset(struct spdk_nvme_qpair *qpair); \
 	int nvme_ ## name ## _qpair_submit_request(struct spdk_nvme_qpair *qpair, struct nvme_request *req); \
 	int32_t nvme_ ## name ## _qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_completions); \
+	int nvme_ ## name ## _qpair_get_doorbell_stats(struct spdk_nvme_qpair *qpair, \
+		struct spdk_nvme_qpair_doorbell_stats *stats); \
 	void nvme_ ## name ## _admin_qpair_abort_aers(struct spdk_nvme_qpair *qpair); \
+	int nvme_ ## name ## _poll_group_add(struct nvme_transport_poll_group *tgroup, struct spdk_nvme_qpair *qpair); \
+	int nvme_ ## name ## _poll_group_remove(struct nvme_transport_poll_group *tgroup, struct spdk_nvme_qpair *qpair); \
+	int64_t nvme_ ## name ## _poll_group_process_completions(struct nvme_transport_poll_group *tgroup, \
+		uint32_t completions_per_qpair, spdk_nvme_disconnected_qpair_cb disconnected_qpair_cb); \
+	int nvme_ ## name ## _poll_group_destroy(struct nvme_transport_poll_group *tgroup); \
 
 DECLARE_TRANSPORT(transport) /* generic transport dispatch functions */
 DECLARE_TRANSPORT(pcie)
@@ -1121,6 +1161,14 @@ DECLARE_TRANSPORT(rdma)
 
 #undef DECLARE_TRANSPORT
 
+struct nvme_transport_poll_group *nvme_transport_poll_group_create(
+	enum spdk_nvme_transport_type trtype);
+struct nvme_transport_poll_group *nvme_pcie_poll_group_create(void);
+struct nvme_transport_poll_group *nvme_tcp_poll_group_create(void);
+#ifdef  SPDK_CONFIG_RDMA
+struct nvme_transport_poll_group *nvme_rdma_poll_group_create(void);
+#endif
+
 /*
  * Below ref related functions must be called with the global
  *  driver lock held for the multi-process condition.
@@ -66,6 +66,9 @@ struct nvme_pcie_enum_ctx {
 	bool has_pci_addr;
 };
 
+/* Controller memory buffer allocations are made of chunks of this size */
+#define NVME_PCIE_CMB_CHUNK_SIZE	0x1000
+
 /* PCIe transport extensions for spdk_nvme_ctrlr */
 struct nvme_pcie_ctrlr {
 	struct spdk_nvme_ctrlr ctrlr;
@@ -85,12 +88,18 @@ struct nvme_pcie_ctrlr {
 	/* Controller memory buffer size in Bytes */
 	uint64_t cmb_size;
 
-	/* Current offset of controller memory buffer, relative to start of BAR virt addr */
-	uint64_t cmb_current_offset;
+	/* First offset of CMB handed out, relative to start of BAR virt addr */
+	uint64_t cmb_base_offset;
 
 	/* Last valid offset into CMB, this differs if CMB memory registration occurs or not */
 	uint64_t cmb_max_offset;
 
+	/*
+	 * One bit per chunk from cmb_base_offset, set while the chunk is allocated.
+	 *  In shared memory, since the controller may be shared between processes.
+	 */
+	struct spdk_bit_array *cmb_chunks;
+
 	void *cmb_mem_register_addr;
 	size_t cmb_mem_register_size;
 
@@ -163,12 +172,20 @@ struct nvme_pcie_qpair {
 	uint16_t cq_head;
 	uint16_t sq_head;
 
+	/* Completions consumed since the completion queue head doorbell was last written */
+	uint16_t cq_pending;
+
 	struct {
 		uint8_t phase			: 1;
 		uint8_t delay_pcie_doorbell	: 1;
 		uint8_t has_shadow_doorbell	: 1;
+		uint8_t adaptive_doorbell	: 1;
 	} flags;
 
+	/* Adaptive doorbell: latency budget and submit time of the oldest command not rung yet */
+	uint64_t doorbell_budget_ticks;
+	uint64_t first_unrung_tsc;
+
 	/*
 	 * Base qpair structure.
 	 * This is located after the hot data in this structure so that the important parts of
@@ -176,6 +193,8 @@ struct nvme_pcie_qpair {
 	 */
 	struct spdk_nvme_qpair qpair;
 
+	struct spdk_nvme_qpair_doorbell_stats doorbell_stats;
+
 	struct {
 		/* Submission queue shadow tail doorbell */
 		volatile uint32_t *sq_tdbl;
@@ -468,6 +487,23 @@ nvme_pcie_ctrlr_get_max_sges(struct spdk_nvme_ctrlr *ctrlr)
 	return NVME_MAX_SGL_DESCRIPTORS;
 }
 
+static int
+nvme_pcie_ctrlr_init_cmb_chunks(struct nvme_pcie_ctrlr *pctrlr)
+{
+	uint64_t num_chunks;
+
+	assert(pctrlr->cmb_base_offset % NVME_PCIE_CMB_CHUNK_SIZE == 0);
+
+	num_chunks = (pctrlr->cmb_max_offset - pctrlr->cmb_base_offset) / NVME_PCIE_CMB_CHUNK_SIZE;
+	pctrlr->cmb_chunks = spdk_bit_array_create(num_chunks);
+	if (pctrlr->cmb_chunks == NULL) {
+		SPDK_ERRLOG("Failed to allocate CMB chunk map\n");
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
 static void
 nvme_pcie_ctrlr_map_cmb(struct nvme_pcie_ctrlr *pctrlr)
 {
@@ -519,7 +555,7 @@ nvme_pcie_ctrlr_map_cmb(struct nvme_pcie_ctrlr *pctrlr)
 	pctrlr->cmb_bar_virt_addr = addr;
 	pctrlr->cmb_bar_phys_addr = bar_phys_addr;
 	pctrlr->cmb_size = size;
-	pctrlr->cmb_current_offset = offset;
+	pctrlr->cmb_base_offset = offset;
 	pctrlr->cmb_max_offset = offset + size;
 
 	if (!cmbsz.bits.sqs) {
@@ -528,6 +564,9 @@ nvme_pcie_ctrlr_map_cmb(struct nvme_pcie_ctrlr *pctrlr)
 
 	/* If only SQS is supported use legacy mapping */
 	if (cmbsz.bits.sqs && !(cmbsz.bits.wds || cmbsz.bits.rds)) {
+		if (nvme_pcie_ctrlr_init_cmb_chunks(pctrlr) != 0) {
+			goto exit;
+		}
 		return;
 	}
 
@@ -546,8 +585,13 @@ nvme_pcie_ctrlr_map_cmb(struct nvme_pcie_ctrlr *pctrlr)
 		SPDK_ERRLOG("spdk_mem_register() failed\n");
 		goto exit;
 	}
-	pctrlr->cmb_current_offset = mem_register_start - ((uint64_t)pctrlr->cmb_bar_virt_addr);
+	pctrlr->cmb_base_offset = mem_register_start - ((uint64_t)pctrlr->cmb_bar_virt_addr);
 	pctrlr->cmb_max_offset = mem_register_end - ((uint64_t)pctrlr->cmb_bar_virt_addr);
+	if (nvme_pcie_ctrlr_init_cmb_chunks(pctrlr) != 0) {
+		spdk_mem_unregister(pctrlr->cmb_mem_register_addr, pctrlr->cmb_mem_register_size);
+		pctrlr->cmb_mem_register_addr = NULL;
+		goto exit;
+	}
 	pctrlr->cmb_io_data_supported = true;
 
 	return;
@@ -568,6 +612,7 @@ nvme_pcie_ctrlr_unmap_cmb(struct nvme_pcie_ctrlr *pctrlr)
 		if (pctrlr->cmb_mem_register_addr) {
 			spdk_mem_unregister(pctrlr->cmb_mem_register_addr, pctrlr->cmb_mem_register_size);
 		}
+		spdk_bit_array_free(&pctrlr->cmb_chunks);
 
 		if (nvme_pcie_ctrlr_get_cmbloc(pctrlr, &cmbloc)) {
 			SPDK_ERRLOG("get_cmbloc() failed\n");
@@ -583,19 +628,67 @@ nvme_pcie_ctrlr_alloc_cmb(struct spdk_nvme_ctrlr *ctrlr, uint64_t length, uint64
 			  uint64_t *offset)
 {
 	struct nvme_pcie_ctrlr *pctrlr = nvme_pcie_ctrlr(ctrlr);
-	uint64_t round_offset;
-
-	round_offset = pctrlr->cmb_current_offset;
-	round_offset = (round_offset + (aligned - 1)) & ~(aligned - 1);
+	uint64_t num_chunks, round_offset;
+	uint32_t first, used;
 
-	/* CMB may only consume part of the BAR, calculate accordingly */
-	if (round_offset + length > pctrlr->cmb_max_offset) {
-		SPDK_ERRLOG("Tried to allocate past valid CMB range!\n");
+	if (pctrlr->cmb_chunks == NULL) {
 		return -1;
 	}
 
-	*offset = round_offset;
-	pctrlr->cmb_current_offset = round_offset + length;
+	num_chunks = spdk_divide_round_up(length, NVME_PCIE_CMB_CHUNK_SIZE);
+	aligned = spdk_max(aligned, NVME_PCIE_CMB_CHUNK_SIZE);
+
+	/* First fit: look for enough clear bits in a row at an aligned offset */
+	first = spdk_bit_array_find_first_clear(pctrlr->cmb_chunks, 0);
+	while (first != UINT32_MAX) {
+		round_offset = pctrlr->cmb_base_offset + (uint64_t)first * NVME_PCIE_CMB_CHUNK_SIZE;
+		round_offset = (round_offset + (aligned - 1)) & ~(aligned - 1);
+		first = (round_offset - pctrlr->cmb_base_offset) / NVME_PCIE_CMB_CHUNK_SIZE;
+		if (first + num_chunks > spdk_bit_array_capacity(pctrlr->cmb_chunks)) {
+			break;
+		}
+
+		used = spdk_bit_array_find_first_set(pctrlr->cmb_chunks, first);
+		if (used >= first + num_chunks) {
+			for (used = first; used < first + num_chunks; used++) {
+				spdk_bit_array_set(pctrlr->cmb_chunks, used);
+			}
+			*offset = round_offset;
+			return 0;
+		}
+
+		first = spdk_bit_array_find_first_clear(pctrlr->cmb_chunks, used);
+	}
+
+	SPDK_ERRLOG("Tried to allocate past valid CMB range!\n");
+	return -1;
+}
+
+static int
+nvme_pcie_ctrlr_free_cmb(struct spdk_nvme_ctrlr *ctrlr, uint64_t offset, uint64_t length)
+{
+	struct nvme_pcie_ctrlr *pctrlr = nvme_pcie_ctrlr(ctrlr);
+	uint64_t first, num_chunks, i;
+
+	if (pctrlr->cmb_chunks == NULL || offset < pctrlr->cmb_base_offset ||
+	    (offset - pctrlr->cmb_base_offset) % NVME_PCIE_CMB_CHUNK_SIZE != 0 ||
+	    offset + length > pctrlr->cmb_max_offset) {
+		SPDK_ERRLOG("Tried to free unallocated CMB range!\n");
+		return -EINVAL;
+	}
+
+	first = (offset - pctrlr->cmb_base_offset) / NVME_PCIE_CMB_CHUNK_SIZE;
+	num_chunks = spdk_divide_round_up(length, NVME_PCIE_CMB_CHUNK_SIZE);
+	for (i = first; i < first + num_chunks; i++) {
+		if (!spdk_bit_array_get(pctrlr->cmb_chunks, i)) {
+			SPDK_ERRLOG("Tried to free unallocated CMB range!\n");
+			return -EINVAL;
+		}
+	}
+
+	for (i = first; i < first + num_chunks; i++) {
+		spdk_bit_array_clear(pctrlr->cmb_chunks, i);
+	}
 
 	return 0;
 }
@@ -635,12 +728,16 @@ nvme_pcie_ctrlr_alloc_cmb_io_buffer(struct spdk_nvme_ctrlr *ctrlr, size_t size)
 int
 nvme_pcie_ctrlr_free_cmb_io_buffer(struct spdk_nvme_ctrlr *ctrlr, void *buf, size_t size)
 {
-	/*
-	 * Do nothing for now.
-	 * TODO: Track free space so buffers may be reused.
-	 */
-	SPDK_ERRLOG("no deallocation for CMB buffers yet!\n");
-	return 0;
+	struct nvme_pcie_ctrlr *pctrlr = nvme_pcie_ctrlr(ctrlr);
+
+	if (pctrlr->cmb_bar_virt_addr == NULL ||
+	    (uintptr_t)buf < (uintptr_t)pctrlr->cmb_bar_virt_addr) {
+		SPDK_ERRLOG("Buffer %p is not in the CMB\n", buf);
+		return -EINVAL;
+	}
+
+	return nvme_pcie_ctrlr_free_cmb(ctrlr, (uintptr_t)buf - (uintptr_t)pctrlr->cmb_bar_virt_addr,
+					size);
 }
 
 static int
@@ -964,6 +1061,7 @@ nvme_pcie_qpair_reset(struct spdk_nvme_qpair *qpair)
 
 	/* all head/tail vals are set to 0 */
 	pqpair->last_sq_tail = pqpair->sq_tail = pqpair->sq_head = pqpair->cq_head = 0;
+	pqpair->cq_pending = 0;
 
 	/*
 	 * First time through the completion queue, HW will set phase
@@ -1253,7 +1351,10 @@ nvme_pcie_qpair_ring_sq_doorbell(struct spdk_nvme_qpair *qpair)
 		g_thread_mmio_ctrlr = pctrlr;
 		spdk_mmio_write_4(pqpair->sq_tdbl, pqpair->sq_tail);
 		g_thread_mmio_ctrlr = NULL;
+		pqpair->doorbell_stats.sq_doorbell_writes++;
 	}
+
+	pqpair->last_sq_tail = pqpair->sq_tail;
 }
 
 static inline void
@@ -1274,6 +1375,38 @@ nvme_pcie_qpair_ring_cq_doorbell(struct spdk_nvme_qpair *qpair)
 		g_thread_mmio_ctrlr = pctrlr;
 		spdk_mmio_write_4(pqpair->cq_hdbl, pqpair->cq_head);
 		g_thread_mmio_ctrlr = NULL;
+		pqpair->doorbell_stats.cq_doorbell_writes++;
+	}
+
+	pqpair->cq_pending = 0;
+}
+
+/*
+ * Ring the doorbell of a lone command right away. Otherwise the doorbell is rung once
+ *  for the batch by nvme_pcie_qpair_process_completions(), unless the oldest command
+ *  waiting for it exceeds its latency budget first.
+ */
+static inline void
+nvme_pcie_qpair_adaptive_sq_doorbell(struct spdk_nvme_qpair *qpair, struct nvme_tracker *tr)
+{
+	struct nvme_pcie_qpair	*pqpair = nvme_pcie_qpair(qpair);
+	uint64_t		now;
+
+	if (TAILQ_FIRST(&pqpair->outstanding_tr) == tr && TAILQ_NEXT(tr, tq_list) == NULL) {
+		nvme_pcie_qpair_ring_sq_doorbell(qpair);
+		return;
+	}
+
+	if (pqpair->doorbell_budget_ticks == 0) {
+		return;
+	}
+
+	now = spdk_get_ticks();
+	if (pqpair->sq_tail == (uint16_t)((pqpair->last_sq_tail + 1) % pqpair->num_entries)) {
+		/* First command waiting for the doorbell */
+		pqpair->first_unrung_tsc = now;
+	} else if (now - pqpair->first_unrung_tsc >= pqpair->doorbell_budget_ticks) {
+		nvme_pcie_qpair_ring_sq_doorbell(qpair);
 	}
 }
 
@@ -1297,7 +1430,11 @@ nvme_pcie_qpair_submit_tracker(struct spdk_nvme_qpair *qpair, struct nvme_tracke
 		SPDK_ERRLOG("sq_tail is passing sq_head!\n");
 	}
 
-	if (!pqpair->flags.delay_pcie_doorbell) {
+	pqpair->doorbell_stats.submitted++;
+
+	if (pqpair->flags.adaptive_doorbell) {
+		nvme_pcie_qpair_adaptive_sq_doorbell(qpair, tr);
+	} else if (!pqpair->flags.delay_pcie_doorbell) {
 		nvme_pcie_qpair_ring_sq_doorbell(qpair);
 	}
 }
@@ -1387,6 +1524,16 @@ nvme_pcie_qpair_abort_trackers(struct spdk_nvme_qpair *qpair, uint32_t dnr)
 	}
 }
 
+int
+nvme_pcie_qpair_get_doorbell_stats(struct spdk_nvme_qpair *qpair,
+				   struct spdk_nvme_qpair_doorbell_stats *stats)
+{
+	struct nvme_pcie_qpair	*pqpair = nvme_pcie_qpair(qpair);
+
+	*stats = pqpair->doorbell_stats;
+	return 0;
+}
+
 void
 nvme_pcie_admin_qpair_abort_aers(struct spdk_nvme_qpair *qpair)
 {
@@ -1425,9 +1572,13 @@ nvme_pcie_qpair_destroy(struct spdk_nvme_qpair *qpair)
 	 * We check sq_vaddr and cq_vaddr to see if the user specified the memory
 	 * buffers when creating the I/O queue.
 	 * If the user specified them, we cannot free that memory.
-	 * Nor do we free it if it's in the CMB.
+	 * A submission queue in the CMB is given back to the CMB instead.
 	 */
-	if (!pqpair->sq_vaddr && pqpair->cmd && !pqpair->sq_in_cmb) {
+	if (pqpair->sq_in_cmb) {
+		nvme_pcie_ctrlr_free_cmb(qpair->ctrlr, (uintptr_t)pqpair->cmd -
+					 (uintptr_t)nvme_pcie_ctrlr(qpair->ctrlr)->cmb_bar_virt_addr,
+					 pqpair->num_entries * sizeof(struct spdk_nvme_cmd));
+	} else if (!pqpair->sq_vaddr && pqpair->cmd) {
 		spdk_free(pqpair->cmd);
 	}
 	if (!pqpair->cq_vaddr && pqpair->cpl) {
@@ -1619,6 +1770,9 @@ nvme_pcie_ctrlr_create_io_qpair(struct spdk_nvme_ctrlr *ctrlr, uint16_t qid,
 
 	pqpair->num_entries = opts->io_queue_size;
 	pqpair->flags.delay_pcie_doorbell = opts->delay_pcie_doorbell;
+	pqpair->flags.adaptive_doorbell = opts->adaptive_pcie_doorbell;
+	pqpair->doorbell_budget_ticks = opts->pcie_doorbell_budget_us * spdk_get_ticks_hz() /
+					SPDK_SEC_TO_USEC;
 
 	qpair = &pqpair->qpair;
 
@@ -1635,14 +1789,6 @@ nvme_pcie_ctrlr_create_io_qpair(struct spdk_nvme_ctrlr *ctrlr, uint16_t qid,
 		return NULL;
 	}
 
-	rc = nvme_transport_ctrlr_connect_qpair(ctrlr, qpair);
-
-	if (rc != 0) {
-		SPDK_ERRLOG("I/O queue creation failed\n");
-		nvme_pcie_qpair_destroy(qpair);
-		return NULL;
-	}
-
 	return qpair;
 }
 
@@ -1669,7 +1815,8 @@ nvme_pcie_ctrlr_delete_io_qpair(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_
 
 	assert(ctrlr != NULL);
 
-	if (ctrlr->is_removed) {
+	/* A disabled qpair was never created on the controller, or was lost in a reset. */
+	if (ctrlr->is_removed || nvme_qpair_state_equals(qpair, NVME_QPAIR_DISABLED)) {
 		goto free;
 	}
 
@@ -1726,7 +1873,8 @@ nvme_pcie_prp_list_append(struct nvme_tracker *tr, uint32_t *prp_index, void *vi
 {
 	struct spdk_nvme_cmd *cmd = &tr->req->cmd;
 	uintptr_t page_mask = page_size - 1;
-	uint64_t phys_addr;
+	uint64_t phys_addr = 0;
+	uint64_t mapping_length = 0;
 	uint32_t i;
 
 	SPDK_DEBUGLOG(SPDK_LOG_NVME, "prp_index:%u virt_addr:%p len:%u\n",
@@ -1750,10 +1898,17 @@ nvme_pcie_prp_list_append(struct nvme_tracker *tr, uint32_t *prp_index, void *vi
 			return -EINVAL;
 		}
 
-		phys_addr = spdk_vtophys(virt_addr, NULL);
-		if (spdk_unlikely(phys_addr == SPDK_VTOPHYS_ERROR)) {
-			SPDK_ERRLOG("vtophys(%p) failed\n", virt_addr);
-			return -EINVAL;
+		/*
+		 * Hugepages are physically contiguous, so translate once per contiguous region
+		 *  and derive the address of each page within it.
+		 */
+		if (mapping_length == 0) {
+			mapping_length = len;
+			phys_addr = spdk_vtophys(virt_addr, &mapping_length);
+			if (spdk_unlikely(phys_addr == SPDK_VTOPHYS_ERROR)) {
+				SPDK_ERRLOG("vtophys(%p) failed\n", virt_addr);
+				return -EINVAL;
+			}
 		}
 
 		if (i == 0) {
@@ -1773,6 +1928,8 @@ nvme_pcie_prp_list_append(struct nvme_tracker *tr, uint32_t *prp_index, void *vi
 
 		seg_len = spdk_min(seg_len, len);
 		virt_addr += seg_len;
+		phys_addr += seg_len;
+		mapping_length -= spdk_min(seg_len, mapping_length);
 		len -= seg_len;
 		i++;
 	}
@@ -1821,7 +1978,7 @@ nvme_pcie_qpair_build_hw_sgl_request(struct spdk_nvme_qpair *qpair, struct nvme_
 {
 	int rc;
 	void *virt_addr;
-	uint64_t phys_addr;
+	uint64_t phys_addr, mapping_length;
 	uint32_t remaining_transfer_len, remaining_user_sge_len, length;
 	struct spdk_nvme_sgl_descriptor *sgl;
 	uint32_t nseg = 0;
@@ -1857,13 +2014,15 @@ nvme_pcie_qpair_build_hw_sgl_request(struct spdk_nvme_qpair *qpair, struct nvme_
 				return -1;
 			}
 
-			phys_addr = spdk_vtophys(virt_addr, NULL);
+			/* One descriptor covers all of the physically contiguous part of the SGE. */
+			mapping_length = remaining_user_sge_len;
+			phys_addr = spdk_vtophys(virt_addr, &mapping_length);
 			if (phys_addr == SPDK_VTOPHYS_ERROR) {
 				nvme_pcie_fail_request_bad_vtophys(qpair, tr);
 				return -1;
 			}
 
-			length = spdk_min(remaining_user_sge_len, VALUE_2MB - _2MB_OFFSET(virt_addr));
+			length = spdk_min(remaining_user_sge_len, mapping_length);
 			remaining_user_sge_len -= length;
 			virt_addr += length;
 
@@ -2089,6 +2248,15 @@ nvme_pcie_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_
 		max_completions = pqpair->max_completions_cap;
 	}
 
+	if (pqpair->flags.adaptive_doorbell) {
+		/*
+		 * The completion queue entries consumed without a head doorbell write are still
+		 *  occupied for the controller, so they count against the cap as well.
+		 */
+		max_completions = spdk_min(max_completions, (uint32_t)pqpair->max_completions_cap -
+					   pqpair->cq_pending);
+	}
+
 	while (1) {
 		cpl = &pqpair->cpl[pqpair->cq_head];
 
@@ -2145,14 +2313,21 @@ nvme_pcie_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_
 		}
 	}
 
-	if (num_completions > 0) {
+	pqpair->doorbell_stats.completed += num_completions;
+	pqpair->cq_pending += num_completions;
+
+	if (pqpair->flags.adaptive_doorbell) {
+		/* Only give the entries back once half of the cap is used up. */
+		if (pqpair->cq_pending >= pqpair->max_completions_cap / 2) {
+			nvme_pcie_qpair_ring_cq_doorbell(qpair);
+		}
+	} else if (num_completions > 0) {
 		nvme_pcie_qpair_ring_cq_doorbell(qpair);
 	}
 
-	if (pqpair->flags.delay_pcie_doorbell) {
+	if (pqpair->flags.delay_pcie_doorbell || pqpair->flags.adaptive_doorbell) {
 		if (pqpair->last_sq_tail != pqpair->sq_tail) {
 			nvme_pcie_qpair_ring_sq_doorbell(qpair);
-			pqpair->last_sq_tail = pqpair->sq_tail;
 		}
 	}
 
@@ -2172,3 +2347,50 @@ nvme_pcie_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_
 
 	return num_completions;
 }
+
+struct nvme_transport_poll_group *
+nvme_pcie_poll_group_create(void)
+{
+	/* PCIe qpairs have nothing to share, each of them is polled on its own. */
+	return calloc(1, sizeof(struct nvme_transport_poll_group));
+}
+
+int
+nvme_pcie_poll_group_add(struct nvme_transport_poll_group *tgroup, struct spdk_nvme_qpair *qpair)
+{
+	return 0;
+}
+
+int
+nvme_pcie_poll_group_remove(struct nvme_transport_poll_group *tgroup,
+			    struct spdk_nvme_qpair *qpair)
+{
+	return 0;
+}
+
+int64_t
+nvme_pcie_poll_group_process_completions(struct nvme_transport_poll_group *tgroup,
+		uint32_t completions_per_qpair, spdk_nvme_disconnected_qpair_cb disconnected_qpair_cb)
+{
+	struct spdk_nvme_qpair *qpair;
+	int32_t local_completions;
+	int64_t num_completions = 0;
+
+	TAILQ_FOREACH(qpair, &tgroup->qpairs, poll_group_tailq) {
+		local_completions = spdk_nvme_qpair_process_completions(qpair, completions_per_qpair);
+		if (local_completions < 0) {
+			disconnected_qpair_cb(qpair, tgroup->group->ctx);
+			local_completions = 0;
+		}
+		num_completions += local_completions;
+	}
+
+	return num_completions;
+}
+
+int
+nvme_pcie_poll_group_destroy(struct nvme_transport_poll_group *tgroup)
+{
+	free(tgroup);
+	return 0;
+}
@@ -0,0 +1,184 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * NVMe poll groups: qpairs of any controllers and transports polled in one call
+ */
+
+#include "nvme_internal.h"
+
+struct spdk_nvme_poll_group *
+spdk_nvme_poll_group_create(void *ctx)
+{
+	struct spdk_nvme_poll_group *group;
+
+	group = calloc(1, sizeof(*group));
+	if (group == NULL) {
+		return NULL;
+	}
+
+	group->ctx = ctx;
+	STAILQ_INIT(&group->tgroups);
+
+	return group;
+}
+
+int
+spdk_nvme_poll_group_add(struct spdk_nvme_poll_group *group, struct spdk_nvme_qpair *qpair)
+{
+	struct nvme_transport_poll_group *tgroup;
+	int rc;
+
+	if (qpair->poll_group != NULL || nvme_qpair_is_admin_queue(qpair)) {
+		return -EINVAL;
+	}
+
+	STAILQ_FOREACH(tgroup, &group->tgroups, link) {
+		if (tgroup->trtype == qpair->trtype) {
+			break;
+		}
+	}
+
+	if (tgroup == NULL) {
+		tgroup = nvme_transport_poll_group_create(qpair->trtype);
+		if (tgroup == NULL) {
+			return -ENOMEM;
+		}
+		tgroup->group = group;
+		tgroup->trtype = qpair->trtype;
+		TAILQ_INIT(&tgroup->qpairs);
+		STAILQ_INSERT_TAIL(&group->tgroups, tgroup, link);
+	}
+
+	qpair->poll_group = tgroup;
+	TAILQ_INSERT_TAIL(&tgroup->qpairs, qpair, poll_group_tailq);
+
+	rc = nvme_transport_poll_group_add(tgroup, qpair);
+	if (rc != 0) {
+		TAILQ_REMOVE(&tgroup->qpairs, qpair, poll_group_tailq);
+		qpair->poll_group = NULL;
+	}
+
+	return rc;
+}
+
+int
+nvme_poll_group_remove_qpair(struct spdk_nvme_qpair *qpair)
+{
+	struct nvme_transport_poll_group *tgroup = qpair->poll_group;
+	int rc;
+
+	rc = nvme_transport_poll_group_remove(tgroup, qpair);
+	if (rc != 0) {
+		return rc;
+	}
+
+	TAILQ_REMOVE(&tgroup->qpairs, qpair, poll_group_tailq);
+	qpair->poll_group = NULL;
+
+	return 0;
+}
+
+int
+spdk_nvme_poll_group_remove(struct spdk_nvme_poll_group *group, struct spdk_nvme_qpair *qpair)
+{
+	if (qpair->poll_group == NULL || qpair->poll_group->group != group) {
+		return -ENOENT;
+	}
+
+	if (group->in_completion_context) {
+		return -EBUSY;
+	}
+
+	return nvme_poll_group_remove_qpair(qpair);
+}
+
+int64_t
+spdk_nvme_poll_group_process_completions(struct spdk_nvme_poll_group *group,
+		uint32_t completions_per_qpair, spdk_nvme_disconnected_qpair_cb disconnected_qpair_cb)
+{
+	struct nvme_transport_poll_group *tgroup;
+	struct spdk_nvme_qpair *qpair, *tmp;
+	int64_t num_completions = 0;
+
+	assert(disconnected_qpair_cb != NULL);
+	assert(!group->in_completion_context);
+
+	group->in_completion_context = true;
+	STAILQ_FOREACH(tgroup, &group->tgroups, link) {
+		num_completions += nvme_transport_poll_group_process_completions(tgroup,
+				   completions_per_qpair, disconnected_qpair_cb);
+	}
+	group->in_completion_context = false;
+
+	if (spdk_unlikely(group->has_deferred_deletes)) {
+		group->has_deferred_deletes = false;
+		STAILQ_FOREACH(tgroup, &group->tgroups, link) {
+			TAILQ_FOREACH_SAFE(qpair, &tgroup->qpairs, poll_group_tailq, tmp) {
+				if (qpair->delete_after_completion_context) {
+					spdk_nvme_ctrlr_free_io_qpair(qpair);
+				}
+			}
+		}
+	}
+
+	return num_completions;
+}
+
+void *
+spdk_nvme_poll_group_get_ctx(struct spdk_nvme_poll_group *group)
+{
+	return group->ctx;
+}
+
+int
+spdk_nvme_poll_group_destroy(struct spdk_nvme_poll_group *group)
+{
+	struct nvme_transport_poll_group *tgroup;
+
+	STAILQ_FOREACH(tgroup, &group->tgroups, link) {
+		if (!TAILQ_EMPTY(&tgroup->qpairs)) {
+			return -EBUSY;
+		}
+	}
+
+	while (!STAILQ_EMPTY(&group->tgroups)) {
+		tgroup = STAILQ_FIRST(&group->tgroups);
+		STAILQ_REMOVE_HEAD(&group->tgroups, link);
+		nvme_transport_poll_group_destroy(tgroup);
+	}
+
+	free(group);
+
+	return 0;
+}
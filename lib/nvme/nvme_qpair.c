@@ -433,12 +433,14 @@ nvme_qpair_check_enabled(struct spdk_nvme_qpair *qpair)
 	return nvme_qpair_state_equals(qpair, NVME_QPAIR_ENABLED);
 }
 
-int32_t
-spdk_nvme_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_completions)
+/*
+ * Called by the poll paths before the transport reaps completions for a qpair.
+ *  Returns 1 if completions should be reaped, 0 if the qpair is not enabled and
+ *  -ENXIO if it failed.
+ */
+int
+nvme_qpair_completions_prepare(struct spdk_nvme_qpair *qpair)
 {
-	int32_t ret;
-	int32_t resubmit_rc;
-	int32_t i;
 	struct nvme_request *req, *tmp;
 
 	if (spdk_unlikely(qpair->ctrlr->is_failed)) {
@@ -473,8 +475,20 @@ spdk_nvme_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_
 		}
 	}
 
-	qpair->in_completion_context = 1;
-	ret = nvme_transport_qpair_process_completions(qpair, max_completions);
+	return 1;
+}
+
+/*
+ * Called by the poll paths once the transport reaped ret completions for a qpair,
+ *  with in_completion_context set since nvme_qpair_completions_prepare().
+ */
+int32_t
+nvme_qpair_completions_done(struct spdk_nvme_qpair *qpair, int32_t ret)
+{
+	int32_t resubmit_rc;
+	int32_t i;
+	struct nvme_request *req;
+
 	if (ret < 0) {
 		SPDK_ERRLOG("CQ error, abort requests after transport retry counter exceeded\n");
 		if (nvme_qpair_is_admin_queue(qpair)) {
@@ -510,6 +524,29 @@ spdk_nvme_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_
 	return ret;
 }
 
+int32_t
+spdk_nvme_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_completions)
+{
+	int32_t ret;
+
+	ret = nvme_qpair_completions_prepare(qpair);
+	if (ret <= 0) {
+		return ret;
+	}
+
+	qpair->in_completion_context = 1;
+	ret = nvme_transport_qpair_process_completions(qpair, max_completions);
+
+	return nvme_qpair_completions_done(qpair, ret);
+}
+
+int
+spdk_nvme_qpair_get_doorbell_stats(struct spdk_nvme_qpair *qpair,
+				   struct spdk_nvme_qpair_doorbell_stats *stats)
+{
+	return nvme_transport_qpair_get_doorbell_stats(qpair, stats);
+}
+
 int
 nvme_qpair_init(struct spdk_nvme_qpair *qpair, uint16_t id,
 		struct spdk_nvme_ctrlr *ctrlr,
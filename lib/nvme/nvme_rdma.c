@@ -72,6 +72,14 @@
 /* CM event processing timeout */
 #define NVME_RDMA_QPAIR_CM_EVENT_TIMEOUT_US	100000
 
+#define MAX_COMPLETIONS_PER_POLL 128
+
+/* Initial size of the CQ shared by the qpairs of a poll group on one device */
+#define NVME_RDMA_POLLER_CQ_SIZE		4096
+
+/* Time to wait for the work requests of a qpair on a shared CQ to be flushed */
+#define NVME_RDMA_QPAIR_DRAIN_TIMEOUT_US	1000000
+
 struct spdk_nvmf_cmd {
 	struct spdk_nvme_cmd cmd;
 	struct spdk_nvme_sgl_descriptor sgl[NVME_RDMA_MAX_SGL_DESCRIPTORS];
@@ -110,6 +118,52 @@ struct nvme_rdma_ctrlr {
 	struct nvme_rdma_cm_event_entry		*cm_events;
 };
 
+/*
+ * Context of every send and receive work request, so that a completion reaped
+ *  from a CQ shared by several qpairs can be routed to its qpair.
+ */
+struct nvme_rdma_wr {
+	struct nvme_rdma_qpair			*rqpair;
+};
+
+/* Completion reaped from a shared CQ while another qpair polled it on its own */
+struct nvme_rdma_deferred_wc {
+	struct ibv_wc				wc;
+	/* NULL once the completion was handled or its qpair disconnected */
+	struct nvme_rdma_qpair			*rqpair;
+	uint32_t				generation;
+};
+
+/* CQ shared by the qpairs of a poll group connected on the same device */
+struct nvme_rdma_poller {
+	struct ibv_context			*device;
+	struct ibv_cq				*cq;
+	int					cq_size;
+
+	/* CQ entries the qpairs connected on the CQ may use */
+	int					required_cq_size;
+
+	/* Set while the CQ is reaped, so that it is neither reaped again nor resized */
+	bool					busy;
+
+	/* Array of cq_size entries */
+	struct nvme_rdma_deferred_wc		*deferred_wcs;
+	uint32_t				num_deferred_wcs;
+
+	STAILQ_ENTRY(nvme_rdma_poller)		link;
+};
+
+/* NVMe RDMA transport extensions for nvme_transport_poll_group */
+struct nvme_rdma_poll_group {
+	struct nvme_transport_poll_group	group;
+	STAILQ_HEAD(, nvme_rdma_poller)		pollers;
+};
+
+struct spdk_nvme_rdma_rsp {
+	struct nvme_rdma_wr			rdma_wr;
+	uint16_t				idx;
+};
+
 /* NVMe RDMA qpair extensions for spdk_nvme_qpair */
 struct nvme_rdma_qpair {
 	struct spdk_nvme_qpair			qpair;
@@ -131,6 +185,7 @@ struct nvme_rdma_qpair {
 	struct spdk_nvme_cpl			*rsps;
 
 	struct ibv_recv_wr			*rsp_recv_wrs;
+	struct spdk_nvme_rdma_rsp		*rdma_rsps;
 
 	/* Memory region describing all rsps for this qpair */
 	struct ibv_mr				*rsp_mr;
@@ -149,6 +204,19 @@ struct nvme_rdma_qpair {
 	TAILQ_HEAD(, spdk_nvme_rdma_req)	free_reqs;
 	TAILQ_HEAD(, spdk_nvme_rdma_req)	outstanding_reqs;
 
+	/* Shared CQ of the poll group, or NULL if cq belongs to this qpair */
+	struct nvme_rdma_poller			*poller;
+
+	/* Work requests posted and not reaped from the CQ yet */
+	uint32_t				num_outstanding_wrs;
+
+	/* Bumped on disconnect, so that completions reaped before are dropped */
+	uint32_t				generation;
+
+	/* Responses handled for this qpair by the poll group poll in progress */
+	int32_t					num_completions;
+	bool					poll_active;
+
 	/* Placed at the end of the struct since it is not used frequently */
 	struct rdma_cm_event			*evt;
 };
@@ -156,6 +224,8 @@ struct nvme_rdma_qpair {
 struct spdk_nvme_rdma_req {
 	int					id;
 
+	struct nvme_rdma_wr			rdma_wr;
+
 	struct ibv_send_wr			send_wr;
 
 	struct nvme_request			*req;
@@ -205,6 +275,19 @@ nvme_rdma_ctrlr(struct spdk_nvme_ctrlr *ctrlr)
 	return SPDK_CONTAINEROF(ctrlr, struct nvme_rdma_ctrlr, ctrlr);
 }
 
+static inline struct nvme_rdma_poll_group *
+nvme_rdma_poll_group(struct nvme_transport_poll_group *tgroup)
+{
+	assert(tgroup->trtype == SPDK_NVME_TRANSPORT_RDMA);
+	return SPDK_CONTAINEROF(tgroup, struct nvme_rdma_poll_group, group);
+}
+
+static inline struct nvme_rdma_qpair *
+nvme_rdma_wc_qpair(struct ibv_wc *wc)
+{
+	return ((struct nvme_rdma_wr *)wc->wr_id)->rqpair;
+}
+
 static struct spdk_nvme_rdma_req *
 nvme_rdma_req_get(struct nvme_rdma_qpair *rqpair)
 {
@@ -398,6 +481,150 @@ nvme_rdma_process_event(struct nvme_rdma_qpair *rqpair,
 	return rc == 0 ? rc2 : rc;
 }
 
+static struct nvme_rdma_poller *
+nvme_rdma_poller_get(struct nvme_rdma_poll_group *group, struct ibv_context *device,
+		     int cq_entries)
+{
+	struct nvme_rdma_poller *poller;
+	struct nvme_rdma_deferred_wc *deferred_wcs;
+	int cq_size;
+
+	STAILQ_FOREACH(poller, &group->pollers, link) {
+		if (poller->device == device) {
+			break;
+		}
+	}
+
+	if (poller == NULL) {
+		poller = calloc(1, sizeof(*poller));
+		if (poller == NULL) {
+			SPDK_ERRLOG("Unable to allocate a poller\n");
+			return NULL;
+		}
+
+		poller->device = device;
+		poller->cq_size = spdk_max(NVME_RDMA_POLLER_CQ_SIZE, cq_entries);
+		poller->cq = ibv_create_cq(device, poller->cq_size, poller, NULL, 0);
+		if (poller->cq == NULL) {
+			SPDK_ERRLOG("Unable to create shared completion queue: errno %d: %s\n", errno,
+				    spdk_strerror(errno));
+			free(poller);
+			return NULL;
+		}
+
+		poller->deferred_wcs = calloc(poller->cq_size, sizeof(*poller->deferred_wcs));
+		if (poller->deferred_wcs == NULL) {
+			SPDK_ERRLOG("Unable to allocate deferred completions\n");
+			ibv_destroy_cq(poller->cq);
+			free(poller);
+			return NULL;
+		}
+
+		STAILQ_INSERT_TAIL(&group->pollers, poller, link);
+	}
+
+	if (poller->required_cq_size + cq_entries > poller->cq_size) {
+		/* Resizing would move the deferred completions underneath a poll in progress. */
+		if (poller->busy) {
+			return NULL;
+		}
+
+		cq_size = spdk_max(poller->cq_size * 2, poller->required_cq_size + cq_entries);
+		if (ibv_resize_cq(poller->cq, cq_size)) {
+			SPDK_ERRLOG("Unable to resize shared completion queue to %d entries\n", cq_size);
+			return NULL;
+		}
+
+		deferred_wcs = realloc(poller->deferred_wcs, cq_size * sizeof(*deferred_wcs));
+		if (deferred_wcs == NULL) {
+			SPDK_ERRLOG("Unable to allocate deferred completions\n");
+			return NULL;
+		}
+		poller->deferred_wcs = deferred_wcs;
+		poller->cq_size = cq_size;
+	}
+
+	poller->required_cq_size += cq_entries;
+
+	return poller;
+}
+
+static void
+nvme_rdma_poller_defer_wc(struct nvme_rdma_poller *poller, struct nvme_rdma_qpair *rqpair,
+			  struct ibv_wc *wc, uint32_t generation)
+{
+	struct nvme_rdma_deferred_wc *deferred;
+
+	if (spdk_unlikely(poller->num_deferred_wcs == (uint32_t)poller->cq_size)) {
+		SPDK_ERRLOG("Unable to defer a completion of qpair %p\n", rqpair);
+		rqpair->qpair.transport_qp_is_failed = true;
+		return;
+	}
+
+	deferred = &poller->deferred_wcs[poller->num_deferred_wcs++];
+	deferred->wc = *wc;
+	deferred->rqpair = rqpair;
+	deferred->generation = generation;
+}
+
+static void
+nvme_rdma_poller_purge_qpair(struct nvme_rdma_poller *poller, struct nvme_rdma_qpair *rqpair)
+{
+	uint32_t i;
+
+	/* Entries are only compacted by the poll owning the CQ. */
+	for (i = 0; i < poller->num_deferred_wcs; i++) {
+		if (poller->deferred_wcs[i].rqpair == rqpair) {
+			poller->deferred_wcs[i].rqpair = NULL;
+		}
+	}
+}
+
+/*
+ * Flush the work requests of a qpair on a shared CQ, so that none of them completes
+ *  once the qpair is gone. Completions of other qpairs are deferred meanwhile.
+ */
+static void
+nvme_rdma_poller_drain_qpair(struct nvme_rdma_poller *poller, struct nvme_rdma_qpair *rqpair)
+{
+	struct ibv_qp_attr		attr = {};
+	struct ibv_wc			wc[MAX_COMPLETIONS_PER_POLL];
+	struct nvme_rdma_qpair		*other;
+	uint64_t			timeout_tsc;
+	int				i, rc;
+
+	attr.qp_state = IBV_QPS_ERR;
+	if (ibv_modify_qp(rqpair->cm_id->qp, &attr, IBV_QP_STATE)) {
+		SPDK_ERRLOG("Unable to move qpair %p to the error state\n", rqpair);
+	}
+
+	timeout_tsc = spdk_get_ticks() + NVME_RDMA_QPAIR_DRAIN_TIMEOUT_US * spdk_get_ticks_hz() /
+		      SPDK_SEC_TO_USEC;
+	while (rqpair->num_outstanding_wrs > 0) {
+		if (spdk_get_ticks() > timeout_tsc) {
+			SPDK_ERRLOG("Timed out flushing %u work requests of qpair %p\n",
+				    rqpair->num_outstanding_wrs, rqpair);
+			break;
+		}
+
+		rc = ibv_poll_cq(poller->cq, MAX_COMPLETIONS_PER_POLL, wc);
+		if (rc < 0) {
+			SPDK_ERRLOG("Error polling CQ! (%d): %s\n", errno, spdk_strerror(errno));
+			break;
+		}
+
+		for (i = 0; i < rc; i++) {
+			other = nvme_rdma_wc_qpair(&wc[i]);
+			other->num_outstanding_wrs--;
+			if (other != rqpair) {
+				nvme_rdma_poller_defer_wc(poller, other, &wc[i], other->generation);
+			}
+		}
+	}
+
+	nvme_rdma_poller_purge_qpair(poller, rqpair);
+}
+
 static int
 nvme_rdma_qpair_init(struct nvme_rdma_qpair *rqpair)
 {
@@ -412,10 +639,20 @@ nvme_rdma_qpair_init(struct nvme_rdma_qpair *rqpair)
 		return -1;
 	}
 
-	rqpair->cq = ibv_create_cq(rqpair->cm_id->verbs, rqpair->num_entries * 2, rqpair, NULL, 0);
-	if (!rqpair->cq) {
-		SPDK_ERRLOG("Unable to create completion queue: errno %d: %s\n", errno, spdk_strerror(errno));
-		return -1;
+	if (rqpair->qpair.poll_group != NULL) {
+		rqpair->poller = nvme_rdma_poller_get(nvme_rdma_poll_group(rqpair->qpair.poll_group),
+						      rqpair->cm_id->verbs, rqpair->num_entries * 2);
+	}
+
+	if (rqpair->poller != NULL) {
+		rqpair->cq = rqpair->poller->cq;
+	} else {
+		rqpair->cq = ibv_create_cq(rqpair->cm_id->verbs, rqpair->num_entries * 2, rqpair, NULL, 0);
+		if (!rqpair->cq) {
+			SPDK_ERRLOG("Unable to create completion queue: errno %d: %s\n", errno,
+				    spdk_strerror(errno));
+			return -1;
+		}
 	}
 
 	rctrlr = nvme_rdma_ctrlr(rqpair->qpair.ctrlr);
@@ -470,6 +707,8 @@ nvme_rdma_post_recv(struct nvme_rdma_qpair *rqpair, uint16_t rsp_idx)
 	rc = ibv_post_recv(rqpair->cm_id->qp, wr, &bad_wr);
 	if (rc) {
 		SPDK_ERRLOG("Failure posting rdma recv, rc = 0x%x\n", rc);
+	} else {
+		rqpair->num_outstanding_wrs++;
 	}
 
 	return rc;
@@ -493,13 +732,18 @@ nvme_rdma_free_rsps(struct nvme_rdma_qpair *rqpair)
 	rqpair->rsp_sgls = NULL;
 	free(rqpair->rsp_recv_wrs);
 	rqpair->rsp_recv_wrs = NULL;
+	free(rqpair->rdma_rsps);
+	rqpair->rdma_rsps = NULL;
 }
 
 static int
 nvme_rdma_alloc_rsps(struct nvme_rdma_qpair *rqpair)
 {
+	uint16_t i;
+
 	rqpair->rsps = NULL;
 	rqpair->rsp_recv_wrs = NULL;
+	rqpair->rdma_rsps = NULL;
 
 	rqpair->rsp_sgls = calloc(rqpair->num_entries, sizeof(*rqpair->rsp_sgls));
 	if (!rqpair->rsp_sgls) {
@@ -520,6 +764,17 @@ nvme_rdma_alloc_rsps(struct nvme_rdma_qpair *rqpair)
 		goto fail;
 	}
 
+	rqpair->rdma_rsps = calloc(rqpair->num_entries, sizeof(*rqpair->rdma_rsps));
+	if (!rqpair->rdma_rsps) {
+		SPDK_ERRLOG("can not allocate rdma rsp contexts\n");
+		goto fail;
+	}
+
+	for (i = 0; i < rqpair->num_entries; i++) {
+		rqpair->rdma_rsps[i].rdma_wr.rqpair = rqpair;
+		rqpair->rdma_rsps[i].idx = i;
+	}
+
 	return 0;
 fail:
 	nvme_rdma_free_rsps(rqpair);
@@ -545,7 +800,7 @@ nvme_rdma_register_rsps(struct nvme_rdma_qpair *rqpair)
 		rsp_sgl->length = sizeof(rqpair->rsps[i]);
 		rsp_sgl->lkey = rqpair->rsp_mr->lkey;
 
-		rqpair->rsp_recv_wrs[i].wr_id = i;
+		rqpair->rsp_recv_wrs[i].wr_id = (uint64_t)&rqpair->rdma_rsps[i].rdma_wr;
 		rqpair->rsp_recv_wrs[i].next = NULL;
 		rqpair->rsp_recv_wrs[i].sg_list = rsp_sgl;
 		rqpair->rsp_recv_wrs[i].num_sge = 1;
@@ -620,7 +875,8 @@ nvme_rdma_alloc_reqs(struct nvme_rdma_qpair *rqpair)
 		 * an NVMe-oF SGL is required, the length of
 		 * this element may change. */
 		rdma_req->send_sgl[0].addr = (uint64_t)cmd;
-		rdma_req->send_wr.wr_id = (uint64_t)rdma_req;
+		rdma_req->rdma_wr.rqpair = rqpair;
+		rdma_req->send_wr.wr_id = (uint64_t)&rdma_req->rdma_wr;
 		rdma_req->send_wr.next = NULL;
 		rdma_req->send_wr.opcode = IBV_WR_SEND;
 		rdma_req->send_wr.send_flags = IBV_SEND_SIGNALED;
@@ -1448,12 +1704,6 @@ nvme_rdma_ctrlr_create_qpair(struct spdk_nvme_ctrlr *ctrlr,
 	}
 	SPDK_DEBUGLOG(SPDK_LOG_NVME, "RDMA responses allocated\n");
 
-	rc = nvme_transport_ctrlr_connect_qpair(ctrlr, qpair);
-	if (rc < 0) {
-		nvme_rdma_qpair_destroy(qpair);
-		return NULL;
-	}
-
 	return qpair;
 }
 
@@ -1463,6 +1713,10 @@ nvme_rdma_qpair_disconnect(struct spdk_nvme_qpair *qpair)
 	struct nvme_rdma_qpair *rqpair = nvme_rdma_qpair(qpair);
 
 	qpair->transport_qp_is_failed = true;
+	if (rqpair->poller != NULL && rqpair->cm_id != NULL && rqpair->cm_id->qp != NULL) {
+		nvme_rdma_poller_drain_qpair(rqpair->poller, rqpair);
+	}
+
 	nvme_rdma_unregister_mem(rqpair);
 	nvme_rdma_unregister_reqs(rqpair);
 	nvme_rdma_unregister_rsps(rqpair);
@@ -1480,10 +1734,18 @@ nvme_rdma_qpair_disconnect(struct spdk_nvme_qpair *qpair)
 		rqpair->cm_id = NULL;
 	}
 
-	if (rqpair->cq) {
+	if (rqpair->poller != NULL) {
+		/* The CQ belongs to the poll group. */
+		rqpair->poller->required_cq_size -= rqpair->num_entries * 2;
+		rqpair->poller = NULL;
+		rqpair->cq = NULL;
+	} else if (rqpair->cq) {
 		ibv_destroy_cq(rqpair->cq);
 		rqpair->cq = NULL;
 	}
+
+	rqpair->num_outstanding_wrs = 0;
+	rqpair->generation++;
 }
 
 static int
@@ -1616,6 +1878,13 @@ struct spdk_nvme_ctrlr *nvme_rdma_ctrlr_construct(const struct spdk_nvme_transpo
 		return NULL;
 	}
 
+	rc = nvme_transport_ctrlr_connect_qpair(&rctrlr->ctrlr, rctrlr->ctrlr.adminq);
+	if (rc < 0) {
+		SPDK_ERRLOG("failed to connect admin qpair\n");
+		nvme_rdma_ctrlr_destruct(&rctrlr->ctrlr);
+		return NULL;
+	}
+
 	if (nvme_ctrlr_get_cap(&rctrlr->ctrlr, &cap)) {
 		SPDK_ERRLOG("get_cap() failed\n");
 		nvme_ctrlr_destruct(&rctrlr->ctrlr);
@@ -1727,6 +1996,8 @@ nvme_rdma_qpair_submit_request(struct spdk_nvme_qpair *qpair,
 	if (rc) {
 		SPDK_ERRLOG("Failure posting rdma send for NVMf completion: %d (%s)\n", rc, spdk_strerror(rc));
 		nvme_rdma_req_put(rqpair, rdma_req);
+	} else {
+		rqpair->num_outstanding_wrs++;
 	}
 
 	return rc;
@@ -1817,7 +2088,194 @@ nvme_rdma_qpair_check_timeout(struct spdk_nvme_qpair *qpair)
 	}
 }
 
-#define MAX_COMPLETIONS_PER_POLL 128
+/*
+ * Handle a completion of rqpair. Returns 1 for a response, 0 for a send and -ENXIO
+ *  if the qpair failed.
+ */
+static int
+nvme_rdma_qpair_process_wc(struct nvme_rdma_qpair *rqpair, struct ibv_wc *wc)
+{
+	struct nvme_rdma_wr		*rdma_wr = (struct nvme_rdma_wr *)wc->wr_id;
+	struct spdk_nvme_rdma_rsp	*rdma_rsp;
+	struct spdk_nvme_rdma_req	*rdma_req;
+
+	if (wc->status) {
+		SPDK_ERRLOG("CQ error on Queue Pair %p, Work Request %p (%d): %s\n",
+			    &rqpair->qpair, rdma_wr, wc->status, ibv_wc_status_str(wc->status));
+		return -ENXIO;
+	}
+
+	switch (wc->opcode) {
+	case IBV_WC_RECV:
+		SPDK_DEBUGLOG(SPDK_LOG_NVME, "CQ recv completion\n");
+
+		if (wc->byte_len < sizeof(struct spdk_nvme_cpl)) {
+			SPDK_ERRLOG("recv length %u less than expected response size\n", wc->byte_len);
+			return -ENXIO;
+		}
+
+		rdma_rsp = SPDK_CONTAINEROF(rdma_wr, struct spdk_nvme_rdma_rsp, rdma_wr);
+		if (nvme_rdma_recv(rqpair, rdma_rsp->idx)) {
+			SPDK_ERRLOG("nvme_rdma_recv processing failure\n");
+			return -ENXIO;
+		}
+		return 1;
+
+	case IBV_WC_SEND:
+		rdma_req = SPDK_CONTAINEROF(rdma_wr, struct spdk_nvme_rdma_req, rdma_wr);
+
+		if (rdma_req->request_ready_to_put) {
+			nvme_rdma_req_put(rqpair, rdma_req);
+		} else {
+			rdma_req->request_ready_to_put = true;
+		}
+		return 0;
+
+	default:
+		SPDK_ERRLOG("Received an unexpected opcode on the CQ: %d\n", wc->opcode);
+		return -ENXIO;
+	}
+}
+
+/*
+ * Handle a completion reaped from a shared CQ. A failing qpair is only marked failed,
+ *  it is disconnected once the owner of the CQ is done with the completions in hand.
+ */
+static uint32_t
+nvme_rdma_poller_handle_wc(struct nvme_rdma_qpair *rqpair, struct ibv_wc *wc, uint32_t generation)
+{
+	int rc;
+
+	if (generation != rqpair->generation || rqpair->qpair.transport_qp_is_failed) {
+		return 0;
+	}
+
+	rc = nvme_rdma_qpair_process_wc(rqpair, wc);
+	if (rc < 0) {
+		rqpair->qpair.transport_qp_is_failed = true;
+		return 0;
+	}
+
+	rqpair->num_completions += rc;
+	return rc;
+}
+
+static uint64_t
+nvme_rdma_poller_process_deferred(struct nvme_rdma_poller *poller, struct nvme_rdma_qpair *only)
+{
+	struct nvme_rdma_deferred_wc	*deferred;
+	struct nvme_rdma_qpair		*rqpair;
+	uint64_t			reaped = 0;
+	uint32_t			i, j;
+
+	/* Completions deferred by a qpair drained meanwhile are appended and handled as well. */
+	for (i = 0; i < poller->num_deferred_wcs; i++) {
+		deferred = &poller->deferred_wcs[i];
+		rqpair = deferred->rqpair;
+		if (rqpair == NULL || (only != NULL && rqpair != only)) {
+			continue;
+		}
+
+		deferred->rqpair = NULL;
+		reaped += nvme_rdma_poller_handle_wc(rqpair, &deferred->wc, deferred->generation);
+	}
+
+	for (i = 0, j = 0; i < poller->num_deferred_wcs; i++) {
+		if (poller->deferred_wcs[i].rqpair != NULL) {
+			if (i != j) {
+				poller->deferred_wcs[j] = poller->deferred_wcs[i];
+			}
+			j++;
+		}
+	}
+	poller->num_deferred_wcs = j;
+
+	return reaped;
+}
+
+/*
+ * Reap a shared CQ, starting with the completions deferred by earlier polls. With only
+ *  set, the completions of the other qpairs are deferred to the next poll of the group.
+ *  Returns the number of responses handled.
+ */
+static uint64_t
+nvme_rdma_poller_poll(struct nvme_rdma_poller *poller, struct nvme_rdma_qpair *only,
+		      uint64_t max_completions)
+{
+	struct ibv_wc			wc[MAX_COMPLETIONS_PER_POLL];
+	uint32_t			generations[MAX_COMPLETIONS_PER_POLL];
+	struct nvme_rdma_qpair		*rqpair;
+	uint64_t			reaped;
+	int				i, rc, batch_size;
+
+	poller->busy = true;
+
+	reaped = nvme_rdma_poller_process_deferred(poller, only);
+	while (reaped < max_completions) {
+		batch_size = spdk_min(max_completions - reaped, MAX_COMPLETIONS_PER_POLL);
+		rc = ibv_poll_cq(poller->cq, batch_size, wc);
+		if (rc < 0) {
+			SPDK_ERRLOG("Error polling CQ! (%d): %s\n", errno, spdk_strerror(errno));
+			if (only != NULL) {
+				only->qpair.transport_qp_is_failed = true;
+			}
+			break;
+		} else if (rc == 0) {
+			/* Ran out of completions */
+			break;
+		}
+
+		/* Account for the whole batch first, a completion callback may disconnect a qpair. */
+		for (i = 0; i < rc; i++) {
+			rqpair = nvme_rdma_wc_qpair(&wc[i]);
+			rqpair->num_outstanding_wrs--;
+			generations[i] = rqpair->generation;
+		}
+
+		for (i = 0; i < rc; i++) {
+			rqpair = nvme_rdma_wc_qpair(&wc[i]);
+			if (only != NULL && rqpair != only) {
+				if (generations[i] == rqpair->generation) {
+					nvme_rdma_poller_defer_wc(poller, rqpair, &wc[i], generations[i]);
+				}
+				continue;
+			}
+
+			reaped += nvme_rdma_poller_handle_wc(rqpair, &wc[i], generations[i]);
+		}
+	}
+
+	poller->busy = false;
+
+	return reaped;
+}
+
+static int32_t
+nvme_rdma_qpair_process_shared_completions(struct nvme_rdma_qpair *rqpair,
+		uint32_t max_completions)
+{
+	struct spdk_nvme_poll_group	*group = rqpair->qpair.poll_group->group;
+	bool				in_completion_context;
+	int32_t				reaped;
+
+	/* The poll group is reaping the CQ, the completions of this qpair are handled there. */
+	if (rqpair->poller->busy) {
+		return 0;
+	}
+
+	/* Other qpairs of the group freed from the callbacks must outlive the completions in hand. */
+	in_completion_context = group->in_completion_context;
+	group->in_completion_context = true;
+	reaped = nvme_rdma_poller_poll(rqpair->poller, rqpair, max_completions);
+	group->in_completion_context = in_completion_context;
+
+	if (spdk_unlikely(rqpair->qpair.transport_qp_is_failed)) {
+		nvme_rdma_qpair_disconnect(&rqpair->qpair);
+		return -ENXIO;
+	}
+
+	return reaped;
+}
 
 int
 nvme_rdma_qpair_process_completions(struct spdk_nvme_qpair *qpair,
@@ -1826,9 +2284,8 @@ nvme_rdma_qpair_process_completions(struct spdk_nvme_qpair *qpair,
 	struct nvme_rdma_qpair		*rqpair = nvme_rdma_qpair(qpair);
 	struct ibv_wc			wc[MAX_COMPLETIONS_PER_POLL];
 	int				i, rc, batch_size;
-	uint32_t			reaped;
+	int32_t				reaped;
 	struct ibv_cq			*cq;
-	struct spdk_nvme_rdma_req	*rdma_req;
 	struct nvme_rdma_ctrlr		*rctrlr;
 
 	if (max_completions == 0) {
@@ -1847,6 +2304,14 @@ nvme_rdma_qpair_process_completions(struct spdk_nvme_qpair *qpair,
 		goto fail;
 	}
 
+	if (rqpair->poller != NULL) {
+		reaped = nvme_rdma_qpair_process_shared_completions(rqpair, max_completions);
+		if (reaped < 0) {
+			return reaped;
+		}
+		goto out;
+	}
+
 	cq = rqpair->cq;
 
 	reaped = 0;
@@ -1863,47 +2328,17 @@ nvme_rdma_qpair_process_completions(struct spdk_nvme_qpair *qpair,
 			break;
 		}
 
+		rqpair->num_outstanding_wrs -= rc;
 		for (i = 0; i < rc; i++) {
-			if (wc[i].status) {
-				SPDK_ERRLOG("CQ error on Queue Pair %p, Response Index %lu (%d): %s\n",
-					    qpair, wc[i].wr_id, wc[i].status, ibv_wc_status_str(wc[i].status));
-				goto fail;
-			}
-
-			switch (wc[i].opcode) {
-			case IBV_WC_RECV:
-				SPDK_DEBUGLOG(SPDK_LOG_NVME, "CQ recv completion\n");
-
-				reaped++;
-
-				if (wc[i].byte_len < sizeof(struct spdk_nvme_cpl)) {
-					SPDK_ERRLOG("recv length %u less than expected response size\n", wc[i].byte_len);
-					goto fail;
-				}
-
-				if (nvme_rdma_recv(rqpair, wc[i].wr_id)) {
-					SPDK_ERRLOG("nvme_rdma_recv processing failure\n");
-					goto fail;
-				}
-				break;
-
-			case IBV_WC_SEND:
-				rdma_req = (struct spdk_nvme_rdma_req *)wc[i].wr_id;
-
-				if (rdma_req->request_ready_to_put) {
-					nvme_rdma_req_put(rqpair, rdma_req);
-				} else {
-					rdma_req->request_ready_to_put = true;
-				}
-				break;
-
-			default:
-				SPDK_ERRLOG("Received an unexpected opcode on the CQ: %d\n", wc[i].opcode);
+			rc = nvme_rdma_qpair_process_wc(rqpair, &wc[i]);
+			if (rc < 0) {
 				goto fail;
 			}
+			reaped += rc;
 		}
-	} while (reaped < max_completions);
+	} while ((uint32_t)reaped < max_completions);
 
+out:
 	if (spdk_unlikely(rqpair->qpair.ctrlr->timeout_enabled)) {
 		nvme_rdma_qpair_check_timeout(qpair);
 	}
@@ -1954,6 +2389,13 @@ nvme_rdma_ctrlr_free_cmb_io_buffer(struct spdk_nvme_ctrlr *ctrlr, void *buf, siz
 	return 0;
 }
 
+int
+nvme_rdma_qpair_get_doorbell_stats(struct spdk_nvme_qpair *qpair,
+				   struct spdk_nvme_qpair_doorbell_stats *stats)
+{
+	return -ENOTSUP;
+}
+
 void
 nvme_rdma_admin_qpair_abort_aers(struct spdk_nvme_qpair *qpair)
 {
@@ -1982,3 +2424,148 @@ spdk_nvme_rdma_init_hooks(struct spdk_nvme_rdma_hooks *hooks)
 {
 	g_nvme_hooks = *hooks;
 }
+
+struct nvme_transport_poll_group *
+nvme_rdma_poll_group_create(void)
+{
+	struct nvme_rdma_poll_group *group;
+
+	group = calloc(1, sizeof(*group));
+	if (group == NULL) {
+		SPDK_ERRLOG("Unable to allocate poll group\n");
+		return NULL;
+	}
+
+	STAILQ_INIT(&group->pollers);
+	return &group->group;
+}
+
+int
+nvme_rdma_poll_group_add(struct nvme_transport_poll_group *tgroup, struct spdk_nvme_qpair *qpair)
+{
+	/* The shared CQ is picked up by nvme_rdma_qpair_init() once the qpair connects. */
+	return 0;
+}
+
+int
+nvme_rdma_poll_group_remove(struct nvme_transport_poll_group *tgroup,
+			    struct spdk_nvme_qpair *qpair)
+{
+	struct nvme_rdma_qpair *rqpair = nvme_rdma_qpair(qpair);
+
+	/* The work requests of the qpair complete on the CQ of the group until it disconnects. */
+	if (rqpair->poller != NULL) {
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
+int64_t
+nvme_rdma_poll_group_process_completions(struct nvme_transport_poll_group *tgroup,
+		uint32_t completions_per_qpair, spdk_nvme_disconnected_qpair_cb disconnected_qpair_cb)
+{
+	struct nvme_rdma_poll_group	*group = nvme_rdma_poll_group(tgroup);
+	struct nvme_rdma_poller		*poller;
+	struct spdk_nvme_qpair		*qpair;
+	struct nvme_rdma_qpair		*rqpair;
+	uint64_t			max_completions;
+	int32_t				local_completions;
+	int64_t				num_completions = 0;
+	int				rc;
+
+	TAILQ_FOREACH(qpair, &tgroup->qpairs, poll_group_tailq) {
+		rqpair = nvme_rdma_qpair(qpair);
+		rqpair->num_completions = 0;
+		rqpair->poll_active = false;
+
+		if (rqpair->poller == NULL) {
+			local_completions = spdk_nvme_qpair_process_completions(qpair, completions_per_qpair);
+			if (local_completions < 0) {
+				disconnected_qpair_cb(qpair, tgroup->group->ctx);
+				local_completions = 0;
+			}
+			num_completions += local_completions;
+			continue;
+		}
+
+		nvme_rdma_qpair_process_cm_event(rqpair);
+
+		rc = nvme_qpair_completions_prepare(qpair);
+		if (rc < 0) {
+			disconnected_qpair_cb(qpair, tgroup->group->ctx);
+		} else if (rc > 0) {
+			qpair->in_completion_context = 1;
+			rqpair->poll_active = true;
+		}
+	}
+
+	STAILQ_FOREACH(poller, &group->pollers, link) {
+		/* Per-qpair limits add up to the limit of the CQ they share. */
+		max_completions = 0;
+		TAILQ_FOREACH(qpair, &tgroup->qpairs, poll_group_tailq) {
+			rqpair = nvme_rdma_qpair(qpair);
+			if (rqpair->poller != poller || !rqpair->poll_active) {
+				continue;
+			}
+			if (completions_per_qpair == 0) {
+				max_completions += rqpair->num_entries;
+			} else {
+				max_completions += spdk_min(completions_per_qpair, rqpair->num_entries);
+			}
+		}
+
+		if (max_completions > 0 || poller->num_deferred_wcs > 0) {
+			nvme_rdma_poller_poll(poller, NULL, max_completions);
+		}
+	}
+
+	TAILQ_FOREACH(qpair, &tgroup->qpairs, poll_group_tailq) {
+		rqpair = nvme_rdma_qpair(qpair);
+		if (rqpair->poller == NULL && !rqpair->poll_active) {
+			continue;
+		}
+
+		if (rqpair->poller != NULL && qpair->transport_qp_is_failed) {
+			nvme_rdma_qpair_disconnect(qpair);
+		}
+
+		if (!rqpair->poll_active) {
+			continue;
+		}
+
+		if (spdk_unlikely(qpair->transport_qp_is_failed)) {
+			nvme_qpair_completions_done(qpair, -ENXIO);
+			disconnected_qpair_cb(qpair, tgroup->group->ctx);
+			continue;
+		}
+
+		if (spdk_unlikely(qpair->ctrlr->timeout_enabled)) {
+			nvme_rdma_qpair_check_timeout(qpair);
+		}
+
+		num_completions += rqpair->num_completions;
+		nvme_qpair_completions_done(qpair, rqpair->num_completions);
+	}
+
+	return num_completions;
+}
+
+int
+nvme_rdma_poll_group_destroy(struct nvme_transport_poll_group *tgroup)
+{
+	struct nvme_rdma_poll_group	*group = nvme_rdma_poll_group(tgroup);
+	struct nvme_rdma_poller		*poller, *tmp;
+
+	STAILQ_FOREACH_SAFE(poller, &group->pollers, link, tmp) {
+		STAILQ_REMOVE(&group->pollers, poller, nvme_rdma_poller, link);
+		if (ibv_destroy_cq(poller->cq)) {
+			SPDK_ERRLOG("Unable to destroy shared completion queue\n");
+		}
+		free(poller->deferred_wcs);
+		free(poller);
+	}
+
+	free(group);
+	return 0;
+}
@@ -63,6 +63,17 @@ struct nvme_tcp_ctrlr {
 	struct spdk_nvme_ctrlr			ctrlr;
 };
 
+/* NVMe TCP transport extensions for nvme_transport_poll_group */
+struct nvme_tcp_poll_group {
+	struct nvme_transport_poll_group	group;
+	/* Sockets of all the connected qpairs of the group */
+	struct spdk_sock_group			*sock_group;
+	/* Arguments of the poll in progress, for the socket callbacks */
+	uint32_t				completions_per_qpair;
+	spdk_nvme_disconnected_qpair_cb		disconnected_qpair_cb;
+	int64_t					num_completions;
+};
+
 /* NVMe TCP qpair extensions for spdk_nvme_qpair */
 struct nvme_tcp_qpair {
 	struct spdk_nvme_qpair			qpair;
@@ -131,6 +142,16 @@ nvme_tcp_ctrlr(struct spdk_nvme_ctrlr *ctrlr)
 	return SPDK_CONTAINEROF(ctrlr, struct nvme_tcp_ctrlr, ctrlr);
 }
 
+static inline struct nvme_tcp_poll_group *
+nvme_tcp_poll_group(struct nvme_transport_poll_group *tgroup)
+{
+	assert(tgroup->trtype == SPDK_NVME_TRANSPORT_TCP);
+	return SPDK_CONTAINEROF(tgroup, struct nvme_tcp_poll_group, group);
+}
+
+static int nvme_tcp_poll_group_add_sock(struct nvme_tcp_poll_group *group,
+					struct nvme_tcp_qpair *tqpair);
+
 static struct nvme_tcp_req *
 nvme_tcp_req_get(struct nvme_tcp_qpair *tqpair)
 {
@@ -235,6 +256,10 @@ nvme_tcp_qpair_disconnect(struct spdk_nvme_qpair *qpair)
 	struct nvme_tcp_qpair *tqpair = nvme_tcp_qpair(qpair);
 	struct nvme_tcp_pdu *pdu;
 
+	if (tqpair->sock != NULL && qpair->poll_group != NULL) {
+		spdk_sock_group_remove_sock(nvme_tcp_poll_group(qpair->poll_group)->sock_group,
+					    tqpair->sock);
+	}
 	spdk_sock_close(&tqpair->sock);
 
 	/* clear the send_queue */
@@ -1598,6 +1623,13 @@ nvme_tcp_qpair_connect(struct nvme_tcp_qpair *tqpair)
 		return -1;
 	}
 
+	if (tqpair->qpair.poll_group != NULL) {
+		rc = nvme_tcp_poll_group_add_sock(nvme_tcp_poll_group(tqpair->qpair.poll_group), tqpair);
+		if (rc != 0) {
+			return -1;
+		}
+	}
+
 	tqpair->maxr2t = NVME_TCP_MAX_R2T_DEFAULT;
 	/* Explicitly set the state and recv_state of tqpair */
 	tqpair->state = NVME_TCP_QPAIR_STATE_INVALID;
@@ -1663,12 +1695,6 @@ nvme_tcp_ctrlr_create_qpair(struct spdk_nvme_ctrlr *ctrlr,
 		return NULL;
 	}
 
-	rc = nvme_transport_ctrlr_connect_qpair(ctrlr, qpair);
-	if (rc < 0) {
-		nvme_tcp_qpair_destroy(qpair);
-		return NULL;
-	}
-
 	return qpair;
 }
 
@@ -1713,6 +1739,13 @@ struct spdk_nvme_ctrlr *nvme_tcp_ctrlr_construct(const struct spdk_nvme_transpor
 		return NULL;
 	}
 
+	rc = nvme_transport_ctrlr_connect_qpair(&tctrlr->ctrlr, tctrlr->ctrlr.adminq);
+	if (rc < 0) {
+		SPDK_ERRLOG("failed to connect admin qpair\n");
+		nvme_tcp_ctrlr_destruct(&tctrlr->ctrlr);
+		return NULL;
+	}
+
 	if (nvme_ctrlr_get_cap(&tctrlr->ctrlr, &cap)) {
 		SPDK_ERRLOG("get_cap() failed\n");
 		nvme_ctrlr_destruct(&tctrlr->ctrlr);
@@ -1773,6 +1806,13 @@ nvme_tcp_ctrlr_free_cmb_io_buffer(struct spdk_nvme_ctrlr *ctrlr, void *buf, size
 	return 0;
 }
 
+int
+nvme_tcp_qpair_get_doorbell_stats(struct spdk_nvme_qpair *qpair,
+				  struct spdk_nvme_qpair_doorbell_stats *stats)
+{
+	return -ENOTSUP;
+}
+
 void
 nvme_tcp_admin_qpair_abort_aers(struct spdk_nvme_qpair *qpair)
 {
@@ -1795,3 +1835,143 @@ nvme_tcp_admin_qpair_abort_aers(struct spdk_nvme_qpair *qpair)
 		nvme_tcp_req_put(tqpair, tcp_req);
 	}
 }
+
+static void
+nvme_tcp_qpair_sock_cb(void *ctx, struct spdk_sock_group *sock_group, struct spdk_sock *sock)
+{
+	struct nvme_tcp_qpair *tqpair = ctx;
+	struct nvme_tcp_poll_group *group = nvme_tcp_poll_group(tqpair->qpair.poll_group);
+	int32_t num_completions;
+
+	num_completions = spdk_nvme_qpair_process_completions(&tqpair->qpair,
+			  group->completions_per_qpair);
+	if (num_completions < 0) {
+		group->disconnected_qpair_cb(&tqpair->qpair, group->group.group->ctx);
+		return;
+	}
+	group->num_completions += num_completions;
+}
+
+static int
+nvme_tcp_poll_group_add_sock(struct nvme_tcp_poll_group *group, struct nvme_tcp_qpair *tqpair)
+{
+	int rc;
+
+	rc = spdk_sock_group_add_sock(group->sock_group, tqpair->sock, nvme_tcp_qpair_sock_cb, tqpair);
+	if (rc != 0) {
+		SPDK_ERRLOG("Unable to add the socket of tqpair=%p to the poll group\n", tqpair);
+	}
+
+	return rc;
+}
+
+/*
+ * Qpairs which still have to be polled although their socket did not become readable:
+ *  pending sends, timeouts, state changes after a reset and failures to report.
+ */
+static bool
+nvme_tcp_qpair_needs_poll(struct nvme_tcp_qpair *tqpair)
+{
+	struct spdk_nvme_qpair *qpair = &tqpair->qpair;
+
+	return qpair->transport_qp_is_failed || qpair->ctrlr->is_failed ||
+	       qpair->ctrlr->timeout_enabled || tqpair->sock == NULL ||
+	       !nvme_qpair_state_equals(qpair, NVME_QPAIR_ENABLED) ||
+	       !TAILQ_EMPTY(&tqpair->send_queue) || !STAILQ_EMPTY(&qpair->err_req_head);
+}
+
+struct nvme_transport_poll_group *
+nvme_tcp_poll_group_create(void)
+{
+	struct nvme_tcp_poll_group *group;
+
+	group = calloc(1, sizeof(*group));
+	if (group == NULL) {
+		SPDK_ERRLOG("Unable to allocate the TCP poll group\n");
+		return NULL;
+	}
+
+	group->sock_group = spdk_sock_group_create(group);
+	if (group->sock_group == NULL) {
+		SPDK_ERRLOG("Unable to create the socket group\n");
+		free(group);
+		return NULL;
+	}
+
+	return &group->group;
+}
+
+int
+nvme_tcp_poll_group_add(struct nvme_transport_poll_group *tgroup, struct spdk_nvme_qpair *qpair)
+{
+	struct nvme_tcp_qpair *tqpair = nvme_tcp_qpair(qpair);
+
+	/* Qpairs which are not connected yet add their socket once they connect. */
+	if (tqpair->sock == NULL) {
+		return 0;
+	}
+
+	return nvme_tcp_poll_group_add_sock(nvme_tcp_poll_group(tgroup), tqpair);
+}
+
+int
+nvme_tcp_poll_group_remove(struct nvme_transport_poll_group *tgroup,
+			   struct spdk_nvme_qpair *qpair)
+{
+	struct nvme_tcp_qpair *tqpair = nvme_tcp_qpair(qpair);
+
+	if (tqpair->sock == NULL) {
+		return 0;
+	}
+
+	return spdk_sock_group_remove_sock(nvme_tcp_poll_group(tgroup)->sock_group, tqpair->sock);
+}
+
+int64_t
+nvme_tcp_poll_group_process_completions(struct nvme_transport_poll_group *tgroup,
+		uint32_t completions_per_qpair, spdk_nvme_disconnected_qpair_cb disconnected_qpair_cb)
+{
+	struct nvme_tcp_poll_group *group = nvme_tcp_poll_group(tgroup);
+	struct spdk_nvme_qpair *qpair;
+	struct nvme_tcp_qpair *tqpair;
+	int32_t num_completions;
+
+	group->completions_per_qpair = completions_per_qpair;
+	group->disconnected_qpair_cb = disconnected_qpair_cb;
+	group->num_completions = 0;
+
+	/* Only the qpairs whose socket became readable are polled here. */
+	if (spdk_sock_group_poll(group->sock_group) < 0) {
+		SPDK_ERRLOG("Failed to poll the socket group\n");
+	}
+
+	TAILQ_FOREACH(qpair, &tgroup->qpairs, poll_group_tailq) {
+		tqpair = nvme_tcp_qpair(qpair);
+		if (spdk_likely(!nvme_tcp_qpair_needs_poll(tqpair))) {
+			continue;
+		}
+
+		num_completions = spdk_nvme_qpair_process_completions(qpair, completions_per_qpair);
+		if (num_completions < 0) {
+			disconnected_qpair_cb(qpair, tgroup->group->ctx);
+			continue;
+		}
+		group->num_completions += num_completions;
+	}
+
+	return group->num_completions;
+}
+
+int
+nvme_tcp_poll_group_destroy(struct nvme_transport_poll_group *tgroup)
+{
+	struct nvme_tcp_poll_group *group = nvme_tcp_poll_group(tgroup);
+
+	if (spdk_sock_group_close(&group->sock_group) != 0) {
+		SPDK_ERRLOG("Failed to close the socket group\n");
+		return -EBUSY;
+	}
+
+	free(group);
+	return 0;
+}
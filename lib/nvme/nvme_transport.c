@@ -223,8 +223,49 @@ nvme_transport_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t
 	NVME_TRANSPORT_CALL(qpair->trtype, qpair_process_completions, (qpair, max_completions));
 }
 
+int
+nvme_transport_qpair_get_doorbell_stats(struct spdk_nvme_qpair *qpair,
+					struct spdk_nvme_qpair_doorbell_stats *stats)
+{
+	NVME_TRANSPORT_CALL(qpair->trtype, qpair_get_doorbell_stats, (qpair, stats));
+}
+
 void
 nvme_transport_admin_qpair_abort_aers(struct spdk_nvme_qpair *qpair)
 {
 	NVME_TRANSPORT_CALL(qpair->trtype, admin_qpair_abort_aers, (qpair));
 }
+
+struct nvme_transport_poll_group *
+nvme_transport_poll_group_create(enum spdk_nvme_transport_type trtype)
+{
+	NVME_TRANSPORT_CALL(trtype, poll_group_create, ());
+}
+
+int
+nvme_transport_poll_group_add(struct nvme_transport_poll_group *tgroup,
+			      struct spdk_nvme_qpair *qpair)
+{
+	NVME_TRANSPORT_CALL(tgroup->trtype, poll_group_add, (tgroup, qpair));
+}
+
+int
+nvme_transport_poll_group_remove(struct nvme_transport_poll_group *tgroup,
+				 struct spdk_nvme_qpair *qpair)
+{
+	NVME_TRANSPORT_CALL(tgroup->trtype, poll_group_remove, (tgroup, qpair));
+}
+
+int64_t
+nvme_transport_poll_group_process_completions(struct nvme_transport_poll_group *tgroup,
+		uint32_t completions_per_qpair, spdk_nvme_disconnected_qpair_cb disconnected_qpair_cb)
+{
+	NVME_TRANSPORT_CALL(tgroup->trtype, poll_group_process_completions,
+			    (tgroup, completions_per_qpair, disconnected_qpair_cb));
+}
+
+int
+nvme_transport_poll_group_destroy(struct nvme_transport_poll_group *tgroup)
+{
+	NVME_TRANSPORT_CALL(tgroup->trtype, poll_group_destroy, (tgroup));
+}
@@ -469,6 +469,20 @@ spdk_sock_group_impl_poll_count(struct spdk_sock_group_impl *group_impl,
 	return num_events;
 }
 
+int
+spdk_sock_group_get_fd(struct spdk_sock_group *group)
+{
+	struct spdk_sock_group_impl *group_impl;
+
+	group_impl = STAILQ_FIRST(&group->group_impls);
+	if (group_impl == NULL || STAILQ_NEXT(group_impl, link) != NULL ||
+	    group_impl->net_impl->group_impl_get_fd == NULL) {
+		return -ENOTSUP;
+	}
+
+	return group_impl->net_impl->group_impl_get_fd(group_impl);
+}
+
 int
 spdk_sock_group_poll_count(struct spdk_sock_group *group, int max_events)
 {
@@ -33,7 +33,9 @@
 
 #include "spdk/stdinc.h"
 
+#include "spdk/assert.h"
 #include "spdk/env.h"
+#include "spdk/likely.h"
 #include "spdk/queue.h"
 #include "spdk/string.h"
 #include "spdk/thread.h"
@@ -42,9 +44,16 @@
 #include "spdk_internal/log.h"
 #include "spdk_internal/thread.h"
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#endif
+
 #define SPDK_MSG_BATCH_SIZE		8
+#define SPDK_MSG_BULK_SIZE		64
 #define SPDK_MAX_DEVICE_NAME_LEN	256
 #define SPDK_MAX_THREAD_NAME_LEN	256
+#define SPDK_MAX_POLLER_NAME_LEN	256
 
 static pthread_mutex_t g_devlist_mutex = PTHREAD_MUTEX_INITIALIZER;
 
@@ -72,13 +81,51 @@ static TAILQ_HEAD(, io_device) g_io_devices = TAILQ_HEAD_INITIALIZER(g_io_device
 struct spdk_msg {
 	spdk_msg_fn		fn;
 	void			*arg;
+	/* Messages to a thread run in the order of their sequence numbers. */
+	uint64_t		seq;
 
-	SLIST_ENTRY(spdk_msg)	link;
+	STAILQ_ENTRY(spdk_msg)	link;
 };
 
 #define SPDK_MSG_MEMPOOL_CACHE_SIZE	1024
 static struct spdk_mempool *g_spdk_msg_mempool = NULL;
 
+/* Must be a power of 2. */
+#define SPDK_MSG_LANE_SIZE		256
+#define SPDK_MSG_LANE_TABLE_MIN_SIZE	16
+
+/*
+ * Single producer, single consumer message queue from one SPDK thread to
+ *  another. The source thread enqueues to msgs and the destination dequeues
+ *  from it without any locked instruction. Messages that don't fit go through
+ *  the ring of the destination instead.
+ */
+struct spdk_msg_lane {
+	/* Written by the source thread only. */
+	uint32_t			head;
+	struct spdk_thread		*dst;
+
+	/* Written by the destination thread only. */
+	uint32_t			tail __attribute__((aligned(64)));
+	/* Next lane of the destination's incoming lanes. */
+	struct spdk_msg_lane		*next;
+
+	bool				src_gone __attribute__((aligned(64)));
+	bool				dst_gone;
+	/* One reference for the source and one for the destination. */
+	uint32_t			refs;
+
+	struct spdk_msg			*msgs[SPDK_MSG_LANE_SIZE];
+};
+
+struct spdk_msg_lane_entry {
+	uint64_t			dst_id;
+	/* NULL if the lane could not be created. The ring is used instead. */
+	struct spdk_msg_lane		*lane;
+};
+
+static bool g_msg_lanes_enabled = true;
+
 enum spdk_poller_state {
 	/* The poller is registered with a thread but not currently executing its fn. */
 	SPDK_POLLER_STATE_WAITING,
@@ -98,14 +145,27 @@ struct spdk_poller {
 
 	uint64_t			period_ticks;
 	uint64_t			next_run_tick;
+	/* Orders timed pollers that expire on the same tick by when they were armed. */
+	uint64_t			timer_seq;
+	/* Position of a timed poller in the timer heap of its thread. */
+	uint32_t			timer_index;
 	spdk_poller_fn			fn;
 	void				*arg;
+	struct spdk_thread		*thread;
+
+	/* Becomes readable when the poller has work to do, -1 if not set. */
+	int				wakeup_fd;
+
+	struct spdk_poller_stats	stats;
+	char				name[SPDK_MAX_POLLER_NAME_LEN + 1];
 };
 
 struct spdk_thread {
 	TAILQ_HEAD(, spdk_io_channel)	io_channels;
 	TAILQ_ENTRY(spdk_thread)	tailq;
 	char				name[SPDK_MAX_THREAD_NAME_LEN + 1];
+	/* Unique for the lifetime of the process, never 0. */
+	uint64_t			id;
 
 	bool				exit;
 
@@ -123,21 +183,66 @@ struct spdk_thread {
 	TAILQ_HEAD(active_pollers_head, spdk_poller)	active_pollers;
 
 	/**
-	 * Contains pollers running on this thread with a periodic timer.
+	 * Contains pollers running on this thread with a periodic timer, as a binary
+	 *  min-heap ordered by next_run_tick. Re-arming a poller after it ran is
+	 *  O(log n) in the number of timed pollers.
 	 */
-	TAILQ_HEAD(timer_pollers_head, spdk_poller)	timer_pollers;
+	struct spdk_poller		**timer_pollers;
+	uint32_t			timer_poller_count;
+	uint32_t			timer_poller_size;
+	uint64_t			timer_seq;
 
 	struct spdk_ring		*messages;
 
-	SLIST_HEAD(, spdk_msg)		msg_cache;
+	STAILQ_HEAD(, spdk_msg)		msg_cache;
 	size_t				msg_cache_count;
 
+	/*
+	 * Lanes this thread sends messages on, hashed by the id of the destination.
+	 *  The lane used last is cached separately since threads tend to send
+	 *  several messages in a row to the same destination.
+	 */
+	struct spdk_msg_lane_entry	*out_lanes;
+	uint32_t			out_lanes_size;
+	uint32_t			out_lanes_count;
+	uint64_t			last_lane_dst_id;
+	struct spdk_msg_lane		*last_lane;
+
+	/* Lanes other threads send messages to this thread on. Only ever pushed to by sources. */
+	struct spdk_msg_lane		*in_lanes;
+	/* The lane the last message came from. */
+	struct spdk_msg_lane		*last_in_lane;
+
+	/*
+	 * Senders take the sequence numbers of their messages from msg_seq. The
+	 *  thread runs them in that order, whether they came through a lane or
+	 *  through the ring, so that a message never overtakes one that was sent
+	 *  before it, even by another thread. msg_seq_next is the number of the
+	 *  next message to run and msgs_early holds the messages taken off the
+	 *  ring ahead of their turn, sorted by number.
+	 */
+	uint64_t			msg_seq;
+	uint64_t			msg_seq_next;
+	STAILQ_HEAD(, spdk_msg)		msgs_early;
+
+	/*
+	 * Set while the thread waits for work instead of being polled. Senders then
+	 *  signal msg_fd, which is in the epoll set wakeup_fd along with the wakeup
+	 *  fds of the pollers. Both fds are -1 if they could not be created.
+	 */
+	bool				waiting;
+	int				wakeup_fd;
+	int				msg_fd;
+
 	/* User context allocated at the end */
-	uint8_t				ctx[0];
+	uint8_t				ctx[0] __attribute__((aligned(8)));
 };
+SPDK_STATIC_ASSERT(offsetof(struct spdk_thread, ctx) % 8 == 0,
+		   "The user context of a thread must be 8-byte aligned");
 
 static TAILQ_HEAD(, spdk_thread) g_threads = TAILQ_HEAD_INITIALIZER(g_threads);
 static uint32_t g_thread_count = 0;
+static uint64_t g_last_thread_id = 0;
 
 static __thread struct spdk_thread *tls_thread = NULL;
 
@@ -189,12 +294,294 @@ spdk_thread_lib_fini(void)
 	g_ctx_sz = 0;
 }
 
+void
+spdk_thread_lib_set_msg_lanes(bool enabled)
+{
+	g_msg_lanes_enabled = enabled;
+}
+
+static inline void
+_spdk_msg_put(struct spdk_thread *thread, struct spdk_msg *msg)
+{
+	if (thread->msg_cache_count < SPDK_MSG_MEMPOOL_CACHE_SIZE) {
+		/* Insert the messages at the head. We want to re-use the hot
+		 * ones. */
+		STAILQ_INSERT_HEAD(&thread->msg_cache, msg, link);
+		thread->msg_cache_count++;
+	} else {
+		spdk_mempool_put(g_spdk_msg_mempool, msg);
+	}
+}
+
+static inline uint32_t
+_spdk_msg_lane_enqueue(struct spdk_msg_lane *lane, struct spdk_msg **msgs, uint32_t count)
+{
+	uint32_t head, tail, i;
+
+	head = lane->head;
+	tail = __atomic_load_n(&lane->tail, __ATOMIC_ACQUIRE);
+	count = spdk_min(count, SPDK_MSG_LANE_SIZE - (head - tail));
+
+	for (i = 0; i < count; i++) {
+		lane->msgs[(head + i) & (SPDK_MSG_LANE_SIZE - 1)] = msgs[i];
+	}
+
+	__atomic_store_n(&lane->head, head + count, __ATOMIC_RELEASE);
+
+	return count;
+}
+
+static inline uint32_t
+_spdk_msg_lane_dequeue(struct spdk_msg_lane *lane, struct spdk_msg **msgs, uint32_t count)
+{
+	uint32_t head, tail, i;
+
+	tail = lane->tail;
+	head = __atomic_load_n(&lane->head, __ATOMIC_ACQUIRE);
+	count = spdk_min(count, head - tail);
+
+	for (i = 0; i < count; i++) {
+		msgs[i] = lane->msgs[(tail + i) & (SPDK_MSG_LANE_SIZE - 1)];
+	}
+
+	__atomic_store_n(&lane->tail, tail + count, __ATOMIC_RELEASE);
+
+	return count;
+}
+
+static inline bool
+_spdk_msg_lane_is_empty(struct spdk_msg_lane *lane)
+{
+	return __atomic_load_n(&lane->head, __ATOMIC_ACQUIRE) == lane->tail;
+}
+
+static void
+_spdk_msg_lane_release(struct spdk_msg_lane *lane)
+{
+	struct spdk_msg *msg;
+
+	if (__atomic_sub_fetch(&lane->refs, 1, __ATOMIC_ACQ_REL) != 0) {
+		return;
+	}
+
+	/* Both threads are gone, so nothing will run the remaining messages. */
+	while (_spdk_msg_lane_dequeue(lane, &msg, 1) == 1) {
+		spdk_mempool_put(g_spdk_msg_mempool, msg);
+	}
+
+	free(lane);
+}
+
+static struct spdk_msg_lane *
+_spdk_msg_lane_create(struct spdk_thread *dst)
+{
+	struct spdk_msg_lane *lane = NULL, *next;
+
+	if (posix_memalign((void **)&lane, 64, sizeof(*lane)) != 0) {
+		return NULL;
+	}
+
+	memset(lane, 0, sizeof(*lane));
+	lane->dst = dst;
+	lane->refs = 2;
+
+	next = __atomic_load_n(&dst->in_lanes, __ATOMIC_RELAXED);
+	do {
+		lane->next = next;
+	} while (!__atomic_compare_exchange_n(&dst->in_lanes, &next, lane, true,
+					      __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+	return lane;
+}
+
+static void
+_spdk_msg_lane_table_insert(struct spdk_msg_lane_entry *table, uint32_t size,
+			    uint64_t dst_id, struct spdk_msg_lane *lane)
+{
+	uint32_t i;
+
+	for (i = dst_id & (size - 1); table[i].dst_id != 0; i = (i + 1) & (size - 1)) {
+		;
+	}
+
+	table[i].dst_id = dst_id;
+	table[i].lane = lane;
+}
+
+/*
+ * Make room for one more outgoing lane. Lanes to destroyed threads are dropped
+ *  while rehashing, so the table only grows with the number of live destinations.
+ */
+static int
+_spdk_msg_lanes_resize(struct spdk_thread *thread)
+{
+	struct spdk_msg_lane_entry *table, *entry;
+	struct spdk_msg_lane *lane;
+	uint32_t i, size, count = 0;
+
+	for (i = 0; i < thread->out_lanes_size; i++) {
+		lane = thread->out_lanes[i].lane;
+		if (thread->out_lanes[i].dst_id != 0 &&
+		    (lane == NULL || !__atomic_load_n(&lane->dst_gone, __ATOMIC_ACQUIRE))) {
+			count++;
+		}
+	}
+
+	size = spdk_max(thread->out_lanes_size, SPDK_MSG_LANE_TABLE_MIN_SIZE);
+	while ((count + 1) * 2 > size) {
+		size *= 2;
+	}
+
+	table = calloc(size, sizeof(*table));
+	if (table == NULL) {
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < thread->out_lanes_size; i++) {
+		entry = &thread->out_lanes[i];
+		if (entry->dst_id == 0) {
+			continue;
+		}
+
+		if (entry->lane != NULL && __atomic_load_n(&entry->lane->dst_gone, __ATOMIC_ACQUIRE)) {
+			_spdk_msg_lane_release(entry->lane);
+			continue;
+		}
+
+		_spdk_msg_lane_table_insert(table, size, entry->dst_id, entry->lane);
+	}
+
+	free(thread->out_lanes);
+	thread->out_lanes = table;
+	thread->out_lanes_size = size;
+	thread->out_lanes_count = count;
+	thread->last_lane_dst_id = 0;
+
+	return 0;
+}
+
+/* Returns the lane from src to dst, or NULL if messages have to go through the ring of dst. */
+static struct spdk_msg_lane *
+_spdk_msg_lane_get(struct spdk_thread *src, struct spdk_thread *dst)
+{
+	struct spdk_msg_lane_entry *entry;
+	struct spdk_msg_lane *lane;
+	uint32_t i;
+
+	if (spdk_likely(src->last_lane_dst_id == dst->id)) {
+		return src->last_lane;
+	}
+
+	for (i = dst->id & (src->out_lanes_size - 1); src->out_lanes_size != 0;
+	     i = (i + 1) & (src->out_lanes_size - 1)) {
+		entry = &src->out_lanes[i];
+		if (entry->dst_id == dst->id) {
+			src->last_lane_dst_id = dst->id;
+			src->last_lane = entry->lane;
+			return entry->lane;
+		}
+
+		if (entry->dst_id == 0) {
+			break;
+		}
+	}
+
+	if ((src->out_lanes_count + 1) * 2 > src->out_lanes_size &&
+	    _spdk_msg_lanes_resize(src) != 0) {
+		return NULL;
+	}
+
+	/*
+	 * Once a destination is known, the choice between the lane and the ring is
+	 *  never changed so that the messages from src to dst stay in order.
+	 */
+	if (g_msg_lanes_enabled) {
+		lane = _spdk_msg_lane_create(dst);
+		if (lane == NULL) {
+			SPDK_ERRLOG("Unable to allocate message lane from thread %s to %s\n",
+				    src->name, dst->name);
+		}
+	} else {
+		lane = NULL;
+	}
+
+	_spdk_msg_lane_table_insert(src->out_lanes, src->out_lanes_size, dst->id, lane);
+	src->out_lanes_count++;
+	src->last_lane_dst_id = dst->id;
+	src->last_lane = lane;
+
+	return lane;
+}
+
+static inline void
+_spdk_thread_wakeup(struct spdk_thread *thread)
+{
+	if (spdk_unlikely(__atomic_load_n(&thread->waiting, __ATOMIC_SEQ_CST))) {
+		uint64_t count = 1;
+
+		if (write(thread->msg_fd, &count, sizeof(count)) < 0) {
+			SPDK_ERRLOG("Unable to wake up thread %s: %s\n", thread->name, spdk_strerror(errno));
+		}
+	}
+}
+
+static void
+_spdk_msg_lanes_free(struct spdk_thread *thread)
+{
+	struct spdk_msg_lane *lane, *next;
+	uint32_t i;
+
+	for (i = 0; i < thread->out_lanes_size; i++) {
+		lane = thread->out_lanes[i].lane;
+		if (lane == NULL) {
+			continue;
+		}
+
+		__atomic_store_n(&lane->src_gone, true, __ATOMIC_RELEASE);
+		_spdk_msg_lane_release(lane);
+	}
+
+	free(thread->out_lanes);
+	thread->out_lanes = NULL;
+	thread->out_lanes_size = 0;
+
+	thread->last_in_lane = NULL;
+	lane = __atomic_exchange_n(&thread->in_lanes, NULL, __ATOMIC_ACQUIRE);
+	while (lane != NULL) {
+		next = lane->next;
+		__atomic_store_n(&lane->dst_gone, true, __ATOMIC_RELEASE);
+		_spdk_msg_lane_release(lane);
+		lane = next;
+	}
+}
+
+/* Whether any message for the thread is waiting in an incoming lane or ahead of its turn. */
+static bool
+_spdk_msg_lanes_pending(struct spdk_thread *thread)
+{
+	struct spdk_msg_lane *lane;
+
+	if (!STAILQ_EMPTY(&thread->msgs_early)) {
+		return true;
+	}
+
+	lane = __atomic_load_n(&thread->in_lanes, __ATOMIC_ACQUIRE);
+	for (; lane != NULL; lane = lane->next) {
+		if (!_spdk_msg_lane_is_empty(lane)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 static void
 _free_thread(struct spdk_thread *thread)
 {
 	struct spdk_io_channel *ch;
 	struct spdk_msg *msg;
 	struct spdk_poller *poller, *ptmp;
+	uint32_t i;
 
 	TAILQ_FOREACH(ch, &thread->io_channels, tailq) {
 		SPDK_ERRLOG("thread %s still has channel for io_device %s\n",
@@ -212,15 +599,18 @@ _free_thread(struct spdk_thread *thread)
 	}
 
 
-	TAILQ_FOREACH_SAFE(poller, &thread->timer_pollers, tailq, ptmp) {
+	for (i = 0; i < thread->timer_poller_count; i++) {
+		poller = thread->timer_pollers[i];
 		if (poller->state == SPDK_POLLER_STATE_WAITING) {
 			SPDK_WARNLOG("poller %p still registered at thread exit\n",
 				     poller);
 		}
 
-		TAILQ_REMOVE(&thread->timer_pollers, poller, tailq);
 		free(poller);
 	}
+	free(thread->timer_pollers);
+	thread->timer_pollers = NULL;
+	thread->timer_poller_count = 0;
 
 	pthread_mutex_lock(&g_devlist_mutex);
 	assert(g_thread_count > 0);
@@ -228,23 +618,74 @@ _free_thread(struct spdk_thread *thread)
 	TAILQ_REMOVE(&g_threads, thread, tailq);
 	pthread_mutex_unlock(&g_devlist_mutex);
 
-	msg = SLIST_FIRST(&thread->msg_cache);
+	_spdk_msg_lanes_free(thread);
+
+	while ((msg = STAILQ_FIRST(&thread->msgs_early)) != NULL) {
+		STAILQ_REMOVE_HEAD(&thread->msgs_early, link);
+		spdk_mempool_put(g_spdk_msg_mempool, msg);
+	}
+
+	msg = STAILQ_FIRST(&thread->msg_cache);
 	while (msg != NULL) {
-		SLIST_REMOVE_HEAD(&thread->msg_cache, link);
+		STAILQ_REMOVE_HEAD(&thread->msg_cache, link);
 
 		assert(thread->msg_cache_count > 0);
 		thread->msg_cache_count--;
 		spdk_mempool_put(g_spdk_msg_mempool, msg);
 
-		msg = SLIST_FIRST(&thread->msg_cache);
+		msg = STAILQ_FIRST(&thread->msg_cache);
 	}
 
 	assert(thread->msg_cache_count == 0);
 
+	if (thread->msg_fd >= 0) {
+		close(thread->msg_fd);
+	}
+	if (thread->wakeup_fd >= 0) {
+		close(thread->wakeup_fd);
+	}
+
 	spdk_ring_free(thread->messages);
 	free(thread);
 }
 
+static void
+_spdk_thread_wakeup_init(struct spdk_thread *thread)
+{
+#ifdef __linux__
+	struct epoll_event event = {};
+
+	thread->wakeup_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (thread->wakeup_fd < 0) {
+		goto err;
+	}
+
+	thread->msg_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (thread->msg_fd < 0) {
+		goto err;
+	}
+
+	event.events = EPOLLIN;
+	if (epoll_ctl(thread->wakeup_fd, EPOLL_CTL_ADD, thread->msg_fd, &event) != 0) {
+		goto err;
+	}
+
+	return;
+
+err:
+	SPDK_WARNLOG("Unable to create wakeup fd for thread %s: %s\n", thread->name,
+		     spdk_strerror(errno));
+	if (thread->msg_fd >= 0) {
+		close(thread->msg_fd);
+		thread->msg_fd = -1;
+	}
+	if (thread->wakeup_fd >= 0) {
+		close(thread->wakeup_fd);
+		thread->wakeup_fd = -1;
+	}
+#endif
+}
+
 struct spdk_thread *
 spdk_thread_create(const char *name, struct spdk_cpuset *cpumask)
 {
@@ -266,9 +707,11 @@ spdk_thread_create(const char *name, struct spdk_cpuset *cpumask)
 
 	TAILQ_INIT(&thread->io_channels);
 	TAILQ_INIT(&thread->active_pollers);
-	TAILQ_INIT(&thread->timer_pollers);
-	SLIST_INIT(&thread->msg_cache);
+	STAILQ_INIT(&thread->msg_cache);
 	thread->msg_cache_count = 0;
+	STAILQ_INIT(&thread->msgs_early);
+	thread->wakeup_fd = -1;
+	thread->msg_fd = -1;
 
 	thread->tsc_last = spdk_get_ticks();
 
@@ -285,7 +728,7 @@ spdk_thread_create(const char *name, struct spdk_cpuset *cpumask)
 		/* If we can't populate the cache it's ok. The cache will get filled
 		 * up organically as messages are passed to the thread. */
 		for (i = 0; i < SPDK_MSG_MEMPOOL_CACHE_SIZE; i++) {
-			SLIST_INSERT_HEAD(&thread->msg_cache, msgs[i], link);
+			STAILQ_INSERT_HEAD(&thread->msg_cache, msgs[i], link);
 			thread->msg_cache_count++;
 		}
 	}
@@ -296,9 +739,12 @@ spdk_thread_create(const char *name, struct spdk_cpuset *cpumask)
 		snprintf(thread->name, sizeof(thread->name), "%p", thread);
 	}
 
+	_spdk_thread_wakeup_init(thread);
+
 	SPDK_DEBUGLOG(SPDK_LOG_THREAD, "Allocating new thread %s\n", thread->name);
 
 	pthread_mutex_lock(&g_devlist_mutex);
+	thread->id = ++g_last_thread_id;
 	TAILQ_INSERT_TAIL(&g_threads, thread, tailq);
 	g_thread_count++;
 	pthread_mutex_unlock(&g_devlist_mutex);
@@ -373,20 +819,128 @@ spdk_thread_get_from_ctx(void *ctx)
 	return SPDK_CONTAINEROF(ctx, struct spdk_thread, ctx);
 }
 
+static inline struct spdk_msg *
+_spdk_msg_lane_peek(struct spdk_msg_lane *lane)
+{
+	uint32_t tail = lane->tail;
+
+	if (__atomic_load_n(&lane->head, __ATOMIC_ACQUIRE) == tail) {
+		return NULL;
+	}
+
+	return lane->msgs[tail & (SPDK_MSG_LANE_SIZE - 1)];
+}
+
+static inline void
+_spdk_msg_lane_pop(struct spdk_msg_lane *lane)
+{
+	__atomic_store_n(&lane->tail, lane->tail + 1, __ATOMIC_RELEASE);
+}
+
+/* Keeps msgs_early sorted. Messages mostly come off the ring in order, so try the tail first. */
+static void
+_spdk_msg_early_insert(struct spdk_thread *thread, struct spdk_msg *msg)
+{
+	struct spdk_msg *prev = NULL, *cur;
+
+	cur = STAILQ_LAST(&thread->msgs_early, spdk_msg, link);
+	if (cur == NULL || cur->seq < msg->seq) {
+		STAILQ_INSERT_TAIL(&thread->msgs_early, msg, link);
+		return;
+	}
+
+	STAILQ_FOREACH(cur, &thread->msgs_early, link) {
+		if (cur->seq > msg->seq) {
+			break;
+		}
+		prev = cur;
+	}
+
+	if (prev == NULL) {
+		STAILQ_INSERT_HEAD(&thread->msgs_early, msg, link);
+	} else {
+		STAILQ_INSERT_AFTER(&thread->msgs_early, prev, msg, link);
+	}
+}
+
+/*
+ * Returns the message whose turn it is to run, or NULL if it is not there yet.
+ *  Its sender may still be about to enqueue it, or it may be on the ring behind
+ *  messages that are taken off a batch at a time. Lanes whose source is gone
+ *  are unlinked once they are drained, except for the list head which sources
+ *  may be pushing new lanes in front of.
+ */
+static struct spdk_msg *
+_spdk_msg_next(struct spdk_thread *thread)
+{
+	struct spdk_msg_lane *lane, *prev = NULL, *next;
+	struct spdk_msg *msg;
+	void *msgs[SPDK_MSG_BATCH_SIZE];
+	uint64_t seq = thread->msg_seq_next;
+	uint32_t count, i;
+
+	msg = STAILQ_FIRST(&thread->msgs_early);
+	if (msg != NULL && msg->seq == seq) {
+		STAILQ_REMOVE_HEAD(&thread->msgs_early, link);
+		return msg;
+	}
+
+	/* Threads tend to send several messages in a row. */
+	lane = thread->last_in_lane;
+	if (lane != NULL) {
+		msg = _spdk_msg_lane_peek(lane);
+		if (msg != NULL && msg->seq == seq) {
+			_spdk_msg_lane_pop(lane);
+			return msg;
+		}
+	}
+
+	lane = __atomic_load_n(&thread->in_lanes, __ATOMIC_ACQUIRE);
+	while (lane != NULL) {
+		next = lane->next;
+
+		msg = _spdk_msg_lane_peek(lane);
+		if (msg != NULL && msg->seq == seq) {
+			_spdk_msg_lane_pop(lane);
+			thread->last_in_lane = lane;
+			return msg;
+		}
+
+		if (msg == NULL && prev != NULL &&
+		    __atomic_load_n(&lane->src_gone, __ATOMIC_ACQUIRE) &&
+		    _spdk_msg_lane_is_empty(lane)) {
+			prev->next = next;
+			if (thread->last_in_lane == lane) {
+				thread->last_in_lane = NULL;
+			}
+			_spdk_msg_lane_release(lane);
+		} else {
+			prev = lane;
+		}
+
+		lane = next;
+	}
+
+	count = spdk_ring_dequeue(thread->messages, msgs, SPDK_MSG_BATCH_SIZE);
+	for (i = 0; i < count; i++) {
+		assert(msgs[i] != NULL);
+		_spdk_msg_early_insert(thread, msgs[i]);
+	}
+
+	msg = STAILQ_FIRST(&thread->msgs_early);
+	if (msg != NULL && msg->seq == seq) {
+		STAILQ_REMOVE_HEAD(&thread->msgs_early, link);
+		return msg;
+	}
+
+	return NULL;
+}
+
 static inline uint32_t
 _spdk_msg_queue_run_batch(struct spdk_thread *thread, uint32_t max_msgs)
 {
-	unsigned count, i;
-	void *messages[SPDK_MSG_BATCH_SIZE];
-
-#ifdef DEBUG
-	/*
-	 * spdk_ring_dequeue() fills messages and returns how many entries it wrote,
-	 * so we will never actually read uninitialized data from events, but just to be sure
-	 * (and to silence a static analyzer false positive), initialize the array to NULL pointers.
-	 */
-	memset(messages, 0, sizeof(messages));
-#endif
+	struct spdk_msg *msg;
+	uint32_t count = 0;
 
 	if (max_msgs > 0) {
 		max_msgs = spdk_min(max_msgs, SPDK_MSG_BATCH_SIZE);
@@ -394,54 +948,150 @@ _spdk_msg_queue_run_batch(struct spdk_thread *thread, uint32_t max_msgs)
 		max_msgs = SPDK_MSG_BATCH_SIZE;
 	}
 
-	count = spdk_ring_dequeue(thread->messages, messages, max_msgs);
-	if (count == 0) {
-		return 0;
+	while (count < max_msgs && (msg = _spdk_msg_next(thread)) != NULL) {
+		thread->msg_seq_next++;
+		msg->fn(msg->arg);
+		count++;
+
+		if (thread->exit) {
+			return count;
+		}
+
+		_spdk_msg_put(thread, msg);
 	}
 
-	for (i = 0; i < count; i++) {
-		struct spdk_msg *msg = messages[i];
+	return count;
+}
 
-		assert(msg != NULL);
-		msg->fn(msg->arg);
+#define SPDK_TIMER_HEAP_MIN_SIZE	16
 
-		if (thread->exit) {
+static inline bool
+_spdk_poller_timer_before(const struct spdk_poller *a, const struct spdk_poller *b)
+{
+	if (a->next_run_tick != b->next_run_tick) {
+		return a->next_run_tick < b->next_run_tick;
+	}
+
+	return a->timer_seq < b->timer_seq;
+}
+
+static inline void
+_spdk_timer_heap_set(struct spdk_thread *thread, uint32_t index, struct spdk_poller *poller)
+{
+	thread->timer_pollers[index] = poller;
+	poller->timer_index = index;
+}
+
+static void
+_spdk_timer_heap_sift_up(struct spdk_thread *thread, uint32_t index)
+{
+	struct spdk_poller *poller = thread->timer_pollers[index];
+	uint32_t parent;
+
+	while (index > 0) {
+		parent = (index - 1) / 2;
+		if (!_spdk_poller_timer_before(poller, thread->timer_pollers[parent])) {
 			break;
 		}
 
-		if (thread->msg_cache_count < SPDK_MSG_MEMPOOL_CACHE_SIZE) {
-			/* Insert the messages at the head. We want to re-use the hot
-			 * ones. */
-			SLIST_INSERT_HEAD(&thread->msg_cache, msg, link);
-			thread->msg_cache_count++;
-		} else {
-			spdk_mempool_put(g_spdk_msg_mempool, msg);
+		_spdk_timer_heap_set(thread, index, thread->timer_pollers[parent]);
+		index = parent;
+	}
+
+	_spdk_timer_heap_set(thread, index, poller);
+}
+
+static void
+_spdk_timer_heap_sift_down(struct spdk_thread *thread, uint32_t index)
+{
+	struct spdk_poller *poller = thread->timer_pollers[index];
+	uint32_t child;
+
+	while ((child = index * 2 + 1) < thread->timer_poller_count) {
+		if (child + 1 < thread->timer_poller_count &&
+		    _spdk_poller_timer_before(thread->timer_pollers[child + 1], thread->timer_pollers[child])) {
+			child++;
 		}
+
+		if (!_spdk_poller_timer_before(thread->timer_pollers[child], poller)) {
+			break;
+		}
+
+		_spdk_timer_heap_set(thread, index, thread->timer_pollers[child]);
+		index = child;
 	}
 
-	return count;
+	_spdk_timer_heap_set(thread, index, poller);
 }
 
 static void
-_spdk_poller_insert_timer(struct spdk_thread *thread, struct spdk_poller *poller, uint64_t now)
+_spdk_timer_heap_remove(struct spdk_thread *thread, struct spdk_poller *poller)
 {
-	struct spdk_poller *iter;
+	uint32_t index = poller->timer_index;
+	struct spdk_poller *last;
 
-	poller->next_run_tick = now + poller->period_ticks;
+	assert(index < thread->timer_poller_count);
+	assert(thread->timer_pollers[index] == poller);
 
-	/*
-	 * Insert poller in the thread's timer_pollers list in sorted order by next scheduled
-	 * run time.
-	 */
-	TAILQ_FOREACH_REVERSE(iter, &thread->timer_pollers, timer_pollers_head, tailq) {
-		if (iter->next_run_tick <= poller->next_run_tick) {
-			TAILQ_INSERT_AFTER(&thread->timer_pollers, iter, poller, tailq);
-			return;
+	last = thread->timer_pollers[--thread->timer_poller_count];
+	if (last == poller) {
+		return;
+	}
+
+	_spdk_timer_heap_set(thread, index, last);
+	_spdk_timer_heap_sift_up(thread, index);
+	_spdk_timer_heap_sift_down(thread, last->timer_index);
+}
+
+static void
+_spdk_poller_set_timer(struct spdk_thread *thread, struct spdk_poller *poller, uint64_t tick)
+{
+	poller->next_run_tick = tick;
+	poller->timer_seq = thread->timer_seq++;
+}
+
+static int
+_spdk_poller_insert_timer(struct spdk_thread *thread, struct spdk_poller *poller, uint64_t now)
+{
+	struct spdk_poller **pollers;
+	uint32_t size;
+
+	if (thread->timer_poller_count == thread->timer_poller_size) {
+		size = spdk_max(thread->timer_poller_size * 2, SPDK_TIMER_HEAP_MIN_SIZE);
+		pollers = realloc(thread->timer_pollers, size * sizeof(*pollers));
+		if (pollers == NULL) {
+			return -ENOMEM;
 		}
+
+		thread->timer_pollers = pollers;
+		thread->timer_poller_size = size;
 	}
 
-	/* No earlier pollers were found, so this poller must be the new head */
-	TAILQ_INSERT_HEAD(&thread->timer_pollers, poller, tailq);
+	_spdk_poller_set_timer(thread, poller, now + poller->period_ticks);
+	_spdk_timer_heap_set(thread, thread->timer_poller_count++, poller);
+	_spdk_timer_heap_sift_up(thread, poller->timer_index);
+
+	return 0;
+}
+
+/* A re-armed poller only ever expires later than before, so sifting down is enough. */
+static void
+_spdk_poller_rearm_timer(struct spdk_thread *thread, struct spdk_poller *poller, uint64_t now)
+{
+	_spdk_poller_set_timer(thread, poller, now + poller->period_ticks);
+	_spdk_timer_heap_sift_down(thread, poller->timer_index);
+}
+
+static inline void
+_spdk_poller_update_stats(struct spdk_poller *poller, int rc, uint64_t tsc)
+{
+	poller->stats.run_count++;
+	poller->stats.run_tsc += tsc;
+
+	if (rc > 0) {
+		poller->stats.busy_count++;
+		poller->stats.busy_tsc += tsc;
+	}
 }
 
 int
@@ -450,6 +1100,7 @@ spdk_thread_poll(struct spdk_thread *thread, uint32_t max_msgs, uint64_t now)
 	uint32_t msg_count;
 	struct spdk_thread *orig_thread;
 	struct spdk_poller *poller, *tmp;
+	uint64_t start, end;
 	int rc = 0;
 
 	orig_thread = _get_thread();
@@ -464,6 +1115,9 @@ spdk_thread_poll(struct spdk_thread *thread, uint32_t max_msgs, uint64_t now)
 		rc = 1;
 	}
 
+	/* The end of each poller run is the start of the next one, so each run costs one tick read. */
+	start = spdk_get_ticks();
+
 	TAILQ_FOREACH_REVERSE_SAFE(poller, &thread->active_pollers,
 				   active_pollers_head, tailq, tmp) {
 		int poller_rc;
@@ -481,6 +1135,10 @@ spdk_thread_poll(struct spdk_thread *thread, uint32_t max_msgs, uint64_t now)
 		poller->state = SPDK_POLLER_STATE_RUNNING;
 		poller_rc = poller->fn(poller->arg);
 
+		end = spdk_get_ticks();
+		_spdk_poller_update_stats(poller, poller_rc, end - start);
+		start = end;
+
 		if (poller->state == SPDK_POLLER_STATE_UNREGISTERED) {
 			TAILQ_REMOVE(&thread->active_pollers, poller, tailq);
 			free(poller);
@@ -501,15 +1159,16 @@ spdk_thread_poll(struct spdk_thread *thread, uint32_t max_msgs, uint64_t now)
 
 	}
 
-	TAILQ_FOREACH_SAFE(poller, &thread->timer_pollers, tailq, tmp) {
+	while (thread->timer_poller_count > 0) {
 		int timer_rc = 0;
 
 		if (thread->exit) {
 			break;
 		}
 
+		poller = thread->timer_pollers[0];
 		if (poller->state == SPDK_POLLER_STATE_UNREGISTERED) {
-			TAILQ_REMOVE(&thread->timer_pollers, poller, tailq);
+			_spdk_timer_heap_remove(thread, poller);
 			free(poller);
 			continue;
 		}
@@ -521,15 +1180,18 @@ spdk_thread_poll(struct spdk_thread *thread, uint32_t max_msgs, uint64_t now)
 		poller->state = SPDK_POLLER_STATE_RUNNING;
 		timer_rc = poller->fn(poller->arg);
 
+		end = spdk_get_ticks();
+		_spdk_poller_update_stats(poller, timer_rc, end - start);
+		start = end;
+
 		if (poller->state == SPDK_POLLER_STATE_UNREGISTERED) {
-			TAILQ_REMOVE(&thread->timer_pollers, poller, tailq);
+			_spdk_timer_heap_remove(thread, poller);
 			free(poller);
 			continue;
 		}
 
 		poller->state = SPDK_POLLER_STATE_WAITING;
-		TAILQ_REMOVE(&thread->timer_pollers, poller, tailq);
-		_spdk_poller_insert_timer(thread, poller, now);
+		_spdk_poller_rearm_timer(thread, poller, now);
 
 #ifdef DEBUG
 		if (timer_rc == -1) {
@@ -560,11 +1222,8 @@ spdk_thread_poll(struct spdk_thread *thread, uint32_t max_msgs, uint64_t now)
 uint64_t
 spdk_thread_next_poller_expiration(struct spdk_thread *thread)
 {
-	struct spdk_poller *poller;
-
-	poller = TAILQ_FIRST(&thread->timer_pollers);
-	if (poller) {
-		return poller->next_run_tick;
+	if (thread->timer_poller_count > 0) {
+		return thread->timer_pollers[0]->next_run_tick;
 	}
 
 	return 0;
@@ -580,17 +1239,24 @@ bool
 spdk_thread_has_pollers(struct spdk_thread *thread)
 {
 	if (TAILQ_EMPTY(&thread->active_pollers) &&
-	    TAILQ_EMPTY(&thread->timer_pollers)) {
+	    thread->timer_poller_count == 0) {
 		return false;
 	}
 
 	return true;
 }
 
+bool
+spdk_thread_has_io_channels(struct spdk_thread *thread)
+{
+	return !TAILQ_EMPTY(&thread->io_channels);
+}
+
 bool
 spdk_thread_is_idle(struct spdk_thread *thread)
 {
 	if (spdk_ring_count(thread->messages) ||
+	    _spdk_msg_lanes_pending(thread) ||
 	    spdk_thread_has_pollers(thread)) {
 		return false;
 	}
@@ -598,6 +1264,56 @@ spdk_thread_is_idle(struct spdk_thread *thread)
 	return true;
 }
 
+int
+spdk_thread_get_wakeup_fd(struct spdk_thread *thread)
+{
+	if (thread->wakeup_fd < 0) {
+		return -ENOTSUP;
+	}
+
+	return thread->wakeup_fd;
+}
+
+bool
+spdk_thread_wait_begin(struct spdk_thread *thread)
+{
+	struct spdk_poller *poller;
+
+	if (thread->wakeup_fd < 0) {
+		return false;
+	}
+
+	/*
+	 * Pairs with the check in spdk_thread_send_msg(). Either the sender sees
+	 *  the flag and signals msg_fd, or the message is seen here.
+	 */
+	__atomic_store_n(&thread->waiting, true, __ATOMIC_SEQ_CST);
+	if (spdk_ring_count(thread->messages) != 0 || _spdk_msg_lanes_pending(thread)) {
+		return false;
+	}
+
+	TAILQ_FOREACH(poller, &thread->active_pollers, tailq) {
+		if (poller->state != SPDK_POLLER_STATE_UNREGISTERED && poller->wakeup_fd < 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void
+spdk_thread_wait_end(struct spdk_thread *thread)
+{
+	uint64_t count;
+
+	__atomic_store_n(&thread->waiting, false, __ATOMIC_SEQ_CST);
+
+	if (thread->msg_fd >= 0 && read(thread->msg_fd, &count, sizeof(count)) < 0) {
+		/* EAGAIN only means that no message was sent while waiting. */
+		return;
+	}
+}
+
 uint32_t
 spdk_thread_get_count(void)
 {
@@ -628,6 +1344,12 @@ spdk_thread_get_name(const struct spdk_thread *thread)
 	return thread->name;
 }
 
+uint64_t
+spdk_thread_get_id(const struct spdk_thread *thread)
+{
+	return thread->id;
+}
+
 int
 spdk_thread_get_stats(struct spdk_thread_stats *stats)
 {
@@ -648,12 +1370,80 @@ spdk_thread_get_stats(struct spdk_thread_stats *stats)
 	return 0;
 }
 
+static inline struct spdk_msg *
+_spdk_msg_get(struct spdk_thread *local_thread)
+{
+	struct spdk_msg *msg;
+
+	if (local_thread != NULL && local_thread->msg_cache_count > 0) {
+		msg = STAILQ_FIRST(&local_thread->msg_cache);
+		assert(msg != NULL);
+		STAILQ_REMOVE_HEAD(&local_thread->msg_cache, link);
+		local_thread->msg_cache_count--;
+		return msg;
+	}
+
+	return spdk_mempool_get(g_spdk_msg_mempool);
+}
+
+static void
+_spdk_thread_send_msgs(struct spdk_thread *local_thread, struct spdk_thread *thread,
+		       struct spdk_msg **msgs, uint32_t count)
+{
+	struct spdk_msg_lane *lane = NULL;
+	uint32_t sent = 0, rc, i;
+	uint64_t seq;
+
+	/*
+	 * A message sent after another one, by any thread, takes a higher number,
+	 *  since sending the first happened before taking the number of the second.
+	 */
+	seq = __atomic_fetch_add(&thread->msg_seq, count, __ATOMIC_RELAXED);
+	for (i = 0; i < count; i++) {
+		msgs[i]->seq = seq + i;
+	}
+
+	if (local_thread != NULL) {
+		lane = _spdk_msg_lane_get(local_thread, thread);
+	}
+
+	if (lane != NULL) {
+		sent = _spdk_msg_lane_enqueue(lane, msgs, count);
+	}
+
+	/* The destination waits for each number in turn, so no message may be dropped. */
+	while (sent < count) {
+		rc = spdk_ring_enqueue(thread->messages, (void **)&msgs[sent], count - sent, NULL);
+		if (rc > 0) {
+			sent += rc;
+			continue;
+		}
+
+		if (local_thread == thread) {
+			/* Nobody else would make room on the ring. */
+			for (; sent < count; sent++) {
+				_spdk_msg_early_insert(thread, msgs[sent]);
+			}
+			break;
+		}
+
+		/* Wait for the destination to make room. */
+		_spdk_thread_wakeup(thread);
+	}
+
+	/*
+	 * Pairs with spdk_thread_wait_begin(). The release store of the lane head
+	 *  alone may be reordered after the load of the waiting flag.
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	_spdk_thread_wakeup(thread);
+}
+
 void
 spdk_thread_send_msg(const struct spdk_thread *thread, spdk_msg_fn fn, void *ctx)
 {
 	struct spdk_thread *local_thread;
 	struct spdk_msg *msg;
-	int rc;
 
 	if (!thread) {
 		assert(false);
@@ -662,39 +1452,63 @@ spdk_thread_send_msg(const struct spdk_thread *thread, spdk_msg_fn fn, void *ctx
 
 	local_thread = _get_thread();
 
-	msg = NULL;
-	if (local_thread != NULL) {
-		if (local_thread->msg_cache_count > 0) {
-			msg = SLIST_FIRST(&local_thread->msg_cache);
-			assert(msg != NULL);
-			SLIST_REMOVE_HEAD(&local_thread->msg_cache, link);
-			local_thread->msg_cache_count--;
-		}
-	}
-
-	if (msg == NULL) {
-		msg = spdk_mempool_get(g_spdk_msg_mempool);
-		if (!msg) {
-			assert(false);
-			return;
-		}
+	msg = _spdk_msg_get(local_thread);
+	if (!msg) {
+		assert(false);
+		return;
 	}
 
 	msg->fn = fn;
 	msg->arg = ctx;
 
-	rc = spdk_ring_enqueue(thread->messages, (void **)&msg, 1, NULL);
-	if (rc != 1) {
+	_spdk_thread_send_msgs(local_thread, (struct spdk_thread *)thread, &msg, 1);
+}
+
+uint32_t
+spdk_thread_send_msg_bulk(const struct spdk_thread *thread, spdk_msg_fn fn, void **ctxs,
+			  uint32_t count)
+{
+	struct spdk_thread *local_thread;
+	struct spdk_msg *msgs[SPDK_MSG_BULK_SIZE];
+	uint32_t sent = 0, batch, i;
+
+	if (!thread) {
 		assert(false);
-		spdk_mempool_put(g_spdk_msg_mempool, msg);
-		return;
+		return 0;
+	}
+
+	local_thread = _get_thread();
+
+	while (sent < count) {
+		batch = spdk_min(count - sent, SPDK_MSG_BULK_SIZE);
+
+		for (i = 0; i < batch; i++) {
+			msgs[i] = _spdk_msg_get(local_thread);
+			if (msgs[i] == NULL) {
+				batch = i;
+				break;
+			}
+
+			msgs[i]->fn = fn;
+			msgs[i]->arg = ctxs[sent + i];
+		}
+
+		if (batch == 0) {
+			break;
+		}
+
+		_spdk_thread_send_msgs(local_thread, (struct spdk_thread *)thread, msgs, batch);
+		sent += batch;
 	}
+
+	return sent;
 }
 
-struct spdk_poller *
-spdk_poller_register(spdk_poller_fn fn,
-		     void *arg,
-		     uint64_t period_microseconds)
+static struct spdk_poller *
+_spdk_poller_register(spdk_poller_fn fn,
+		      void *arg,
+		      uint64_t period_microseconds,
+		      const char *name)
 {
 	struct spdk_thread *thread;
 	struct spdk_poller *poller;
@@ -715,6 +1529,14 @@ spdk_poller_register(spdk_poller_fn fn,
 	poller->state = SPDK_POLLER_STATE_WAITING;
 	poller->fn = fn;
 	poller->arg = arg;
+	poller->thread = thread;
+	poller->wakeup_fd = -1;
+
+	if (name) {
+		snprintf(poller->name, sizeof(poller->name), "%s", name);
+	} else {
+		snprintf(poller->name, sizeof(poller->name), "%p", fn);
+	}
 
 	if (period_microseconds) {
 		quotient = period_microseconds / SPDK_SEC_TO_USEC;
@@ -727,7 +1549,11 @@ spdk_poller_register(spdk_poller_fn fn,
 	}
 
 	if (poller->period_ticks) {
-		_spdk_poller_insert_timer(thread, poller, spdk_get_ticks());
+		if (_spdk_poller_insert_timer(thread, poller, spdk_get_ticks()) != 0) {
+			SPDK_ERRLOG("Poller memory allocation failed\n");
+			free(poller);
+			return NULL;
+		}
 	} else {
 		TAILQ_INSERT_TAIL(&thread->active_pollers, poller, tailq);
 	}
@@ -735,6 +1561,23 @@ spdk_poller_register(spdk_poller_fn fn,
 	return poller;
 }
 
+struct spdk_poller *
+spdk_poller_register(spdk_poller_fn fn,
+		     void *arg,
+		     uint64_t period_microseconds)
+{
+	return _spdk_poller_register(fn, arg, period_microseconds, NULL);
+}
+
+struct spdk_poller *
+spdk_poller_register_named(spdk_poller_fn fn,
+			   void *arg,
+			   uint64_t period_microseconds,
+			   const char *name)
+{
+	return _spdk_poller_register(fn, arg, period_microseconds, name);
+}
+
 void
 spdk_poller_unregister(struct spdk_poller **ppoller)
 {
@@ -754,12 +1597,107 @@ spdk_poller_unregister(struct spdk_poller **ppoller)
 		return;
 	}
 
+#ifdef __linux__
+	if (poller->wakeup_fd >= 0) {
+		epoll_ctl(thread->wakeup_fd, EPOLL_CTL_DEL, poller->wakeup_fd, NULL);
+	}
+#endif
+
 	/* Simply set the state to unregistered. The poller will get cleaned up
 	 * in a subsequent call to spdk_thread_poll().
 	 */
 	poller->state = SPDK_POLLER_STATE_UNREGISTERED;
 }
 
+int
+spdk_poller_set_wakeup_fd(struct spdk_poller *poller, int fd)
+{
+#ifdef __linux__
+	struct spdk_thread *thread;
+	struct epoll_event event = {};
+
+	thread = spdk_get_thread();
+	if (!thread) {
+		assert(false);
+		return -EINVAL;
+	}
+
+	if (thread->wakeup_fd < 0) {
+		return -ENOTSUP;
+	}
+
+	if (poller->wakeup_fd >= 0) {
+		epoll_ctl(thread->wakeup_fd, EPOLL_CTL_DEL, poller->wakeup_fd, NULL);
+		poller->wakeup_fd = -1;
+	}
+
+	event.events = EPOLLIN;
+	if (epoll_ctl(thread->wakeup_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+		return -errno;
+	}
+
+	poller->wakeup_fd = fd;
+
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+/* Returns the first registered poller from active on, then from the timer heap at timer_index on. */
+static struct spdk_poller *
+_spdk_thread_find_poller(struct spdk_thread *thread, struct spdk_poller *active,
+			 uint32_t timer_index)
+{
+	for (; active != NULL; active = TAILQ_NEXT(active, tailq)) {
+		if (active->state != SPDK_POLLER_STATE_UNREGISTERED) {
+			return active;
+		}
+	}
+
+	for (; timer_index < thread->timer_poller_count; timer_index++) {
+		if (thread->timer_pollers[timer_index]->state != SPDK_POLLER_STATE_UNREGISTERED) {
+			return thread->timer_pollers[timer_index];
+		}
+	}
+
+	return NULL;
+}
+
+struct spdk_poller *
+spdk_thread_get_first_poller(struct spdk_thread *thread)
+{
+	return _spdk_thread_find_poller(thread, TAILQ_FIRST(&thread->active_pollers), 0);
+}
+
+struct spdk_poller *
+spdk_thread_get_next_poller(struct spdk_poller *prev)
+{
+	if (prev->period_ticks == 0) {
+		return _spdk_thread_find_poller(prev->thread, TAILQ_NEXT(prev, tailq), 0);
+	}
+
+	return _spdk_thread_find_poller(prev->thread, NULL, prev->timer_index + 1);
+}
+
+const char *
+spdk_poller_get_name(const struct spdk_poller *poller)
+{
+	return poller->name;
+}
+
+uint64_t
+spdk_poller_get_period_ticks(const struct spdk_poller *poller)
+{
+	return poller->period_ticks;
+}
+
+void
+spdk_poller_get_stats(const struct spdk_poller *poller, struct spdk_poller_stats *stats)
+{
+	*stats = poller->stats;
+}
+
 struct call_thread {
 	struct spdk_thread *cur_thread;
 	spdk_msg_fn fn;
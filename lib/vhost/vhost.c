@@ -44,6 +44,8 @@
 #include "spdk_internal/memory.h"
 
 static TAILQ_HEAD(, vhost_poll_group) g_poll_groups = TAILQ_HEAD_INITIALIZER(g_poll_groups);
+static uint32_t g_poll_group_id;
+static uint32_t g_num_exiting_poll_groups;
 
 /* Temporary cpuset for poll group assignment */
 static struct spdk_cpuset *g_tmp_cpuset;
@@ -863,10 +865,35 @@ struct vhost_poll_group *
 vhost_get_poll_group(struct spdk_cpuset *cpumask)
 {
 	struct vhost_poll_group *pg, *selected_pg;
+	char thread_name[32];
 	uint32_t min_ctrlrs;
 
+	/* Reuse a poll group that no session runs on anymore */
+	TAILQ_FOREACH(pg, &g_poll_groups, tailq) {
+		if (pg->ref == 0 &&
+		    spdk_cpuset_equal(spdk_thread_get_cpumask(pg->thread), cpumask)) {
+			return pg;
+		}
+	}
+
+	/*
+	 * Each poll group gets its own thread that may run on any core of the
+	 * device cpumask, so that a scheduler can move it between reactors.
+	 */
+	pg = calloc(1, sizeof(*pg));
+	if (pg != NULL) {
+		snprintf(thread_name, sizeof(thread_name), "vhost_pg_%u", g_poll_group_id++);
+		pg->thread = spdk_thread_create(thread_name, cpumask);
+		if (pg->thread != NULL) {
+			TAILQ_INSERT_TAIL(&g_poll_groups, pg, tailq);
+			return pg;
+		}
+		free(pg);
+	}
+
+	SPDK_ERRLOG("Failed to create a poll group thread, trying to share an existing one\n");
 	min_ctrlrs = INT_MAX;
-	selected_pg = TAILQ_FIRST(&g_poll_groups);
+	selected_pg = NULL;
 
 	TAILQ_FOREACH(pg, &g_poll_groups, tailq) {
 		spdk_cpuset_copy(g_tmp_cpuset, cpumask);
@@ -883,7 +910,6 @@ vhost_get_poll_group(struct spdk_cpuset *cpumask)
 		}
 	}
 
-	assert(selected_pg != NULL);
 	return selected_pg;
 }
 
@@ -1457,56 +1483,32 @@ spdk_vhost_unlock(void)
 	pthread_mutex_unlock(&g_vhost_mutex);
 }
 
-static void
-vhost_create_poll_group_done(void *ctx)
+static int
+vhost_controllers_construct(void)
 {
-	spdk_vhost_init_cb init_cb = ctx;
 	int ret;
 
-	if (TAILQ_EMPTY(&g_poll_groups)) {
-		/* No threads? Iteration failed? */
-		init_cb(-ECHILD);
-		return;
-	}
-
 	ret = vhost_scsi_controller_construct();
 	if (ret != 0) {
 		SPDK_ERRLOG("Cannot construct vhost controllers\n");
-		goto out;
+		return ret;
 	}
 
 	ret = vhost_blk_controller_construct();
 	if (ret != 0) {
 		SPDK_ERRLOG("Cannot construct vhost block controllers\n");
-		goto out;
+		return ret;
 	}
 
 #ifdef SPDK_CONFIG_VHOST_INTERNAL_LIB
 	ret = vhost_nvme_controller_construct();
 	if (ret != 0) {
 		SPDK_ERRLOG("Cannot construct vhost NVMe controllers\n");
-		goto out;
+		return ret;
 	}
 #endif
 
-out:
-	init_cb(ret);
-}
-
-static void
-vhost_create_poll_group(void *ctx)
-{
-	struct vhost_poll_group *pg;
-
-	pg = calloc(1, sizeof(*pg));
-	if (!pg) {
-		SPDK_ERRLOG("Not enough memory to allocate poll groups\n");
-		spdk_app_stop(-ENOMEM);
-		return;
-	}
-
-	pg->thread = spdk_get_thread();
-	TAILQ_INSERT_TAIL(&g_poll_groups, pg, tailq);
+	return 0;
 }
 
 void
@@ -1546,19 +1548,56 @@ spdk_vhost_init(spdk_vhost_init_cb init_cb)
 		goto err_out;
 	}
 
-	spdk_for_each_thread(vhost_create_poll_group,
-			     init_cb,
-			     vhost_create_poll_group_done);
-	return;
+	/* Poll groups are created on demand when sessions start */
+	ret = vhost_controllers_construct();
 err_out:
 	init_cb(ret);
 }
 
+static void
+vhost_poll_group_exit_done(void *ctx)
+{
+	struct vhost_poll_group *pg = ctx;
+
+	TAILQ_REMOVE(&g_poll_groups, pg, tailq);
+	free(pg);
+
+	assert(g_num_exiting_poll_groups > 0);
+	if (--g_num_exiting_poll_groups == 0) {
+		g_fini_cpl_cb();
+	}
+}
+
+static int
+vhost_poll_group_exit_poll(void *ctx)
+{
+	struct vhost_poll_group *pg = ctx;
+
+	/* Sessions put their channels asynchronously. Exit once they are all gone. */
+	if (spdk_thread_has_io_channels(pg->thread)) {
+		return 0;
+	}
+
+	spdk_poller_unregister(&pg->exit_poller);
+	spdk_thread_exit(pg->thread);
+	spdk_thread_send_msg(g_vhost_init_thread, vhost_poll_group_exit_done, pg);
+
+	return 1;
+}
+
+static void
+vhost_poll_group_exit(void *ctx)
+{
+	struct vhost_poll_group *pg = ctx;
+
+	pg->exit_poller = SPDK_POLLER_REGISTER(vhost_poll_group_exit_poll, pg, 0);
+}
+
 static void
 _spdk_vhost_fini(void *arg1)
 {
 	struct spdk_vhost_dev *vdev, *tmp;
-	struct vhost_poll_group *pg, *tpg;
+	struct vhost_poll_group *pg;
 
 	spdk_vhost_lock();
 	vdev = spdk_vhost_dev_next(NULL);
@@ -1573,11 +1612,17 @@ _spdk_vhost_fini(void *arg1)
 	/* All devices are removed now. */
 	sem_destroy(&g_dpdk_sem);
 	spdk_cpuset_free(g_tmp_cpuset);
-	TAILQ_FOREACH_SAFE(pg, &g_poll_groups, tailq, tpg) {
-		TAILQ_REMOVE(&g_poll_groups, pg, tailq);
-		free(pg);
+
+	if (TAILQ_EMPTY(&g_poll_groups)) {
+		g_fini_cpl_cb();
+		return;
+	}
+
+	TAILQ_FOREACH(pg, &g_poll_groups, tailq) {
+		assert(pg->ref == 0);
+		g_num_exiting_poll_groups++;
+		spdk_thread_send_msg(pg->thread, vhost_poll_group_exit, pg);
 	}
-	g_fini_cpl_cb();
 }
 
 static void *
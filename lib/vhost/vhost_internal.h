@@ -96,6 +96,7 @@
 
 struct vhost_poll_group {
 	struct spdk_thread *thread;
+	struct spdk_poller *exit_poller;
 	unsigned ref;
 	TAILQ_ENTRY(vhost_poll_group) tailq;
 };
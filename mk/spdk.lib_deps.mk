@@ -56,13 +56,13 @@ DEPDIRS-reduce := log util
 DEPDIRS-thread := log util
 
 DEPDIRS-blob := log util thread
-DEPDIRS-copy := thread
 DEPDIRS-jsonrpc := log util json
 DEPDIRS-virtio := log util json thread
 
 DEPDIRS-lvol := log util blob
 DEPDIRS-rpc := log util json jsonrpc
 
+DEPDIRS-copy := log util thread $(JSON_LIBS)
 DEPDIRS-log_rpc := log $(JSON_LIBS)
 DEPDIRS-net := log util $(JSON_LIBS)
 DEPDIRS-notify := log util $(JSON_LIBS)
@@ -117,6 +117,8 @@ DEPDIRS-bdev_error := $(BDEV_DEPS_CONF)
 DEPDIRS-bdev_malloc := $(BDEV_DEPS_CONF) copy
 DEPDIRS-bdev_split := $(BDEV_DEPS_CONF)
 
+DEPDIRS-bdev_cache := $(BDEV_DEPS_THREAD)
+DEPDIRS-bdev_dedup := $(BDEV_DEPS_THREAD)
 DEPDIRS-bdev_compress := $(BDEV_DEPS_THREAD) reduce
 DEPDIRS-bdev_delay := $(BDEV_DEPS_THREAD)
 
@@ -133,6 +135,7 @@ DEPDIRS-bdev_passthru := $(BDEV_DEPS_CONF_THREAD)
 DEPDIRS-bdev_pmem := $(BDEV_DEPS_CONF_THREAD)
 DEPDIRS-bdev_raid := $(BDEV_DEPS_CONF_THREAD)
 DEPDIRS-bdev_rbd := $(BDEV_DEPS_CONF_THREAD)
+DEPDIRS-bdev_uring := $(BDEV_DEPS_CONF_THREAD)
 DEPDIRS-bdev_virtio := $(BDEV_DEPS_CONF_THREAD) virtio
 
 # module/event
@@ -50,6 +50,13 @@
 #include "spdk_internal/log.h"
 
 #include <libaio.h>
+#include <sys/eventfd.h>
+
+#define SPDK_AIO_QUEUE_DEPTH 128
+#define MAX_EVENTS_PER_POLL 32
+
+/* Buckets of the batch size histogram: 1, 2-3, 4-7, ..., 128 iocbs per io_submit(). */
+#define SPDK_AIO_BATCH_HIST_BUCKETS 8
 
 struct bdev_aio_io_channel {
 	uint64_t				io_inflight;
@@ -59,6 +66,24 @@ struct bdev_aio_io_channel {
 struct bdev_aio_group_channel {
 	struct spdk_poller			*poller;
 	io_context_t				io_ctx;
+
+	/* Signaled by the kernel for every completed iocb, or -1 if eventfd is not used. */
+	int					efd;
+	/* The eventfd may have been signaled since it was last read. */
+	bool					efd_signaled;
+	/* iocbs submitted to the kernel and not reaped yet */
+	uint32_t				io_inflight;
+
+	/* iocbs waiting for the next io_submit(), and when the first of them was queued */
+	struct iocb				*pending[SPDK_AIO_QUEUE_DEPTH];
+	uint32_t				pending_count;
+	uint64_t				pending_tsc;
+	uint32_t				max_batch;
+	uint64_t				batch_latency_ticks;
+
+	uint64_t				submit_calls;
+	uint64_t				submitted_iocbs;
+	uint64_t				batch_hist[SPDK_AIO_BATCH_HIST_BUCKETS];
 };
 
 struct bdev_aio_task {
@@ -97,10 +122,16 @@ static int bdev_aio_initialize(void);
 static void bdev_aio_fini(void);
 static void aio_free_disk(struct file_disk *fdisk);
 static void bdev_aio_get_spdk_running_config(FILE *fp);
+static int bdev_aio_config_json(struct spdk_json_write_ctx *w);
 static TAILQ_HEAD(, file_disk) g_aio_disk_head;
 
-#define SPDK_AIO_QUEUE_DEPTH 128
-#define MAX_EVENTS_PER_POLL 32
+static struct bdev_aio_opts g_opts = {
+	.max_batch = 32,
+	.batch_latency_us = 0,
+	.use_eventfd = false,
+};
+
+static bool g_aio_initialized;
 
 static int
 bdev_aio_get_ctx_size(void)
@@ -113,11 +144,35 @@ static struct spdk_bdev_module aio_if = {
 	.module_init	= bdev_aio_initialize,
 	.module_fini	= bdev_aio_fini,
 	.config_text	= bdev_aio_get_spdk_running_config,
+	.config_json	= bdev_aio_config_json,
 	.get_ctx_size	= bdev_aio_get_ctx_size,
 };
 
 SPDK_BDEV_MODULE_REGISTER(aio, &aio_if)
 
+void
+bdev_aio_get_opts(struct bdev_aio_opts *opts)
+{
+	*opts = g_opts;
+}
+
+int
+bdev_aio_set_opts(const struct bdev_aio_opts *opts)
+{
+	if (g_aio_initialized) {
+		SPDK_ERRLOG("AIO options can only be changed before the module is initialized\n");
+		return -EPERM;
+	}
+
+	if (opts->max_batch == 0 || opts->max_batch > SPDK_AIO_QUEUE_DEPTH) {
+		SPDK_ERRLOG("max_batch must be between 1 and %d\n", SPDK_AIO_QUEUE_DEPTH);
+		return -EINVAL;
+	}
+
+	g_opts = *opts;
+	return 0;
+}
+
 static int
 bdev_aio_open(struct file_disk *disk)
 {
@@ -161,6 +216,79 @@ bdev_aio_close(struct file_disk *disk)
 	return 0;
 }
 
+/*
+ * Submit all queued iocbs with as few io_submit() calls as the kernel allows. The ones
+ * it does not take are completed with NOMEM, so that the bdev layer retries them once
+ * other I/O completes.
+ */
+static int
+bdev_aio_group_flush(struct bdev_aio_group_channel *group_ch)
+{
+	struct iocb *failed[SPDK_AIO_QUEUE_DEPTH];
+	struct bdev_aio_task *aio_task;
+	uint32_t count = group_ch->pending_count;
+	uint32_t submitted = 0, i;
+	int rc = 0;
+
+	while (submitted < count) {
+		rc = io_submit(group_ch->io_ctx, count - submitted, &group_ch->pending[submitted]);
+		group_ch->submit_calls++;
+		if (rc <= 0) {
+			break;
+		}
+		group_ch->batch_hist[spdk_u32log2(rc)]++;
+		submitted += rc;
+	}
+
+	group_ch->io_inflight += submitted;
+	group_ch->submitted_iocbs += submitted;
+	group_ch->pending_count = 0;
+
+	if (spdk_likely(submitted == count)) {
+		return count;
+	}
+
+	/* Completions may queue new iocbs, so move the remaining ones out of the way first. */
+	memcpy(failed, &group_ch->pending[submitted], (count - submitted) * sizeof(failed[0]));
+	if (rc != -EAGAIN && rc != 0) {
+		SPDK_ERRLOG("io_submit returned %d\n", rc);
+	}
+
+	for (i = 0; i < count - submitted; i++) {
+		aio_task = failed[i]->data;
+		aio_task->ch->io_inflight--;
+		spdk_bdev_io_complete(spdk_bdev_io_from_ctx(aio_task),
+				      (rc == -EAGAIN || rc == 0) ? SPDK_BDEV_IO_STATUS_NOMEM :
+				      SPDK_BDEV_IO_STATUS_FAILED);
+	}
+
+	return submitted;
+}
+
+/*
+ * Queue an iocb on the group channel. It is submitted together with the other queued
+ * iocbs by the group poller, or right away once max_batch of them are queued.
+ */
+static void
+bdev_aio_queue(struct bdev_aio_io_channel *aio_ch, struct iocb *iocb)
+{
+	struct bdev_aio_group_channel *group_ch = aio_ch->group_ch;
+
+	if (group_ch->efd >= 0) {
+		io_set_eventfd(iocb, group_ch->efd);
+	}
+
+	aio_ch->io_inflight++;
+	if (group_ch->pending_count == 0) {
+		group_ch->pending_tsc = spdk_get_ticks();
+	}
+	group_ch->pending[group_ch->pending_count++] = iocb;
+
+	if (group_ch->pending_count >= group_ch->max_batch) {
+		bdev_aio_group_flush(group_ch);
+	}
+}
+
 static int64_t
 bdev_aio_readv(struct file_disk *fdisk, struct spdk_io_channel *ch,
 	       struct bdev_aio_task *aio_task,
@@ -168,7 +296,6 @@ bdev_aio_readv(struct file_disk *fdisk, struct spdk_io_channel *ch,
 {
 	struct iocb *iocb = &aio_task->iocb;
 	struct bdev_aio_io_channel *aio_ch = spdk_io_channel_get_ctx(ch);
-	int rc;
 
 	io_prep_preadv(iocb, fdisk->fd, iov, iovcnt, offset);
 	iocb->data = aio_task;
@@ -178,17 +305,7 @@ bdev_aio_readv(struct file_disk *fdisk, struct spdk_io_channel *ch,
 	SPDK_DEBUGLOG(SPDK_LOG_AIO, "read %d iovs size %lu to off: %#lx\n",
 		      iovcnt, nbytes, offset);
 
-	rc = io_submit(aio_ch->group_ch->io_ctx, 1, &iocb);
-	if (rc < 0) {
-		if (rc == -EAGAIN) {
-			spdk_bdev_io_complete(spdk_bdev_io_from_ctx(aio_task), SPDK_BDEV_IO_STATUS_NOMEM);
-		} else {
-			spdk_bdev_io_complete(spdk_bdev_io_from_ctx(aio_task), SPDK_BDEV_IO_STATUS_FAILED);
-			SPDK_ERRLOG("%s: io_submit returned %d\n", __func__, rc);
-		}
-		return -1;
-	}
-	aio_ch->io_inflight++;
+	bdev_aio_queue(aio_ch, iocb);
 	return nbytes;
 }
 
@@ -199,7 +316,6 @@ bdev_aio_writev(struct file_disk *fdisk, struct spdk_io_channel *ch,
 {
 	struct iocb *iocb = &aio_task->iocb;
 	struct bdev_aio_io_channel *aio_ch = spdk_io_channel_get_ctx(ch);
-	int rc;
 
 	io_prep_pwritev(iocb, fdisk->fd, iov, iovcnt, offset);
 	iocb->data = aio_task;
@@ -209,17 +325,7 @@ bdev_aio_writev(struct file_disk *fdisk, struct spdk_io_channel *ch,
 	SPDK_DEBUGLOG(SPDK_LOG_AIO, "write %d iovs size %lu from off: %#lx\n",
 		      iovcnt, len, offset);
 
-	rc = io_submit(aio_ch->group_ch->io_ctx, 1, &iocb);
-	if (rc < 0) {
-		if (rc == -EAGAIN) {
-			spdk_bdev_io_complete(spdk_bdev_io_from_ctx(aio_task), SPDK_BDEV_IO_STATUS_NOMEM);
-		} else {
-			spdk_bdev_io_complete(spdk_bdev_io_from_ctx(aio_task), SPDK_BDEV_IO_STATUS_FAILED);
-			SPDK_ERRLOG("%s: io_submit returned %d\n", __func__, rc);
-		}
-		return -1;
-	}
-	aio_ch->io_inflight++;
+	bdev_aio_queue(aio_ch, iocb);
 	return len;
 }
 
@@ -312,9 +418,8 @@ bdev_user_io_getevents(io_context_t io_ctx, unsigned int max, struct io_event *u
 }
 
 static int
-bdev_aio_group_poll(void *arg)
+bdev_aio_group_reap(struct bdev_aio_group_channel *group_ch)
 {
-	struct bdev_aio_group_channel *group_ch = arg;
 	int nr, i = 0;
 	enum spdk_bdev_io_status status;
 	struct bdev_aio_task *aio_task;
@@ -322,10 +427,13 @@ bdev_aio_group_poll(void *arg)
 
 	nr = bdev_user_io_getevents(group_ch->io_ctx, SPDK_AIO_QUEUE_DEPTH, events);
 
-	if (nr < 0) {
-		return -1;
+	if (nr <= 0) {
+		return nr;
 	}
 
+	group_ch->io_inflight -= nr;
+	group_ch->efd_signaled = true;
+
 	for (i = 0; i < nr; i++) {
 		aio_task = events[i].data;
 		if (events[i].res != aio_task->len) {
@@ -341,6 +449,60 @@ bdev_aio_group_poll(void *arg)
 	return nr;
 }
 
+/*
+ * Reset the eventfd counter. Returns true if it was signaled, in which case completions
+ * that arrived since the last reap may be waiting. Any completion after this call
+ * signals the eventfd again, so no wakeup is lost.
+ */
+static bool
+bdev_aio_group_clear_eventfd(struct bdev_aio_group_channel *group_ch)
+{
+	uint64_t val;
+
+	group_ch->efd_signaled = false;
+	return read(group_ch->efd, &val, sizeof(val)) == sizeof(val);
+}
+
+static int
+bdev_aio_group_poll(void *arg)
+{
+	struct bdev_aio_group_channel *group_ch = arg;
+	uint64_t val = 1;
+	int nr;
+
+	nr = bdev_aio_group_reap(group_ch);
+	if (nr < 0) {
+		return -1;
+	}
+
+	/*
+	 * Only read the eventfd once the ring ran dry, so that a busy group does not pay
+	 * for a system call per poll. A group with nothing in flight skips it as well.
+	 */
+	if (nr == 0 && group_ch->efd >= 0 &&
+	    (group_ch->io_inflight > 0 || group_ch->efd_signaled) &&
+	    bdev_aio_group_clear_eventfd(group_ch)) {
+		nr = bdev_aio_group_reap(group_ch);
+		if (nr < 0) {
+			return -1;
+		}
+	}
+
+	/* Completions above may have queued new iocbs, they go out in the same batch. */
+	if (group_ch->pending_count > 0) {
+		if (spdk_get_ticks() - group_ch->pending_tsc >= group_ch->batch_latency_ticks) {
+			nr += bdev_aio_group_flush(group_ch);
+		} else if (group_ch->efd >= 0) {
+			/* Keep the thread from sleeping while iocbs are held back. */
+			if (write(group_ch->efd, &val, sizeof(val)) == sizeof(val)) {
+				group_ch->efd_signaled = true;
+			}
+		}
+	}
+
+	return nr;
+}
+
 static void
 _bdev_aio_get_io_inflight(struct spdk_io_channel_iter *i)
 {
@@ -363,7 +525,7 @@ _bdev_aio_get_io_inflight_done(struct spdk_io_channel_iter *i, int status)
 	struct file_disk *fdisk = spdk_io_channel_iter_get_ctx(i);
 
 	if (status == -1) {
-		fdisk->reset_retry_timer = spdk_poller_register(bdev_aio_reset_retry_timer, fdisk, 500);
+		fdisk->reset_retry_timer = SPDK_POLLER_REGISTER(bdev_aio_reset_retry_timer, fdisk, 500);
 		return;
 	}
 
@@ -561,12 +723,30 @@ bdev_aio_group_create_cb(void *io_device, void *ctx_buf)
 {
 	struct bdev_aio_group_channel *ch = ctx_buf;
 
+	ch->efd = -1;
+	ch->max_batch = g_opts.max_batch;
+	ch->batch_latency_ticks = g_opts.batch_latency_us * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
+
 	if (io_setup(SPDK_AIO_QUEUE_DEPTH, &ch->io_ctx) < 0) {
 		SPDK_ERRLOG("async I/O context setup failure\n");
 		return -1;
 	}
 
-	ch->poller = spdk_poller_register(bdev_aio_group_poll, ch, 0);
+	if (g_opts.use_eventfd) {
+		ch->efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (ch->efd < 0) {
+			SPDK_ERRLOG("eventfd() failed, errno %d: %s\n", errno, spdk_strerror(errno));
+			io_destroy(ch->io_ctx);
+			return -1;
+		}
+	}
+
+	ch->poller = SPDK_POLLER_REGISTER(bdev_aio_group_poll, ch, 0);
+	if (ch->efd >= 0) {
+		/* Let the reactor sleep while no I/O of this group is in flight. */
+		spdk_poller_set_wakeup_fd(ch->poller, ch->efd);
+	}
+
 	return 0;
 }
 
@@ -575,9 +755,77 @@ bdev_aio_group_destroy_cb(void *io_device, void *ctx_buf)
 {
 	struct bdev_aio_group_channel *ch = ctx_buf;
 
+	assert(ch->pending_count == 0);
+
 	io_destroy(ch->io_ctx);
 
 	spdk_poller_unregister(&ch->poller);
+	if (ch->efd >= 0) {
+		close(ch->efd);
+	}
+}
+
+struct bdev_aio_get_stats_ctx {
+	struct spdk_json_write_ctx	*w;
+	bdev_aio_get_stats_complete	cb_fn;
+	void				*cb_arg;
+};
+
+static void
+_bdev_aio_get_stats(struct spdk_io_channel_iter *i)
+{
+	struct bdev_aio_get_stats_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
+	struct bdev_aio_group_channel *ch = spdk_io_channel_get_ctx(_ch);
+	struct spdk_json_write_ctx *w = ctx->w;
+	int bucket;
+
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_string(w, "thread", spdk_thread_get_name(spdk_get_thread()));
+	spdk_json_write_named_bool(w, "eventfd", ch->efd >= 0);
+	spdk_json_write_named_uint64(w, "submit_calls", ch->submit_calls);
+	spdk_json_write_named_uint64(w, "submitted_iocbs", ch->submitted_iocbs);
+	spdk_json_write_named_uint32(w, "io_inflight", ch->io_inflight);
+
+	spdk_json_write_named_array_begin(w, "batch_size_histogram");
+	for (bucket = 0; bucket < SPDK_AIO_BATCH_HIST_BUCKETS; bucket++) {
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_uint32(w, "min", 1u << bucket);
+		spdk_json_write_named_uint32(w, "max", spdk_min((2u << bucket) - 1, SPDK_AIO_QUEUE_DEPTH));
+		spdk_json_write_named_uint64(w, "count", ch->batch_hist[bucket]);
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_array_end(w);
+
+	spdk_json_write_object_end(w);
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+_bdev_aio_get_stats_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct bdev_aio_get_stats_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	ctx->cb_fn(ctx->cb_arg);
+	free(ctx);
+}
+
+void
+bdev_aio_get_stats(struct spdk_json_write_ctx *w, bdev_aio_get_stats_complete cb_fn, void *cb_arg)
+{
+	struct bdev_aio_get_stats_ctx *ctx;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		cb_fn(cb_arg);
+		return;
+	}
+
+	ctx->w = w;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+	spdk_for_each_channel(&aio_if, _bdev_aio_get_stats, ctx, _bdev_aio_get_stats_done);
 }
 
 int
@@ -731,6 +979,7 @@ bdev_aio_initialize(void)
 	int rc = 0;
 
 	TAILQ_INIT(&g_aio_disk_head);
+	g_aio_initialized = true;
 	spdk_io_device_register(&aio_if, bdev_aio_group_create_cb, bdev_aio_group_destroy_cb,
 				sizeof(struct bdev_aio_group_channel),
 				"aio_module");
@@ -786,6 +1035,25 @@ static void
 bdev_aio_fini(void)
 {
 	spdk_io_device_unregister(&aio_if, NULL);
+	g_aio_initialized = false;
+}
+
+static int
+bdev_aio_config_json(struct spdk_json_write_ctx *w)
+{
+	spdk_json_write_object_begin(w);
+
+	spdk_json_write_named_string(w, "method", "bdev_aio_set_options");
+
+	spdk_json_write_named_object_begin(w, "params");
+	spdk_json_write_named_uint32(w, "max_batch", g_opts.max_batch);
+	spdk_json_write_named_uint32(w, "batch_latency_us", g_opts.batch_latency_us);
+	spdk_json_write_named_bool(w, "use_eventfd", g_opts.use_eventfd);
+	spdk_json_write_object_end(w);
+
+	spdk_json_write_object_end(w);
+
+	return 0;
 }
 
 static void
@@ -36,9 +36,33 @@
 
 #include "spdk/stdinc.h"
 #include "spdk/bdev.h"
+#include "spdk/json.h"
 
 typedef void (*delete_aio_bdev_complete)(void *cb_arg, int bdeverrno);
 
+struct bdev_aio_opts {
+	/* Most iocbs passed to a single io_submit(). 1 submits every I/O on its own. */
+	uint32_t	max_batch;
+	/* Microseconds an iocb may be held back to batch it with later ones. 0 submits on the next poll. */
+	uint32_t	batch_latency_us;
+	/* Signal completions on an eventfd, so that a group without I/O lets its thread sleep */
+	bool		use_eventfd;
+};
+
+void bdev_aio_get_opts(struct bdev_aio_opts *opts);
+
+/* Options can only be changed before the module is initialized. */
+int bdev_aio_set_opts(const struct bdev_aio_opts *opts);
+
+typedef void (*bdev_aio_get_stats_complete)(void *cb_arg);
+
+/*
+ * Write an object with the submission statistics of each group channel to w, then
+ * call cb_fn once all of them were written.
+ */
+void bdev_aio_get_stats(struct spdk_json_write_ctx *w, bdev_aio_get_stats_complete cb_fn,
+			void *cb_arg);
+
 int create_aio_bdev(const char *name, const char *filename, uint32_t block_size);
 
 void bdev_aio_delete(struct spdk_bdev *bdev, delete_aio_bdev_complete cb_fn, void *cb_arg);
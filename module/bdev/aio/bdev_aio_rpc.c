@@ -37,6 +37,42 @@
 #include "spdk/string.h"
 #include "spdk_internal/log.h"
 
+static const struct spdk_json_object_decoder rpc_bdev_aio_set_options_decoders[] = {
+	{"max_batch", offsetof(struct bdev_aio_opts, max_batch), spdk_json_decode_uint32, true},
+	{"batch_latency_us", offsetof(struct bdev_aio_opts, batch_latency_us), spdk_json_decode_uint32, true},
+	{"use_eventfd", offsetof(struct bdev_aio_opts, use_eventfd), spdk_json_decode_bool, true},
+};
+
+static void
+spdk_rpc_bdev_aio_set_options(struct spdk_jsonrpc_request *request,
+			      const struct spdk_json_val *params)
+{
+	struct bdev_aio_opts opts;
+	struct spdk_json_write_ctx *w;
+	int rc;
+
+	bdev_aio_get_opts(&opts);
+	if (params != NULL &&
+	    spdk_json_decode_object(params, rpc_bdev_aio_set_options_decoders,
+				    SPDK_COUNTOF(rpc_bdev_aio_set_options_decoders), &opts)) {
+		SPDK_ERRLOG("spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "Invalid parameters");
+		return;
+	}
+
+	rc = bdev_aio_set_opts(&opts);
+	if (rc) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+}
+SPDK_RPC_REGISTER("bdev_aio_set_options", spdk_rpc_bdev_aio_set_options, SPDK_RPC_STARTUP)
+
 struct rpc_construct_aio {
 	char *name;
 	char *filename;
@@ -146,3 +182,46 @@ cleanup:
 }
 SPDK_RPC_REGISTER("bdev_aio_delete", spdk_rpc_bdev_aio_delete, SPDK_RPC_RUNTIME)
 SPDK_RPC_REGISTER_ALIAS_DEPRECATED(bdev_aio_delete, delete_aio_bdev)
+
+struct rpc_bdev_aio_get_stats_ctx {
+	struct spdk_jsonrpc_request *request;
+	struct spdk_json_write_ctx *w;
+};
+
+static void
+_spdk_rpc_bdev_aio_get_stats_cb(void *cb_arg)
+{
+	struct rpc_bdev_aio_get_stats_ctx *ctx = cb_arg;
+
+	spdk_json_write_array_end(ctx->w);
+	spdk_json_write_object_end(ctx->w);
+	spdk_jsonrpc_end_result(ctx->request, ctx->w);
+	free(ctx);
+}
+
+static void
+spdk_rpc_bdev_aio_get_stats(struct spdk_jsonrpc_request *request,
+			    const struct spdk_json_val *params)
+{
+	struct rpc_bdev_aio_get_stats_ctx *ctx;
+
+	if (params != NULL) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "bdev_aio_get_stats requires no parameters");
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		spdk_jsonrpc_send_error_response(request, -ENOMEM, spdk_strerror(ENOMEM));
+		return;
+	}
+
+	ctx->request = request;
+	ctx->w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_object_begin(ctx->w);
+	spdk_json_write_named_array_begin(ctx->w, "group_channels");
+
+	bdev_aio_get_stats(ctx->w, _spdk_rpc_bdev_aio_get_stats_cb, ctx);
+}
+SPDK_RPC_REGISTER("bdev_aio_get_stats", spdk_rpc_bdev_aio_get_stats, SPDK_RPC_RUNTIME)
@@ -0,0 +1,2388 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Write-back cache virtual bdev. A fast bdev (the cache bdev) holds copies of
+ * fixed size lines of a slow bdev (the base bdev). Writes complete once they are
+ * on the cache bdev and are destaged to the base bdev in the background.
+ *
+ * Layout of the cache bdev:
+ *  - block 0: superblock
+ *  - metadata pages, one block each, with an entry per cache line
+ *  - cache lines, starting at a line aligned block
+ *
+ * The metadata entry of a line is written after the data that made the line
+ * dirty, and before such a write completes. After a crash, only dirty lines are
+ * picked up, with just their dirty blocks, which are always consistent with
+ * their entry. A clean shutdown saves all entries, so the whole cache survives.
+ *
+ * All state of a cache is owned by the thread that created it, and I/O is sent
+ * to that thread like the compress vbdev does.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "vbdev_cache.h"
+
+#include "spdk/assert.h"
+#include "spdk/bdev_module.h"
+#include "spdk/crc32.h"
+#include "spdk/env.h"
+#include "spdk/json.h"
+#include "spdk/likely.h"
+#include "spdk/string.h"
+#include "spdk/thread.h"
+#include "spdk/util.h"
+#include "spdk/uuid.h"
+
+#include "spdk_internal/log.h"
+#include "spdk_internal/vbdev_md.h"
+
+#define CACHE_SB_MAGIC			"SPDKCACH"
+#define CACHE_SB_VERSION		1
+/* Valid bits and dirty bits of a line are kept in one uint64_t each. */
+#define CACHE_MAX_LINE_BLOCKS		64
+#define CACHE_DEFAULT_LINE_SIZE		(64 * 1024)
+#define CACHE_FILL_BUFS			32
+#define CACHE_DESTAGE_MAX_LINES		8
+#define CACHE_DESTAGE_CTXS		16
+#define CACHE_DESTAGE_POLL_US		100
+/* Destaging speeds up once this percentage of the lines is dirty. */
+#define CACHE_DIRTY_LOW_PCT		10
+#define CACHE_DIRTY_HIGH_PCT		50
+/* Most lines looked at from the LRU end of a list when looking for one to evict */
+#define CACHE_EVICT_SCAN		128
+#define CACHE_STREAMS			8
+#define CACHE_NONE			UINT32_MAX
+
+struct cache_sb {
+	struct spdk_vbdev_md_sb	hdr;
+	uint32_t		block_size;
+	uint32_t		line_blocks;
+	uint64_t		num_lines;
+	uint64_t		md_offset;
+	uint64_t		md_blocks;
+	uint64_t		data_offset;
+	uint64_t		base_blockcnt;
+	struct spdk_uuid	base_uuid;
+	/* Set on a clean shutdown, when every metadata entry is up to date. */
+	uint8_t			clean;
+	uint8_t			reserved[7];
+};
+SPDK_STATIC_ASSERT(sizeof(struct cache_sb) <= 512, "cache superblock does not fit a block");
+
+struct cache_md_hdr {
+	/* CRC32C of the page with this field set to 0 */
+	uint32_t		crc;
+	uint32_t		reserved;
+	uint64_t		reserved2;
+};
+
+struct cache_md_entry {
+	/* Base line number + 1, 0 for an unused line */
+	uint64_t		base_line;
+	uint64_t		valid;
+	uint64_t		dirty;
+	uint64_t		reserved;
+};
+
+struct cache_geometry {
+	uint32_t		line_blocks;
+	uint64_t		num_lines;
+	uint64_t		md_offset;
+	uint64_t		md_blocks;
+	uint64_t		data_offset;
+	uint32_t		entries_per_page;
+};
+
+enum cache_list {
+	/* Unused cache line */
+	CACHE_LIST_FREE,
+	/* Lines accessed once recently. The only list used by LRU. */
+	CACHE_LIST_T1,
+	/* Lines accessed more than once recently */
+	CACHE_LIST_T2,
+	/* Ghosts of the lines evicted from T1 and T2, without data */
+	CACHE_LIST_B1,
+	CACHE_LIST_B2,
+	CACHE_LIST_COUNT,
+};
+
+struct vbdev_cache_io;
+
+struct cache_line {
+	uint64_t			base_line;
+	uint64_t			valid;
+	uint64_t			dirty;
+	/* Dirty bits as they are on the cache bdev, and as they are being written */
+	uint64_t			md_dirty;
+	uint64_t			md_snap;
+	/* Blocks being destaged, and blocks written while they were */
+	uint64_t			destage_mask;
+	uint64_t			redirty;
+	/* Blocks being filled after a read miss */
+	uint64_t			fill_mask;
+	uint32_t			hash_next;
+	uint32_t			refcnt;
+	uint32_t			writes;
+	uint8_t				list;
+	bool				on_dirty_list;
+	TAILQ_ENTRY(cache_line)		link;
+	TAILQ_ENTRY(cache_line)		dirty_link;
+	/* Writes waiting for a fill of the same blocks */
+	TAILQ_HEAD(, vbdev_cache_io)	waiters;
+};
+
+TAILQ_HEAD(cache_line_list, cache_line);
+
+struct vbdev_cache;
+
+struct cache_fill {
+	struct vbdev_cache		*cache;
+	struct cache_line		*line;
+	uint64_t			mask;
+	uint32_t			first;
+	uint32_t			num_blocks;
+	void				*buf;
+	struct spdk_bdev_io_wait_entry	bdev_io_wait;
+	TAILQ_ENTRY(cache_fill)		link;
+};
+
+struct cache_destage;
+
+struct cache_destage_seg {
+	struct cache_destage		*destage;
+	struct cache_line		*line;
+	uint32_t			first;
+	uint32_t			num_blocks;
+	/* Offset of the segment in the destage buffer, in blocks */
+	uint32_t			buf_offset;
+	struct spdk_vbdev_md_wait	md_wait;
+	struct spdk_bdev_io_wait_entry	bdev_io_wait;
+};
+
+struct cache_destage {
+	struct vbdev_cache		*cache;
+	struct cache_destage_seg	segs[CACHE_DESTAGE_MAX_LINES];
+	uint32_t			num_segs;
+	uint32_t			num_blocks;
+	uint32_t			outstanding;
+	bool				failed;
+	void				*buf;
+	struct spdk_bdev_io_wait_entry	bdev_io_wait;
+	TAILQ_ENTRY(cache_destage)	link;
+};
+
+struct cache_stats {
+	uint64_t			read_hits;
+	uint64_t			read_partial_hits;
+	uint64_t			read_misses;
+	uint64_t			write_hits;
+	uint64_t			write_misses;
+	uint64_t			write_around;
+	uint64_t			bypassed;
+	uint64_t			fills;
+	uint64_t			evictions;
+	uint64_t			destage_ios;
+	uint64_t			destaged_blocks;
+};
+
+struct cache_stream {
+	uint64_t			next;
+	uint64_t			blocks;
+	uint64_t			tick;
+};
+
+struct vbdev_cache {
+	struct spdk_bdev		bdev;
+	struct spdk_bdev		*base_bdev;
+	struct spdk_bdev_desc		*base_desc;
+	struct spdk_io_channel		*base_ch;
+	struct spdk_bdev		*cache_bdev;
+	struct spdk_bdev_desc		*cache_desc;
+	struct spdk_io_channel		*cache_ch;
+	/* The superblock and the line entries. Its thread owns all the state. */
+	struct spdk_vbdev_md		md;
+
+	enum vbdev_cache_policy		policy;
+	uint64_t			seq_cutoff;
+	uint32_t			block_size;
+	uint32_t			line_shift;
+	struct cache_geometry		geo;
+
+	/* geo.num_lines resident lines, followed by as many ghosts */
+	struct cache_line		*lines;
+	uint32_t			*hash;
+	uint64_t			hash_mask;
+	struct cache_line_list		lists[CACHE_LIST_COUNT];
+	uint64_t			list_len[CACHE_LIST_COUNT];
+	struct cache_line_list		free_ghosts;
+	/* ARC target size of T1 */
+	uint64_t			arc_p;
+	/* Dirty lines not being destaged, oldest first */
+	struct cache_line_list		dirty_lines;
+	uint64_t			num_dirty;
+
+	struct cache_fill		fills[CACHE_FILL_BUFS];
+	TAILQ_HEAD(, cache_fill)	free_fills;
+	/* Reads waiting for a buffer to merge dirty blocks from the cache */
+	TAILQ_HEAD(, vbdev_cache_io)	buf_waiters;
+
+	struct cache_destage		destages[CACHE_DESTAGE_CTXS];
+	TAILQ_HEAD(, cache_destage)	free_destages;
+	uint32_t			destages_outstanding;
+	struct spdk_poller		*destage_poller;
+	uint64_t			io_count;
+	uint64_t			last_io_count;
+	bool				alloc_failed;
+
+	struct cache_stream		streams[CACHE_STREAMS];
+	uint64_t			stream_tick;
+
+	/* Writes that go to the base bdev directly, for lines not in the cache */
+	TAILQ_HEAD(, vbdev_cache_io)	direct_ios;
+	/*
+	 * Bumped by every write to the base bdev. A read miss only fills the cache if
+	 * nothing was written to the base bdev while it was read.
+	 */
+	uint64_t			base_write_gen;
+
+	/* User I/O, fills and destages in progress */
+	uint64_t			outstanding;
+	bool				stopping;
+	bool				removing;
+	struct cache_stats		stats;
+
+	vbdev_cache_create_cb		create_cb;
+	void				*create_cb_arg;
+
+	TAILQ_ENTRY(vbdev_cache)	link;
+};
+
+struct vbdev_cache_io {
+	struct vbdev_cache		*cache;
+	struct cache_line		*line;
+	uint64_t			base_line;
+	uint32_t			first;
+	uint64_t			mask;
+	/* Blocks of a partial hit to read from the cache over the data of the base bdev */
+	uint64_t			overlay;
+	uint64_t			base_write_gen;
+	bool				sequential;
+	enum spdk_bdev_io_status	status;
+	struct cache_fill		*bounce;
+	struct spdk_vbdev_md_wait	md_wait;
+	struct spdk_bdev_io_wait_entry	bdev_io_wait;
+	TAILQ_ENTRY(vbdev_cache_io)	link;
+};
+
+struct cache_io_channel {
+	struct vbdev_cache		*cache;
+};
+
+static int vbdev_cache_init(void);
+static void vbdev_cache_finish(void);
+static int vbdev_cache_get_ctx_size(void);
+static int vbdev_cache_config_json(struct spdk_json_write_ctx *w);
+
+static struct spdk_bdev_module cache_if = {
+	.name = "cache",
+	.module_init = vbdev_cache_init,
+	.module_fini = vbdev_cache_finish,
+	.get_ctx_size = vbdev_cache_get_ctx_size,
+	.config_json = vbdev_cache_config_json,
+};
+
+SPDK_BDEV_MODULE_REGISTER(cache, &cache_if)
+
+static TAILQ_HEAD(, vbdev_cache) g_caches = TAILQ_HEAD_INITIALIZER(g_caches);
+
+static const char *g_policy_names[] = {
+	[VBDEV_CACHE_POLICY_LRU] = "lru",
+	[VBDEV_CACHE_POLICY_ARC] = "arc",
+};
+
+const char *
+vbdev_cache_policy_str(enum vbdev_cache_policy policy)
+{
+	if ((size_t)policy >= SPDK_COUNTOF(g_policy_names)) {
+		return NULL;
+	}
+
+	return g_policy_names[policy];
+}
+
+int
+vbdev_cache_policy_parse(const char *str, enum vbdev_cache_policy *policy)
+{
+	size_t i;
+
+	for (i = 0; i < SPDK_COUNTOF(g_policy_names); i++) {
+		if (strcmp(str, g_policy_names[i]) == 0) {
+			*policy = i;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static int
+cache_compute_geometry(uint64_t cache_blockcnt, uint32_t block_size, uint32_t line_blocks,
+		       struct cache_geometry *geo)
+{
+	uint64_t num_lines;
+
+	if (block_size <= sizeof(struct cache_md_hdr) + sizeof(struct cache_md_entry)) {
+		return -EINVAL;
+	}
+
+	geo->line_blocks = line_blocks;
+	geo->entries_per_page = (block_size - sizeof(struct cache_md_hdr)) /
+				sizeof(struct cache_md_entry);
+	geo->md_offset = 1;
+
+	if (cache_blockcnt <= geo->md_offset) {
+		return -ENOSPC;
+	}
+
+	num_lines = (cache_blockcnt - geo->md_offset) / line_blocks;
+	while (num_lines > 0) {
+		geo->md_blocks = spdk_divide_round_up(num_lines, geo->entries_per_page);
+		geo->data_offset = spdk_divide_round_up(geo->md_offset + geo->md_blocks,
+							line_blocks) * line_blocks;
+		if (geo->data_offset + num_lines * line_blocks <= cache_blockcnt) {
+			break;
+		}
+		num_lines--;
+	}
+
+	/* Lines and their ghosts are indexed with 32 bit numbers. */
+	if (num_lines == 0) {
+		return -ENOSPC;
+	}
+	geo->num_lines = spdk_min(num_lines, (uint64_t)(CACHE_NONE / 2));
+
+	return 0;
+}
+
+static inline uint64_t
+cache_mask(uint32_t first, uint32_t num_blocks)
+{
+	uint64_t mask = num_blocks >= 64 ? UINT64_MAX : (1ULL << num_blocks) - 1;
+
+	return mask << first;
+}
+
+static inline bool
+cache_line_is_resident(const struct cache_line *line)
+{
+	return line->list == CACHE_LIST_T1 || line->list == CACHE_LIST_T2;
+}
+
+static inline uint32_t
+cache_line_idx(const struct vbdev_cache *cache, const struct cache_line *line)
+{
+	return line - cache->lines;
+}
+
+static inline uint64_t
+cache_line_offset(const struct vbdev_cache *cache, const struct cache_line *line, uint32_t block)
+{
+	return cache->geo.data_offset +
+	       (uint64_t)cache_line_idx(cache, line) * cache->geo.line_blocks + block;
+}
+
+/* Hash of lines and ghosts by base line number */
+
+static inline uint64_t
+cache_hash_bucket(const struct vbdev_cache *cache, uint64_t base_line)
+{
+	return ((base_line * 0x9E3779B97F4A7C15ULL) >> 32) & cache->hash_mask;
+}
+
+static struct cache_line *
+cache_hash_find(struct vbdev_cache *cache, uint64_t base_line)
+{
+	uint32_t idx = cache->hash[cache_hash_bucket(cache, base_line)];
+
+	while (idx != CACHE_NONE) {
+		if (cache->lines[idx].base_line == base_line) {
+			return &cache->lines[idx];
+		}
+		idx = cache->lines[idx].hash_next;
+	}
+
+	return NULL;
+}
+
+static void
+cache_hash_insert(struct vbdev_cache *cache, struct cache_line *line)
+{
+	uint64_t bucket = cache_hash_bucket(cache, line->base_line);
+
+	line->hash_next = cache->hash[bucket];
+	cache->hash[bucket] = cache_line_idx(cache, line);
+}
+
+static void
+cache_hash_remove(struct vbdev_cache *cache, struct cache_line *line)
+{
+	uint32_t *idx = &cache->hash[cache_hash_bucket(cache, line->base_line)];
+	uint32_t line_idx = cache_line_idx(cache, line);
+
+	while (*idx != line_idx) {
+		assert(*idx != CACHE_NONE);
+		idx = &cache->lines[*idx].hash_next;
+	}
+	*idx = line->hash_next;
+	line->hash_next = CACHE_NONE;
+}
+
+static struct cache_line *
+cache_find_resident(struct vbdev_cache *cache, uint64_t base_line)
+{
+	struct cache_line *line = cache_hash_find(cache, base_line);
+
+	return (line != NULL && cache_line_is_resident(line)) ? line : NULL;
+}
+
+/* Replacement policies. The tail of a list is its most recently used end. */
+
+static void
+cache_list_add(struct vbdev_cache *cache, struct cache_line *line, enum cache_list list)
+{
+	line->list = list;
+	TAILQ_INSERT_TAIL(&cache->lists[list], line, link);
+	cache->list_len[list]++;
+}
+
+static void
+cache_list_remove(struct vbdev_cache *cache, struct cache_line *line)
+{
+	TAILQ_REMOVE(&cache->lists[line->list], line, link);
+	cache->list_len[line->list]--;
+}
+
+static inline bool
+cache_line_evictable(const struct cache_line *line)
+{
+	return line->refcnt == 0 && line->dirty == 0 && line->md_dirty == 0 &&
+	       TAILQ_EMPTY(&line->waiters);
+}
+
+static struct cache_line *
+cache_find_victim(struct vbdev_cache *cache, enum cache_list list)
+{
+	struct cache_line *line;
+	int scanned = 0;
+
+	TAILQ_FOREACH(line, &cache->lists[list], link) {
+		if (cache_line_evictable(line)) {
+			return line;
+		}
+		if (++scanned == CACHE_EVICT_SCAN) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+cache_drop_ghost(struct vbdev_cache *cache, struct cache_line *ghost)
+{
+	cache_hash_remove(cache, ghost);
+	cache_list_remove(cache, ghost);
+	ghost->list = CACHE_LIST_FREE;
+	TAILQ_INSERT_TAIL(&cache->free_ghosts, ghost, link);
+}
+
+/* Take a line out of the cache. With ARC, its base line is remembered in a ghost list. */
+static void
+cache_evict(struct vbdev_cache *cache, struct cache_line *line, enum cache_list ghost_list)
+{
+	struct cache_line *ghost;
+
+	assert(cache_line_evictable(line));
+
+	cache_hash_remove(cache, line);
+	cache_list_remove(cache, line);
+	cache->stats.evictions++;
+
+	if (ghost_list == CACHE_LIST_FREE) {
+		return;
+	}
+
+	ghost = TAILQ_FIRST(&cache->free_ghosts);
+	if (ghost == NULL) {
+		ghost = TAILQ_FIRST(&cache->lists[CACHE_LIST_B2]);
+		if (ghost == NULL) {
+			ghost = TAILQ_FIRST(&cache->lists[CACHE_LIST_B1]);
+		}
+		assert(ghost != NULL);
+		cache_drop_ghost(cache, ghost);
+	}
+
+	TAILQ_REMOVE(&cache->free_ghosts, ghost, link);
+	ghost->base_line = line->base_line;
+	cache_hash_insert(cache, ghost);
+	cache_list_add(cache, ghost, ghost_list);
+}
+
+/* ARC's REPLACE: evict from T1 or T2 depending on the target size of T1. */
+static struct cache_line *
+cache_arc_replace(struct vbdev_cache *cache, bool in_b2)
+{
+	uint64_t t1 = cache->list_len[CACHE_LIST_T1];
+	struct cache_line *victim;
+
+	if (t1 > 0 && (t1 > cache->arc_p || (in_b2 && t1 == cache->arc_p))) {
+		victim = cache_find_victim(cache, CACHE_LIST_T1);
+		if (victim != NULL) {
+			cache_evict(cache, victim, CACHE_LIST_B1);
+			return victim;
+		}
+	}
+
+	victim = cache_find_victim(cache, CACHE_LIST_T2);
+	if (victim != NULL) {
+		cache_evict(cache, victim, CACHE_LIST_B2);
+		return victim;
+	}
+
+	victim = cache_find_victim(cache, CACHE_LIST_T1);
+	if (victim != NULL) {
+		cache_evict(cache, victim, CACHE_LIST_B1);
+	}
+
+	return victim;
+}
+
+/*
+ * Find a line to cache base_line in, evicting another one if needed. Returns NULL if
+ * all lines are dirty or busy.
+ */
+static struct cache_line *
+cache_policy_alloc(struct vbdev_cache *cache, uint64_t base_line)
+{
+	uint64_t c = cache->geo.num_lines;
+	uint64_t *len = cache->list_len;
+	struct cache_line *line, *ghost;
+	enum cache_list target = CACHE_LIST_T1;
+	bool in_b2 = false, evict_t1 = false;
+
+	if (cache->policy == VBDEV_CACHE_POLICY_ARC) {
+		ghost = cache_hash_find(cache, base_line);
+		assert(ghost == NULL || !cache_line_is_resident(ghost));
+
+		if (ghost != NULL && ghost->list == CACHE_LIST_B1) {
+			uint64_t delta = spdk_max(1, len[CACHE_LIST_B2] / len[CACHE_LIST_B1]);
+
+			cache->arc_p = spdk_min(c, cache->arc_p + delta);
+			cache_drop_ghost(cache, ghost);
+			target = CACHE_LIST_T2;
+		} else if (ghost != NULL && ghost->list == CACHE_LIST_B2) {
+			uint64_t delta = spdk_max(1, len[CACHE_LIST_B1] / len[CACHE_LIST_B2]);
+
+			cache->arc_p = cache->arc_p > delta ? cache->arc_p - delta : 0;
+			cache_drop_ghost(cache, ghost);
+			target = CACHE_LIST_T2;
+			in_b2 = true;
+		} else if (len[CACHE_LIST_T1] + len[CACHE_LIST_B1] >= c) {
+			if (len[CACHE_LIST_T1] < c && len[CACHE_LIST_B1] > 0) {
+				cache_drop_ghost(cache, TAILQ_FIRST(&cache->lists[CACHE_LIST_B1]));
+			} else {
+				evict_t1 = true;
+			}
+		} else if (len[CACHE_LIST_T1] + len[CACHE_LIST_T2] + len[CACHE_LIST_B1] +
+			   len[CACHE_LIST_B2] >= 2 * c && len[CACHE_LIST_B2] > 0) {
+			cache_drop_ghost(cache, TAILQ_FIRST(&cache->lists[CACHE_LIST_B2]));
+		}
+	}
+
+	line = TAILQ_FIRST(&cache->lists[CACHE_LIST_FREE]);
+	if (line != NULL) {
+		cache_list_remove(cache, line);
+	} else if (cache->policy == VBDEV_CACHE_POLICY_LRU || evict_t1) {
+		line = cache_find_victim(cache, CACHE_LIST_T1);
+		if (line == NULL && cache->policy == VBDEV_CACHE_POLICY_ARC) {
+			line = cache_arc_replace(cache, false);
+		} else if (line != NULL) {
+			cache_evict(cache, line, CACHE_LIST_FREE);
+		}
+	} else {
+		line = cache_arc_replace(cache, in_b2);
+	}
+
+	if (line == NULL) {
+		cache->alloc_failed = true;
+		return NULL;
+	}
+
+	line->base_line = base_line;
+	line->valid = 0;
+	line->dirty = 0;
+	assert(line->md_dirty == 0);
+	cache_hash_insert(cache, line);
+	cache_list_add(cache, line, target);
+
+	return line;
+}
+
+static void
+cache_policy_hit(struct vbdev_cache *cache, struct cache_line *line)
+{
+	cache_list_remove(cache, line);
+	cache_list_add(cache, line, cache->policy == VBDEV_CACHE_POLICY_ARC ? CACHE_LIST_T2 :
+		       CACHE_LIST_T1);
+}
+
+/*
+ * Track up to CACHE_STREAMS sequential streams. Returns true once the stream the
+ * I/O belongs to is longer than the sequential cutoff.
+ */
+static bool
+cache_stream_update(struct vbdev_cache *cache, uint64_t offset_blocks, uint64_t num_blocks)
+{
+	struct cache_stream *stream, *lru = &cache->streams[0];
+	uint64_t tick = ++cache->stream_tick;
+	int i;
+
+	if (cache->seq_cutoff == 0) {
+		return false;
+	}
+
+	for (i = 0; i < CACHE_STREAMS; i++) {
+		stream = &cache->streams[i];
+		if (stream->blocks != 0 && stream->next == offset_blocks) {
+			stream->next += num_blocks;
+			stream->blocks += num_blocks;
+			stream->tick = tick;
+			return stream->blocks * cache->block_size > cache->seq_cutoff;
+		}
+		if (stream->tick < lru->tick) {
+			lru = stream;
+		}
+	}
+
+	lru->next = offset_blocks + num_blocks;
+	lru->blocks = num_blocks;
+	lru->tick = tick;
+
+	return false;
+}
+
+static void
+cache_dirty_list_add(struct vbdev_cache *cache, struct cache_line *line)
+{
+	assert(!line->on_dirty_list);
+	TAILQ_INSERT_TAIL(&cache->dirty_lines, line, dirty_link);
+	line->on_dirty_list = true;
+}
+
+static void
+cache_dirty_list_remove(struct vbdev_cache *cache, struct cache_line *line)
+{
+	assert(line->on_dirty_list);
+	TAILQ_REMOVE(&cache->dirty_lines, line, dirty_link);
+	line->on_dirty_list = false;
+}
+
+static void
+cache_queue_retry(struct vbdev_cache *cache, bool on_cache_bdev,
+		  struct spdk_bdev_io_wait_entry *wait, spdk_bdev_io_wait_cb cb_fn, void *cb_arg)
+{
+	int rc;
+
+	wait->bdev = on_cache_bdev ? cache->cache_bdev : cache->base_bdev;
+	wait->cb_fn = cb_fn;
+	wait->cb_arg = cb_arg;
+
+	rc = spdk_bdev_queue_io_wait(wait->bdev, on_cache_bdev ? cache->cache_ch : cache->base_ch,
+				     wait);
+	if (rc != 0) {
+		SPDK_ERRLOG("Could not queue I/O to %s: %d\n", spdk_bdev_get_name(wait->bdev), rc);
+		assert(false);
+	}
+}
+
+/* Metadata pages */
+
+static void
+cache_md_serialize_page(void *ctx, uint64_t page_idx, void *buf)
+{
+	struct vbdev_cache *cache = ctx;
+	struct cache_md_hdr *hdr = buf;
+	struct cache_md_entry *entry = (struct cache_md_entry *)(hdr + 1);
+	uint64_t idx = page_idx * cache->geo.entries_per_page;
+	uint64_t end = spdk_min(idx + cache->geo.entries_per_page, cache->geo.num_lines);
+	struct cache_line *line;
+
+	memset(buf, 0, cache->block_size);
+
+	for (; idx < end; idx++, entry++) {
+		line = &cache->lines[idx];
+		if (cache_line_is_resident(line)) {
+			entry->base_line = line->base_line + 1;
+			entry->valid = line->valid;
+			entry->dirty = line->dirty;
+		}
+		line->md_snap = entry->dirty;
+	}
+
+	hdr->crc = spdk_crc32c_update(buf, cache->block_size, 0);
+}
+
+/* The dirty bits of the entries written are now on the cache bdev. */
+static void
+cache_md_page_written(void *ctx, uint64_t page_idx)
+{
+	struct vbdev_cache *cache = ctx;
+	uint64_t idx = page_idx * cache->geo.entries_per_page;
+	uint64_t end = spdk_min(idx + cache->geo.entries_per_page, cache->geo.num_lines);
+
+	for (; idx < end; idx++) {
+		cache->lines[idx].md_dirty = cache->lines[idx].md_snap;
+	}
+}
+
+/* Persist the metadata entry of a line, then call wait->cb_fn. */
+static void
+cache_md_update(struct vbdev_cache *cache, struct cache_line *line,
+		struct spdk_vbdev_md_wait *wait)
+{
+	spdk_vbdev_md_update(&cache->md, cache_line_idx(cache, line) / cache->geo.entries_per_page,
+			     wait);
+}
+
+/* Copying between iovecs and buffers */
+
+static void
+cache_iovs_to_buf(struct iovec *iovs, int iovcnt, void *buf, size_t len)
+{
+	size_t n;
+	int i;
+
+	for (i = 0; i < iovcnt && len > 0; i++) {
+		n = spdk_min(len, iovs[i].iov_len);
+		memcpy(buf, iovs[i].iov_base, n);
+		buf = (uint8_t *)buf + n;
+		len -= n;
+	}
+}
+
+static void
+cache_buf_to_iovs(struct iovec *iovs, int iovcnt, size_t offset, const void *buf, size_t len)
+{
+	size_t n;
+	int i;
+
+	for (i = 0; i < iovcnt && len > 0; i++) {
+		if (offset >= iovs[i].iov_len) {
+			offset -= iovs[i].iov_len;
+			continue;
+		}
+		n = spdk_min(len, iovs[i].iov_len - offset);
+		memcpy((uint8_t *)iovs[i].iov_base + offset, buf, n);
+		buf = (const uint8_t *)buf + n;
+		len -= n;
+		offset = 0;
+	}
+}
+
+/* User I/O */
+
+static void
+_cache_complete_io(void *arg)
+{
+	struct spdk_bdev_io *bdev_io = arg;
+	struct vbdev_cache_io *io = (struct vbdev_cache_io *)bdev_io->driver_ctx;
+
+	spdk_bdev_io_complete(bdev_io, io->status);
+}
+
+static void
+cache_io_complete(struct vbdev_cache_io *io, enum spdk_bdev_io_status status)
+{
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(io);
+	struct spdk_thread *thread = spdk_bdev_io_get_thread(bdev_io);
+
+	io->cache->outstanding--;
+	io->status = status;
+
+	if (thread != spdk_get_thread()) {
+		spdk_thread_send_msg(thread, _cache_complete_io, bdev_io);
+	} else {
+		_cache_complete_io(bdev_io);
+	}
+}
+
+static void
+cache_io_finish(struct vbdev_cache_io *io, enum spdk_bdev_io_status status)
+{
+	if (io->line != NULL) {
+		io->line->refcnt--;
+		io->line = NULL;
+	}
+
+	cache_io_complete(io, status);
+}
+
+static void cache_fill_buf_put(struct vbdev_cache *cache, struct cache_fill *fill);
+
+static void
+cache_read_hit_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct vbdev_cache_io *io = cb_arg;
+
+	spdk_bdev_free_io(bdev_io);
+	cache_io_finish(io, success ? SPDK_BDEV_IO_STATUS_SUCCESS : SPDK_BDEV_IO_STATUS_FAILED);
+}
+
+static void
+cache_read_hit_submit(void *arg)
+{
+	struct vbdev_cache_io *io = arg;
+	struct vbdev_cache *cache = io->cache;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(io);
+	int rc;
+
+	rc = spdk_bdev_readv_blocks(cache->cache_desc, cache->cache_ch, bdev_io->u.bdev.iovs,
+				    bdev_io->u.bdev.iovcnt,
+				    cache_line_offset(cache, io->line, io->first),
+				    bdev_io->u.bdev.num_blocks, cache_read_hit_done, io);
+	if (rc == -ENOMEM) {
+		cache_queue_retry(cache, true, &io->bdev_io_wait, cache_read_hit_submit, io);
+	} else if (rc != 0) {
+		cache_io_finish(io, SPDK_BDEV_IO_STATUS_FAILED);
+	}
+}
+
+static void
+cache_read_overlay_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct vbdev_cache_io *io = cb_arg;
+	struct vbdev_cache *cache = io->cache;
+	struct spdk_bdev_io *orig_io = spdk_bdev_io_from_ctx(io);
+	uint32_t lo = __builtin_ctzll(io->overlay);
+	uint32_t block, end;
+
+	spdk_bdev_free_io(bdev_io);
+
+	if (success) {
+		/* Copy every run of dirty blocks over the data read from the base bdev. */
+		for (block = lo; block < 64; block = end) {
+			if (!(io->overlay & (1ULL << block))) {
+				end = block + 1;
+				continue;
+			}
+			for (end = block; end < 64 && (io->overlay & (1ULL << end)); end++) {
+			}
+			cache_buf_to_iovs(orig_io->u.bdev.iovs, orig_io->u.bdev.iovcnt,
+					  (size_t)(block - io->first) * cache->block_size,
+					  (uint8_t *)io->bounce->buf +
+					  (size_t)(block - lo) * cache->block_size,
+					  (size_t)(end - block) * cache->block_size);
+		}
+	}
+
+	cache_fill_buf_put(cache, io->bounce);
+	io->bounce = NULL;
+	cache_io_finish(io, success ? SPDK_BDEV_IO_STATUS_SUCCESS : SPDK_BDEV_IO_STATUS_FAILED);
+}
+
+static void
+cache_read_overlay_submit(void *arg)
+{
+	struct vbdev_cache_io *io = arg;
+	struct vbdev_cache *cache = io->cache;
+	uint32_t lo = __builtin_ctzll(io->overlay);
+	uint32_t hi = 63 - __builtin_clzll(io->overlay);
+	int rc;
+
+	rc = spdk_bdev_read_blocks(cache->cache_desc, cache->cache_ch, io->bounce->buf,
+				   cache_line_offset(cache, io->line, lo), hi - lo + 1,
+				   cache_read_overlay_done, io);
+	if (rc == -ENOMEM) {
+		cache_queue_retry(cache, true, &io->bdev_io_wait, cache_read_overlay_submit, io);
+	} else if (rc != 0) {
+		cache_fill_buf_put(cache, io->bounce);
+		io->bounce = NULL;
+		cache_io_finish(io, SPDK_BDEV_IO_STATUS_FAILED);
+	}
+}
+
+static void
+cache_read_overlay(struct vbdev_cache_io *io)
+{
+	struct vbdev_cache *cache = io->cache;
+
+	io->bounce = TAILQ_FIRST(&cache->free_fills);
+	if (io->bounce == NULL) {
+		TAILQ_INSERT_TAIL(&cache->buf_waiters, io, link);
+		return;
+	}
+
+	TAILQ_REMOVE(&cache->free_fills, io->bounce, link);
+	cache_read_overlay_submit(io);
+}
+
+static void cache_write_line(struct vbdev_cache_io *io);
+
+static void
+cache_fill_buf_put(struct vbdev_cache *cache, struct cache_fill *fill)
+{
+	struct vbdev_cache_io *io;
+
+	TAILQ_INSERT_HEAD(&cache->free_fills, fill, link);
+
+	io = TAILQ_FIRST(&cache->buf_waiters);
+	if (io != NULL) {
+		TAILQ_REMOVE(&cache->buf_waiters, io, link);
+		cache_read_overlay(io);
+	}
+}
+
+static void
+cache_fill_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct cache_fill *fill = cb_arg;
+	struct vbdev_cache *cache = fill->cache;
+	struct cache_line *line = fill->line;
+	TAILQ_HEAD(, vbdev_cache_io) waiters = TAILQ_HEAD_INITIALIZER(waiters);
+	struct vbdev_cache_io *io;
+
+	spdk_bdev_free_io(bdev_io);
+
+	line->fill_mask &= ~fill->mask;
+	if (success) {
+		line->valid |= fill->mask;
+	}
+	line->refcnt--;
+	cache->outstanding--;
+	cache_fill_buf_put(cache, fill);
+
+	TAILQ_CONCAT(&waiters, &line->waiters, link);
+	while ((io = TAILQ_FIRST(&waiters))) {
+		TAILQ_REMOVE(&waiters, io, link);
+		cache_write_line(io);
+	}
+}
+
+static void
+cache_fill_submit(void *arg)
+{
+	struct cache_fill *fill = arg;
+	struct vbdev_cache *cache = fill->cache;
+	int rc;
+
+	rc = spdk_bdev_write_blocks(cache->cache_desc, cache->cache_ch, fill->buf,
+				    cache_line_offset(cache, fill->line, fill->first),
+				    fill->num_blocks, cache_fill_done, fill);
+	if (rc == -ENOMEM) {
+		cache_queue_retry(cache, true, &fill->bdev_io_wait, cache_fill_submit, fill);
+	} else if (rc != 0) {
+		struct cache_line *line = fill->line;
+
+		line->fill_mask &= ~fill->mask;
+		line->refcnt--;
+		cache->outstanding--;
+		cache_fill_buf_put(cache, fill);
+	}
+}
+
+static bool
+cache_direct_in_progress(struct vbdev_cache *cache, uint64_t base_line)
+{
+	struct vbdev_cache_io *io;
+
+	TAILQ_FOREACH(io, &cache->direct_ios, link) {
+		if (io->base_line == base_line) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Copy the data of a read miss into the cache. This is best effort and skipped
+ * whenever it could race with a write of the same blocks.
+ */
+static void
+cache_fill(struct vbdev_cache_io *io)
+{
+	struct vbdev_cache *cache = io->cache;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(io);
+	struct cache_fill *fill;
+	struct cache_line *line;
+
+	if (cache->stopping || io->base_write_gen != cache->base_write_gen ||
+	    cache_direct_in_progress(cache, io->base_line)) {
+		return;
+	}
+
+	fill = TAILQ_FIRST(&cache->free_fills);
+	if (fill == NULL) {
+		return;
+	}
+
+	line = cache_find_resident(cache, io->base_line);
+	if (line != NULL) {
+		if (((line->dirty | line->fill_mask) & io->mask) || line->writes > 0) {
+			return;
+		}
+	} else {
+		line = cache_policy_alloc(cache, io->base_line);
+		if (line == NULL) {
+			return;
+		}
+	}
+
+	TAILQ_REMOVE(&cache->free_fills, fill, link);
+	fill->line = line;
+	fill->mask = io->mask;
+	fill->first = io->first;
+	fill->num_blocks = bdev_io->u.bdev.num_blocks;
+	cache_iovs_to_buf(bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt, fill->buf,
+			  (size_t)fill->num_blocks * cache->block_size);
+
+	line->fill_mask |= fill->mask;
+	line->refcnt++;
+	cache->outstanding++;
+	cache->stats.fills++;
+	cache_fill_submit(fill);
+}
+
+static void
+cache_read_base_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct vbdev_cache_io *io = cb_arg;
+
+	spdk_bdev_free_io(bdev_io);
+
+	if (!success) {
+		cache_io_finish(io, SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
+	if (io->line != NULL) {
+		/*
+		 * Valid blocks in the cache are never older than those on the base bdev, which
+		 * may have been written by a destage since it was read.
+		 */
+		io->overlay |= io->line->valid & io->mask;
+		cache_read_overlay(io);
+		return;
+	}
+
+	if (!io->sequential) {
+		cache_fill(io);
+	}
+	cache_io_finish(io, SPDK_BDEV_IO_STATUS_SUCCESS);
+}
+
+static void
+cache_read_base_submit(void *arg)
+{
+	struct vbdev_cache_io *io = arg;
+	struct vbdev_cache *cache = io->cache;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(io);
+	int rc;
+
+	rc = spdk_bdev_readv_blocks(cache->base_desc, cache->base_ch, bdev_io->u.bdev.iovs,
+				    bdev_io->u.bdev.iovcnt, bdev_io->u.bdev.offset_blocks,
+				    bdev_io->u.bdev.num_blocks, cache_read_base_done, io);
+	if (rc == -ENOMEM) {
+		cache_queue_retry(cache, false, &io->bdev_io_wait, cache_read_base_submit, io);
+	} else if (rc != 0) {
+		cache_io_finish(io, SPDK_BDEV_IO_STATUS_FAILED);
+	}
+}
+
+static void
+cache_read(struct vbdev_cache_io *io)
+{
+	struct vbdev_cache *cache = io->cache;
+	struct cache_line *line;
+
+	line = cache_find_resident(cache, io->base_line);
+	if (line != NULL && (line->valid & io->mask) == io->mask) {
+		cache->stats.read_hits++;
+		cache_policy_hit(cache, line);
+		line->refcnt++;
+		io->line = line;
+		cache_read_hit_submit(io);
+		return;
+	}
+
+	if (line != NULL && (line->dirty & io->mask)) {
+		/* Read the base bdev and put the dirty blocks from the cache over it. */
+		cache->stats.read_partial_hits++;
+		cache_policy_hit(cache, line);
+		line->refcnt++;
+		io->line = line;
+		io->overlay = line->dirty & io->mask;
+		cache_read_base_submit(io);
+		return;
+	}
+
+	cache->stats.read_misses++;
+	if (io->sequential) {
+		cache->stats.bypassed++;
+	}
+	io->base_write_gen = cache->base_write_gen;
+	cache_read_base_submit(io);
+}
+
+static void
+cache_write_md_done(void *ctx, int status)
+{
+	struct vbdev_cache_io *io = ctx;
+
+	cache_io_finish(io, status == 0 ? SPDK_BDEV_IO_STATUS_SUCCESS : SPDK_BDEV_IO_STATUS_FAILED);
+}
+
+static void
+cache_write_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct vbdev_cache_io *io = cb_arg;
+	struct vbdev_cache *cache = io->cache;
+	struct cache_line *line = io->line;
+
+	spdk_bdev_free_io(bdev_io);
+
+	line->writes--;
+	if (!success) {
+		/* Clean blocks are read from the base bdev again, dirty ones are lost. */
+		line->valid &= ~io->mask | line->dirty;
+		cache_io_finish(io, SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
+	line->valid |= io->mask;
+	if (line->destage_mask != 0) {
+		line->redirty |= io->mask;
+	}
+	if (line->dirty == 0) {
+		cache->num_dirty++;
+	}
+	line->dirty |= io->mask;
+	if (!line->on_dirty_list && line->destage_mask == 0) {
+		cache_dirty_list_add(cache, line);
+	}
+
+	if ((io->mask & ~line->md_dirty) == 0) {
+		/* The blocks are already dirty in the metadata. */
+		cache_io_finish(io, SPDK_BDEV_IO_STATUS_SUCCESS);
+		return;
+	}
+
+	io->md_wait.cb_fn = cache_write_md_done;
+	io->md_wait.ctx = io;
+	cache_md_update(cache, line, &io->md_wait);
+}
+
+static void
+cache_write_submit(void *arg)
+{
+	struct vbdev_cache_io *io = arg;
+	struct vbdev_cache *cache = io->cache;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(io);
+	int rc;
+
+	rc = spdk_bdev_writev_blocks(cache->cache_desc, cache->cache_ch, bdev_io->u.bdev.iovs,
+				     bdev_io->u.bdev.iovcnt,
+				     cache_line_offset(cache, io->line, io->first),
+				     bdev_io->u.bdev.num_blocks, cache_write_done, io);
+	if (rc == -ENOMEM) {
+		cache_queue_retry(cache, true, &io->bdev_io_wait, cache_write_submit, io);
+	} else if (rc != 0) {
+		io->line->writes--;
+		cache_io_finish(io, SPDK_BDEV_IO_STATUS_FAILED);
+	}
+}
+
+static void
+cache_write_line(struct vbdev_cache_io *io)
+{
+	struct cache_line *line = io->line;
+
+	if (line->fill_mask & io->mask) {
+		TAILQ_INSERT_TAIL(&line->waiters, io, link);
+		return;
+	}
+
+	line->writes++;
+	cache_write_submit(io);
+}
+
+static void
+cache_write_direct_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct vbdev_cache_io *io = cb_arg;
+
+	spdk_bdev_free_io(bdev_io);
+
+	TAILQ_REMOVE(&io->cache->direct_ios, io, link);
+	cache_io_finish(io, success ? SPDK_BDEV_IO_STATUS_SUCCESS : SPDK_BDEV_IO_STATUS_FAILED);
+}
+
+static void
+cache_write_direct_submit(void *arg)
+{
+	struct vbdev_cache_io *io = arg;
+	struct vbdev_cache *cache = io->cache;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(io);
+	int rc;
+
+	rc = spdk_bdev_writev_blocks(cache->base_desc, cache->base_ch, bdev_io->u.bdev.iovs,
+				     bdev_io->u.bdev.iovcnt, bdev_io->u.bdev.offset_blocks,
+				     bdev_io->u.bdev.num_blocks, cache_write_direct_done, io);
+	if (rc == -ENOMEM) {
+		cache_queue_retry(cache, false, &io->bdev_io_wait, cache_write_direct_submit, io);
+	} else if (rc != 0) {
+		TAILQ_REMOVE(&cache->direct_ios, io, link);
+		cache_io_finish(io, SPDK_BDEV_IO_STATUS_FAILED);
+	}
+}
+
+/* Write a line that is not in the cache to the base bdev. */
+static void
+cache_write_direct(struct vbdev_cache_io *io)
+{
+	struct vbdev_cache *cache = io->cache;
+
+	cache->base_write_gen++;
+	TAILQ_INSERT_TAIL(&cache->direct_ios, io, link);
+	cache_write_direct_submit(io);
+}
+
+static void
+cache_write(struct vbdev_cache_io *io)
+{
+	struct vbdev_cache *cache = io->cache;
+	struct cache_line *line;
+
+	line = cache_find_resident(cache, io->base_line);
+	if (line != NULL) {
+		cache->stats.write_hits++;
+		cache_policy_hit(cache, line);
+	} else if (io->sequential) {
+		cache->stats.bypassed++;
+		cache_write_direct(io);
+		return;
+	} else {
+		/* Writes to the base bdev in progress would overtake a later destage. */
+		if (!cache_direct_in_progress(cache, io->base_line)) {
+			line = cache_policy_alloc(cache, io->base_line);
+		}
+		if (line == NULL) {
+			cache->stats.write_around++;
+			cache_write_direct(io);
+			return;
+		}
+		cache->stats.write_misses++;
+	}
+
+	line->refcnt++;
+	io->line = line;
+	cache_write_line(io);
+}
+
+static void
+cache_flush_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg);
+
+static void
+cache_flush_submit(void *arg)
+{
+	struct vbdev_cache_io *io = arg;
+	struct vbdev_cache *cache = io->cache;
+	bool on_cache_bdev = io->mask != 0;
+	struct spdk_bdev_desc *desc = on_cache_bdev ? cache->cache_desc : cache->base_desc;
+	struct spdk_io_channel *ch = on_cache_bdev ? cache->cache_ch : cache->base_ch;
+	int rc;
+
+	if (!spdk_bdev_io_type_supported(spdk_bdev_desc_get_bdev(desc), SPDK_BDEV_IO_TYPE_FLUSH)) {
+		cache_flush_done(NULL, true, io);
+		return;
+	}
+
+	rc = spdk_bdev_flush_blocks(desc, ch, 0,
+				    spdk_bdev_get_num_blocks(spdk_bdev_desc_get_bdev(desc)),
+				    cache_flush_done, io);
+	if (rc == -ENOMEM) {
+		cache_queue_retry(cache, on_cache_bdev, &io->bdev_io_wait, cache_flush_submit, io);
+	} else if (rc != 0) {
+		cache_io_finish(io, SPDK_BDEV_IO_STATUS_FAILED);
+	}
+}
+
+/* A flush goes to the cache bdev first (mask set), then to the base bdev. */
+static void
+cache_flush_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct vbdev_cache_io *io = cb_arg;
+
+	if (bdev_io != NULL) {
+		spdk_bdev_free_io(bdev_io);
+	}
+
+	if (!success || io->mask == 0) {
+		cache_io_finish(io, success ? SPDK_BDEV_IO_STATUS_SUCCESS :
+				SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
+	io->mask = 0;
+	cache_flush_submit(io);
+}
+
+static void
+_cache_submit_io(void *arg)
+{
+	struct spdk_bdev_io *bdev_io = arg;
+	struct vbdev_cache_io *io = (struct vbdev_cache_io *)bdev_io->driver_ctx;
+	struct vbdev_cache *cache = io->cache;
+	uint32_t line_blocks = cache->geo.line_blocks;
+
+	cache->outstanding++;
+	cache->io_count++;
+
+	switch (bdev_io->type) {
+	case SPDK_BDEV_IO_TYPE_READ:
+	case SPDK_BDEV_IO_TYPE_WRITE:
+		/* The bdev layer splits I/O on line boundaries. */
+		io->base_line = bdev_io->u.bdev.offset_blocks >> cache->line_shift;
+		io->first = bdev_io->u.bdev.offset_blocks & (line_blocks - 1);
+		assert(io->first + bdev_io->u.bdev.num_blocks <= line_blocks);
+		io->mask = cache_mask(io->first, bdev_io->u.bdev.num_blocks);
+		io->sequential = cache_stream_update(cache, bdev_io->u.bdev.offset_blocks,
+						     bdev_io->u.bdev.num_blocks);
+		if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ) {
+			cache_read(io);
+		} else {
+			cache_write(io);
+		}
+		break;
+	case SPDK_BDEV_IO_TYPE_FLUSH:
+		io->mask = 1;
+		cache_flush_submit(io);
+		break;
+	default:
+		SPDK_ERRLOG("cache: unknown I/O type %d\n", bdev_io->type);
+		cache_io_complete(io, SPDK_BDEV_IO_STATUS_FAILED);
+		break;
+	}
+}
+
+static void
+cache_read_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io, bool success)
+{
+	struct vbdev_cache_io *io = (struct vbdev_cache_io *)bdev_io->driver_ctx;
+
+	if (!success) {
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
+	spdk_vbdev_md_call(&io->cache->md, _cache_submit_io, bdev_io);
+}
+
+static void
+vbdev_cache_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+{
+	struct vbdev_cache *cache = SPDK_CONTAINEROF(bdev_io->bdev, struct vbdev_cache, bdev);
+	struct vbdev_cache_io *io = (struct vbdev_cache_io *)bdev_io->driver_ctx;
+
+	memset(io, 0, sizeof(*io));
+	io->cache = cache;
+
+	if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ) {
+		spdk_bdev_io_get_buf(bdev_io, cache_read_get_buf_cb,
+				     bdev_io->u.bdev.num_blocks * bdev_io->bdev->blocklen);
+		return;
+	}
+
+	spdk_vbdev_md_call(&cache->md, _cache_submit_io, bdev_io);
+}
+
+static bool
+vbdev_cache_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type)
+{
+	switch (io_type) {
+	case SPDK_BDEV_IO_TYPE_READ:
+	case SPDK_BDEV_IO_TYPE_WRITE:
+	case SPDK_BDEV_IO_TYPE_FLUSH:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Destaging */
+
+static void
+cache_destage_release(struct cache_destage *destage)
+{
+	struct vbdev_cache *cache = destage->cache;
+	uint32_t i;
+
+	for (i = 0; i < destage->num_segs; i++) {
+		destage->segs[i].line->refcnt--;
+	}
+
+	cache->outstanding--;
+	cache->destages_outstanding--;
+	TAILQ_INSERT_TAIL(&cache->free_destages, destage, link);
+}
+
+static void
+cache_destage_md_done(void *ctx, int status)
+{
+	struct cache_destage_seg *seg = ctx;
+	struct cache_destage *destage = seg->destage;
+
+	if (--destage->outstanding == 0) {
+		cache_destage_release(destage);
+	}
+}
+
+static void
+cache_destage_write_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct cache_destage *destage = cb_arg;
+	struct vbdev_cache *cache = destage->cache;
+	struct cache_destage_seg *seg;
+	struct cache_line *line;
+	uint64_t cleared;
+	uint32_t i;
+
+	if (bdev_io != NULL) {
+		spdk_bdev_free_io(bdev_io);
+	}
+
+	if (!success) {
+		SPDK_ERRLOG("Destaging %u blocks of %s failed\n", destage->num_blocks,
+			    cache->bdev.name);
+	} else {
+		cache->stats.destage_ios++;
+		cache->stats.destaged_blocks += destage->num_blocks;
+		cache->base_write_gen++;
+	}
+
+	destage->outstanding = destage->num_segs;
+	for (i = 0; i < destage->num_segs; i++) {
+		seg = &destage->segs[i];
+		line = seg->line;
+
+		/* Blocks written while they were destaged stay dirty. */
+		cleared = success ? line->destage_mask & ~line->redirty : 0;
+		line->destage_mask = 0;
+		line->redirty = 0;
+		line->dirty &= ~cleared;
+		if (line->dirty == 0) {
+			cache->num_dirty--;
+		} else {
+			cache_dirty_list_add(cache, line);
+		}
+
+		if (cleared == 0) {
+			cache_destage_md_done(seg, 0);
+			continue;
+		}
+
+		seg->md_wait.cb_fn = cache_destage_md_done;
+		seg->md_wait.ctx = seg;
+		cache_md_update(cache, line, &seg->md_wait);
+	}
+}
+
+static void
+cache_destage_write_submit(void *arg)
+{
+	struct cache_destage *destage = arg;
+	struct vbdev_cache *cache = destage->cache;
+	struct cache_destage_seg *seg = &destage->segs[0];
+	int rc;
+
+	rc = spdk_bdev_write_blocks(cache->base_desc, cache->base_ch, destage->buf,
+				    (seg->line->base_line << cache->line_shift) + seg->first,
+				    destage->num_blocks, cache_destage_write_done, destage);
+	if (rc == -ENOMEM) {
+		cache_queue_retry(cache, false, &destage->bdev_io_wait, cache_destage_write_submit,
+				  destage);
+	} else if (rc != 0) {
+		cache_destage_write_done(NULL, false, destage);
+	}
+}
+
+static void
+cache_destage_read_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct cache_destage_seg *seg = cb_arg;
+	struct cache_destage *destage = seg->destage;
+
+	if (bdev_io != NULL) {
+		spdk_bdev_free_io(bdev_io);
+	}
+
+	if (!success) {
+		destage->failed = true;
+	}
+
+	if (--destage->outstanding > 0) {
+		return;
+	}
+
+	if (destage->failed) {
+		cache_destage_write_done(NULL, false, destage);
+		return;
+	}
+
+	cache_destage_write_submit(destage);
+}
+
+static void
+cache_destage_read_submit(void *arg)
+{
+	struct cache_destage_seg *seg = arg;
+	struct cache_destage *destage = seg->destage;
+	struct vbdev_cache *cache = destage->cache;
+	int rc;
+
+	rc = spdk_bdev_read_blocks(cache->cache_desc, cache->cache_ch,
+				   (uint8_t *)destage->buf +
+				   (size_t)seg->buf_offset * cache->block_size,
+				   cache_line_offset(cache, seg->line, seg->first), seg->num_blocks,
+				   cache_destage_read_done, seg);
+	if (rc == -ENOMEM) {
+		cache_queue_retry(cache, true, &seg->bdev_io_wait, cache_destage_read_submit, seg);
+	} else if (rc != 0) {
+		cache_destage_read_done(NULL, false, seg);
+	}
+}
+
+/* Add the first run of dirty blocks of a line to a destage. */
+static uint32_t
+cache_destage_add(struct cache_destage *destage, struct cache_line *line)
+{
+	struct vbdev_cache *cache = destage->cache;
+	struct cache_destage_seg *seg = &destage->segs[destage->num_segs++];
+	uint64_t run;
+
+	seg->destage = destage;
+	seg->line = line;
+	seg->first = __builtin_ctzll(line->dirty);
+	run = ~(line->dirty >> seg->first);
+	seg->num_blocks = run == 0 ? 64 - seg->first : (uint32_t)__builtin_ctzll(run);
+	seg->num_blocks = spdk_min(seg->num_blocks, cache->geo.line_blocks - seg->first);
+	seg->buf_offset = destage->num_blocks;
+	destage->num_blocks += seg->num_blocks;
+
+	cache_dirty_list_remove(cache, line);
+	line->destage_mask = cache_mask(seg->first, seg->num_blocks);
+	line->redirty = 0;
+	line->refcnt++;
+
+	return seg->first + seg->num_blocks;
+}
+
+/*
+ * Destage the oldest dirty line. Dirty runs that continue into the next lines of
+ * the base bdev are written with the same I/O.
+ */
+static bool
+cache_destage_start(struct vbdev_cache *cache)
+{
+	struct cache_destage *destage;
+	struct cache_line *line;
+	uint32_t end, i;
+
+	line = TAILQ_FIRST(&cache->dirty_lines);
+	destage = TAILQ_FIRST(&cache->free_destages);
+	if (line == NULL || destage == NULL) {
+		return false;
+	}
+
+	TAILQ_REMOVE(&cache->free_destages, destage, link);
+	destage->num_segs = 0;
+	destage->num_blocks = 0;
+	destage->failed = false;
+
+	end = cache_destage_add(destage, line);
+	while (end == cache->geo.line_blocks && destage->num_segs < CACHE_DESTAGE_MAX_LINES) {
+		line = cache_find_resident(cache, line->base_line + 1);
+		if (line == NULL || !line->on_dirty_list || !(line->dirty & 1)) {
+			break;
+		}
+		end = cache_destage_add(destage, line);
+	}
+
+	cache->outstanding++;
+	cache->destages_outstanding++;
+	destage->outstanding = destage->num_segs;
+	for (i = 0; i < destage->num_segs; i++) {
+		cache_destage_read_submit(&destage->segs[i]);
+	}
+
+	return true;
+}
+
+static int
+cache_destage_poll(void *arg)
+{
+	struct vbdev_cache *cache = arg;
+	uint32_t target = 0;
+	uint64_t dirty_pct;
+	bool idle;
+	int started = 0;
+
+	idle = cache->io_count == cache->last_io_count;
+	cache->last_io_count = cache->io_count;
+
+	if (cache->num_dirty == 0) {
+		cache->alloc_failed = false;
+		return 0;
+	}
+
+	/*
+	 * Destage at full speed once the cache had to send writes around it or is mostly
+	 * dirty, in the background while it is idle or filling up, and not at all while
+	 * only a few lines are dirty, so that rewrites of them are absorbed.
+	 */
+	dirty_pct = cache->num_dirty * 100 / cache->geo.num_lines;
+	if (cache->alloc_failed || dirty_pct >= CACHE_DIRTY_HIGH_PCT) {
+		target = CACHE_DESTAGE_CTXS;
+	} else if (idle || dirty_pct >= CACHE_DIRTY_LOW_PCT) {
+		target = CACHE_DESTAGE_CTXS / 4;
+	}
+	cache->alloc_failed = false;
+
+	while (cache->destages_outstanding < target && cache_destage_start(cache)) {
+		started++;
+	}
+
+	return started;
+}
+
+/* Loading and saving all metadata */
+
+static int
+cache_md_parse_page(struct vbdev_cache *cache, uint64_t page_idx, void *buf, bool clean)
+{
+	struct cache_md_hdr *hdr = buf;
+	struct cache_md_entry *entry = (struct cache_md_entry *)(hdr + 1);
+	uint64_t idx = page_idx * cache->geo.entries_per_page;
+	uint64_t end = spdk_min(idx + cache->geo.entries_per_page, cache->geo.num_lines);
+	uint64_t base_lines = spdk_divide_round_up(spdk_bdev_get_num_blocks(cache->base_bdev),
+			      cache->geo.line_blocks);
+	uint64_t line_mask = cache_mask(0, cache->geo.line_blocks);
+	struct cache_line *line;
+	uint32_t crc = hdr->crc;
+
+	hdr->crc = 0;
+	if (crc != spdk_crc32c_update(buf, cache->block_size, 0)) {
+		SPDK_ERRLOG("Metadata page %" PRIu64 " of %s is corrupted\n", page_idx,
+			    cache->bdev.name);
+		return -EILSEQ;
+	}
+
+	for (; idx < end; idx++, entry++) {
+		/* After a crash only the dirty blocks are known to match their entry. */
+		if (entry->base_line == 0 || (!clean && entry->dirty == 0)) {
+			continue;
+		}
+
+		if (entry->base_line > base_lines || ((entry->valid | entry->dirty) & ~line_mask) ||
+		    cache_hash_find(cache, entry->base_line - 1) != NULL) {
+			SPDK_ERRLOG("Invalid metadata entry %" PRIu64 " of %s\n", idx,
+				    cache->bdev.name);
+			return -EILSEQ;
+		}
+
+		line = &cache->lines[idx];
+		cache_list_remove(cache, line);
+		line->base_line = entry->base_line - 1;
+		line->dirty = entry->dirty;
+		line->valid = (clean ? entry->valid : 0) | entry->dirty;
+		line->md_dirty = entry->dirty;
+		cache_hash_insert(cache, line);
+		cache_list_add(cache, line, CACHE_LIST_T1);
+		if (line->dirty != 0) {
+			cache->num_dirty++;
+			cache_dirty_list_add(cache, line);
+		}
+	}
+
+	return 0;
+}
+
+static int
+cache_md_load_page(void *ctx, uint64_t page_idx, void *buf)
+{
+	struct vbdev_cache *cache = ctx;
+	struct cache_sb *sb = cache->md.sb;
+
+	return cache_md_parse_page(cache, page_idx, buf, sb->clean);
+}
+
+static const struct spdk_vbdev_md_ops cache_md_ops = {
+	.magic		= CACHE_SB_MAGIC,
+	.version	= CACHE_SB_VERSION,
+	.sb_size	= sizeof(struct cache_sb),
+	.serialize_page	= cache_md_serialize_page,
+	.parse_page	= cache_md_load_page,
+	.page_written	= cache_md_page_written,
+};
+
+static void
+cache_sb_write(struct vbdev_cache *cache, bool clean, spdk_vbdev_md_cb cb)
+{
+	struct cache_sb *sb = cache->md.sb;
+
+	memset(sb, 0, cache->block_size);
+	sb->block_size = cache->block_size;
+	sb->line_blocks = cache->geo.line_blocks;
+	sb->num_lines = cache->geo.num_lines;
+	sb->md_offset = cache->geo.md_offset;
+	sb->md_blocks = cache->geo.md_blocks;
+	sb->data_offset = cache->geo.data_offset;
+	sb->base_blockcnt = spdk_bdev_get_num_blocks(cache->base_bdev);
+	spdk_uuid_copy(&sb->base_uuid, spdk_bdev_get_uuid(cache->base_bdev));
+	sb->clean = clean;
+
+	spdk_vbdev_md_sb_write(&cache->md, cb);
+}
+
+/* Creation and deletion */
+
+static void
+cache_free(struct vbdev_cache *cache)
+{
+	uint32_t i;
+
+	for (i = 0; i < CACHE_FILL_BUFS; i++) {
+		spdk_dma_free(cache->fills[i].buf);
+	}
+	for (i = 0; i < CACHE_DESTAGE_CTXS; i++) {
+		spdk_dma_free(cache->destages[i].buf);
+	}
+	spdk_vbdev_md_free(&cache->md);
+	free(cache->lines);
+	free(cache->hash);
+	free(cache->bdev.name);
+	free(cache);
+}
+
+static void
+cache_close_bdevs(struct vbdev_cache *cache)
+{
+	if (cache->base_ch != NULL) {
+		spdk_put_io_channel(cache->base_ch);
+	}
+	if (cache->cache_ch != NULL) {
+		spdk_put_io_channel(cache->cache_ch);
+	}
+	if (cache->base_desc != NULL) {
+		spdk_bdev_module_release_bdev(cache->base_bdev);
+		spdk_bdev_close(cache->base_desc);
+	}
+	if (cache->cache_desc != NULL) {
+		spdk_bdev_module_release_bdev(cache->cache_bdev);
+		spdk_bdev_close(cache->cache_desc);
+	}
+}
+
+static void
+_device_unregister_cb(void *io_device)
+{
+	cache_free(io_device);
+}
+
+static void
+cache_stop_done(void *ctx, int status)
+{
+	struct vbdev_cache *cache = ctx;
+
+	if (status != 0) {
+		SPDK_ERRLOG("Saving the metadata of %s failed: %s\n", cache->bdev.name,
+			    spdk_strerror(-status));
+	}
+
+	cache_close_bdevs(cache);
+	spdk_bdev_destruct_done(&cache->bdev, status);
+	spdk_io_device_unregister(cache, _device_unregister_cb);
+}
+
+static void
+cache_stop_save_done(void *ctx, int status)
+{
+	struct vbdev_cache *cache = ctx;
+
+	if (status != 0) {
+		cache_stop_done(cache, status);
+		return;
+	}
+
+	cache_sb_write(cache, true, cache_stop_done);
+}
+
+static void
+cache_stop_drain_done(void *ctx, int status)
+{
+	struct vbdev_cache *cache = ctx;
+
+	SPDK_NOTICELOG("Saving the metadata of %s, %" PRIu64 " dirty lines\n", cache->bdev.name,
+		       cache->num_dirty);
+	spdk_vbdev_md_io(&cache->md, true, cache_stop_save_done);
+}
+
+static void
+_cache_stop(void *arg)
+{
+	struct vbdev_cache *cache = arg;
+
+	cache->stopping = true;
+	spdk_poller_unregister(&cache->destage_poller);
+	spdk_vbdev_md_drain(&cache->md, &cache->outstanding, cache_stop_drain_done);
+}
+
+static int
+vbdev_cache_destruct(void *ctx)
+{
+	struct vbdev_cache *cache = ctx;
+
+	TAILQ_REMOVE(&g_caches, cache, link);
+	spdk_vbdev_md_call(&cache->md, _cache_stop, cache);
+
+	return 1;
+}
+
+static struct spdk_io_channel *
+vbdev_cache_get_io_channel(void *ctx)
+{
+	return spdk_get_io_channel(ctx);
+}
+
+static int
+vbdev_cache_dump_info_json(void *ctx, struct spdk_json_write_ctx *w)
+{
+	struct vbdev_cache *cache = ctx;
+	struct cache_stats *stats = &cache->stats;
+	uint64_t reads = stats->read_hits + stats->read_partial_hits + stats->read_misses;
+
+	spdk_json_write_named_object_begin(w, "cache");
+	spdk_json_write_named_string(w, "name", spdk_bdev_get_name(&cache->bdev));
+	spdk_json_write_named_string(w, "base_bdev_name", spdk_bdev_get_name(cache->base_bdev));
+	spdk_json_write_named_string(w, "cache_bdev_name", spdk_bdev_get_name(cache->cache_bdev));
+	spdk_json_write_named_uint32(w, "line_size", cache->geo.line_blocks * cache->block_size);
+	spdk_json_write_named_string(w, "policy", vbdev_cache_policy_str(cache->policy));
+	spdk_json_write_named_uint64(w, "seq_cutoff", cache->seq_cutoff);
+	spdk_json_write_named_uint64(w, "num_lines", cache->geo.num_lines);
+	spdk_json_write_named_uint64(w, "used_lines", cache->list_len[CACHE_LIST_T1] +
+				     cache->list_len[CACHE_LIST_T2]);
+	spdk_json_write_named_uint64(w, "dirty_lines", cache->num_dirty);
+
+	spdk_json_write_named_object_begin(w, "stats");
+	spdk_json_write_named_uint64(w, "read_hits", stats->read_hits);
+	spdk_json_write_named_uint64(w, "read_partial_hits", stats->read_partial_hits);
+	spdk_json_write_named_uint64(w, "read_misses", stats->read_misses);
+	spdk_json_write_named_uint32(w, "read_hit_rate_pct",
+				     reads ? (uint32_t)(stats->read_hits * 100 / reads) : 0);
+	spdk_json_write_named_uint64(w, "write_hits", stats->write_hits);
+	spdk_json_write_named_uint64(w, "write_misses", stats->write_misses);
+	spdk_json_write_named_uint64(w, "write_around", stats->write_around);
+	spdk_json_write_named_uint64(w, "bypassed", stats->bypassed);
+	spdk_json_write_named_uint64(w, "fills", stats->fills);
+	spdk_json_write_named_uint64(w, "evictions", stats->evictions);
+	spdk_json_write_named_uint64(w, "destage_ios", stats->destage_ios);
+	spdk_json_write_named_uint64(w, "destaged_blocks", stats->destaged_blocks);
+	spdk_json_write_named_uint64(w, "md_writes", cache->md.writes);
+	spdk_json_write_object_end(w);
+
+	spdk_json_write_object_end(w);
+
+	return 0;
+}
+
+static void
+vbdev_cache_write_config_json(struct spdk_bdev *bdev, struct spdk_json_write_ctx *w)
+{
+	/* No config per bdev needed */
+}
+
+static const struct spdk_bdev_fn_table vbdev_cache_fn_table = {
+	.destruct		= vbdev_cache_destruct,
+	.submit_request		= vbdev_cache_submit_request,
+	.io_type_supported	= vbdev_cache_io_type_supported,
+	.get_io_channel		= vbdev_cache_get_io_channel,
+	.dump_info_json		= vbdev_cache_dump_info_json,
+	.write_config_json	= vbdev_cache_write_config_json,
+};
+
+static int
+cache_ch_create_cb(void *io_device, void *ctx_buf)
+{
+	struct cache_io_channel *ch = ctx_buf;
+
+	ch->cache = io_device;
+
+	return 0;
+}
+
+static void
+cache_ch_destroy_cb(void *io_device, void *ctx_buf)
+{
+}
+
+/* Called when the base bdev or the cache bdev goes away. */
+static void
+vbdev_cache_hotremove_cb(void *ctx)
+{
+	struct vbdev_cache *cache = ctx;
+
+	if (!cache->removing) {
+		cache->removing = true;
+		spdk_bdev_unregister(&cache->bdev, NULL, NULL);
+	}
+}
+
+static void
+cache_create_done(void *ctx, int status)
+{
+	struct vbdev_cache *cache = ctx;
+	vbdev_cache_create_cb cb_fn = cache->create_cb;
+	void *cb_arg = cache->create_cb_arg;
+
+	if (status != 0) {
+		SPDK_ERRLOG("Could not create cache %s: %s\n", cache->bdev.name,
+			    spdk_strerror(-status));
+		cache_close_bdevs(cache);
+		cache_free(cache);
+		cb_fn(cb_arg, NULL, status);
+		return;
+	}
+
+	spdk_io_device_register(cache, cache_ch_create_cb, cache_ch_destroy_cb,
+				sizeof(struct cache_io_channel), cache->bdev.name);
+
+	status = spdk_bdev_register(&cache->bdev);
+	if (status != 0) {
+		SPDK_ERRLOG("Could not register cache %s\n", cache->bdev.name);
+		cache_close_bdevs(cache);
+		spdk_io_device_unregister(cache, _device_unregister_cb);
+		cb_fn(cb_arg, NULL, status);
+		return;
+	}
+
+	cache->destage_poller = SPDK_POLLER_REGISTER(cache_destage_poll, cache,
+				CACHE_DESTAGE_POLL_US);
+	TAILQ_INSERT_TAIL(&g_caches, cache, link);
+
+	SPDK_NOTICELOG("Cache %s: %" PRIu64 " lines of %u KiB, %" PRIu64 " used, %" PRIu64
+		       " dirty\n", cache->bdev.name, cache->geo.num_lines,
+		       cache->geo.line_blocks * cache->block_size / 1024,
+		       cache->list_len[CACHE_LIST_T1], cache->num_dirty);
+	cb_fn(cb_arg, &cache->bdev, 0);
+}
+
+static void
+cache_create_md_done(void *ctx, int status)
+{
+	struct vbdev_cache *cache = ctx;
+
+	if (status != 0) {
+		cache_create_done(cache, status);
+		return;
+	}
+
+	/* From now on only dirty entries can be trusted after a crash. */
+	cache_sb_write(cache, false, cache_create_done);
+}
+
+static int
+cache_init_state(struct vbdev_cache *cache)
+{
+	uint64_t num_nodes = cache->geo.num_lines * 2;
+	uint64_t buckets = spdk_align64pow2(num_nodes);
+	size_t align = spdk_max(spdk_bdev_get_buf_align(cache->base_bdev),
+				spdk_bdev_get_buf_align(cache->cache_bdev));
+	size_t line_size = (size_t)cache->geo.line_blocks * cache->block_size;
+	uint64_t i;
+	int rc;
+
+	cache->lines = calloc(num_nodes, sizeof(*cache->lines));
+	cache->hash = malloc(buckets * sizeof(*cache->hash));
+	if (cache->lines == NULL || cache->hash == NULL) {
+		return -ENOMEM;
+	}
+
+	cache->hash_mask = buckets - 1;
+	for (i = 0; i < buckets; i++) {
+		cache->hash[i] = CACHE_NONE;
+	}
+
+	for (i = 0; i < CACHE_LIST_COUNT; i++) {
+		TAILQ_INIT(&cache->lists[i]);
+	}
+	TAILQ_INIT(&cache->free_ghosts);
+	TAILQ_INIT(&cache->dirty_lines);
+	for (i = 0; i < num_nodes; i++) {
+		cache->lines[i].hash_next = CACHE_NONE;
+		TAILQ_INIT(&cache->lines[i].waiters);
+		if (i < cache->geo.num_lines) {
+			cache_list_add(cache, &cache->lines[i], CACHE_LIST_FREE);
+		} else {
+			TAILQ_INSERT_TAIL(&cache->free_ghosts, &cache->lines[i], link);
+		}
+	}
+
+	rc = spdk_vbdev_md_alloc_pages(&cache->md, cache->geo.md_offset, cache->geo.md_blocks);
+	if (rc != 0) {
+		return rc;
+	}
+
+	TAILQ_INIT(&cache->free_fills);
+	TAILQ_INIT(&cache->buf_waiters);
+	for (i = 0; i < CACHE_FILL_BUFS; i++) {
+		cache->fills[i].cache = cache;
+		cache->fills[i].buf = spdk_dma_malloc(line_size, align, NULL);
+		if (cache->fills[i].buf == NULL) {
+			return -ENOMEM;
+		}
+		TAILQ_INSERT_TAIL(&cache->free_fills, &cache->fills[i], link);
+	}
+
+	TAILQ_INIT(&cache->free_destages);
+	for (i = 0; i < CACHE_DESTAGE_CTXS; i++) {
+		cache->destages[i].cache = cache;
+		cache->destages[i].buf = spdk_dma_malloc(line_size * CACHE_DESTAGE_MAX_LINES, align,
+					 NULL);
+		if (cache->destages[i].buf == NULL) {
+			return -ENOMEM;
+		}
+		TAILQ_INSERT_TAIL(&cache->free_destages, &cache->destages[i], link);
+	}
+
+	TAILQ_INIT(&cache->direct_ios);
+
+	return 0;
+}
+
+static int
+cache_set_geometry(struct vbdev_cache *cache, uint32_t line_blocks)
+{
+	int rc;
+
+	rc = cache_compute_geometry(spdk_bdev_get_num_blocks(cache->cache_bdev), cache->block_size,
+				    line_blocks, &cache->geo);
+	if (rc != 0) {
+		SPDK_ERRLOG("%s is too small for a cache with %u KiB lines\n",
+			    spdk_bdev_get_name(cache->cache_bdev),
+			    line_blocks * cache->block_size / 1024);
+		return rc;
+	}
+
+	cache->line_shift = spdk_u32log2(line_blocks);
+	cache->bdev.optimal_io_boundary = line_blocks;
+
+	return cache_init_state(cache);
+}
+
+static void
+cache_format(struct vbdev_cache *cache, uint32_t line_blocks)
+{
+	int rc;
+
+	SPDK_NOTICELOG("Formatting %s for cache %s\n", spdk_bdev_get_name(cache->cache_bdev),
+		       cache->bdev.name);
+
+	rc = cache_set_geometry(cache, line_blocks);
+	if (rc != 0) {
+		cache_create_done(cache, rc);
+		return;
+	}
+
+	spdk_vbdev_md_io(&cache->md, true, cache_create_md_done);
+}
+
+static int
+cache_sb_check(struct vbdev_cache *cache)
+{
+	struct cache_sb *sb = cache->md.sb;
+	struct cache_geometry geo;
+	int rc;
+
+	if (spdk_uuid_compare(&sb->base_uuid, spdk_bdev_get_uuid(cache->base_bdev)) != 0 ||
+	    sb->base_blockcnt != spdk_bdev_get_num_blocks(cache->base_bdev)) {
+		SPDK_ERRLOG("%s holds a cache of another bdev than %s\n",
+			    spdk_bdev_get_name(cache->cache_bdev),
+			    spdk_bdev_get_name(cache->base_bdev));
+		return -EINVAL;
+	}
+
+	if (sb->block_size != cache->block_size || sb->line_blocks == 0 ||
+	    sb->line_blocks > CACHE_MAX_LINE_BLOCKS || !spdk_u32_is_pow2(sb->line_blocks)) {
+		return -EILSEQ;
+	}
+
+	rc = cache_compute_geometry(spdk_bdev_get_num_blocks(cache->cache_bdev), cache->block_size,
+				    sb->line_blocks, &geo);
+	if (rc != 0 || geo.num_lines != sb->num_lines || geo.md_offset != sb->md_offset ||
+	    geo.md_blocks != sb->md_blocks || geo.data_offset != sb->data_offset) {
+		SPDK_ERRLOG("The cache on %s does not match the size of the bdev\n",
+			    spdk_bdev_get_name(cache->cache_bdev));
+		return -EILSEQ;
+	}
+
+	return 0;
+}
+
+static void
+cache_sb_read_done(void *ctx, int status)
+{
+	struct vbdev_cache *cache = ctx;
+	struct cache_sb *sb = cache->md.sb;
+
+	if (status == -ENOENT) {
+		cache_format(cache, cache->geo.line_blocks);
+		return;
+	}
+
+	if (status == 0) {
+		status = cache_sb_check(cache);
+	}
+	if (status == 0) {
+		status = cache_set_geometry(cache, sb->line_blocks);
+	}
+	if (status != 0) {
+		cache_create_done(cache, status);
+		return;
+	}
+
+	SPDK_NOTICELOG("Loading cache %s after %s shutdown\n", cache->bdev.name,
+		       sb->clean ? "a clean" : "an unclean");
+	spdk_vbdev_md_io(&cache->md, false, cache_create_md_done);
+}
+
+static int
+cache_open_bdev(struct vbdev_cache *cache, const char *name, struct spdk_bdev **bdev,
+		struct spdk_bdev_desc **desc)
+{
+	int rc;
+
+	*bdev = spdk_bdev_get_by_name(name);
+	if (*bdev == NULL) {
+		SPDK_ERRLOG("Could not find bdev %s\n", name);
+		return -ENODEV;
+	}
+
+	rc = spdk_bdev_open(*bdev, true, vbdev_cache_hotremove_cb, cache, desc);
+	if (rc != 0) {
+		SPDK_ERRLOG("Could not open bdev %s\n", name);
+		return rc;
+	}
+
+	rc = spdk_bdev_module_claim_bdev(*bdev, *desc, &cache_if);
+	if (rc != 0) {
+		SPDK_ERRLOG("Could not claim bdev %s\n", name);
+		spdk_bdev_close(*desc);
+		*desc = NULL;
+		return rc;
+	}
+
+	return 0;
+}
+
+void
+vbdev_cache_create(const struct vbdev_cache_opts *opts, vbdev_cache_create_cb cb_fn, void *cb_arg)
+{
+	struct vbdev_cache *cache;
+	uint32_t line_size;
+	int rc;
+
+	if (spdk_bdev_get_by_name(opts->name) != NULL) {
+		cb_fn(cb_arg, NULL, -EEXIST);
+		return;
+	}
+
+	if (vbdev_cache_policy_str(opts->policy) == NULL) {
+		cb_fn(cb_arg, NULL, -EINVAL);
+		return;
+	}
+
+	cache = calloc(1, sizeof(*cache));
+	if (cache == NULL) {
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	cache->bdev.name = strdup(opts->name);
+	if (cache->bdev.name == NULL) {
+		free(cache);
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	cache->create_cb = cb_fn;
+	cache->create_cb_arg = cb_arg;
+	cache->policy = opts->policy;
+	cache->seq_cutoff = opts->seq_cutoff;
+
+	rc = cache_open_bdev(cache, opts->base_bdev_name, &cache->base_bdev, &cache->base_desc);
+	if (rc == 0) {
+		rc = cache_open_bdev(cache, opts->cache_bdev_name, &cache->cache_bdev,
+				     &cache->cache_desc);
+	}
+	if (rc != 0) {
+		cache_create_done(cache, rc);
+		return;
+	}
+
+	cache->block_size = spdk_bdev_get_block_size(cache->base_bdev);
+	if (spdk_bdev_get_block_size(cache->cache_bdev) != cache->block_size ||
+	    spdk_bdev_get_md_size(cache->base_bdev) != 0) {
+		SPDK_ERRLOG("%s and %s must have the same block size and no metadata\n",
+			    opts->base_bdev_name, opts->cache_bdev_name);
+		cache_create_done(cache, -EINVAL);
+		return;
+	}
+
+	line_size = opts->line_size;
+	if (line_size == 0) {
+		line_size = spdk_min(CACHE_DEFAULT_LINE_SIZE,
+				     CACHE_MAX_LINE_BLOCKS * cache->block_size);
+	}
+	cache->geo.line_blocks = line_size / cache->block_size;
+	if (line_size % cache->block_size != 0 || cache->geo.line_blocks == 0 ||
+	    cache->geo.line_blocks > CACHE_MAX_LINE_BLOCKS ||
+	    !spdk_u32_is_pow2(cache->geo.line_blocks)) {
+		SPDK_ERRLOG("The line size must be a power of two between 1 and %d blocks\n",
+			    CACHE_MAX_LINE_BLOCKS);
+		cache_create_done(cache, -EINVAL);
+		return;
+	}
+
+	cache->bdev.product_name = "cache";
+	cache->bdev.write_cache = cache->base_bdev->write_cache || cache->cache_bdev->write_cache;
+	cache->bdev.required_alignment = spdk_max(cache->base_bdev->required_alignment,
+				       cache->cache_bdev->required_alignment);
+	cache->bdev.split_on_optimal_io_boundary = true;
+	cache->bdev.blocklen = cache->block_size;
+	cache->bdev.blockcnt = spdk_bdev_get_num_blocks(cache->base_bdev);
+	cache->bdev.ctxt = cache;
+	cache->bdev.fn_table = &vbdev_cache_fn_table;
+	cache->bdev.module = &cache_if;
+
+	cache->base_ch = spdk_bdev_get_io_channel(cache->base_desc);
+	cache->cache_ch = spdk_bdev_get_io_channel(cache->cache_desc);
+	if (cache->base_ch == NULL || cache->cache_ch == NULL) {
+		cache_create_done(cache, -ENOMEM);
+		return;
+	}
+
+	rc = spdk_vbdev_md_init(&cache->md, &cache_md_ops, cache, cache->bdev.name,
+				cache->cache_desc, cache->cache_ch);
+	if (rc != 0) {
+		cache_create_done(cache, rc);
+		return;
+	}
+
+	if (opts->format) {
+		cache_format(cache, cache->geo.line_blocks);
+		return;
+	}
+
+	spdk_vbdev_md_sb_read(&cache->md, cache_sb_read_done);
+}
+
+void
+vbdev_cache_delete(struct spdk_bdev *bdev, spdk_bdev_unregister_cb cb_fn, void *cb_arg)
+{
+	struct vbdev_cache *cache;
+
+	if (!bdev || bdev->module != &cache_if) {
+		cb_fn(cb_arg, -ENODEV);
+		return;
+	}
+
+	cache = SPDK_CONTAINEROF(bdev, struct vbdev_cache, bdev);
+	cache->removing = true;
+	spdk_bdev_unregister(bdev, cb_fn, cb_arg);
+}
+
+static int
+vbdev_cache_init(void)
+{
+	return 0;
+}
+
+static void
+vbdev_cache_finish(void)
+{
+}
+
+static int
+vbdev_cache_get_ctx_size(void)
+{
+	return sizeof(struct vbdev_cache_io);
+}
+
+static int
+vbdev_cache_config_json(struct spdk_json_write_ctx *w)
+{
+	struct vbdev_cache *cache;
+
+	TAILQ_FOREACH(cache, &g_caches, link) {
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_string(w, "method", "bdev_cache_create");
+		spdk_json_write_named_object_begin(w, "params");
+		spdk_json_write_named_string(w, "name", spdk_bdev_get_name(&cache->bdev));
+		spdk_json_write_named_string(w, "base_bdev_name",
+					     spdk_bdev_get_name(cache->base_bdev));
+		spdk_json_write_named_string(w, "cache_bdev_name",
+					     spdk_bdev_get_name(cache->cache_bdev));
+		spdk_json_write_named_uint32(w, "line_size_kb",
+					     cache->geo.line_blocks * cache->block_size / 1024);
+		spdk_json_write_named_string(w, "policy", vbdev_cache_policy_str(cache->policy));
+		spdk_json_write_named_uint64(w, "seq_cutoff_kb", cache->seq_cutoff / 1024);
+		spdk_json_write_object_end(w);
+		spdk_json_write_object_end(w);
+	}
+
+	return 0;
+}
+
+SPDK_LOG_REGISTER_COMPONENT("vbdev_cache", SPDK_LOG_VBDEV_CACHE)
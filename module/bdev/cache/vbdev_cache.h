@@ -0,0 +1,95 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SPDK_VBDEV_CACHE_H
+#define SPDK_VBDEV_CACHE_H
+
+#include "spdk/stdinc.h"
+
+#include "spdk/bdev.h"
+#include "spdk/bdev_module.h"
+
+enum vbdev_cache_policy {
+	VBDEV_CACHE_POLICY_LRU,
+	VBDEV_CACHE_POLICY_ARC,
+};
+
+struct vbdev_cache_opts {
+	/* Name of the cache vbdev */
+	const char			*name;
+	/* Slow bdev whose data is cached */
+	const char			*base_bdev_name;
+	/* Fast bdev holding the cached data and its metadata */
+	const char			*cache_bdev_name;
+	/* Size of a cache line in bytes. 0 picks the default. Only used when formatting. */
+	uint32_t			line_size;
+	enum vbdev_cache_policy		policy;
+	/*
+	 * Bytes of sequential I/O after which a stream bypasses the cache.
+	 * 0 never bypasses.
+	 */
+	uint64_t			seq_cutoff;
+	/* Format the cache bdev even if it holds the metadata of a cache. */
+	bool				format;
+};
+
+typedef void (*vbdev_cache_create_cb)(void *cb_arg, struct spdk_bdev *bdev, int bdeverrno);
+
+/**
+ * Create a write-back cache vbdev. If the cache bdev holds the metadata of a
+ * cache of the same base bdev, its content, including dirty data after a crash,
+ * is picked up. Otherwise the cache bdev is formatted.
+ *
+ * \param opts Options of the vbdev.
+ * \param cb_fn Function to call once the vbdev was registered, or creating it failed.
+ * \param cb_arg Argument to pass to cb_fn.
+ */
+void vbdev_cache_create(const struct vbdev_cache_opts *opts, vbdev_cache_create_cb cb_fn,
+			void *cb_arg);
+
+/**
+ * Delete a cache vbdev. Dirty data stays on the cache bdev and the metadata is
+ * saved, so that the cache can be created again with the same bdevs.
+ *
+ * \param bdev Pointer to the cache vbdev.
+ * \param cb_fn Function to call after deletion.
+ * \param cb_arg Argument to pass to cb_fn.
+ */
+void vbdev_cache_delete(struct spdk_bdev *bdev, spdk_bdev_unregister_cb cb_fn, void *cb_arg);
+
+const char *vbdev_cache_policy_str(enum vbdev_cache_policy policy);
+
+/* Returns -EINVAL for an unknown policy name. */
+int vbdev_cache_policy_parse(const char *str, enum vbdev_cache_policy *policy);
+
+#endif /* SPDK_VBDEV_CACHE_H */
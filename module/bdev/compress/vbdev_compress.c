@@ -32,6 +32,7 @@
  */
 
 #include "vbdev_compress.h"
+#include "vbdev_compress_sw.h"
 
 #include "spdk/reduce.h"
 #include "spdk/stdinc.h"
@@ -64,10 +65,24 @@
 
 #define ISAL_PMD "compress_isal"
 #define QAT_PMD "compress_qat"
+#define SW_ENGINE "compress_sw"
 #define NUM_MBUFS		8192
 #define POOL_CACHE_SIZE		256
 
+/* Reduce has at most 256 requests per volume, each with at most one operation
+ * outstanding, so this many software ops never run out in practice.
+ */
+#define COMP_SW_NUM_OPS		256
+#define COMP_SW_POLL_BATCH	32
+/* Ops run per poll when there are no workers, so the reactor isn't held up. */
+#define COMP_SW_INLINE_BATCH	4
+
 static enum compress_pmd g_opts;
+static struct compress_sw_opts g_sw_opts = {
+	.level = COMP_SW_LEVEL_DEFAULT,
+	.num_workers = 1,
+};
+static bool g_sw_engine_started = false;
 
 /* Global list of available compression devices. */
 struct compress_dev {
@@ -127,6 +142,12 @@ struct vbdev_compress {
 	void				*delete_cb_arg;
 	bool				orphaned;	/* base bdev claimed but comp_bdev not registered */
 	TAILQ_HEAD(, vbdev_comp_op)	queued_comp_ops;
+	bool				sw;		/* uses the software engine, not a PMD */
+	struct comp_sw_op		*sw_ops;
+	TAILQ_HEAD(, comp_sw_op)	sw_free_ops;
+	TAILQ_HEAD(, comp_sw_op)	sw_pending_ops;	/* run by the poller without workers */
+	struct comp_sw_ctx		*sw_ctx;	/* set when there are no workers */
+	struct spdk_ring		*sw_cq;		/* ops completed by the workers */
 	TAILQ_ENTRY(vbdev_compress)	link;
 };
 static TAILQ_HEAD(, vbdev_compress) g_vbdev_comp = TAILQ_HEAD_INITIALIZER(g_vbdev_comp);
@@ -328,15 +349,17 @@ vbdev_init_compress_drivers(void)
 	struct compress_dev *device;
 	int rc;
 
-	/* We always init the compress_isal PMD */
+	/* We always try to init the compress_isal PMD. Without it, the software
+	 * engine still works.
+	 */
 	rc = rte_vdev_init(ISAL_PMD, NULL);
 	if (rc == 0) {
 		SPDK_NOTICELOG("created virtual PMD %s\n", ISAL_PMD);
 	} else if (rc == -EEXIST) {
 		SPDK_NOTICELOG("virtual PMD %s already exists.\n", ISAL_PMD);
 	} else {
-		SPDK_ERRLOG("creating virtual PMD %s\n", ISAL_PMD);
-		return -EINVAL;
+		SPDK_NOTICELOG("could not create virtual PMD %s (%d), using %s instead\n",
+			       ISAL_PMD, rc, SW_ENGINE);
 	}
 
 	/* If we have no compression devices, there's no reason to continue. */
@@ -429,6 +452,40 @@ spdk_reduce_rw_blocks_cb(void *arg, int reduce_errno)
 	}
 }
 
+/* Hand an operation to the software engine, returns -ENOMEM if all ops are in use. */
+static int
+_compress_operation_sw(struct vbdev_compress *comp_bdev, struct iovec *src_iovs,
+		       int src_iovcnt, struct iovec *dst_iovs,
+		       int dst_iovcnt, bool compress, void *cb_arg)
+{
+	struct comp_sw_op *op;
+
+	op = TAILQ_FIRST(&comp_bdev->sw_free_ops);
+	if (op == NULL) {
+		return -ENOMEM;
+	}
+	TAILQ_REMOVE(&comp_bdev->sw_free_ops, op, link);
+
+	op->src_iovs = src_iovs;
+	op->src_iovcnt = src_iovcnt;
+	op->dst_iovs = dst_iovs;
+	op->dst_iovcnt = dst_iovcnt;
+	op->compress = compress;
+	op->level = g_sw_opts.level;
+	op->result = 0;
+	op->cq = comp_bdev->sw_cq;
+	op->cb_arg = cb_arg;
+
+	/* Either way the op runs later, not on this call stack. */
+	if (comp_bdev->sw_ctx != NULL) {
+		TAILQ_INSERT_TAIL(&comp_bdev->sw_pending_ops, op, link);
+	} else {
+		comp_sw_engine_submit(op);
+	}
+
+	return 0;
+}
+
 static int
 _compress_operation(struct spdk_reduce_backing_dev *backing_dev, struct iovec *src_iovs,
 		    int src_iovcnt, struct iovec *dst_iovs,
@@ -440,7 +497,7 @@ _compress_operation(struct spdk_reduce_backing_dev *backing_dev, struct iovec *s
 	struct rte_comp_op *comp_op;
 	struct rte_mbuf *src_mbufs[MAX_MBUFS_PER_OP];
 	struct rte_mbuf *dst_mbufs[MAX_MBUFS_PER_OP];
-	uint8_t cdev_id = comp_bdev->device_qp->device->cdev_id;
+	uint8_t cdev_id;
 	uint64_t updated_length, remainder, phys_addr, total_length = 0;
 	uint8_t *current_src_base = NULL;
 	uint8_t *current_dst_base = NULL;
@@ -453,6 +510,16 @@ _compress_operation(struct spdk_reduce_backing_dev *backing_dev, struct iovec *s
 
 	assert(src_iovcnt < MAX_MBUFS_PER_OP);
 
+	if (comp_bdev->sw) {
+		rc = _compress_operation_sw(comp_bdev, src_iovs, src_iovcnt, dst_iovs, dst_iovcnt,
+					    compress, cb_arg);
+		if (rc == 0) {
+			return 0;
+		}
+		goto error_get_op;
+	}
+	cdev_id = comp_bdev->device_qp->device->cdev_id;
+
 #ifdef DEBUG
 	memset(src_mbufs, 0, sizeof(src_mbufs));
 	memset(dst_mbufs, 0, sizeof(dst_mbufs));
@@ -701,6 +768,60 @@ comp_dev_poller(void *args)
 	return 0;
 }
 
+/* Poller for the software engine. */
+static int
+comp_sw_poller(void *args)
+{
+	struct vbdev_compress *comp_bdev = args;
+	struct comp_sw_op *done_ops[COMP_SW_POLL_BATCH];
+	struct spdk_reduce_vol_cb_args *reduce_args;
+	struct vbdev_comp_op *op_to_resubmit;
+	struct comp_sw_op *op;
+	size_t num_done = 0, i;
+	int result;
+
+	if (comp_bdev->sw_ctx != NULL) {
+		while (num_done < COMP_SW_INLINE_BATCH &&
+		       (op = TAILQ_FIRST(&comp_bdev->sw_pending_ops)) != NULL) {
+			TAILQ_REMOVE(&comp_bdev->sw_pending_ops, op, link);
+			comp_sw_op_execute(comp_bdev->sw_ctx, op);
+			done_ops[num_done++] = op;
+		}
+	} else {
+		num_done = spdk_ring_dequeue(comp_bdev->sw_cq, (void **)done_ops,
+					     COMP_SW_POLL_BATCH);
+	}
+
+	for (i = 0; i < num_done; i++) {
+		op = done_ops[i];
+		reduce_args = op->cb_arg;
+		result = op->result;
+		/* The callback may submit the next operation, so free the op first. */
+		TAILQ_INSERT_HEAD(&comp_bdev->sw_free_ops, op, link);
+
+		if (result < 0) {
+			/* Reduce stores the chunk uncompressed if it didn't compress. */
+			SPDK_DEBUGLOG(SPDK_LOG_VBDEV_COMPRESS, "%s failed with %d\n",
+				      op->compress ? "compress" : "decompress", result);
+		}
+		reduce_args->cb_fn(reduce_args->cb_arg, result);
+	}
+
+	while (!TAILQ_EMPTY(&comp_bdev->queued_comp_ops) && !TAILQ_EMPTY(&comp_bdev->sw_free_ops)) {
+		op_to_resubmit = TAILQ_FIRST(&comp_bdev->queued_comp_ops);
+		TAILQ_REMOVE(&comp_bdev->queued_comp_ops, op_to_resubmit, link);
+		_compress_operation_sw(comp_bdev, op_to_resubmit->src_iovs,
+				       op_to_resubmit->src_iovcnt,
+				       op_to_resubmit->dst_iovs,
+				       op_to_resubmit->dst_iovcnt,
+				       op_to_resubmit->compress,
+				       op_to_resubmit->cb_arg);
+		free(op_to_resubmit);
+	}
+
+	return num_done;
+}
+
 /* Entry point for reduce lib to issue a compress operation. */
 static void
 _comp_reduce_compress(struct spdk_reduce_backing_dev *dev,
@@ -1038,6 +1159,9 @@ vbdev_compress_dump_info_json(void *ctx, struct spdk_json_write_ctx *w)
 	spdk_json_write_named_string(w, "name", spdk_bdev_get_name(&comp_bdev->comp_bdev));
 	spdk_json_write_named_string(w, "base_bdev_name", spdk_bdev_get_name(comp_bdev->base_bdev));
 	spdk_json_write_named_string(w, "compression_pmd", comp_bdev->drv_name);
+	if (comp_bdev->sw) {
+		spdk_json_write_named_uint32(w, "compression_level", g_sw_opts.level);
+	}
 	spdk_json_write_object_end(w);
 
 	return 0;
@@ -1049,6 +1173,14 @@ vbdev_compress_config_json(struct spdk_json_write_ctx *w)
 {
 	struct vbdev_compress *comp_bdev;
 
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_string(w, "method", "bdev_compress_set_sw_options");
+	spdk_json_write_named_object_begin(w, "params");
+	spdk_json_write_named_uint32(w, "level", g_sw_opts.level);
+	spdk_json_write_named_uint32(w, "num_workers", g_sw_opts.num_workers);
+	spdk_json_write_object_end(w);
+	spdk_json_write_object_end(w);
+
 	TAILQ_FOREACH(comp_bdev, &g_vbdev_comp, link) {
 		spdk_json_write_object_begin(w);
 		spdk_json_write_named_string(w, "method", "bdev_compress_create");
@@ -1251,23 +1383,55 @@ _prepare_for_load_init(struct spdk_bdev *bdev)
 	return meta_ctx;
 }
 
+/* Start the workers of the software engine on first use. */
+static int
+_sw_engine_get(void)
+{
+	int rc;
+
+	if (g_sw_engine_started || g_sw_opts.num_workers == 0) {
+		return 0;
+	}
+
+	rc = comp_sw_engine_start(g_sw_opts.num_workers);
+	if (rc) {
+		SPDK_ERRLOG("could not start %u %s workers: %s\n", g_sw_opts.num_workers,
+			    SW_ENGINE, spdk_strerror(-rc));
+		return rc;
+	}
+	g_sw_engine_started = true;
+
+	return 0;
+}
+
 static bool
 _set_pmd(struct vbdev_compress *comp_dev)
 {
 	if (g_opts == COMPRESS_PMD_AUTO) {
 		if (g_qat_available) {
 			comp_dev->drv_name = QAT_PMD;
-		} else {
+		} else if (g_isal_available) {
 			comp_dev->drv_name = ISAL_PMD;
+		} else {
+			comp_dev->drv_name = SW_ENGINE;
 		}
 	} else if (g_opts == COMPRESS_PMD_QAT_ONLY && g_qat_available) {
 		comp_dev->drv_name = QAT_PMD;
 	} else if (g_opts == COMPRESS_PMD_ISAL_ONLY && g_isal_available) {
 		comp_dev->drv_name = ISAL_PMD;
+	} else if (g_opts == COMPRESS_PMD_SW_ONLY) {
+		comp_dev->drv_name = SW_ENGINE;
 	} else {
 		SPDK_ERRLOG("Requested PMD is not available.\n");
 		return false;
 	}
+
+	if (strcmp(comp_dev->drv_name, SW_ENGINE) == 0) {
+		if (_sw_engine_get()) {
+			return false;
+		}
+		comp_dev->sw = true;
+	}
 	SPDK_NOTICELOG("PMD being used: %s\n", comp_dev->drv_name);
 	return true;
 }
@@ -1312,11 +1476,65 @@ vbdev_init_reduce(struct spdk_bdev *bdev, const char *pm_path)
  * we can communicate with the base bdev on a per channel basis.  If we needed
  * our own poller for this vbdev, we'd register it here.
  */
+static int
+_comp_sw_channel_init(struct vbdev_compress *comp_bdev)
+{
+	int i;
+
+	TAILQ_INIT(&comp_bdev->sw_free_ops);
+	TAILQ_INIT(&comp_bdev->sw_pending_ops);
+
+	comp_bdev->sw_ops = calloc(COMP_SW_NUM_OPS, sizeof(struct comp_sw_op));
+	if (comp_bdev->sw_ops == NULL) {
+		goto error;
+	}
+	for (i = 0; i < COMP_SW_NUM_OPS; i++) {
+		TAILQ_INSERT_TAIL(&comp_bdev->sw_free_ops, &comp_bdev->sw_ops[i], link);
+	}
+
+	/* Without workers the ops run from the poller of this bdev. The choice is made
+	 * when the channel is created so that it stays the same while ops are out.
+	 */
+	if (g_sw_engine_started) {
+		comp_bdev->sw_cq = spdk_ring_create(SPDK_RING_TYPE_MP_SC, COMP_SW_NUM_OPS,
+						    SPDK_ENV_SOCKET_ID_ANY);
+		if (comp_bdev->sw_cq == NULL) {
+			goto error;
+		}
+	} else {
+		comp_bdev->sw_ctx = comp_sw_ctx_alloc();
+		if (comp_bdev->sw_ctx == NULL) {
+			goto error;
+		}
+	}
+
+	comp_bdev->poller = SPDK_POLLER_REGISTER(comp_sw_poller, comp_bdev, 0);
+	return 0;
+
+error:
+	free(comp_bdev->sw_ops);
+	comp_bdev->sw_ops = NULL;
+	return -ENOMEM;
+}
+
+static void
+_comp_sw_channel_fini(struct vbdev_compress *comp_bdev)
+{
+	assert(TAILQ_EMPTY(&comp_bdev->sw_pending_ops));
+	spdk_ring_free(comp_bdev->sw_cq);
+	comp_bdev->sw_cq = NULL;
+	comp_sw_ctx_free(comp_bdev->sw_ctx);
+	comp_bdev->sw_ctx = NULL;
+	free(comp_bdev->sw_ops);
+	comp_bdev->sw_ops = NULL;
+}
+
 static int
 comp_bdev_ch_create_cb(void *io_device, void *ctx_buf)
 {
 	struct vbdev_compress *comp_bdev = io_device;
 	struct comp_device_qp *device_qp;
+	int rc;
 
 	/* We use this queue to track outstanding IO in our layer. */
 	TAILQ_INIT(&comp_bdev->pending_comp_ios);
@@ -1326,10 +1544,20 @@ comp_bdev_ch_create_cb(void *io_device, void *ctx_buf)
 
 	/* Now set the reduce channel if it's not already set. */
 	pthread_mutex_lock(&comp_bdev->reduce_lock);
-	if (comp_bdev->ch_count == 0) {
+	if (comp_bdev->ch_count == 0 && comp_bdev->sw) {
+		rc = _comp_sw_channel_init(comp_bdev);
+		if (rc) {
+			pthread_mutex_unlock(&comp_bdev->reduce_lock);
+			SPDK_ERRLOG("could not allocate %s ops for comp_bdev %p\n", SW_ENGINE,
+				    comp_bdev);
+			return rc;
+		}
+		comp_bdev->base_ch = spdk_bdev_get_io_channel(comp_bdev->base_desc);
+		comp_bdev->reduce_thread = spdk_get_thread();
+	} else if (comp_bdev->ch_count == 0) {
 		comp_bdev->base_ch = spdk_bdev_get_io_channel(comp_bdev->base_desc);
 		comp_bdev->reduce_thread = spdk_get_thread();
-		comp_bdev->poller = spdk_poller_register(comp_dev_poller, comp_bdev, 0);
+		comp_bdev->poller = SPDK_POLLER_REGISTER(comp_dev_poller, comp_bdev, 0);
 		/* Now assign a q pair */
 		pthread_mutex_lock(&g_comp_device_qp_lock);
 		TAILQ_FOREACH(device_qp, &g_comp_device_qp, link) {
@@ -1350,7 +1578,7 @@ comp_bdev_ch_create_cb(void *io_device, void *ctx_buf)
 	comp_bdev->ch_count++;
 	pthread_mutex_unlock(&comp_bdev->reduce_lock);
 
-	if (comp_bdev->device_qp != NULL) {
+	if (comp_bdev->device_qp != NULL || comp_bdev->sw) {
 		return 0;
 	} else {
 		SPDK_ERRLOG("out of qpairs, cannot assign one to comp_bdev %p\n", comp_bdev);
@@ -1369,6 +1597,9 @@ _channel_cleanup(struct vbdev_compress *comp_bdev)
 	spdk_put_io_channel(comp_bdev->base_ch);
 	comp_bdev->reduce_thread = NULL;
 	spdk_poller_unregister(&comp_bdev->poller);
+	if (comp_bdev->sw) {
+		_comp_sw_channel_fini(comp_bdev);
+	}
 }
 
 /* Used to reroute destroy_ch to the correct thread */
@@ -1446,6 +1677,9 @@ vbdev_compress_finish(void)
 	}
 	pthread_mutex_destroy(&g_comp_device_qp_lock);
 
+	comp_sw_engine_stop();
+	g_sw_engine_started = false;
+
 	rte_mempool_free(g_comp_op_mp);
 	rte_mempool_free(g_mbuf_mp);
 }
@@ -1734,4 +1968,25 @@ set_compress_pmd(enum compress_pmd *opts)
 	return 0;
 }
 
+int
+set_compress_sw_opts(const struct compress_sw_opts *opts)
+{
+	if (opts->level > COMP_SW_LEVEL_MAX) {
+		return -EINVAL;
+	}
+	if (g_sw_engine_started && opts->num_workers != g_sw_opts.num_workers) {
+		return -EBUSY;
+	}
+
+	g_sw_opts = *opts;
+
+	return 0;
+}
+
+void
+get_compress_sw_opts(struct compress_sw_opts *opts)
+{
+	*opts = g_sw_opts;
+}
+
 SPDK_LOG_REGISTER_COMPONENT("vbdev_compress", SPDK_LOG_VBDEV_COMPRESS)
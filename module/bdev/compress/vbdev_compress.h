@@ -73,11 +73,36 @@ enum compress_pmd {
 	COMPRESS_PMD_AUTO = 0,
 	COMPRESS_PMD_QAT_ONLY,
 	COMPRESS_PMD_ISAL_ONLY,
+	/* The software engine built on ISA-L, needs no DPDK compressdev. */
+	COMPRESS_PMD_SW_ONLY,
 	COMPRESS_PMD_MAX
 };
 
 int set_compress_pmd(enum compress_pmd *opts);
 
+struct compress_sw_opts {
+	/* ISA-L compression level, from 0 (fastest) to 3 (best ratio). */
+	uint32_t	level;
+	/*
+	 * Threads running the software engine. With 0, each compress bdev runs
+	 * its operations from its poller instead.
+	 */
+	uint32_t	num_workers;
+};
+
+/**
+ * Set the options of the software compression engine. The level applies to
+ * operations submitted afterwards. The number of workers can't change once a
+ * compress bdev started them.
+ *
+ * \param opts Options to set.
+ * \return 0 on success, -EINVAL for an invalid level, -EBUSY if the number of
+ * workers can't change anymore.
+ */
+int set_compress_sw_opts(const struct compress_sw_opts *opts);
+
+void get_compress_sw_opts(struct compress_sw_opts *opts);
+
 typedef void (*spdk_delete_compress_complete)(void *cb_arg, int bdeverrno);
 
 /**
@@ -144,6 +144,45 @@ spdk_rpc_set_compress_pmd(struct spdk_jsonrpc_request *request,
 SPDK_RPC_REGISTER("set_compress_pmd", spdk_rpc_set_compress_pmd,
 		  SPDK_RPC_STARTUP | SPDK_RPC_RUNTIME)
 
+static const struct spdk_json_object_decoder rpc_compress_sw_opts_decoders[] = {
+	{"level", offsetof(struct compress_sw_opts, level), spdk_json_decode_uint32, true},
+	{
+		"num_workers", offsetof(struct compress_sw_opts, num_workers),
+		spdk_json_decode_uint32, true
+	},
+};
+
+static void
+spdk_rpc_bdev_compress_set_sw_options(struct spdk_jsonrpc_request *request,
+				      const struct spdk_json_val *params)
+{
+	struct compress_sw_opts opts;
+	struct spdk_json_write_ctx *w;
+	int rc;
+
+	get_compress_sw_opts(&opts);
+	if (params && spdk_json_decode_object(params, rpc_compress_sw_opts_decoders,
+					      SPDK_COUNTOF(rpc_compress_sw_opts_decoders),
+					      &opts)) {
+		SPDK_ERRLOG("spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		return;
+	}
+
+	rc = set_compress_sw_opts(&opts);
+	if (rc) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+}
+SPDK_RPC_REGISTER("bdev_compress_set_sw_options", spdk_rpc_bdev_compress_set_sw_options,
+		  SPDK_RPC_STARTUP | SPDK_RPC_RUNTIME)
+
 /* Structure to hold the parameters for this RPC method. */
 struct rpc_construct_compress {
 	char *base_bdev_name;
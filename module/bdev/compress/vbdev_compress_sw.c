@@ -0,0 +1,349 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "vbdev_compress_sw.h"
+
+#include "spdk/env.h"
+#include "spdk/string.h"
+#include "spdk/util.h"
+
+#include "spdk_internal/log.h"
+
+#include "isa-l/include/igzip_lib.h"
+
+struct comp_sw_ctx {
+	struct isal_zstream	stream;
+	struct inflate_state	inflate;
+	uint8_t			*level_buf;
+};
+
+/* Size of the ISA-L level buffer for each level. Levels above 0 need one. */
+static const uint32_t g_comp_sw_level_buf_size[COMP_SW_LEVEL_MAX + 1] = {
+	ISAL_DEF_LVL0_DEFAULT,
+	ISAL_DEF_LVL1_DEFAULT,
+	ISAL_DEF_LVL2_DEFAULT,
+	ISAL_DEF_LVL3_DEFAULT,
+};
+
+struct comp_sw_worker {
+	pthread_t		tid;
+	struct comp_sw_ctx	*ctx;
+};
+
+static struct {
+	pthread_mutex_t			lock;
+	pthread_cond_t			cond;
+	TAILQ_HEAD(, comp_sw_op)	ops;
+	bool				stop;
+	/* Workers with a codec context, and how many of them run a thread. */
+	uint32_t			num_workers;
+	uint32_t			num_started;
+	struct comp_sw_worker		*workers;
+} g_comp_sw = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+	.ops = TAILQ_HEAD_INITIALIZER(g_comp_sw.ops),
+};
+
+struct comp_sw_ctx *
+comp_sw_ctx_alloc(void)
+{
+	struct comp_sw_ctx *ctx;
+	uint32_t size = 0;
+	int i;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		return NULL;
+	}
+
+	for (i = 0; i <= COMP_SW_LEVEL_MAX; i++) {
+		size = spdk_max(size, g_comp_sw_level_buf_size[i]);
+	}
+	ctx->level_buf = malloc(size);
+	if (ctx->level_buf == NULL) {
+		free(ctx);
+		return NULL;
+	}
+
+	return ctx;
+}
+
+void
+comp_sw_ctx_free(struct comp_sw_ctx *ctx)
+{
+	if (ctx == NULL) {
+		return;
+	}
+
+	free(ctx->level_buf);
+	free(ctx);
+}
+
+int
+comp_sw_deflate(struct comp_sw_ctx *ctx, uint32_t level,
+		const struct iovec *src_iovs, int src_iovcnt,
+		const struct iovec *dst_iovs, int dst_iovcnt)
+{
+	struct isal_zstream *stream = &ctx->stream;
+	int src_idx = 0, dst_idx = 0;
+	int rc;
+
+	if (level > COMP_SW_LEVEL_MAX) {
+		return -EINVAL;
+	}
+
+	/* The buffers are left over from the last op, which may have failed midway. */
+	isal_deflate_init(stream);
+	stream->next_in = NULL;
+	stream->avail_in = 0;
+	stream->next_out = NULL;
+	stream->avail_out = 0;
+	stream->level = level;
+	stream->level_buf = ctx->level_buf;
+	stream->level_buf_size = g_comp_sw_level_buf_size[level];
+	stream->flush = NO_FLUSH;
+	stream->end_of_stream = src_iovcnt == 0;
+
+	do {
+		/* Feed one source buffer at a time, skipping empty ones. */
+		while (stream->avail_in == 0 && src_idx < src_iovcnt) {
+			stream->next_in = src_iovs[src_idx].iov_base;
+			stream->avail_in = src_iovs[src_idx].iov_len;
+			src_idx++;
+			stream->end_of_stream = src_idx == src_iovcnt;
+		}
+		while (stream->avail_out == 0) {
+			if (dst_idx == dst_iovcnt) {
+				return -ENOSPC;
+			}
+			stream->next_out = dst_iovs[dst_idx].iov_base;
+			stream->avail_out = dst_iovs[dst_idx].iov_len;
+			dst_idx++;
+		}
+
+		rc = isal_deflate(stream);
+		if (rc != COMP_OK) {
+			SPDK_ERRLOG("isal_deflate() failed with %d\n", rc);
+			return -EIO;
+		}
+	} while (stream->internal_state.state != ZSTATE_END);
+
+	return stream->total_out;
+}
+
+int
+comp_sw_inflate(struct comp_sw_ctx *ctx,
+		const struct iovec *src_iovs, int src_iovcnt,
+		const struct iovec *dst_iovs, int dst_iovcnt)
+{
+	struct inflate_state *state = &ctx->inflate;
+	int src_idx = 0, dst_idx = 0;
+	uint32_t avail_in, total_out;
+	int rc;
+
+	isal_inflate_init(state);
+	state->next_in = NULL;
+	state->avail_in = 0;
+	state->next_out = NULL;
+	state->avail_out = 0;
+	state->crc_flag = ISAL_DEFLATE;
+
+	do {
+		while (state->avail_in == 0 && src_idx < src_iovcnt) {
+			state->next_in = src_iovs[src_idx].iov_base;
+			state->avail_in = src_iovs[src_idx].iov_len;
+			src_idx++;
+		}
+		while (state->avail_out == 0) {
+			if (dst_idx == dst_iovcnt) {
+				return -ENOSPC;
+			}
+			state->next_out = dst_iovs[dst_idx].iov_base;
+			state->avail_out = dst_iovs[dst_idx].iov_len;
+			dst_idx++;
+		}
+
+		avail_in = state->avail_in;
+		total_out = state->total_out;
+		rc = isal_inflate(state);
+		if (rc < 0) {
+			return -EIO;
+		}
+
+		/* With room left for output, no progress means the stream is truncated. */
+		if (state->block_state != ISAL_BLOCK_FINISH &&
+		    state->avail_in == avail_in && state->total_out == total_out) {
+			return -EIO;
+		}
+	} while (state->block_state != ISAL_BLOCK_FINISH);
+
+	return state->total_out;
+}
+
+void
+comp_sw_op_execute(struct comp_sw_ctx *ctx, struct comp_sw_op *op)
+{
+	if (op->compress) {
+		op->result = comp_sw_deflate(ctx, op->level, op->src_iovs, op->src_iovcnt,
+					     op->dst_iovs, op->dst_iovcnt);
+	} else {
+		op->result = comp_sw_inflate(ctx, op->src_iovs, op->src_iovcnt,
+					     op->dst_iovs, op->dst_iovcnt);
+	}
+}
+
+static void *
+comp_sw_worker_fn(void *arg)
+{
+	struct comp_sw_worker *worker = arg;
+	struct comp_sw_op *op;
+	size_t rc __attribute__((unused));
+
+	pthread_mutex_lock(&g_comp_sw.lock);
+	while (true) {
+		op = TAILQ_FIRST(&g_comp_sw.ops);
+		if (op == NULL) {
+			if (g_comp_sw.stop) {
+				break;
+			}
+			pthread_cond_wait(&g_comp_sw.cond, &g_comp_sw.lock);
+			continue;
+		}
+		TAILQ_REMOVE(&g_comp_sw.ops, op, link);
+		pthread_mutex_unlock(&g_comp_sw.lock);
+
+		comp_sw_op_execute(worker->ctx, op);
+		rc = spdk_ring_enqueue(op->cq, (void **)&op, 1, NULL);
+		assert(rc == 1);
+
+		pthread_mutex_lock(&g_comp_sw.lock);
+	}
+	pthread_mutex_unlock(&g_comp_sw.lock);
+
+	return NULL;
+}
+
+/* Called with the affinity of all cores, which the workers inherit. */
+static void *
+_comp_sw_engine_start(void *arg)
+{
+	struct comp_sw_worker *worker;
+	uint32_t i;
+	int rc;
+
+	for (i = 0; i < g_comp_sw.num_workers; i++) {
+		worker = &g_comp_sw.workers[i];
+		rc = pthread_create(&worker->tid, NULL, comp_sw_worker_fn, worker);
+		if (rc != 0) {
+			SPDK_ERRLOG("could not create compress worker thread: %s\n",
+				    spdk_strerror(rc));
+			return NULL;
+		}
+		g_comp_sw.num_started++;
+	}
+
+	return &g_comp_sw;
+}
+
+int
+comp_sw_engine_start(uint32_t num_workers)
+{
+	uint32_t i;
+
+	assert(g_comp_sw.workers == NULL);
+	if (num_workers == 0) {
+		return -EINVAL;
+	}
+
+	g_comp_sw.workers = calloc(num_workers, sizeof(struct comp_sw_worker));
+	if (g_comp_sw.workers == NULL) {
+		return -ENOMEM;
+	}
+
+	g_comp_sw.stop = false;
+	g_comp_sw.num_workers = num_workers;
+	for (i = 0; i < num_workers; i++) {
+		g_comp_sw.workers[i].ctx = comp_sw_ctx_alloc();
+		if (g_comp_sw.workers[i].ctx == NULL) {
+			comp_sw_engine_stop();
+			return -ENOMEM;
+		}
+	}
+
+	if (spdk_call_unaffinitized(_comp_sw_engine_start, NULL) == NULL) {
+		comp_sw_engine_stop();
+		return -EIO;
+	}
+
+	return 0;
+}
+
+void
+comp_sw_engine_stop(void)
+{
+	uint32_t i;
+
+	if (g_comp_sw.workers == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&g_comp_sw.lock);
+	assert(TAILQ_EMPTY(&g_comp_sw.ops));
+	g_comp_sw.stop = true;
+	pthread_cond_broadcast(&g_comp_sw.cond);
+	pthread_mutex_unlock(&g_comp_sw.lock);
+
+	for (i = 0; i < g_comp_sw.num_started; i++) {
+		pthread_join(g_comp_sw.workers[i].tid, NULL);
+	}
+	for (i = 0; i < g_comp_sw.num_workers; i++) {
+		comp_sw_ctx_free(g_comp_sw.workers[i].ctx);
+	}
+
+	free(g_comp_sw.workers);
+	g_comp_sw.workers = NULL;
+	g_comp_sw.num_workers = 0;
+	g_comp_sw.num_started = 0;
+}
+
+void
+comp_sw_engine_submit(struct comp_sw_op *op)
+{
+	assert(g_comp_sw.num_started > 0);
+
+	pthread_mutex_lock(&g_comp_sw.lock);
+	TAILQ_INSERT_TAIL(&g_comp_sw.ops, op, link);
+	pthread_cond_signal(&g_comp_sw.cond);
+	pthread_mutex_unlock(&g_comp_sw.lock);
+}
@@ -0,0 +1,117 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Software deflate engine of the compress vbdev, built on ISA-L. It is used
+ * when no DPDK compressdev is available or when selected explicitly. The
+ * output is raw deflate, the format the compressdev PMDs produce, so a volume
+ * can be moved between the engine and the PMDs.
+ */
+
+#ifndef SPDK_VBDEV_COMPRESS_SW_H
+#define SPDK_VBDEV_COMPRESS_SW_H
+
+#include "spdk/stdinc.h"
+#include "spdk/queue.h"
+
+#define COMP_SW_LEVEL_MIN	0
+#define COMP_SW_LEVEL_MAX	3
+#define COMP_SW_LEVEL_DEFAULT	1
+
+struct spdk_ring;
+
+/* Codec state. Not thread safe, each thread needs its own. */
+struct comp_sw_ctx;
+
+/* An operation handed to the engine. */
+struct comp_sw_op {
+	struct iovec			*src_iovs;
+	int				src_iovcnt;
+	struct iovec			*dst_iovs;
+	int				dst_iovcnt;
+	bool				compress;
+	uint32_t			level;
+	/* Number of bytes produced, or a negative errno. Set by the engine. */
+	int				result;
+	/* Ring the op is enqueued on once it was executed by a worker. */
+	struct spdk_ring		*cq;
+	void				*cb_arg;
+	TAILQ_ENTRY(comp_sw_op)		link;
+};
+
+struct comp_sw_ctx *comp_sw_ctx_alloc(void);
+
+void comp_sw_ctx_free(struct comp_sw_ctx *ctx);
+
+/**
+ * Compress the source buffers into the destination buffers.
+ *
+ * \return the number of bytes produced, -ENOSPC if the destination buffers are
+ * too small, or another negative errno on failure.
+ */
+int comp_sw_deflate(struct comp_sw_ctx *ctx, uint32_t level,
+		    const struct iovec *src_iovs, int src_iovcnt,
+		    const struct iovec *dst_iovs, int dst_iovcnt);
+
+/**
+ * Decompress the source buffers into the destination buffers.
+ *
+ * \return the number of bytes produced, -ENOSPC if the destination buffers are
+ * too small, or -EIO if the source is not a complete deflate stream.
+ */
+int comp_sw_inflate(struct comp_sw_ctx *ctx,
+		    const struct iovec *src_iovs, int src_iovcnt,
+		    const struct iovec *dst_iovs, int dst_iovcnt);
+
+/* Run an operation on the calling thread and set its result. */
+void comp_sw_op_execute(struct comp_sw_ctx *ctx, struct comp_sw_op *op);
+
+/**
+ * Start the worker threads of the engine. The workers are not pinned to the
+ * cores of the reactors.
+ *
+ * \param num_workers Number of worker threads, at least 1.
+ * \return 0 on success, negative errno on failure.
+ */
+int comp_sw_engine_start(uint32_t num_workers);
+
+/* Stop the worker threads. Operations must not be outstanding. */
+void comp_sw_engine_stop(void);
+
+/**
+ * Queue an operation to the worker threads. Once executed, the op is enqueued
+ * on op->cq, which must have room for it.
+ */
+void comp_sw_engine_submit(struct comp_sw_op *op);
+
+#endif /* SPDK_VBDEV_COMPRESS_SW_H */
@@ -0,0 +1,1768 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Deduplicating virtual bdev. The vbdev is divided into fixed size logical
+ * chunks, each mapped to a physical chunk of the base bdev. Chunks with the same
+ * content share one physical chunk, found through an in-memory index of the
+ * fingerprints of all physical chunks. A fingerprint match is always confirmed
+ * by comparing the data, so fingerprints only need to be good hints.
+ *
+ * Layout of the base bdev:
+ *  - block 0: superblock
+ *  - the chunk map, with the physical chunk of every logical chunk
+ *  - the fingerprints of the physical chunks
+ *  - the physical chunks, starting at a chunk aligned block
+ *
+ * Physical chunks are never modified while in use. A write goes to a free chunk,
+ * or maps the logical chunk to an existing one with the same data, and the map
+ * entry is written once the data is on the base bdev. The old chunk is released
+ * after the map entry is written, so the map always points to valid data. Like
+ * lib/reduce, reference counts are not stored, but rebuilt from the map on load.
+ * Fingerprints are written along with the map entry, but a stale one only costs
+ * a missed deduplication.
+ *
+ * All state of a vbdev is owned by the thread that created it, and I/O is sent
+ * to that thread like the compress vbdev does.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "vbdev_dedup.h"
+
+#include "spdk/assert.h"
+#include "spdk/bdev_module.h"
+#include "spdk/crc32.h"
+#include "spdk/env.h"
+#include "spdk/json.h"
+#include "spdk/string.h"
+#include "spdk/thread.h"
+#include "spdk/util.h"
+#include "spdk/uuid.h"
+
+#include "spdk_internal/log.h"
+#include "spdk_internal/vbdev_md.h"
+
+#if defined(__x86_64__) && defined(__SSE4_2__)
+#include <x86intrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#define DEDUP_SB_MAGIC			"SPDKDDUP"
+#define DEDUP_SB_VERSION		1
+#define DEDUP_DEFAULT_CHUNK_SIZE	4096
+#define DEDUP_MAX_CHUNK_SIZE		(128 * 1024)
+/* Chunk operations in progress, each with two chunk buffers */
+#define DEDUP_OPS			64
+#define DEDUP_FP_LANES			4
+#define DEDUP_NONE			UINT32_MAX
+
+struct dedup_sb {
+	struct spdk_vbdev_md_sb	hdr;
+	uint32_t		block_size;
+	uint32_t		chunk_blocks;
+	uint64_t		num_lchunks;
+	uint64_t		num_pchunks;
+	uint64_t		map_offset;
+	uint64_t		map_blocks;
+	uint64_t		fp_offset;
+	uint64_t		fp_blocks;
+	uint64_t		data_offset;
+	uint64_t		base_blockcnt;
+	struct spdk_uuid	uuid;
+};
+SPDK_STATIC_ASSERT(sizeof(struct dedup_sb) <= 512, "dedup superblock does not fit a block");
+
+struct dedup_fp {
+	uint32_t		lane[DEDUP_FP_LANES];
+};
+
+struct dedup_geometry {
+	uint32_t		chunk_blocks;
+	uint64_t		num_lchunks;
+	uint64_t		num_pchunks;
+	uint64_t		map_offset;
+	uint64_t		map_blocks;
+	uint64_t		fp_offset;
+	uint64_t		fp_blocks;
+	uint64_t		data_offset;
+	uint32_t		map_per_page;
+	uint32_t		fp_per_page;
+};
+
+struct dedup_pchunk {
+	struct dedup_fp		fp;
+	/* Map entries and I/O using the chunk. Free chunks are not in the index. */
+	uint32_t		refcnt;
+	/* Next chunk in the same index bucket, or in the free list */
+	uint32_t		next;
+};
+
+struct vbdev_dedup_io;
+
+/* Write of one logical chunk */
+struct dedup_op {
+	struct vbdev_dedup		*dedup;
+	struct vbdev_dedup_io		*io;
+	uint64_t			lchunk;
+	uint32_t			first;
+	uint32_t			num_blocks;
+	/* Offset of the data of the op in the iovecs of the I/O */
+	uint64_t			iov_offset;
+	/* Write zeroes instead of data from the I/O */
+	bool				zeroes;
+	/* The whole chunk is in buf, merged with the old data for partial writes */
+	bool				merged;
+	bool				failed;
+	/* Map entries (physical chunk + 1, or 0 for a chunk of zeroes) */
+	uint32_t			old_ref;
+	uint32_t			new_ref;
+	/* Physical chunk with the same fingerprint being compared */
+	uint32_t			candidate;
+	/* Steps of the op in progress, the op finishes when none are left */
+	uint32_t			pending;
+	struct dedup_fp			fp;
+	/* The data to write, either buf or the iovecs of the I/O */
+	struct iovec			*iovs;
+	int				iovcnt;
+	struct iovec			iov;
+	void				*buf;
+	void				*cmp_buf;
+	struct spdk_vbdev_md_wait	map_wait;
+	struct spdk_vbdev_md_wait	fp_wait;
+	struct spdk_bdev_io_wait_entry	bdev_io_wait;
+	TAILQ_ENTRY(dedup_op)		link;
+	/* Ops for the same logical chunk, waiting for this one to finish */
+	TAILQ_HEAD(, dedup_op)		waiters;
+};
+
+struct dedup_stats {
+	uint64_t			dedup_hits;
+	uint64_t			fp_mismatches;
+	uint64_t			zero_chunks;
+	uint64_t			chunk_writes;
+	uint64_t			merges;
+	uint64_t			no_space;
+};
+
+struct vbdev_dedup {
+	struct spdk_bdev		bdev;
+	struct spdk_bdev		*base_bdev;
+	struct spdk_bdev_desc		*base_desc;
+	struct spdk_io_channel		*base_ch;
+	/* The superblock, the map and the fingerprints. Its thread owns all the state. */
+	struct spdk_vbdev_md		md;
+
+	uint32_t			block_size;
+	uint32_t			chunk_shift;
+	size_t				chunk_size;
+	struct dedup_geometry		geo;
+
+	/* Map entry of each logical chunk */
+	uint32_t			*map;
+	uint64_t			mapped_chunks;
+	struct dedup_pchunk		*pchunks;
+	uint32_t			*index;
+	uint64_t			index_mask;
+	uint32_t			free_head;
+	uint64_t			num_free;
+
+	struct dedup_op			ops[DEDUP_OPS];
+	TAILQ_HEAD(, dedup_op)		free_ops;
+	TAILQ_HEAD(, dedup_op)		active_ops;
+	/* I/O waiting for an op */
+	TAILQ_HEAD(, vbdev_dedup_io)	op_waiters;
+	bool				resuming;
+
+	/* User I/O in progress */
+	uint64_t			outstanding;
+	bool				removing;
+	struct dedup_stats		stats;
+
+	vbdev_dedup_create_cb		create_cb;
+	void				*create_cb_arg;
+
+	TAILQ_ENTRY(vbdev_dedup)	link;
+};
+
+struct vbdev_dedup_io {
+	struct vbdev_dedup		*dedup;
+	enum spdk_bdev_io_status	status;
+	/* Map entry a read holds a reference to */
+	uint32_t			ref;
+	/* Next block to start an op for, and the ops in progress */
+	uint64_t			next_block;
+	uint32_t			ops_outstanding;
+	bool				failed;
+	/* Queued on op_waiters */
+	bool				waiting;
+	/* In dedup_io_start_ops(), ops completing inline must not start more */
+	bool				starting;
+	struct spdk_bdev_io_wait_entry	bdev_io_wait;
+	TAILQ_ENTRY(vbdev_dedup_io)	link;
+};
+
+struct dedup_io_channel {
+	struct vbdev_dedup		*dedup;
+};
+
+static int vbdev_dedup_init(void);
+static void vbdev_dedup_finish(void);
+static int vbdev_dedup_get_ctx_size(void);
+static int vbdev_dedup_config_json(struct spdk_json_write_ctx *w);
+
+static struct spdk_bdev_module dedup_if = {
+	.name = "dedup",
+	.module_init = vbdev_dedup_init,
+	.module_fini = vbdev_dedup_finish,
+	.get_ctx_size = vbdev_dedup_get_ctx_size,
+	.config_json = vbdev_dedup_config_json,
+};
+
+SPDK_BDEV_MODULE_REGISTER(dedup, &dedup_if)
+
+static TAILQ_HEAD(, vbdev_dedup) g_dedups = TAILQ_HEAD_INITIALIZER(g_dedups);
+
+/* Fingerprints */
+
+static inline uint32_t
+dedup_crc32c_u64(uint32_t crc, uint64_t word)
+{
+#if defined(__x86_64__) && defined(__SSE4_2__)
+	return (uint32_t)_mm_crc32_u64(crc, word);
+#elif defined(__ARM_FEATURE_CRC32)
+	return __crc32cd(crc, word);
+#else
+	return spdk_crc32c_update(&word, sizeof(word), crc);
+#endif
+}
+
+static const uint32_t g_fp_seeds[DEDUP_FP_LANES] = {
+	0xffffffff, 0x9e3779b9, 0x85ebca6b, 0xc2b2ae35
+};
+
+/*
+ * Compute the fingerprint of a chunk: a CRC32C of every fourth 64-bit word, in
+ * four lanes. The lanes are independent, so the CRC32 instructions of all four
+ * run in parallel, and together they give a 128-bit fingerprint. The result does
+ * not depend on how the data is split into iovecs, as long as every iovec holds a
+ * multiple of 32 bytes, which whole blocks do.
+ */
+static void
+dedup_fingerprint(const struct iovec *iovs, int iovcnt, size_t len, struct dedup_fp *fp)
+{
+	uint32_t l0 = g_fp_seeds[0], l1 = g_fp_seeds[1], l2 = g_fp_seeds[2], l3 = g_fp_seeds[3];
+	const uint8_t *p, *end;
+	uint64_t w[DEDUP_FP_LANES];
+	size_t n;
+	int i;
+
+	for (i = 0; i < iovcnt && len > 0; i++) {
+		n = spdk_min(len, iovs[i].iov_len);
+		assert(n % sizeof(w) == 0);
+		p = iovs[i].iov_base;
+		for (end = p + n; p < end; p += sizeof(w)) {
+			memcpy(w, p, sizeof(w));
+			l0 = dedup_crc32c_u64(l0, w[0]);
+			l1 = dedup_crc32c_u64(l1, w[1]);
+			l2 = dedup_crc32c_u64(l2, w[2]);
+			l3 = dedup_crc32c_u64(l3, w[3]);
+		}
+		len -= n;
+	}
+
+	fp->lane[0] = l0;
+	fp->lane[1] = l1;
+	fp->lane[2] = l2;
+	fp->lane[3] = l3;
+}
+
+static inline bool
+dedup_fp_equal(const struct dedup_fp *a, const struct dedup_fp *b)
+{
+	return memcmp(a, b, sizeof(*a)) == 0;
+}
+
+static int
+dedup_compute_geometry(uint64_t base_blockcnt, uint32_t block_size, uint32_t chunk_blocks,
+		       uint64_t num_lchunks, struct dedup_geometry *geo)
+{
+	uint64_t num_pchunks;
+
+	if (block_size < sizeof(struct dedup_sb) || block_size % sizeof(struct dedup_fp) != 0) {
+		return -EINVAL;
+	}
+
+	geo->chunk_blocks = chunk_blocks;
+	geo->map_per_page = block_size / sizeof(uint32_t);
+	geo->fp_per_page = block_size / sizeof(struct dedup_fp);
+	geo->map_offset = 1;
+
+	if (base_blockcnt <= geo->map_offset) {
+		return -ENOSPC;
+	}
+
+	/* Without a logical size, expose as many logical chunks as there are physical ones. */
+	if (num_lchunks == 0) {
+		num_lchunks = (base_blockcnt - geo->map_offset) / chunk_blocks;
+		if (num_lchunks == 0 ||
+		    dedup_compute_geometry(base_blockcnt, block_size, chunk_blocks, num_lchunks,
+					   geo) != 0) {
+			return -ENOSPC;
+		}
+		num_lchunks = geo->num_pchunks;
+	}
+
+	geo->num_lchunks = num_lchunks;
+	geo->map_blocks = spdk_divide_round_up(num_lchunks, geo->map_per_page);
+	geo->fp_offset = geo->map_offset + geo->map_blocks;
+	if (num_lchunks >= DEDUP_NONE || geo->fp_offset >= base_blockcnt) {
+		return -ENOSPC;
+	}
+
+	num_pchunks = spdk_min((base_blockcnt - geo->fp_offset) / chunk_blocks, DEDUP_NONE - 1);
+	while (num_pchunks > 0) {
+		geo->fp_blocks = spdk_divide_round_up(num_pchunks, geo->fp_per_page);
+		geo->data_offset = spdk_divide_round_up(geo->fp_offset + geo->fp_blocks,
+							chunk_blocks) * chunk_blocks;
+		if (geo->data_offset + num_pchunks * chunk_blocks <= base_blockcnt) {
+			break;
+		}
+		num_pchunks--;
+	}
+
+	if (num_pchunks == 0) {
+		return -ENOSPC;
+	}
+	geo->num_pchunks = num_pchunks;
+
+	return 0;
+}
+
+/* Index of the fingerprints and references of physical chunks */
+
+static inline uint64_t
+dedup_index_bucket(const struct vbdev_dedup *dedup, const struct dedup_fp *fp)
+{
+	return (((uint64_t)fp->lane[0] << 32) | fp->lane[1]) & dedup->index_mask;
+}
+
+static void
+dedup_index_insert(struct vbdev_dedup *dedup, uint32_t pchunk)
+{
+	uint64_t bucket = dedup_index_bucket(dedup, &dedup->pchunks[pchunk].fp);
+
+	dedup->pchunks[pchunk].next = dedup->index[bucket];
+	dedup->index[bucket] = pchunk;
+}
+
+static void
+dedup_index_remove(struct vbdev_dedup *dedup, uint32_t pchunk)
+{
+	uint32_t *idx = &dedup->index[dedup_index_bucket(dedup, &dedup->pchunks[pchunk].fp)];
+
+	while (*idx != pchunk) {
+		assert(*idx != DEDUP_NONE);
+		idx = &dedup->pchunks[*idx].next;
+	}
+	*idx = dedup->pchunks[pchunk].next;
+}
+
+/* Find a chunk in use with the given fingerprint. */
+static uint32_t
+dedup_index_find(struct vbdev_dedup *dedup, const struct dedup_fp *fp)
+{
+	uint32_t idx = dedup->index[dedup_index_bucket(dedup, fp)];
+
+	while (idx != DEDUP_NONE && !dedup_fp_equal(&dedup->pchunks[idx].fp, fp)) {
+		idx = dedup->pchunks[idx].next;
+	}
+
+	return idx;
+}
+
+static void
+dedup_free_push(struct vbdev_dedup *dedup, uint32_t pchunk)
+{
+	dedup->pchunks[pchunk].next = dedup->free_head;
+	dedup->free_head = pchunk;
+	dedup->num_free++;
+}
+
+static uint32_t
+dedup_free_pop(struct vbdev_dedup *dedup)
+{
+	uint32_t pchunk = dedup->free_head;
+
+	if (pchunk != DEDUP_NONE) {
+		dedup->free_head = dedup->pchunks[pchunk].next;
+		dedup->num_free--;
+	}
+
+	return pchunk;
+}
+
+static inline void
+dedup_ref_get(struct vbdev_dedup *dedup, uint32_t ref)
+{
+	if (ref != 0) {
+		dedup->pchunks[ref - 1].refcnt++;
+	}
+}
+
+/* Drop a reference to a chunk in the index. Unused chunks become free. */
+static void
+dedup_ref_put(struct vbdev_dedup *dedup, uint32_t ref)
+{
+	uint32_t pchunk = ref - 1;
+
+	if (ref == 0) {
+		return;
+	}
+
+	assert(dedup->pchunks[pchunk].refcnt > 0);
+	if (--dedup->pchunks[pchunk].refcnt == 0) {
+		dedup_index_remove(dedup, pchunk);
+		dedup_free_push(dedup, pchunk);
+	}
+}
+
+static inline uint64_t
+dedup_pchunk_offset(const struct vbdev_dedup *dedup, uint32_t pchunk)
+{
+	return dedup->geo.data_offset + (uint64_t)pchunk * dedup->geo.chunk_blocks;
+}
+
+static void
+dedup_queue_retry(struct vbdev_dedup *dedup, struct spdk_bdev_io_wait_entry *wait,
+		  spdk_bdev_io_wait_cb cb_fn, void *cb_arg)
+{
+	int rc;
+
+	wait->bdev = dedup->base_bdev;
+	wait->cb_fn = cb_fn;
+	wait->cb_arg = cb_arg;
+
+	rc = spdk_bdev_queue_io_wait(dedup->base_bdev, dedup->base_ch, wait);
+	if (rc != 0) {
+		SPDK_ERRLOG("Could not queue I/O to %s: %d\n", spdk_bdev_get_name(dedup->base_bdev),
+			    rc);
+		assert(false);
+	}
+}
+
+/* Metadata pages */
+
+static void
+dedup_md_serialize_page(void *ctx, uint64_t page_idx, void *buf)
+{
+	struct vbdev_dedup *dedup = ctx;
+	struct dedup_fp *fp = buf;
+	uint64_t idx, end;
+
+	memset(buf, 0, dedup->block_size);
+
+	if (page_idx < dedup->geo.map_blocks) {
+		idx = page_idx * dedup->geo.map_per_page;
+		end = spdk_min(idx + dedup->geo.map_per_page, dedup->geo.num_lchunks);
+		memcpy(buf, &dedup->map[idx], (end - idx) * sizeof(uint32_t));
+		return;
+	}
+
+	idx = (page_idx - dedup->geo.map_blocks) * dedup->geo.fp_per_page;
+	end = spdk_min(idx + dedup->geo.fp_per_page, dedup->geo.num_pchunks);
+	for (; idx < end; idx++, fp++) {
+		*fp = dedup->pchunks[idx].fp;
+	}
+}
+
+/* Copying between iovecs and buffers */
+
+static void
+dedup_iovs_to_buf(struct iovec *iovs, int iovcnt, size_t offset, void *buf, size_t len)
+{
+	size_t n;
+	int i;
+
+	for (i = 0; i < iovcnt && len > 0; i++) {
+		if (offset >= iovs[i].iov_len) {
+			offset -= iovs[i].iov_len;
+			continue;
+		}
+		n = spdk_min(len, iovs[i].iov_len - offset);
+		memcpy(buf, (uint8_t *)iovs[i].iov_base + offset, n);
+		buf = (uint8_t *)buf + n;
+		len -= n;
+		offset = 0;
+	}
+}
+
+static bool
+dedup_iovs_equal(struct iovec *iovs, int iovcnt, const void *buf, size_t len)
+{
+	size_t n;
+	int i;
+
+	for (i = 0; i < iovcnt && len > 0; i++) {
+		n = spdk_min(len, iovs[i].iov_len);
+		if (memcmp(iovs[i].iov_base, buf, n) != 0) {
+			return false;
+		}
+		buf = (const uint8_t *)buf + n;
+		len -= n;
+	}
+
+	return true;
+}
+
+static bool
+dedup_iovs_all_zero(struct iovec *iovs, int iovcnt, size_t len)
+{
+	size_t n;
+	int i;
+
+	for (i = 0; i < iovcnt && len > 0; i++) {
+		n = spdk_min(len, iovs[i].iov_len);
+		if (!spdk_mem_all_zero(iovs[i].iov_base, n)) {
+			return false;
+		}
+		len -= n;
+	}
+
+	return true;
+}
+
+static void
+dedup_iovs_zero(struct iovec *iovs, int iovcnt)
+{
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		memset(iovs[i].iov_base, 0, iovs[i].iov_len);
+	}
+}
+
+/* User I/O */
+
+static void
+_dedup_complete_io(void *arg)
+{
+	struct spdk_bdev_io *bdev_io = arg;
+	struct vbdev_dedup_io *io = (struct vbdev_dedup_io *)bdev_io->driver_ctx;
+
+	spdk_bdev_io_complete(bdev_io, io->status);
+}
+
+static void
+dedup_io_complete(struct vbdev_dedup_io *io, enum spdk_bdev_io_status status)
+{
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(io);
+	struct spdk_thread *thread = spdk_bdev_io_get_thread(bdev_io);
+
+	io->dedup->outstanding--;
+	io->status = status;
+
+	if (thread != spdk_get_thread()) {
+		spdk_thread_send_msg(thread, _dedup_complete_io, bdev_io);
+	} else {
+		_dedup_complete_io(bdev_io);
+	}
+}
+
+static void
+dedup_read_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct vbdev_dedup_io *io = cb_arg;
+
+	if (bdev_io != NULL) {
+		spdk_bdev_free_io(bdev_io);
+	}
+
+	dedup_ref_put(io->dedup, io->ref);
+	dedup_io_complete(io, success ? SPDK_BDEV_IO_STATUS_SUCCESS : SPDK_BDEV_IO_STATUS_FAILED);
+}
+
+static void
+dedup_read_submit(void *arg)
+{
+	struct vbdev_dedup_io *io = arg;
+	struct vbdev_dedup *dedup = io->dedup;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(io);
+	uint64_t first = bdev_io->u.bdev.offset_blocks & (dedup->geo.chunk_blocks - 1);
+	int rc;
+
+	rc = spdk_bdev_readv_blocks(dedup->base_desc, dedup->base_ch, bdev_io->u.bdev.iovs,
+				    bdev_io->u.bdev.iovcnt,
+				    dedup_pchunk_offset(dedup, io->ref - 1) + first,
+				    bdev_io->u.bdev.num_blocks, dedup_read_done, io);
+	if (rc == -ENOMEM) {
+		dedup_queue_retry(dedup, &io->bdev_io_wait, dedup_read_submit, io);
+	} else if (rc != 0) {
+		dedup_read_done(NULL, false, io);
+	}
+}
+
+static void
+dedup_read(struct vbdev_dedup_io *io)
+{
+	struct vbdev_dedup *dedup = io->dedup;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(io);
+
+	io->ref = dedup->map[bdev_io->u.bdev.offset_blocks >> dedup->chunk_shift];
+	if (io->ref == 0) {
+		dedup_iovs_zero(bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt);
+		dedup_io_complete(io, SPDK_BDEV_IO_STATUS_SUCCESS);
+		return;
+	}
+
+	/* Keep the chunk from being reused until it was read. */
+	dedup_ref_get(dedup, io->ref);
+	dedup_read_submit(io);
+}
+
+/* Chunk writes */
+
+static void dedup_io_start_ops(struct vbdev_dedup_io *io);
+static void dedup_op_start(struct dedup_op *op);
+static void dedup_op_alloc(struct dedup_op *op);
+
+static void
+dedup_op_done(struct dedup_op *op)
+{
+	struct vbdev_dedup *dedup = op->dedup;
+	struct vbdev_dedup_io *io = op->io;
+	TAILQ_HEAD(, dedup_op) waiters = TAILQ_HEAD_INITIALIZER(waiters);
+	struct dedup_op *waiter;
+
+	TAILQ_REMOVE(&dedup->active_ops, op, link);
+	TAILQ_CONCAT(&waiters, &op->waiters, link);
+	TAILQ_INSERT_TAIL(&dedup->free_ops, op, link);
+
+	/* The first waiter takes over the chunk, the others queue up behind it again. */
+	while ((waiter = TAILQ_FIRST(&waiters))) {
+		TAILQ_REMOVE(&waiters, waiter, link);
+		dedup_op_start(waiter);
+	}
+
+	if (op->failed) {
+		io->failed = true;
+	}
+	io->ops_outstanding--;
+	if (!io->starting) {
+		dedup_io_start_ops(io);
+	}
+
+	if (dedup->resuming) {
+		return;
+	}
+
+	dedup->resuming = true;
+	while ((io = TAILQ_FIRST(&dedup->op_waiters)) && !io->starting &&
+	       !TAILQ_EMPTY(&dedup->free_ops)) {
+		dedup_io_start_ops(io);
+	}
+	dedup->resuming = false;
+}
+
+static inline void
+dedup_op_put(struct dedup_op *op)
+{
+	assert(op->pending > 0);
+	if (--op->pending == 0) {
+		dedup_op_done(op);
+	}
+}
+
+static void
+dedup_op_fp_written(void *ctx, int status)
+{
+	struct dedup_op *op = ctx;
+
+	/* Fingerprints are only hints, a stale one costs a missed match after a reload. */
+	dedup_op_put(op);
+}
+
+static void
+dedup_op_map_written(void *ctx, int status)
+{
+	struct dedup_op *op = ctx;
+
+	if (status != 0) {
+		/*
+		 * The map on disk may still point to the old chunk, so keep it until the
+		 * reference counts are rebuilt on the next load.
+		 */
+		op->failed = true;
+	} else {
+		dedup_ref_put(op->dedup, op->old_ref);
+	}
+
+	dedup_op_put(op);
+}
+
+/* Point the logical chunk to new_ref, which the op holds a reference to. */
+static void
+dedup_op_map(struct dedup_op *op)
+{
+	struct vbdev_dedup *dedup = op->dedup;
+
+	if (op->new_ref == op->old_ref) {
+		dedup_ref_put(dedup, op->new_ref);
+		dedup_op_put(op);
+		return;
+	}
+
+	if (op->old_ref == 0) {
+		dedup->mapped_chunks++;
+	} else if (op->new_ref == 0) {
+		dedup->mapped_chunks--;
+	}
+
+	dedup->map[op->lchunk] = op->new_ref;
+	op->map_wait.cb_fn = dedup_op_map_written;
+	op->map_wait.ctx = op;
+	spdk_vbdev_md_update(&dedup->md, op->lchunk / dedup->geo.map_per_page, &op->map_wait);
+}
+
+static void
+dedup_op_write_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct dedup_op *op = cb_arg;
+	struct vbdev_dedup *dedup = op->dedup;
+	uint32_t pchunk = op->new_ref - 1;
+
+	if (bdev_io != NULL) {
+		spdk_bdev_free_io(bdev_io);
+	}
+
+	if (!success) {
+		/* The chunk is not in the index yet. */
+		dedup->pchunks[pchunk].refcnt = 0;
+		dedup_free_push(dedup, pchunk);
+		op->failed = true;
+		dedup_op_put(op);
+		return;
+	}
+
+	/* Only now other writes may find the chunk. */
+	dedup->pchunks[pchunk].fp = op->fp;
+	dedup_index_insert(dedup, pchunk);
+
+	op->pending++;
+	op->fp_wait.cb_fn = dedup_op_fp_written;
+	op->fp_wait.ctx = op;
+	spdk_vbdev_md_update(&dedup->md, dedup->geo.map_blocks + pchunk / dedup->geo.fp_per_page,
+			     &op->fp_wait);
+
+	dedup_op_map(op);
+}
+
+static void
+dedup_op_write_submit(void *arg)
+{
+	struct dedup_op *op = arg;
+	struct vbdev_dedup *dedup = op->dedup;
+	int rc;
+
+	rc = spdk_bdev_writev_blocks(dedup->base_desc, dedup->base_ch, op->iovs, op->iovcnt,
+				     dedup_pchunk_offset(dedup, op->new_ref - 1),
+				     dedup->geo.chunk_blocks, dedup_op_write_done, op);
+	if (rc == -ENOMEM) {
+		dedup_queue_retry(dedup, &op->bdev_io_wait, dedup_op_write_submit, op);
+	} else if (rc != 0) {
+		dedup_op_write_done(NULL, false, op);
+	}
+}
+
+/* Write the data to a free chunk. */
+static void
+dedup_op_alloc(struct dedup_op *op)
+{
+	struct vbdev_dedup *dedup = op->dedup;
+	uint32_t pchunk;
+
+	pchunk = dedup_free_pop(dedup);
+	if (pchunk == DEDUP_NONE) {
+		dedup->stats.no_space++;
+		op->failed = true;
+		dedup_op_put(op);
+		return;
+	}
+
+	dedup->stats.chunk_writes++;
+	dedup->pchunks[pchunk].refcnt = 1;
+	op->new_ref = pchunk + 1;
+	dedup_op_write_submit(op);
+}
+
+static void
+dedup_op_compare_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct dedup_op *op = cb_arg;
+	struct vbdev_dedup *dedup = op->dedup;
+
+	if (bdev_io != NULL) {
+		spdk_bdev_free_io(bdev_io);
+	}
+
+	if (success && dedup_iovs_equal(op->iovs, op->iovcnt, op->cmp_buf, dedup->chunk_size)) {
+		dedup->stats.dedup_hits++;
+		op->new_ref = op->candidate + 1;
+		dedup_op_map(op);
+		return;
+	}
+
+	if (success) {
+		dedup->stats.fp_mismatches++;
+	}
+	dedup_ref_put(dedup, op->candidate + 1);
+	dedup_op_alloc(op);
+}
+
+static void
+dedup_op_compare_submit(void *arg)
+{
+	struct dedup_op *op = arg;
+	struct vbdev_dedup *dedup = op->dedup;
+	int rc;
+
+	rc = spdk_bdev_read_blocks(dedup->base_desc, dedup->base_ch, op->cmp_buf,
+				   dedup_pchunk_offset(dedup, op->candidate),
+				   dedup->geo.chunk_blocks, dedup_op_compare_done, op);
+	if (rc == -ENOMEM) {
+		dedup_queue_retry(dedup, &op->bdev_io_wait, dedup_op_compare_submit, op);
+	} else if (rc != 0) {
+		dedup_op_compare_done(NULL, false, op);
+	}
+}
+
+/* The whole new content of the chunk is in op->iovs, find a chunk holding the same. */
+static void
+dedup_op_lookup(struct dedup_op *op)
+{
+	struct vbdev_dedup *dedup = op->dedup;
+
+	if (dedup_iovs_all_zero(op->iovs, op->iovcnt, dedup->chunk_size)) {
+		dedup->stats.zero_chunks++;
+		op->new_ref = 0;
+		dedup_op_map(op);
+		return;
+	}
+
+	dedup_fingerprint(op->iovs, op->iovcnt, dedup->chunk_size, &op->fp);
+	op->candidate = dedup_index_find(dedup, &op->fp);
+	if (op->candidate == DEDUP_NONE) {
+		dedup_op_alloc(op);
+		return;
+	}
+
+	/* Keep the candidate from being freed and reused while comparing. */
+	dedup_ref_get(dedup, op->candidate + 1);
+	dedup_op_compare_submit(op);
+}
+
+static void
+dedup_op_merge(struct dedup_op *op)
+{
+	struct vbdev_dedup *dedup = op->dedup;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(op->io);
+	uint8_t *dst = (uint8_t *)op->buf + (size_t)op->first * dedup->block_size;
+	size_t len = (size_t)op->num_blocks * dedup->block_size;
+
+	if (op->zeroes) {
+		memset(dst, 0, len);
+	} else {
+		dedup_iovs_to_buf(bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt, op->iov_offset,
+				  dst, len);
+	}
+
+	op->iov.iov_base = op->buf;
+	op->iov.iov_len = dedup->chunk_size;
+	op->iovs = &op->iov;
+	op->iovcnt = 1;
+	dedup_op_lookup(op);
+}
+
+static void
+dedup_op_read_old_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct dedup_op *op = cb_arg;
+
+	if (bdev_io != NULL) {
+		spdk_bdev_free_io(bdev_io);
+	}
+
+	if (!success) {
+		op->failed = true;
+		dedup_op_put(op);
+		return;
+	}
+
+	dedup_op_merge(op);
+}
+
+static void
+dedup_op_read_old_submit(void *arg)
+{
+	struct dedup_op *op = arg;
+	struct vbdev_dedup *dedup = op->dedup;
+	int rc;
+
+	rc = spdk_bdev_read_blocks(dedup->base_desc, dedup->base_ch, op->buf,
+				   dedup_pchunk_offset(dedup, op->old_ref - 1),
+				   dedup->geo.chunk_blocks, dedup_op_read_old_done, op);
+	if (rc == -ENOMEM) {
+		dedup_queue_retry(dedup, &op->bdev_io_wait, dedup_op_read_old_submit, op);
+	} else if (rc != 0) {
+		dedup_op_read_old_done(NULL, false, op);
+	}
+}
+
+static void
+dedup_op_start(struct dedup_op *op)
+{
+	struct vbdev_dedup *dedup = op->dedup;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(op->io);
+	struct dedup_op *active;
+
+	/* Writes of the same logical chunk are serialized. */
+	TAILQ_FOREACH(active, &dedup->active_ops, link) {
+		if (active->lchunk == op->lchunk) {
+			TAILQ_INSERT_TAIL(&active->waiters, op, link);
+			return;
+		}
+	}
+
+	TAILQ_INSERT_TAIL(&dedup->active_ops, op, link);
+	op->old_ref = dedup->map[op->lchunk];
+	op->new_ref = 0;
+	op->failed = false;
+	op->pending = 1;
+
+	if (op->num_blocks == dedup->geo.chunk_blocks) {
+		if (op->zeroes) {
+			dedup->stats.zero_chunks++;
+			dedup_op_map(op);
+			return;
+		}
+
+		if (op->iov_offset == 0) {
+			op->iovs = bdev_io->u.bdev.iovs;
+			op->iovcnt = bdev_io->u.bdev.iovcnt;
+			dedup_op_lookup(op);
+			return;
+		}
+	}
+
+	dedup->stats.merges++;
+	if (op->num_blocks == dedup->geo.chunk_blocks || op->old_ref == 0) {
+		memset(op->buf, 0, dedup->chunk_size);
+		dedup_op_merge(op);
+		return;
+	}
+
+	dedup_op_read_old_submit(op);
+}
+
+/*
+ * Start an op for each chunk the I/O covers, as long as there are free ops, and
+ * complete the I/O once all its ops are done. Writes are split on chunk boundaries
+ * by the bdev layer, but unmap and write zeroes I/O may cover many chunks.
+ */
+static void
+dedup_io_start_ops(struct vbdev_dedup_io *io)
+{
+	struct vbdev_dedup *dedup = io->dedup;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(io);
+	uint64_t end = bdev_io->u.bdev.offset_blocks + bdev_io->u.bdev.num_blocks;
+	uint32_t chunk_blocks = dedup->geo.chunk_blocks;
+	struct dedup_op *op;
+
+	io->starting = true;
+	while (!io->failed && io->next_block < end && (op = TAILQ_FIRST(&dedup->free_ops))) {
+		TAILQ_REMOVE(&dedup->free_ops, op, link);
+		op->io = io;
+		op->lchunk = io->next_block >> dedup->chunk_shift;
+		op->first = io->next_block & (chunk_blocks - 1);
+		op->num_blocks = spdk_min(chunk_blocks - op->first, end - io->next_block);
+		op->iov_offset = (io->next_block - bdev_io->u.bdev.offset_blocks) *
+				 dedup->block_size;
+		op->zeroes = bdev_io->type != SPDK_BDEV_IO_TYPE_WRITE;
+		io->next_block += op->num_blocks;
+		io->ops_outstanding++;
+		dedup_op_start(op);
+	}
+	io->starting = false;
+
+	if (!io->failed && io->next_block < end) {
+		if (!io->waiting) {
+			io->waiting = true;
+			TAILQ_INSERT_TAIL(&dedup->op_waiters, io, link);
+		}
+		return;
+	}
+
+	if (io->waiting) {
+		io->waiting = false;
+		TAILQ_REMOVE(&dedup->op_waiters, io, link);
+	}
+
+	if (io->ops_outstanding == 0) {
+		dedup_io_complete(io, io->failed ? SPDK_BDEV_IO_STATUS_FAILED :
+				  SPDK_BDEV_IO_STATUS_SUCCESS);
+	}
+}
+
+static void
+dedup_flush_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct vbdev_dedup_io *io = cb_arg;
+
+	if (bdev_io != NULL) {
+		spdk_bdev_free_io(bdev_io);
+	}
+
+	dedup_io_complete(io, success ? SPDK_BDEV_IO_STATUS_SUCCESS : SPDK_BDEV_IO_STATUS_FAILED);
+}
+
+/* Map and data writes complete before the I/O does, so only the base bdev needs a flush. */
+static void
+dedup_flush_submit(void *arg)
+{
+	struct vbdev_dedup_io *io = arg;
+	struct vbdev_dedup *dedup = io->dedup;
+	int rc;
+
+	if (!spdk_bdev_io_type_supported(dedup->base_bdev, SPDK_BDEV_IO_TYPE_FLUSH)) {
+		dedup_flush_done(NULL, true, io);
+		return;
+	}
+
+	rc = spdk_bdev_flush_blocks(dedup->base_desc, dedup->base_ch, 0,
+				    spdk_bdev_get_num_blocks(dedup->base_bdev),
+				    dedup_flush_done, io);
+	if (rc == -ENOMEM) {
+		dedup_queue_retry(dedup, &io->bdev_io_wait, dedup_flush_submit, io);
+	} else if (rc != 0) {
+		dedup_flush_done(NULL, false, io);
+	}
+}
+
+static void
+_dedup_submit_io(void *arg)
+{
+	struct spdk_bdev_io *bdev_io = arg;
+	struct vbdev_dedup_io *io = (struct vbdev_dedup_io *)bdev_io->driver_ctx;
+	struct vbdev_dedup *dedup = io->dedup;
+
+	dedup->outstanding++;
+
+	switch (bdev_io->type) {
+	case SPDK_BDEV_IO_TYPE_READ:
+		/* The bdev layer splits I/O on chunk boundaries. */
+		assert((bdev_io->u.bdev.offset_blocks & (dedup->geo.chunk_blocks - 1)) +
+		       bdev_io->u.bdev.num_blocks <= dedup->geo.chunk_blocks);
+		dedup_read(io);
+		break;
+	case SPDK_BDEV_IO_TYPE_WRITE:
+	case SPDK_BDEV_IO_TYPE_UNMAP:
+	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
+		io->next_block = bdev_io->u.bdev.offset_blocks;
+		dedup_io_start_ops(io);
+		break;
+	case SPDK_BDEV_IO_TYPE_FLUSH:
+		dedup_flush_submit(io);
+		break;
+	default:
+		SPDK_ERRLOG("dedup: unknown I/O type %d\n", bdev_io->type);
+		dedup_io_complete(io, SPDK_BDEV_IO_STATUS_FAILED);
+		break;
+	}
+}
+
+static void
+dedup_read_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io, bool success)
+{
+	struct vbdev_dedup_io *io = (struct vbdev_dedup_io *)bdev_io->driver_ctx;
+
+	if (!success) {
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
+	spdk_vbdev_md_call(&io->dedup->md, _dedup_submit_io, bdev_io);
+}
+
+static void
+vbdev_dedup_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+{
+	struct vbdev_dedup *dedup = SPDK_CONTAINEROF(bdev_io->bdev, struct vbdev_dedup, bdev);
+	struct vbdev_dedup_io *io = (struct vbdev_dedup_io *)bdev_io->driver_ctx;
+
+	memset(io, 0, sizeof(*io));
+	io->dedup = dedup;
+
+	if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ) {
+		spdk_bdev_io_get_buf(bdev_io, dedup_read_get_buf_cb,
+				     bdev_io->u.bdev.num_blocks * bdev_io->bdev->blocklen);
+		return;
+	}
+
+	spdk_vbdev_md_call(&dedup->md, _dedup_submit_io, bdev_io);
+}
+
+static bool
+vbdev_dedup_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type)
+{
+	switch (io_type) {
+	case SPDK_BDEV_IO_TYPE_READ:
+	case SPDK_BDEV_IO_TYPE_WRITE:
+	case SPDK_BDEV_IO_TYPE_FLUSH:
+	case SPDK_BDEV_IO_TYPE_UNMAP:
+	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Loading and formatting */
+
+static int
+dedup_md_parse_page(void *ctx, uint64_t page_idx, void *buf)
+{
+	struct vbdev_dedup *dedup = ctx;
+	const struct dedup_fp *fp = buf;
+	uint64_t idx, end;
+
+	if (page_idx < dedup->geo.map_blocks) {
+		idx = page_idx * dedup->geo.map_per_page;
+		end = spdk_min(idx + dedup->geo.map_per_page, dedup->geo.num_lchunks);
+		memcpy(&dedup->map[idx], buf, (end - idx) * sizeof(uint32_t));
+		for (; idx < end; idx++) {
+			if (dedup->map[idx] > dedup->geo.num_pchunks) {
+				SPDK_ERRLOG("Logical chunk %" PRIu64 " of %s maps to chunk %u of %"
+					    PRIu64 "\n", idx, dedup->bdev.name, dedup->map[idx] - 1,
+					    dedup->geo.num_pchunks);
+				return -EILSEQ;
+			}
+		}
+		return 0;
+	}
+
+	idx = (page_idx - dedup->geo.map_blocks) * dedup->geo.fp_per_page;
+	end = spdk_min(idx + dedup->geo.fp_per_page, dedup->geo.num_pchunks);
+	for (; idx < end; idx++, fp++) {
+		dedup->pchunks[idx].fp = *fp;
+	}
+
+	return 0;
+}
+
+static const struct spdk_vbdev_md_ops dedup_md_ops = {
+	.magic		= DEDUP_SB_MAGIC,
+	.version	= DEDUP_SB_VERSION,
+	.sb_size	= sizeof(struct dedup_sb),
+	.serialize_page	= dedup_md_serialize_page,
+	.parse_page	= dedup_md_parse_page,
+};
+
+static void
+dedup_sb_write(struct vbdev_dedup *dedup, spdk_vbdev_md_cb cb)
+{
+	struct dedup_sb *sb = dedup->md.sb;
+
+	memset(sb, 0, dedup->block_size);
+	sb->block_size = dedup->block_size;
+	sb->chunk_blocks = dedup->geo.chunk_blocks;
+	sb->num_lchunks = dedup->geo.num_lchunks;
+	sb->num_pchunks = dedup->geo.num_pchunks;
+	sb->map_offset = dedup->geo.map_offset;
+	sb->map_blocks = dedup->geo.map_blocks;
+	sb->fp_offset = dedup->geo.fp_offset;
+	sb->fp_blocks = dedup->geo.fp_blocks;
+	sb->data_offset = dedup->geo.data_offset;
+	sb->base_blockcnt = spdk_bdev_get_num_blocks(dedup->base_bdev);
+	spdk_uuid_copy(&sb->uuid, &dedup->bdev.uuid);
+
+	spdk_vbdev_md_sb_write(&dedup->md, cb);
+}
+
+/* Creation and deletion */
+
+static void
+dedup_free(struct vbdev_dedup *dedup)
+{
+	uint32_t i;
+
+	for (i = 0; i < DEDUP_OPS; i++) {
+		spdk_dma_free(dedup->ops[i].buf);
+		spdk_dma_free(dedup->ops[i].cmp_buf);
+	}
+	spdk_vbdev_md_free(&dedup->md);
+	free(dedup->map);
+	free(dedup->pchunks);
+	free(dedup->index);
+	free(dedup->bdev.name);
+	free(dedup);
+}
+
+static void
+dedup_close_bdev(struct vbdev_dedup *dedup)
+{
+	if (dedup->base_ch != NULL) {
+		spdk_put_io_channel(dedup->base_ch);
+	}
+	if (dedup->base_desc != NULL) {
+		spdk_bdev_module_release_bdev(dedup->base_bdev);
+		spdk_bdev_close(dedup->base_desc);
+	}
+}
+
+static void
+_device_unregister_cb(void *io_device)
+{
+	dedup_free(io_device);
+}
+
+/* The map is written before I/O completes, so there is nothing to save. */
+static void
+dedup_stop_done(void *ctx, int status)
+{
+	struct vbdev_dedup *dedup = ctx;
+
+	dedup_close_bdev(dedup);
+	spdk_bdev_destruct_done(&dedup->bdev, status);
+	spdk_io_device_unregister(dedup, _device_unregister_cb);
+}
+
+static void
+_dedup_stop(void *arg)
+{
+	struct vbdev_dedup *dedup = arg;
+
+	spdk_vbdev_md_drain(&dedup->md, &dedup->outstanding, dedup_stop_done);
+}
+
+static int
+vbdev_dedup_destruct(void *ctx)
+{
+	struct vbdev_dedup *dedup = ctx;
+
+	TAILQ_REMOVE(&g_dedups, dedup, link);
+	spdk_vbdev_md_call(&dedup->md, _dedup_stop, dedup);
+
+	return 1;
+}
+
+static struct spdk_io_channel *
+vbdev_dedup_get_io_channel(void *ctx)
+{
+	return spdk_get_io_channel(ctx);
+}
+
+static int
+vbdev_dedup_dump_info_json(void *ctx, struct spdk_json_write_ctx *w)
+{
+	struct vbdev_dedup *dedup = ctx;
+	struct dedup_stats *stats = &dedup->stats;
+	uint64_t used = dedup->geo.num_pchunks - dedup->num_free;
+
+	spdk_json_write_named_object_begin(w, "dedup");
+	spdk_json_write_named_string(w, "name", spdk_bdev_get_name(&dedup->bdev));
+	spdk_json_write_named_string(w, "base_bdev_name", spdk_bdev_get_name(dedup->base_bdev));
+	spdk_json_write_named_uint32(w, "chunk_size", (uint32_t)dedup->chunk_size);
+	spdk_json_write_named_uint64(w, "logical_chunks", dedup->geo.num_lchunks);
+	spdk_json_write_named_uint64(w, "mapped_chunks", dedup->mapped_chunks);
+	spdk_json_write_named_uint64(w, "physical_chunks", dedup->geo.num_pchunks);
+	spdk_json_write_named_uint64(w, "used_chunks", used);
+	/* Mapped chunks per used chunk, in percent */
+	spdk_json_write_named_uint64(w, "dedup_ratio_pct",
+				     used ? dedup->mapped_chunks * 100 / used : 0);
+
+	spdk_json_write_named_object_begin(w, "stats");
+	spdk_json_write_named_uint64(w, "dedup_hits", stats->dedup_hits);
+	spdk_json_write_named_uint64(w, "fp_mismatches", stats->fp_mismatches);
+	spdk_json_write_named_uint64(w, "zero_chunks", stats->zero_chunks);
+	spdk_json_write_named_uint64(w, "chunk_writes", stats->chunk_writes);
+	spdk_json_write_named_uint64(w, "merges", stats->merges);
+	spdk_json_write_named_uint64(w, "md_writes", dedup->md.writes);
+	spdk_json_write_named_uint64(w, "no_space", stats->no_space);
+	spdk_json_write_object_end(w);
+
+	spdk_json_write_object_end(w);
+
+	return 0;
+}
+
+static void
+vbdev_dedup_write_config_json(struct spdk_bdev *bdev, struct spdk_json_write_ctx *w)
+{
+	/* No config per bdev needed */
+}
+
+static const struct spdk_bdev_fn_table vbdev_dedup_fn_table = {
+	.destruct		= vbdev_dedup_destruct,
+	.submit_request		= vbdev_dedup_submit_request,
+	.io_type_supported	= vbdev_dedup_io_type_supported,
+	.get_io_channel		= vbdev_dedup_get_io_channel,
+	.dump_info_json		= vbdev_dedup_dump_info_json,
+	.write_config_json	= vbdev_dedup_write_config_json,
+};
+
+static int
+dedup_ch_create_cb(void *io_device, void *ctx_buf)
+{
+	struct dedup_io_channel *ch = ctx_buf;
+
+	ch->dedup = io_device;
+
+	return 0;
+}
+
+static void
+dedup_ch_destroy_cb(void *io_device, void *ctx_buf)
+{
+}
+
+static void
+vbdev_dedup_hotremove_cb(void *ctx)
+{
+	struct vbdev_dedup *dedup = ctx;
+
+	if (!dedup->removing) {
+		dedup->removing = true;
+		spdk_bdev_unregister(&dedup->bdev, NULL, NULL);
+	}
+}
+
+static void
+dedup_create_done(void *ctx, int status)
+{
+	struct vbdev_dedup *dedup = ctx;
+	vbdev_dedup_create_cb cb_fn = dedup->create_cb;
+	void *cb_arg = dedup->create_cb_arg;
+
+	if (status != 0) {
+		SPDK_ERRLOG("Could not create dedup %s: %s\n", dedup->bdev.name,
+			    spdk_strerror(-status));
+		dedup_close_bdev(dedup);
+		dedup_free(dedup);
+		cb_fn(cb_arg, NULL, status);
+		return;
+	}
+
+	spdk_io_device_register(dedup, dedup_ch_create_cb, dedup_ch_destroy_cb,
+				sizeof(struct dedup_io_channel), dedup->bdev.name);
+
+	status = spdk_bdev_register(&dedup->bdev);
+	if (status != 0) {
+		SPDK_ERRLOG("Could not register dedup %s\n", dedup->bdev.name);
+		dedup_close_bdev(dedup);
+		spdk_io_device_unregister(dedup, _device_unregister_cb);
+		cb_fn(cb_arg, NULL, status);
+		return;
+	}
+
+	TAILQ_INSERT_TAIL(&g_dedups, dedup, link);
+
+	SPDK_NOTICELOG("Dedup %s: %" PRIu64 " of %" PRIu64 " chunks of %zu KiB mapped to %"
+		       PRIu64 " of %" PRIu64 "\n", dedup->bdev.name, dedup->mapped_chunks,
+		       dedup->geo.num_lchunks, dedup->chunk_size / 1024,
+		       dedup->geo.num_pchunks - dedup->num_free, dedup->geo.num_pchunks);
+	cb_fn(cb_arg, &dedup->bdev, 0);
+}
+
+/* Rebuild the reference counts and the index from the map. */
+static void
+dedup_load_done(void *ctx, int status)
+{
+	struct vbdev_dedup *dedup = ctx;
+	uint64_t i;
+
+	if (status != 0) {
+		dedup_create_done(dedup, status);
+		return;
+	}
+
+	for (i = 0; i < dedup->geo.num_lchunks; i++) {
+		if (dedup->map[i] != 0) {
+			dedup->pchunks[dedup->map[i] - 1].refcnt++;
+			dedup->mapped_chunks++;
+		}
+	}
+
+	/* Push in reverse order, so that chunks are allocated from the start. */
+	for (i = dedup->geo.num_pchunks; i > 0; i--) {
+		if (dedup->pchunks[i - 1].refcnt > 0) {
+			dedup_index_insert(dedup, i - 1);
+		} else {
+			dedup_free_push(dedup, i - 1);
+		}
+	}
+
+	dedup_create_done(dedup, 0);
+}
+
+static void
+dedup_format_md_done(void *ctx, int status)
+{
+	struct vbdev_dedup *dedup = ctx;
+
+	if (status != 0) {
+		dedup_create_done(dedup, status);
+		return;
+	}
+
+	/* The superblock goes last, so that an interrupted format is not picked up. */
+	dedup_sb_write(dedup, dedup_load_done);
+}
+
+static uint32_t
+dedup_opts_chunk_blocks(struct vbdev_dedup *dedup)
+{
+	if (dedup->geo.chunk_blocks != 0) {
+		return dedup->geo.chunk_blocks;
+	}
+
+	return spdk_max(DEDUP_DEFAULT_CHUNK_SIZE / dedup->block_size, 1);
+}
+
+static int
+dedup_init_state(struct vbdev_dedup *dedup)
+{
+	uint64_t buckets = spdk_align64pow2(dedup->geo.num_pchunks);
+	size_t align = spdk_bdev_get_buf_align(dedup->base_bdev);
+	uint64_t i;
+	int rc;
+
+	dedup->chunk_shift = spdk_u32log2(dedup->geo.chunk_blocks);
+	dedup->chunk_size = (size_t)dedup->geo.chunk_blocks * dedup->block_size;
+	dedup->bdev.blockcnt = dedup->geo.num_lchunks * dedup->geo.chunk_blocks;
+	dedup->bdev.optimal_io_boundary = dedup->geo.chunk_blocks;
+
+	dedup->map = calloc(dedup->geo.num_lchunks, sizeof(*dedup->map));
+	dedup->pchunks = calloc(dedup->geo.num_pchunks, sizeof(*dedup->pchunks));
+	dedup->index = malloc(buckets * sizeof(*dedup->index));
+	if (dedup->map == NULL || dedup->pchunks == NULL || dedup->index == NULL) {
+		return -ENOMEM;
+	}
+
+	dedup->index_mask = buckets - 1;
+	for (i = 0; i < buckets; i++) {
+		dedup->index[i] = DEDUP_NONE;
+	}
+	dedup->free_head = DEDUP_NONE;
+
+	/* The fingerprint pages follow the map pages. */
+	rc = spdk_vbdev_md_alloc_pages(&dedup->md, dedup->geo.map_offset,
+				       dedup->geo.map_blocks + dedup->geo.fp_blocks);
+	if (rc != 0) {
+		return rc;
+	}
+
+	TAILQ_INIT(&dedup->free_ops);
+	TAILQ_INIT(&dedup->active_ops);
+	TAILQ_INIT(&dedup->op_waiters);
+	for (i = 0; i < DEDUP_OPS; i++) {
+		dedup->ops[i].dedup = dedup;
+		TAILQ_INIT(&dedup->ops[i].waiters);
+		dedup->ops[i].buf = spdk_dma_malloc(dedup->chunk_size, align, NULL);
+		dedup->ops[i].cmp_buf = spdk_dma_malloc(dedup->chunk_size, align, NULL);
+		if (dedup->ops[i].buf == NULL || dedup->ops[i].cmp_buf == NULL) {
+			return -ENOMEM;
+		}
+		TAILQ_INSERT_TAIL(&dedup->free_ops, &dedup->ops[i], link);
+	}
+
+	return 0;
+}
+
+/* Format with the geometry of the options, the default chunk size if none was given. */
+static void
+dedup_format(struct vbdev_dedup *dedup)
+{
+	uint32_t chunk_blocks = dedup_opts_chunk_blocks(dedup);
+	int rc;
+
+	SPDK_NOTICELOG("Formatting %s for dedup %s\n", spdk_bdev_get_name(dedup->base_bdev),
+		       dedup->bdev.name);
+
+	rc = dedup_compute_geometry(spdk_bdev_get_num_blocks(dedup->base_bdev), dedup->block_size,
+				    chunk_blocks, dedup->geo.num_lchunks, &dedup->geo);
+	if (rc != 0) {
+		SPDK_ERRLOG("%s is too small for dedup with %u KiB chunks\n",
+			    spdk_bdev_get_name(dedup->base_bdev),
+			    chunk_blocks * dedup->block_size / 1024);
+		dedup_create_done(dedup, rc);
+		return;
+	}
+
+	rc = dedup_init_state(dedup);
+	if (rc != 0) {
+		dedup_create_done(dedup, rc);
+		return;
+	}
+
+	spdk_uuid_generate(&dedup->bdev.uuid);
+	spdk_vbdev_md_io(&dedup->md, true, dedup_format_md_done);
+}
+
+static int
+dedup_sb_check(struct vbdev_dedup *dedup)
+{
+	struct dedup_sb *sb = dedup->md.sb;
+	struct dedup_geometry geo;
+	int rc;
+
+	if (sb->block_size != dedup->block_size || sb->chunk_blocks == 0 ||
+	    sb->chunk_blocks * dedup->block_size > DEDUP_MAX_CHUNK_SIZE ||
+	    !spdk_u32_is_pow2(sb->chunk_blocks) ||
+	    sb->base_blockcnt != spdk_bdev_get_num_blocks(dedup->base_bdev)) {
+		SPDK_ERRLOG("The dedup superblock on %s does not match the bdev\n",
+			    spdk_bdev_get_name(dedup->base_bdev));
+		return -EILSEQ;
+	}
+
+	rc = dedup_compute_geometry(sb->base_blockcnt, dedup->block_size, sb->chunk_blocks,
+				    sb->num_lchunks, &geo);
+	if (rc != 0 || geo.num_pchunks != sb->num_pchunks || geo.map_offset != sb->map_offset ||
+	    geo.map_blocks != sb->map_blocks || geo.fp_offset != sb->fp_offset ||
+	    geo.fp_blocks != sb->fp_blocks || geo.data_offset != sb->data_offset) {
+		SPDK_ERRLOG("The dedup layout on %s is inconsistent\n",
+			    spdk_bdev_get_name(dedup->base_bdev));
+		return -EILSEQ;
+	}
+
+	if ((dedup->geo.chunk_blocks != 0 && dedup->geo.chunk_blocks != sb->chunk_blocks) ||
+	    (dedup->geo.num_lchunks != 0 && dedup->geo.num_lchunks != sb->num_lchunks)) {
+		SPDK_ERRLOG("%s holds a dedup bdev of another geometry, format it to change it\n",
+			    spdk_bdev_get_name(dedup->base_bdev));
+		return -EINVAL;
+	}
+
+	dedup->geo = geo;
+	spdk_uuid_copy(&dedup->bdev.uuid, &sb->uuid);
+
+	return 0;
+}
+
+static void
+dedup_sb_read_done(void *ctx, int status)
+{
+	struct vbdev_dedup *dedup = ctx;
+
+	if (status == -ENOENT) {
+		dedup_format(dedup);
+		return;
+	}
+
+	if (status == 0) {
+		status = dedup_sb_check(dedup);
+	}
+	if (status == 0) {
+		status = dedup_init_state(dedup);
+	}
+	if (status != 0) {
+		dedup_create_done(dedup, status);
+		return;
+	}
+
+	spdk_vbdev_md_io(&dedup->md, false, dedup_load_done);
+}
+
+void
+vbdev_dedup_create(const struct vbdev_dedup_opts *opts, vbdev_dedup_create_cb cb_fn, void *cb_arg)
+{
+	struct vbdev_dedup *dedup;
+	uint32_t chunk_size;
+	int rc;
+
+	if (spdk_bdev_get_by_name(opts->name) != NULL) {
+		cb_fn(cb_arg, NULL, -EEXIST);
+		return;
+	}
+
+	dedup = calloc(1, sizeof(*dedup));
+	if (dedup == NULL) {
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	dedup->bdev.name = strdup(opts->name);
+	if (dedup->bdev.name == NULL) {
+		free(dedup);
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	dedup->create_cb = cb_fn;
+	dedup->create_cb_arg = cb_arg;
+
+	dedup->base_bdev = spdk_bdev_get_by_name(opts->base_bdev_name);
+	if (dedup->base_bdev == NULL) {
+		SPDK_ERRLOG("Could not find bdev %s\n", opts->base_bdev_name);
+		dedup_create_done(dedup, -ENODEV);
+		return;
+	}
+
+	rc = spdk_bdev_open(dedup->base_bdev, true, vbdev_dedup_hotremove_cb, dedup,
+			    &dedup->base_desc);
+	if (rc != 0) {
+		SPDK_ERRLOG("Could not open bdev %s\n", opts->base_bdev_name);
+		dedup_create_done(dedup, rc);
+		return;
+	}
+
+	rc = spdk_bdev_module_claim_bdev(dedup->base_bdev, dedup->base_desc, &dedup_if);
+	if (rc != 0) {
+		SPDK_ERRLOG("Could not claim bdev %s\n", opts->base_bdev_name);
+		spdk_bdev_close(dedup->base_desc);
+		dedup->base_desc = NULL;
+		dedup_create_done(dedup, rc);
+		return;
+	}
+
+	dedup->block_size = spdk_bdev_get_block_size(dedup->base_bdev);
+	if (spdk_bdev_get_md_size(dedup->base_bdev) != 0) {
+		SPDK_ERRLOG("%s must not have metadata\n", opts->base_bdev_name);
+		dedup_create_done(dedup, -EINVAL);
+		return;
+	}
+
+	/* A chunk size or logical size of 0 keeps the one on disk, or picks the default. */
+	chunk_size = opts->chunk_size;
+	if (chunk_size != 0) {
+		dedup->geo.chunk_blocks = chunk_size / dedup->block_size;
+		if (chunk_size % dedup->block_size != 0 || chunk_size > DEDUP_MAX_CHUNK_SIZE ||
+		    !spdk_u32_is_pow2(dedup->geo.chunk_blocks)) {
+			SPDK_ERRLOG("The chunk size must be a power of two multiple of the block "
+				    "size, up to %d KiB\n", DEDUP_MAX_CHUNK_SIZE / 1024);
+			dedup_create_done(dedup, -EINVAL);
+			return;
+		}
+	}
+
+	if (opts->logical_size != 0) {
+		chunk_size = dedup_opts_chunk_blocks(dedup) * dedup->block_size;
+		if (opts->logical_size % chunk_size != 0) {
+			SPDK_ERRLOG("The logical size must be a multiple of the chunk size\n");
+			dedup_create_done(dedup, -EINVAL);
+			return;
+		}
+		dedup->geo.num_lchunks = opts->logical_size / chunk_size;
+	}
+
+	dedup->bdev.product_name = "dedup";
+	dedup->bdev.write_cache = dedup->base_bdev->write_cache;
+	dedup->bdev.required_alignment = dedup->base_bdev->required_alignment;
+	dedup->bdev.split_on_optimal_io_boundary = true;
+	dedup->bdev.blocklen = dedup->block_size;
+	dedup->bdev.ctxt = dedup;
+	dedup->bdev.fn_table = &vbdev_dedup_fn_table;
+	dedup->bdev.module = &dedup_if;
+
+	dedup->base_ch = spdk_bdev_get_io_channel(dedup->base_desc);
+	if (dedup->base_ch == NULL) {
+		dedup_create_done(dedup, -ENOMEM);
+		return;
+	}
+
+	rc = spdk_vbdev_md_init(&dedup->md, &dedup_md_ops, dedup, dedup->bdev.name,
+				dedup->base_desc, dedup->base_ch);
+	if (rc != 0) {
+		dedup_create_done(dedup, rc);
+		return;
+	}
+
+	if (opts->format) {
+		dedup_format(dedup);
+		return;
+	}
+
+	spdk_vbdev_md_sb_read(&dedup->md, dedup_sb_read_done);
+}
+
+void
+vbdev_dedup_delete(struct spdk_bdev *bdev, spdk_bdev_unregister_cb cb_fn, void *cb_arg)
+{
+	struct vbdev_dedup *dedup;
+
+	if (!bdev || bdev->module != &dedup_if) {
+		cb_fn(cb_arg, -ENODEV);
+		return;
+	}
+
+	dedup = SPDK_CONTAINEROF(bdev, struct vbdev_dedup, bdev);
+	dedup->removing = true;
+	spdk_bdev_unregister(bdev, cb_fn, cb_arg);
+}
+
+static int
+vbdev_dedup_init(void)
+{
+	return 0;
+}
+
+static void
+vbdev_dedup_finish(void)
+{
+}
+
+static int
+vbdev_dedup_get_ctx_size(void)
+{
+	return sizeof(struct vbdev_dedup_io);
+}
+
+static int
+vbdev_dedup_config_json(struct spdk_json_write_ctx *w)
+{
+	struct vbdev_dedup *dedup;
+
+	TAILQ_FOREACH(dedup, &g_dedups, link) {
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_string(w, "method", "bdev_dedup_create");
+		spdk_json_write_named_object_begin(w, "params");
+		spdk_json_write_named_string(w, "name", spdk_bdev_get_name(&dedup->bdev));
+		spdk_json_write_named_string(w, "base_bdev_name",
+					     spdk_bdev_get_name(dedup->base_bdev));
+		spdk_json_write_object_end(w);
+		spdk_json_write_object_end(w);
+	}
+
+	return 0;
+}
+
+SPDK_LOG_REGISTER_COMPONENT("vbdev_dedup", SPDK_LOG_VBDEV_DEDUP)
@@ -0,0 +1,84 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SPDK_VBDEV_DEDUP_H
+#define SPDK_VBDEV_DEDUP_H
+
+#include "spdk/stdinc.h"
+
+#include "spdk/bdev.h"
+#include "spdk/bdev_module.h"
+
+struct vbdev_dedup_opts {
+	/* Name of the dedup vbdev */
+	const char			*name;
+	/* Bdev holding the metadata and the unique chunks */
+	const char			*base_bdev_name;
+	/*
+	 * Size of a chunk in bytes. 0 picks the default when formatting, and accepts
+	 * any chunk size when loading.
+	 */
+	uint32_t			chunk_size;
+	/*
+	 * Size of the vbdev in bytes, which may be larger than the base bdev. 0 makes it
+	 * as large as the data area of the base bdev when formatting, and accepts any
+	 * size when loading.
+	 */
+	uint64_t			logical_size;
+	/* Format the base bdev even if it holds the metadata of a dedup vbdev. */
+	bool				format;
+};
+
+typedef void (*vbdev_dedup_create_cb)(void *cb_arg, struct spdk_bdev *bdev, int bdeverrno);
+
+/**
+ * Create a deduplicating vbdev. If the base bdev holds the metadata of a dedup
+ * vbdev, it is loaded. Otherwise the base bdev is formatted.
+ *
+ * \param opts Options of the vbdev.
+ * \param cb_fn Function to call once the vbdev was registered, or creating it failed.
+ * \param cb_arg Argument to pass to cb_fn.
+ */
+void vbdev_dedup_create(const struct vbdev_dedup_opts *opts, vbdev_dedup_create_cb cb_fn,
+			void *cb_arg);
+
+/**
+ * Delete a dedup vbdev. Its data stays on the base bdev.
+ *
+ * \param bdev Pointer to the dedup vbdev.
+ * \param cb_fn Function to call after deletion.
+ * \param cb_arg Argument to pass to cb_fn.
+ */
+void vbdev_dedup_delete(struct spdk_bdev *bdev, spdk_bdev_unregister_cb cb_fn, void *cb_arg);
+
+#endif /* SPDK_VBDEV_DEDUP_H */
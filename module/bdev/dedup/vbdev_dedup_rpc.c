@@ -0,0 +1,166 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "vbdev_dedup.h"
+#include "spdk/rpc.h"
+#include "spdk/util.h"
+#include "spdk/string.h"
+#include "spdk_internal/log.h"
+
+struct rpc_bdev_dedup_create {
+	char *name;
+	char *base_bdev_name;
+	uint32_t chunk_size_kb;
+	uint64_t logical_size_mb;
+	bool format;
+};
+
+static void
+free_rpc_bdev_dedup_create(struct rpc_bdev_dedup_create *r)
+{
+	free(r->name);
+	free(r->base_bdev_name);
+	free(r);
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_dedup_create_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_dedup_create, name), spdk_json_decode_string},
+	{"base_bdev_name", offsetof(struct rpc_bdev_dedup_create, base_bdev_name), spdk_json_decode_string},
+	{"chunk_size_kb", offsetof(struct rpc_bdev_dedup_create, chunk_size_kb), spdk_json_decode_uint32, true},
+	{"logical_size_mb", offsetof(struct rpc_bdev_dedup_create, logical_size_mb), spdk_json_decode_uint64, true},
+	{"format", offsetof(struct rpc_bdev_dedup_create, format), spdk_json_decode_bool, true},
+};
+
+static void
+_spdk_rpc_bdev_dedup_create_cb(void *cb_arg, struct spdk_bdev *bdev, int bdeverrno)
+{
+	struct spdk_jsonrpc_request *request = cb_arg;
+	struct spdk_json_write_ctx *w;
+
+	if (bdeverrno != 0) {
+		spdk_jsonrpc_send_error_response(request, bdeverrno, spdk_strerror(-bdeverrno));
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_string(w, spdk_bdev_get_name(bdev));
+	spdk_jsonrpc_end_result(request, w);
+}
+
+static void
+spdk_rpc_bdev_dedup_create(struct spdk_jsonrpc_request *request,
+			   const struct spdk_json_val *params)
+{
+	struct rpc_bdev_dedup_create *req;
+	struct vbdev_dedup_opts opts = {};
+
+	req = calloc(1, sizeof(*req));
+	if (req == NULL) {
+		spdk_jsonrpc_send_error_response(request, -ENOMEM, spdk_strerror(ENOMEM));
+		return;
+	}
+
+	if (spdk_json_decode_object(params, rpc_bdev_dedup_create_decoders,
+				    SPDK_COUNTOF(rpc_bdev_dedup_create_decoders),
+				    req)) {
+		SPDK_DEBUGLOG(SPDK_LOG_VBDEV_DEDUP, "spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	opts.name = req->name;
+	opts.base_bdev_name = req->base_bdev_name;
+	opts.chunk_size = req->chunk_size_kb * 1024;
+	opts.logical_size = req->logical_size_mb * 1024 * 1024;
+	opts.format = req->format;
+
+	vbdev_dedup_create(&opts, _spdk_rpc_bdev_dedup_create_cb, request);
+
+cleanup:
+	free_rpc_bdev_dedup_create(req);
+}
+SPDK_RPC_REGISTER("bdev_dedup_create", spdk_rpc_bdev_dedup_create, SPDK_RPC_RUNTIME)
+
+struct rpc_bdev_dedup_delete {
+	char *name;
+};
+
+static void
+free_rpc_bdev_dedup_delete(struct rpc_bdev_dedup_delete *req)
+{
+	free(req->name);
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_dedup_delete_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_dedup_delete, name), spdk_json_decode_string},
+};
+
+static void
+_spdk_rpc_bdev_dedup_delete_cb(void *cb_arg, int bdeverrno)
+{
+	struct spdk_jsonrpc_request *request = cb_arg;
+	struct spdk_json_write_ctx *w;
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, bdeverrno == 0);
+	spdk_jsonrpc_end_result(request, w);
+}
+
+static void
+spdk_rpc_bdev_dedup_delete(struct spdk_jsonrpc_request *request,
+			   const struct spdk_json_val *params)
+{
+	struct rpc_bdev_dedup_delete req = {NULL};
+	struct spdk_bdev *bdev;
+
+	if (spdk_json_decode_object(params, rpc_bdev_dedup_delete_decoders,
+				    SPDK_COUNTOF(rpc_bdev_dedup_delete_decoders),
+				    &req)) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	bdev = spdk_bdev_get_by_name(req.name);
+	if (bdev == NULL) {
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	vbdev_dedup_delete(bdev, _spdk_rpc_bdev_dedup_delete_cb, request);
+
+cleanup:
+	free_rpc_bdev_dedup_delete(&req);
+}
+SPDK_RPC_REGISTER("bdev_dedup_delete", spdk_rpc_bdev_dedup_delete, SPDK_RPC_RUNTIME)
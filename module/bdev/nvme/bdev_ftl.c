@@ -685,7 +685,7 @@ bdev_ftl_io_channel_create_cb(void *io_device, void *ctx)
 		return -ENOMEM;
 	}
 
-	ch->poller = spdk_poller_register(bdev_ftl_poll, ch, 0);
+	ch->poller = SPDK_POLLER_REGISTER(bdev_ftl_poll, ch, 0);
 	if (!ch->poller) {
 		spdk_ring_free(ch->ring);
 		return -ENOMEM;
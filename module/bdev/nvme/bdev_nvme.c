@@ -53,14 +53,18 @@
 static void bdev_nvme_get_spdk_running_config(FILE *fp);
 static int bdev_nvme_config_json(struct spdk_json_write_ctx *w);
 
-struct nvme_io_channel {
-	struct spdk_nvme_qpair	*qpair;
-	struct spdk_poller	*poller;
-
-	bool			collect_spin_stat;
-	uint64_t		spin_ticks;
-	uint64_t		start_ticks;
-	uint64_t		end_ticks;
+/* Per-thread poll group polling the I/O qpairs of all controllers. */
+struct nvme_bdev_poll_group {
+	struct spdk_nvme_poll_group	*group;
+	struct spdk_poller		*poller;
+
+	bool				collect_spin_stat;
+	uint64_t			spin_ticks;
+	uint64_t			start_ticks;
+	uint64_t			end_ticks;
+
+	/* Controller channels whose qpairs are polled by the group */
+	TAILQ_HEAD(, nvme_io_channel)	io_channels;
 };
 
 struct nvme_bdev_io {
@@ -81,6 +85,21 @@ struct nvme_bdev_io {
 
 	/** Originating thread */
 	struct spdk_thread *orig_thread;
+
+	/** Controller memory buffer holding the data of a zcopy request. */
+	struct nvme_cmb_buf *cmb_buf;
+
+	/** Path the request is submitted through. */
+	struct nvme_io_path *io_path;
+
+	/** Number of times the request was failed over to another path. */
+	uint32_t failover_count;
+
+	/** Index of the path whose controller a reset is at. */
+	uint32_t reset_path_idx;
+
+	/** A controller reset of the request failed. */
+	bool reset_failed;
 };
 
 struct nvme_probe_ctx {
@@ -111,11 +130,21 @@ static struct spdk_bdev_nvme_opts g_opts = {
 	.nvme_adminq_poll_period_us = 1000000ULL,
 	.nvme_ioq_poll_period_us = 0,
 	.io_queue_requests = 0,
+	.use_cmb_sqs = true,
+	.cmb_zcopy = false,
+	.multipath = true,
 };
 
 #define NVME_HOTPLUG_POLL_PERIOD_MAX			10000000ULL
 #define NVME_HOTPLUG_POLL_PERIOD_DEFAULT		100000ULL
 
+/*
+ * Each I/O channel of a controller sets aside this many CMB buffers for zcopy
+ * requests, so they don't contend on the controller for CMB space.
+ */
+#define NVME_CMB_ZCOPY_BUFS				8
+#define NVME_CMB_ZCOPY_BUF_SIZE				0x20000
+
 static int g_hot_insert_nvme_controller_index = 0;
 static uint64_t g_nvme_hotplug_poll_period_us = NVME_HOTPLUG_POLL_PERIOD_DEFAULT;
 static bool g_nvme_hotplug_enabled = false;
@@ -127,25 +156,27 @@ static char *g_nvme_hostnqn = NULL;
 static void nvme_ctrlr_create_bdevs(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr);
 static int bdev_nvme_library_init(void);
 static void bdev_nvme_library_fini(void);
-static int bdev_nvme_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+static int bdev_nvme_readv(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 			   struct nvme_bdev_io *bio,
 			   struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba);
-static int bdev_nvme_no_pi_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+static int bdev_nvme_no_pi_readv(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 				 struct nvme_bdev_io *bio,
 				 struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba);
-static int bdev_nvme_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+static int bdev_nvme_writev(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 			    struct nvme_bdev_io *bio,
 			    struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba);
-static int bdev_nvme_admin_passthru(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+static int bdev_nvme_admin_passthru(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 				    struct nvme_bdev_io *bio,
 				    struct spdk_nvme_cmd *cmd, void *buf, size_t nbytes);
-static int bdev_nvme_io_passthru(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+static int bdev_nvme_io_passthru(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 				 struct nvme_bdev_io *bio,
 				 struct spdk_nvme_cmd *cmd, void *buf, size_t nbytes);
-static int bdev_nvme_io_passthru_md(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+static int bdev_nvme_io_passthru_md(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 				    struct nvme_bdev_io *bio,
 				    struct spdk_nvme_cmd *cmd, void *buf, size_t nbytes, void *md_buf, size_t md_len);
 static int nvme_ctrlr_create_bdev(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr, uint32_t nsid);
+static void _bdev_nvme_destruct(struct nvme_bdev *nbdev);
+static bool bdev_nvme_cmb_data_supported(struct spdk_nvme_ctrlr *ctrlr);
 
 struct spdk_nvme_qpair *
 spdk_bdev_nvme_get_io_qpair(struct spdk_io_channel *ctrlr_io_ch)
@@ -174,31 +205,50 @@ static struct spdk_bdev_module nvme_if = {
 };
 SPDK_BDEV_MODULE_REGISTER(nvme, &nvme_if)
 
-static int
-bdev_nvme_poll(void *arg)
+static void
+bdev_nvme_disconnected_qpair_cb(struct spdk_nvme_qpair *qpair, void *poll_group_ctx)
 {
-	struct nvme_io_channel *ch = arg;
-	int32_t num_completions;
+	struct nvme_bdev_poll_group *group = poll_group_ctx;
+	struct nvme_io_channel *nvme_ch;
 
-	if (ch->qpair == NULL) {
-		return -1;
+	SPDK_DEBUGLOG(SPDK_LOG_BDEV_NVME, "qpair %p is disconnected\n", qpair);
+
+	TAILQ_FOREACH(nvme_ch, &group->io_channels, tailq) {
+		if (nvme_ch->qpair == qpair) {
+			/*
+			 * Freeing the qpair aborts its outstanding requests, so that they get
+			 * failed over to another path. Clear it first, so that they don't pick
+			 * it again. The qpair is recreated by a reset of its controller.
+			 */
+			nvme_ch->qpair = NULL;
+			spdk_nvme_ctrlr_free_io_qpair(qpair);
+			return;
+		}
 	}
+}
 
-	if (ch->collect_spin_stat && ch->start_ticks == 0) {
-		ch->start_ticks = spdk_get_ticks();
+static int
+bdev_nvme_poll(void *arg)
+{
+	struct nvme_bdev_poll_group *group = arg;
+	int64_t num_completions;
+
+	if (group->collect_spin_stat && group->start_ticks == 0) {
+		group->start_ticks = spdk_get_ticks();
 	}
 
-	num_completions = spdk_nvme_qpair_process_completions(ch->qpair, 0);
+	num_completions = spdk_nvme_poll_group_process_completions(group->group, 0,
+			  bdev_nvme_disconnected_qpair_cb);
 
-	if (ch->collect_spin_stat) {
+	if (group->collect_spin_stat) {
 		if (num_completions > 0) {
-			if (ch->end_ticks != 0) {
-				ch->spin_ticks += (ch->end_ticks - ch->start_ticks);
-				ch->end_ticks = 0;
+			if (group->end_ticks != 0) {
+				group->spin_ticks += (group->end_ticks - group->start_ticks);
+				group->end_ticks = 0;
 			}
-			ch->start_ticks = 0;
+			group->start_ticks = 0;
 		} else {
-			ch->end_ticks = spdk_get_ticks();
+			group->end_ticks = spdk_get_ticks();
 		}
 	}
 
@@ -234,27 +284,72 @@ bdev_nvme_ctrlr_destruct(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr)
 	spdk_io_device_unregister(nvme_bdev_ctrlr->ctrlr, bdev_nvme_unregister_cb);
 	spdk_poller_unregister(&nvme_bdev_ctrlr->adminq_timer_poller);
 	free(nvme_bdev_ctrlr->name);
-	free(nvme_bdev_ctrlr->bdevs);
+	free(nvme_bdev_ctrlr->namespaces);
 	free(nvme_bdev_ctrlr);
 }
 
-static int
-bdev_nvme_destruct(void *ctx)
+/* Drop the reference a path holds on its controller. */
+static void
+nvme_bdev_ctrlr_release(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr)
 {
-	struct nvme_bdev *nvme_disk = ctx;
-	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr = nvme_disk->nvme_bdev_ctrlr;
-
 	pthread_mutex_lock(&g_bdev_nvme_mutex);
 	nvme_bdev_ctrlr->ref--;
-	free(nvme_disk->disk.name);
-	nvme_disk->active = false;
 	if (nvme_bdev_ctrlr->ref == 0 && nvme_bdev_ctrlr->destruct) {
 		pthread_mutex_unlock(&g_bdev_nvme_mutex);
 		bdev_nvme_ctrlr_destruct(nvme_bdev_ctrlr);
-		return 0;
+		return;
 	}
 
 	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+}
+
+static void
+bdev_nvme_disk_unregister_cb(void *io_device)
+{
+	struct nvme_bdev *nvme_disk = io_device;
+
+	free(nvme_disk->disk.name);
+	free(nvme_disk);
+}
+
+static void
+_bdev_nvme_destruct(struct nvme_bdev *nvme_disk)
+{
+	struct nvme_bdev_ns *nvme_ns, *tmp;
+	TAILQ_HEAD(, nvme_bdev_ns) nvme_ns_list = TAILQ_HEAD_INITIALIZER(nvme_ns_list);
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	TAILQ_SWAP(&nvme_ns_list, &nvme_disk->nvme_ns_list, nvme_bdev_ns, tailq);
+	nvme_disk->num_paths = 0;
+	TAILQ_FOREACH(nvme_ns, &nvme_ns_list, tailq) {
+		nvme_ns->bdev = NULL;
+		nvme_ns->active = false;
+	}
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	/* Releasing a controller may free its namespaces, so don't touch them afterwards. */
+	TAILQ_FOREACH_SAFE(nvme_ns, &nvme_ns_list, tailq, tmp) {
+		nvme_bdev_ctrlr_release(nvme_ns->ctrlr);
+	}
+
+	spdk_io_device_unregister(nvme_disk, bdev_nvme_disk_unregister_cb);
+}
+
+static int
+bdev_nvme_destruct(void *ctx)
+{
+	struct nvme_bdev *nvme_disk = ctx;
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	if (nvme_disk->path_updates > 0) {
+		/* The channels are still being iterated, finish once they are done. */
+		nvme_disk->destruct_pending = true;
+		pthread_mutex_unlock(&g_bdev_nvme_mutex);
+		return 1;
+	}
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	_bdev_nvme_destruct(nvme_disk);
 	return 0;
 }
 
@@ -267,36 +362,242 @@ bdev_nvme_flush(struct nvme_bdev *nbdev, struct nvme_bdev_io *bio,
 	return 0;
 }
 
+static struct nvme_io_path *
+bdev_nvme_get_io_path(struct nvme_bdev_channel *nbdev_ch, struct nvme_bdev_io *bio)
+{
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
+	struct nvme_io_path *io_path;
+
+	assert(bio->io_path == NULL);
+
+	io_path = nvme_bdev_find_io_path(bdev_io->bdev->ctxt, nbdev_ch);
+	if (io_path != NULL) {
+		io_path->outstanding++;
+		bio->io_path = io_path;
+	}
+
+	return io_path;
+}
+
 static void
-_bdev_nvme_reset_done(struct spdk_io_channel_iter *i, int status)
+bdev_nvme_io_path_free(struct nvme_io_path *io_path)
 {
-	void *ctx = spdk_io_channel_iter_get_ctx(i);
-	int rc = SPDK_BDEV_IO_STATUS_SUCCESS;
+	spdk_put_io_channel(io_path->ctrlr_ch);
+	free(io_path);
+}
 
-	if (status) {
-		rc = SPDK_BDEV_IO_STATUS_FAILED;
+static void
+bdev_nvme_io_path_put(struct nvme_bdev_io *bio)
+{
+	struct nvme_io_path *io_path = bio->io_path;
+
+	if (io_path == NULL) {
+		return;
+	}
+
+	bio->io_path = NULL;
+	assert(io_path->outstanding > 0);
+	io_path->outstanding--;
+	if (spdk_unlikely(io_path->removed) && io_path->outstanding == 0) {
+		bdev_nvme_io_path_free(io_path);
 	}
-	spdk_bdev_io_complete(spdk_bdev_io_from_ctx(ctx), rc);
 }
 
+static int bdev_nvme_channel_add_io_path(struct nvme_bdev_channel *nbdev_ch,
+		struct nvme_bdev_ns *nvme_ns);
+
 static void
-_bdev_nvme_reset_create_qpair(struct spdk_io_channel_iter *i)
+_bdev_nvme_add_io_path(struct spdk_io_channel_iter *i)
 {
-	struct spdk_nvme_ctrlr *ctrlr = spdk_io_channel_iter_get_io_device(i);
-	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(_ch);
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct nvme_bdev_ns *nvme_ns = spdk_io_channel_iter_get_ctx(i);
+
+	/* A channel which can't connect to the controller keeps using the other paths. */
+	bdev_nvme_channel_add_io_path(spdk_io_channel_get_ctx(ch), nvme_ns);
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+_bdev_nvme_remove_io_path(struct spdk_io_channel_iter *i)
+{
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct nvme_bdev_channel *nbdev_ch = spdk_io_channel_get_ctx(ch);
+	struct nvme_bdev_ns *nvme_ns = spdk_io_channel_iter_get_ctx(i);
+	struct nvme_io_path *io_path;
+
+	TAILQ_FOREACH(io_path, &nbdev_ch->io_paths, tailq) {
+		if (io_path->nvme_ns == nvme_ns) {
+			break;
+		}
+	}
+
+	if (io_path != NULL) {
+		TAILQ_REMOVE(&nbdev_ch->io_paths, io_path, tailq);
+		nbdev_ch->num_paths--;
+		if (nbdev_ch->rr_path == io_path) {
+			nbdev_ch->rr_path = NULL;
+		}
+
+		if (io_path->outstanding == 0) {
+			bdev_nvme_io_path_free(io_path);
+		} else {
+			io_path->removed = true;
+			io_path->nvme_ns = NULL;
+		}
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+bdev_nvme_path_update_done(struct nvme_bdev *nbdev)
+{
+	bool destruct;
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	assert(nbdev->path_updates > 0);
+	nbdev->path_updates--;
+	destruct = nbdev->path_updates == 0 && nbdev->destruct_pending;
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	if (destruct) {
+		_bdev_nvme_destruct(nbdev);
+		spdk_bdev_destruct_done(&nbdev->disk, 0);
+	}
+}
+
+static void
+bdev_nvme_add_path_done(struct spdk_io_channel_iter *i, int status)
+{
+	bdev_nvme_path_update_done(spdk_io_channel_iter_get_io_device(i));
+}
+
+static void
+bdev_nvme_remove_path_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct nvme_bdev_ns *nvme_ns = spdk_io_channel_iter_get_ctx(i);
+	struct nvme_bdev *nbdev = spdk_io_channel_iter_get_io_device(i);
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	nvme_ns->bdev = NULL;
+	nvme_ns->active = false;
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	/* No channel uses the path any more. */
+	nvme_bdev_ctrlr_release(nvme_ns->ctrlr);
+	bdev_nvme_path_update_done(nbdev);
+}
+
+/* Called with g_bdev_nvme_mutex held */
+static void
+nvme_bdev_add_path(struct nvme_bdev *nbdev, struct nvme_bdev_ns *nvme_ns)
+{
+	nvme_ns->bdev = nbdev;
+	nvme_ns->active = true;
+	nvme_ns->ctrlr->ref++;
+	TAILQ_INSERT_TAIL(&nbdev->nvme_ns_list, nvme_ns, tailq);
+	nbdev->num_paths++;
+	/* The zcopy buffer of a request has to stay on one controller. */
+	nbdev->cmb_zcopy = false;
+	nbdev->path_updates++;
+
+	spdk_for_each_channel(nbdev, _bdev_nvme_add_io_path, nvme_ns, bdev_nvme_add_path_done);
+}
+
+/*
+ * Remove a namespace, e.g. because it was detached or its controller went away.
+ * The bdev is unregistered together with its last path.
+ */
+static void
+nvme_ctrlr_deactivate_ns(struct nvme_bdev_ns *nvme_ns)
+{
+	struct nvme_bdev *nbdev = nvme_ns->bdev;
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	if (nbdev->num_paths == 1) {
+		/* The path is released when the bdev is destructed. */
+		nvme_ns->active = false;
+		pthread_mutex_unlock(&g_bdev_nvme_mutex);
+		spdk_bdev_unregister(&nbdev->disk, NULL, NULL);
+		return;
+	}
+
+	SPDK_NOTICELOG("Removing path %s of bdev %s\n", nvme_ns->ctrlr->name, nbdev->disk.name);
+	TAILQ_REMOVE(&nbdev->nvme_ns_list, nvme_ns, tailq);
+	nbdev->num_paths--;
+	nbdev->path_updates++;
+	nvme_ns->active = false;
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	spdk_for_each_channel(nbdev, _bdev_nvme_remove_io_path, nvme_ns, bdev_nvme_remove_path_done);
+}
+
+static void bdev_nvme_reset_path(struct nvme_bdev_io *bio);
+
+static void
+bdev_nvme_reset_path_done(struct nvme_bdev_io *bio, int status)
+{
+	if (status != 0) {
+		bio->reset_failed = true;
+	}
+
+	bio->reset_path_idx++;
+	bdev_nvme_reset_path(bio);
+}
+
+static void
+_bdev_nvme_reset_done(struct spdk_io_channel_iter *i, int status)
+{
+	bdev_nvme_reset_path_done(spdk_io_channel_iter_get_ctx(i), status);
+}
+
+static int
+bdev_nvme_create_qpair(struct spdk_nvme_ctrlr *ctrlr, struct nvme_io_channel *nvme_ch)
+{
+	struct nvme_bdev_poll_group *group = spdk_io_channel_get_ctx(nvme_ch->group_ch);
 	struct spdk_nvme_io_qpair_opts opts;
+	int rc;
 
 	spdk_nvme_ctrlr_get_default_io_qpair_opts(ctrlr, &opts, sizeof(opts));
 	opts.delay_pcie_doorbell = true;
+	opts.io_queue_requests = spdk_max(g_opts.io_queue_requests, opts.io_queue_requests);
+	g_opts.io_queue_requests = opts.io_queue_requests;
+	/* Join the poll group first, so that the qpair can share its resources. */
+	opts.create_only = true;
 
 	nvme_ch->qpair = spdk_nvme_ctrlr_alloc_io_qpair(ctrlr, &opts, sizeof(opts));
-	if (!nvme_ch->qpair) {
-		spdk_for_each_channel_continue(i, -1);
-		return;
+	if (nvme_ch->qpair == NULL) {
+		return -1;
 	}
 
-	spdk_for_each_channel_continue(i, 0);
+	rc = spdk_nvme_poll_group_add(group->group, nvme_ch->qpair);
+	if (rc != 0) {
+		SPDK_ERRLOG("Unable to add I/O qpair to poll group.\n");
+		goto err;
+	}
+
+	rc = spdk_nvme_ctrlr_connect_io_qpair(ctrlr, nvme_ch->qpair);
+	if (rc != 0) {
+		SPDK_ERRLOG("Unable to connect I/O qpair.\n");
+		goto err;
+	}
+
+	return 0;
+
+err:
+	spdk_nvme_ctrlr_free_io_qpair(nvme_ch->qpair);
+	nvme_ch->qpair = NULL;
+	return -1;
+}
+
+static void
+_bdev_nvme_reset_create_qpair(struct spdk_io_channel_iter *i)
+{
+	struct spdk_nvme_ctrlr *ctrlr = spdk_io_channel_iter_get_io_device(i);
+	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
+	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(_ch);
+
+	spdk_for_each_channel_continue(i, bdev_nvme_create_qpair(ctrlr, nvme_ch));
 }
 
 static void
@@ -307,13 +608,13 @@ _bdev_nvme_reset(struct spdk_io_channel_iter *i, int status)
 	int rc;
 
 	if (status) {
-		spdk_bdev_io_complete(spdk_bdev_io_from_ctx(bio), SPDK_BDEV_IO_STATUS_FAILED);
+		bdev_nvme_reset_path_done(bio, status);
 		return;
 	}
 
 	rc = spdk_nvme_ctrlr_reset(ctrlr);
 	if (rc != 0) {
-		spdk_bdev_io_complete(spdk_bdev_io_from_ctx(bio), SPDK_BDEV_IO_STATUS_FAILED);
+		bdev_nvme_reset_path_done(bio, rc);
 		return;
 	}
 
@@ -331,30 +632,66 @@ _bdev_nvme_reset_destroy_qpair(struct spdk_io_channel_iter *i)
 {
 	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
 	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
+	struct spdk_nvme_qpair *qpair = nvme_ch->qpair;
 	int rc;
 
-	rc = spdk_nvme_ctrlr_free_io_qpair(nvme_ch->qpair);
-	if (!rc) {
-		nvme_ch->qpair = NULL;
+	/* Requests aborted by freeing the qpair may be failed over, but not to this qpair. */
+	nvme_ch->qpair = NULL;
+	rc = spdk_nvme_ctrlr_free_io_qpair(qpair);
+	if (rc) {
+		nvme_ch->qpair = qpair;
 	}
 
 	spdk_for_each_channel_continue(i, rc);
 }
 
-static int
-bdev_nvme_reset(struct nvme_bdev *nbdev, struct nvme_bdev_io *bio)
+/* Reset the controllers of all paths of the bdev one after the other. */
+static void
+bdev_nvme_reset_path(struct nvme_bdev_io *bio)
 {
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
+	struct nvme_bdev *nbdev = bdev_io->bdev->ctxt;
+	struct nvme_bdev_ns *nvme_ns;
+	struct spdk_nvme_ctrlr *ctrlr = NULL;
+	uint32_t idx = 0;
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	TAILQ_FOREACH(nvme_ns, &nbdev->nvme_ns_list, tailq) {
+		if (idx++ == bio->reset_path_idx) {
+			ctrlr = nvme_ns->ctrlr->ctrlr;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	if (ctrlr == NULL) {
+		if (bio->reset_failed || bio->reset_path_idx == 0) {
+			spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+		} else {
+			spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_SUCCESS);
+		}
+		return;
+	}
+
 	/* First, delete all NVMe I/O queue pairs. */
-	spdk_for_each_channel(nbdev->nvme_bdev_ctrlr->ctrlr,
+	spdk_for_each_channel(ctrlr,
 			      _bdev_nvme_reset_destroy_qpair,
 			      bio,
 			      _bdev_nvme_reset);
+}
+
+static int
+bdev_nvme_reset(struct nvme_bdev *nbdev, struct nvme_bdev_io *bio)
+{
+	bio->reset_path_idx = 0;
+	bio->reset_failed = false;
+	bdev_nvme_reset_path(bio);
 
 	return 0;
 }
 
 static int
-bdev_nvme_unmap(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_unmap(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 		struct nvme_bdev_io *bio,
 		uint64_t offset_blocks,
 		uint64_t num_blocks);
@@ -363,6 +700,8 @@ static void
 bdev_nvme_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io,
 		     bool success)
 {
+	struct nvme_bdev_io *bio = (struct nvme_bdev_io *)bdev_io->driver_ctx;
+	struct nvme_io_path *io_path;
 	int ret;
 
 	if (!success) {
@@ -370,9 +709,16 @@ bdev_nvme_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io,
 		return;
 	}
 
+	/* Pick the path only now, it may have gone away while waiting for the buffer. */
+	io_path = bdev_nvme_get_io_path(spdk_io_channel_get_ctx(ch), bio);
+	if (io_path == NULL) {
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
 	ret = bdev_nvme_readv((struct nvme_bdev *)bdev_io->bdev->ctxt,
-			      ch,
-			      (struct nvme_bdev_io *)bdev_io->driver_ctx,
+			      io_path,
+			      bio,
 			      bdev_io->u.bdev.iovs,
 			      bdev_io->u.bdev.iovcnt,
 			      bdev_io->u.bdev.md_buf,
@@ -381,24 +727,177 @@ bdev_nvme_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io,
 
 	if (spdk_likely(ret == 0)) {
 		return;
-	} else if (ret == -ENOMEM) {
+	}
+
+	bdev_nvme_io_path_put(bio);
+	if (ret == -ENOMEM) {
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_NOMEM);
+	} else {
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+	}
+}
+
+/*
+ * A zcopy request holds its path from the start until the end, since its buffer may
+ * live in the memory buffer of the path's controller.
+ */
+static void
+bdev_nvme_zcopy_release(struct spdk_bdev_io *bdev_io)
+{
+	struct nvme_bdev_io *bio = (struct nvme_bdev_io *)bdev_io->driver_ctx;
+	struct nvme_io_channel *nvme_ch;
+
+	if (bio->cmb_buf != NULL) {
+		nvme_ch = spdk_io_channel_get_ctx(bio->io_path->ctrlr_ch);
+		STAILQ_INSERT_HEAD(&nvme_ch->cmb_free_bufs, bio->cmb_buf, stailq);
+		bio->cmb_buf = NULL;
+	}
+
+	bdev_nvme_io_path_put(bio);
+}
+
+static void
+bdev_nvme_zcopy_start_done(void *ref, const struct spdk_nvme_cpl *cpl)
+{
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx((struct nvme_bdev_io *)ref);
+
+	if (spdk_nvme_cpl_is_error(cpl)) {
+		/* A zcopy which failed to start doesn't have to be ended. */
+		bdev_nvme_zcopy_release(bdev_io);
+	}
+
+	spdk_bdev_io_complete_nvme_status(bdev_io, cpl->status.sct, cpl->status.sc);
+}
+
+static void
+bdev_nvme_zcopy_end_done(void *ref, const struct spdk_nvme_cpl *cpl)
+{
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx((struct nvme_bdev_io *)ref);
+
+	bdev_nvme_zcopy_release(bdev_io);
+	spdk_bdev_io_complete_nvme_status(bdev_io, cpl->status.sct, cpl->status.sc);
+}
+
+static int
+bdev_nvme_zcopy_populate(struct nvme_bdev *nbdev, struct spdk_bdev_io *bdev_io)
+{
+	struct nvme_bdev_io *bio = (struct nvme_bdev_io *)bdev_io->driver_ctx;
+	struct spdk_nvme_qpair *qpair = nvme_io_path_get_qpair(bio->io_path);
+	int rc;
+
+	if (!bdev_io->u.bdev.zcopy.populate) {
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_SUCCESS);
+		return 0;
+	}
+
+	if (qpair == NULL) {
+		return -ENXIO;
+	}
+
+	rc = spdk_nvme_ns_cmd_read_with_md(bio->io_path->ns, qpair,
+					   bdev_io->u.bdev.iovs[0].iov_base, NULL,
+					   bdev_io->u.bdev.offset_blocks, bdev_io->u.bdev.num_blocks,
+					   bdev_nvme_zcopy_start_done, bdev_io->driver_ctx,
+					   nbdev->disk.dif_check_flags, 0, 0);
+	if (rc != 0 && rc != -ENOMEM) {
+		SPDK_ERRLOG("zcopy read failed: rc = %d\n", rc);
+	}
+	return rc;
+}
+
+static void
+bdev_nvme_zcopy_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io,
+			   bool success)
+{
+	int rc;
+
+	if (!success) {
+		bdev_nvme_zcopy_release(bdev_io);
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
+	rc = bdev_nvme_zcopy_populate((struct nvme_bdev *)bdev_io->bdev->ctxt, bdev_io);
+	if (spdk_likely(rc == 0)) {
+		return;
+	}
+
+	bdev_nvme_zcopy_release(bdev_io);
+	if (rc == -ENOMEM) {
 		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_NOMEM);
 	} else {
 		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
 	}
 }
 
+static int
+bdev_nvme_zcopy_start(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
+		      struct spdk_bdev_io *bdev_io)
+{
+	struct nvme_bdev_io *bio = (struct nvme_bdev_io *)bdev_io->driver_ctx;
+	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(io_path->ctrlr_ch);
+	uint64_t len = bdev_io->u.bdev.num_blocks * bdev_io->bdev->blocklen;
+	int rc;
+
+	if (len > NVME_CMB_ZCOPY_BUF_SIZE || STAILQ_EMPTY(&nvme_ch->cmb_free_bufs)) {
+		/* The CMB buffers of the channel are used up, so stage the data in host memory. */
+		spdk_bdev_io_get_buf(bdev_io, bdev_nvme_zcopy_get_buf_cb, len);
+		return 0;
+	}
+
+	bio->cmb_buf = STAILQ_FIRST(&nvme_ch->cmb_free_bufs);
+	STAILQ_REMOVE_HEAD(&nvme_ch->cmb_free_bufs, stailq);
+	spdk_bdev_io_set_buf(bdev_io, bio->cmb_buf->buf, len);
+
+	rc = bdev_nvme_zcopy_populate(nbdev, bdev_io);
+	if (rc != 0) {
+		/* The request is completed with an error or retried from the start. */
+		bdev_nvme_zcopy_release(bdev_io);
+	}
+	return rc;
+}
+
+static int
+bdev_nvme_zcopy_end(struct nvme_bdev *nbdev, struct spdk_bdev_io *bdev_io)
+{
+	struct nvme_bdev_io *bio = (struct nvme_bdev_io *)bdev_io->driver_ctx;
+	struct spdk_nvme_qpair *qpair;
+	int rc;
+
+	if (bio->io_path == NULL) {
+		return -EINVAL;
+	}
+
+	if (!bdev_io->u.bdev.zcopy.commit) {
+		bdev_nvme_zcopy_release(bdev_io);
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_SUCCESS);
+		return 0;
+	}
+
+	qpair = nvme_io_path_get_qpair(bio->io_path);
+	if (qpair == NULL) {
+		return -ENXIO;
+	}
+
+	rc = spdk_nvme_ns_cmd_write_with_md(bio->io_path->ns, qpair,
+					    bdev_io->u.bdev.iovs[0].iov_base, NULL,
+					    bdev_io->u.bdev.offset_blocks, bdev_io->u.bdev.num_blocks,
+					    bdev_nvme_zcopy_end_done, bdev_io->driver_ctx,
+					    nbdev->disk.dif_check_flags, 0, 0);
+	if (rc != 0 && rc != -ENOMEM) {
+		SPDK_ERRLOG("zcopy write failed: rc = %d\n", rc);
+	}
+	return rc;
+}
+
 static int
 _bdev_nvme_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
+	struct nvme_bdev_channel *nbdev_ch = spdk_io_channel_get_ctx(ch);
 	struct nvme_bdev *nbdev = (struct nvme_bdev *)bdev_io->bdev->ctxt;
 	struct nvme_bdev_io *nbdev_io = (struct nvme_bdev_io *)bdev_io->driver_ctx;
-
-	if (nvme_ch->qpair == NULL) {
-		/* The device is currently resetting */
-		return -1;
-	}
+	struct nvme_io_path *io_path;
+	int rc;
 
 	switch (bdev_io->type) {
 	case SPDK_BDEV_IO_TYPE_READ:
@@ -406,30 +905,6 @@ _bdev_nvme_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_
 				     bdev_io->u.bdev.num_blocks * bdev_io->bdev->blocklen);
 		return 0;
 
-	case SPDK_BDEV_IO_TYPE_WRITE:
-		return bdev_nvme_writev(nbdev,
-					ch,
-					nbdev_io,
-					bdev_io->u.bdev.iovs,
-					bdev_io->u.bdev.iovcnt,
-					bdev_io->u.bdev.md_buf,
-					bdev_io->u.bdev.num_blocks,
-					bdev_io->u.bdev.offset_blocks);
-
-	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
-		return bdev_nvme_unmap(nbdev,
-				       ch,
-				       nbdev_io,
-				       bdev_io->u.bdev.offset_blocks,
-				       bdev_io->u.bdev.num_blocks);
-
-	case SPDK_BDEV_IO_TYPE_UNMAP:
-		return bdev_nvme_unmap(nbdev,
-				       ch,
-				       nbdev_io,
-				       bdev_io->u.bdev.offset_blocks,
-				       bdev_io->u.bdev.num_blocks);
-
 	case SPDK_BDEV_IO_TYPE_RESET:
 		return bdev_nvme_reset(nbdev, nbdev_io);
 
@@ -439,57 +914,155 @@ _bdev_nvme_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_
 				       bdev_io->u.bdev.offset_blocks,
 				       bdev_io->u.bdev.num_blocks);
 
+	case SPDK_BDEV_IO_TYPE_ZCOPY:
+		if (!bdev_io->u.bdev.zcopy.start) {
+			/* The end goes through the path the start picked. */
+			return bdev_nvme_zcopy_end(nbdev, bdev_io);
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	io_path = bdev_nvme_get_io_path(nbdev_ch, nbdev_io);
+	if (io_path == NULL) {
+		/* All paths are resetting or inaccessible */
+		return -ENXIO;
+	}
+
+	switch (bdev_io->type) {
+	case SPDK_BDEV_IO_TYPE_WRITE:
+		rc = bdev_nvme_writev(nbdev,
+				      io_path,
+				      nbdev_io,
+				      bdev_io->u.bdev.iovs,
+				      bdev_io->u.bdev.iovcnt,
+				      bdev_io->u.bdev.md_buf,
+				      bdev_io->u.bdev.num_blocks,
+				      bdev_io->u.bdev.offset_blocks);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
+	case SPDK_BDEV_IO_TYPE_UNMAP:
+		rc = bdev_nvme_unmap(nbdev,
+				     io_path,
+				     nbdev_io,
+				     bdev_io->u.bdev.offset_blocks,
+				     bdev_io->u.bdev.num_blocks);
+		break;
+
 	case SPDK_BDEV_IO_TYPE_NVME_ADMIN:
-		return bdev_nvme_admin_passthru(nbdev,
-						ch,
-						nbdev_io,
-						&bdev_io->u.nvme_passthru.cmd,
-						bdev_io->u.nvme_passthru.buf,
-						bdev_io->u.nvme_passthru.nbytes);
+		rc = bdev_nvme_admin_passthru(nbdev,
+					      io_path,
+					      nbdev_io,
+					      &bdev_io->u.nvme_passthru.cmd,
+					      bdev_io->u.nvme_passthru.buf,
+					      bdev_io->u.nvme_passthru.nbytes);
+		break;
 
 	case SPDK_BDEV_IO_TYPE_NVME_IO:
-		return bdev_nvme_io_passthru(nbdev,
-					     ch,
-					     nbdev_io,
-					     &bdev_io->u.nvme_passthru.cmd,
-					     bdev_io->u.nvme_passthru.buf,
-					     bdev_io->u.nvme_passthru.nbytes);
+		rc = bdev_nvme_io_passthru(nbdev,
+					   io_path,
+					   nbdev_io,
+					   &bdev_io->u.nvme_passthru.cmd,
+					   bdev_io->u.nvme_passthru.buf,
+					   bdev_io->u.nvme_passthru.nbytes);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_ZCOPY:
+		rc = bdev_nvme_zcopy_start(nbdev, io_path, bdev_io);
+		break;
 
 	case SPDK_BDEV_IO_TYPE_NVME_IO_MD:
-		return bdev_nvme_io_passthru_md(nbdev,
-						ch,
-						nbdev_io,
-						&bdev_io->u.nvme_passthru.cmd,
-						bdev_io->u.nvme_passthru.buf,
-						bdev_io->u.nvme_passthru.nbytes,
-						bdev_io->u.nvme_passthru.md_buf,
-						bdev_io->u.nvme_passthru.md_len);
+		rc = bdev_nvme_io_passthru_md(nbdev,
+					      io_path,
+					      nbdev_io,
+					      &bdev_io->u.nvme_passthru.cmd,
+					      bdev_io->u.nvme_passthru.buf,
+					      bdev_io->u.nvme_passthru.nbytes,
+					      bdev_io->u.nvme_passthru.md_buf,
+					      bdev_io->u.nvme_passthru.md_len);
+		break;
 
 	default:
-		return -EINVAL;
+		rc = -EINVAL;
+		break;
 	}
-	return 0;
+
+	if (rc != 0) {
+		bdev_nvme_io_path_put(nbdev_io);
+	}
+	return rc;
 }
 
 static void
 bdev_nvme_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
 {
-	int rc = _bdev_nvme_submit_request(ch, bdev_io);
+	struct nvme_bdev_io *nbdev_io = (struct nvme_bdev_io *)bdev_io->driver_ctx;
+	int rc;
 
+	if (bdev_io->type != SPDK_BDEV_IO_TYPE_ZCOPY || bdev_io->u.bdev.zcopy.start) {
+		/* Nothing is staged until the start of a zcopy gets to allocate a buffer. */
+		nbdev_io->cmb_buf = NULL;
+		nbdev_io->io_path = NULL;
+		nbdev_io->failover_count = 0;
+	}
+
+	rc = _bdev_nvme_submit_request(ch, bdev_io);
 	if (spdk_unlikely(rc != 0)) {
 		if (rc == -ENOMEM) {
 			spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_NOMEM);
 		} else {
+			if (bdev_io->type == SPDK_BDEV_IO_TYPE_ZCOPY) {
+				bdev_nvme_zcopy_release(bdev_io);
+			}
 			spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
 		}
 	}
 }
 
+/*
+ * Release the path of a completed request. If the request failed because of its
+ * path and the bdev has another one, resubmit the request through that path.
+ *
+ * Returns true if the request was resubmitted.
+ */
+static bool
+bdev_nvme_io_path_done(struct nvme_bdev_io *bio, const struct spdk_nvme_cpl *cpl)
+{
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
+	struct spdk_io_channel *ch = spdk_bdev_io_get_io_channel(bdev_io);
+	struct nvme_bdev_channel *nbdev_ch = spdk_io_channel_get_ctx(ch);
+	bool failover;
+
+	failover = nvme_bdev_io_path_failover(nbdev_ch, bio->io_path, cpl, bio->failover_count);
+	bdev_nvme_io_path_put(bio);
+	if (spdk_likely(!failover)) {
+		return false;
+	}
+
+	bio->failover_count++;
+	SPDK_DEBUGLOG(SPDK_LOG_BDEV_NVME, "failing over I/O of %s (sct=%d, sc=%d)\n",
+		      bdev_io->bdev->name, cpl->status.sct, cpl->status.sc);
+
+	return _bdev_nvme_submit_request(ch, bdev_io) == 0;
+}
+
 static bool
 bdev_nvme_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type)
 {
 	struct nvme_bdev *nbdev = ctx;
+	struct nvme_bdev_ns *nvme_ns;
 	const struct spdk_nvme_ctrlr_data *cdata;
+	bool supported;
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	nvme_ns = TAILQ_FIRST(&nbdev->nvme_ns_list);
+	if (nvme_ns == NULL) {
+		pthread_mutex_unlock(&g_bdev_nvme_mutex);
+		return false;
+	}
 
 	switch (io_type) {
 	case SPDK_BDEV_IO_TYPE_READ:
@@ -498,72 +1071,237 @@ bdev_nvme_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type)
 	case SPDK_BDEV_IO_TYPE_FLUSH:
 	case SPDK_BDEV_IO_TYPE_NVME_ADMIN:
 	case SPDK_BDEV_IO_TYPE_NVME_IO:
-		return true;
+		supported = true;
+		break;
 
 	case SPDK_BDEV_IO_TYPE_NVME_IO_MD:
-		return spdk_nvme_ns_get_md_size(nbdev->ns) ? true : false;
+		supported = spdk_nvme_ns_get_md_size(nvme_ns->ns) ? true : false;
+		break;
+
+	case SPDK_BDEV_IO_TYPE_ZCOPY:
+		supported = nbdev->cmb_zcopy;
+		break;
 
 	case SPDK_BDEV_IO_TYPE_UNMAP:
-		cdata = spdk_nvme_ctrlr_get_data(nbdev->nvme_bdev_ctrlr->ctrlr);
-		return cdata->oncs.dsm;
+		cdata = spdk_nvme_ctrlr_get_data(nvme_ns->ctrlr->ctrlr);
+		supported = cdata->oncs.dsm;
+		break;
 
 	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
-		cdata = spdk_nvme_ctrlr_get_data(nbdev->nvme_bdev_ctrlr->ctrlr);
+		cdata = spdk_nvme_ctrlr_get_data(nvme_ns->ctrlr->ctrlr);
 		/*
 		 * If an NVMe controller guarantees reading unallocated blocks returns zero,
 		 * we can implement WRITE_ZEROES as an NVMe deallocate command.
-		 */
-		if (cdata->oncs.dsm &&
-		    spdk_nvme_ns_get_dealloc_logical_block_read_value(nbdev->ns) == SPDK_NVME_DEALLOC_READ_00) {
-			return true;
-		}
-		/*
+		 *
 		 * The NVMe controller write_zeroes function is currently not used by our driver.
 		 * If a user submits an arbitrarily large write_zeroes request to the controller, the request will fail.
 		 * Until this is resolved, we only claim support for write_zeroes if deallocated blocks return 0's when read.
 		 */
-		return false;
+		supported = cdata->oncs.dsm &&
+			    spdk_nvme_ns_get_dealloc_logical_block_read_value(nvme_ns->ns) ==
+			    SPDK_NVME_DEALLOC_READ_00;
+		break;
+
+	default:
+		supported = false;
+		break;
+	}
+
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+	return supported;
+}
+
+/*
+ * Carve the CMB buffers of a channel out of the controller memory buffer. Without
+ * them the zcopy requests of the channel stage their data in host memory.
+ */
+static void
+bdev_nvme_alloc_cmb_bufs(struct spdk_nvme_ctrlr *ctrlr, struct nvme_io_channel *ch)
+{
+	uint32_t i;
+
+	STAILQ_INIT(&ch->cmb_free_bufs);
+	if (!g_opts.cmb_zcopy || !bdev_nvme_cmb_data_supported(ctrlr)) {
+		return;
+	}
+
+	ch->cmb_bufs = calloc(NVME_CMB_ZCOPY_BUFS, sizeof(*ch->cmb_bufs));
+	if (ch->cmb_bufs == NULL) {
+		return;
+	}
+
+	ch->cmb_pool = spdk_nvme_ctrlr_alloc_cmb_io_buffer(ctrlr,
+			NVME_CMB_ZCOPY_BUFS * NVME_CMB_ZCOPY_BUF_SIZE);
+	if (ch->cmb_pool == NULL) {
+		SPDK_NOTICELOG("CMB is used up, zcopy requests of the channel use host memory\n");
+		free(ch->cmb_bufs);
+		ch->cmb_bufs = NULL;
+		return;
+	}
+
+	for (i = 0; i < NVME_CMB_ZCOPY_BUFS; i++) {
+		ch->cmb_bufs[i].buf = (uint8_t *)ch->cmb_pool + i * NVME_CMB_ZCOPY_BUF_SIZE;
+		STAILQ_INSERT_TAIL(&ch->cmb_free_bufs, &ch->cmb_bufs[i], stailq);
+	}
+}
+
+static void
+bdev_nvme_free_cmb_bufs(struct spdk_nvme_ctrlr *ctrlr, struct nvme_io_channel *ch)
+{
+	if (ch->cmb_pool != NULL) {
+		spdk_nvme_ctrlr_free_cmb_io_buffer(ctrlr, ch->cmb_pool,
+						   NVME_CMB_ZCOPY_BUFS * NVME_CMB_ZCOPY_BUF_SIZE);
+		ch->cmb_pool = NULL;
+	}
+	free(ch->cmb_bufs);
+	ch->cmb_bufs = NULL;
+}
+
+static int
+bdev_nvme_create_cb(void *io_device, void *ctx_buf)
+{
+	struct spdk_nvme_ctrlr *ctrlr = io_device;
+	struct nvme_io_channel *ch = ctx_buf;
+	struct nvme_bdev_poll_group *group;
+
+	ch->group_ch = spdk_get_io_channel(&g_nvme_bdev_ctrlrs);
+	if (ch->group_ch == NULL) {
+		return -1;
+	}
+
+	if (bdev_nvme_create_qpair(ctrlr, ch) != 0) {
+		spdk_put_io_channel(ch->group_ch);
+		return -1;
+	}
+
+	group = spdk_io_channel_get_ctx(ch->group_ch);
+	TAILQ_INSERT_TAIL(&group->io_channels, ch, tailq);
+	bdev_nvme_alloc_cmb_bufs(ctrlr, ch);
+
+	return 0;
+}
+
+static void
+bdev_nvme_destroy_cb(void *io_device, void *ctx_buf)
+{
+	struct spdk_nvme_ctrlr *ctrlr = io_device;
+	struct nvme_io_channel *ch = ctx_buf;
+	struct nvme_bdev_poll_group *group = spdk_io_channel_get_ctx(ch->group_ch);
+
+	TAILQ_REMOVE(&group->io_channels, ch, tailq);
+	bdev_nvme_free_cmb_bufs(ctrlr, ch);
+	spdk_nvme_ctrlr_free_io_qpair(ch->qpair);
+	spdk_put_io_channel(ch->group_ch);
+}
+
+static int
+bdev_nvme_channel_add_io_path(struct nvme_bdev_channel *nbdev_ch, struct nvme_bdev_ns *nvme_ns)
+{
+	struct nvme_io_path *io_path;
+
+	TAILQ_FOREACH(io_path, &nbdev_ch->io_paths, tailq) {
+		if (io_path->nvme_ns == nvme_ns) {
+			/* The channel was created after the path was added. */
+			return 0;
+		}
+	}
+
+	io_path = calloc(1, sizeof(*io_path));
+	if (io_path == NULL) {
+		return -ENOMEM;
+	}
+
+	io_path->ctrlr_ch = spdk_get_io_channel(nvme_ns->ctrlr->ctrlr);
+	if (io_path->ctrlr_ch == NULL) {
+		SPDK_ERRLOG("Failed to get I/O channel of controller %s\n", nvme_ns->ctrlr->name);
+		free(io_path);
+		return -ENOMEM;
+	}
+
+	io_path->nvme_ns = nvme_ns;
+	io_path->ns = nvme_ns->ns;
+	io_path->ctrlr = nvme_ns->ctrlr->ctrlr;
+	TAILQ_INSERT_TAIL(&nbdev_ch->io_paths, io_path, tailq);
+	nbdev_ch->num_paths++;
+
+	return 0;
+}
+
+static void
+bdev_nvme_channel_destroy_cb(void *io_device, void *ctx_buf)
+{
+	struct nvme_bdev_channel *nbdev_ch = ctx_buf;
+	struct nvme_io_path *io_path;
+
+	while ((io_path = TAILQ_FIRST(&nbdev_ch->io_paths)) != NULL) {
+		TAILQ_REMOVE(&nbdev_ch->io_paths, io_path, tailq);
+		assert(io_path->outstanding == 0);
+		bdev_nvme_io_path_free(io_path);
+	}
+}
+
+static int
+bdev_nvme_channel_create_cb(void *io_device, void *ctx_buf)
+{
+	struct nvme_bdev *nbdev = io_device;
+	struct nvme_bdev_channel *nbdev_ch = ctx_buf;
+	struct nvme_bdev_ns *nvme_ns;
 
-	default:
-		return false;
+	TAILQ_INIT(&nbdev_ch->io_paths);
+	nbdev_ch->num_paths = 0;
+	nbdev_ch->rr_path = NULL;
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	TAILQ_FOREACH(nvme_ns, &nbdev->nvme_ns_list, tailq) {
+		/* A path the channel can't connect to is left out. */
+		bdev_nvme_channel_add_io_path(nbdev_ch, nvme_ns);
+	}
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	if (nbdev_ch->num_paths == 0) {
+		return -1;
 	}
+
+	return 0;
 }
 
 static int
-bdev_nvme_create_cb(void *io_device, void *ctx_buf)
+bdev_nvme_poll_group_create_cb(void *io_device, void *ctx_buf)
 {
-	struct spdk_nvme_ctrlr *ctrlr = io_device;
-	struct nvme_io_channel *ch = ctx_buf;
-	struct spdk_nvme_io_qpair_opts opts;
+	struct nvme_bdev_poll_group *group = ctx_buf;
 
 #ifdef SPDK_CONFIG_VTUNE
-	ch->collect_spin_stat = true;
+	group->collect_spin_stat = true;
 #else
-	ch->collect_spin_stat = false;
+	group->collect_spin_stat = false;
 #endif
+	TAILQ_INIT(&group->io_channels);
 
-	spdk_nvme_ctrlr_get_default_io_qpair_opts(ctrlr, &opts, sizeof(opts));
-	opts.delay_pcie_doorbell = true;
-	opts.io_queue_requests = spdk_max(g_opts.io_queue_requests, opts.io_queue_requests);
-	g_opts.io_queue_requests = opts.io_queue_requests;
-
-	ch->qpair = spdk_nvme_ctrlr_alloc_io_qpair(ctrlr, &opts, sizeof(opts));
+	group->group = spdk_nvme_poll_group_create(group);
+	if (group->group == NULL) {
+		return -1;
+	}
 
-	if (ch->qpair == NULL) {
+	group->poller = SPDK_POLLER_REGISTER(bdev_nvme_poll, group, g_opts.nvme_ioq_poll_period_us);
+	if (group->poller == NULL) {
+		SPDK_ERRLOG("Failed to register poller.\n");
+		spdk_nvme_poll_group_destroy(group->group);
 		return -1;
 	}
 
-	ch->poller = spdk_poller_register(bdev_nvme_poll, ch, g_opts.nvme_ioq_poll_period_us);
 	return 0;
 }
 
 static void
-bdev_nvme_destroy_cb(void *io_device, void *ctx_buf)
+bdev_nvme_poll_group_destroy_cb(void *io_device, void *ctx_buf)
 {
-	struct nvme_io_channel *ch = ctx_buf;
+	struct nvme_bdev_poll_group *group = ctx_buf;
 
-	spdk_nvme_ctrlr_free_io_qpair(ch->qpair);
-	spdk_poller_unregister(&ch->poller);
+	spdk_poller_unregister(&group->poller);
+	if (spdk_nvme_poll_group_destroy(group->group)) {
+		SPDK_ERRLOG("Unable to destroy a poll group for the NVMe bdev module.\n");
+		assert(false);
+	}
 }
 
 static struct spdk_io_channel *
@@ -571,24 +1309,73 @@ bdev_nvme_get_io_channel(void *ctx)
 {
 	struct nvme_bdev *nvme_bdev = ctx;
 
-	return spdk_get_io_channel(nvme_bdev->nvme_bdev_ctrlr->ctrlr);
+	return spdk_get_io_channel(nvme_bdev);
+}
+
+/* Called with g_bdev_nvme_mutex held */
+static void
+_bdev_nvme_dump_paths_json(struct nvme_bdev *nvme_bdev, struct spdk_json_write_ctx *w)
+{
+	struct nvme_bdev_ns *nvme_ns;
+
+	spdk_json_write_named_string(w, "name", nvme_bdev->disk.name);
+	spdk_json_write_named_string(w, "policy", nvme_bdev_mp_policy_str(nvme_bdev->mp_policy));
+
+	spdk_json_write_named_array_begin(w, "paths");
+	TAILQ_FOREACH(nvme_ns, &nvme_bdev->nvme_ns_list, tailq) {
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_string(w, "ctrlr", nvme_ns->ctrlr->name);
+		spdk_json_write_named_object_begin(w, "trid");
+		nvme_bdev_dump_trid_json(&nvme_ns->ctrlr->trid, w);
+		spdk_json_write_object_end(w);
+		spdk_json_write_named_string(w, "ana_state",
+					     nvme_bdev_ana_state_str(nvme_ns->ana_state));
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_array_end(w);
+}
+
+int
+spdk_bdev_nvme_dump_paths_json(struct spdk_bdev *bdev, struct spdk_json_write_ctx *w)
+{
+	if (bdev->module != &nvme_if) {
+		return -ENODEV;
+	}
+
+	spdk_json_write_object_begin(w);
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	_bdev_nvme_dump_paths_json(bdev->ctxt, w);
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+	spdk_json_write_object_end(w);
+
+	return 0;
 }
 
 static int
 bdev_nvme_dump_info_json(void *ctx, struct spdk_json_write_ctx *w)
 {
 	struct nvme_bdev *nvme_bdev = ctx;
-	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr = nvme_bdev->nvme_bdev_ctrlr;
+	struct nvme_bdev_ns *nvme_ns;
+	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr;
 	const struct spdk_nvme_ctrlr_data *cdata;
 	struct spdk_nvme_ns *ns;
 	union spdk_nvme_vs_register vs;
 	union spdk_nvme_csts_register csts;
 	char buf[128];
 
-	cdata = spdk_nvme_ctrlr_get_data(nvme_bdev->nvme_bdev_ctrlr->ctrlr);
-	vs = spdk_nvme_ctrlr_get_regs_vs(nvme_bdev->nvme_bdev_ctrlr->ctrlr);
-	csts = spdk_nvme_ctrlr_get_regs_csts(nvme_bdev->nvme_bdev_ctrlr->ctrlr);
-	ns = nvme_bdev->ns;
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	nvme_ns = TAILQ_FIRST(&nvme_bdev->nvme_ns_list);
+	if (nvme_ns == NULL) {
+		pthread_mutex_unlock(&g_bdev_nvme_mutex);
+		return 0;
+	}
+
+	/* The controller data is reported for the first path. */
+	nvme_bdev_ctrlr = nvme_ns->ctrlr;
+	cdata = spdk_nvme_ctrlr_get_data(nvme_bdev_ctrlr->ctrlr);
+	vs = spdk_nvme_ctrlr_get_regs_vs(nvme_bdev_ctrlr->ctrlr);
+	csts = spdk_nvme_ctrlr_get_regs_csts(nvme_bdev_ctrlr->ctrlr);
+	ns = nvme_ns->ns;
 
 	spdk_json_write_named_object_begin(w, "nvme");
 
@@ -663,6 +1450,12 @@ bdev_nvme_dump_info_json(void *ctx, struct spdk_json_write_ctx *w)
 
 	spdk_json_write_object_end(w);
 
+	spdk_json_write_named_object_begin(w, "multipath");
+	_bdev_nvme_dump_paths_json(nvme_bdev, w);
+	spdk_json_write_object_end(w);
+
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
 	return 0;
 }
 
@@ -675,21 +1468,31 @@ bdev_nvme_write_config_json(struct spdk_bdev *bdev, struct spdk_json_write_ctx *
 static uint64_t
 bdev_nvme_get_spin_time(struct spdk_io_channel *ch)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
+	struct nvme_bdev_channel *nbdev_ch = spdk_io_channel_get_ctx(ch);
+	struct nvme_io_path *io_path = TAILQ_FIRST(&nbdev_ch->io_paths);
+	struct nvme_io_channel *nvme_ch;
+	struct nvme_bdev_poll_group *group;
 	uint64_t spin_time;
 
-	if (!nvme_ch->collect_spin_stat) {
+	if (io_path == NULL) {
+		return 0;
+	}
+
+	/* All the paths of the channel are polled by the same group. */
+	nvme_ch = spdk_io_channel_get_ctx(io_path->ctrlr_ch);
+	group = spdk_io_channel_get_ctx(nvme_ch->group_ch);
+	if (!group->collect_spin_stat) {
 		return 0;
 	}
 
-	if (nvme_ch->end_ticks != 0) {
-		nvme_ch->spin_ticks += (nvme_ch->end_ticks - nvme_ch->start_ticks);
-		nvme_ch->end_ticks = 0;
+	if (group->end_ticks != 0) {
+		group->spin_ticks += (group->end_ticks - group->start_ticks);
+		group->end_ticks = 0;
 	}
 
-	spin_time = (nvme_ch->spin_ticks * 1000000ULL) / spdk_get_ticks_hz();
-	nvme_ch->start_ticks = 0;
-	nvme_ch->spin_ticks = 0;
+	spin_time = (group->spin_ticks * 1000000ULL) / spdk_get_ticks_hz();
+	group->start_ticks = 0;
+	group->spin_ticks = 0;
 
 	return spin_time;
 }
@@ -704,10 +1507,103 @@ static const struct spdk_bdev_fn_table nvmelib_fn_table = {
 	.get_spin_time		= bdev_nvme_get_spin_time,
 };
 
+static bool
+bdev_nvme_cmb_data_supported(struct spdk_nvme_ctrlr *ctrlr)
+{
+	union spdk_nvme_cmbsz_register cmbsz;
+
+	if (spdk_nvme_ctrlr_get_transport_id(ctrlr)->trtype != SPDK_NVME_TRANSPORT_PCIE) {
+		return false;
+	}
+
+	cmbsz = spdk_nvme_ctrlr_get_regs_cmbsz(ctrlr);
+
+	return cmbsz.bits.sz != 0 && cmbsz.bits.wds && cmbsz.bits.rds;
+}
+
+static bool
+bdev_nvme_ns_ids_match(struct spdk_nvme_ns *ns1, struct spdk_nvme_ns *ns2)
+{
+	const struct spdk_nvme_ns_data *nsdata1 = spdk_nvme_ns_get_data(ns1);
+	const struct spdk_nvme_ns_data *nsdata2 = spdk_nvme_ns_get_data(ns2);
+	const struct spdk_uuid *uuid1 = spdk_nvme_ns_get_uuid(ns1);
+	const struct spdk_uuid *uuid2 = spdk_nvme_ns_get_uuid(ns2);
+	static const uint8_t zero_nguid[sizeof(nsdata1->nguid)];
+
+	if (uuid1 != NULL && uuid2 != NULL) {
+		return spdk_uuid_compare(uuid1, uuid2) == 0;
+	}
+
+	if (memcmp(nsdata1->nguid, zero_nguid, sizeof(zero_nguid)) != 0) {
+		return memcmp(nsdata1->nguid, nsdata2->nguid, sizeof(nsdata1->nguid)) == 0;
+	}
+
+	return nsdata1->eui64 != 0 && nsdata1->eui64 == nsdata2->eui64;
+}
+
+/*
+ * Find the bdev of a namespace which is reachable through another controller of the
+ * same subsystem. Only namespaces which report to be shared and have a unique
+ * identifier are grouped.
+ *
+ * Called with g_bdev_nvme_mutex held.
+ */
+static struct nvme_bdev *
+nvme_bdev_find_multipath_bdev(struct nvme_bdev_ns *nvme_ns)
+{
+	const struct spdk_nvme_ctrlr_data *cdata = spdk_nvme_ctrlr_get_data(nvme_ns->ctrlr->ctrlr);
+	const struct spdk_nvme_ns_data *nsdata = spdk_nvme_ns_get_data(nvme_ns->ns);
+	const struct spdk_nvme_ctrlr_data *other_cdata;
+	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr;
+	struct nvme_bdev_ns *other_ns;
+	struct nvme_bdev *bdev;
+	uint32_t i;
+
+	if (cdata->subnqn[0] == '\0' || !nsdata->nmic.can_share) {
+		return NULL;
+	}
+
+	TAILQ_FOREACH(nvme_bdev_ctrlr, &g_nvme_bdev_ctrlrs, tailq) {
+		if (nvme_bdev_ctrlr == nvme_ns->ctrlr || nvme_bdev_ctrlr->destruct) {
+			continue;
+		}
+
+		other_cdata = spdk_nvme_ctrlr_get_data(nvme_bdev_ctrlr->ctrlr);
+		if (strncmp((const char *)cdata->subnqn, (const char *)other_cdata->subnqn,
+			    sizeof(cdata->subnqn)) != 0) {
+			continue;
+		}
+
+		for (i = 0; i < nvme_bdev_ctrlr->num_ns; i++) {
+			other_ns = &nvme_bdev_ctrlr->namespaces[i];
+			if (!other_ns->active || other_ns->bdev == NULL ||
+			    !spdk_nvme_ns_get_data(other_ns->ns)->nmic.can_share ||
+			    !bdev_nvme_ns_ids_match(nvme_ns->ns, other_ns->ns)) {
+				continue;
+			}
+
+			bdev = other_ns->bdev;
+			if (spdk_nvme_ns_get_extended_sector_size(nvme_ns->ns) !=
+			    bdev->disk.blocklen ||
+			    spdk_nvme_ns_get_num_sectors(nvme_ns->ns) != bdev->disk.blockcnt ||
+			    spdk_nvme_ns_get_md_size(nvme_ns->ns) != bdev->disk.md_len) {
+				SPDK_ERRLOG("NSID %u of %s doesn't match the format of %s\n",
+					    nvme_ns->id, nvme_ns->ctrlr->name, bdev->disk.name);
+				return NULL;
+			}
+
+			return bdev;
+		}
+	}
+
+	return NULL;
+}
+
 static int
 nvme_ctrlr_create_bdev(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr, uint32_t nsid)
 {
 	struct spdk_nvme_ctrlr	*ctrlr = nvme_bdev_ctrlr->ctrlr;
+	struct nvme_bdev_ns	*nvme_ns;
 	struct nvme_bdev	*bdev;
 	struct spdk_nvme_ns	*ns;
 	const struct spdk_uuid	*uuid;
@@ -723,17 +1619,38 @@ nvme_ctrlr_create_bdev(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr, uint32_t nsid)
 		return -EINVAL;
 	}
 
-	bdev = &nvme_bdev_ctrlr->bdevs[nsid - 1];
-	bdev->id = nsid;
+	nvme_ns = &nvme_bdev_ctrlr->namespaces[nsid - 1];
+	if (nvme_ns->bdev != NULL) {
+		/* The bdev of the namespace is still being removed */
+		return -EBUSY;
+	}
+
+	nvme_ns->id = nsid;
+	nvme_ns->ns = ns;
+	nvme_ns->ctrlr = nvme_bdev_ctrlr;
 
-	bdev->nvme_bdev_ctrlr = nvme_bdev_ctrlr;
-	bdev->ns = ns;
-	nvme_bdev_ctrlr->ref++;
+	if (g_opts.multipath) {
+		pthread_mutex_lock(&g_bdev_nvme_mutex);
+		bdev = nvme_bdev_find_multipath_bdev(nvme_ns);
+		if (bdev != NULL) {
+			SPDK_NOTICELOG("Adding namespace %u of %s as a path of bdev %s\n", nsid,
+				       nvme_bdev_ctrlr->name, bdev->disk.name);
+			nvme_bdev_add_path(bdev, nvme_ns);
+			pthread_mutex_unlock(&g_bdev_nvme_mutex);
+			return 0;
+		}
+		pthread_mutex_unlock(&g_bdev_nvme_mutex);
+	}
+
+	bdev = calloc(1, sizeof(*bdev));
+	if (bdev == NULL) {
+		return -ENOMEM;
+	}
+	TAILQ_INIT(&bdev->nvme_ns_list);
 
 	bdev->disk.name = spdk_sprintf_alloc("%sn%d", nvme_bdev_ctrlr->name, spdk_nvme_ns_get_id(ns));
 	if (!bdev->disk.name) {
-		nvme_bdev_ctrlr->ref--;
-		memset(bdev, 0, sizeof(*bdev));
+		free(bdev);
 		return -ENOMEM;
 	}
 	bdev->disk.product_name = "NVMe disk";
@@ -763,22 +1680,33 @@ nvme_ctrlr_create_bdev(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr, uint32_t nsid)
 		}
 	}
 
+	bdev->cmb_zcopy = g_opts.cmb_zcopy && bdev_nvme_cmb_data_supported(ctrlr) &&
+			  (bdev->disk.md_len == 0 || bdev->disk.md_interleave);
+	bdev->mp_policy = NVME_BDEV_MP_POLICY_ROUND_ROBIN;
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	nvme_ns->bdev = bdev;
+	nvme_ns->active = true;
+	nvme_bdev_ctrlr->ref++;
+	TAILQ_INSERT_TAIL(&bdev->nvme_ns_list, nvme_ns, tailq);
+	bdev->num_paths = 1;
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	spdk_io_device_register(bdev, bdev_nvme_channel_create_cb, bdev_nvme_channel_destroy_cb,
+				sizeof(struct nvme_bdev_channel), bdev->disk.name);
+
 	bdev->disk.ctxt = bdev;
 	bdev->disk.fn_table = &nvmelib_fn_table;
 	bdev->disk.module = &nvme_if;
 	rc = spdk_bdev_register(&bdev->disk);
 	if (rc) {
-		free(bdev->disk.name);
-		nvme_bdev_ctrlr->ref--;
-		memset(bdev, 0, sizeof(*bdev));
+		_bdev_nvme_destruct(bdev);
 		return rc;
 	}
-	bdev->active = true;
 
 	return 0;
 }
 
-
 static bool
 hotplug_probe_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
 		 struct spdk_nvme_ctrlr_opts *opts)
@@ -795,6 +1723,7 @@ hotplug_probe_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
 	opts->low_priority_weight = (uint8_t)g_opts.low_priority_weight;
 	opts->medium_priority_weight = (uint8_t)g_opts.medium_priority_weight;
 	opts->high_priority_weight = (uint8_t)g_opts.high_priority_weight;
+	opts->use_cmb_sqs = g_opts.use_cmb_sqs;
 
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_NVME, "Attaching to %s\n", trid->traddr);
 
@@ -840,6 +1769,7 @@ probe_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
 	opts->low_priority_weight = (uint8_t)g_opts.low_priority_weight;
 	opts->medium_priority_weight = (uint8_t)g_opts.medium_priority_weight;
 	opts->high_priority_weight = (uint8_t)g_opts.high_priority_weight;
+	opts->use_cmb_sqs = g_opts.use_cmb_sqs;
 
 	return true;
 }
@@ -906,35 +1836,137 @@ timeout_cb(void *cb_arg, struct spdk_nvme_ctrlr *ctrlr,
 	}
 }
 
-static void
-nvme_ctrlr_deactivate_bdev(struct nvme_bdev *bdev)
-{
-	spdk_bdev_unregister(&bdev->disk, NULL, NULL);
-	bdev->active = false;
-}
-
 static void
 nvme_ctrlr_update_ns_bdevs(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr)
 {
 	struct spdk_nvme_ctrlr	*ctrlr = nvme_bdev_ctrlr->ctrlr;
 	uint32_t		i;
-	struct nvme_bdev	*bdev;
+	struct nvme_bdev_ns	*nvme_ns;
 
 	for (i = 0; i < nvme_bdev_ctrlr->num_ns; i++) {
 		uint32_t	nsid = i + 1;
 
-		bdev = &nvme_bdev_ctrlr->bdevs[i];
-		if (!bdev->active && spdk_nvme_ctrlr_is_active_ns(ctrlr, nsid)) {
+		nvme_ns = &nvme_bdev_ctrlr->namespaces[i];
+		if (!nvme_ns->active && spdk_nvme_ctrlr_is_active_ns(ctrlr, nsid)) {
 			SPDK_NOTICELOG("NSID %u to be added\n", nsid);
 			nvme_ctrlr_create_bdev(nvme_bdev_ctrlr, nsid);
 		}
 
-		if (bdev->active && !spdk_nvme_ctrlr_is_active_ns(ctrlr, nsid)) {
-			SPDK_NOTICELOG("NSID %u Bdev %s is removed\n", nsid, bdev->disk.name);
-			nvme_ctrlr_deactivate_bdev(bdev);
+		if (nvme_ns->active && !spdk_nvme_ctrlr_is_active_ns(ctrlr, nsid)) {
+			SPDK_NOTICELOG("NSID %u Bdev %s is removed\n", nsid,
+				       nvme_ns->bdev->disk.name);
+			nvme_ctrlr_deactivate_ns(nvme_ns);
+		}
+	}
+
+}
+
+struct nvme_ana_log_ctx {
+	struct spdk_nvme_ctrlr	*ctrlr;
+	void			*buf;
+	uint32_t		size;
+};
+
+static void
+bdev_nvme_ana_log_page_done(void *arg, const struct spdk_nvme_cpl *cpl)
+{
+	struct nvme_ana_log_ctx *ctx = arg;
+	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr;
+	struct spdk_nvme_ana_page *page = ctx->buf;
+	struct spdk_nvme_ana_group_descriptor *desc;
+	struct nvme_bdev_ns *nvme_ns;
+	size_t offset, desc_size;
+	uint32_t i, j, nsid;
+
+	if (spdk_nvme_cpl_is_error(cpl)) {
+		SPDK_ERRLOG("Reading the ANA log page failed\n");
+		goto out;
+	}
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	TAILQ_FOREACH(nvme_bdev_ctrlr, &g_nvme_bdev_ctrlrs, tailq) {
+		if (nvme_bdev_ctrlr->ctrlr == ctx->ctrlr) {
+			break;
+		}
+	}
+
+	if (nvme_bdev_ctrlr == NULL || nvme_bdev_ctrlr->destruct) {
+		pthread_mutex_unlock(&g_bdev_nvme_mutex);
+		goto out;
+	}
+
+	offset = sizeof(*page);
+	for (i = 0; i < page->num_ana_group_desc; i++) {
+		if (offset + sizeof(*desc) > ctx->size) {
+			break;
+		}
+
+		desc = (struct spdk_nvme_ana_group_descriptor *)((uint8_t *)ctx->buf + offset);
+		desc_size = sizeof(*desc) + desc->num_of_nsid * sizeof(uint32_t);
+		if (offset + desc_size > ctx->size) {
+			break;
+		}
+
+		for (j = 0; j < desc->num_of_nsid; j++) {
+			nsid = desc->nsid[j];
+			if (nsid == 0 || nsid > nvme_bdev_ctrlr->num_ns) {
+				continue;
+			}
+
+			nvme_ns = &nvme_bdev_ctrlr->namespaces[nsid - 1];
+			if (nvme_ns->ana_state != desc->ana_state) {
+				SPDK_NOTICELOG("NSID %u of %s is in ANA state %s\n",
+					       nsid, nvme_bdev_ctrlr->name,
+					       nvme_bdev_ana_state_str(desc->ana_state));
+				nvme_ns->ana_state = desc->ana_state;
+			}
 		}
+
+		offset += desc_size;
+	}
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+out:
+	free(ctx->buf);
+	free(ctx);
+}
+
+static void
+bdev_nvme_read_ana_log_page(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr)
+{
+	const struct spdk_nvme_ctrlr_data *cdata = spdk_nvme_ctrlr_get_data(nvme_bdev_ctrlr->ctrlr);
+	struct nvme_ana_log_ctx *ctx;
+	int rc;
+
+	if (!cdata->cmic.ana_reporting) {
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		return;
+	}
+
+	ctx->ctrlr = nvme_bdev_ctrlr->ctrlr;
+	ctx->size = sizeof(struct spdk_nvme_ana_page) +
+		    cdata->nanagrpid * sizeof(struct spdk_nvme_ana_group_descriptor) +
+		    nvme_bdev_ctrlr->num_ns * sizeof(uint32_t);
+	ctx->buf = calloc(1, ctx->size);
+	if (ctx->buf == NULL) {
+		free(ctx);
+		return;
 	}
 
+	rc = spdk_nvme_ctrlr_cmd_get_log_page(nvme_bdev_ctrlr->ctrlr,
+					      SPDK_NVME_LOG_ASYMMETRIC_NAMESPACE_ACCESS,
+					      SPDK_NVME_GLOBAL_NS_TAG, ctx->buf, ctx->size, 0,
+					      bdev_nvme_ana_log_page_done, ctx);
+	if (rc != 0) {
+		SPDK_ERRLOG("Failed to read the ANA log page of %s: %d\n",
+			    nvme_bdev_ctrlr->name, rc);
+		free(ctx->buf);
+		free(ctx);
+	}
 }
 
 static void
@@ -952,6 +1984,9 @@ aer_cb(void *arg, const struct spdk_nvme_cpl *cpl)
 	if ((event.bits.async_event_type == SPDK_NVME_ASYNC_EVENT_TYPE_NOTICE) &&
 	    (event.bits.async_event_info == SPDK_NVME_ASYNC_EVENT_NS_ATTR_CHANGED)) {
 		nvme_ctrlr_update_ns_bdevs(nvme_bdev_ctrlr);
+	} else if ((event.bits.async_event_type == SPDK_NVME_ASYNC_EVENT_TYPE_NOTICE) &&
+		   (event.bits.async_event_info == SPDK_NVME_ASYNC_EVENT_ANA_CHANGE)) {
+		bdev_nvme_read_ana_log_page(nvme_bdev_ctrlr);
 	}
 }
 
@@ -962,6 +1997,7 @@ create_ctrlr(struct spdk_nvme_ctrlr *ctrlr,
 	     uint32_t prchk_flags)
 {
 	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr;
+	uint32_t i;
 
 	nvme_bdev_ctrlr = calloc(1, sizeof(*nvme_bdev_ctrlr));
 	if (nvme_bdev_ctrlr == NULL) {
@@ -969,12 +2005,16 @@ create_ctrlr(struct spdk_nvme_ctrlr *ctrlr,
 		return -ENOMEM;
 	}
 	nvme_bdev_ctrlr->num_ns = spdk_nvme_ctrlr_get_num_ns(ctrlr);
-	nvme_bdev_ctrlr->bdevs = calloc(nvme_bdev_ctrlr->num_ns, sizeof(struct nvme_bdev));
-	if (!nvme_bdev_ctrlr->bdevs) {
-		SPDK_ERRLOG("Failed to allocate block devices struct\n");
+	nvme_bdev_ctrlr->namespaces = calloc(nvme_bdev_ctrlr->num_ns, sizeof(struct nvme_bdev_ns));
+	if (!nvme_bdev_ctrlr->namespaces) {
+		SPDK_ERRLOG("Failed to allocate namespaces struct\n");
 		free(nvme_bdev_ctrlr);
 		return -ENOMEM;
 	}
+	/* Without ANA reporting all the namespaces are optimized. */
+	for (i = 0; i < nvme_bdev_ctrlr->num_ns; i++) {
+		nvme_bdev_ctrlr->namespaces[i].ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	}
 
 	nvme_bdev_ctrlr->adminq_timer_poller = NULL;
 	nvme_bdev_ctrlr->ctrlr = ctrlr;
@@ -982,7 +2022,7 @@ create_ctrlr(struct spdk_nvme_ctrlr *ctrlr,
 	nvme_bdev_ctrlr->trid = *trid;
 	nvme_bdev_ctrlr->name = strdup(name);
 	if (nvme_bdev_ctrlr->name == NULL) {
-		free(nvme_bdev_ctrlr->bdevs);
+		free(nvme_bdev_ctrlr->namespaces);
 		free(nvme_bdev_ctrlr);
 		return -ENOMEM;
 	}
@@ -992,7 +2032,7 @@ create_ctrlr(struct spdk_nvme_ctrlr *ctrlr,
 				sizeof(struct nvme_io_channel),
 				name);
 
-	nvme_bdev_ctrlr->adminq_timer_poller = spdk_poller_register(bdev_nvme_poll_adminq, ctrlr,
+	nvme_bdev_ctrlr->adminq_timer_poller = SPDK_POLLER_REGISTER(bdev_nvme_poll_adminq, ctrlr,
 					       g_opts.nvme_adminq_poll_period_us);
 
 	TAILQ_INSERT_TAIL(&g_nvme_bdev_ctrlrs, nvme_bdev_ctrlr, tailq);
@@ -1003,6 +2043,7 @@ create_ctrlr(struct spdk_nvme_ctrlr *ctrlr,
 	}
 
 	spdk_nvme_ctrlr_register_aer_callback(ctrlr, aer_cb, nvme_bdev_ctrlr);
+	bdev_nvme_read_ana_log_page(nvme_bdev_ctrlr);
 
 	if (spdk_nvme_ctrlr_get_flags(nvme_bdev_ctrlr->ctrlr) &
 	    SPDK_NVME_CTRLR_SECURITY_SEND_RECV_SUPPORTED) {
@@ -1059,7 +2100,7 @@ remove_cb(void *cb_ctx, struct spdk_nvme_ctrlr *ctrlr)
 {
 	uint32_t i;
 	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr;
-	struct nvme_bdev *nvme_bdev;
+	struct nvme_bdev_ns *nvme_ns;
 
 	pthread_mutex_lock(&g_bdev_nvme_mutex);
 	TAILQ_FOREACH(nvme_bdev_ctrlr, &g_nvme_bdev_ctrlrs, tailq) {
@@ -1073,10 +2114,10 @@ remove_cb(void *cb_ctx, struct spdk_nvme_ctrlr *ctrlr)
 			for (i = 0; i < nvme_bdev_ctrlr->num_ns; i++) {
 				uint32_t	nsid = i + 1;
 
-				nvme_bdev = &nvme_bdev_ctrlr->bdevs[nsid - 1];
-				if (nvme_bdev->active) {
-					assert(nvme_bdev->id == nsid);
-					spdk_bdev_unregister(&nvme_bdev->disk, NULL, NULL);
+				nvme_ns = &nvme_bdev_ctrlr->namespaces[nsid - 1];
+				if (nvme_ns->active) {
+					assert(nvme_ns->id == nsid);
+					nvme_ctrlr_deactivate_ns(nvme_ns);
 				}
 			}
 
@@ -1153,7 +2194,7 @@ set_nvme_hotplug_period_cb(void *_ctx)
 
 	spdk_poller_unregister(&g_hotplug_poller);
 	if (ctx->enabled) {
-		g_hotplug_poller = spdk_poller_register(bdev_nvme_hotplug, NULL, ctx->period_us);
+		g_hotplug_poller = SPDK_POLLER_REGISTER(bdev_nvme_hotplug, NULL, ctx->period_us);
 	}
 
 	g_nvme_hotplug_poll_period_us = ctx->period_us;
@@ -1193,7 +2234,7 @@ static int
 bdev_nvme_create_bdevs(struct nvme_async_probe_ctx *ctx)
 {
 	struct nvme_bdev_ctrlr	*nvme_bdev_ctrlr;
-	struct nvme_bdev	*nvme_bdev;
+	struct nvme_bdev_ns	*nvme_ns;
 	uint32_t		i, nsid;
 	size_t			j;
 
@@ -1209,13 +2250,14 @@ bdev_nvme_create_bdevs(struct nvme_async_probe_ctx *ctx)
 	j = 0;
 	for (i = 0; i < nvme_bdev_ctrlr->num_ns; i++) {
 		nsid = i + 1;
-		nvme_bdev = &nvme_bdev_ctrlr->bdevs[nsid - 1];
-		if (!nvme_bdev->active) {
+		nvme_ns = &nvme_bdev_ctrlr->namespaces[nsid - 1];
+		if (!nvme_ns->active) {
 			continue;
 		}
-		assert(nvme_bdev->id == nsid);
+		assert(nvme_ns->id == nsid);
 		if (j < ctx->count) {
-			ctx->names[j] = nvme_bdev->disk.name;
+			/* A namespace added as a path reports the name of the bdev it joined. */
+			ctx->names[j] = nvme_ns->bdev->disk.name;
 			j++;
 		} else {
 			SPDK_ERRLOG("Maximum number of namespaces supported per NVMe controller is %du. Unable to return all names of created bdevs\n",
@@ -1322,6 +2364,7 @@ spdk_bdev_nvme_create(struct spdk_nvme_transport_id *trid,
 
 	spdk_nvme_ctrlr_get_default_ctrlr_opts(&ctx->opts, sizeof(ctx->opts));
 	ctx->opts.transport_retry_count = g_opts.retry_count;
+	ctx->opts.use_cmb_sqs = g_opts.use_cmb_sqs;
 
 	if (hostnqn) {
 		snprintf(ctx->opts.hostnqn, sizeof(ctx->opts.hostnqn), "%s", hostnqn);
@@ -1341,7 +2384,7 @@ spdk_bdev_nvme_create(struct spdk_nvme_transport_id *trid,
 		free(ctx);
 		return -ENODEV;
 	}
-	ctx->poller = spdk_poller_register(bdev_nvme_async_poll, ctx, 1000);
+	ctx->poller = SPDK_POLLER_REGISTER(bdev_nvme_async_poll, ctx, 1000);
 
 	return 0;
 }
@@ -1392,6 +2435,10 @@ bdev_nvme_library_init(void)
 
 	g_bdev_nvme_init_thread = spdk_get_thread();
 
+	spdk_io_device_register(&g_nvme_bdev_ctrlrs, bdev_nvme_poll_group_create_cb,
+				bdev_nvme_poll_group_destroy_cb,
+				sizeof(struct nvme_bdev_poll_group), "bdev_nvme_poll_groups");
+
 	sp = spdk_conf_find_section(NULL, "Nvme");
 	if (sp == NULL) {
 		goto end;
@@ -1617,6 +2664,8 @@ bdev_nvme_library_fini(void)
 		pthread_mutex_lock(&g_bdev_nvme_mutex);
 	}
 	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	spdk_io_device_unregister(&g_nvme_bdev_ctrlrs, NULL);
 }
 
 static void
@@ -1690,6 +2739,8 @@ bdev_nvme_no_pi_readv_done(void *ref, const struct spdk_nvme_cpl *cpl)
 		bdev_nvme_verify_pi_error(bdev_io);
 	}
 
+	bdev_nvme_io_path_put(bio);
+
 	/* Return original completion status */
 	spdk_bdev_io_complete_nvme_status(bdev_io, bio->cpl.status.sct,
 					  bio->cpl.status.sc);
@@ -1711,7 +2762,7 @@ bdev_nvme_readv_done(void *ref, const struct spdk_nvme_cpl *cpl)
 
 		/* Read without PI checking to verify PI error. */
 		ret = bdev_nvme_no_pi_readv((struct nvme_bdev *)bdev_io->bdev->ctxt,
-					    spdk_bdev_io_get_io_channel(bdev_io),
+					    bio->io_path,
 					    bio,
 					    bdev_io->u.bdev.iovs,
 					    bdev_io->u.bdev.iovcnt,
@@ -1723,13 +2774,18 @@ bdev_nvme_readv_done(void *ref, const struct spdk_nvme_cpl *cpl)
 		}
 	}
 
+	if (bdev_nvme_io_path_done(bio, cpl)) {
+		return;
+	}
+
 	spdk_bdev_io_complete_nvme_status(bdev_io, cpl->status.sct, cpl->status.sc);
 }
 
 static void
 bdev_nvme_writev_done(void *ref, const struct spdk_nvme_cpl *cpl)
 {
-	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx((struct nvme_bdev_io *)ref);
+	struct nvme_bdev_io *bio = ref;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
 
 	if (spdk_nvme_cpl_is_pi_error(cpl)) {
 		SPDK_ERRLOG("writev completed with PI error (sct=%d, sc=%d)\n",
@@ -1738,13 +2794,22 @@ bdev_nvme_writev_done(void *ref, const struct spdk_nvme_cpl *cpl)
 		bdev_nvme_verify_pi_error(bdev_io);
 	}
 
+	if (bdev_nvme_io_path_done(bio, cpl)) {
+		return;
+	}
+
 	spdk_bdev_io_complete_nvme_status(bdev_io, cpl->status.sct, cpl->status.sc);
 }
 
 static void
 bdev_nvme_queued_done(void *ref, const struct spdk_nvme_cpl *cpl)
 {
-	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx((struct nvme_bdev_io *)ref);
+	struct nvme_bdev_io *bio = ref;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
+
+	if (bdev_nvme_io_path_done(bio, cpl)) {
+		return;
+	}
 
 	spdk_bdev_io_complete_nvme_status(bdev_io, cpl->status.sct, cpl->status.sc);
 }
@@ -1755,6 +2820,8 @@ bdev_nvme_admin_passthru_completion(void *ctx)
 	struct nvme_bdev_io *bio = ctx;
 	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
 
+	/* Admin commands are not failed over, the path is released on its own thread. */
+	bdev_nvme_io_path_put(bio);
 	spdk_bdev_io_complete_nvme_status(bdev_io,
 					  bio->cpl.status.sct, bio->cpl.status.sc);
 }
@@ -1814,13 +2881,17 @@ bdev_nvme_queued_next_sge(void *ref, void **address, uint32_t *length)
 }
 
 static int
-bdev_nvme_no_pi_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_no_pi_readv(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 		      struct nvme_bdev_io *bio, struct iovec *iov, int iovcnt,
 		      void *md, uint64_t lba_count, uint64_t lba)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
+	struct spdk_nvme_qpair *qpair = nvme_io_path_get_qpair(io_path);
 	int rc;
 
+	if (spdk_unlikely(qpair == NULL)) {
+		return -ENXIO;
+	}
+
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_NVME, "read %lu blocks with offset %#lx without PI check\n",
 		      lba_count, lba);
 
@@ -1829,7 +2900,7 @@ bdev_nvme_no_pi_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	bio->iovpos = 0;
 	bio->iov_offset = 0;
 
-	rc = spdk_nvme_ns_cmd_readv_with_md(nbdev->ns, nvme_ch->qpair, lba, lba_count,
+	rc = spdk_nvme_ns_cmd_readv_with_md(io_path->ns, qpair, lba, lba_count,
 					    bdev_nvme_no_pi_readv_done, bio, 0,
 					    bdev_nvme_queued_reset_sgl, bdev_nvme_queued_next_sge,
 					    md, 0, 0);
@@ -1841,13 +2912,17 @@ bdev_nvme_no_pi_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 }
 
 static int
-bdev_nvme_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_readv(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 		struct nvme_bdev_io *bio, struct iovec *iov, int iovcnt,
 		void *md, uint64_t lba_count, uint64_t lba)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
+	struct spdk_nvme_qpair *qpair = nvme_io_path_get_qpair(io_path);
 	int rc;
 
+	if (spdk_unlikely(qpair == NULL)) {
+		return -ENXIO;
+	}
+
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_NVME, "read %lu blocks with offset %#lx\n",
 		      lba_count, lba);
 
@@ -1856,7 +2931,7 @@ bdev_nvme_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	bio->iovpos = 0;
 	bio->iov_offset = 0;
 
-	rc = spdk_nvme_ns_cmd_readv_with_md(nbdev->ns, nvme_ch->qpair, lba, lba_count,
+	rc = spdk_nvme_ns_cmd_readv_with_md(io_path->ns, qpair, lba, lba_count,
 					    bdev_nvme_readv_done, bio, nbdev->disk.dif_check_flags,
 					    bdev_nvme_queued_reset_sgl, bdev_nvme_queued_next_sge,
 					    md, 0, 0);
@@ -1868,13 +2943,17 @@ bdev_nvme_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 }
 
 static int
-bdev_nvme_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_writev(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 		 struct nvme_bdev_io *bio,
 		 struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
+	struct spdk_nvme_qpair *qpair = nvme_io_path_get_qpair(io_path);
 	int rc;
 
+	if (spdk_unlikely(qpair == NULL)) {
+		return -ENXIO;
+	}
+
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_NVME, "write %lu blocks with offset %#lx\n",
 		      lba_count, lba);
 
@@ -1883,7 +2962,7 @@ bdev_nvme_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	bio->iovpos = 0;
 	bio->iov_offset = 0;
 
-	rc = spdk_nvme_ns_cmd_writev_with_md(nbdev->ns, nvme_ch->qpair, lba, lba_count,
+	rc = spdk_nvme_ns_cmd_writev_with_md(io_path->ns, qpair, lba, lba_count,
 					     bdev_nvme_writev_done, bio, nbdev->disk.dif_check_flags,
 					     bdev_nvme_queued_reset_sgl, bdev_nvme_queued_next_sge,
 					     md, 0, 0);
@@ -1895,12 +2974,12 @@ bdev_nvme_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 }
 
 static int
-bdev_nvme_unmap(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_unmap(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 		struct nvme_bdev_io *bio,
 		uint64_t offset_blocks,
 		uint64_t num_blocks)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
+	struct spdk_nvme_qpair *qpair = nvme_io_path_get_qpair(io_path);
 	struct spdk_nvme_dsm_range dsm_ranges[SPDK_NVME_DATASET_MANAGEMENT_MAX_RANGES];
 	struct spdk_nvme_dsm_range *range;
 	uint64_t offset, remaining;
@@ -1908,6 +2987,10 @@ bdev_nvme_unmap(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	uint16_t num_ranges;
 	int rc;
 
+	if (spdk_unlikely(qpair == NULL)) {
+		return -ENXIO;
+	}
+
 	num_ranges_u64 = (num_blocks + SPDK_NVME_DATASET_MANAGEMENT_RANGE_MAX_BLOCKS - 1) /
 			 SPDK_NVME_DATASET_MANAGEMENT_RANGE_MAX_BLOCKS;
 	if (num_ranges_u64 > SPDK_COUNTOF(dsm_ranges)) {
@@ -1936,7 +3019,7 @@ bdev_nvme_unmap(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	range->length = remaining;
 	range->starting_lba = offset;
 
-	rc = spdk_nvme_ns_cmd_dataset_management(nbdev->ns, nvme_ch->qpair,
+	rc = spdk_nvme_ns_cmd_dataset_management(io_path->ns, qpair,
 			SPDK_NVME_DSM_ATTR_DEALLOCATE,
 			dsm_ranges, num_ranges,
 			bdev_nvme_queued_done, bio);
@@ -1945,30 +3028,34 @@ bdev_nvme_unmap(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 }
 
 static int
-bdev_nvme_admin_passthru(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_admin_passthru(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 			 struct nvme_bdev_io *bio,
 			 struct spdk_nvme_cmd *cmd, void *buf, size_t nbytes)
 {
-	uint32_t max_xfer_size = spdk_nvme_ctrlr_get_max_xfer_size(nbdev->nvme_bdev_ctrlr->ctrlr);
+	uint32_t max_xfer_size = spdk_nvme_ctrlr_get_max_xfer_size(io_path->ctrlr);
 
 	if (nbytes > max_xfer_size) {
 		SPDK_ERRLOG("nbytes is greater than MDTS %" PRIu32 ".\n", max_xfer_size);
 		return -EINVAL;
 	}
 
-	bio->orig_thread = spdk_io_channel_get_thread(ch);
+	bio->orig_thread = spdk_get_thread();
 
-	return spdk_nvme_ctrlr_cmd_admin_raw(nbdev->nvme_bdev_ctrlr->ctrlr, cmd, buf,
+	return spdk_nvme_ctrlr_cmd_admin_raw(io_path->ctrlr, cmd, buf,
 					     (uint32_t)nbytes, bdev_nvme_admin_passthru_done, bio);
 }
 
 static int
-bdev_nvme_io_passthru(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_io_passthru(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 		      struct nvme_bdev_io *bio,
 		      struct spdk_nvme_cmd *cmd, void *buf, size_t nbytes)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
-	uint32_t max_xfer_size = spdk_nvme_ctrlr_get_max_xfer_size(nbdev->nvme_bdev_ctrlr->ctrlr);
+	struct spdk_nvme_qpair *qpair = nvme_io_path_get_qpair(io_path);
+	uint32_t max_xfer_size = spdk_nvme_ctrlr_get_max_xfer_size(io_path->ctrlr);
+
+	if (spdk_unlikely(qpair == NULL)) {
+		return -ENXIO;
+	}
 
 	if (nbytes > max_xfer_size) {
 		SPDK_ERRLOG("nbytes is greater than MDTS %" PRIu32 ".\n", max_xfer_size);
@@ -1979,27 +3066,31 @@ bdev_nvme_io_passthru(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	 * Each NVMe bdev is a specific namespace, and all NVMe I/O commands require a nsid,
 	 * so fill it out automatically.
 	 */
-	cmd->nsid = spdk_nvme_ns_get_id(nbdev->ns);
+	cmd->nsid = spdk_nvme_ns_get_id(io_path->ns);
 
-	return spdk_nvme_ctrlr_cmd_io_raw(nbdev->nvme_bdev_ctrlr->ctrlr, nvme_ch->qpair, cmd, buf,
+	return spdk_nvme_ctrlr_cmd_io_raw(io_path->ctrlr, qpair, cmd, buf,
 					  (uint32_t)nbytes, bdev_nvme_queued_done, bio);
 }
 
 static int
-bdev_nvme_io_passthru_md(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_io_passthru_md(struct nvme_bdev *nbdev, struct nvme_io_path *io_path,
 			 struct nvme_bdev_io *bio,
 			 struct spdk_nvme_cmd *cmd, void *buf, size_t nbytes, void *md_buf, size_t md_len)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
-	size_t nr_sectors = nbytes / spdk_nvme_ns_get_extended_sector_size(nbdev->ns);
-	uint32_t max_xfer_size = spdk_nvme_ctrlr_get_max_xfer_size(nbdev->nvme_bdev_ctrlr->ctrlr);
+	struct spdk_nvme_qpair *qpair = nvme_io_path_get_qpair(io_path);
+	size_t nr_sectors = nbytes / spdk_nvme_ns_get_extended_sector_size(io_path->ns);
+	uint32_t max_xfer_size = spdk_nvme_ctrlr_get_max_xfer_size(io_path->ctrlr);
+
+	if (spdk_unlikely(qpair == NULL)) {
+		return -ENXIO;
+	}
 
 	if (nbytes > max_xfer_size) {
 		SPDK_ERRLOG("nbytes is greater than MDTS %" PRIu32 ".\n", max_xfer_size);
 		return -EINVAL;
 	}
 
-	if (md_len != nr_sectors * spdk_nvme_ns_get_md_size(nbdev->ns)) {
+	if (md_len != nr_sectors * spdk_nvme_ns_get_md_size(io_path->ns)) {
 		SPDK_ERRLOG("invalid meta data buffer size\n");
 		return -EINVAL;
 	}
@@ -2008,9 +3099,9 @@ bdev_nvme_io_passthru_md(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	 * Each NVMe bdev is a specific namespace, and all NVMe I/O commands require a nsid,
 	 * so fill it out automatically.
 	 */
-	cmd->nsid = spdk_nvme_ns_get_id(nbdev->ns);
+	cmd->nsid = spdk_nvme_ns_get_id(io_path->ns);
 
-	return spdk_nvme_ctrlr_cmd_io_raw_with_md(nbdev->nvme_bdev_ctrlr->ctrlr, nvme_ch->qpair, cmd, buf,
+	return spdk_nvme_ctrlr_cmd_io_raw_with_md(io_path->ctrlr, qpair, cmd, buf,
 			(uint32_t)nbytes, md_buf, bdev_nvme_queued_done, bio);
 }
 
@@ -2118,8 +3209,11 @@ static int
 bdev_nvme_config_json(struct spdk_json_write_ctx *w)
 {
 	struct nvme_bdev_ctrlr		*nvme_bdev_ctrlr;
+	struct nvme_bdev_ns		*nvme_ns;
 	struct spdk_nvme_transport_id	*trid;
 	const char			*action;
+	const char			*policy;
+	uint32_t			i;
 
 	if (g_opts.action_on_timeout == SPDK_BDEV_NVME_TIMEOUT_ACTION_RESET) {
 		action = "reset";
@@ -2144,6 +3238,9 @@ bdev_nvme_config_json(struct spdk_json_write_ctx *w)
 	spdk_json_write_named_uint64(w, "nvme_adminq_poll_period_us", g_opts.nvme_adminq_poll_period_us);
 	spdk_json_write_named_uint64(w, "nvme_ioq_poll_period_us", g_opts.nvme_ioq_poll_period_us);
 	spdk_json_write_named_uint32(w, "io_queue_requests", g_opts.io_queue_requests);
+	spdk_json_write_named_bool(w, "use_cmb_sqs", g_opts.use_cmb_sqs);
+	spdk_json_write_named_bool(w, "cmb_zcopy", g_opts.cmb_zcopy);
+	spdk_json_write_named_bool(w, "multipath", g_opts.multipath);
 	spdk_json_write_object_end(w);
 
 	spdk_json_write_object_end(w);
@@ -2174,6 +3271,29 @@ bdev_nvme_config_json(struct spdk_json_write_ctx *w)
 		spdk_json_write_object_end(w);
 	}
 
+	/* Policies of multipath bdevs can only be set once all of their paths are attached. */
+	TAILQ_FOREACH(nvme_bdev_ctrlr, &g_nvme_bdev_ctrlrs, tailq) {
+		for (i = 0; i < nvme_bdev_ctrlr->num_ns; i++) {
+			nvme_ns = &nvme_bdev_ctrlr->namespaces[i];
+			if (!nvme_ns->active || nvme_ns->bdev == NULL ||
+			    TAILQ_FIRST(&nvme_ns->bdev->nvme_ns_list) != nvme_ns ||
+			    nvme_ns->bdev->mp_policy == NVME_BDEV_MP_POLICY_ROUND_ROBIN) {
+				continue;
+			}
+
+			spdk_json_write_object_begin(w);
+			spdk_json_write_named_string(w, "method", "bdev_nvme_set_multipath_policy");
+
+			spdk_json_write_named_object_begin(w, "params");
+			spdk_json_write_named_string(w, "name", nvme_ns->bdev->disk.name);
+			policy = nvme_bdev_mp_policy_str(nvme_ns->bdev->mp_policy);
+			spdk_json_write_named_string(w, "policy", policy);
+			spdk_json_write_object_end(w);
+
+			spdk_json_write_object_end(w);
+		}
+	}
+
 	/* Dump as last parameter to give all NVMe bdevs chance to be constructed
 	 * before enabling hotplug poller.
 	 */
@@ -2194,11 +3314,43 @@ bdev_nvme_config_json(struct spdk_json_write_ctx *w)
 struct spdk_nvme_ctrlr *
 spdk_bdev_nvme_get_ctrlr(struct spdk_bdev *bdev)
 {
+	struct nvme_bdev *nvme_bdev;
+	struct nvme_bdev_ns *nvme_ns;
+	struct spdk_nvme_ctrlr *ctrlr = NULL;
+
 	if (!bdev || bdev->module != &nvme_if) {
 		return NULL;
 	}
 
-	return SPDK_CONTAINEROF(bdev, struct nvme_bdev, disk)->nvme_bdev_ctrlr->ctrlr;
+	nvme_bdev = SPDK_CONTAINEROF(bdev, struct nvme_bdev, disk);
+
+	/* The controller of the first path is reported for a multipath bdev. */
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	nvme_ns = TAILQ_FIRST(&nvme_bdev->nvme_ns_list);
+	if (nvme_ns != NULL) {
+		ctrlr = nvme_ns->ctrlr->ctrlr;
+	}
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	return ctrlr;
+}
+
+int
+spdk_bdev_nvme_set_multipath_policy(const char *name, enum nvme_bdev_mp_policy policy)
+{
+	struct spdk_bdev *bdev;
+	struct nvme_bdev *nvme_bdev;
+
+	bdev = spdk_bdev_get_by_name(name);
+	if (bdev == NULL || bdev->module != &nvme_if) {
+		return -ENODEV;
+	}
+
+	nvme_bdev = SPDK_CONTAINEROF(bdev, struct nvme_bdev, disk);
+	/* The channels read the policy on each submission. */
+	nvme_bdev->mp_policy = policy;
+
+	return 0;
 }
 
 SPDK_LOG_REGISTER_COMPONENT("bdev_nvme", SPDK_LOG_BDEV_NVME)
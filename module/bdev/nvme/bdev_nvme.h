@@ -59,6 +59,15 @@ struct spdk_bdev_nvme_opts {
 	uint64_t nvme_adminq_poll_period_us;
 	uint64_t nvme_ioq_poll_period_us;
 	uint32_t io_queue_requests;
+	/* Place PCIe submission queues in the controller memory buffer, if supported. */
+	bool use_cmb_sqs;
+	/* Stage the data of zcopy requests in the controller memory buffer, if supported. */
+	bool cmb_zcopy;
+	/*
+	 * Expose a namespace that several controllers of the same subsystem reach
+	 * as one bdev with a path per controller.
+	 */
+	bool multipath;
 };
 
 struct spdk_nvme_qpair *spdk_bdev_nvme_get_io_qpair(struct spdk_io_channel *ctrlr_io_ch);
@@ -86,4 +95,23 @@ struct spdk_nvme_ctrlr *spdk_bdev_nvme_get_ctrlr(struct spdk_bdev *bdev);
  */
 int spdk_bdev_nvme_delete(const char *name);
 
+/**
+ * Set the policy picking the path of each I/O among the paths of a bdev.
+ *
+ * \param name Name of the NVMe bdev.
+ * \param policy Policy to use.
+ * \return zero on success or -ENODEV if the bdev is not found.
+ */
+int spdk_bdev_nvme_set_multipath_policy(const char *name, enum nvme_bdev_mp_policy policy);
+
+/**
+ * Write the multipath policy and the paths of an NVMe bdev with their ANA
+ * state as a JSON object.
+ *
+ * \param bdev Bdev to dump.
+ * \param w JSON write context.
+ * \return zero on success or -ENODEV if the bdev is not an NVMe bdev.
+ */
+int spdk_bdev_nvme_dump_paths_json(struct spdk_bdev *bdev, struct spdk_json_write_ctx *w);
+
 #endif /* SPDK_BDEV_NVME_H */
@@ -0,0 +1,149 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Path selection of the NVMe bdevs with several paths, kept apart from the I/O
+ * submission so that it can be tested on its own.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/likely.h"
+
+#include "common.h"
+
+/* Lower is better. Paths in persistent loss state are never used. */
+static inline int
+nvme_bdev_ana_state_rank(enum spdk_nvme_ana_state ana_state)
+{
+	switch (ana_state) {
+	case SPDK_NVME_ANA_OPTIMIZED_STATE:
+		return 0;
+	case SPDK_NVME_ANA_NON_OPTIMIZED_STATE:
+		return 1;
+	case SPDK_NVME_ANA_CHANGE_STATE:
+		return 2;
+	case SPDK_NVME_ANA_INACCESSIBLE_STATE:
+		return 3;
+	default:
+		return -1;
+	}
+}
+
+struct nvme_io_path *
+nvme_bdev_find_io_path(struct nvme_bdev *nbdev, struct nvme_bdev_channel *nbdev_ch)
+{
+	struct nvme_io_path *io_path, *start, *best = NULL;
+	bool by_queue_depth = nbdev->mp_policy == NVME_BDEV_MP_POLICY_QUEUE_DEPTH;
+	int rank, best_rank = INT_MAX;
+
+	io_path = TAILQ_FIRST(&nbdev_ch->io_paths);
+	if (spdk_likely(nbdev_ch->num_paths == 1)) {
+		return nvme_io_path_is_connected(io_path) ? io_path : NULL;
+	}
+
+	/* Round robin starts right after the last pick, so that ties rotate. */
+	if (nbdev_ch->rr_path != NULL && TAILQ_NEXT(nbdev_ch->rr_path, tailq) != NULL) {
+		io_path = TAILQ_NEXT(nbdev_ch->rr_path, tailq);
+	}
+
+	start = io_path;
+	while (io_path != NULL) {
+		rank = nvme_bdev_ana_state_rank(io_path->nvme_ns->ana_state);
+		if (rank >= 0 && nvme_io_path_is_connected(io_path)) {
+			if (rank < best_rank ||
+			    (rank == best_rank && by_queue_depth &&
+			     io_path->outstanding < best->outstanding)) {
+				best = io_path;
+				best_rank = rank;
+			}
+		}
+
+		io_path = TAILQ_NEXT(io_path, tailq);
+		if (io_path == NULL) {
+			io_path = TAILQ_FIRST(&nbdev_ch->io_paths);
+		}
+		if (io_path == start) {
+			break;
+		}
+	}
+
+	nbdev_ch->rr_path = best;
+	return best;
+}
+
+static inline bool
+nvme_bdev_cpl_is_path_error(const struct spdk_nvme_cpl *cpl)
+{
+	switch (cpl->status.sct) {
+	case SPDK_NVME_SCT_PATH:
+		return true;
+	case SPDK_NVME_SCT_GENERIC:
+		/* Requests of a qpair which failed or got freed are aborted */
+		return cpl->status.sc == SPDK_NVME_SC_ABORTED_SQ_DELETION ||
+		       cpl->status.sc == SPDK_NVME_SC_ABORTED_BY_REQUEST;
+	default:
+		return false;
+	}
+}
+
+bool
+nvme_bdev_io_path_failover(struct nvme_bdev_channel *nbdev_ch, struct nvme_io_path *io_path,
+			   const struct spdk_nvme_cpl *cpl, uint32_t failover_count)
+{
+	if (spdk_likely(spdk_nvme_cpl_is_success(cpl)) || !nvme_bdev_cpl_is_path_error(cpl)) {
+		return false;
+	}
+
+	if (cpl->status.sct == SPDK_NVME_SCT_PATH && io_path != NULL && !io_path->removed) {
+		/*
+		 * The controller reports an ANA state change with an asynchronous event,
+		 * which updates the state again once the change is done.
+		 */
+		switch (cpl->status.sc) {
+		case SPDK_NVME_SC_ASYMMETRIC_ACCESS_PERSISTENT_LOSS:
+			io_path->nvme_ns->ana_state = SPDK_NVME_ANA_PERSISTENT_LOSS_STATE;
+			break;
+		case SPDK_NVME_SC_ASYMMETRIC_ACCESS_INACCESSIBLE:
+			io_path->nvme_ns->ana_state = SPDK_NVME_ANA_INACCESSIBLE_STATE;
+			break;
+		case SPDK_NVME_SC_ASYMMETRIC_ACCESS_TRANSITION:
+			io_path->nvme_ns->ana_state = SPDK_NVME_ANA_CHANGE_STATE;
+			break;
+		default:
+			break;
+		}
+	}
+
+	return nbdev_ch->num_paths >= 2 && failover_count < nbdev_ch->num_paths;
+}
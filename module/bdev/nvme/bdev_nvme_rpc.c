@@ -80,6 +80,9 @@ static const struct spdk_json_object_decoder rpc_bdev_nvme_options_decoders[] =
 	{"nvme_adminq_poll_period_us", offsetof(struct spdk_bdev_nvme_opts, nvme_adminq_poll_period_us), spdk_json_decode_uint64, true},
 	{"nvme_ioq_poll_period_us", offsetof(struct spdk_bdev_nvme_opts, nvme_ioq_poll_period_us), spdk_json_decode_uint64, true},
 	{"io_queue_requests", offsetof(struct spdk_bdev_nvme_opts, io_queue_requests), spdk_json_decode_uint32, true},
+	{"use_cmb_sqs", offsetof(struct spdk_bdev_nvme_opts, use_cmb_sqs), spdk_json_decode_bool, true},
+	{"cmb_zcopy", offsetof(struct spdk_bdev_nvme_opts, cmb_zcopy), spdk_json_decode_bool, true},
+	{"multipath", offsetof(struct spdk_bdev_nvme_opts, multipath), spdk_json_decode_bool, true},
 };
 
 static void
@@ -460,6 +463,137 @@ SPDK_RPC_REGISTER("bdev_nvme_detach_controller", spdk_rpc_bdev_nvme_detach_contr
 		  SPDK_RPC_RUNTIME)
 SPDK_RPC_REGISTER_ALIAS_DEPRECATED(bdev_nvme_detach_controller, delete_nvme_controller)
 
+struct rpc_bdev_nvme_get_paths {
+	char *name;
+};
+
+static void
+free_rpc_bdev_nvme_get_paths(struct rpc_bdev_nvme_get_paths *r)
+{
+	free(r->name);
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_nvme_get_paths_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_nvme_get_paths, name), spdk_json_decode_string, true},
+};
+
+static void
+spdk_rpc_bdev_nvme_get_paths(struct spdk_jsonrpc_request *request,
+			     const struct spdk_json_val *params)
+{
+	struct rpc_bdev_nvme_get_paths req = {};
+	struct spdk_json_write_ctx *w;
+	struct spdk_bdev *bdev = NULL;
+
+	if (params && spdk_json_decode_object(params, rpc_bdev_nvme_get_paths_decoders,
+					      SPDK_COUNTOF(rpc_bdev_nvme_get_paths_decoders),
+					      &req)) {
+		SPDK_ERRLOG("spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	if (req.name) {
+		bdev = spdk_bdev_get_by_name(req.name);
+		if (bdev == NULL || spdk_bdev_nvme_get_ctrlr(bdev) == NULL) {
+			SPDK_ERRLOG("NVMe bdev '%s' does not exist\n", req.name);
+			spdk_jsonrpc_send_error_response_fmt(request, -ENODEV,
+							     "NVMe bdev %s does not exist", req.name);
+			goto cleanup;
+		}
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_array_begin(w);
+
+	if (bdev != NULL) {
+		spdk_bdev_nvme_dump_paths_json(bdev, w);
+	} else {
+		for (bdev = spdk_bdev_first(); bdev; bdev = spdk_bdev_next(bdev)) {
+			/* Bdevs of other modules are skipped */
+			spdk_bdev_nvme_dump_paths_json(bdev, w);
+		}
+	}
+
+	spdk_json_write_array_end(w);
+
+	spdk_jsonrpc_end_result(request, w);
+
+cleanup:
+	free_rpc_bdev_nvme_get_paths(&req);
+}
+SPDK_RPC_REGISTER("bdev_nvme_get_paths", spdk_rpc_bdev_nvme_get_paths, SPDK_RPC_RUNTIME)
+
+struct rpc_bdev_nvme_set_multipath_policy {
+	char *name;
+	enum nvme_bdev_mp_policy policy;
+};
+
+static void
+free_rpc_bdev_nvme_set_multipath_policy(struct rpc_bdev_nvme_set_multipath_policy *req)
+{
+	free(req->name);
+}
+
+static int
+rpc_decode_mp_policy(const struct spdk_json_val *val, void *out)
+{
+	enum nvme_bdev_mp_policy *policy = out;
+	char *str = NULL;
+	int rc;
+
+	rc = spdk_json_decode_string(val, &str);
+	if (rc) {
+		return rc;
+	}
+
+	rc = nvme_bdev_mp_policy_parse(str, policy);
+	if (rc) {
+		SPDK_NOTICELOG("Invalid parameter value: policy\n");
+	}
+
+	free(str);
+	return rc;
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_nvme_set_multipath_policy_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_nvme_set_multipath_policy, name), spdk_json_decode_string},
+	{"policy", offsetof(struct rpc_bdev_nvme_set_multipath_policy, policy), rpc_decode_mp_policy},
+};
+
+static void
+spdk_rpc_bdev_nvme_set_multipath_policy(struct spdk_jsonrpc_request *request,
+					const struct spdk_json_val *params)
+{
+	struct rpc_bdev_nvme_set_multipath_policy req = {NULL};
+	struct spdk_json_write_ctx *w;
+	int rc;
+
+	if (spdk_json_decode_object(params, rpc_bdev_nvme_set_multipath_policy_decoders,
+				    SPDK_COUNTOF(rpc_bdev_nvme_set_multipath_policy_decoders),
+				    &req)) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	rc = spdk_bdev_nvme_set_multipath_policy(req.name, req.policy);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+
+cleanup:
+	free_rpc_bdev_nvme_set_multipath_policy(&req);
+}
+SPDK_RPC_REGISTER("bdev_nvme_set_multipath_policy", spdk_rpc_bdev_nvme_set_multipath_policy,
+		  SPDK_RPC_RUNTIME)
+
 struct rpc_apply_firmware {
 	char *filename;
 	char *bdev_name;
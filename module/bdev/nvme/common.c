@@ -109,3 +109,49 @@ nvme_bdev_dump_trid_json(struct spdk_nvme_transport_id *trid, struct spdk_json_w
 		spdk_json_write_named_string(w, "subnqn", trid->subnqn);
 	}
 }
+
+const char *
+nvme_bdev_ana_state_str(enum spdk_nvme_ana_state ana_state)
+{
+	switch (ana_state) {
+	case SPDK_NVME_ANA_OPTIMIZED_STATE:
+		return "optimized";
+	case SPDK_NVME_ANA_NON_OPTIMIZED_STATE:
+		return "non_optimized";
+	case SPDK_NVME_ANA_INACCESSIBLE_STATE:
+		return "inaccessible";
+	case SPDK_NVME_ANA_PERSISTENT_LOSS_STATE:
+		return "persistent_loss";
+	case SPDK_NVME_ANA_CHANGE_STATE:
+		return "change";
+	default:
+		return "unknown";
+	}
+}
+
+const char *
+nvme_bdev_mp_policy_str(enum nvme_bdev_mp_policy policy)
+{
+	switch (policy) {
+	case NVME_BDEV_MP_POLICY_ROUND_ROBIN:
+		return "round_robin";
+	case NVME_BDEV_MP_POLICY_QUEUE_DEPTH:
+		return "queue_depth";
+	default:
+		return "unknown";
+	}
+}
+
+int
+nvme_bdev_mp_policy_parse(const char *str, enum nvme_bdev_mp_policy *policy)
+{
+	if (strcmp(str, "round_robin") == 0) {
+		*policy = NVME_BDEV_MP_POLICY_ROUND_ROBIN;
+	} else if (strcmp(str, "queue_depth") == 0) {
+		*policy = NVME_BDEV_MP_POLICY_QUEUE_DEPTH;
+	} else {
+		return -EINVAL;
+	}
+
+	return 0;
+}
@@ -37,6 +37,7 @@
 #include "spdk/nvme.h"
 #include "spdk/bdev_module.h"
 #include "spdk/opal.h"
+#include "spdk/thread.h"
 
 TAILQ_HEAD(nvme_bdev_ctrlrs, nvme_bdev_ctrlr);
 extern struct nvme_bdev_ctrlrs g_nvme_bdev_ctrlrs;
@@ -62,8 +63,8 @@ struct nvme_bdev_ctrlr {
 	 */
 	uint32_t			prchk_flags;
 	uint32_t			num_ns;
-	/** Array of bdevs indexed by nsid - 1 */
-	struct nvme_bdev		*bdevs;
+	/** Array of namespaces indexed by nsid - 1 */
+	struct nvme_bdev_ns		*namespaces;
 
 	struct spdk_opal_dev		*opal_dev;
 
@@ -73,12 +74,75 @@ struct nvme_bdev_ctrlr {
 	TAILQ_ENTRY(nvme_bdev_ctrlr)	tailq;
 };
 
-struct nvme_bdev {
-	struct spdk_bdev	disk;
-	struct nvme_bdev_ctrlr	*nvme_bdev_ctrlr;
+/* A namespace as seen through one controller, i.e. one path to an nvme_bdev. */
+struct nvme_bdev_ns {
 	uint32_t		id;
 	bool			active;
 	struct spdk_nvme_ns	*ns;
+	struct nvme_bdev_ctrlr	*ctrlr;
+	/* ANA state of the namespace on this controller */
+	enum spdk_nvme_ana_state ana_state;
+	/* Bdev this namespace is a path to */
+	struct nvme_bdev	*bdev;
+	TAILQ_ENTRY(nvme_bdev_ns) tailq;
+};
+
+enum nvme_bdev_mp_policy {
+	/* Rotate through the paths in the best ANA state */
+	NVME_BDEV_MP_POLICY_ROUND_ROBIN,
+	/* Pick the path in the best ANA state with the fewest outstanding I/O */
+	NVME_BDEV_MP_POLICY_QUEUE_DEPTH,
+};
+
+struct nvme_bdev {
+	struct spdk_bdev		disk;
+	/* Paths to the namespace. Protected by g_bdev_nvme_mutex. */
+	TAILQ_HEAD(, nvme_bdev_ns)	nvme_ns_list;
+	uint32_t			num_paths;
+	enum nvme_bdev_mp_policy	mp_policy;
+	/* Stage zcopy data in the controller memory buffer */
+	bool				cmb_zcopy;
+	/* Path changes which are still being applied to the I/O channels */
+	uint32_t			path_updates;
+	bool				destruct_pending;
+};
+
+/* Fixed size buffer in the controller memory buffer, staging the data of a zcopy request */
+struct nvme_cmb_buf {
+	void				*buf;
+	STAILQ_ENTRY(nvme_cmb_buf)	stailq;
+};
+
+struct nvme_io_channel {
+	struct spdk_nvme_qpair		*qpair;
+	struct spdk_io_channel		*group_ch;
+	/* Controller memory buffer set aside for the zcopy requests of the channel */
+	void				*cmb_pool;
+	struct nvme_cmb_buf		*cmb_bufs;
+	STAILQ_HEAD(, nvme_cmb_buf)	cmb_free_bufs;
+	TAILQ_ENTRY(nvme_io_channel)	tailq;
+};
+
+/* One path of a bdev channel: the namespace behind the I/O qpair of one controller. */
+struct nvme_io_path {
+	/* Only valid as long as the path is not removed */
+	struct nvme_bdev_ns		*nvme_ns;
+	struct spdk_nvme_ns		*ns;
+	struct spdk_nvme_ctrlr		*ctrlr;
+	/* Channel of the controller, keeping the namespace and the controller alive */
+	struct spdk_io_channel		*ctrlr_ch;
+	/* Requests submitted through the path and not completed yet */
+	uint32_t			outstanding;
+	/* The path was removed from the channel and is freed once it is idle */
+	bool				removed;
+	TAILQ_ENTRY(nvme_io_path)	tailq;
+};
+
+struct nvme_bdev_channel {
+	TAILQ_HEAD(, nvme_io_path)	io_paths;
+	uint32_t			num_paths;
+	/* Path picked last by the round robin policy */
+	struct nvme_io_path		*rr_path;
 };
 
 typedef void (*spdk_bdev_create_nvme_fn)(void *ctx, size_t bdev_count, int rc);
@@ -104,4 +168,41 @@ struct nvme_bdev_ctrlr *nvme_bdev_next_ctrlr(struct nvme_bdev_ctrlr *prev);
 void nvme_bdev_dump_trid_json(struct spdk_nvme_transport_id *trid,
 			      struct spdk_json_write_ctx *w);
 
+const char *nvme_bdev_ana_state_str(enum spdk_nvme_ana_state ana_state);
+const char *nvme_bdev_mp_policy_str(enum nvme_bdev_mp_policy policy);
+/* Returns -EINVAL for an unknown policy name. */
+int nvme_bdev_mp_policy_parse(const char *str, enum nvme_bdev_mp_policy *policy);
+
+static inline struct spdk_nvme_qpair *
+nvme_io_path_get_qpair(struct nvme_io_path *io_path)
+{
+	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(io_path->ctrlr_ch);
+
+	return nvme_ch->qpair;
+}
+
+/* The qpair of a path is NULL while its controller is reset or failed. */
+static inline bool
+nvme_io_path_is_connected(struct nvme_io_path *io_path)
+{
+	return nvme_io_path_get_qpair(io_path) != NULL;
+}
+
+/*
+ * Pick the path of a channel for the next request, among the connected ones in the
+ * best ANA state, following the multipath policy of the bdev. Returns NULL if no
+ * path can be used.
+ */
+struct nvme_io_path *nvme_bdev_find_io_path(struct nvme_bdev *nbdev,
+					    struct nvme_bdev_channel *nbdev_ch);
+
+/*
+ * Account for the completion of a request submitted through io_path, which may be
+ * NULL. A path error updates the ANA state of the path. Returns true if the
+ * request failed because of its path and should be submitted again through
+ * another one.
+ */
+bool nvme_bdev_io_path_failover(struct nvme_bdev_channel *nbdev_ch, struct nvme_io_path *io_path,
+				const struct spdk_nvme_cpl *cpl, uint32_t failover_count);
+
 #endif /* SPDK_COMMON_BDEV_NVME_H */
@@ -70,6 +70,7 @@ struct raid_offline_tailq	g_raid_bdev_offline_list = TAILQ_HEAD_INITIALIZER(
 static void	raid_bdev_examine(struct spdk_bdev *bdev);
 static int	raid_bdev_init(void);
 static void	raid0_waitq_io_process(void *ctx);
+static void	raid0_submit_split_request(struct spdk_bdev_io *bdev_io);
 static void	raid_bdev_deconfigure(struct raid_bdev *raid_bdev,
 				      raid_bdev_destruct_cb cb_fn, void *cb_arg);
 static void	raid_bdev_remove_base_bdev(void *ctx);
@@ -100,7 +101,12 @@ raid_bdev_create_cb(void *io_device, void *ctx_buf)
 
 	raid_ch->base_channel = calloc(raid_ch->num_channels,
 				       sizeof(struct spdk_io_channel *));
-	if (!raid_ch->base_channel) {
+	raid_ch->base_outstanding = calloc(raid_ch->num_channels, sizeof(uint32_t));
+	if (!raid_ch->base_channel || !raid_ch->base_outstanding) {
+		free(raid_ch->base_channel);
+		free(raid_ch->base_outstanding);
+		raid_ch->base_channel = NULL;
+		raid_ch->base_outstanding = NULL;
 		SPDK_ERRLOG("Unable to allocate base bdevs io channel\n");
 		return -ENOMEM;
 	}
@@ -108,21 +114,46 @@ raid_bdev_create_cb(void *io_device, void *ctx_buf)
 		/*
 		 * Get the spdk_io_channel for all the base bdevs. This is used during
 		 * split logic to send the respective child bdev ios to respective base
-		 * bdev io channel.
+		 * bdev io channel. A degraded raid bdev has no descriptor for a missing
+		 * base bdev and keeps its channel NULL.
 		 */
+		if (raid_bdev->base_bdev_info[i].desc == NULL) {
+			continue;
+		}
 		raid_ch->base_channel[i] = spdk_bdev_get_io_channel(
 						   raid_bdev->base_bdev_info[i].desc);
 		if (!raid_ch->base_channel[i]) {
 			for (uint8_t j = 0; j < i; j++) {
-				spdk_put_io_channel(raid_ch->base_channel[j]);
+				if (raid_ch->base_channel[j] != NULL) {
+					spdk_put_io_channel(raid_ch->base_channel[j]);
+				}
 			}
 			free(raid_ch->base_channel);
+			free(raid_ch->base_outstanding);
 			raid_ch->base_channel = NULL;
+			raid_ch->base_outstanding = NULL;
 			SPDK_ERRLOG("Unable to create io channel for base bdev\n");
 			return -ENOMEM;
 		}
 	}
 
+	if (raid_bdev->fn_table->channel_create != NULL) {
+		int rc = raid_bdev->fn_table->channel_create(raid_bdev, raid_ch);
+
+		if (rc != 0) {
+			for (uint8_t i = 0; i < raid_ch->num_channels; i++) {
+				if (raid_ch->base_channel[i] != NULL) {
+					spdk_put_io_channel(raid_ch->base_channel[i]);
+				}
+			}
+			free(raid_ch->base_channel);
+			free(raid_ch->base_outstanding);
+			raid_ch->base_channel = NULL;
+			raid_ch->base_outstanding = NULL;
+			return rc;
+		}
+	}
+
 	return 0;
 }
 
@@ -139,19 +170,26 @@ raid_bdev_create_cb(void *io_device, void *ctx_buf)
 static void
 raid_bdev_destroy_cb(void *io_device, void *ctx_buf)
 {
+	struct raid_bdev            *raid_bdev = io_device;
 	struct raid_bdev_io_channel *raid_ch = ctx_buf;
 
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "raid_bdev_destroy_cb\n");
 
 	assert(raid_ch != NULL);
 	assert(raid_ch->base_channel);
+	if (raid_bdev->fn_table->channel_destroy != NULL) {
+		raid_bdev->fn_table->channel_destroy(raid_bdev, raid_ch);
+	}
 	for (uint8_t i = 0; i < raid_ch->num_channels; i++) {
 		/* Free base bdev channels */
-		assert(raid_ch->base_channel[i] != NULL);
-		spdk_put_io_channel(raid_ch->base_channel[i]);
+		if (raid_ch->base_channel[i] != NULL) {
+			spdk_put_io_channel(raid_ch->base_channel[i]);
+		}
 	}
 	free(raid_ch->base_channel);
+	free(raid_ch->base_outstanding);
 	raid_ch->base_channel = NULL;
+	raid_ch->base_outstanding = NULL;
 }
 
 /*
@@ -195,7 +233,7 @@ raid_bdev_cleanup(struct raid_bdev *raid_bdev)
  * 0 - success
  * non zero - failure
  */
-static void
+void
 raid_bdev_free_base_bdev_resource(struct raid_bdev *raid_bdev, uint8_t base_bdev_slot)
 {
 	struct raid_base_bdev_info *info;
@@ -228,6 +266,9 @@ raid_bdev_destruct(void *ctxt)
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "raid_bdev_destruct\n");
 
 	raid_bdev->destruct_called = true;
+	if (raid_bdev->fn_table->stop != NULL) {
+		raid_bdev->fn_table->stop(raid_bdev);
+	}
 	for (uint8_t i = 0; i < raid_bdev->num_base_bdevs; i++) {
 		/*
 		 * Close all base bdev descriptors for which call has come from below
@@ -488,9 +529,7 @@ raid0_start_rw_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
 	end_strip = (bdev_io->u.bdev.offset_blocks + bdev_io->u.bdev.num_blocks - 1) >>
 		    raid_bdev->strip_size_shift;
 	if (start_strip != end_strip && raid_bdev->num_base_bdevs > 1) {
-		assert(false);
-		SPDK_ERRLOG("I/O spans strip boundary!\n");
-		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+		raid0_submit_split_request(bdev_io);
 		return;
 	}
 	ret = raid0_submit_rw_request(bdev_io, start_strip);
@@ -511,7 +550,7 @@ raid0_start_rw_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
  * returns:
  * none
  */
-static void
+void
 raid_bdev_base_io_submit_fail_process(struct spdk_bdev_io *raid_bdev_io, uint8_t pd_idx,
 				      spdk_bdev_io_wait_cb cb_fn, int ret)
 {
@@ -684,6 +723,388 @@ _raid0_split_io_range(struct raid_bdev_io_range *io_range, uint8_t disk_idx,
 	*_nblocks_in_disk = nblocks_in_disk;
 }
 
+/* Split I/O contexts preallocated per raid0 channel, and iovecs each of them holds */
+#define RAID0_SPLIT_IO_POOL_SIZE	64
+#define RAID0_SPLIT_IO_POOL_IOVS	32
+
+/*
+ * Parent I/O payload of a raid0 I/O spanning several strips, sliced into one
+ * iovec array per member disk. The strips of a member disk are contiguous on
+ * it, so each member disk gets a single request.
+ */
+struct raid0_split_io {
+	STAILQ_ENTRY(raid0_split_io)	link;
+
+	/* Taken from the pool of the channel, allocated on its own otherwise */
+	bool				pooled;
+
+	/* Index in iovs of the first iovec of each member disk request, plus the end */
+	int				*iov_start;
+	struct iovec			iovs[];
+};
+
+struct raid0_channel {
+	/* Backing memory of the split I/O contexts, and the ones not in use */
+	void				*split_pool;
+	STAILQ_HEAD(, raid0_split_io)	free_splits;
+
+	/* Parent I/O waiting for a split I/O context */
+	TAILQ_HEAD(, spdk_bdev_io)	waiting_ios;
+};
+
+/*
+ * brief:
+ * raid0_append_iovs appends the part [offset, offset + len) of an iovec array
+ * to another one, merging it with the last iovec when they are contiguous.
+ * params:
+ * iovs - iovec array to append to
+ * iovcnt - number of iovecs in iovs, updated
+ * first - index in iovs from which merging is allowed
+ * src - source iovec array
+ * src_cnt - number of iovecs in src
+ * offset - byte offset of the part in src
+ * len - byte length of the part
+ * returns:
+ * none
+ */
+static void
+raid0_append_iovs(struct iovec *iovs, int *iovcnt, int first, const struct iovec *src,
+		  int src_cnt, uint64_t offset, uint64_t len)
+{
+	struct iovec	*last;
+	uint64_t	n;
+	int		i;
+
+	for (i = 0; i < src_cnt && offset >= src[i].iov_len; i++) {
+		offset -= src[i].iov_len;
+	}
+
+	for (; i < src_cnt && len > 0; i++) {
+		n = spdk_min(len, src[i].iov_len - offset);
+		last = *iovcnt > first ? &iovs[*iovcnt - 1] : NULL;
+		if (last != NULL &&
+		    (uint8_t *)last->iov_base + last->iov_len == (uint8_t *)src[i].iov_base + offset) {
+			last->iov_len += n;
+		} else {
+			iovs[*iovcnt].iov_base = (uint8_t *)src[i].iov_base + offset;
+			iovs[*iovcnt].iov_len = n;
+			(*iovcnt)++;
+		}
+		len -= n;
+		offset = 0;
+	}
+	assert(len == 0);
+}
+
+static size_t
+raid0_split_io_size(int max_iovs, uint8_t num_base_bdevs)
+{
+	size_t size = sizeof(struct raid0_split_io) + max_iovs * sizeof(struct iovec) +
+		      (num_base_bdevs + 1) * sizeof(int);
+
+	/* Keep the contexts of a pool aligned */
+	return spdk_divide_round_up(size, sizeof(struct iovec)) * sizeof(struct iovec);
+}
+
+/*
+ * brief:
+ * raid0_channel_create preallocates the split I/O contexts of a raid bdev io channel,
+ * so that I/O spanning several strips needs no allocation.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * raid_ch - pointer to raid bdev io channel
+ * returns:
+ * 0 - success
+ * non zero - failure
+ */
+static int
+raid0_channel_create(struct raid_bdev *raid_bdev, struct raid_bdev_io_channel *raid_ch)
+{
+	struct raid0_channel	*r0ch;
+	struct raid0_split_io	*split;
+	size_t			split_size;
+	int			i;
+
+	if (raid_bdev->num_base_bdevs < 2) {
+		/* I/O is never split */
+		return 0;
+	}
+
+	split_size = raid0_split_io_size(RAID0_SPLIT_IO_POOL_IOVS, raid_bdev->num_base_bdevs);
+	r0ch = calloc(1, sizeof(*r0ch));
+	if (r0ch != NULL) {
+		r0ch->split_pool = calloc(RAID0_SPLIT_IO_POOL_SIZE, split_size);
+	}
+	if (r0ch == NULL || r0ch->split_pool == NULL) {
+		SPDK_ERRLOG("Unable to allocate raid0 channel\n");
+		free(r0ch);
+		return -ENOMEM;
+	}
+
+	STAILQ_INIT(&r0ch->free_splits);
+	TAILQ_INIT(&r0ch->waiting_ios);
+	for (i = 0; i < RAID0_SPLIT_IO_POOL_SIZE; i++) {
+		split = (struct raid0_split_io *)((uint8_t *)r0ch->split_pool + i * split_size);
+		split->pooled = true;
+		split->iov_start = (int *)&split->iovs[RAID0_SPLIT_IO_POOL_IOVS];
+		STAILQ_INSERT_TAIL(&r0ch->free_splits, split, link);
+	}
+	raid_ch->level_ctx = r0ch;
+
+	return 0;
+}
+
+static void
+raid0_channel_destroy(struct raid_bdev *raid_bdev, struct raid_bdev_io_channel *raid_ch)
+{
+	struct raid0_channel *r0ch = raid_ch->level_ctx;
+
+	if (r0ch == NULL) {
+		return;
+	}
+
+	assert(TAILQ_EMPTY(&r0ch->waiting_ios));
+	free(r0ch->split_pool);
+	free(r0ch);
+	raid_ch->level_ctx = NULL;
+}
+
+/*
+ * brief:
+ * raid0_split_io_get takes a split I/O context for a parent I/O that needs up to
+ * max_iovs iovecs from the pool of the channel. The rare parent I/O whose payload
+ * is too fragmented for it gets a context allocated on its own.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * r0ch - raid0 part of the raid bdev io channel
+ * max_iovs - number of iovecs needed
+ * returns:
+ * pointer to the split I/O, NULL if the pool is empty or on allocation failure
+ */
+static struct raid0_split_io *
+raid0_split_io_get(struct raid_bdev *raid_bdev, struct raid0_channel *r0ch, int max_iovs)
+{
+	struct raid0_split_io *split;
+
+	if (max_iovs <= RAID0_SPLIT_IO_POOL_IOVS) {
+		split = STAILQ_FIRST(&r0ch->free_splits);
+		if (split != NULL) {
+			STAILQ_REMOVE_HEAD(&r0ch->free_splits, link);
+		}
+		return split;
+	}
+
+	split = calloc(1, raid0_split_io_size(max_iovs, raid_bdev->num_base_bdevs));
+	if (split == NULL) {
+		return NULL;
+	}
+	split->iov_start = (int *)&split->iovs[max_iovs];
+
+	return split;
+}
+
+/*
+ * brief:
+ * raid0_split_io_fill slices the payload of a raid0 I/O spanning several strips
+ * per member disk, in the order of raid0_split_io_range() starting at start_disk.
+ * params:
+ * split - split I/O context, large enough for the parent bdev io
+ * raid_bdev - pointer to raid bdev
+ * bdev_io - parent bdev io
+ * io_range - io range of the parent bdev io
+ * returns:
+ * none
+ */
+static void
+raid0_split_io_fill(struct raid0_split_io *split, struct raid_bdev *raid_bdev,
+		    struct spdk_bdev_io *bdev_io, struct raid_bdev_io_range *io_range)
+{
+	uint64_t		start_block = bdev_io->u.bdev.offset_blocks;
+	uint64_t		end_block = start_block + bdev_io->u.bdev.num_blocks;
+	uint64_t		start_strip = start_block >> raid_bdev->strip_size_shift;
+	uint64_t		end_strip = (end_block - 1) >> raid_bdev->strip_size_shift;
+	uint64_t		strip, first, last;
+	int			iovcnt = 0;
+	uint8_t			i;
+
+	for (i = 0; i < io_range->n_disks_involved; i++) {
+		split->iov_start[i] = iovcnt;
+		for (strip = start_strip + i; strip <= end_strip; strip += raid_bdev->num_base_bdevs) {
+			first = spdk_max(strip << raid_bdev->strip_size_shift, start_block);
+			last = spdk_min((strip + 1) << raid_bdev->strip_size_shift, end_block);
+			raid0_append_iovs(split->iovs, &iovcnt, split->iov_start[i],
+					  bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt,
+					  (first - start_block) << raid_bdev->blocklen_shift,
+					  (last - first) << raid_bdev->blocklen_shift);
+		}
+	}
+	split->iov_start[i] = iovcnt;
+	assert(iovcnt <= bdev_io->u.bdev.iovcnt + (int)(end_strip - start_strip));
+}
+
+static void
+raid0_split_io_complete(struct spdk_bdev_io *bdev_io)
+{
+	struct raid_bdev_io	*raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+	struct raid_bdev_io_channel *raid_ch = spdk_io_channel_get_ctx(raid_io->ch);
+	struct raid0_channel	*r0ch = raid_ch->level_ctx;
+	struct raid0_split_io	*split = raid_io->split;
+	bool			pooled = split->pooled;
+
+	raid_io->split = NULL;
+	if (pooled) {
+		STAILQ_INSERT_HEAD(&r0ch->free_splits, split, link);
+	} else {
+		free(split);
+	}
+	spdk_bdev_io_complete(bdev_io, raid_io->base_bdev_io_status);
+
+	/* Hand the context over to the oldest parent I/O waiting for one */
+	if (pooled && !TAILQ_EMPTY(&r0ch->waiting_ios)) {
+		bdev_io = TAILQ_FIRST(&r0ch->waiting_ios);
+		TAILQ_REMOVE(&r0ch->waiting_ios, bdev_io, module_link);
+		raid0_submit_split_request(bdev_io);
+	}
+}
+
+static void
+raid0_split_io_completion(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct spdk_bdev_io *parent_io = cb_arg;
+	struct raid_bdev_io *raid_io = (struct raid_bdev_io *)parent_io->driver_ctx;
+
+	spdk_bdev_free_io(bdev_io);
+
+	if (!success) {
+		raid_io->base_bdev_io_status = SPDK_BDEV_IO_STATUS_FAILED;
+	}
+
+	raid_io->base_bdev_io_completed++;
+	if (raid_io->base_bdev_io_completed == raid_io->base_bdev_io_expected) {
+		raid0_split_io_complete(parent_io);
+	}
+}
+
+/*
+ * brief:
+ * _raid0_submit_split_request_next submits the remaining member disk requests
+ * of a raid0 I/O spanning several strips. It will submit as many as possible
+ * unless one fails with -ENOMEM, in which case it will queue itself for later
+ * submission.
+ * params:
+ * _bdev_io - pointer to parent bdev_io on raid bdev device
+ * returns:
+ * none
+ */
+static void
+_raid0_submit_split_request_next(void *_bdev_io)
+{
+	struct spdk_bdev_io		*bdev_io = _bdev_io;
+	struct raid_bdev_io		*raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(raid_io->ch);
+	struct raid_bdev		*raid_bdev = (struct raid_bdev *)bdev_io->bdev->ctxt;
+	struct raid0_split_io		*split = raid_io->split;
+	struct raid_bdev_io_range	io_range;
+	uint64_t			offset_in_disk;
+	uint64_t			nblocks_in_disk;
+	uint8_t				i, disk_idx;
+	int				ret;
+
+	_raid0_get_io_range(&io_range, raid_bdev->num_base_bdevs, raid_bdev->strip_size,
+			    raid_bdev->strip_size_shift, bdev_io->u.bdev.offset_blocks,
+			    bdev_io->u.bdev.num_blocks);
+
+	while (raid_io->base_bdev_io_submitted < raid_io->base_bdev_io_expected) {
+		i = raid_io->base_bdev_io_submitted;
+		disk_idx = (io_range.start_disk + i) % raid_bdev->num_base_bdevs;
+		_raid0_split_io_range(&io_range, disk_idx, &offset_in_disk, &nblocks_in_disk);
+
+		if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ) {
+			ret = spdk_bdev_readv_blocks(raid_bdev->base_bdev_info[disk_idx].desc,
+						     raid_ch->base_channel[disk_idx],
+						     &split->iovs[split->iov_start[i]],
+						     split->iov_start[i + 1] - split->iov_start[i],
+						     offset_in_disk, nblocks_in_disk,
+						     raid0_split_io_completion, bdev_io);
+		} else {
+			ret = spdk_bdev_writev_blocks(raid_bdev->base_bdev_info[disk_idx].desc,
+						      raid_ch->base_channel[disk_idx],
+						      &split->iovs[split->iov_start[i]],
+						      split->iov_start[i + 1] - split->iov_start[i],
+						      offset_in_disk, nblocks_in_disk,
+						      raid0_split_io_completion, bdev_io);
+		}
+
+		if (ret == -ENOMEM) {
+			raid_bdev_base_io_submit_fail_process(bdev_io, disk_idx,
+							      _raid0_submit_split_request_next, ret);
+			return;
+		}
+
+		if (ret != 0) {
+			SPDK_ERRLOG("bdev io submit error %d on base bdev %u\n", ret, disk_idx);
+			raid_io->base_bdev_io_status = SPDK_BDEV_IO_STATUS_FAILED;
+			raid_io->base_bdev_io_expected = raid_io->base_bdev_io_submitted;
+			if (raid_io->base_bdev_io_completed == raid_io->base_bdev_io_expected) {
+				raid0_split_io_complete(bdev_io);
+			}
+			return;
+		}
+
+		raid_io->base_bdev_io_submitted++;
+	}
+}
+
+/*
+ * brief:
+ * raid0_submit_split_request submits a raid0 read or write spanning several
+ * strips with one request per member disk involved, instead of one per strip.
+ * params:
+ * bdev_io - pointer to parent bdev_io on raid bdev device
+ * returns:
+ * none
+ */
+static void
+raid0_submit_split_request(struct spdk_bdev_io *bdev_io)
+{
+	struct raid_bdev_io		*raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(raid_io->ch);
+	struct raid0_channel		*r0ch = raid_ch->level_ctx;
+	struct raid_bdev		*raid_bdev = (struct raid_bdev *)bdev_io->bdev->ctxt;
+	struct raid_bdev_io_range	io_range;
+	uint64_t			start_strip, end_strip;
+	int				max_iovs;
+
+	_raid0_get_io_range(&io_range, raid_bdev->num_base_bdevs, raid_bdev->strip_size,
+			    raid_bdev->strip_size_shift, bdev_io->u.bdev.offset_blocks,
+			    bdev_io->u.bdev.num_blocks);
+
+	/* Every strip boundary cuts at most one parent iovec in two */
+	start_strip = bdev_io->u.bdev.offset_blocks >> raid_bdev->strip_size_shift;
+	end_strip = (bdev_io->u.bdev.offset_blocks + bdev_io->u.bdev.num_blocks - 1) >>
+		    raid_bdev->strip_size_shift;
+	max_iovs = bdev_io->u.bdev.iovcnt + (end_strip - start_strip);
+
+	raid_io->split = raid0_split_io_get(raid_bdev, r0ch, max_iovs);
+	if (raid_io->split == NULL) {
+		if (max_iovs <= RAID0_SPLIT_IO_POOL_IOVS) {
+			/* Submitted again once an I/O of this channel gives its context back */
+			TAILQ_INSERT_TAIL(&r0ch->waiting_ios, bdev_io, module_link);
+			return;
+		}
+		SPDK_ERRLOG("Unable to allocate memory for split io\n");
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_NOMEM);
+		return;
+	}
+	raid0_split_io_fill(raid_io->split, raid_bdev, bdev_io, &io_range);
+
+	raid_io->base_bdev_io_submitted = 0;
+	raid_io->base_bdev_io_completed = 0;
+	raid_io->base_bdev_io_expected = io_range.n_disks_involved;
+	raid_io->base_bdev_io_status = SPDK_BDEV_IO_STATUS_SUCCESS;
+	_raid0_submit_split_request_next(bdev_io);
+}
+
 /*
  * brief:
  * _raid_bdev_submit_null_payload_request_next function submits the next batch of
@@ -839,12 +1260,20 @@ raid_bdev_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_i
 		break;
 
 	case SPDK_BDEV_IO_TYPE_RESET:
-		_raid_bdev_submit_reset_request(ch, bdev_io);
+		if (raid_bdev->fn_table->submit_null_payload_request != NULL) {
+			raid_bdev->fn_table->submit_null_payload_request(ch, bdev_io);
+		} else {
+			_raid_bdev_submit_reset_request(ch, bdev_io);
+		}
 		break;
 
 	case SPDK_BDEV_IO_TYPE_FLUSH:
 	case SPDK_BDEV_IO_TYPE_UNMAP:
-		_raid_bdev_submit_null_payload_request(ch, bdev_io);
+		if (raid_bdev->fn_table->submit_null_payload_request != NULL) {
+			raid_bdev->fn_table->submit_null_payload_request(ch, bdev_io);
+		} else {
+			_raid_bdev_submit_null_payload_request(ch, bdev_io);
+		}
 		break;
 
 	default:
@@ -875,7 +1304,8 @@ _raid_bdev_io_type_supported(struct raid_bdev *raid_bdev, enum spdk_bdev_io_type
 
 	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
 		if (raid_bdev->base_bdev_info[i].bdev == NULL) {
-			assert(false);
+			/* Only a raid level that runs degraded can miss a base bdev. */
+			assert(raid_bdev->fn_table->remove_base_bdev != NULL);
 			continue;
 		}
 
@@ -903,6 +1333,8 @@ _raid_bdev_io_type_supported(struct raid_bdev *raid_bdev, enum spdk_bdev_io_type
 static bool
 raid_bdev_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type)
 {
+	struct raid_bdev *raid_bdev = ctx;
+
 	switch (io_type) {
 	case SPDK_BDEV_IO_TYPE_READ:
 	case SPDK_BDEV_IO_TYPE_WRITE:
@@ -911,7 +1343,10 @@ raid_bdev_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type)
 	case SPDK_BDEV_IO_TYPE_FLUSH:
 	case SPDK_BDEV_IO_TYPE_RESET:
 	case SPDK_BDEV_IO_TYPE_UNMAP:
-		return _raid_bdev_io_type_supported(ctx, io_type);
+		if (raid_bdev->fn_table->io_type_supported != NULL) {
+			return raid_bdev->fn_table->io_type_supported(raid_bdev, io_type);
+		}
+		return _raid_bdev_io_type_supported(raid_bdev, io_type);
 
 	default:
 		return false;
@@ -974,6 +1409,9 @@ raid_bdev_dump_info_json(void *ctx, struct spdk_json_write_ctx *w)
 		}
 	}
 	spdk_json_write_array_end(w);
+	if (raid_bdev->fn_table->dump_info_json != NULL) {
+		raid_bdev->fn_table->dump_info_json(raid_bdev, w);
+	}
 	spdk_json_write_object_end(w);
 
 	return 0;
@@ -1009,6 +1447,9 @@ raid_bdev_write_config_json(struct spdk_bdev *bdev, struct spdk_json_write_ctx *
 		base = raid_bdev->base_bdev_info[i].bdev;
 		if (base) {
 			spdk_json_write_string(w, base->name);
+		} else if (raid_bdev->config != NULL) {
+			/* A degraded raid bdev still wants its missing base bdev back. */
+			spdk_json_write_string(w, raid_bdev->config->base_bdev[i].name);
 		}
 	}
 	spdk_json_write_array_end(w);
@@ -1102,7 +1543,7 @@ raid_bdev_config_find_by_name(const char *raid_name)
  * raid_name - name for raid bdev.
  * strip_size - strip size in KB
  * num_base_bdevs - number of base bdevs.
- * raid_level - raid level, only raid level 0 is supported.
+ * raid_level - raid level, 0, 1 or 5.
  * _raid_cfg - Pointer to newly added configuration
  */
 int
@@ -1128,12 +1569,23 @@ raid_bdev_config_add(const char *raid_name, uint32_t strip_size, uint8_t num_bas
 		return -EINVAL;
 	}
 
-	if (raid_level != RAID0) {
-		SPDK_ERRLOG("invalid raid level %u, only raid level 0 is supported\n",
+	if (raid_level != RAID0 && raid_level != RAID1 && raid_level != RAID5) {
+		SPDK_ERRLOG("invalid raid level %u, only raid levels 0, 1 and 5 are supported\n",
 			    raid_level);
 		return -EINVAL;
 	}
 
+	if (raid_level == RAID1 && (num_base_bdevs < 2 || num_base_bdevs > RAID1_MAX_BASE_BDEVS)) {
+		SPDK_ERRLOG("raid level 1 needs 2 to %u base devices, got %u\n",
+			    RAID1_MAX_BASE_BDEVS, num_base_bdevs);
+		return -EINVAL;
+	}
+
+	if (raid_level == RAID5 && num_base_bdevs < 3) {
+		SPDK_ERRLOG("raid level 5 needs at least 3 base devices, got %u\n", num_base_bdevs);
+		return -EINVAL;
+	}
+
 	raid_cfg = calloc(1, sizeof(*raid_cfg));
 	if (raid_cfg == NULL) {
 		SPDK_ERRLOG("unable to allocate memory\n");
@@ -1521,6 +1973,8 @@ static const struct raid_fn_table g_raid0_fn_table = {
 	.waitq_io_process	= raid0_waitq_io_process,
 	.get_io_range		= _raid0_get_io_range,
 	.split_io_range		= _raid0_split_io_range,
+	.channel_create		= raid0_channel_create,
+	.channel_destroy	= raid0_channel_destroy,
 };
 
 /*
@@ -1567,6 +2021,12 @@ raid_bdev_create(struct raid_bdev_config *raid_cfg)
 	case RAID0:
 		raid_bdev->fn_table = &g_raid0_fn_table;
 		break;
+	case RAID1:
+		raid_bdev->fn_table = &g_raid1_fn_table;
+		break;
+	case RAID5:
+		raid_bdev->fn_table = &g_raid5_fn_table;
+		break;
 	default:
 		SPDK_ERRLOG("invalid raid level %u\n", raid_bdev->raid_level);
 		free(raid_bdev);
@@ -1630,7 +2090,7 @@ raid_bdev_alloc_base_bdev_resource(struct raid_bdev *raid_bdev, struct spdk_bdev
 
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "bdev %s is claimed\n", bdev->name);
 
-	assert(raid_bdev->state != RAID_BDEV_STATE_ONLINE);
+	assert(raid_bdev->state != RAID_BDEV_STATE_ONLINE || raid_bdev->fn_table->add_base_bdev != NULL);
 	assert(base_bdev_slot < raid_bdev->num_base_bdevs);
 
 	raid_bdev->base_bdev_info[base_bdev_slot].bdev = bdev;
@@ -1689,8 +2149,12 @@ raid_bdev_configure(struct raid_bdev *raid_bdev)
 	raid_bdev_gen = &raid_bdev->bdev;
 	raid_bdev_gen->blocklen = blocklen;
 	if (raid_bdev->num_base_bdevs > 1) {
+		/*
+		 * I/O spanning several strips is sliced per member disk by raid0 itself,
+		 * the strip size is only reported as a hint.
+		 */
 		raid_bdev_gen->optimal_io_boundary = raid_bdev->strip_size;
-		raid_bdev_gen->split_on_optimal_io_boundary = true;
+		raid_bdev_gen->split_on_optimal_io_boundary = false;
 	} else {
 		/* Do not need to split reads/writes on single bdev RAID modules. */
 		raid_bdev_gen->optimal_io_boundary = 0;
@@ -1707,10 +2171,18 @@ raid_bdev_configure(struct raid_bdev *raid_bdev)
 		      raid_bdev->num_base_bdevs, raid_bdev->strip_size_shift);
 	raid_bdev_gen->blockcnt = ((min_blockcnt >> raid_bdev->strip_size_shift) <<
 				   raid_bdev->strip_size_shift)  * raid_bdev->num_base_bdevs;
-	SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "io device register %p\n", raid_bdev);
-	SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "blockcnt %lu, blocklen %u\n", raid_bdev_gen->blockcnt,
-		      raid_bdev_gen->blocklen);
 	if (raid_bdev->state == RAID_BDEV_STATE_CONFIGURING) {
+		if (raid_bdev->fn_table->start != NULL) {
+			/* The raid level may lay out the raid bdev differently */
+			rc = raid_bdev->fn_table->start(raid_bdev);
+			if (rc != 0) {
+				SPDK_ERRLOG("Unable to start raid bdev and stay at configuring state\n");
+				return rc;
+			}
+		}
+		SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "io device register %p\n", raid_bdev);
+		SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "blockcnt %lu, blocklen %u\n", raid_bdev_gen->blockcnt,
+			      raid_bdev_gen->blocklen);
 		raid_bdev->state = RAID_BDEV_STATE_ONLINE;
 		spdk_io_device_register(raid_bdev, raid_bdev_create_cb, raid_bdev_destroy_cb,
 					sizeof(struct raid_bdev_io_channel),
@@ -1718,6 +2190,9 @@ raid_bdev_configure(struct raid_bdev *raid_bdev)
 		rc = spdk_bdev_register(raid_bdev_gen);
 		if (rc != 0) {
 			SPDK_ERRLOG("Unable to register raid bdev and stay at configuring state\n");
+			if (raid_bdev->fn_table->stop != NULL) {
+				raid_bdev->fn_table->stop(raid_bdev);
+			}
 			spdk_io_device_unregister(raid_bdev, NULL);
 			raid_bdev->state = RAID_BDEV_STATE_CONFIGURING;
 			return rc;
@@ -1755,7 +2230,8 @@ raid_bdev_deconfigure(struct raid_bdev *raid_bdev, raid_bdev_destruct_cb cb_fn,
 		return;
 	}
 
-	assert(raid_bdev->num_base_bdevs == raid_bdev->num_base_bdevs_discovered);
+	assert(raid_bdev->num_base_bdevs == raid_bdev->num_base_bdevs_discovered ||
+	       raid_bdev->fn_table->remove_base_bdev != NULL);
 	TAILQ_REMOVE(&g_raid_bdev_configured_list, raid_bdev, state_link);
 	raid_bdev->state = RAID_BDEV_STATE_OFFLINE;
 	assert(raid_bdev->num_base_bdevs_discovered);
@@ -1837,6 +2313,12 @@ raid_bdev_remove_base_bdev(void *ctx)
 			raid_bdev_cleanup(raid_bdev);
 			return;
 		}
+	} else if (raid_bdev->state == RAID_BDEV_STATE_ONLINE &&
+		   raid_bdev->fn_table->remove_base_bdev != NULL) {
+		/* The raid level may keep running without this base bdev. */
+		if (raid_bdev->fn_table->remove_base_bdev(raid_bdev, base_bdev_slot) == 0) {
+			return;
+		}
 	}
 
 	raid_bdev_deconfigure(raid_bdev, NULL, NULL);
@@ -1938,12 +2420,29 @@ raid_bdev_add_base_device(struct raid_bdev_config *raid_cfg, struct spdk_bdev *b
 		return -ENODEV;
 	}
 
+	if (raid_bdev->state == RAID_BDEV_STATE_ONLINE) {
+		/* Only a degraded raid bdev whose level can take a base bdev back accepts it */
+		if (raid_bdev->fn_table->add_base_bdev == NULL || raid_bdev->destruct_called ||
+		    raid_bdev->base_bdev_info[base_bdev_slot].bdev != NULL) {
+			return -EBUSY;
+		}
+	}
+
 	rc = raid_bdev_alloc_base_bdev_resource(raid_bdev, bdev, base_bdev_slot);
 	if (rc != 0) {
 		SPDK_ERRLOG("Failed to allocate resource for bdev '%s'\n", bdev->name);
 		return rc;
 	}
 
+	if (raid_bdev->state == RAID_BDEV_STATE_ONLINE) {
+		rc = raid_bdev->fn_table->add_base_bdev(raid_bdev, base_bdev_slot);
+		if (rc != 0) {
+			SPDK_ERRLOG("Failed to add bdev '%s' back to raid bdev\n", bdev->name);
+			raid_bdev_free_base_bdev_resource(raid_bdev, base_bdev_slot);
+		}
+		return rc;
+	}
+
 	assert(raid_bdev->num_base_bdevs_discovered <= raid_bdev->num_base_bdevs);
 
 	if (raid_bdev->num_base_bdevs_discovered == raid_bdev->num_base_bdevs) {
@@ -37,6 +37,11 @@
 #include "spdk/bdev_module.h"
 
 #define RAID0 0
+#define RAID1 1
+#define RAID5 5
+
+/* Fanout I/O of raid1 tracks its base bdevs in 64 bit masks */
+#define RAID1_MAX_BASE_BDEVS 64
 
 /*
  * Raid state describes the state of the raid. This raid bdev can be either in
@@ -80,8 +85,17 @@ struct raid_base_bdev_info {
 	 * descriptor will be closed
 	 */
 	bool			remove_scheduled;
+
+	/*
+	 * Set while this base bdev may not hold all the data of the raid bdev, e.g. after
+	 * it came back to a degraded raid1 bdev and until it is resynced. Reads are not
+	 * sent to it.
+	 */
+	bool			resyncing;
 };
 
+struct raid0_split_io;
+
 /*
  * raid_bdev_io is the context part of bdev_io. It contains the information
  * related to bdev_io for a raid bdev
@@ -98,6 +112,23 @@ struct raid_bdev_io {
 	uint8_t				base_bdev_io_completed;
 	uint8_t				base_bdev_io_expected;
 	uint8_t				base_bdev_io_status;
+
+	/* raid1: base bdev a read was sent to and write epoch a write was counted in */
+	uint8_t				base_bdev_idx;
+	uint8_t				write_epoch;
+
+	/*
+	 * raid1: slots of the base bdevs that were in sync when a fanout I/O was
+	 * submitted to them, and slots that completed it successfully
+	 */
+	uint64_t			in_sync_slots;
+	uint64_t			succeeded_slots;
+
+	/* raid1: slots listed in sync by the superblocks that a held write missed */
+	uint64_t			held_slots;
+
+	/* raid0: member disk requests of an I/O spanning several strips */
+	struct raid0_split_io		*split;
 };
 
 /* raid0 IO range */
@@ -113,6 +144,7 @@ struct raid_bdev_io_range {
 };
 
 struct raid_bdev;
+struct raid_bdev_io_channel;
 
 struct raid_fn_table {
 	void (*start_rw_request)(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io);
@@ -123,6 +155,38 @@ struct raid_fn_table {
 			     uint64_t offset_blocks, uint64_t num_blocks);
 	void (*split_io_range)(struct raid_bdev_io_range *io_range, uint8_t disk_idx,
 			       uint64_t *_offset_in_disk, uint64_t *_nblocks_in_disk);
+
+	/*
+	 * The callbacks below are optional.
+	 *
+	 * submit_null_payload_request handles FLUSH, UNMAP and RESET instead of the
+	 *  striped split done for raid0.
+	 */
+	void (*submit_null_payload_request)(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io);
+
+	/*
+	 * start is called once all base bdevs are discovered, before the raid bdev is
+	 *  registered, and may adjust its geometry. stop is called when it is destructed.
+	 */
+	int (*start)(struct raid_bdev *raid_bdev);
+	void (*stop)(struct raid_bdev *raid_bdev);
+
+	/*
+	 * Called when a base bdev of an online raid bdev is hot removed or comes back.
+	 *  remove_base_bdev returns non zero if the raid bdev can't run without it and
+	 *  has to go offline.
+	 */
+	int (*remove_base_bdev)(struct raid_bdev *raid_bdev, uint8_t slot);
+	int (*add_base_bdev)(struct raid_bdev *raid_bdev, uint8_t slot);
+
+	void (*dump_info_json)(struct raid_bdev *raid_bdev, struct spdk_json_write_ctx *w);
+
+	/* Overrides the generic check of the I/O types the base bdevs support. */
+	bool (*io_type_supported)(struct raid_bdev *raid_bdev, enum spdk_bdev_io_type io_type);
+
+	/* Set up and tear down the level_ctx of a raid bdev io channel. */
+	int (*channel_create)(struct raid_bdev *raid_bdev, struct raid_bdev_io_channel *raid_ch);
+	void (*channel_destroy)(struct raid_bdev *raid_bdev, struct raid_bdev_io_channel *raid_ch);
 };
 
 /*
@@ -178,6 +242,9 @@ struct raid_bdev {
 
 	/* function table for RAID operations */
 	const struct raid_fn_table	*fn_table;
+
+	/* private data of the raid level */
+	void				*level_ctx;
 };
 
 /*
@@ -236,6 +303,15 @@ struct raid_bdev_io_channel {
 
 	/* Number of IO channels */
 	uint8_t			num_channels;
+
+	/* raid1: reads outstanding on each base bdev channel */
+	uint32_t		*base_outstanding;
+
+	/* raid1: writes outstanding in the current and the previous write epoch */
+	uint64_t		writes_in_epoch[2];
+
+	/* private data of the raid level */
+	void			*level_ctx;
 };
 
 /* TAIL heads for various raid bdev lists */
@@ -263,4 +339,11 @@ int raid_bdev_config_add_base_bdev(struct raid_bdev_config *raid_cfg,
 void raid_bdev_config_cleanup(struct raid_bdev_config *raid_cfg);
 struct raid_bdev_config *raid_bdev_config_find_by_name(const char *raid_name);
 
+void raid_bdev_base_io_submit_fail_process(struct spdk_bdev_io *raid_bdev_io, uint8_t pd_idx,
+		spdk_bdev_io_wait_cb cb_fn, int ret);
+void raid_bdev_free_base_bdev_resource(struct raid_bdev *raid_bdev, uint8_t base_bdev_slot);
+
+extern const struct raid_fn_table g_raid1_fn_table;
+extern const struct raid_fn_table g_raid5_fn_table;
+
 #endif /* SPDK_BDEV_RAID_INTERNAL_H */
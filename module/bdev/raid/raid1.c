@@ -0,0 +1,1863 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bdev_raid.h"
+
+#include "spdk/crc32.h"
+#include "spdk/env.h"
+#include "spdk/thread.h"
+#include "spdk/util.h"
+#include "spdk/uuid.h"
+#include "spdk/json.h"
+#include "spdk_internal/log.h"
+
+/*
+ * raid1 mirrors the raid bdev on every base bdev. Writes go to all base bdevs
+ * that are present and reads go to the in-sync base bdev with the fewest reads
+ * outstanding on the channel.
+ *
+ * When a base bdev is removed or fails, the raid bdev keeps running as long as
+ * one in-sync base bdev is left. Every write that completes while a base bdev
+ * is out of sync sets the bits of the regions it touched in the dirty map of
+ * that base bdev. A region is strip_size blocks. When the base bdev comes back,
+ * the resync poller copies only the dirty regions to it from an in-sync base
+ * bdev.
+ *
+ * Writes racing with a copy are sent to the resyncing base bdev too and set
+ * the region dirty again when they complete, so it is copied once more. Before
+ * copying a batch of regions, and before declaring the base bdev in sync, the
+ * resync flips the write epoch and waits on every channel for the writes of the
+ * previous epoch, so that no write submitted before a region was cleared can
+ * complete after it was copied without setting it again.
+ *
+ * The last block of every base bdev holds a superblock with the UUID of the raid
+ * bdev and an event counter, bumped every time the set of in-sync base bdevs
+ * changes and written to the base bdevs in sync. When the raid bdev starts, the
+ * base bdevs with the highest event counter are in sync and the others are
+ * resynced in full. A base bdev that comes back is resynced from its dirty map
+ * only if its superblock holds the event counter it had when it went out of sync,
+ * and in full otherwise. A base bdev with the superblock of another raid bdev is
+ * not used. A write that missed a base bdev is not acked before the superblocks
+ * of the others stop listing it in sync.
+ */
+
+/* Number of dirty regions copied per write epoch flip */
+#define RAID1_RESYNC_BATCH		32
+
+/* How often a raid1 bdev checks for base bdevs to resync */
+#define RAID1_RESYNC_CHECK_US		(100 * 1000)
+
+#define RAID1_SB_MAGIC			"SPDKRAD1"
+#define RAID1_SB_VERSION		1
+
+/* In the last block of every base bdev */
+struct raid1_sb {
+	char			magic[8];
+	uint32_t		version;
+	/* CRC32C of the superblock with this field set to 0 */
+	uint32_t		crc;
+	struct spdk_uuid	uuid;
+	uint64_t		events;
+};
+
+enum raid1_resync_state {
+	/* Look for a base bdev to resync */
+	RAID1_RESYNC_IDLE,
+
+	/* Collect the next batch of dirty regions of the base bdev */
+	RAID1_RESYNC_SCAN,
+
+	/* Wait for the writes of the previous write epoch */
+	RAID1_RESYNC_DRAIN,
+
+	/* Copy the batch of regions */
+	RAID1_RESYNC_COPY,
+
+	/* All regions were copied once, check if the base bdev is in sync */
+	RAID1_RESYNC_FINISH,
+};
+
+struct raid1_info {
+	struct raid_bdev		*raid_bdev;
+	uint8_t				num_base_bdevs;
+
+	/* Dirty region bitmap of every base bdev */
+	uint64_t			**dirty_maps;
+	uint64_t			num_regions;
+	uint64_t			map_words;
+
+	/* Writes are counted per channel in writes_in_epoch[write_epoch & 1] */
+	uint32_t			write_epoch;
+
+	struct spdk_poller		*check_poller;
+	struct spdk_poller		*resync_poller;
+	struct spdk_io_channel		*resync_ch;
+	void				*resync_buf;
+	enum raid1_resync_state		resync_state;
+	uint8_t				resync_slot;
+	uint8_t				resync_src;
+	uint64_t			resync_cursor;
+	uint64_t			resync_batch[RAID1_RESYNC_BATCH];
+	uint32_t			resync_batch_count;
+	uint32_t			resync_batch_idx;
+
+	/* A channel iteration or a copy I/O of the resync is in progress */
+	bool				resync_io_pending;
+
+	/* Thread the raid bdev was started on, the superblocks are read and written on it */
+	struct spdk_thread		*thread;
+	struct spdk_uuid		uuid;
+	uint64_t			events;
+
+	/*
+	 * Slots whose superblock holds the current event counter. A write is not
+	 * acked while it missed one of them.
+	 */
+	uint64_t			sb_slots;
+	/* Slots whose superblock holds left_events[slot], written when they went out of sync */
+	uint64_t			left_slots;
+	uint64_t			*left_events;
+
+	/* Superblocks read at start, NULL once they were all read */
+	struct raid1_sb			*loaded_sbs;
+	uint64_t			loaded_valid;
+	uint8_t				load_remaining;
+
+	/* I/O is queued on the channels until the superblocks are read and written */
+	bool				loading;
+	/* Slots written by the round in progress, writes left in it and another round needed */
+	uint64_t			sb_round_slots;
+	uint32_t			sb_writes;
+	bool				sb_writing;
+	bool				sb_again;
+	/* Superblock I/O, channel iterations and messages in flight that refer to this */
+	uint32_t			sb_io_pending;
+
+	/* The raid bdev was destructed, free this once the resync and superblock I/O is done */
+	bool				stopped;
+};
+
+struct raid1_channel {
+	/* I/O submitted while the raid bdev was loading */
+	TAILQ_HEAD(, spdk_bdev_io)	waiting_ios;
+	/* Writes that completed but missed a base bdev still listed in sync by the superblocks */
+	TAILQ_HEAD(, spdk_bdev_io)	held_ios;
+};
+
+struct raid1_slot_ctx {
+	struct raid_bdev		*raid_bdev;
+	uint8_t				slot;
+};
+
+struct raid1_sb_io {
+	struct raid1_info		*raid1;
+	uint8_t				slot;
+	struct spdk_bdev_desc		*desc;
+	struct spdk_io_channel		*ch;
+	struct raid1_sb			*sb;
+	void				(*done)(struct raid1_sb_io *sb_io, bool success);
+};
+
+static void raid1_resync_start(struct raid1_info *raid1);
+static void raid1_sb_update(struct raid1_info *raid1);
+static void raid1_free(struct raid1_info *raid1);
+static void raid1_detach_base_bdev(struct raid_bdev *raid_bdev, uint8_t slot);
+
+static inline bool
+raid1_base_bdev_in_sync(struct raid_bdev *raid_bdev, uint8_t slot)
+{
+	struct raid_base_bdev_info *info = &raid_bdev->base_bdev_info[slot];
+
+	return info->bdev != NULL && !info->resyncing && !info->remove_scheduled;
+}
+
+static inline bool
+raid1_write_tracked(struct spdk_bdev_io *bdev_io)
+{
+	return bdev_io->type == SPDK_BDEV_IO_TYPE_WRITE || bdev_io->type == SPDK_BDEV_IO_TYPE_UNMAP;
+}
+
+static void
+raid1_set_regions(uint64_t *map, uint64_t first, uint64_t last)
+{
+	uint64_t region;
+
+	for (region = first; region <= last; region++) {
+		__atomic_fetch_or(&map[region / 64], 1ULL << (region % 64), __ATOMIC_RELAXED);
+	}
+}
+
+/*
+ * brief:
+ * raid1_mark_dirty sets the regions of a completed write dirty in the map of
+ * every base bdev that is out of sync.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * offset_blocks - start of the write
+ * num_blocks - length of the write
+ * returns:
+ * none
+ */
+static void
+raid1_mark_dirty(struct raid_bdev *raid_bdev, uint64_t offset_blocks, uint64_t num_blocks)
+{
+	struct raid1_info	*raid1 = raid_bdev->level_ctx;
+	uint64_t		first, last;
+	uint8_t			i;
+
+	if (num_blocks == 0) {
+		return;
+	}
+
+	first = offset_blocks >> raid_bdev->strip_size_shift;
+	last = (offset_blocks + num_blocks - 1) >> raid_bdev->strip_size_shift;
+	assert(last < raid1->num_regions);
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		if (!raid1_base_bdev_in_sync(raid_bdev, i)) {
+			raid1_set_regions(raid1->dirty_maps[i], first, last);
+		}
+	}
+}
+
+/*
+ * brief:
+ * raid1_base_bdev_failed takes a base bdev that failed a write out of the set
+ * of in-sync base bdevs, unless it is the last one. Its regions are then
+ * tracked and it is resynced by the next check.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * slot - base bdev slot
+ * returns:
+ * none
+ */
+static void
+raid1_base_bdev_failed(struct raid_bdev *raid_bdev, uint8_t slot)
+{
+	uint8_t i;
+
+	if (!raid1_base_bdev_in_sync(raid_bdev, slot)) {
+		return;
+	}
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		if (i != slot && raid1_base_bdev_in_sync(raid_bdev, i)) {
+			break;
+		}
+	}
+
+	if (i == raid_bdev->num_base_bdevs) {
+		return;
+	}
+
+	SPDK_ERRLOG("Base bdev %s of raid bdev %s failed a write, it will be resynced\n",
+		    raid_bdev->base_bdev_info[slot].bdev->name, raid_bdev->bdev.name);
+	raid_bdev->base_bdev_info[slot].resyncing = true;
+	raid1_sb_update(raid_bdev->level_ctx);
+}
+
+static uint8_t
+raid1_get_base_bdev_slot(struct raid_bdev *raid_bdev, struct spdk_bdev *bdev)
+{
+	uint8_t i;
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		if (bdev != NULL && raid_bdev->base_bdev_info[i].bdev == bdev) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+/*
+ * brief:
+ * raid1_select_read_base_bdev picks the in-sync base bdev with the fewest reads
+ * outstanding on this channel.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * raid_ch - pointer to raid bdev io channel
+ * exclude - slot to skip, e.g. one that just failed the read
+ * returns:
+ * slot of the base bdev, num_base_bdevs if there is none
+ */
+static uint8_t
+raid1_select_read_base_bdev(struct raid_bdev *raid_bdev, struct raid_bdev_io_channel *raid_ch,
+			    uint8_t exclude)
+{
+	uint8_t		i, slot = raid_bdev->num_base_bdevs;
+	uint32_t	min_outstanding = UINT32_MAX;
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		if (i == exclude || raid_ch->base_channel[i] == NULL ||
+		    !raid1_base_bdev_in_sync(raid_bdev, i)) {
+			continue;
+		}
+
+		if (raid_ch->base_outstanding[i] < min_outstanding) {
+			min_outstanding = raid_ch->base_outstanding[i];
+			slot = i;
+		}
+	}
+
+	return slot;
+}
+
+static void _raid1_submit_read_request(void *_bdev_io);
+
+static void
+raid1_read_completion(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct spdk_bdev_io		*parent_io = cb_arg;
+	struct raid_bdev_io		*raid_io = (struct raid_bdev_io *)parent_io->driver_ctx;
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(raid_io->ch);
+	struct raid_bdev		*raid_bdev = parent_io->bdev->ctxt;
+
+	spdk_bdev_free_io(bdev_io);
+
+	assert(raid_ch->base_outstanding[raid_io->base_bdev_idx] > 0);
+	raid_ch->base_outstanding[raid_io->base_bdev_idx]--;
+
+	if (success) {
+		spdk_bdev_io_complete(parent_io, SPDK_BDEV_IO_STATUS_SUCCESS);
+		return;
+	}
+
+	/* Retry the read on another in-sync base bdev */
+	raid_io->base_bdev_io_completed++;
+	if (raid_io->base_bdev_io_completed >= raid_bdev->num_base_bdevs) {
+		spdk_bdev_io_complete(parent_io, SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
+	_raid1_submit_read_request(parent_io);
+}
+
+/*
+ * brief:
+ * _raid1_submit_read_request submits a read to one in-sync base bdev. The
+ * number of failed attempts is kept in base_bdev_io_completed and the slot of
+ * the last attempt in base_bdev_idx.
+ * params:
+ * _bdev_io - pointer to parent bdev_io on raid bdev device
+ * returns:
+ * none
+ */
+static void
+_raid1_submit_read_request(void *_bdev_io)
+{
+	struct spdk_bdev_io		*bdev_io = _bdev_io;
+	struct raid_bdev_io		*raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(raid_io->ch);
+	struct raid_bdev		*raid_bdev = bdev_io->bdev->ctxt;
+	uint8_t				slot, exclude;
+	int				ret;
+
+	exclude = raid_io->base_bdev_io_completed > 0 ? raid_io->base_bdev_idx : UINT8_MAX;
+	slot = raid1_select_read_base_bdev(raid_bdev, raid_ch, exclude);
+	if (slot == raid_bdev->num_base_bdevs) {
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
+	raid_io->base_bdev_idx = slot;
+	raid_ch->base_outstanding[slot]++;
+	ret = spdk_bdev_readv_blocks(raid_bdev->base_bdev_info[slot].desc,
+				     raid_ch->base_channel[slot],
+				     bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt,
+				     bdev_io->u.bdev.offset_blocks, bdev_io->u.bdev.num_blocks,
+				     raid1_read_completion, bdev_io);
+	if (ret != 0) {
+		raid_ch->base_outstanding[slot]--;
+		raid_bdev_base_io_submit_fail_process(bdev_io, slot, _raid1_submit_read_request, ret);
+	}
+}
+
+static void
+raid1_fanout_complete(struct spdk_bdev_io *bdev_io)
+{
+	struct raid_bdev_io		*raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(raid_io->ch);
+	struct raid1_channel		*r1ch = raid_ch->level_ctx;
+	struct raid_bdev		*raid_bdev = bdev_io->bdev->ctxt;
+	struct raid1_info		*raid1 = raid_bdev->level_ctx;
+
+	if (raid1_write_tracked(bdev_io)) {
+		raid1_mark_dirty(raid_bdev, bdev_io->u.bdev.offset_blocks, bdev_io->u.bdev.num_blocks);
+		assert(raid_ch->writes_in_epoch[raid_io->write_epoch] > 0);
+		raid_ch->writes_in_epoch[raid_io->write_epoch]--;
+	}
+
+	/*
+	 * A base bdev that is resyncing does not hold the data the raid bdev reads, so
+	 * only base bdevs that were in sync when the I/O was submitted count.
+	 */
+	if (raid_io->in_sync_slots & raid_io->succeeded_slots) {
+		raid_io->base_bdev_io_status = SPDK_BDEV_IO_STATUS_SUCCESS;
+	} else {
+		raid_io->base_bdev_io_status = SPDK_BDEV_IO_STATUS_FAILED;
+	}
+
+	/*
+	 * Don't ack a write that a base bdev missed while its superblock says it is
+	 * in sync, it would be used after a restart without the write.
+	 */
+	if (raid1_write_tracked(bdev_io) &&
+	    raid_io->base_bdev_io_status == SPDK_BDEV_IO_STATUS_SUCCESS) {
+		raid_io->held_slots = __atomic_load_n(&raid1->sb_slots, __ATOMIC_SEQ_CST) &
+				      ~raid_io->succeeded_slots;
+		if (raid_io->held_slots != 0) {
+			TAILQ_INSERT_TAIL(&r1ch->held_ios, bdev_io, module_link);
+			return;
+		}
+	}
+
+	spdk_bdev_io_complete(bdev_io, raid_io->base_bdev_io_status);
+}
+
+/*
+ * brief:
+ * raid1_queue_if_loading queues an I/O submitted before the superblocks of the
+ * raid bdev were read. It is submitted again once they are.
+ * params:
+ * ch - pointer to raid bdev io channel
+ * bdev_io - pointer to parent bdev_io on raid bdev device
+ * returns:
+ * true if the I/O was queued
+ */
+static bool
+raid1_queue_if_loading(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+{
+	struct raid_bdev_io		*raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(ch);
+	struct raid1_channel		*r1ch = raid_ch->level_ctx;
+	struct raid_bdev		*raid_bdev = bdev_io->bdev->ctxt;
+	struct raid1_info		*raid1 = raid_bdev->level_ctx;
+
+	if (!__atomic_load_n(&raid1->loading, __ATOMIC_ACQUIRE)) {
+		return false;
+	}
+
+	raid_io->ch = ch;
+	TAILQ_INSERT_TAIL(&r1ch->waiting_ios, bdev_io, module_link);
+
+	return true;
+}
+
+/*
+ * brief:
+ * raid1_fanout_completion is the completion callback of the base bdev I/O of a
+ * write, unmap, flush or reset. The raid bdev I/O succeeds if any base bdev that
+ * was in sync when it was submitted completed it successfully.
+ * params:
+ * bdev_io - pointer to base bdev_io
+ * success - true if successful, false if unsuccessful
+ * cb_arg - callback argument (parent raid bdev_io)
+ * returns:
+ * none
+ */
+static void
+raid1_fanout_completion(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct spdk_bdev_io	*parent_io = cb_arg;
+	struct raid_bdev_io	*raid_io = (struct raid_bdev_io *)parent_io->driver_ctx;
+	struct raid_bdev	*raid_bdev = parent_io->bdev->ctxt;
+	uint8_t			slot;
+
+	slot = raid1_get_base_bdev_slot(raid_bdev, bdev_io->bdev);
+	spdk_bdev_free_io(bdev_io);
+
+	if (slot < raid_bdev->num_base_bdevs) {
+		if (success) {
+			raid_io->succeeded_slots |= 1ULL << slot;
+		} else if (raid1_write_tracked(parent_io)) {
+			raid1_base_bdev_failed(raid_bdev, slot);
+		}
+	}
+
+	raid_io->base_bdev_io_completed++;
+	if (raid_io->base_bdev_io_submitted == raid_bdev->num_base_bdevs &&
+	    raid_io->base_bdev_io_completed == raid_io->base_bdev_io_expected) {
+		raid1_fanout_complete(parent_io);
+	}
+}
+
+/*
+ * brief:
+ * _raid1_submit_fanout_request_next submits the I/O to the remaining base bdevs
+ * that are present on this channel. base_bdev_io_submitted is the next slot and
+ * base_bdev_io_expected the number of base bdev I/O submitted so far.
+ * params:
+ * _bdev_io - pointer to parent bdev_io on raid bdev device
+ * returns:
+ * none
+ */
+static void
+_raid1_submit_fanout_request_next(void *_bdev_io)
+{
+	struct spdk_bdev_io		*bdev_io = _bdev_io;
+	struct raid_bdev_io		*raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(raid_io->ch);
+	struct raid_bdev		*raid_bdev = bdev_io->bdev->ctxt;
+	struct spdk_bdev_desc		*desc;
+	struct spdk_io_channel		*base_ch;
+	uint8_t				i;
+	int				ret;
+
+	while (raid_io->base_bdev_io_submitted < raid_bdev->num_base_bdevs) {
+		i = raid_io->base_bdev_io_submitted;
+		desc = raid_bdev->base_bdev_info[i].desc;
+		base_ch = raid_ch->base_channel[i];
+		if (base_ch == NULL) {
+			raid_io->base_bdev_io_submitted++;
+			continue;
+		}
+
+		/* Set before submitting, the base bdev I/O may complete right away */
+		if (raid1_base_bdev_in_sync(raid_bdev, i)) {
+			raid_io->in_sync_slots |= 1ULL << i;
+		} else {
+			raid_io->in_sync_slots &= ~(1ULL << i);
+		}
+
+		switch (bdev_io->type) {
+		case SPDK_BDEV_IO_TYPE_WRITE:
+			ret = spdk_bdev_writev_blocks(desc, base_ch,
+						      bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt,
+						      bdev_io->u.bdev.offset_blocks, bdev_io->u.bdev.num_blocks,
+						      raid1_fanout_completion, bdev_io);
+			break;
+		case SPDK_BDEV_IO_TYPE_UNMAP:
+			ret = spdk_bdev_unmap_blocks(desc, base_ch,
+						     bdev_io->u.bdev.offset_blocks, bdev_io->u.bdev.num_blocks,
+						     raid1_fanout_completion, bdev_io);
+			break;
+		case SPDK_BDEV_IO_TYPE_FLUSH:
+			ret = spdk_bdev_flush_blocks(desc, base_ch,
+						     bdev_io->u.bdev.offset_blocks, bdev_io->u.bdev.num_blocks,
+						     raid1_fanout_completion, bdev_io);
+			break;
+		case SPDK_BDEV_IO_TYPE_RESET:
+			ret = spdk_bdev_reset(desc, base_ch, raid1_fanout_completion, bdev_io);
+			break;
+		default:
+			SPDK_ERRLOG("submit request, invalid io type %u\n", bdev_io->type);
+			assert(false);
+			ret = -EINVAL;
+			break;
+		}
+
+		if (ret == -ENOMEM) {
+			raid_bdev_base_io_submit_fail_process(bdev_io, i, _raid1_submit_fanout_request_next, ret);
+			return;
+		}
+
+		if (ret == 0) {
+			raid_io->base_bdev_io_expected++;
+		} else if (raid1_write_tracked(bdev_io)) {
+			raid1_base_bdev_failed(raid_bdev, i);
+		}
+		raid_io->base_bdev_io_submitted++;
+	}
+
+	if (raid_io->base_bdev_io_completed == raid_io->base_bdev_io_expected) {
+		raid1_fanout_complete(bdev_io);
+	}
+}
+
+/*
+ * brief:
+ * raid1_submit_fanout_request sends a write, unmap, flush or reset to every
+ * base bdev present on the channel.
+ * params:
+ * ch - pointer to raid bdev io channel
+ * bdev_io - pointer to parent bdev_io on raid bdev device
+ * returns:
+ * none
+ */
+static void
+raid1_submit_fanout_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+{
+	struct raid_bdev_io		*raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(ch);
+	struct raid_bdev		*raid_bdev = bdev_io->bdev->ctxt;
+	struct raid1_info		*raid1 = raid_bdev->level_ctx;
+
+	if (raid1_queue_if_loading(ch, bdev_io)) {
+		return;
+	}
+
+	raid_io->ch = ch;
+	raid_io->base_bdev_io_submitted = 0;
+	raid_io->base_bdev_io_completed = 0;
+	raid_io->base_bdev_io_expected = 0;
+	raid_io->base_bdev_io_status = SPDK_BDEV_IO_STATUS_FAILED;
+	raid_io->in_sync_slots = 0;
+	raid_io->succeeded_slots = 0;
+
+	if (raid1_write_tracked(bdev_io)) {
+		raid_io->write_epoch = raid1->write_epoch & 1;
+		raid_ch->writes_in_epoch[raid_io->write_epoch]++;
+	}
+
+	_raid1_submit_fanout_request_next(bdev_io);
+}
+
+/*
+ * brief:
+ * raid1_start_rw_request function is the submit_request function for
+ * read/write requests for raid1 bdevs.
+ * params:
+ * ch - pointer to raid bdev io channel
+ * bdev_io - pointer to parent bdev_io on raid bdev device
+ * returns:
+ * none
+ */
+static void
+raid1_start_rw_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+{
+	struct raid_bdev_io *raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+
+	if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ) {
+		if (raid1_queue_if_loading(ch, bdev_io)) {
+			return;
+		}
+		raid_io->ch = ch;
+		raid_io->base_bdev_io_completed = 0;
+		_raid1_submit_read_request(bdev_io);
+	} else {
+		raid1_submit_fanout_request(ch, bdev_io);
+	}
+}
+
+static void
+raid1_free(struct raid1_info *raid1)
+{
+	uint8_t i;
+
+	if (raid1->resync_ch != NULL) {
+		spdk_put_io_channel(raid1->resync_ch);
+	}
+	spdk_dma_free(raid1->resync_buf);
+
+	if (raid1->dirty_maps != NULL) {
+		for (i = 0; i < raid1->num_base_bdevs; i++) {
+			free(raid1->dirty_maps[i]);
+		}
+		free(raid1->dirty_maps);
+	}
+	free(raid1->left_events);
+	free(raid1->loaded_sbs);
+	free(raid1);
+}
+
+/* Frees the raid1 info of a destructed raid bdev once no I/O or message refers to it. */
+static void
+raid1_free_if_idle(struct raid1_info *raid1)
+{
+	if (raid1->stopped && !raid1->resync_io_pending &&
+	    __atomic_load_n(&raid1->sb_io_pending, __ATOMIC_SEQ_CST) == 0) {
+		raid1_free(raid1);
+	}
+}
+
+static void
+raid1_resync_stop(struct raid1_info *raid1)
+{
+	assert(!raid1->resync_io_pending);
+
+	spdk_poller_unregister(&raid1->resync_poller);
+	if (raid1->resync_ch != NULL) {
+		spdk_put_io_channel(raid1->resync_ch);
+		raid1->resync_ch = NULL;
+	}
+	spdk_dma_free(raid1->resync_buf);
+	raid1->resync_buf = NULL;
+	raid1->resync_state = RAID1_RESYNC_IDLE;
+}
+
+/* Put the regions of the current batch that weren't copied back into the dirty map. */
+static void
+raid1_resync_abort_batch(struct raid1_info *raid1)
+{
+	uint64_t	*map = raid1->dirty_maps[raid1->resync_slot];
+	uint32_t	i;
+
+	for (i = raid1->resync_batch_idx; i < raid1->resync_batch_count; i++) {
+		raid1_set_regions(map, raid1->resync_batch[i], raid1->resync_batch[i]);
+	}
+	raid1->resync_batch_count = 0;
+	raid1->resync_batch_idx = 0;
+}
+
+/* Returns false if the resync I/O completed after the raid bdev was destructed. */
+static bool
+raid1_resync_io_done(struct raid1_info *raid1)
+{
+	raid1->resync_io_pending = false;
+
+	if (raid1->stopped) {
+		raid1_free_if_idle(raid1);
+		return false;
+	}
+
+	return true;
+}
+
+static void
+raid1_resync_write_completion(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct raid1_info *raid1 = cb_arg;
+
+	spdk_bdev_free_io(bdev_io);
+
+	if (!raid1_resync_io_done(raid1)) {
+		return;
+	}
+
+	if (!success) {
+		SPDK_ERRLOG("Resync of base bdev %u of raid bdev %s failed to write\n",
+			    raid1->resync_slot, raid1->raid_bdev->bdev.name);
+		raid1_resync_abort_batch(raid1);
+		raid1_resync_stop(raid1);
+		return;
+	}
+
+	raid1->resync_batch_idx++;
+}
+
+static void
+raid1_resync_read_completion(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct raid1_info		*raid1 = cb_arg;
+	struct raid_bdev		*raid_bdev = raid1->raid_bdev;
+	struct raid_bdev_io_channel	*raid_ch;
+	uint64_t			num_blocks;
+	int				rc;
+
+	num_blocks = bdev_io->u.bdev.num_blocks;
+	spdk_bdev_free_io(bdev_io);
+
+	if (!raid1_resync_io_done(raid1)) {
+		return;
+	}
+
+	if (!success) {
+		SPDK_ERRLOG("Resync of base bdev %u of raid bdev %s failed to read\n",
+			    raid1->resync_slot, raid_bdev->bdev.name);
+		raid1_resync_abort_batch(raid1);
+		raid1_resync_stop(raid1);
+		return;
+	}
+
+	raid_ch = spdk_io_channel_get_ctx(raid1->resync_ch);
+	if (raid_ch->base_channel[raid1->resync_slot] == NULL) {
+		/* The base bdev went away, the poller will notice it. */
+		return;
+	}
+
+	raid1->resync_io_pending = true;
+	rc = spdk_bdev_write_blocks(raid_bdev->base_bdev_info[raid1->resync_slot].desc,
+				    raid_ch->base_channel[raid1->resync_slot], raid1->resync_buf,
+				    raid1->resync_batch[raid1->resync_batch_idx] << raid_bdev->strip_size_shift,
+				    num_blocks, raid1_resync_write_completion, raid1);
+	if (rc != 0) {
+		/* Read the region again on the next poll. */
+		raid1->resync_io_pending = false;
+	}
+}
+
+/*
+ * brief:
+ * raid1_resync_copy_region copies the next region of the batch from the source
+ * to the base bdev being resynced.
+ * params:
+ * raid1 - pointer to raid1 info
+ * returns:
+ * none
+ */
+static void
+raid1_resync_copy_region(struct raid1_info *raid1)
+{
+	struct raid_bdev		*raid_bdev = raid1->raid_bdev;
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(raid1->resync_ch);
+	uint64_t			offset_blocks, num_blocks;
+	int				rc;
+
+	if (raid1->resync_batch_idx == raid1->resync_batch_count) {
+		raid1->resync_batch_count = 0;
+		raid1->resync_batch_idx = 0;
+		raid1->resync_state = RAID1_RESYNC_SCAN;
+		return;
+	}
+
+	if (!raid1_base_bdev_in_sync(raid_bdev, raid1->resync_src) ||
+	    raid_ch->base_channel[raid1->resync_src] == NULL ||
+	    raid_ch->base_channel[raid1->resync_slot] == NULL) {
+		raid1_resync_abort_batch(raid1);
+		raid1->resync_state = RAID1_RESYNC_IDLE;
+		return;
+	}
+
+	offset_blocks = raid1->resync_batch[raid1->resync_batch_idx] << raid_bdev->strip_size_shift;
+	num_blocks = spdk_min(raid_bdev->strip_size, raid_bdev->bdev.blockcnt - offset_blocks);
+
+	raid1->resync_io_pending = true;
+	rc = spdk_bdev_read_blocks(raid_bdev->base_bdev_info[raid1->resync_src].desc,
+				   raid_ch->base_channel[raid1->resync_src], raid1->resync_buf,
+				   offset_blocks, num_blocks, raid1_resync_read_completion, raid1);
+	if (rc != 0) {
+		/* Retry on the next poll. */
+		raid1->resync_io_pending = false;
+	}
+}
+
+static void
+raid1_resync_drain_channel(struct spdk_io_channel_iter *i)
+{
+	struct raid1_info		*raid1 = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel		*ch = spdk_io_channel_iter_get_channel(i);
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(ch);
+	uint32_t			prev_epoch = (raid1->write_epoch - 1) & 1;
+
+	spdk_for_each_channel_continue(i, raid_ch->writes_in_epoch[prev_epoch] ? -EAGAIN : 0);
+}
+
+static void
+raid1_resync_drain_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct raid1_info *raid1 = spdk_io_channel_iter_get_ctx(i);
+
+	if (!raid1_resync_io_done(raid1)) {
+		return;
+	}
+
+	if (status != 0) {
+		/* Writes of the previous epoch are still outstanding, check again on the next poll. */
+		return;
+	}
+
+	raid1->resync_state = raid1->resync_batch_count > 0 ? RAID1_RESYNC_COPY : RAID1_RESYNC_FINISH;
+}
+
+/*
+ * brief:
+ * raid1_resync_scan clears up to RAID1_RESYNC_BATCH dirty regions of the base
+ * bdev being resynced, starting at the cursor, and flips the write epoch.
+ * params:
+ * raid1 - pointer to raid1 info
+ * returns:
+ * none
+ */
+static void
+raid1_resync_scan(struct raid1_info *raid1)
+{
+	uint64_t	*map = raid1->dirty_maps[raid1->resync_slot];
+	uint64_t	word, bit;
+
+	while (raid1->resync_cursor < raid1->map_words &&
+	       raid1->resync_batch_count < RAID1_RESYNC_BATCH) {
+		word = __atomic_load_n(&map[raid1->resync_cursor], __ATOMIC_RELAXED);
+		if (word == 0) {
+			raid1->resync_cursor++;
+			continue;
+		}
+
+		bit = __builtin_ctzll(word);
+		__atomic_fetch_and(&map[raid1->resync_cursor], ~(1ULL << bit), __ATOMIC_RELAXED);
+		raid1->resync_batch[raid1->resync_batch_count++] = raid1->resync_cursor * 64 + bit;
+	}
+
+	raid1->write_epoch++;
+	raid1->resync_state = RAID1_RESYNC_DRAIN;
+}
+
+static bool
+raid1_map_empty(struct raid1_info *raid1, uint8_t slot)
+{
+	uint64_t i;
+
+	for (i = 0; i < raid1->map_words; i++) {
+		if (__atomic_load_n(&raid1->dirty_maps[slot][i], __ATOMIC_RELAXED) != 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * brief:
+ * raid1_resync_pick picks the next base bdev to resync and an in-sync base bdev
+ * to copy from.
+ * params:
+ * raid1 - pointer to raid1 info
+ * returns:
+ * true if there is a base bdev to resync
+ */
+static bool
+raid1_resync_pick(struct raid1_info *raid1)
+{
+	struct raid_bdev		*raid_bdev = raid1->raid_bdev;
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(raid1->resync_ch);
+	struct raid_base_bdev_info	*info;
+	uint8_t				i, slot = UINT8_MAX, src = UINT8_MAX;
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		info = &raid_bdev->base_bdev_info[i];
+		if (raid_ch->base_channel[i] == NULL) {
+			continue;
+		}
+
+		if (raid1_base_bdev_in_sync(raid_bdev, i)) {
+			if (src == UINT8_MAX) {
+				src = i;
+			}
+		} else if (info->bdev != NULL && info->resyncing && !info->remove_scheduled &&
+			   slot == UINT8_MAX) {
+			slot = i;
+		}
+	}
+
+	if (slot == UINT8_MAX || src == UINT8_MAX) {
+		return false;
+	}
+
+	raid1->resync_slot = slot;
+	raid1->resync_src = src;
+	raid1->resync_cursor = 0;
+	raid1->resync_batch_count = 0;
+	raid1->resync_batch_idx = 0;
+
+	return true;
+}
+
+static int
+raid1_resync_poll(void *arg)
+{
+	struct raid1_info	*raid1 = arg;
+	struct raid_bdev	*raid_bdev = raid1->raid_bdev;
+
+	if (raid1->resync_io_pending) {
+		return 0;
+	}
+
+	if (raid1->resync_state != RAID1_RESYNC_IDLE &&
+	    raid_bdev->base_bdev_info[raid1->resync_slot].bdev == NULL) {
+		/* The base bdev went away again, its dirty map is kept for when it returns. */
+		raid1_resync_abort_batch(raid1);
+		raid1->resync_state = RAID1_RESYNC_IDLE;
+	}
+
+	switch (raid1->resync_state) {
+	case RAID1_RESYNC_IDLE:
+		if (!raid1_resync_pick(raid1)) {
+			raid1_resync_stop(raid1);
+			return 0;
+		}
+		SPDK_NOTICELOG("Resyncing base bdev %s of raid bdev %s\n",
+			       raid_bdev->base_bdev_info[raid1->resync_slot].bdev->name,
+			       raid_bdev->bdev.name);
+		raid1->resync_state = RAID1_RESYNC_SCAN;
+		break;
+	case RAID1_RESYNC_SCAN:
+		raid1_resync_scan(raid1);
+		break;
+	case RAID1_RESYNC_DRAIN:
+		raid1->resync_io_pending = true;
+		spdk_for_each_channel(raid_bdev, raid1_resync_drain_channel, raid1,
+				      raid1_resync_drain_done);
+		break;
+	case RAID1_RESYNC_COPY:
+		raid1_resync_copy_region(raid1);
+		break;
+	case RAID1_RESYNC_FINISH:
+		if (raid1->resync_cursor < raid1->map_words || !raid1_map_empty(raid1, raid1->resync_slot)) {
+			/* Regions written during the last pass need another one. */
+			raid1->resync_cursor = 0;
+			raid1->resync_state = RAID1_RESYNC_SCAN;
+			break;
+		}
+		SPDK_NOTICELOG("Base bdev %s of raid bdev %s is in sync\n",
+			       raid_bdev->base_bdev_info[raid1->resync_slot].bdev->name,
+			       raid_bdev->bdev.name);
+		raid_bdev->base_bdev_info[raid1->resync_slot].resyncing = false;
+		raid1->left_slots &= ~(1ULL << raid1->resync_slot);
+		raid1->resync_state = RAID1_RESYNC_IDLE;
+		raid1_sb_update(raid1);
+		break;
+	}
+
+	return 1;
+}
+
+/*
+ * brief:
+ * raid1_resync_start starts the resync poller if it isn't running yet. It
+ * stops by itself once no base bdev needs a resync.
+ * params:
+ * raid1 - pointer to raid1 info
+ * returns:
+ * none
+ */
+static void
+raid1_resync_start(struct raid1_info *raid1)
+{
+	struct raid_bdev *raid_bdev = raid1->raid_bdev;
+
+	if (raid1->resync_poller != NULL || raid1->stopped) {
+		return;
+	}
+
+	raid1->resync_ch = spdk_get_io_channel(raid_bdev);
+	if (raid1->resync_ch == NULL) {
+		SPDK_ERRLOG("Unable to get io channel for resync of raid bdev %s\n", raid_bdev->bdev.name);
+		return;
+	}
+
+	raid1->resync_buf = spdk_dma_malloc(raid_bdev->strip_size * raid_bdev->bdev.blocklen, 0x1000,
+					    NULL);
+	if (raid1->resync_buf == NULL) {
+		SPDK_ERRLOG("Unable to allocate resync buffer for raid bdev %s\n", raid_bdev->bdev.name);
+		spdk_put_io_channel(raid1->resync_ch);
+		raid1->resync_ch = NULL;
+		return;
+	}
+
+	raid1->resync_state = RAID1_RESYNC_IDLE;
+	raid1->resync_poller = SPDK_POLLER_REGISTER(raid1_resync_poll, raid1, 0);
+}
+
+static int
+raid1_resync_check(void *arg)
+{
+	struct raid1_info	*raid1 = arg;
+	struct raid_bdev	*raid_bdev = raid1->raid_bdev;
+	uint8_t			i;
+
+	if (raid1->resync_poller != NULL) {
+		return 0;
+	}
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		if (raid_bdev->base_bdev_info[i].bdev != NULL &&
+		    raid_bdev->base_bdev_info[i].resyncing) {
+			raid1_resync_start(raid1);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void
+raid1_set_all_regions(struct raid1_info *raid1, uint8_t slot)
+{
+	uint64_t *map = raid1->dirty_maps[slot];
+	uint64_t last = raid1->num_regions % 64;
+	uint64_t i;
+
+	for (i = 0; i < raid1->map_words; i++) {
+		__atomic_store_n(&map[i], UINT64_MAX, __ATOMIC_RELAXED);
+	}
+	if (last != 0) {
+		__atomic_store_n(&map[raid1->map_words - 1], (1ULL << last) - 1, __ATOMIC_RELAXED);
+	}
+}
+
+static void
+raid1_sb_init(struct raid1_info *raid1, struct raid1_sb *sb)
+{
+	memcpy(sb->magic, RAID1_SB_MAGIC, sizeof(sb->magic));
+	sb->version = RAID1_SB_VERSION;
+	spdk_uuid_copy(&sb->uuid, &raid1->uuid);
+	sb->events = raid1->events;
+	sb->crc = 0;
+	sb->crc = spdk_crc32c_update(sb, sizeof(*sb), ~0);
+}
+
+static bool
+raid1_sb_valid(struct raid1_sb *sb)
+{
+	uint32_t	crc = sb->crc;
+	bool		valid;
+
+	if (memcmp(sb->magic, RAID1_SB_MAGIC, sizeof(sb->magic)) != 0 ||
+	    sb->version != RAID1_SB_VERSION) {
+		return false;
+	}
+
+	sb->crc = 0;
+	valid = spdk_crc32c_update(sb, sizeof(*sb), ~0) == crc;
+	sb->crc = crc;
+
+	return valid;
+}
+
+/* Drops a reference taken for superblock I/O, a message or a channel iteration. */
+static void
+raid1_sb_io_put(struct raid1_info *raid1)
+{
+	if (__atomic_sub_fetch(&raid1->sb_io_pending, 1, __ATOMIC_SEQ_CST) == 0) {
+		raid1_free_if_idle(raid1);
+	}
+}
+
+static void
+raid1_sb_io_completion(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct raid1_sb_io	*sb_io = cb_arg;
+	struct raid1_info	*raid1 = sb_io->raid1;
+
+	spdk_bdev_free_io(bdev_io);
+	spdk_put_io_channel(sb_io->ch);
+
+	if (!raid1->stopped) {
+		sb_io->done(sb_io, success);
+	}
+
+	spdk_dma_free(sb_io->sb);
+	free(sb_io);
+	raid1_sb_io_put(raid1);
+}
+
+/*
+ * brief:
+ * raid1_sb_io reads or writes the superblock in the last block of a base bdev.
+ * params:
+ * raid1 - pointer to raid1 info
+ * slot - base bdev slot
+ * write - true to write the superblock of the raid bdev, false to read it
+ * done - called when the I/O completed, unless the raid bdev was destructed
+ * returns:
+ * 0 - success
+ * non zero - failure, done is not called
+ */
+static int
+raid1_sb_io(struct raid1_info *raid1, uint8_t slot, bool write,
+	    void (*done)(struct raid1_sb_io *sb_io, bool success))
+{
+	struct raid_base_bdev_info	*info = &raid1->raid_bdev->base_bdev_info[slot];
+	uint64_t			offset_blocks = info->bdev->blockcnt - 1;
+	struct raid1_sb_io		*sb_io;
+	int				rc;
+
+	sb_io = calloc(1, sizeof(*sb_io));
+	if (sb_io == NULL) {
+		return -ENOMEM;
+	}
+
+	sb_io->raid1 = raid1;
+	sb_io->slot = slot;
+	sb_io->desc = info->desc;
+	sb_io->done = done;
+	sb_io->sb = spdk_dma_zmalloc(info->bdev->blocklen, 0x1000, NULL);
+	sb_io->ch = spdk_bdev_get_io_channel(info->desc);
+	if (sb_io->sb == NULL || sb_io->ch == NULL) {
+		rc = -ENOMEM;
+		goto err;
+	}
+
+	__atomic_fetch_add(&raid1->sb_io_pending, 1, __ATOMIC_SEQ_CST);
+	if (write) {
+		raid1_sb_init(raid1, sb_io->sb);
+		rc = spdk_bdev_write_blocks(info->desc, sb_io->ch, sb_io->sb, offset_blocks, 1,
+					    raid1_sb_io_completion, sb_io);
+	} else {
+		rc = spdk_bdev_read_blocks(info->desc, sb_io->ch, sb_io->sb, offset_blocks, 1,
+					   raid1_sb_io_completion, sb_io);
+	}
+	if (rc == 0) {
+		return 0;
+	}
+	__atomic_fetch_sub(&raid1->sb_io_pending, 1, __ATOMIC_SEQ_CST);
+
+err:
+	if (sb_io->ch != NULL) {
+		spdk_put_io_channel(sb_io->ch);
+	}
+	spdk_dma_free(sb_io->sb);
+	free(sb_io);
+
+	return rc;
+}
+
+/*
+ * brief:
+ * raid1_release_channel acks the held writes of a channel that no longer miss
+ * a base bdev the superblocks list in sync, and submits the I/O queued while the
+ * raid bdev was loading.
+ * params:
+ * i - pointer to io channel iterator
+ * returns:
+ * none
+ */
+static void
+raid1_release_channel(struct spdk_io_channel_iter *i)
+{
+	struct raid1_info		*raid1 = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel		*ch = spdk_io_channel_iter_get_channel(i);
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(ch);
+	struct raid1_channel		*r1ch = raid_ch->level_ctx;
+	struct spdk_bdev_io		*bdev_io, *tmp;
+	struct raid_bdev_io		*raid_io;
+	uint64_t			sb_slots;
+
+	sb_slots = __atomic_load_n(&raid1->sb_slots, __ATOMIC_SEQ_CST);
+
+	TAILQ_FOREACH_SAFE(bdev_io, &r1ch->held_ios, module_link, tmp) {
+		raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+		if ((raid_io->held_slots & sb_slots) == 0) {
+			TAILQ_REMOVE(&r1ch->held_ios, bdev_io, module_link);
+			spdk_bdev_io_complete(bdev_io, raid_io->base_bdev_io_status);
+		}
+	}
+
+	if (!__atomic_load_n(&raid1->loading, __ATOMIC_ACQUIRE)) {
+		while ((bdev_io = TAILQ_FIRST(&r1ch->waiting_ios)) != NULL) {
+			TAILQ_REMOVE(&r1ch->waiting_ios, bdev_io, module_link);
+			if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ ||
+			    bdev_io->type == SPDK_BDEV_IO_TYPE_WRITE) {
+				raid1_start_rw_request(ch, bdev_io);
+			} else {
+				raid1_submit_fanout_request(ch, bdev_io);
+			}
+		}
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+raid1_release_done(struct spdk_io_channel_iter *i, int status)
+{
+	raid1_sb_io_put(spdk_io_channel_iter_get_ctx(i));
+}
+
+static void raid1_sb_write_round(struct raid1_info *raid1);
+
+/* Drops a superblock write of the round, or the reference of the round itself. */
+static void
+raid1_sb_write_put(struct raid1_info *raid1)
+{
+	if (--raid1->sb_writes > 0) {
+		return;
+	}
+
+	raid1->sb_writing = false;
+	__atomic_store_n(&raid1->sb_slots, raid1->sb_round_slots, __ATOMIC_SEQ_CST);
+
+	if (raid1->sb_again) {
+		raid1->sb_again = false;
+		raid1_sb_write_round(raid1);
+		return;
+	}
+
+	__atomic_store_n(&raid1->loading, false, __ATOMIC_RELEASE);
+	__atomic_fetch_add(&raid1->sb_io_pending, 1, __ATOMIC_SEQ_CST);
+	spdk_for_each_channel(raid1->raid_bdev, raid1_release_channel, raid1, raid1_release_done);
+}
+
+static void
+raid1_sb_write_done(struct raid1_sb_io *sb_io, bool success)
+{
+	struct raid1_info	*raid1 = sb_io->raid1;
+	struct raid_bdev	*raid_bdev = raid1->raid_bdev;
+
+	if (!success) {
+		SPDK_ERRLOG("Unable to write the superblock of base bdev %u of raid bdev %s\n",
+			    sb_io->slot, raid_bdev->bdev.name);
+		raid1_base_bdev_failed(raid_bdev, sb_io->slot);
+	}
+
+	raid1_sb_write_put(raid1);
+}
+
+/*
+ * brief:
+ * raid1_sb_write_round bumps the event counter and writes it to the superblocks
+ * of the base bdevs in sync. Base bdevs that went out of sync since the last
+ * round keep the event counter they have on disk, so that they can be resynced
+ * from their dirty map when they come back. Only one round is written at a time.
+ * params:
+ * raid1 - pointer to raid1 info
+ * returns:
+ * none
+ */
+static void
+raid1_sb_write_round(struct raid1_info *raid1)
+{
+	struct raid_bdev	*raid_bdev = raid1->raid_bdev;
+	uint8_t			i;
+
+	if (raid1->sb_writing) {
+		raid1->sb_again = true;
+		return;
+	}
+
+	raid1->sb_writing = true;
+	raid1->events++;
+	raid1->sb_round_slots = 0;
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		if (raid1_base_bdev_in_sync(raid_bdev, i)) {
+			raid1->sb_round_slots |= 1ULL << i;
+		} else if (raid1->sb_slots & (1ULL << i)) {
+			raid1->left_events[i] = raid1->events - 1;
+			raid1->left_slots |= 1ULL << i;
+		}
+	}
+
+	raid1->sb_writes = 1;
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		if (!(raid1->sb_round_slots & (1ULL << i))) {
+			continue;
+		}
+
+		/* Counted first, the write may complete right away */
+		raid1->sb_writes++;
+		if (raid1_sb_io(raid1, i, true, raid1_sb_write_done) != 0) {
+			raid1->sb_writes--;
+			SPDK_ERRLOG("Unable to write the superblock of base bdev %s\n",
+				    raid_bdev->base_bdev_info[i].bdev->name);
+			raid1_base_bdev_failed(raid_bdev, i);
+		}
+	}
+	raid1_sb_write_put(raid1);
+}
+
+static void
+raid1_sb_update_msg(void *ctx)
+{
+	struct raid1_info *raid1 = ctx;
+
+	if (!raid1->stopped) {
+		raid1_sb_write_round(raid1);
+	}
+	raid1_sb_io_put(raid1);
+}
+
+/*
+ * brief:
+ * raid1_sb_update writes a new round of superblocks after the set of base bdevs
+ * in sync changed. It may be called on any thread, the superblocks are written
+ * on the thread the raid bdev was started on.
+ * params:
+ * raid1 - pointer to raid1 info
+ * returns:
+ * none
+ */
+static void
+raid1_sb_update(struct raid1_info *raid1)
+{
+	__atomic_fetch_add(&raid1->sb_io_pending, 1, __ATOMIC_SEQ_CST);
+	spdk_thread_send_msg(raid1->thread, raid1_sb_update_msg, raid1);
+}
+
+/*
+ * brief:
+ * raid1_sb_load_finish picks the superblock with the highest event counter. The
+ * base bdevs holding it are in sync, the ones with an older counter or without
+ * a superblock are resynced in full and the ones of another raid bdev are not
+ * used. Without any superblock, the raid bdev is new and gets a new UUID.
+ * params:
+ * raid1 - pointer to raid1 info
+ * returns:
+ * none
+ */
+static void
+raid1_sb_load_finish(struct raid1_info *raid1)
+{
+	struct raid_bdev	*raid_bdev = raid1->raid_bdev;
+	struct raid1_sb		*sb, *best = NULL;
+	const char		*name;
+	uint8_t			i;
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		sb = &raid1->loaded_sbs[i];
+		if (!(raid1->loaded_valid & (1ULL << i))) {
+			continue;
+		}
+		if (best == NULL || sb->events > best->events) {
+			best = sb;
+		}
+	}
+
+	if (best == NULL) {
+		SPDK_NOTICELOG("No superblock found on the base bdevs of raid bdev %s\n",
+			       raid_bdev->bdev.name);
+		spdk_uuid_generate(&raid1->uuid);
+		raid1->events = 0;
+		goto write;
+	}
+
+	spdk_uuid_copy(&raid1->uuid, &best->uuid);
+	raid1->events = best->events;
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		sb = &raid1->loaded_sbs[i];
+		name = raid_bdev->base_bdev_info[i].bdev->name;
+		if (!(raid1->loaded_valid & (1ULL << i))) {
+			SPDK_NOTICELOG("Base bdev %s has no superblock, resyncing it\n", name);
+		} else if (spdk_uuid_compare(&sb->uuid, &raid1->uuid) != 0) {
+			SPDK_ERRLOG("Base bdev %s belongs to another raid bdev, not using it\n",
+				    name);
+			raid1_detach_base_bdev(raid_bdev, i);
+			continue;
+		} else if (sb->events != raid1->events) {
+			SPDK_NOTICELOG("Base bdev %s is stale, resyncing it\n", name);
+		} else {
+			continue;
+		}
+		raid1_set_all_regions(raid1, i);
+		raid_bdev->base_bdev_info[i].resyncing = true;
+	}
+
+write:
+	free(raid1->loaded_sbs);
+	raid1->loaded_sbs = NULL;
+	raid1->sb_writing = false;
+	raid1_sb_write_round(raid1);
+}
+
+static void
+raid1_sb_load_put(struct raid1_info *raid1)
+{
+	if (--raid1->load_remaining == 0) {
+		raid1_sb_load_finish(raid1);
+	}
+}
+
+static void
+raid1_sb_load_done(struct raid1_sb_io *sb_io, bool success)
+{
+	struct raid1_info *raid1 = sb_io->raid1;
+
+	if (success && raid1_sb_valid(sb_io->sb)) {
+		raid1->loaded_sbs[sb_io->slot] = *sb_io->sb;
+		raid1->loaded_valid |= 1ULL << sb_io->slot;
+	}
+
+	raid1_sb_load_put(raid1);
+}
+
+/* Reads the superblocks of all base bdevs, with I/O queued until they are written back. */
+static void
+raid1_sb_load(void *ctx)
+{
+	struct raid1_info	*raid1 = ctx;
+	struct raid_bdev	*raid_bdev = raid1->raid_bdev;
+	uint8_t			i;
+
+	if (raid1->stopped) {
+		raid1_sb_io_put(raid1);
+		return;
+	}
+
+	raid1->load_remaining = 1;
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		raid1->load_remaining++;
+		if (raid1_sb_io(raid1, i, false, raid1_sb_load_done) != 0) {
+			raid1->load_remaining--;
+		}
+	}
+	raid1_sb_load_put(raid1);
+	raid1_sb_io_put(raid1);
+}
+
+/*
+ * brief:
+ * raid1_start allocates the dirty maps of a raid1 bdev and reads the superblocks
+ * of its base bdevs. The raid bdev is as large as its smallest base bdev without
+ * the superblock block and I/O is not split.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * returns:
+ * 0 - success
+ * non zero - failure
+ */
+static int
+raid1_start(struct raid_bdev *raid_bdev)
+{
+	struct raid1_info	*raid1;
+	uint64_t		min_blockcnt = UINT64_MAX;
+	uint8_t			i;
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		min_blockcnt = spdk_min(min_blockcnt, raid_bdev->base_bdev_info[i].bdev->blockcnt);
+	}
+
+	if (min_blockcnt < 2) {
+		SPDK_ERRLOG("Base bdevs of raid bdev %s are too small\n", raid_bdev->bdev.name);
+		return -EINVAL;
+	}
+
+	/* The last block holds the superblock */
+	min_blockcnt--;
+	raid_bdev->bdev.blockcnt = min_blockcnt;
+	raid_bdev->bdev.optimal_io_boundary = 0;
+	raid_bdev->bdev.split_on_optimal_io_boundary = false;
+
+	raid1 = calloc(1, sizeof(*raid1));
+	if (raid1 == NULL) {
+		SPDK_ERRLOG("Unable to allocate raid1 info\n");
+		return -ENOMEM;
+	}
+
+	raid1->raid_bdev = raid_bdev;
+	raid1->num_base_bdevs = raid_bdev->num_base_bdevs;
+	raid1->num_regions = spdk_divide_round_up(min_blockcnt, raid_bdev->strip_size);
+	raid1->map_words = spdk_divide_round_up(raid1->num_regions, 64);
+	raid1->dirty_maps = calloc(raid_bdev->num_base_bdevs, sizeof(uint64_t *));
+	raid1->left_events = calloc(raid_bdev->num_base_bdevs, sizeof(uint64_t));
+	raid1->loaded_sbs = calloc(raid_bdev->num_base_bdevs, sizeof(struct raid1_sb));
+	if (raid1->dirty_maps == NULL || raid1->left_events == NULL || raid1->loaded_sbs == NULL) {
+		SPDK_ERRLOG("Unable to allocate dirty maps\n");
+		raid1_free(raid1);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		raid1->dirty_maps[i] = calloc(raid1->map_words, sizeof(uint64_t));
+		if (raid1->dirty_maps[i] == NULL) {
+			SPDK_ERRLOG("Unable to allocate dirty maps\n");
+			raid1_free(raid1);
+			return -ENOMEM;
+		}
+	}
+
+	raid1->check_poller = SPDK_POLLER_REGISTER(raid1_resync_check, raid1, RAID1_RESYNC_CHECK_US);
+	raid_bdev->level_ctx = raid1;
+
+	/* Read the superblocks once the raid bdev io device is registered */
+	raid1->thread = spdk_get_thread();
+	raid1->loading = true;
+	raid1->sb_writing = true;
+	raid1->sb_io_pending = 1;
+	spdk_thread_send_msg(raid1->thread, raid1_sb_load, raid1);
+
+	return 0;
+}
+
+static void
+raid1_stop(struct raid_bdev *raid_bdev)
+{
+	struct raid1_info *raid1 = raid_bdev->level_ctx;
+
+	if (raid1 == NULL) {
+		return;
+	}
+
+	raid_bdev->level_ctx = NULL;
+	spdk_poller_unregister(&raid1->check_poller);
+	spdk_poller_unregister(&raid1->resync_poller);
+
+	/* Freed once the resync and superblock I/O completes, the raid bdev may be gone by then. */
+	raid1->stopped = true;
+	raid1_free_if_idle(raid1);
+}
+
+static void
+raid1_put_slot_channel(struct spdk_io_channel_iter *i)
+{
+	struct raid1_slot_ctx		*ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel		*ch = spdk_io_channel_iter_get_channel(i);
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(ch);
+
+	if (raid_ch->base_channel[ctx->slot] != NULL) {
+		spdk_put_io_channel(raid_ch->base_channel[ctx->slot]);
+		raid_ch->base_channel[ctx->slot] = NULL;
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+raid1_detach_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct raid1_slot_ctx		*ctx = spdk_io_channel_iter_get_ctx(i);
+	struct raid_bdev		*raid_bdev = ctx->raid_bdev;
+	struct raid_base_bdev_info	*info = &raid_bdev->base_bdev_info[ctx->slot];
+
+	if (info->bdev != NULL) {
+		raid_bdev_free_base_bdev_resource(raid_bdev, ctx->slot);
+	}
+	info->remove_scheduled = false;
+	info->resyncing = true;
+
+	free(ctx);
+}
+
+/*
+ * brief:
+ * raid1_detach_base_bdev releases the channels of a base bdev on all raid bdev
+ * channels and then closes it. Its dirty map keeps tracking writes.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * slot - base bdev slot
+ * returns:
+ * none
+ */
+static void
+raid1_detach_base_bdev(struct raid_bdev *raid_bdev, uint8_t slot)
+{
+	struct raid1_slot_ctx *ctx;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		SPDK_ERRLOG("Unable to allocate memory to detach base bdev\n");
+		return;
+	}
+
+	ctx->raid_bdev = raid_bdev;
+	ctx->slot = slot;
+	raid_bdev->base_bdev_info[slot].remove_scheduled = true;
+	spdk_for_each_channel(raid_bdev, raid1_put_slot_channel, ctx, raid1_detach_done);
+}
+
+static int
+raid1_remove_base_bdev(struct raid_bdev *raid_bdev, uint8_t slot)
+{
+	uint8_t i;
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		if (i != slot && raid1_base_bdev_in_sync(raid_bdev, i)) {
+			break;
+		}
+	}
+
+	if (i == raid_bdev->num_base_bdevs) {
+		return -ENODEV;
+	}
+
+	SPDK_ERRLOG("Base bdev %s removed, raid bdev %s is degraded\n",
+		    raid_bdev->base_bdev_info[slot].bdev->name, raid_bdev->bdev.name);
+	raid1_detach_base_bdev(raid_bdev, slot);
+	raid1_sb_update(raid_bdev->level_ctx);
+
+	return 0;
+}
+
+static void
+raid1_get_slot_channel(struct spdk_io_channel_iter *i)
+{
+	struct raid1_slot_ctx		*ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel		*ch = spdk_io_channel_iter_get_channel(i);
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(ch);
+	struct raid_bdev		*raid_bdev = ctx->raid_bdev;
+
+	assert(raid_ch->base_channel[ctx->slot] == NULL);
+	raid_ch->base_channel[ctx->slot] =
+		spdk_bdev_get_io_channel(raid_bdev->base_bdev_info[ctx->slot].desc);
+
+	spdk_for_each_channel_continue(i, raid_ch->base_channel[ctx->slot] ? 0 : -ENOMEM);
+}
+
+static void
+raid1_attach_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct raid1_slot_ctx	*ctx = spdk_io_channel_iter_get_ctx(i);
+	struct raid_bdev	*raid_bdev = ctx->raid_bdev;
+	uint8_t			slot = ctx->slot;
+
+	free(ctx);
+
+	if (status != 0) {
+		/* Writes on some channels would skip it, so it can't be resynced. */
+		SPDK_ERRLOG("Unable to get io channels for base bdev %s\n",
+			    raid_bdev->base_bdev_info[slot].bdev->name);
+		raid1_detach_base_bdev(raid_bdev, slot);
+		return;
+	}
+
+	if (raid_bdev->level_ctx != NULL) {
+		raid1_resync_start(raid_bdev->level_ctx);
+	}
+}
+
+/*
+ * brief:
+ * raid1_add_sb_read_done checks the superblock of a base bdev that came back.
+ * It is resynced from its dirty map if the superblock holds the event counter
+ * it had when it went out of sync, in full if not, and not used at all if it
+ * can't be read or belongs to another raid bdev. It then gets the writes.
+ * params:
+ * sb_io - pointer to superblock I/O
+ * success - true if the superblock was read
+ * returns:
+ * none
+ */
+static void
+raid1_add_sb_read_done(struct raid1_sb_io *sb_io, bool success)
+{
+	struct raid1_info		*raid1 = sb_io->raid1;
+	struct raid_bdev		*raid_bdev = raid1->raid_bdev;
+	struct raid_base_bdev_info	*info = &raid_bdev->base_bdev_info[sb_io->slot];
+	struct raid1_sb			*sb = sb_io->sb;
+	struct raid1_slot_ctx		*ctx;
+
+	if (info->desc != sb_io->desc || info->remove_scheduled) {
+		/* It went away again */
+		return;
+	}
+
+	if (!success) {
+		SPDK_ERRLOG("Unable to read the superblock of base bdev %s, not using it\n",
+			    info->bdev->name);
+		raid_bdev_free_base_bdev_resource(raid_bdev, sb_io->slot);
+		return;
+	}
+
+	if (raid1_sb_valid(sb) && spdk_uuid_compare(&sb->uuid, &raid1->uuid) != 0) {
+		SPDK_ERRLOG("Base bdev %s belongs to another raid bdev, not using it\n",
+			    info->bdev->name);
+		raid_bdev_free_base_bdev_resource(raid_bdev, sb_io->slot);
+		return;
+	}
+
+	if (!raid1_sb_valid(sb) || !(raid1->left_slots & (1ULL << sb_io->slot)) ||
+	    sb->events != raid1->left_events[sb_io->slot]) {
+		SPDK_NOTICELOG("Base bdev %s changed while it was away, resyncing it\n",
+			       info->bdev->name);
+		raid1_set_all_regions(raid1, sb_io->slot);
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		SPDK_ERRLOG("Unable to allocate memory to attach base bdev\n");
+		raid_bdev_free_base_bdev_resource(raid_bdev, sb_io->slot);
+		return;
+	}
+
+	ctx->raid_bdev = raid_bdev;
+	ctx->slot = sb_io->slot;
+	spdk_for_each_channel(raid_bdev, raid1_get_slot_channel, ctx, raid1_attach_done);
+}
+
+/*
+ * brief:
+ * raid1_add_base_bdev attaches a base bdev that came back to an online raid1
+ * bdev, once its superblock was checked.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * slot - base bdev slot
+ * returns:
+ * 0 - success
+ * non zero - failure
+ */
+static int
+raid1_add_base_bdev(struct raid_bdev *raid_bdev, uint8_t slot)
+{
+	int rc;
+
+	SPDK_NOTICELOG("Base bdev %s is back in raid bdev %s\n",
+		       raid_bdev->base_bdev_info[slot].bdev->name, raid_bdev->bdev.name);
+
+	raid_bdev->base_bdev_info[slot].resyncing = true;
+	rc = raid1_sb_io(raid_bdev->level_ctx, slot, false, raid1_add_sb_read_done);
+	if (rc != 0) {
+		SPDK_ERRLOG("Unable to read the superblock of base bdev %s\n",
+			    raid_bdev->base_bdev_info[slot].bdev->name);
+	}
+
+	return rc;
+}
+
+/*
+ * brief:
+ * raid1_channel_create sets up the queues of I/O waiting for the superblocks on
+ * a raid bdev io channel.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * raid_ch - pointer to raid bdev io channel
+ * returns:
+ * 0 - success
+ * non zero - failure
+ */
+static int
+raid1_channel_create(struct raid_bdev *raid_bdev, struct raid_bdev_io_channel *raid_ch)
+{
+	struct raid1_channel *r1ch;
+
+	r1ch = calloc(1, sizeof(*r1ch));
+	if (r1ch == NULL) {
+		SPDK_ERRLOG("Unable to allocate raid1 channel\n");
+		return -ENOMEM;
+	}
+
+	TAILQ_INIT(&r1ch->waiting_ios);
+	TAILQ_INIT(&r1ch->held_ios);
+	raid_ch->level_ctx = r1ch;
+
+	return 0;
+}
+
+static void
+raid1_channel_destroy(struct raid_bdev *raid_bdev, struct raid_bdev_io_channel *raid_ch)
+{
+	struct raid1_channel *r1ch = raid_ch->level_ctx;
+
+	if (r1ch == NULL) {
+		return;
+	}
+
+	assert(TAILQ_EMPTY(&r1ch->waiting_ios));
+	assert(TAILQ_EMPTY(&r1ch->held_ios));
+	free(r1ch);
+	raid_ch->level_ctx = NULL;
+}
+
+static void
+raid1_dump_info_json(struct raid_bdev *raid_bdev, struct spdk_json_write_ctx *w)
+{
+	bool	degraded = false;
+	uint8_t	i;
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		if (!raid1_base_bdev_in_sync(raid_bdev, i)) {
+			degraded = true;
+		}
+	}
+
+	spdk_json_write_named_bool(w, "degraded", degraded);
+}
+
+const struct raid_fn_table g_raid1_fn_table = {
+	.start_rw_request		= raid1_start_rw_request,
+	.submit_null_payload_request	= raid1_submit_fanout_request,
+	.start				= raid1_start,
+	.stop				= raid1_stop,
+	.remove_base_bdev		= raid1_remove_base_bdev,
+	.add_base_bdev			= raid1_add_base_bdev,
+	.dump_info_json			= raid1_dump_info_json,
+	.channel_create			= raid1_channel_create,
+	.channel_destroy		= raid1_channel_destroy,
+};
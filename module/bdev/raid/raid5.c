@@ -0,0 +1,1445 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "bdev_raid.h"
+
+#include "spdk/config.h"
+#include "spdk/env.h"
+#include "spdk/thread.h"
+#include "spdk/util.h"
+#include "spdk/json.h"
+#include "spdk_internal/log.h"
+
+#ifdef SPDK_CONFIG_ISAL
+#include "isa-l/include/raid.h"
+#endif
+
+/*
+ * raid5 stripes the data over num_base_bdevs - 1 base bdevs and stores the XOR
+ * parity of each stripe on the remaining one, rotating the parity strip from
+ * the last base bdev down to the first (left-symmetric layout).
+ *
+ * The raid bdev splits I/O on strip boundaries. Reads go straight to the base
+ * bdev holding the strip. Writes are gathered per channel in a small cache of
+ * stripe buffers. A stripe that gets all of its data strips written is written
+ * out with freshly computed parity and no reads. A stripe that is still partial
+ * when the channel poller finds it untouched since its last run is written with
+ * read-modify-write: the old data of the written spans and the old parity are
+ * read and the parity is updated with the difference.
+ *
+ * Writing a stripe, and reading one to rebuild the strip of a missing base bdev,
+ * holds a lock on the stripe shared by all channels, so that parity updates of
+ * the same stripe from different channels are serialized.
+ *
+ * One base bdev may be missing. Reads of its strips are rebuilt from the other
+ * strips of the stripe and writes to it are only reflected in the parity. A base
+ * bdev that fails a write is taken out the same way as one that is removed,
+ * before the stripe is unlocked: the parity written with the stripe covers the
+ * strip that failed, so later reads and writes of the stripe rebuild it instead
+ * of using the stale one. The failed base bdev stays claimed until it is removed.
+ * A base bdev that was removed or failed can't be added back, the raid bdev has
+ * to be recreated.
+ */
+
+/* Number of stripe buffers per channel */
+#define RAID5_CACHE_STRIPES	4
+
+enum raid5_stripe_state {
+	RAID5_STRIPE_FREE,
+
+	/* Gathering writes */
+	RAID5_STRIPE_FILLING,
+
+	/* Waiting for the stripe lock held by another stripe buffer */
+	RAID5_STRIPE_LOCK_WAIT,
+
+	/* Reading old data and parity, or the strips to rebuild a read */
+	RAID5_STRIPE_READING,
+
+	/* Writing data and parity */
+	RAID5_STRIPE_WRITING,
+};
+
+struct raid5_op {
+	uint8_t			slot;
+	uint64_t		offset_blocks;
+	uint64_t		num_blocks;
+	void			*buf;
+};
+
+struct raid5_stripe {
+	struct raid5_channel		*r5ch;
+	enum raid5_stripe_state		state;
+	uint64_t			index;
+
+	/* A write was added since the last poll */
+	bool				touched;
+
+	/* Rebuilds a read of a missing base bdev instead of writing */
+	bool				rebuild_read;
+	uint8_t				rebuild_strip;
+
+	/* New data of all data strips, then parity, old data and old parity */
+	uint8_t				*data;
+	uint8_t				*parity;
+	uint8_t				*old;
+	uint8_t				*old_parity;
+
+	/* One bit per data block of the stripe */
+	uint64_t			*dirty;
+	uint64_t			dirty_blocks;
+
+	/* Per data strip first and last dirty block, and their union */
+	uint64_t			*span_first;
+	uint64_t			*span_last;
+	uint64_t			lo;
+	uint64_t			hi;
+
+	/* Parent I/O waiting for the stripe */
+	TAILQ_HEAD(, spdk_bdev_io)	ios;
+
+	/* Base bdev I/O of the current phase */
+	struct raid5_op			*ops;
+	uint32_t			num_ops;
+	uint32_t			next_op;
+	uint32_t			ops_outstanding;
+	bool				failed;
+	struct spdk_bdev_io_wait_entry	waitq_entry;
+
+	/* Sources of a parity computation, plus room for the destination */
+	void				**xor_vects;
+
+	TAILQ_ENTRY(raid5_stripe)	lock_link;
+};
+
+struct raid5_channel {
+	struct raid_bdev		*raid_bdev;
+	struct raid_bdev_io_channel	*raid_ch;
+	struct raid5_stripe		stripes[RAID5_CACHE_STRIPES];
+
+	/* Parent I/O waiting for a free stripe buffer */
+	TAILQ_HEAD(, spdk_bdev_io)	waiting_ios;
+
+	struct spdk_poller		*poller;
+};
+
+struct raid5_info {
+	struct raid_bdev		*raid_bdev;
+	uint8_t				num_data_strips;
+	uint64_t			stripe_blocks;
+	uint64_t			strip_bytes;
+
+	/* Slot of the missing base bdev, UINT8_MAX if there is none */
+	uint8_t				missing;
+
+	/* Stripes being written or rebuilt by any channel */
+	pthread_mutex_t			lock;
+	TAILQ_HEAD(, raid5_stripe)	locked_stripes;
+};
+
+static void raid5_start_rw_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io);
+static void raid5_stripe_flush(struct raid5_stripe *stripe);
+
+static inline uint8_t
+raid5_parity_slot(struct raid_bdev *raid_bdev, uint64_t stripe_index)
+{
+	return raid_bdev->num_base_bdevs - 1 - (stripe_index % raid_bdev->num_base_bdevs);
+}
+
+static inline uint8_t
+raid5_data_slot(struct raid_bdev *raid_bdev, uint64_t stripe_index, uint8_t strip)
+{
+	return (raid5_parity_slot(raid_bdev, stripe_index) + 1 + strip) % raid_bdev->num_base_bdevs;
+}
+
+static inline bool
+raid5_block_dirty(struct raid5_stripe *stripe, uint64_t block)
+{
+	return stripe->dirty[block / 64] & (1ULL << (block % 64));
+}
+
+/*
+ * brief:
+ * raid5_xor computes the XOR of nsrcs buffers of len bytes into dest. vects
+ * holds the sources and has room for one more pointer after them.
+ * params:
+ * dest - destination buffer, may not be one of the sources
+ * vects - source buffers
+ * nsrcs - number of sources
+ * len - length of the buffers, a multiple of the block size
+ * returns:
+ * none
+ */
+static void
+raid5_xor(void *dest, void **vects, uint32_t nsrcs, size_t len)
+{
+	uint64_t	*d = dest;
+	uint64_t	acc;
+	size_t		i;
+	uint32_t	j;
+
+	assert(nsrcs > 0);
+	if (nsrcs == 1) {
+		memcpy(dest, vects[0], len);
+		return;
+	}
+
+#ifdef SPDK_CONFIG_ISAL
+	/* xor_gen takes the destination as the last vector */
+	vects[nsrcs] = dest;
+	if (xor_gen(nsrcs + 1, len, vects) == 0) {
+		return;
+	}
+#endif
+
+	for (i = 0; i < len / sizeof(uint64_t); i++) {
+		acc = ((uint64_t *)vects[0])[i];
+		for (j = 1; j < nsrcs; j++) {
+			acc ^= ((uint64_t *)vects[j])[i];
+		}
+		d[i] = acc;
+	}
+}
+
+static bool
+raid5_stripe_trylock(struct raid5_info *raid5, struct raid5_stripe *stripe)
+{
+	struct raid5_stripe *locked;
+
+	pthread_mutex_lock(&raid5->lock);
+	TAILQ_FOREACH(locked, &raid5->locked_stripes, lock_link) {
+		if (locked->index == stripe->index) {
+			pthread_mutex_unlock(&raid5->lock);
+			return false;
+		}
+	}
+	TAILQ_INSERT_TAIL(&raid5->locked_stripes, stripe, lock_link);
+	pthread_mutex_unlock(&raid5->lock);
+
+	return true;
+}
+
+static void
+raid5_stripe_unlock(struct raid5_info *raid5, struct raid5_stripe *stripe)
+{
+	pthread_mutex_lock(&raid5->lock);
+	TAILQ_REMOVE(&raid5->locked_stripes, stripe, lock_link);
+	pthread_mutex_unlock(&raid5->lock);
+}
+
+static struct raid5_stripe *
+raid5_get_free_stripe(struct raid5_channel *r5ch, uint64_t index)
+{
+	struct raid5_info	*raid5 = r5ch->raid_bdev->level_ctx;
+	struct raid5_stripe	*stripe;
+	int			i;
+
+	for (i = 0; i < RAID5_CACHE_STRIPES; i++) {
+		stripe = &r5ch->stripes[i];
+		if (stripe->state == RAID5_STRIPE_FREE) {
+			memset(stripe->dirty, 0, spdk_divide_round_up(raid5->stripe_blocks, 64) * sizeof(uint64_t));
+			stripe->index = index;
+			stripe->dirty_blocks = 0;
+			stripe->touched = false;
+			stripe->rebuild_read = false;
+			stripe->failed = false;
+			stripe->state = RAID5_STRIPE_FILLING;
+			return stripe;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * brief:
+ * raid5_resume_waiting resubmits I/O that waited for a stripe buffer while
+ * there are free ones.
+ * params:
+ * r5ch - pointer to raid5 channel
+ * returns:
+ * none
+ */
+static void
+raid5_resume_waiting(struct raid5_channel *r5ch)
+{
+	struct spdk_bdev_io	*bdev_io;
+	struct raid_bdev_io	*raid_io;
+	int			i;
+
+	while (!TAILQ_EMPTY(&r5ch->waiting_ios)) {
+		for (i = 0; i < RAID5_CACHE_STRIPES; i++) {
+			if (r5ch->stripes[i].state == RAID5_STRIPE_FREE) {
+				break;
+			}
+		}
+		if (i == RAID5_CACHE_STRIPES) {
+			return;
+		}
+
+		bdev_io = TAILQ_FIRST(&r5ch->waiting_ios);
+		TAILQ_REMOVE(&r5ch->waiting_ios, bdev_io, module_link);
+		raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+		raid5_start_rw_request(raid_io->ch, bdev_io);
+	}
+}
+
+static void
+raid5_copy_to_iovs(struct spdk_bdev_io *bdev_io, const uint8_t *buf)
+{
+	int i;
+
+	for (i = 0; i < bdev_io->u.bdev.iovcnt; i++) {
+		memcpy(bdev_io->u.bdev.iovs[i].iov_base, buf, bdev_io->u.bdev.iovs[i].iov_len);
+		buf += bdev_io->u.bdev.iovs[i].iov_len;
+	}
+}
+
+static void
+raid5_copy_from_iovs(uint8_t *buf, struct spdk_bdev_io *bdev_io)
+{
+	int i;
+
+	for (i = 0; i < bdev_io->u.bdev.iovcnt; i++) {
+		memcpy(buf, bdev_io->u.bdev.iovs[i].iov_base, bdev_io->u.bdev.iovs[i].iov_len);
+		buf += bdev_io->u.bdev.iovs[i].iov_len;
+	}
+}
+
+/*
+ * brief:
+ * raid5_stripe_finish releases the stripe buffer and completes the I/O that
+ * waited for it.
+ * params:
+ * stripe - pointer to stripe buffer
+ * returns:
+ * none
+ */
+static void
+raid5_stripe_finish(struct raid5_stripe *stripe)
+{
+	struct raid5_channel		*r5ch = stripe->r5ch;
+	struct raid_bdev		*raid_bdev = r5ch->raid_bdev;
+	struct raid5_info		*raid5 = raid_bdev->level_ctx;
+	enum spdk_bdev_io_status	status;
+	struct spdk_bdev_io		*bdev_io;
+	TAILQ_HEAD(, spdk_bdev_io)	ios;
+
+	status = stripe->failed ? SPDK_BDEV_IO_STATUS_FAILED : SPDK_BDEV_IO_STATUS_SUCCESS;
+	if (stripe->rebuild_read && !stripe->failed) {
+		bdev_io = TAILQ_FIRST(&stripe->ios);
+		raid5_copy_to_iovs(bdev_io, stripe->data + stripe->rebuild_strip * raid5->strip_bytes +
+				   (stripe->lo << raid_bdev->blocklen_shift));
+	}
+
+	TAILQ_INIT(&ios);
+	TAILQ_SWAP(&ios, &stripe->ios, spdk_bdev_io, module_link);
+	raid5_stripe_unlock(raid5, stripe);
+	stripe->state = RAID5_STRIPE_FREE;
+
+	while ((bdev_io = TAILQ_FIRST(&ios)) != NULL) {
+		TAILQ_REMOVE(&ios, bdev_io, module_link);
+		spdk_bdev_io_complete(bdev_io, status);
+	}
+
+	raid5_resume_waiting(r5ch);
+}
+
+/* A base bdev is used until it is missing, its channel may still be held for a while after that. */
+static bool
+raid5_slot_usable(struct raid5_channel *r5ch, uint8_t slot)
+{
+	struct raid5_info *raid5 = r5ch->raid_bdev->level_ctx;
+
+	return r5ch->raid_ch->base_channel[slot] != NULL &&
+	       __atomic_load_n(&raid5->missing, __ATOMIC_SEQ_CST) != slot;
+}
+
+static void raid5_stripe_ops_done(struct raid5_stripe *stripe);
+static bool raid5_base_bdev_failed(struct raid_bdev *raid_bdev, uint8_t slot);
+
+/*
+ * brief:
+ * raid5_stripe_op_failed handles a base bdev I/O of a stripe that failed. A
+ * failed write takes the base bdev out of the raid bdev if no other one is
+ * missing, the stripe is still consistent then.
+ * params:
+ * stripe - pointer to stripe buffer
+ * slot - base bdev slot of the I/O
+ * returns:
+ * none
+ */
+static void
+raid5_stripe_op_failed(struct raid5_stripe *stripe, uint8_t slot)
+{
+	struct raid_bdev *raid_bdev = stripe->r5ch->raid_bdev;
+
+	if (stripe->state == RAID5_STRIPE_WRITING && slot < raid_bdev->num_base_bdevs &&
+	    raid5_base_bdev_failed(raid_bdev, slot)) {
+		return;
+	}
+
+	stripe->failed = true;
+}
+
+static uint8_t
+raid5_get_base_bdev_slot(struct raid_bdev *raid_bdev, struct spdk_bdev *bdev)
+{
+	uint8_t i;
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		if (raid_bdev->base_bdev_info[i].bdev == bdev) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+static void
+raid5_op_completion(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct raid5_stripe	*stripe = cb_arg;
+	uint8_t			slot;
+
+	slot = raid5_get_base_bdev_slot(stripe->r5ch->raid_bdev, bdev_io->bdev);
+	spdk_bdev_free_io(bdev_io);
+
+	if (!success) {
+		raid5_stripe_op_failed(stripe, slot);
+	}
+
+	assert(stripe->ops_outstanding > 0);
+	stripe->ops_outstanding--;
+	if (stripe->ops_outstanding == 0 && stripe->next_op == stripe->num_ops) {
+		raid5_stripe_ops_done(stripe);
+	}
+}
+
+/*
+ * brief:
+ * _raid5_stripe_submit_ops submits the remaining base bdev I/O of the current
+ * phase of a stripe. It is called again from the io wait queue when a base bdev
+ * runs out of bdev_io.
+ * params:
+ * _stripe - pointer to stripe buffer
+ * returns:
+ * none
+ */
+static void
+_raid5_stripe_submit_ops(void *_stripe)
+{
+	struct raid5_stripe		*stripe = _stripe;
+	struct raid5_channel		*r5ch = stripe->r5ch;
+	struct raid_bdev		*raid_bdev = r5ch->raid_bdev;
+	struct raid_base_bdev_info	*info;
+	struct spdk_io_channel		*base_ch;
+	struct raid5_op			*op;
+	int				rc;
+
+	while (stripe->next_op < stripe->num_ops) {
+		op = &stripe->ops[stripe->next_op];
+		info = &raid_bdev->base_bdev_info[op->slot];
+		base_ch = r5ch->raid_ch->base_channel[op->slot];
+		if (!raid5_slot_usable(r5ch, op->slot)) {
+			/* The base bdev went away, a write to it is covered by the parity. */
+			if (stripe->state == RAID5_STRIPE_READING) {
+				stripe->failed = true;
+			}
+			stripe->next_op++;
+			continue;
+		}
+
+		stripe->ops_outstanding++;
+		if (stripe->state == RAID5_STRIPE_READING) {
+			rc = spdk_bdev_read_blocks(info->desc, base_ch, op->buf, op->offset_blocks,
+						   op->num_blocks, raid5_op_completion, stripe);
+		} else {
+			rc = spdk_bdev_write_blocks(info->desc, base_ch, op->buf, op->offset_blocks,
+						    op->num_blocks, raid5_op_completion, stripe);
+		}
+
+		if (rc == -ENOMEM) {
+			stripe->ops_outstanding--;
+			stripe->waitq_entry.bdev = info->bdev;
+			stripe->waitq_entry.cb_fn = _raid5_stripe_submit_ops;
+			stripe->waitq_entry.cb_arg = stripe;
+			spdk_bdev_queue_io_wait(info->bdev, base_ch, &stripe->waitq_entry);
+			return;
+		}
+
+		if (rc != 0) {
+			stripe->ops_outstanding--;
+			raid5_stripe_op_failed(stripe, op->slot);
+		}
+		stripe->next_op++;
+	}
+
+	if (stripe->ops_outstanding == 0) {
+		raid5_stripe_ops_done(stripe);
+	}
+}
+
+static void
+raid5_stripe_submit_ops(struct raid5_stripe *stripe, enum raid5_stripe_state state)
+{
+	stripe->state = state;
+	stripe->next_op = 0;
+	stripe->ops_outstanding = 0;
+	_raid5_stripe_submit_ops(stripe);
+}
+
+static void
+raid5_add_op(struct raid5_stripe *stripe, uint8_t slot, uint64_t offset_in_strip,
+	     uint64_t num_blocks, void *buf)
+{
+	struct raid_bdev	*raid_bdev = stripe->r5ch->raid_bdev;
+	struct raid5_op		*op = &stripe->ops[stripe->num_ops++];
+
+	assert(stripe->num_ops <= 2 * (uint32_t)raid_bdev->num_base_bdevs);
+	op->slot = slot;
+	op->offset_blocks = (stripe->index << raid_bdev->strip_size_shift) + offset_in_strip;
+	op->num_blocks = num_blocks;
+	op->buf = buf;
+}
+
+static inline uint8_t *
+raid5_strip_buf(struct raid5_stripe *stripe, uint8_t *base, uint8_t strip, uint64_t offset)
+{
+	struct raid_bdev	*raid_bdev = stripe->r5ch->raid_bdev;
+	struct raid5_info	*raid5 = raid_bdev->level_ctx;
+
+	return base + strip * raid5->strip_bytes + (offset << raid_bdev->blocklen_shift);
+}
+
+/* Returns the data strip of the missing base bdev, UINT8_MAX if it holds parity or none is missing. */
+static uint8_t
+raid5_missing_strip(struct raid5_stripe *stripe)
+{
+	struct raid_bdev	*raid_bdev = stripe->r5ch->raid_bdev;
+	struct raid5_info	*raid5 = raid_bdev->level_ctx;
+	uint8_t			strip, slot;
+
+	for (strip = 0; strip < raid5->num_data_strips; strip++) {
+		slot = raid5_data_slot(raid_bdev, stripe->index, strip);
+		if (!raid5_slot_usable(stripe->r5ch, slot)) {
+			return strip;
+		}
+	}
+
+	return UINT8_MAX;
+}
+
+static bool
+raid5_parity_missing(struct raid5_stripe *stripe)
+{
+	struct raid_bdev *raid_bdev = stripe->r5ch->raid_bdev;
+
+	return !raid5_slot_usable(stripe->r5ch, raid5_parity_slot(raid_bdev, stripe->index));
+}
+
+/*
+ * brief:
+ * raid5_stripe_compute_parity brings the data strips of a written stripe up
+ * to date with what was read and computes the new parity over [lo, hi), or over
+ * the whole strip for a full stripe.
+ * params:
+ * stripe - pointer to stripe buffer
+ * returns:
+ * none
+ */
+static void
+raid5_stripe_compute_parity(struct raid5_stripe *stripe)
+{
+	struct raid_bdev	*raid_bdev = stripe->r5ch->raid_bdev;
+	struct raid5_info	*raid5 = raid_bdev->level_ctx;
+	uint8_t			nd = raid5->num_data_strips;
+	uint8_t			missing = raid5_missing_strip(stripe);
+	uint64_t		lo = stripe->lo, hi = stripe->hi;
+	uint64_t		first, last, block;
+	uint32_t		n = 0;
+	size_t			len;
+	uint8_t			strip;
+
+	if (stripe->dirty_blocks == raid5->stripe_blocks) {
+		for (strip = 0; strip < nd; strip++) {
+			stripe->xor_vects[strip] = raid5_strip_buf(stripe, stripe->data, strip, 0);
+		}
+		raid5_xor(stripe->parity, stripe->xor_vects, nd, raid5->strip_bytes);
+		return;
+	}
+
+	len = (hi - lo) << raid_bdev->blocklen_shift;
+
+	if (missing != UINT8_MAX) {
+		/* The old data of the missing strip is the XOR of the old parity and the other strips. */
+		stripe->xor_vects[n++] = raid5_strip_buf(stripe, stripe->old_parity, 0, lo);
+		for (strip = 0; strip < nd; strip++) {
+			if (strip != missing) {
+				stripe->xor_vects[n++] = raid5_strip_buf(stripe, stripe->old, strip, lo);
+			}
+		}
+		raid5_xor(raid5_strip_buf(stripe, stripe->old, missing, lo), stripe->xor_vects, n, len);
+	}
+
+	for (strip = 0; strip < nd; strip++) {
+		/*
+		 * Fill the blocks that weren't written with the old data: within the written
+		 * span so that it can be written in one I/O and, when parity is computed from
+		 * all data strips, over the whole [lo, hi) range.
+		 */
+		first = stripe->span_first[strip];
+		last = stripe->span_last[strip];
+		if (missing != UINT8_MAX) {
+			first = lo;
+			last = hi - 1;
+		} else if (first == UINT64_MAX) {
+			continue;
+		}
+
+		for (block = first; block <= last; block++) {
+			if (!raid5_block_dirty(stripe, strip * raid_bdev->strip_size + block)) {
+				memcpy(raid5_strip_buf(stripe, stripe->data, strip, block),
+				       raid5_strip_buf(stripe, stripe->old, strip, block), raid_bdev->bdev.blocklen);
+			}
+		}
+	}
+
+	if (raid5_parity_missing(stripe)) {
+		return;
+	}
+
+	n = 0;
+	if (missing != UINT8_MAX) {
+		/* Reconstruct-write: parity of the merged data strips */
+		for (strip = 0; strip < nd; strip++) {
+			stripe->xor_vects[n++] = raid5_strip_buf(stripe, stripe->data, strip, lo);
+		}
+		raid5_xor(raid5_strip_buf(stripe, stripe->parity, 0, lo), stripe->xor_vects, n, len);
+		return;
+	}
+
+	/*
+	 * Read-modify-write: new parity = old parity ^ old data ^ new data. Outside of
+	 * its span, the old and new data of a strip are both zeroed so they cancel out.
+	 */
+	stripe->xor_vects[n++] = raid5_strip_buf(stripe, stripe->old_parity, 0, lo);
+	for (strip = 0; strip < nd; strip++) {
+		first = stripe->span_first[strip];
+		last = stripe->span_last[strip];
+		if (first == UINT64_MAX) {
+			continue;
+		}
+		if (first > lo) {
+			memset(raid5_strip_buf(stripe, stripe->old, strip, lo), 0,
+			       (first - lo) << raid_bdev->blocklen_shift);
+			memset(raid5_strip_buf(stripe, stripe->data, strip, lo), 0,
+			       (first - lo) << raid_bdev->blocklen_shift);
+		}
+		if (last + 1 < hi) {
+			memset(raid5_strip_buf(stripe, stripe->old, strip, last + 1), 0,
+			       (hi - last - 1) << raid_bdev->blocklen_shift);
+			memset(raid5_strip_buf(stripe, stripe->data, strip, last + 1), 0,
+			       (hi - last - 1) << raid_bdev->blocklen_shift);
+		}
+		stripe->xor_vects[n++] = raid5_strip_buf(stripe, stripe->old, strip, lo);
+		stripe->xor_vects[n++] = raid5_strip_buf(stripe, stripe->data, strip, lo);
+	}
+	raid5_xor(raid5_strip_buf(stripe, stripe->parity, 0, lo), stripe->xor_vects, n, len);
+}
+
+static void
+raid5_stripe_write(struct raid5_stripe *stripe)
+{
+	struct raid_bdev	*raid_bdev = stripe->r5ch->raid_bdev;
+	struct raid5_info	*raid5 = raid_bdev->level_ctx;
+	uint8_t			strip;
+	uint64_t		first, last;
+
+	raid5_stripe_compute_parity(stripe);
+
+	stripe->num_ops = 0;
+	for (strip = 0; strip < raid5->num_data_strips; strip++) {
+		first = stripe->span_first[strip];
+		last = stripe->span_last[strip];
+		if (first == UINT64_MAX) {
+			continue;
+		}
+		raid5_add_op(stripe, raid5_data_slot(raid_bdev, stripe->index, strip), first,
+			     last - first + 1, raid5_strip_buf(stripe, stripe->data, strip, first));
+	}
+	if (!raid5_parity_missing(stripe)) {
+		raid5_add_op(stripe, raid5_parity_slot(raid_bdev, stripe->index), stripe->lo,
+			     stripe->hi - stripe->lo, raid5_strip_buf(stripe, stripe->parity, 0, stripe->lo));
+	}
+
+	raid5_stripe_submit_ops(stripe, RAID5_STRIPE_WRITING);
+}
+
+static void
+raid5_stripe_rebuild(struct raid5_stripe *stripe)
+{
+	struct raid_bdev	*raid_bdev = stripe->r5ch->raid_bdev;
+	struct raid5_info	*raid5 = raid_bdev->level_ctx;
+	uint32_t		n = 0;
+	uint8_t			strip;
+
+	stripe->xor_vects[n++] = raid5_strip_buf(stripe, stripe->old_parity, 0, stripe->lo);
+	for (strip = 0; strip < raid5->num_data_strips; strip++) {
+		if (strip != stripe->rebuild_strip) {
+			stripe->xor_vects[n++] = raid5_strip_buf(stripe, stripe->old, strip, stripe->lo);
+		}
+	}
+	raid5_xor(raid5_strip_buf(stripe, stripe->data, stripe->rebuild_strip, stripe->lo),
+		  stripe->xor_vects, n, (stripe->hi - stripe->lo) << raid_bdev->blocklen_shift);
+}
+
+static void
+raid5_stripe_ops_done(struct raid5_stripe *stripe)
+{
+	if (stripe->state == RAID5_STRIPE_READING && !stripe->failed) {
+		if (stripe->rebuild_read) {
+			raid5_stripe_rebuild(stripe);
+		} else {
+			raid5_stripe_write(stripe);
+			return;
+		}
+	}
+
+	raid5_stripe_finish(stripe);
+}
+
+/*
+ * brief:
+ * raid5_stripe_plan_reads computes the written span of every data strip and
+ * adds the reads a partial stripe write needs: the old data of the spans, and
+ * the old parity over their union for read-modify-write. When a data strip is
+ * missing, its old data is rebuilt from the old parity and the other strips,
+ * which are then read over the whole union.
+ * params:
+ * stripe - pointer to stripe buffer
+ * returns:
+ * none
+ */
+static void
+raid5_stripe_plan_reads(struct raid5_stripe *stripe)
+{
+	struct raid_bdev	*raid_bdev = stripe->r5ch->raid_bdev;
+	struct raid5_info	*raid5 = raid_bdev->level_ctx;
+	uint8_t			missing = raid5_missing_strip(stripe);
+	uint64_t		block, first, last;
+	uint8_t			strip;
+
+	stripe->lo = UINT64_MAX;
+	stripe->hi = 0;
+	for (strip = 0; strip < raid5->num_data_strips; strip++) {
+		stripe->span_first[strip] = UINT64_MAX;
+		stripe->span_last[strip] = 0;
+		for (block = 0; block < raid_bdev->strip_size; block++) {
+			if (raid5_block_dirty(stripe, strip * raid_bdev->strip_size + block)) {
+				if (stripe->span_first[strip] == UINT64_MAX) {
+					stripe->span_first[strip] = block;
+				}
+				stripe->span_last[strip] = block;
+			}
+		}
+		if (stripe->span_first[strip] != UINT64_MAX) {
+			stripe->lo = spdk_min(stripe->lo, stripe->span_first[strip]);
+			stripe->hi = spdk_max(stripe->hi, stripe->span_last[strip] + 1);
+		}
+	}
+	assert(stripe->lo < stripe->hi);
+
+	stripe->num_ops = 0;
+	if (stripe->dirty_blocks == raid5->stripe_blocks) {
+		return;
+	}
+
+	for (strip = 0; strip < raid5->num_data_strips; strip++) {
+		if (strip == missing) {
+			continue;
+		}
+		first = stripe->span_first[strip];
+		last = stripe->span_last[strip];
+		if (missing != UINT8_MAX) {
+			first = stripe->lo;
+			last = stripe->hi - 1;
+		} else if (first == UINT64_MAX) {
+			continue;
+		}
+		raid5_add_op(stripe, raid5_data_slot(raid_bdev, stripe->index, strip), first,
+			     last - first + 1, raid5_strip_buf(stripe, stripe->old, strip, first));
+	}
+
+	if (!raid5_parity_missing(stripe)) {
+		raid5_add_op(stripe, raid5_parity_slot(raid_bdev, stripe->index), stripe->lo,
+			     stripe->hi - stripe->lo, raid5_strip_buf(stripe, stripe->old_parity, 0, stripe->lo));
+	}
+}
+
+/*
+ * brief:
+ * raid5_stripe_flush writes a stripe buffer out, or reads the strips to rebuild
+ * a read, once it holds the stripe lock.
+ * params:
+ * stripe - pointer to stripe buffer
+ * returns:
+ * none
+ */
+static void
+raid5_stripe_flush(struct raid5_stripe *stripe)
+{
+	struct raid5_info	*raid5 = stripe->r5ch->raid_bdev->level_ctx;
+	struct raid_bdev	*raid_bdev = stripe->r5ch->raid_bdev;
+	uint8_t			strip;
+
+	if (!raid5_stripe_trylock(raid5, stripe)) {
+		stripe->state = RAID5_STRIPE_LOCK_WAIT;
+		return;
+	}
+
+	if (stripe->rebuild_read) {
+		stripe->num_ops = 0;
+		for (strip = 0; strip < raid5->num_data_strips; strip++) {
+			if (strip != stripe->rebuild_strip) {
+				raid5_add_op(stripe, raid5_data_slot(raid_bdev, stripe->index, strip), stripe->lo,
+					     stripe->hi - stripe->lo,
+					     raid5_strip_buf(stripe, stripe->old, strip, stripe->lo));
+			}
+		}
+		raid5_add_op(stripe, raid5_parity_slot(raid_bdev, stripe->index), stripe->lo,
+			     stripe->hi - stripe->lo, raid5_strip_buf(stripe, stripe->old_parity, 0, stripe->lo));
+		raid5_stripe_submit_ops(stripe, RAID5_STRIPE_READING);
+		return;
+	}
+
+	raid5_stripe_plan_reads(stripe);
+	if (stripe->num_ops == 0) {
+		/* Full stripe */
+		raid5_stripe_write(stripe);
+		return;
+	}
+
+	raid5_stripe_submit_ops(stripe, RAID5_STRIPE_READING);
+}
+
+static int
+raid5_channel_poll(void *arg)
+{
+	struct raid5_channel	*r5ch = arg;
+	struct raid5_stripe	*stripe;
+	int			i, busy = 0;
+
+	for (i = 0; i < RAID5_CACHE_STRIPES; i++) {
+		stripe = &r5ch->stripes[i];
+		if (stripe->state == RAID5_STRIPE_FILLING) {
+			/* Give writes to the stripe one more poll to fill it up. */
+			if (stripe->touched) {
+				stripe->touched = false;
+				continue;
+			}
+			raid5_stripe_flush(stripe);
+			busy = 1;
+		} else if (stripe->state == RAID5_STRIPE_LOCK_WAIT) {
+			raid5_stripe_flush(stripe);
+			busy = 1;
+		}
+	}
+
+	return busy;
+}
+
+/*
+ * brief:
+ * raid5_submit_write copies a write into the stripe buffer of its stripe. A
+ * stripe that got all of its data is written out right away, others by the
+ * channel poller.
+ * params:
+ * raid_ch - pointer to raid bdev io channel
+ * bdev_io - pointer to parent bdev_io on raid bdev device
+ * returns:
+ * none
+ */
+static void
+raid5_submit_write(struct raid_bdev_io_channel *raid_ch, struct spdk_bdev_io *bdev_io)
+{
+	struct raid5_channel	*r5ch = raid_ch->level_ctx;
+	struct raid_bdev	*raid_bdev = r5ch->raid_bdev;
+	struct raid5_info	*raid5 = raid_bdev->level_ctx;
+	struct raid5_stripe	*stripe = NULL;
+	uint64_t		index, offset, block;
+	int			i;
+
+	index = bdev_io->u.bdev.offset_blocks / raid5->stripe_blocks;
+	offset = bdev_io->u.bdev.offset_blocks % raid5->stripe_blocks;
+	assert((offset >> raid_bdev->strip_size_shift) ==
+	       ((offset + bdev_io->u.bdev.num_blocks - 1) >> raid_bdev->strip_size_shift));
+
+	for (i = 0; i < RAID5_CACHE_STRIPES; i++) {
+		if (r5ch->stripes[i].state == RAID5_STRIPE_FILLING && r5ch->stripes[i].index == index) {
+			stripe = &r5ch->stripes[i];
+			break;
+		}
+	}
+	if (stripe == NULL) {
+		stripe = raid5_get_free_stripe(r5ch, index);
+		if (stripe == NULL) {
+			TAILQ_INSERT_TAIL(&r5ch->waiting_ios, bdev_io, module_link);
+			return;
+		}
+	}
+
+	raid5_copy_from_iovs(stripe->data + (offset << raid_bdev->blocklen_shift), bdev_io);
+	for (block = offset; block < offset + bdev_io->u.bdev.num_blocks; block++) {
+		if (!raid5_block_dirty(stripe, block)) {
+			stripe->dirty[block / 64] |= 1ULL << (block % 64);
+			stripe->dirty_blocks++;
+		}
+	}
+	TAILQ_INSERT_TAIL(&stripe->ios, bdev_io, module_link);
+	stripe->touched = true;
+
+	if (stripe->dirty_blocks == raid5->stripe_blocks) {
+		raid5_stripe_flush(stripe);
+	}
+}
+
+static void
+_raid5_submit_rw_request(void *_bdev_io)
+{
+	struct spdk_bdev_io	*bdev_io = _bdev_io;
+	struct raid_bdev_io	*raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+
+	raid5_start_rw_request(raid_io->ch, bdev_io);
+}
+
+static void
+raid5_read_completion(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct spdk_bdev_io *parent_io = cb_arg;
+
+	spdk_bdev_free_io(bdev_io);
+
+	spdk_bdev_io_complete(parent_io, success ? SPDK_BDEV_IO_STATUS_SUCCESS :
+			      SPDK_BDEV_IO_STATUS_FAILED);
+}
+
+/*
+ * brief:
+ * raid5_submit_read reads from the base bdev holding the strip, or rebuilds the
+ * data from the other strips of the stripe if that base bdev is missing.
+ * params:
+ * raid_ch - pointer to raid bdev io channel
+ * bdev_io - pointer to parent bdev_io on raid bdev device
+ * returns:
+ * none
+ */
+static void
+raid5_submit_read(struct raid_bdev_io_channel *raid_ch, struct spdk_bdev_io *bdev_io)
+{
+	struct raid5_channel	*r5ch = raid_ch->level_ctx;
+	struct raid_bdev	*raid_bdev = r5ch->raid_bdev;
+	struct raid5_info	*raid5 = raid_bdev->level_ctx;
+	struct raid5_stripe	*stripe;
+	uint64_t		index, offset, offset_in_strip;
+	uint8_t			strip, slot;
+	int			ret;
+
+	index = bdev_io->u.bdev.offset_blocks / raid5->stripe_blocks;
+	offset = bdev_io->u.bdev.offset_blocks % raid5->stripe_blocks;
+	strip = offset >> raid_bdev->strip_size_shift;
+	offset_in_strip = offset & (raid_bdev->strip_size - 1);
+	slot = raid5_data_slot(raid_bdev, index, strip);
+
+	if (raid5_slot_usable(r5ch, slot)) {
+		ret = spdk_bdev_readv_blocks(raid_bdev->base_bdev_info[slot].desc, raid_ch->base_channel[slot],
+					     bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt,
+					     (index << raid_bdev->strip_size_shift) + offset_in_strip,
+					     bdev_io->u.bdev.num_blocks, raid5_read_completion, bdev_io);
+		if (ret != 0) {
+			raid_bdev_base_io_submit_fail_process(bdev_io, slot, _raid5_submit_rw_request, ret);
+		}
+		return;
+	}
+
+	stripe = raid5_get_free_stripe(r5ch, index);
+	if (stripe == NULL) {
+		TAILQ_INSERT_TAIL(&r5ch->waiting_ios, bdev_io, module_link);
+		return;
+	}
+
+	stripe->rebuild_read = true;
+	stripe->rebuild_strip = strip;
+	stripe->lo = offset_in_strip;
+	stripe->hi = offset_in_strip + bdev_io->u.bdev.num_blocks;
+	TAILQ_INSERT_TAIL(&stripe->ios, bdev_io, module_link);
+	raid5_stripe_flush(stripe);
+}
+
+/*
+ * brief:
+ * raid5_start_rw_request function is the submit_request function for
+ * read/write requests for raid5 bdevs.
+ * params:
+ * ch - pointer to raid bdev io channel
+ * bdev_io - pointer to parent bdev_io on raid bdev device
+ * returns:
+ * none
+ */
+static void
+raid5_start_rw_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+{
+	struct raid_bdev_io		*raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(ch);
+
+	raid_io->ch = ch;
+	if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ) {
+		raid5_submit_read(raid_ch, bdev_io);
+	} else {
+		raid5_submit_write(raid_ch, bdev_io);
+	}
+}
+
+static void
+raid5_null_payload_completion(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct spdk_bdev_io	*parent_io = cb_arg;
+	struct raid_bdev_io	*raid_io = (struct raid_bdev_io *)parent_io->driver_ctx;
+	struct raid_bdev	*raid_bdev = parent_io->bdev->ctxt;
+
+	spdk_bdev_free_io(bdev_io);
+
+	if (!success) {
+		raid_io->base_bdev_io_status = SPDK_BDEV_IO_STATUS_FAILED;
+	}
+
+	raid_io->base_bdev_io_completed++;
+	if (raid_io->base_bdev_io_submitted == raid_bdev->num_base_bdevs &&
+	    raid_io->base_bdev_io_completed == raid_io->base_bdev_io_expected) {
+		spdk_bdev_io_complete(parent_io, raid_io->base_bdev_io_status);
+	}
+}
+
+/*
+ * brief:
+ * _raid5_submit_null_payload_request_next sends a flush or reset to every base
+ * bdev present on the channel. A flush covers the stripes of its range on each
+ * of them.
+ * params:
+ * _bdev_io - pointer to parent bdev_io on raid bdev device
+ * returns:
+ * none
+ */
+static void
+_raid5_submit_null_payload_request_next(void *_bdev_io)
+{
+	struct spdk_bdev_io		*bdev_io = _bdev_io;
+	struct raid_bdev_io		*raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(raid_io->ch);
+	struct raid_bdev		*raid_bdev = bdev_io->bdev->ctxt;
+	struct raid5_info		*raid5 = raid_bdev->level_ctx;
+	uint64_t			first, last;
+	uint8_t				i;
+	int				ret;
+
+	while (raid_io->base_bdev_io_submitted < raid_bdev->num_base_bdevs) {
+		i = raid_io->base_bdev_io_submitted;
+		if (!raid5_slot_usable(raid_ch->level_ctx, i)) {
+			raid_io->base_bdev_io_submitted++;
+			continue;
+		}
+
+		if (bdev_io->type == SPDK_BDEV_IO_TYPE_FLUSH) {
+			first = bdev_io->u.bdev.offset_blocks / raid5->stripe_blocks;
+			last = (bdev_io->u.bdev.offset_blocks + bdev_io->u.bdev.num_blocks - 1) /
+			       raid5->stripe_blocks;
+			ret = spdk_bdev_flush_blocks(raid_bdev->base_bdev_info[i].desc, raid_ch->base_channel[i],
+						     first << raid_bdev->strip_size_shift,
+						     (last - first + 1) << raid_bdev->strip_size_shift,
+						     raid5_null_payload_completion, bdev_io);
+		} else {
+			ret = spdk_bdev_reset(raid_bdev->base_bdev_info[i].desc, raid_ch->base_channel[i],
+					      raid5_null_payload_completion, bdev_io);
+		}
+
+		if (ret == -ENOMEM) {
+			raid_bdev_base_io_submit_fail_process(bdev_io, i, _raid5_submit_null_payload_request_next,
+							      ret);
+			return;
+		}
+
+		if (ret == 0) {
+			raid_io->base_bdev_io_expected++;
+		} else {
+			raid_io->base_bdev_io_status = SPDK_BDEV_IO_STATUS_FAILED;
+		}
+		raid_io->base_bdev_io_submitted++;
+	}
+
+	if (raid_io->base_bdev_io_completed == raid_io->base_bdev_io_expected) {
+		spdk_bdev_io_complete(bdev_io, raid_io->base_bdev_io_status);
+	}
+}
+
+static void
+raid5_submit_null_payload_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+{
+	struct raid_bdev_io *raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+
+	if (bdev_io->type == SPDK_BDEV_IO_TYPE_UNMAP) {
+		/* The parity of unmapped blocks would be undefined. */
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
+	raid_io->ch = ch;
+	raid_io->base_bdev_io_submitted = 0;
+	raid_io->base_bdev_io_completed = 0;
+	raid_io->base_bdev_io_expected = 0;
+	raid_io->base_bdev_io_status = SPDK_BDEV_IO_STATUS_SUCCESS;
+	_raid5_submit_null_payload_request_next(bdev_io);
+}
+
+static bool
+raid5_io_type_supported(struct raid_bdev *raid_bdev, enum spdk_bdev_io_type io_type)
+{
+	uint8_t i;
+
+	if (io_type == SPDK_BDEV_IO_TYPE_UNMAP) {
+		return false;
+	}
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		if (raid_bdev->base_bdev_info[i].bdev != NULL &&
+		    !spdk_bdev_io_type_supported(raid_bdev->base_bdev_info[i].bdev, io_type)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void
+raid5_channel_free(struct raid5_channel *r5ch)
+{
+	struct raid5_stripe	*stripe;
+	int			i;
+
+	for (i = 0; i < RAID5_CACHE_STRIPES; i++) {
+		stripe = &r5ch->stripes[i];
+		spdk_dma_free(stripe->data);
+		free(stripe->dirty);
+		free(stripe->span_first);
+		free(stripe->span_last);
+		free(stripe->ops);
+		free(stripe->xor_vects);
+	}
+	free(r5ch);
+}
+
+/*
+ * brief:
+ * raid5_channel_create allocates the stripe buffers of a raid bdev io channel
+ * and registers the poller that writes out partial stripes.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * raid_ch - pointer to raid bdev io channel
+ * returns:
+ * 0 - success
+ * non zero - failure
+ */
+static int
+raid5_channel_create(struct raid_bdev *raid_bdev, struct raid_bdev_io_channel *raid_ch)
+{
+	struct raid5_info	*raid5 = raid_bdev->level_ctx;
+	struct raid5_channel	*r5ch;
+	struct raid5_stripe	*stripe;
+	uint8_t			n = raid_bdev->num_base_bdevs;
+	int			i;
+
+	r5ch = calloc(1, sizeof(*r5ch));
+	if (r5ch == NULL) {
+		SPDK_ERRLOG("Unable to allocate raid5 channel\n");
+		return -ENOMEM;
+	}
+
+	r5ch->raid_bdev = raid_bdev;
+	r5ch->raid_ch = raid_ch;
+	TAILQ_INIT(&r5ch->waiting_ios);
+
+	for (i = 0; i < RAID5_CACHE_STRIPES; i++) {
+		stripe = &r5ch->stripes[i];
+		stripe->r5ch = r5ch;
+		TAILQ_INIT(&stripe->ios);
+
+		/* data and old data hold num_data_strips strips, followed by one parity strip each */
+		stripe->data = spdk_dma_malloc(2 * n * raid5->strip_bytes, 0x1000, NULL);
+		stripe->dirty = calloc(spdk_divide_round_up(raid5->stripe_blocks, 64), sizeof(uint64_t));
+		stripe->span_first = calloc(raid5->num_data_strips, sizeof(uint64_t));
+		stripe->span_last = calloc(raid5->num_data_strips, sizeof(uint64_t));
+		stripe->ops = calloc(2 * n, sizeof(struct raid5_op));
+		stripe->xor_vects = calloc(2 * n + 1, sizeof(void *));
+		if (stripe->data == NULL || stripe->dirty == NULL || stripe->span_first == NULL ||
+		    stripe->span_last == NULL || stripe->ops == NULL || stripe->xor_vects == NULL) {
+			SPDK_ERRLOG("Unable to allocate raid5 stripe buffers\n");
+			raid5_channel_free(r5ch);
+			return -ENOMEM;
+		}
+		stripe->parity = stripe->data + raid5->num_data_strips * raid5->strip_bytes;
+		stripe->old = stripe->parity + raid5->strip_bytes;
+		stripe->old_parity = stripe->old + raid5->num_data_strips * raid5->strip_bytes;
+	}
+
+	r5ch->poller = SPDK_POLLER_REGISTER(raid5_channel_poll, r5ch, 0);
+	raid_ch->level_ctx = r5ch;
+
+	return 0;
+}
+
+static void
+raid5_channel_destroy(struct raid_bdev *raid_bdev, struct raid_bdev_io_channel *raid_ch)
+{
+	struct raid5_channel *r5ch = raid_ch->level_ctx;
+
+	if (r5ch == NULL) {
+		return;
+	}
+
+	assert(TAILQ_EMPTY(&r5ch->waiting_ios));
+	spdk_poller_unregister(&r5ch->poller);
+	raid5_channel_free(r5ch);
+	raid_ch->level_ctx = NULL;
+}
+
+/*
+ * brief:
+ * raid5_start sets up the geometry of a raid5 bdev: every stripe holds
+ * num_base_bdevs - 1 data strips and I/O is split on strip boundaries.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * returns:
+ * 0 - success
+ * non zero - failure
+ */
+static int
+raid5_start(struct raid_bdev *raid_bdev)
+{
+	struct raid5_info	*raid5;
+	uint64_t		min_blockcnt = UINT64_MAX;
+	uint8_t			i;
+
+	for (i = 0; i < raid_bdev->num_base_bdevs; i++) {
+		min_blockcnt = spdk_min(min_blockcnt, raid_bdev->base_bdev_info[i].bdev->blockcnt);
+	}
+
+	raid5 = calloc(1, sizeof(*raid5));
+	if (raid5 == NULL) {
+		SPDK_ERRLOG("Unable to allocate raid5 info\n");
+		return -ENOMEM;
+	}
+
+	raid5->raid_bdev = raid_bdev;
+	raid5->num_data_strips = raid_bdev->num_base_bdevs - 1;
+	raid5->stripe_blocks = raid5->num_data_strips * raid_bdev->strip_size;
+	raid5->strip_bytes = raid_bdev->strip_size * raid_bdev->bdev.blocklen;
+	raid5->missing = UINT8_MAX;
+	pthread_mutex_init(&raid5->lock, NULL);
+	TAILQ_INIT(&raid5->locked_stripes);
+
+	raid_bdev->bdev.blockcnt = (min_blockcnt >> raid_bdev->strip_size_shift) * raid5->stripe_blocks;
+	raid_bdev->bdev.optimal_io_boundary = raid_bdev->strip_size;
+	raid_bdev->bdev.split_on_optimal_io_boundary = true;
+	raid_bdev->level_ctx = raid5;
+
+	return 0;
+}
+
+static void
+raid5_stop(struct raid_bdev *raid_bdev)
+{
+	struct raid5_info *raid5 = raid_bdev->level_ctx;
+
+	if (raid5 == NULL) {
+		return;
+	}
+
+	/* Channels and their stripe buffers are gone by now. */
+	assert(TAILQ_EMPTY(&raid5->locked_stripes));
+	pthread_mutex_destroy(&raid5->lock);
+	free(raid5);
+	raid_bdev->level_ctx = NULL;
+}
+
+struct raid5_remove_ctx {
+	struct raid_bdev	*raid_bdev;
+	uint8_t			slot;
+};
+
+static void
+raid5_put_slot_channel(struct spdk_io_channel_iter *i)
+{
+	struct raid5_remove_ctx		*ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel		*ch = spdk_io_channel_iter_get_channel(i);
+	struct raid_bdev_io_channel	*raid_ch = spdk_io_channel_get_ctx(ch);
+
+	if (raid_ch->base_channel[ctx->slot] != NULL) {
+		spdk_put_io_channel(raid_ch->base_channel[ctx->slot]);
+		raid_ch->base_channel[ctx->slot] = NULL;
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+raid5_fail_done(struct spdk_io_channel_iter *i, int status)
+{
+	free(spdk_io_channel_iter_get_ctx(i));
+}
+
+/*
+ * brief:
+ * raid5_base_bdev_failed takes a base bdev that failed a write out of the raid
+ * bdev, unless another one is missing already. No channel submits to it once it
+ * is missing, its channels are released and it stays claimed until it is removed.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * slot - base bdev slot
+ * returns:
+ * true if the base bdev is the missing one
+ */
+static bool
+raid5_base_bdev_failed(struct raid_bdev *raid_bdev, uint8_t slot)
+{
+	struct raid5_info	*raid5 = raid_bdev->level_ctx;
+	struct raid5_remove_ctx	*ctx;
+	uint8_t			missing = UINT8_MAX;
+
+	if (!__atomic_compare_exchange_n(&raid5->missing, &missing, slot, false, __ATOMIC_SEQ_CST,
+					 __ATOMIC_SEQ_CST)) {
+		return missing == slot;
+	}
+
+	SPDK_ERRLOG("Base bdev %s of raid bdev %s failed a write, raid bdev is degraded\n",
+		    raid_bdev->base_bdev_info[slot].bdev->name, raid_bdev->bdev.name);
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		/* Unused, they are released when the base bdev is removed */
+		SPDK_ERRLOG("Unable to allocate memory to release base bdev channels\n");
+		return true;
+	}
+
+	ctx->raid_bdev = raid_bdev;
+	ctx->slot = slot;
+	spdk_for_each_channel(raid_bdev, raid5_put_slot_channel, ctx, raid5_fail_done);
+
+	return true;
+}
+
+static void
+raid5_remove_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct raid5_remove_ctx		*ctx = spdk_io_channel_iter_get_ctx(i);
+	struct raid_bdev		*raid_bdev = ctx->raid_bdev;
+	struct raid_base_bdev_info	*info = &raid_bdev->base_bdev_info[ctx->slot];
+
+	if (info->bdev != NULL) {
+		raid_bdev_free_base_bdev_resource(raid_bdev, ctx->slot);
+	}
+	info->remove_scheduled = false;
+
+	free(ctx);
+}
+
+/*
+ * brief:
+ * raid5_remove_base_bdev keeps the raid bdev running without one base bdev, or
+ * releases the base bdev that failed.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * slot - base bdev slot
+ * returns:
+ * 0 - the raid bdev runs degraded
+ * non zero - another base bdev is already missing
+ */
+static int
+raid5_remove_base_bdev(struct raid_bdev *raid_bdev, uint8_t slot)
+{
+	struct raid5_info	*raid5 = raid_bdev->level_ctx;
+	struct raid5_remove_ctx	*ctx;
+	uint8_t			missing = UINT8_MAX;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		SPDK_ERRLOG("Unable to allocate memory to remove base bdev\n");
+		return -ENOMEM;
+	}
+
+	/* A base bdev that failed a write is missing already */
+	if (!__atomic_compare_exchange_n(&raid5->missing, &missing, slot, false, __ATOMIC_SEQ_CST,
+					 __ATOMIC_SEQ_CST) && missing != slot) {
+		free(ctx);
+		return -ENODEV;
+	}
+
+	if (missing == UINT8_MAX) {
+		SPDK_ERRLOG("Base bdev %s removed, raid bdev %s is degraded\n",
+			    raid_bdev->base_bdev_info[slot].bdev->name, raid_bdev->bdev.name);
+	}
+
+	ctx->raid_bdev = raid_bdev;
+	ctx->slot = slot;
+	spdk_for_each_channel(raid_bdev, raid5_put_slot_channel, ctx, raid5_remove_done);
+
+	return 0;
+}
+
+static void
+raid5_dump_info_json(struct raid_bdev *raid_bdev, struct spdk_json_write_ctx *w)
+{
+	struct raid5_info *raid5 = raid_bdev->level_ctx;
+
+	spdk_json_write_named_bool(w, "degraded", raid5 != NULL && raid5->missing != UINT8_MAX);
+}
+
+const struct raid_fn_table g_raid5_fn_table = {
+	.start_rw_request		= raid5_start_rw_request,
+	.submit_null_payload_request	= raid5_submit_null_payload_request,
+	.start				= raid5_start,
+	.stop				= raid5_stop,
+	.remove_base_bdev		= raid5_remove_base_bdev,
+	.dump_info_json			= raid5_dump_info_json,
+	.io_type_supported		= raid5_io_type_supported,
+	.channel_create			= raid5_channel_create,
+	.channel_destroy		= raid5_channel_destroy,
+};
@@ -35,6 +35,7 @@
 #include "spdk/log.h"
 #include "spdk/rpc.h"
 #include "spdk/string.h"
+#include "spdk/thread.h"
 #include "spdk/util.h"
 #include "spdk/histogram_data.h"
 #include "spdk/base64.h"
@@ -208,6 +209,87 @@ spdk_rpc_bdev_get_iostat(struct spdk_jsonrpc_request *request,
 SPDK_RPC_REGISTER("bdev_get_iostat", spdk_rpc_bdev_get_iostat, SPDK_RPC_RUNTIME)
 SPDK_RPC_REGISTER_ALIAS_DEPRECATED(bdev_get_iostat, get_bdevs_iostat)
 
+struct rpc_bdev_get_io_cache_stats_ctx {
+	struct spdk_jsonrpc_request *request;
+	struct spdk_json_write_ctx *w;
+};
+
+static void
+spdk_rpc_bdev_get_io_cache_stat_cb(const struct spdk_bdev_io_cache_stat *stat, void *cb_arg)
+{
+	struct rpc_bdev_get_io_cache_stats_ctx *ctx = cb_arg;
+	struct spdk_json_write_ctx *w = ctx->w;
+	uint32_t i;
+
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_string(w, "name", spdk_thread_get_name(spdk_get_thread()));
+	spdk_json_write_named_uint32(w, "socket_id", stat->socket_id);
+	spdk_json_write_named_uint32(w, "cache_size", stat->cache_size);
+	spdk_json_write_named_uint32(w, "cache_count", stat->cache_count);
+	spdk_json_write_named_uint32(w, "peak_outstanding", stat->peak_outstanding);
+	spdk_json_write_named_uint64(w, "hits", stat->hits);
+	spdk_json_write_named_uint64(w, "misses", stat->misses);
+	spdk_json_write_named_uint64(w, "remote_refills", stat->remote_refills);
+	spdk_json_write_named_uint64(w, "pool_empty", stat->pool_empty);
+	spdk_json_write_named_uint64(w, "grows", stat->grows);
+	spdk_json_write_named_uint64(w, "shrinks", stat->shrinks);
+
+	spdk_json_write_named_array_begin(w, "buf_caches");
+	for (i = 0; i < SPDK_BDEV_NUM_BUF_CLASSES; i++) {
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_uint32(w, "buf_size", stat->buf[i].buf_size);
+		spdk_json_write_named_uint32(w, "cache_count", stat->buf[i].cache_count);
+		spdk_json_write_named_uint64(w, "hits", stat->buf[i].hits);
+		spdk_json_write_named_uint64(w, "misses", stat->buf[i].misses);
+		spdk_json_write_named_uint64(w, "waits", stat->buf[i].waits);
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_array_end(w);
+
+	spdk_json_write_object_end(w);
+}
+
+static void
+spdk_rpc_bdev_get_io_cache_stats_done(void *cb_arg, int rc)
+{
+	struct rpc_bdev_get_io_cache_stats_ctx *ctx = cb_arg;
+
+	spdk_json_write_array_end(ctx->w);
+	spdk_json_write_object_end(ctx->w);
+	spdk_jsonrpc_end_result(ctx->request, ctx->w);
+	free(ctx);
+}
+
+static void
+spdk_rpc_bdev_get_io_cache_stats(struct spdk_jsonrpc_request *request,
+				 const struct spdk_json_val *params)
+{
+	struct rpc_bdev_get_io_cache_stats_ctx *ctx;
+
+	if (params != NULL) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "bdev_get_io_cache_stats requires no parameters");
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		SPDK_ERRLOG("Failed to allocate rpc_bdev_get_io_cache_stats_ctx struct\n");
+		spdk_jsonrpc_send_error_response(request, -ENOMEM, spdk_strerror(ENOMEM));
+		return;
+	}
+
+	ctx->request = request;
+	ctx->w = spdk_jsonrpc_begin_result(request);
+
+	spdk_json_write_object_begin(ctx->w);
+	spdk_json_write_named_array_begin(ctx->w, "threads");
+
+	spdk_bdev_get_io_cache_stats(spdk_rpc_bdev_get_io_cache_stat_cb,
+				     spdk_rpc_bdev_get_io_cache_stats_done, ctx);
+}
+SPDK_RPC_REGISTER("bdev_get_io_cache_stats", spdk_rpc_bdev_get_io_cache_stats, SPDK_RPC_RUNTIME)
+
 static void
 spdk_rpc_dump_bdev_info(struct spdk_json_write_ctx *w,
 			struct spdk_bdev *bdev)
@@ -514,6 +596,225 @@ cleanup:
 SPDK_RPC_REGISTER("bdev_set_qos_limit", spdk_rpc_bdev_set_qos_limit, SPDK_RPC_RUNTIME)
 SPDK_RPC_REGISTER_ALIAS_DEPRECATED(bdev_set_qos_limit, set_bdev_qos_limit)
 
+struct rpc_bdev_set_qos_latency_target {
+	char		*name;
+	uint64_t	latency_target_usec;
+};
+
+static void
+free_rpc_bdev_set_qos_latency_target(struct rpc_bdev_set_qos_latency_target *r)
+{
+	free(r->name);
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_set_qos_latency_target_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_set_qos_latency_target, name), spdk_json_decode_string},
+	{"latency_target_usec", offsetof(struct rpc_bdev_set_qos_latency_target, latency_target_usec), spdk_json_decode_uint64},
+};
+
+static void
+spdk_rpc_bdev_set_qos_latency_target_complete(void *cb_arg, int status)
+{
+	struct spdk_jsonrpc_request *request = cb_arg;
+	struct spdk_json_write_ctx *w;
+
+	if (status != 0) {
+		spdk_jsonrpc_send_error_response_fmt(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						     "Failed to configure latency target: %s",
+						     spdk_strerror(-status));
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+}
+
+static void
+spdk_rpc_bdev_set_qos_latency_target(struct spdk_jsonrpc_request *request,
+				     const struct spdk_json_val *params)
+{
+	struct rpc_bdev_set_qos_latency_target req = {};
+	struct spdk_bdev *bdev;
+
+	if (spdk_json_decode_object(params, rpc_bdev_set_qos_latency_target_decoders,
+				    SPDK_COUNTOF(rpc_bdev_set_qos_latency_target_decoders),
+				    &req)) {
+		SPDK_ERRLOG("spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	bdev = spdk_bdev_get_by_name(req.name);
+	if (bdev == NULL) {
+		SPDK_ERRLOG("bdev '%s' does not exist\n", req.name);
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	spdk_bdev_set_qos_latency_target(bdev, req.latency_target_usec,
+					 spdk_rpc_bdev_set_qos_latency_target_complete, request);
+
+cleanup:
+	free_rpc_bdev_set_qos_latency_target(&req);
+}
+SPDK_RPC_REGISTER("bdev_set_qos_latency_target", spdk_rpc_bdev_set_qos_latency_target,
+		  SPDK_RPC_RUNTIME)
+
+static const char *g_qos_priority_names[SPDK_BDEV_QOS_NUM_PRIORITIES] = {
+	[SPDK_BDEV_QOS_PRIORITY_HIGH] = "high",
+	[SPDK_BDEV_QOS_PRIORITY_LOW] = "low",
+};
+
+struct rpc_bdev_set_qos_priority {
+	char		*name;
+	uint32_t	desc_id;
+	char		*priority;
+};
+
+static void
+free_rpc_bdev_set_qos_priority(struct rpc_bdev_set_qos_priority *r)
+{
+	free(r->name);
+	free(r->priority);
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_set_qos_priority_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_set_qos_priority, name), spdk_json_decode_string},
+	{"desc_id", offsetof(struct rpc_bdev_set_qos_priority, desc_id), spdk_json_decode_uint32},
+	{"priority", offsetof(struct rpc_bdev_set_qos_priority, priority), spdk_json_decode_string},
+};
+
+static void
+spdk_rpc_bdev_set_qos_priority(struct spdk_jsonrpc_request *request,
+			       const struct spdk_json_val *params)
+{
+	struct rpc_bdev_set_qos_priority req = {};
+	struct spdk_json_write_ctx *w;
+	struct spdk_bdev *bdev;
+	int priority, rc;
+
+	if (spdk_json_decode_object(params, rpc_bdev_set_qos_priority_decoders,
+				    SPDK_COUNTOF(rpc_bdev_set_qos_priority_decoders),
+				    &req)) {
+		SPDK_ERRLOG("spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	bdev = spdk_bdev_get_by_name(req.name);
+	if (bdev == NULL) {
+		SPDK_ERRLOG("bdev '%s' does not exist\n", req.name);
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	for (priority = 0; priority < SPDK_BDEV_QOS_NUM_PRIORITIES; priority++) {
+		if (strcmp(req.priority, g_qos_priority_names[priority]) == 0) {
+			break;
+		}
+	}
+	if (priority == SPDK_BDEV_QOS_NUM_PRIORITIES) {
+		spdk_jsonrpc_send_error_response_fmt(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						     "Invalid priority: %s", req.priority);
+		goto cleanup;
+	}
+
+	rc = spdk_bdev_set_qos_priority_by_desc_id(bdev, req.desc_id, priority);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response_fmt(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						     "Failed to set priority of descriptor %" PRIu32 ": %s",
+						     req.desc_id, spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+
+cleanup:
+	free_rpc_bdev_set_qos_priority(&req);
+}
+SPDK_RPC_REGISTER("bdev_set_qos_priority", spdk_rpc_bdev_set_qos_priority, SPDK_RPC_RUNTIME)
+
+struct rpc_bdev_get_qos_latency_stats {
+	char *name;
+};
+
+static void
+free_rpc_bdev_get_qos_latency_stats(struct rpc_bdev_get_qos_latency_stats *r)
+{
+	free(r->name);
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_get_qos_latency_stats_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_get_qos_latency_stats, name), spdk_json_decode_string},
+};
+
+static void
+spdk_rpc_dump_desc_info(void *ctx, const struct spdk_bdev_desc_info *info)
+{
+	struct spdk_json_write_ctx *w = ctx;
+
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_uint32(w, "id", info->id);
+	spdk_json_write_named_string(w, "thread", spdk_thread_get_name(info->thread));
+	spdk_json_write_named_bool(w, "write", info->write);
+	spdk_json_write_named_string(w, "priority", g_qos_priority_names[info->qos_priority]);
+	spdk_json_write_object_end(w);
+}
+
+static void
+spdk_rpc_bdev_get_qos_latency_stats(struct spdk_jsonrpc_request *request,
+				    const struct spdk_json_val *params)
+{
+	struct rpc_bdev_get_qos_latency_stats req = {};
+	struct spdk_bdev_qos_latency_stat stat;
+	struct spdk_json_write_ctx *w;
+	struct spdk_bdev *bdev;
+
+	if (spdk_json_decode_object(params, rpc_bdev_get_qos_latency_stats_decoders,
+				    SPDK_COUNTOF(rpc_bdev_get_qos_latency_stats_decoders),
+				    &req)) {
+		SPDK_ERRLOG("spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	bdev = spdk_bdev_get_by_name(req.name);
+	if (bdev == NULL) {
+		SPDK_ERRLOG("bdev '%s' does not exist\n", req.name);
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	spdk_bdev_get_qos_latency_stat(bdev, &stat);
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_string(w, "name", spdk_bdev_get_name(bdev));
+	spdk_json_write_named_uint64(w, "latency_target_usec", stat.latency_target_usec);
+	spdk_json_write_named_uint64(w, "p99_latency_usec", stat.p99_latency_usec);
+	spdk_json_write_named_uint64(w, "low_priority_ios_per_sec", stat.low_priority_ios_per_sec);
+	spdk_json_write_named_uint64(w, "windows", stat.windows);
+	spdk_json_write_named_uint64(w, "violations", stat.violations);
+
+	spdk_json_write_named_array_begin(w, "descriptors");
+	spdk_bdev_get_desc_info(bdev, spdk_rpc_dump_desc_info, w);
+	spdk_json_write_array_end(w);
+
+	spdk_json_write_object_end(w);
+	spdk_jsonrpc_end_result(request, w);
+
+cleanup:
+	free_rpc_bdev_get_qos_latency_stats(&req);
+}
+SPDK_RPC_REGISTER("bdev_get_qos_latency_stats", spdk_rpc_bdev_get_qos_latency_stats,
+		  SPDK_RPC_RUNTIME)
+
 /* SPDK_RPC_ENABLE_BDEV_HISTOGRAM */
 
 struct rpc_bdev_enable_histogram_request {
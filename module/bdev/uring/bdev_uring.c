@@ -46,12 +46,28 @@
 #include "spdk/util.h"
 #include "spdk/string.h"
 
+#include "spdk_internal/assert.h"
 #include "spdk_internal/log.h"
 
 #include <liburing.h>
 
+#define SPDK_URING_QUEUE_DEPTH 512
+#define MAX_EVENTS_PER_POLL 32
+
+/* Files registered with each ring, i.e. uring bdevs a thread can do I/O to with fixed files */
+#define SPDK_URING_MAX_FILES 64
+
+/* Regions of SPDK memory that can be registered as fixed buffers */
+#define SPDK_URING_MAX_BUFFERS 1024
+
+/* The kernel doesn't accept fixed buffers larger than 1 GiB */
+#define SPDK_URING_MAX_BUFFER_SIZE (1ULL << 30)
+
 struct bdev_uring_io_channel {
 	struct bdev_uring_group_channel		*group_ch;
+
+	/* Index of the bdev's file in the registered files of the ring, or -1 */
+	int					file_index;
 };
 
 struct bdev_uring_group_channel {
@@ -59,6 +75,14 @@ struct bdev_uring_group_channel {
 	uint64_t				io_pending;
 	struct spdk_poller			*poller;
 	struct io_uring				uring;
+	bool					sq_poll;
+
+	/* Registered files, -1 for free slots */
+	bool					files_registered;
+	int					files[SPDK_URING_MAX_FILES];
+
+	/* Index in the registered buffers of the ring of each region in g_uring_buffers, or -1 */
+	int					buf_index[SPDK_URING_MAX_BUFFERS];
 };
 
 struct bdev_uring_task {
@@ -76,11 +100,28 @@ struct bdev_uring {
 
 static int bdev_uring_init(void);
 static void bdev_uring_fini(void);
+static int bdev_uring_config_json(struct spdk_json_write_ctx *w);
 static void uring_free_bdev(struct bdev_uring *uring);
 static TAILQ_HEAD(, bdev_uring) g_uring_bdev_head;
 
-#define SPDK_URING_QUEUE_DEPTH 512
-#define MAX_EVENTS_PER_POLL 32
+static struct bdev_uring_opts g_opts = {
+	.sq_poll = false,
+	.sq_thread_idle_ms = 1000,
+	.fixed_files = false,
+	.fixed_buffers = false,
+};
+
+static bool g_uring_initialized;
+
+/*
+ * Regions of SPDK memory to register as fixed buffers. g_uring_mem_map translates an
+ * address to the index of its region + 1. Regions which were unregistered from SPDK
+ * have a length of 0.
+ */
+static struct spdk_mem_map *g_uring_mem_map;
+static struct iovec g_uring_buffers[SPDK_URING_MAX_BUFFERS];
+static uint32_t g_uring_buffer_count;
+static pthread_mutex_t g_uring_buffers_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static int
 bdev_uring_get_ctx_size(void)
@@ -93,6 +134,7 @@ static struct spdk_bdev_module uring_if = {
 	.module_init	= bdev_uring_init,
 	.module_fini	= bdev_uring_fini,
 	.config_text	= NULL,
+	.config_json	= bdev_uring_config_json,
 	.get_ctx_size	= bdev_uring_get_ctx_size,
 };
 
@@ -137,6 +179,140 @@ bdev_uring_close(struct bdev_uring *bdev)
 	return 0;
 }
 
+void
+bdev_uring_get_opts(struct bdev_uring_opts *opts)
+{
+	*opts = g_opts;
+}
+
+int
+bdev_uring_set_opts(const struct bdev_uring_opts *opts)
+{
+	if (g_uring_initialized) {
+		return -EPERM;
+	}
+
+	g_opts = *opts;
+	return 0;
+}
+
+static int
+bdev_uring_mem_notify(void *cb_ctx, struct spdk_mem_map *map,
+		      enum spdk_mem_map_notify_action action,
+		      void *vaddr, size_t size)
+{
+	uint64_t offset, len, id;
+	int rc = 0;
+
+	pthread_mutex_lock(&g_uring_buffers_lock);
+
+	switch (action) {
+	case SPDK_MEM_MAP_NOTIFY_REGISTER:
+		for (offset = 0; offset < size; offset += len) {
+			len = spdk_min(size - offset, SPDK_URING_MAX_BUFFER_SIZE);
+			if (g_uring_buffer_count == SPDK_URING_MAX_BUFFERS) {
+				/* I/O to the rest of the memory just doesn't use fixed buffers */
+				break;
+			}
+
+			id = g_uring_buffer_count++;
+			g_uring_buffers[id].iov_base = (uint8_t *)vaddr + offset;
+			g_uring_buffers[id].iov_len = len;
+			rc = spdk_mem_map_set_translation(map, (uint64_t)vaddr + offset, len, id + 1);
+			if (rc != 0) {
+				break;
+			}
+		}
+		break;
+	case SPDK_MEM_MAP_NOTIFY_UNREGISTER:
+		for (offset = 0; offset < size; offset += len) {
+			len = size - offset;
+			id = spdk_mem_map_translate(map, (uint64_t)vaddr + offset, &len);
+			if (id != 0) {
+				g_uring_buffers[id - 1].iov_base = NULL;
+				g_uring_buffers[id - 1].iov_len = 0;
+			}
+		}
+		rc = spdk_mem_map_clear_translation(map, (uint64_t)vaddr, size);
+		break;
+	default:
+		SPDK_UNREACHABLE();
+	}
+
+	pthread_mutex_unlock(&g_uring_buffers_lock);
+
+	return rc;
+}
+
+static int
+bdev_uring_mem_are_contiguous(uint64_t id1, uint64_t id2)
+{
+	/* Fixed buffers can't span regions */
+	return id1 == id2;
+}
+
+static const struct spdk_mem_map_ops g_uring_mem_map_ops = {
+	.notify_cb = bdev_uring_mem_notify,
+	.are_contiguous = bdev_uring_mem_are_contiguous,
+};
+
+/* Returns the index of the fixed buffer containing the whole buffer, or -1 */
+static int
+bdev_uring_get_buf_index(struct bdev_uring_group_channel *group_ch, void *buf, uint64_t nbytes)
+{
+	uint64_t size = nbytes;
+	uint64_t id;
+
+	if (g_uring_mem_map == NULL) {
+		return -1;
+	}
+
+	id = spdk_mem_map_translate(g_uring_mem_map, (uint64_t)buf, &size);
+	if (id == 0 || size < nbytes) {
+		return -1;
+	}
+
+	return group_ch->buf_index[id - 1];
+}
+
+static struct io_uring_sqe *
+bdev_uring_get_sqe(struct bdev_uring_group_channel *group_ch)
+{
+	/* Don't let more I/O be in flight than the completion queue can hold */
+	if (spdk_unlikely(group_ch->io_inflight + group_ch->io_pending >= SPDK_URING_QUEUE_DEPTH)) {
+		return NULL;
+	}
+
+	return io_uring_get_sqe(&group_ch->uring);
+}
+
+static void
+bdev_uring_prep_rw(struct io_uring_sqe *sqe, struct bdev_uring *uring,
+		   struct bdev_uring_io_channel *uring_ch, bool write,
+		   struct iovec *iov, int iovcnt, uint64_t offset)
+{
+	int fd = uring_ch->file_index >= 0 ? uring_ch->file_index : uring->fd;
+	int buf_index = -1;
+
+	if (iovcnt == 1) {
+		buf_index = bdev_uring_get_buf_index(uring_ch->group_ch, iov[0].iov_base, iov[0].iov_len);
+	}
+
+	if (buf_index >= 0 && write) {
+		io_uring_prep_write_fixed(sqe, fd, iov[0].iov_base, iov[0].iov_len, offset, buf_index);
+	} else if (buf_index >= 0) {
+		io_uring_prep_read_fixed(sqe, fd, iov[0].iov_base, iov[0].iov_len, offset, buf_index);
+	} else if (write) {
+		io_uring_prep_writev(sqe, fd, iov, iovcnt, offset);
+	} else {
+		io_uring_prep_readv(sqe, fd, iov, iovcnt, offset);
+	}
+
+	if (uring_ch->file_index >= 0) {
+		sqe->flags |= IOSQE_FIXED_FILE;
+	}
+}
+
 static int64_t
 bdev_uring_readv(struct bdev_uring *uring, struct spdk_io_channel *ch,
 		 struct bdev_uring_task *uring_task,
@@ -146,8 +322,11 @@ bdev_uring_readv(struct bdev_uring *uring, struct spdk_io_channel *ch,
 	struct bdev_uring_group_channel *group_ch = uring_ch->group_ch;
 	struct io_uring_sqe *sqe;
 
-	sqe = io_uring_get_sqe(&group_ch->uring);
-	io_uring_prep_readv(sqe, uring->fd, iov, iovcnt, offset);
+	sqe = bdev_uring_get_sqe(group_ch);
+	if (spdk_unlikely(sqe == NULL)) {
+		return -ENOMEM;
+	}
+	bdev_uring_prep_rw(sqe, uring, uring_ch, false, iov, iovcnt, offset);
 	io_uring_sqe_set_data(sqe, uring_task);
 	uring_task->len = nbytes;
 	uring_task->ch = uring_ch;
@@ -168,8 +347,11 @@ bdev_uring_writev(struct bdev_uring *uring, struct spdk_io_channel *ch,
 	struct bdev_uring_group_channel *group_ch = uring_ch->group_ch;
 	struct io_uring_sqe *sqe;
 
-	sqe = io_uring_get_sqe(&group_ch->uring);
-	io_uring_prep_writev(sqe, uring->fd, iov, iovcnt, offset);
+	sqe = bdev_uring_get_sqe(group_ch);
+	if (spdk_unlikely(sqe == NULL)) {
+		return -ENOMEM;
+	}
+	bdev_uring_prep_rw(sqe, uring, uring_ch, true, iov, iovcnt, offset);
 	io_uring_sqe_set_data(sqe, uring_task);
 	uring_task->len = nbytes;
 	uring_task->ch = uring_ch;
@@ -249,9 +431,10 @@ bdev_uring_group_poll(void *arg)
 		ret = io_uring_submit(&group_ch->uring);
 		group_ch->io_pending = 0;
 		group_ch->io_inflight += to_submit;
-	} else if (to_complete > 0) {
+	} else if (to_complete > 0 && !group_ch->sq_poll) {
 		/* If there are I/O in flight but none to submit, we need to
-		 * call io_uring_enter ourselves. */
+		 * call io_uring_enter ourselves. With SQ polling the kernel
+		 * thread reaps completions of polled I/O itself. */
 		ret = io_uring_enter(group_ch->uring.ring_fd, 0, 0,
 				     IORING_ENTER_GETEVENTS, NULL);
 	}
@@ -271,6 +454,8 @@ bdev_uring_group_poll(void *arg)
 static void bdev_uring_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io,
 				  bool success)
 {
+	int64_t rc;
+
 	if (!success) {
 		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
 		return;
@@ -278,7 +463,7 @@ static void bdev_uring_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_i
 
 	switch (bdev_io->type) {
 	case SPDK_BDEV_IO_TYPE_READ:
-		bdev_uring_readv((struct bdev_uring *)bdev_io->bdev->ctxt,
+		rc = bdev_uring_readv((struct bdev_uring *)bdev_io->bdev->ctxt,
 				 ch,
 				 (struct bdev_uring_task *)bdev_io->driver_ctx,
 				 bdev_io->u.bdev.iovs,
@@ -287,7 +472,7 @@ static void bdev_uring_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_i
 				 bdev_io->u.bdev.offset_blocks * bdev_io->bdev->blocklen);
 		break;
 	case SPDK_BDEV_IO_TYPE_WRITE:
-		bdev_uring_writev((struct bdev_uring *)bdev_io->bdev->ctxt,
+		rc = bdev_uring_writev((struct bdev_uring *)bdev_io->bdev->ctxt,
 				  ch,
 				  (struct bdev_uring_task *)bdev_io->driver_ctx,
 				  bdev_io->u.bdev.iovs,
@@ -297,8 +482,15 @@ static void bdev_uring_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_i
 		break;
 	default:
 		SPDK_ERRLOG("Wrong io type\n");
+		rc = -EINVAL;
 		break;
 	}
+
+	if (rc == -ENOMEM) {
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_NOMEM);
+	} else if (rc < 0) {
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+	}
 }
 
 static int _bdev_uring_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
@@ -336,12 +528,52 @@ bdev_uring_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type)
 	}
 }
 
+/* Registers the file with the ring of the thread and returns its index, or -1 */
+static int
+bdev_uring_group_add_file(struct bdev_uring_group_channel *group_ch, int fd)
+{
+	int i, rc;
+
+	if (!group_ch->files_registered) {
+		return -1;
+	}
+
+	for (i = 0; i < SPDK_URING_MAX_FILES; i++) {
+		if (group_ch->files[i] == -1) {
+			break;
+		}
+	}
+	if (i == SPDK_URING_MAX_FILES) {
+		return -1;
+	}
+
+	rc = io_uring_register_files_update(&group_ch->uring, i, &fd, 1);
+	if (rc < 0) {
+		SPDK_WARNLOG("Unable to register fd %d with io_uring: %s\n", fd, spdk_strerror(-rc));
+		return -1;
+	}
+
+	group_ch->files[i] = fd;
+	return i;
+}
+
+static void
+bdev_uring_group_remove_file(struct bdev_uring_group_channel *group_ch, int index)
+{
+	int fd = -1;
+
+	io_uring_register_files_update(&group_ch->uring, index, &fd, 1);
+	group_ch->files[index] = -1;
+}
+
 static int
 bdev_uring_create_cb(void *io_device, void *ctx_buf)
 {
 	struct bdev_uring_io_channel *ch = ctx_buf;
+	struct bdev_uring *uring = io_device;
 
 	ch->group_ch = spdk_io_channel_get_ctx(spdk_get_io_channel(&uring_if));
+	ch->file_index = bdev_uring_group_add_file(ch->group_ch, uring->fd);
 
 	return 0;
 }
@@ -351,6 +583,9 @@ bdev_uring_destroy_cb(void *io_device, void *ctx_buf)
 {
 	struct bdev_uring_io_channel *ch = ctx_buf;
 
+	if (ch->file_index >= 0) {
+		bdev_uring_group_remove_file(ch->group_ch, ch->file_index);
+	}
 	spdk_put_io_channel(spdk_io_channel_from_ctx(ch->group_ch));
 }
 
@@ -363,11 +598,29 @@ bdev_uring_get_io_channel(void *ctx)
 }
 
 
+static void
+bdev_uring_write_json_config(struct spdk_bdev *bdev, struct spdk_json_write_ctx *w)
+{
+	struct bdev_uring *uring = bdev->ctxt;
+
+	spdk_json_write_object_begin(w);
+
+	spdk_json_write_named_string(w, "method", "bdev_uring_create");
+
+	spdk_json_write_named_object_begin(w, "params");
+	spdk_json_write_named_string(w, "name", bdev->name);
+	spdk_json_write_named_string(w, "filename", uring->filename);
+	spdk_json_write_object_end(w);
+
+	spdk_json_write_object_end(w);
+}
+
 static const struct spdk_bdev_fn_table uring_fn_table = {
 	.destruct		= bdev_uring_destruct,
 	.submit_request		= bdev_uring_submit_request,
 	.io_type_supported	= bdev_uring_io_type_supported,
 	.get_io_channel		= bdev_uring_get_io_channel,
+	.write_config_json	= bdev_uring_write_json_config,
 };
 
 static void uring_free_bdev(struct bdev_uring *uring)
@@ -380,17 +633,103 @@ static void uring_free_bdev(struct bdev_uring *uring)
 	free(uring);
 }
 
+static void
+bdev_uring_group_register_buffers(struct bdev_uring_group_channel *ch)
+{
+	struct iovec *iovs;
+	uint32_t i, count = 0;
+	int rc;
+
+	for (i = 0; i < SPDK_URING_MAX_BUFFERS; i++) {
+		ch->buf_index[i] = -1;
+	}
+
+	if (g_uring_mem_map == NULL) {
+		return;
+	}
+
+	iovs = calloc(SPDK_URING_MAX_BUFFERS, sizeof(*iovs));
+	if (iovs == NULL) {
+		return;
+	}
+
+	pthread_mutex_lock(&g_uring_buffers_lock);
+	for (i = 0; i < g_uring_buffer_count; i++) {
+		if (g_uring_buffers[i].iov_len != 0) {
+			ch->buf_index[i] = count;
+			iovs[count++] = g_uring_buffers[i];
+		}
+	}
+	pthread_mutex_unlock(&g_uring_buffers_lock);
+
+	if (count > 0) {
+		rc = io_uring_register_buffers(&ch->uring, iovs, count);
+		if (rc < 0) {
+			SPDK_WARNLOG("Unable to register %" PRIu32 " buffers with io_uring: %s\n",
+				     count, spdk_strerror(-rc));
+			for (i = 0; i < SPDK_URING_MAX_BUFFERS; i++) {
+				ch->buf_index[i] = -1;
+			}
+		}
+	}
+
+	free(iovs);
+}
+
+static void
+bdev_uring_group_register_files(struct bdev_uring_group_channel *ch)
+{
+	int i, rc;
+
+	for (i = 0; i < SPDK_URING_MAX_FILES; i++) {
+		ch->files[i] = -1;
+	}
+
+	ch->files_registered = false;
+	if (!g_opts.fixed_files && !ch->sq_poll) {
+		return;
+	}
+
+	rc = io_uring_register_files(&ch->uring, ch->files, SPDK_URING_MAX_FILES);
+	if (rc < 0) {
+		SPDK_WARNLOG("Unable to register files with io_uring: %s\n", spdk_strerror(-rc));
+		return;
+	}
+
+	ch->files_registered = true;
+}
+
 static int
 bdev_uring_group_create_cb(void *io_device, void *ctx_buf)
 {
 	struct bdev_uring_group_channel *ch = ctx_buf;
+	struct io_uring_params params = {};
+	int rc;
+
+	params.flags = IORING_SETUP_IOPOLL;
+	if (g_opts.sq_poll) {
+		params.flags |= IORING_SETUP_SQPOLL;
+		params.sq_thread_idle = g_opts.sq_thread_idle_ms;
+	}
 
-	if (io_uring_queue_init(SPDK_URING_QUEUE_DEPTH, &ch->uring, IORING_SETUP_IOPOLL) < 0) {
+	rc = io_uring_queue_init_params(SPDK_URING_QUEUE_DEPTH, &ch->uring, &params);
+	if (rc < 0 && g_opts.sq_poll) {
+		SPDK_WARNLOG("Unable to set up io_uring with SQ polling (%s), submitting with syscalls\n",
+			     spdk_strerror(-rc));
+		memset(&params, 0, sizeof(params));
+		params.flags = IORING_SETUP_IOPOLL;
+		rc = io_uring_queue_init_params(SPDK_URING_QUEUE_DEPTH, &ch->uring, &params);
+	}
+	if (rc < 0) {
 		SPDK_ERRLOG("uring I/O context setup failure\n");
 		return -1;
 	}
+	ch->sq_poll = (params.flags & IORING_SETUP_SQPOLL) != 0;
 
-	ch->poller = spdk_poller_register(bdev_uring_group_poll, ch, 0);
+	bdev_uring_group_register_files(ch);
+	bdev_uring_group_register_buffers(ch);
+
+	ch->poller = SPDK_POLLER_REGISTER(bdev_uring_group_poll, ch, 0);
 	return 0;
 }
 
@@ -531,6 +870,15 @@ bdev_uring_init(void)
 	struct spdk_bdev *bdev;
 
 	TAILQ_INIT(&g_uring_bdev_head);
+	g_uring_initialized = true;
+
+	if (g_opts.fixed_buffers) {
+		g_uring_mem_map = spdk_mem_map_alloc(0, &g_uring_mem_map_ops, NULL);
+		if (g_uring_mem_map == NULL) {
+			SPDK_WARNLOG("Unable to allocate memory map, not using fixed buffers\n");
+		}
+	}
+
 	spdk_io_device_register(&uring_if, bdev_uring_group_create_cb, bdev_uring_group_destroy_cb,
 				sizeof(struct bdev_uring_group_channel),
 				"uring_module");
@@ -574,6 +922,30 @@ static void
 bdev_uring_fini(void)
 {
 	spdk_io_device_unregister(&uring_if, NULL);
+	if (g_uring_mem_map != NULL) {
+		spdk_mem_map_free(&g_uring_mem_map);
+	}
+	g_uring_buffer_count = 0;
+	g_uring_initialized = false;
+}
+
+static int
+bdev_uring_config_json(struct spdk_json_write_ctx *w)
+{
+	spdk_json_write_object_begin(w);
+
+	spdk_json_write_named_string(w, "method", "bdev_uring_set_options");
+
+	spdk_json_write_named_object_begin(w, "params");
+	spdk_json_write_named_bool(w, "sq_poll", g_opts.sq_poll);
+	spdk_json_write_named_uint32(w, "sq_thread_idle_ms", g_opts.sq_thread_idle_ms);
+	spdk_json_write_named_bool(w, "fixed_files", g_opts.fixed_files);
+	spdk_json_write_named_bool(w, "fixed_buffers", g_opts.fixed_buffers);
+	spdk_json_write_object_end(w);
+
+	spdk_json_write_object_end(w);
+
+	return 0;
 }
 
 SPDK_LOG_REGISTER_COMPONENT("uring", SPDK_LOG_URING)
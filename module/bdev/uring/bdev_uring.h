@@ -43,6 +43,22 @@
 
 typedef void (*spdk_delete_uring_complete)(void *cb_arg, int bdeverrno);
 
+struct bdev_uring_opts {
+	/* Let a kernel thread poll the submission queues instead of calling io_uring_enter() */
+	bool		sq_poll;
+	/* Milliseconds without I/O after which the kernel thread goes to sleep */
+	uint32_t	sq_thread_idle_ms;
+	/* Register the files of the bdevs with the rings. Implied by sq_poll. */
+	bool		fixed_files;
+	/* Register SPDK memory with the rings and submit I/O on it as fixed buffers */
+	bool		fixed_buffers;
+};
+
+void bdev_uring_get_opts(struct bdev_uring_opts *opts);
+
+/* Options can only be changed before the module is initialized. */
+int bdev_uring_set_opts(const struct bdev_uring_opts *opts);
+
 struct spdk_bdev *create_uring_bdev(const char *name, const char *filename);
 
 void delete_uring_bdev(struct spdk_bdev *bdev, spdk_delete_uring_complete cb_fn, void *cb_arg);
@@ -185,6 +185,43 @@ ioat_copy_submit_fill(void *cb_arg, struct spdk_io_channel *ch, void *dst, uint8
 	return spdk_ioat_submit_fill(ioat_ch->ioat_ch, ioat_task, ioat_done, dst, fill64, nbytes);
 }
 
+static int
+ioat_copy_build(void *cb_arg, struct spdk_io_channel *ch, void *dst, void *src, uint64_t nbytes,
+		spdk_copy_completion_cb cb)
+{
+	struct ioat_task *ioat_task = (struct ioat_task *)cb_arg;
+	struct ioat_io_channel *ioat_ch = spdk_io_channel_get_ctx(ch);
+
+	assert(ioat_ch->ioat_ch != NULL);
+
+	ioat_task->cb = cb;
+
+	return spdk_ioat_build_copy(ioat_ch->ioat_ch, ioat_task, ioat_done, dst, src, nbytes);
+}
+
+static int
+ioat_copy_build_fill(void *cb_arg, struct spdk_io_channel *ch, void *dst, uint8_t fill,
+		     uint64_t nbytes, spdk_copy_completion_cb cb)
+{
+	struct ioat_task *ioat_task = (struct ioat_task *)cb_arg;
+	struct ioat_io_channel *ioat_ch = spdk_io_channel_get_ctx(ch);
+	uint64_t fill64 = 0x0101010101010101ULL * fill;
+
+	assert(ioat_ch->ioat_ch != NULL);
+
+	ioat_task->cb = cb;
+
+	return spdk_ioat_build_fill(ioat_ch->ioat_ch, ioat_task, ioat_done, dst, fill64, nbytes);
+}
+
+static void
+ioat_copy_flush(struct spdk_io_channel *ch)
+{
+	struct ioat_io_channel *ioat_ch = spdk_io_channel_get_ctx(ch);
+
+	spdk_ioat_flush(ioat_ch->ioat_ch);
+}
+
 static int
 ioat_poll(void *arg)
 {
@@ -200,6 +237,9 @@ static struct spdk_io_channel *ioat_get_io_channel(void);
 static struct spdk_copy_engine ioat_copy_engine = {
 	.copy		= ioat_copy_submit,
 	.fill		= ioat_copy_submit_fill,
+	.build_copy	= ioat_copy_build,
+	.build_fill	= ioat_copy_build_fill,
+	.flush		= ioat_copy_flush,
 	.get_io_channel	= ioat_get_io_channel,
 };
 
@@ -216,7 +256,7 @@ ioat_create_cb(void *io_device, void *ctx_buf)
 
 	ch->ioat_dev = ioat_dev;
 	ch->ioat_ch = ioat_dev->ioat;
-	ch->poller = spdk_poller_register(ioat_poll, ch->ioat_ch, 0);
+	ch->poller = SPDK_POLLER_REGISTER(ioat_poll, ch->ioat_ch, 0);
 	return 0;
 }
 
@@ -178,6 +178,8 @@ rpc_thread_get_stats(void *arg)
 	if (0 == spdk_thread_get_stats(&stats)) {
 		spdk_json_write_object_begin(ctx->w);
 		spdk_json_write_named_string(ctx->w, "name", spdk_thread_get_name(spdk_get_thread()));
+		spdk_json_write_named_uint64(ctx->w, "id", spdk_thread_get_id(spdk_get_thread()));
+		spdk_json_write_named_uint32(ctx->w, "lcore", spdk_env_get_current_core());
 		spdk_json_write_named_uint64(ctx->w, "busy", stats.busy_tsc);
 		spdk_json_write_named_uint64(ctx->w, "idle", stats.idle_tsc);
 		spdk_json_write_object_end(ctx->w);
@@ -213,3 +215,271 @@ spdk_rpc_thread_get_stats(struct spdk_jsonrpc_request *request,
 }
 
 SPDK_RPC_REGISTER("thread_get_stats", spdk_rpc_thread_get_stats, SPDK_RPC_RUNTIME)
+
+static void
+rpc_thread_write_pollers(struct spdk_json_write_ctx *w, struct spdk_thread *thread, bool timed)
+{
+	struct spdk_poller *poller;
+	struct spdk_poller_stats stats;
+	uint64_t period_ticks;
+
+	for (poller = spdk_thread_get_first_poller(thread); poller != NULL;
+	     poller = spdk_thread_get_next_poller(poller)) {
+		period_ticks = spdk_poller_get_period_ticks(poller);
+		if ((period_ticks != 0) != timed) {
+			continue;
+		}
+
+		spdk_poller_get_stats(poller, &stats);
+
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_string(w, "name", spdk_poller_get_name(poller));
+		if (timed) {
+			spdk_json_write_named_uint64(w, "period_ticks", period_ticks);
+		}
+		spdk_json_write_named_uint64(w, "run_count", stats.run_count);
+		spdk_json_write_named_uint64(w, "busy_count", stats.busy_count);
+		spdk_json_write_named_uint64(w, "run_tsc", stats.run_tsc);
+		spdk_json_write_named_uint64(w, "busy_tsc", stats.busy_tsc);
+		spdk_json_write_object_end(w);
+	}
+}
+
+static void
+rpc_thread_get_pollers(void *arg)
+{
+	struct rpc_thread_get_stats_ctx *ctx = arg;
+	struct spdk_thread *thread = spdk_get_thread();
+
+	spdk_json_write_object_begin(ctx->w);
+	spdk_json_write_named_string(ctx->w, "name", spdk_thread_get_name(thread));
+	spdk_json_write_named_uint64(ctx->w, "id", spdk_thread_get_id(thread));
+	spdk_json_write_named_uint32(ctx->w, "lcore", spdk_env_get_current_core());
+
+	spdk_json_write_named_array_begin(ctx->w, "active_pollers");
+	rpc_thread_write_pollers(ctx->w, thread, false);
+	spdk_json_write_array_end(ctx->w);
+
+	spdk_json_write_named_array_begin(ctx->w, "timed_pollers");
+	rpc_thread_write_pollers(ctx->w, thread, true);
+	spdk_json_write_array_end(ctx->w);
+
+	spdk_json_write_object_end(ctx->w);
+}
+
+static void
+spdk_rpc_thread_get_pollers(struct spdk_jsonrpc_request *request,
+			    const struct spdk_json_val *params)
+{
+	struct rpc_thread_get_stats_ctx *ctx;
+
+	if (params) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "'thread_get_pollers' requires no arguments");
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "Memory allocation error");
+		return;
+	}
+	ctx->request = request;
+
+	ctx->w = spdk_jsonrpc_begin_result(ctx->request);
+	spdk_json_write_object_begin(ctx->w);
+	spdk_json_write_named_uint64(ctx->w, "tick_rate", spdk_get_ticks_hz());
+	spdk_json_write_named_array_begin(ctx->w, "threads");
+
+	spdk_for_each_thread(rpc_thread_get_pollers, ctx, rpc_thread_get_stats_done);
+}
+
+SPDK_RPC_REGISTER("thread_get_pollers", spdk_rpc_thread_get_pollers, SPDK_RPC_RUNTIME)
+
+struct rpc_framework_set_scheduler {
+	char *name;
+	uint64_t period;
+};
+
+static void
+free_rpc_framework_set_scheduler(struct rpc_framework_set_scheduler *r)
+{
+	free(r->name);
+}
+
+static const struct spdk_json_object_decoder rpc_framework_set_scheduler_decoders[] = {
+	{"name", offsetof(struct rpc_framework_set_scheduler, name), spdk_json_decode_string},
+	{"period", offsetof(struct rpc_framework_set_scheduler, period), spdk_json_decode_uint64, true},
+};
+
+static void
+spdk_rpc_framework_set_scheduler(struct spdk_jsonrpc_request *request,
+				 const struct spdk_json_val *params)
+{
+	struct rpc_framework_set_scheduler req = {};
+	struct spdk_json_write_ctx *w;
+	int rc;
+
+	if (spdk_json_decode_object(params, rpc_framework_set_scheduler_decoders,
+				    SPDK_COUNTOF(rpc_framework_set_scheduler_decoders),
+				    &req)) {
+		SPDK_DEBUGLOG(SPDK_LOG_REACTOR, "spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "Invalid parameters");
+		goto end;
+	}
+
+	rc = spdk_reactor_set_scheduler(req.name, req.period);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		goto end;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+
+end:
+	free_rpc_framework_set_scheduler(&req);
+}
+SPDK_RPC_REGISTER("framework_set_scheduler", spdk_rpc_framework_set_scheduler, SPDK_RPC_RUNTIME)
+
+#define RPC_MAX_MIGRATIONS 64
+
+static void
+spdk_rpc_framework_get_scheduler(struct spdk_jsonrpc_request *request,
+				 const struct spdk_json_val *params)
+{
+	struct spdk_reactor_scheduler_info info;
+	struct spdk_reactor_migration *migrations;
+	struct spdk_json_write_ctx *w;
+	uint32_t i, count;
+
+	if (params) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "'framework_get_scheduler' requires no arguments");
+		return;
+	}
+
+	migrations = calloc(RPC_MAX_MIGRATIONS, sizeof(*migrations));
+	if (!migrations) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "Memory allocation error");
+		return;
+	}
+
+	spdk_reactor_get_scheduler_info(&info);
+	count = spdk_reactor_get_migrations(migrations, RPC_MAX_MIGRATIONS);
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_string(w, "name", info.name);
+	spdk_json_write_named_uint64(w, "period", info.period_usec);
+	spdk_json_write_named_uint64(w, "tick_rate", spdk_get_ticks_hz());
+	spdk_json_write_named_uint64(w, "migrations", info.migrations);
+	spdk_json_write_named_uint64(w, "steals", info.steals);
+
+	spdk_json_write_named_array_begin(w, "recent_migrations");
+	for (i = 0; i < count; i++) {
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_string(w, "thread", migrations[i].thread_name);
+		spdk_json_write_named_uint32(w, "src_lcore", migrations[i].src_lcore);
+		spdk_json_write_named_uint32(w, "dst_lcore", migrations[i].dst_lcore);
+		spdk_json_write_named_bool(w, "stolen", migrations[i].stolen);
+		spdk_json_write_named_uint64(w, "tsc", migrations[i].tsc);
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_array_end(w);
+
+	spdk_json_write_object_end(w);
+	spdk_jsonrpc_end_result(request, w);
+
+	free(migrations);
+}
+SPDK_RPC_REGISTER("framework_get_scheduler", spdk_rpc_framework_get_scheduler, SPDK_RPC_RUNTIME)
+
+struct rpc_framework_set_interrupt_mode {
+	bool enabled;
+	uint64_t idle_period;
+};
+
+static const struct spdk_json_object_decoder rpc_framework_set_interrupt_mode_decoders[] = {
+	{"enabled", offsetof(struct rpc_framework_set_interrupt_mode, enabled), spdk_json_decode_bool},
+	{"idle_period", offsetof(struct rpc_framework_set_interrupt_mode, idle_period), spdk_json_decode_uint64, true},
+};
+
+static void
+spdk_rpc_framework_set_interrupt_mode(struct spdk_jsonrpc_request *request,
+				      const struct spdk_json_val *params)
+{
+	struct rpc_framework_set_interrupt_mode req = {};
+	struct spdk_json_write_ctx *w;
+	int rc;
+
+	if (spdk_json_decode_object(params, rpc_framework_set_interrupt_mode_decoders,
+				    SPDK_COUNTOF(rpc_framework_set_interrupt_mode_decoders),
+				    &req)) {
+		SPDK_DEBUGLOG(SPDK_LOG_REACTOR, "spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "Invalid parameters");
+		return;
+	}
+
+	rc = spdk_reactor_set_interrupt_mode(req.enabled, req.idle_period);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+}
+SPDK_RPC_REGISTER("framework_set_interrupt_mode", spdk_rpc_framework_set_interrupt_mode,
+		  SPDK_RPC_STARTUP | SPDK_RPC_RUNTIME)
+
+static void
+spdk_rpc_framework_get_interrupt_mode(struct spdk_jsonrpc_request *request,
+				      const struct spdk_json_val *params)
+{
+	struct spdk_reactor_interrupt_stats stats;
+	struct spdk_json_write_ctx *w;
+	uint64_t idle_period;
+	bool enabled;
+	uint32_t i;
+
+	if (params) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "'framework_get_interrupt_mode' requires no arguments");
+		return;
+	}
+
+	enabled = spdk_reactor_get_interrupt_mode(&idle_period);
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_bool(w, "enabled", enabled);
+	spdk_json_write_named_uint64(w, "idle_period", idle_period);
+	spdk_json_write_named_uint64(w, "tick_rate", spdk_get_ticks_hz());
+
+	spdk_json_write_named_array_begin(w, "reactors");
+	SPDK_ENV_FOREACH_CORE(i) {
+		if (spdk_reactor_get_interrupt_stats(i, &stats) != 0) {
+			continue;
+		}
+
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_uint32(w, "lcore", i);
+		spdk_json_write_named_bool(w, "sleeping", stats.sleeping);
+		spdk_json_write_named_uint64(w, "sleep_count", stats.sleep_count);
+		spdk_json_write_named_uint64(w, "sleep_ticks", stats.sleep_tsc);
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_array_end(w);
+
+	spdk_json_write_object_end(w);
+	spdk_jsonrpc_end_result(request, w);
+}
+SPDK_RPC_REGISTER("framework_get_interrupt_mode", spdk_rpc_framework_get_interrupt_mode,
+		  SPDK_RPC_RUNTIME)
@@ -65,6 +65,7 @@ static struct spdk_subsystem g_spdk_subsystem_copy = {
 	.init = spdk_copy_engine_subsystem_initialize,
 	.fini = spdk_copy_engine_subsystem_finish,
 	.config = spdk_copy_engine_config_text,
+	.write_config_json = spdk_copy_engine_write_config_json,
 };
 
 SPDK_SUBSYSTEM_REGISTER(g_spdk_subsystem_copy);
@@ -34,6 +34,7 @@
 #include "event_nvmf.h"
 
 #include "spdk/bdev.h"
+#include "spdk/env.h"
 #include "spdk/event.h"
 #include "spdk/thread.h"
 #include "spdk/log.h"
@@ -58,6 +59,7 @@ enum nvmf_tgt_state {
 struct nvmf_tgt_poll_group {
 	struct spdk_nvmf_poll_group		*group;
 	struct spdk_thread			*thread;
+	struct spdk_poller			*exit_poller;
 	TAILQ_ENTRY(nvmf_tgt_poll_group)	link;
 };
 
@@ -82,6 +84,10 @@ static struct nvmf_tgt_poll_group *g_next_poll_group = NULL;
 static TAILQ_HEAD(, nvmf_tgt_poll_group) g_poll_groups = TAILQ_HEAD_INITIALIZER(g_poll_groups);
 static size_t g_num_poll_groups = 0;
 
+/* Thread that drives the target state machine and owns g_poll_groups */
+static struct spdk_thread *g_tgt_init_thread = NULL;
+static size_t g_num_poll_groups_pending = 0;
+
 static struct spdk_poller *g_acceptor_poller = NULL;
 
 static void nvmf_tgt_advance_state(void);
@@ -302,34 +308,81 @@ acceptor_poll(void *arg)
 static void
 nvmf_tgt_destroy_poll_group_done(void *ctx)
 {
+	struct nvmf_tgt_poll_group *pg = ctx;
+
+	TAILQ_REMOVE(&g_poll_groups, pg, link);
+	free(pg);
+
+	assert(g_num_poll_groups > 0);
+	if (--g_num_poll_groups > 0) {
+		return;
+	}
+
+	g_next_poll_group = NULL;
 	g_tgt_state = NVMF_TGT_FINI_STOP_ACCEPTOR;
-	assert(g_num_poll_groups == 0);
 	nvmf_tgt_advance_state();
 }
 
+static int
+nvmf_tgt_poll_group_exit_poll(void *ctx)
+{
+	struct nvmf_tgt_poll_group *pg = ctx;
+
+	/* The poll group releases its channels asynchronously. Exit once they are all gone. */
+	if (spdk_thread_has_io_channels(pg->thread)) {
+		return 0;
+	}
+
+	spdk_poller_unregister(&pg->exit_poller);
+	spdk_thread_exit(pg->thread);
+	spdk_thread_send_msg(g_tgt_init_thread, nvmf_tgt_destroy_poll_group_done, pg);
+
+	return 1;
+}
+
 static void
 nvmf_tgt_destroy_poll_group(void *ctx)
 {
-	struct nvmf_tgt_poll_group *pg, *tpg;
-	struct spdk_thread *thread;
+	struct nvmf_tgt_poll_group *pg = ctx;
+
+	if (pg->group != NULL) {
+		spdk_nvmf_poll_group_destroy(pg->group);
+	}
+	pg->exit_poller = SPDK_POLLER_REGISTER(nvmf_tgt_poll_group_exit_poll, pg, 0);
+}
+
+static void
+nvmf_tgt_destroy_poll_groups(void)
+{
+	struct nvmf_tgt_poll_group *pg;
 
-	thread = spdk_get_thread();
+	if (TAILQ_EMPTY(&g_poll_groups)) {
+		g_tgt_state = NVMF_TGT_FINI_STOP_ACCEPTOR;
+		return;
+	}
 
-	TAILQ_FOREACH_SAFE(pg, &g_poll_groups, link, tpg) {
-		if (pg->thread == thread) {
-			TAILQ_REMOVE(&g_poll_groups, pg, link);
-			spdk_nvmf_poll_group_destroy(pg->group);
-			free(pg);
-			assert(g_num_poll_groups > 0);
-			g_num_poll_groups--;
-			return;
-		}
+	TAILQ_FOREACH(pg, &g_poll_groups, link) {
+		spdk_thread_send_msg(pg->thread, nvmf_tgt_destroy_poll_group, pg);
 	}
 }
 
 static void
 nvmf_tgt_create_poll_group_done(void *ctx)
 {
+	struct nvmf_tgt_poll_group *pg = ctx;
+
+	TAILQ_INSERT_TAIL(&g_poll_groups, pg, link);
+	g_num_poll_groups++;
+
+	if (g_next_poll_group == NULL) {
+		g_next_poll_group = pg;
+	}
+
+	assert(g_num_poll_groups_pending > 0);
+	if (--g_num_poll_groups_pending > 0) {
+		return;
+	}
+
 	g_tgt_state = NVMF_TGT_INIT_START_SUBSYSTEMS;
 	nvmf_tgt_advance_state();
 }
@@ -337,22 +390,53 @@ nvmf_tgt_create_poll_group_done(void *ctx)
 static void
 nvmf_tgt_create_poll_group(void *ctx)
 {
+	struct nvmf_tgt_poll_group *pg = ctx;
+
+	pg->group = spdk_nvmf_poll_group_create(g_spdk_nvmf_tgt);
+	spdk_thread_send_msg(g_tgt_init_thread, nvmf_tgt_create_poll_group_done, pg);
+}
+
+/*
+ * Create one poll group per core of the application, each on its own thread.
+ * The threads may run on any core of the application so that a scheduler
+ * can move them between reactors as the load changes.
+ */
+static void
+nvmf_tgt_create_poll_groups(void)
+{
+	struct spdk_cpuset *app_mask = spdk_app_get_core_mask();
 	struct nvmf_tgt_poll_group *pg;
+	char thread_name[32];
+	uint32_t i;
 
-	pg = calloc(1, sizeof(*pg));
-	if (!pg) {
-		SPDK_ERRLOG("Not enough memory to allocate poll groups\n");
-		spdk_app_stop(-ENOMEM);
-		return;
-	}
+	g_tgt_init_thread = spdk_get_thread();
+	g_num_poll_groups_pending = 0;
 
-	pg->thread = spdk_get_thread();
-	pg->group = spdk_nvmf_poll_group_create(g_spdk_nvmf_tgt);
-	TAILQ_INSERT_TAIL(&g_poll_groups, pg, link);
-	g_num_poll_groups++;
+	SPDK_ENV_FOREACH_CORE(i) {
+		if (!spdk_cpuset_get_cpu(app_mask, i)) {
+			continue;
+		}
 
-	if (g_next_poll_group == NULL) {
-		g_next_poll_group = pg;
+		pg = calloc(1, sizeof(*pg));
+		if (!pg) {
+			SPDK_ERRLOG("Not enough memory to allocate poll groups\n");
+			break;
+		}
+
+		snprintf(thread_name, sizeof(thread_name), "nvmf_tgt_poll_group_%u", i);
+		pg->thread = spdk_thread_create(thread_name, app_mask);
+		if (!pg->thread) {
+			SPDK_ERRLOG("Failed to create thread for poll group on core %u\n", i);
+			free(pg);
+			break;
+		}
+
+		g_num_poll_groups_pending++;
+		spdk_thread_send_msg(pg->thread, nvmf_tgt_create_poll_group, pg);
+	}
+
+	if (g_num_poll_groups_pending == 0) {
+		g_tgt_state = NVMF_TGT_ERROR;
 	}
 }
 
@@ -441,10 +525,7 @@ nvmf_tgt_advance_state(void)
 			spdk_thread_send_msg(spdk_get_thread(), nvmf_tgt_parse_conf_start, NULL);
 			break;
 		case NVMF_TGT_INIT_CREATE_POLL_GROUPS:
-			/* Send a message to each thread and create a poll group */
-			spdk_for_each_thread(nvmf_tgt_create_poll_group,
-					     NULL,
-					     nvmf_tgt_create_poll_group_done);
+			nvmf_tgt_create_poll_groups();
 			break;
 		case NVMF_TGT_INIT_START_SUBSYSTEMS: {
 			struct spdk_nvmf_subsystem *subsystem;
@@ -459,7 +540,7 @@ nvmf_tgt_advance_state(void)
 			break;
 		}
 		case NVMF_TGT_INIT_START_ACCEPTOR:
-			g_acceptor_poller = spdk_poller_register(acceptor_poll, g_spdk_nvmf_tgt,
+			g_acceptor_poller = SPDK_POLLER_REGISTER(acceptor_poll, g_spdk_nvmf_tgt,
 					    g_spdk_nvmf_tgt_conf->acceptor_poll_rate);
 			SPDK_INFOLOG(SPDK_LOG_NVMF, "Acceptor running\n");
 			g_tgt_state = NVMF_TGT_RUNNING;
@@ -480,10 +561,7 @@ nvmf_tgt_advance_state(void)
 			break;
 		}
 		case NVMF_TGT_FINI_DESTROY_POLL_GROUPS:
-			/* Send a message to each thread and destroy the poll group */
-			spdk_for_each_thread(nvmf_tgt_destroy_poll_group,
-					     NULL,
-					     nvmf_tgt_destroy_poll_group_done);
+			nvmf_tgt_destroy_poll_groups();
 			break;
 		case NVMF_TGT_FINI_STOP_ACCEPTOR:
 			spdk_poller_unregister(&g_acceptor_poller);
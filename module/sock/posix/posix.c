@@ -693,6 +693,14 @@ spdk_posix_sock_group_impl_close(struct spdk_sock_group_impl *_group)
 	return rc;
 }
 
+static int
+spdk_posix_sock_group_impl_get_fd(struct spdk_sock_group_impl *_group)
+{
+	struct spdk_posix_sock_group_impl *group = __posix_group_impl(_group);
+
+	return group->fd;
+}
+
 static struct spdk_net_impl g_posix_net_impl = {
 	.name		= "posix",
 	.getaddr	= spdk_posix_sock_getaddr,
@@ -716,6 +724,7 @@ static struct spdk_net_impl g_posix_net_impl = {
 	.group_impl_remove_sock = spdk_posix_sock_group_impl_remove_sock,
 	.group_impl_poll	= spdk_posix_sock_group_impl_poll,
 	.group_impl_close	= spdk_posix_sock_group_impl_close,
+	.group_impl_get_fd	= spdk_posix_sock_group_impl_get_fd,
 };
 
 SPDK_NET_IMPL_REGISTER(posix, &g_posix_net_impl);
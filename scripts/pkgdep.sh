@@ -73,6 +73,8 @@ if [ -s /etc/redhat-release ]; then
 	fi
 	# Additional dependencies for ISA-L used in compression
 	yum install -y autoconf automake libtool help2man
+	# Additional dependencies for spdk_top
+	yum install -y ncurses-devel
 elif [ -f /etc/debian_version ]; then
 	# Includes Ubuntu, Debian
 	apt-get install -y gcc g++ make libcunit1-dev libaio-dev libssl-dev \
@@ -95,6 +97,8 @@ elif [ -f /etc/debian_version ]; then
 	apt-get install -y autoconf automake libtool help2man
 	# Additional dependecies for nvmf performance test script
 	apt-get install -y python3-paramiko
+	# Additional dependencies for spdk_top
+	apt-get install -y libncurses5-dev
 elif [ -f /etc/SuSE-release ] || [ -f /etc/SUSE-brand ]; then
 	zypper install -y gcc gcc-c++ make cunit-devel libaio-devel libopenssl-devel \
 		git-core lcov python-base python-pycodestyle libuuid-devel sg3_utils pciutils \
@@ -111,6 +115,8 @@ elif [ -f /etc/SuSE-release ] || [ -f /etc/SUSE-brand ]; then
 	zypper install -y doxygen mscgen graphviz
 	# Additional dependencies for ISA-L used in compression
 	zypper install -y autoconf automake libtool help2man
+	# Additional dependencies for spdk_top
+	zypper install -y ncurses-devel
 elif [ $(uname -s) = "FreeBSD" ] ; then
 	pkg install -y gmake cunit openssl git devel/astyle bash py27-pycodestyle \
 		python misc/e2fsprogs-libuuid sysutils/sg3_utils nasm
@@ -118,6 +124,8 @@ elif [ $(uname -s) = "FreeBSD" ] ; then
 	pkg install -y doxygen mscgen graphviz
 	# Additional dependencies for ISA-L used in compression
 	pkg install -y autoconf automake libtool help2man
+	# Additional dependencies for spdk_top
+	pkg install -y ncurses
 elif [ -f /etc/arch-release ]; then
 	# Install main dependencies
 	pacman -Sy --needed --noconfirm gcc make cunit libaio openssl \
@@ -139,12 +139,25 @@ if __name__ == "__main__":
     def bdev_set_options(args):
         rpc.bdev.bdev_set_options(args.client,
                                   bdev_io_pool_size=args.bdev_io_pool_size,
-                                  bdev_io_cache_size=args.bdev_io_cache_size)
+                                  bdev_io_cache_size=args.bdev_io_cache_size,
+                                  tiny_buf_pool_size=args.tiny_buf_pool_size,
+                                  small_buf_pool_size=args.small_buf_pool_size,
+                                  large_buf_pool_size=args.large_buf_pool_size,
+                                  huge_buf_pool_size=args.huge_buf_pool_size,
+                                  qos_distributed=args.qos_distributed,
+                                  qos_tolerance_pct=args.qos_tolerance_pct)
 
     p = subparsers.add_parser('bdev_set_options', aliases=['set_bdev_options'],
                               help="""Set options of bdev subsystem""")
     p.add_argument('-p', '--bdev-io-pool-size', help='Number of bdev_io structures in shared buffer pool', type=int)
     p.add_argument('-c', '--bdev-io-cache-size', help='Maximum number of bdev_io structures cached per thread', type=int)
+    p.add_argument('--tiny-buf-pool-size', help='Number of 4 KiB data buffers in shared pool', type=int)
+    p.add_argument('--small-buf-pool-size', help='Number of 8 KiB data buffers in shared pool', type=int)
+    p.add_argument('--large-buf-pool-size', help='Number of 64 KiB data buffers in shared pool', type=int)
+    p.add_argument('--huge-buf-pool-size', help='Number of 128 KiB data buffers in shared pool', type=int)
+    p.add_argument('--qos-distributed', help='Enforce QoS rate limits on each channel instead of funneling I/O through one thread',
+                   action='store_true', default=None)
+    p.add_argument('--qos-tolerance-pct', help='Allowed deviation from QoS rate limits in percent with distributed QoS', type=int)
     p.set_defaults(func=bdev_set_options)
 
     def bdev_compress_create(args):
@@ -171,9 +184,21 @@ if __name__ == "__main__":
         rpc.bdev.set_compress_pmd(args.client,
                                   pmd=args.pmd)
     p = subparsers.add_parser('set_compress_pmd', help='Set pmd option for a compress disk')
-    p.add_argument('-p', '--pmd', type=int, help='0 = auto-select, 1= QAT only, 2 = ISAL only')
+    p.add_argument('-p', '--pmd', type=int,
+                   help='0 = auto-select, 1= QAT only, 2 = ISAL only, 3 = software engine only')
     p.set_defaults(func=set_compress_pmd)
 
+    def bdev_compress_set_sw_options(args):
+        rpc.bdev.bdev_compress_set_sw_options(args.client,
+                                              level=args.level,
+                                              num_workers=args.num_workers)
+    p = subparsers.add_parser('bdev_compress_set_sw_options',
+                              help='Set options of the software compression engine')
+    p.add_argument('-l', '--level', type=int, help='ISA-L level, 0 (fastest) to 3 (best ratio)')
+    p.add_argument('-w', '--num-workers', type=int,
+                   help='Number of worker threads, 0 runs operations from the bdev poller')
+    p.set_defaults(func=bdev_compress_set_sw_options)
+
     def bdev_compress_get_orphans(args):
         print_dict(rpc.bdev.bdev_compress_get_orphans(args.client,
                                                       name=args.name))
@@ -304,6 +329,29 @@ if __name__ == "__main__":
     p.add_argument('name', help='null bdev name')
     p.set_defaults(func=bdev_null_delete)
 
+    def bdev_aio_set_options(args):
+        rpc.bdev.bdev_aio_set_options(args.client,
+                                      max_batch=args.max_batch,
+                                      batch_latency_us=args.batch_latency_us,
+                                      use_eventfd=args.use_eventfd)
+
+    p = subparsers.add_parser('bdev_aio_set_options',
+                              help='Set options of the aio bdev module. This is startup command.')
+    p.add_argument('-b', '--max-batch', type=int,
+                   help='Most iocbs submitted with a single io_submit() call (1-128)')
+    p.add_argument('-l', '--batch-latency-us', type=int,
+                   help='Microseconds an iocb may wait to be batched with later ones')
+    p.add_argument('-e', '--use-eventfd', action='store_true', default=None,
+                   help='Signal completions on an eventfd so that idle threads can sleep')
+    p.set_defaults(func=bdev_aio_set_options)
+
+    def bdev_aio_get_stats(args):
+        print_dict(rpc.bdev.bdev_aio_get_stats(args.client))
+
+    p = subparsers.add_parser('bdev_aio_get_stats',
+                              help='Display io_submit() batching statistics of the aio bdev module')
+    p.set_defaults(func=bdev_aio_get_stats)
+
     def bdev_aio_create(args):
         print_json(rpc.bdev.bdev_aio_create(args.client,
                                             filename=args.filename,
@@ -326,6 +374,43 @@ if __name__ == "__main__":
     p.add_argument('name', help='aio bdev name')
     p.set_defaults(func=bdev_aio_delete)
 
+    def bdev_uring_set_options(args):
+        rpc.bdev.bdev_uring_set_options(args.client,
+                                        sq_poll=args.sq_poll,
+                                        sq_thread_idle_ms=args.sq_thread_idle_ms,
+                                        fixed_files=args.fixed_files,
+                                        fixed_buffers=args.fixed_buffers)
+
+    p = subparsers.add_parser('bdev_uring_set_options',
+                              help='Set options of the uring bdev module. This is startup command.')
+    p.add_argument('-p', '--sq-poll', action='store_true', default=None,
+                   help='Let a kernel thread poll the submission queues instead of using syscalls')
+    p.add_argument('-i', '--sq-thread-idle-ms', type=int,
+                   help='Milliseconds without I/O after which the kernel polling thread sleeps')
+    p.add_argument('-f', '--fixed-files', action='store_true', default=None,
+                   help='Register the files of the bdevs with io_uring')
+    p.add_argument('-b', '--fixed-buffers', action='store_true', default=None,
+                   help='Register SPDK memory with io_uring and use it as fixed buffers')
+    p.set_defaults(func=bdev_uring_set_options)
+
+    def bdev_uring_create(args):
+        print_json(rpc.bdev.bdev_uring_create(args.client,
+                                              filename=args.filename,
+                                              name=args.name))
+
+    p = subparsers.add_parser('bdev_uring_create', help='Add a bdev with io_uring backend')
+    p.add_argument('filename', help='Path to device or file (ex: /dev/nvme0n1)')
+    p.add_argument('name', help='Block device name')
+    p.set_defaults(func=bdev_uring_create)
+
+    def bdev_uring_delete(args):
+        rpc.bdev.bdev_uring_delete(args.client,
+                                   name=args.name)
+
+    p = subparsers.add_parser('bdev_uring_delete', help='Delete a uring bdev')
+    p.add_argument('name', help='uring bdev name')
+    p.set_defaults(func=bdev_uring_delete)
+
     def bdev_nvme_set_options(args):
         rpc.bdev.bdev_nvme_set_options(args.client,
                                        action_on_timeout=args.action_on_timeout,
@@ -337,7 +422,10 @@ if __name__ == "__main__":
                                        high_priority_weight=args.high_priority_weight,
                                        nvme_adminq_poll_period_us=args.nvme_adminq_poll_period_us,
                                        nvme_ioq_poll_period_us=args.nvme_ioq_poll_period_us,
-                                       io_queue_requests=args.io_queue_requests)
+                                       io_queue_requests=args.io_queue_requests,
+                                       use_cmb_sqs=args.use_cmb_sqs,
+                                       cmb_zcopy=args.cmb_zcopy,
+                                       multipath=args.multipath)
 
     p = subparsers.add_parser('bdev_nvme_set_options', aliases=['set_bdev_nvme_options'],
                               help='Set options for the bdev nvme type. This is startup command.')
@@ -361,6 +449,12 @@ if __name__ == "__main__":
                    help='How often to poll I/O queues for completions', type=int)
     p.add_argument('-s', '--io-queue-requests',
                    help='The number of requests allocated for each NVMe I/O queue. Default: 512', type=int)
+    p.add_argument('--disable-cmb-sqs', dest='use_cmb_sqs', action='store_false', default=None,
+                   help='Do not place PCIe submission queues in the controller memory buffer')
+    p.add_argument('--cmb-zcopy', action='store_true', default=None,
+                   help='Stage the data of zero copy requests in the controller memory buffer')
+    p.add_argument('--disable-multipath', dest='multipath', action='store_false', default=None,
+                   help='Create a bdev for each namespace of each controller, even if it is shared')
     p.set_defaults(func=bdev_nvme_set_options)
 
     def bdev_nvme_set_hotplug(args):
@@ -430,6 +524,26 @@ if __name__ == "__main__":
     p.add_argument('name', help="Name of the controller")
     p.set_defaults(func=bdev_nvme_detach_controller)
 
+    def bdev_nvme_get_paths(args):
+        print_dict(rpc.bdev.bdev_nvme_get_paths(args.client,
+                                                name=args.name))
+
+    p = subparsers.add_parser('bdev_nvme_get_paths',
+                              help='Display the paths of all NVMe bdevs or of the required NVMe bdev')
+    p.add_argument('-b', '--name', help="Name of the NVMe bdev. Example: Nvme0n1", required=False)
+    p.set_defaults(func=bdev_nvme_get_paths)
+
+    def bdev_nvme_set_multipath_policy(args):
+        rpc.bdev.bdev_nvme_set_multipath_policy(args.client,
+                                                name=args.name,
+                                                policy=args.policy)
+
+    p = subparsers.add_parser('bdev_nvme_set_multipath_policy',
+                              help='Set the policy used to select the path of I/O of an NVMe bdev')
+    p.add_argument('name', help="Name of the NVMe bdev")
+    p.add_argument('policy', help="Path selection policy", choices=['round_robin', 'queue_depth'])
+    p.set_defaults(func=bdev_nvme_set_multipath_policy)
+
     def bdev_rbd_create(args):
         config = None
         if args.config:
@@ -590,6 +704,61 @@ if __name__ == "__main__":
     p.add_argument('name', help='pass through bdev name')
     p.set_defaults(func=bdev_passthru_delete)
 
+    def bdev_cache_create(args):
+        print_json(rpc.bdev.bdev_cache_create(args.client,
+                                              name=args.name,
+                                              base_bdev_name=args.base_bdev_name,
+                                              cache_bdev_name=args.cache_bdev_name,
+                                              line_size_kb=args.line_size_kb,
+                                              policy=args.policy,
+                                              seq_cutoff_kb=args.seq_cutoff_kb,
+                                              format=args.format))
+
+    p = subparsers.add_parser('bdev_cache_create',
+                              help='Add a write-back cache bdev with a fast bdev in front of a slow one')
+    p.add_argument('-b', '--base-bdev-name', help="Name of the slow bdev to cache", required=True)
+    p.add_argument('-c', '--cache-bdev-name', help="Name of the fast bdev holding the cache", required=True)
+    p.add_argument('-n', '--name', help="Name of the cache bdev", required=True)
+    p.add_argument('-l', '--line-size-kb', help="Size of a cache line in KiB", type=int)
+    p.add_argument('-p', '--policy', help="Replacement policy", choices=['lru', 'arc'])
+    p.add_argument('-s', '--seq-cutoff-kb', help="KiB of sequential I/O after which a stream bypasses the cache, 0 to never bypass",
+                   type=int)
+    p.add_argument('-f', '--format', help="Format the cache bdev even if it holds a cache", action='store_true')
+    p.set_defaults(func=bdev_cache_create)
+
+    def bdev_cache_delete(args):
+        print_json(rpc.bdev.bdev_cache_delete(args.client,
+                                              name=args.name))
+
+    p = subparsers.add_parser('bdev_cache_delete', help='Delete a cache bdev')
+    p.add_argument('name', help='cache bdev name')
+    p.set_defaults(func=bdev_cache_delete)
+
+    def bdev_dedup_create(args):
+        print_json(rpc.bdev.bdev_dedup_create(args.client,
+                                              name=args.name,
+                                              base_bdev_name=args.base_bdev_name,
+                                              chunk_size_kb=args.chunk_size_kb,
+                                              logical_size_mb=args.logical_size_mb,
+                                              format=args.format))
+
+    p = subparsers.add_parser('bdev_dedup_create',
+                              help='Add a bdev storing chunks with the same content only once')
+    p.add_argument('-b', '--base-bdev-name', help="Name of the bdev holding the unique chunks", required=True)
+    p.add_argument('-n', '--name', help="Name of the dedup bdev", required=True)
+    p.add_argument('-c', '--chunk-size-kb', help="Size of a deduplicated chunk in KiB", type=int)
+    p.add_argument('-s', '--logical-size-mb', help="Size of the dedup bdev in MiB, may exceed the base bdev", type=int)
+    p.add_argument('-f', '--format', help="Format the base bdev even if it holds a dedup bdev", action='store_true')
+    p.set_defaults(func=bdev_dedup_create)
+
+    def bdev_dedup_delete(args):
+        print_json(rpc.bdev.bdev_dedup_delete(args.client,
+                                              name=args.name))
+
+    p = subparsers.add_parser('bdev_dedup_delete', help='Delete a dedup bdev')
+    p.add_argument('name', help='dedup bdev name')
+    p.set_defaults(func=bdev_dedup_delete)
+
     def bdev_get_bdevs(args):
         print_dict(rpc.bdev.bdev_get_bdevs(args.client,
                                            name=args.name))
@@ -608,6 +777,13 @@ if __name__ == "__main__":
     p.add_argument('-b', '--name', help="Name of the Blockdev. Example: Nvme0n1", required=False)
     p.set_defaults(func=bdev_get_iostat)
 
+    def bdev_get_io_cache_stats(args):
+        print_dict(rpc.bdev.bdev_get_io_cache_stats(args.client))
+
+    p = subparsers.add_parser('bdev_get_io_cache_stats',
+                              help='Display statistics of the per-thread bdev_io caches.')
+    p.set_defaults(func=bdev_get_io_cache_stats)
+
     def bdev_enable_histogram(args):
         rpc.bdev.bdev_enable_histogram(args.client, name=args.name, enable=args.enable)
 
@@ -664,6 +840,40 @@ if __name__ == "__main__":
                    type=int, required=False)
     p.set_defaults(func=bdev_set_qos_limit)
 
+    def bdev_set_qos_latency_target(args):
+        rpc.bdev.bdev_set_qos_latency_target(args.client,
+                                             name=args.name,
+                                             latency_target_usec=args.latency_target_usec)
+
+    p = subparsers.add_parser('bdev_set_qos_latency_target',
+                              help='Set p99 latency target of high priority I/O on a blockdev')
+    p.add_argument('name', help='Blockdev name. Example: Malloc0')
+    p.add_argument('latency_target_usec', help='Target p99 latency in microseconds. 0 removes the target.',
+                   type=int)
+    p.set_defaults(func=bdev_set_qos_latency_target)
+
+    def bdev_set_qos_priority(args):
+        rpc.bdev.bdev_set_qos_priority(args.client,
+                                       name=args.name,
+                                       desc_id=args.desc_id,
+                                       priority=args.priority)
+
+    p = subparsers.add_parser('bdev_set_qos_priority',
+                              help='Set QoS priority class of a descriptor opened on a blockdev')
+    p.add_argument('name', help='Blockdev name. Example: Malloc0')
+    p.add_argument('desc_id', help='Descriptor id, as reported by bdev_get_qos_latency_stats', type=int)
+    p.add_argument('priority', help='Priority class', choices=['high', 'low'])
+    p.set_defaults(func=bdev_set_qos_priority)
+
+    def bdev_get_qos_latency_stats(args):
+        print_dict(rpc.bdev.bdev_get_qos_latency_stats(args.client,
+                                                       name=args.name))
+
+    p = subparsers.add_parser('bdev_get_qos_latency_stats',
+                              help='Get latency target statistics and descriptor priorities of a blockdev')
+    p.add_argument('name', help='Blockdev name. Example: Malloc0')
+    p.set_defaults(func=bdev_get_qos_latency_stats)
+
     def bdev_error_inject_error(args):
         rpc.bdev.bdev_error_inject_error(args.client,
                                          name=args.name,
@@ -1407,7 +1617,7 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument('-n', '--name', help='raid bdev name', required=True)
     p.add_argument('-s', '--strip-size', help='strip size in KB (deprecated)', type=int)
     p.add_argument('-z', '--strip-size_kb', help='strip size in KB', type=int)
-    p.add_argument('-r', '--raid-level', help='raid level, only raid level 0 is supported', type=int, required=True)
+    p.add_argument('-r', '--raid-level', help='raid level, 0, 1 or 5', type=int, required=True)
     p.add_argument('-b', '--base-bdevs', help='base bdevs name, whitespace separated list in quotes', required=True)
     p.set_defaults(func=bdev_raid_create)
 
@@ -1999,6 +2209,19 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument('name', help='Virtio device name. E.g. VirtioUser0')
     p.set_defaults(func=bdev_virtio_detach_controller)
 
+    # copy
+    def copy_set_sw_options(args):
+        rpc.copy.copy_set_sw_options(args.client,
+                                     large_threshold=args.large_threshold,
+                                     chunk_size=args.chunk_size)
+
+    p = subparsers.add_parser('copy_set_sw_options', help='Set options of the software copy engine')
+    p.add_argument('-t', '--large-threshold', help="""Copies and fills of at least this many bytes are
+    done in chunks from a poller with non-temporal stores (0 to disable)""", type=int)
+    p.add_argument('-c', '--chunk-size', help='Bytes of large copies and fills processed by each poller run',
+                   type=int)
+    p.set_defaults(func=copy_set_sw_options)
+
     # ioat
     def ioat_scan_copy_engine(args):
         pci_whitelist = []
@@ -2067,6 +2290,50 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
         'thread_get_stats', help='Display current statistics of all the threads')
     p.set_defaults(func=thread_get_stats)
 
+    def thread_get_pollers(args):
+        print_dict(rpc.app.thread_get_pollers(args.client))
+
+    p = subparsers.add_parser(
+        'thread_get_pollers', help='Display pollers of all the threads and their statistics')
+    p.set_defaults(func=thread_get_pollers)
+
+    def framework_set_scheduler(args):
+        rpc.app.framework_set_scheduler(args.client,
+                                        name=args.name,
+                                        period=args.period)
+
+    p = subparsers.add_parser('framework_set_scheduler',
+                              help='Select the policy that places threads on reactors')
+    p.add_argument('name', help='Scheduler name: static, balanced or work_stealing')
+    p.add_argument('-p', '--period', help='How often thread load is sampled in microseconds', type=int)
+    p.set_defaults(func=framework_set_scheduler)
+
+    def framework_get_scheduler(args):
+        print_dict(rpc.app.framework_get_scheduler(args.client))
+
+    p = subparsers.add_parser(
+        'framework_get_scheduler', help='Display the scheduler in use and the threads it has moved')
+    p.set_defaults(func=framework_get_scheduler)
+
+    def framework_set_interrupt_mode(args):
+        rpc.app.framework_set_interrupt_mode(args.client,
+                                             enabled=not args.disable,
+                                             idle_period=args.idle_period)
+
+    p = subparsers.add_parser('framework_set_interrupt_mode',
+                              help='Let idle reactors block instead of polling')
+    p.add_argument('-d', '--disable', action='store_true', help='Disable interrupt mode')
+    p.add_argument('-i', '--idle-period', help='How long a reactor must be idle before it blocks in microseconds',
+                   type=int)
+    p.set_defaults(func=framework_set_interrupt_mode)
+
+    def framework_get_interrupt_mode(args):
+        print_dict(rpc.app.framework_get_interrupt_mode(args.client))
+
+    p = subparsers.add_parser(
+        'framework_get_interrupt_mode', help='Display interrupt mode state and reactor sleep statistics')
+    p.set_defaults(func=framework_get_interrupt_mode)
+
     # blobfs
     def blobfs_detect(args):
         print(rpc.blobfs.blobfs_detect(args.client,
@@ -4,6 +4,7 @@ import sys
 from . import app
 from . import bdev
 from . import blobfs
+from . import copy
 from . import ioat
 from . import iscsi
 from . import log
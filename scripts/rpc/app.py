@@ -35,3 +35,56 @@ def thread_get_stats(client):
         Current threads statistics.
     """
     return client.call('thread_get_stats')
+
+
+def thread_get_pollers(client):
+    """Query pollers of all threads and their statistics.
+
+    Returns:
+        Pollers of each thread with run counts and ticks spent.
+    """
+    return client.call('thread_get_pollers')
+
+
+def framework_set_scheduler(client, name, period=None):
+    """Select the policy that places threads on reactors.
+
+    Args:
+        name: scheduler name ("static", "balanced" or "work_stealing")
+        period: how often thread load is sampled in microseconds (optional)
+    """
+    params = {'name': name}
+    if period is not None:
+        params['period'] = period
+    return client.call('framework_set_scheduler', params)
+
+
+def framework_get_scheduler(client):
+    """Query the scheduler in use and the threads it has moved.
+
+    Returns:
+        Scheduler name, period, migration counters and recent migrations.
+    """
+    return client.call('framework_get_scheduler')
+
+
+def framework_set_interrupt_mode(client, enabled, idle_period=None):
+    """Enable or disable interrupt mode of the reactors.
+
+    Args:
+        enabled: True to let idle reactors block instead of polling; False to always poll
+        idle_period: how long a reactor must be idle before it blocks in microseconds (optional)
+    """
+    params = {'enabled': enabled}
+    if idle_period is not None:
+        params['idle_period'] = idle_period
+    return client.call('framework_set_interrupt_mode', params)
+
+
+def framework_get_interrupt_mode(client):
+    """Query interrupt mode and how long each reactor has been blocked.
+
+    Returns:
+        Interrupt mode state and per-reactor statistics.
+    """
+    return client.call('framework_get_interrupt_mode')
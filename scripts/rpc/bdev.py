@@ -2,12 +2,20 @@ from .helpers import deprecated_alias
 
 
 @deprecated_alias('set_bdev_options')
-def bdev_set_options(client, bdev_io_pool_size=None, bdev_io_cache_size=None):
+def bdev_set_options(client, bdev_io_pool_size=None, bdev_io_cache_size=None, tiny_buf_pool_size=None,
+                     small_buf_pool_size=None, large_buf_pool_size=None, huge_buf_pool_size=None,
+                     qos_distributed=None, qos_tolerance_pct=None):
     """Set parameters for the bdev subsystem.
 
     Args:
         bdev_io_pool_size: number of bdev_io structures in shared buffer pool (optional)
         bdev_io_cache_size: maximum number of bdev_io structures cached per thread (optional)
+        tiny_buf_pool_size: number of 4 KiB data buffers in the shared pool (optional)
+        small_buf_pool_size: number of 8 KiB data buffers in the shared pool (optional)
+        large_buf_pool_size: number of 64 KiB data buffers in the shared pool (optional)
+        huge_buf_pool_size: number of 128 KiB data buffers in the shared pool (optional)
+        qos_distributed: enforce QoS rate limits on each channel from a shared budget (optional)
+        qos_tolerance_pct: allowed deviation from the rate limits in percent with distributed QoS (optional)
     """
     params = {}
 
@@ -15,6 +23,18 @@ def bdev_set_options(client, bdev_io_pool_size=None, bdev_io_cache_size=None):
         params['bdev_io_pool_size'] = bdev_io_pool_size
     if bdev_io_cache_size:
         params['bdev_io_cache_size'] = bdev_io_cache_size
+    if tiny_buf_pool_size:
+        params['tiny_buf_pool_size'] = tiny_buf_pool_size
+    if small_buf_pool_size:
+        params['small_buf_pool_size'] = small_buf_pool_size
+    if large_buf_pool_size:
+        params['large_buf_pool_size'] = large_buf_pool_size
+    if huge_buf_pool_size:
+        params['huge_buf_pool_size'] = huge_buf_pool_size
+    if qos_distributed is not None:
+        params['qos_distributed'] = qos_distributed
+    if qos_tolerance_pct:
+        params['qos_tolerance_pct'] = qos_tolerance_pct
 
     return client.call('bdev_set_options', params)
 
@@ -50,13 +70,29 @@ def set_compress_pmd(client, pmd):
     """Set pmd options for the bdev compress.
 
     Args:
-        pmd: 0 = auto-select, 1 = QAT, 2 = ISAL
+        pmd: 0 = auto-select, 1 = QAT, 2 = ISAL, 3 = software engine
     """
     params = {'pmd': pmd}
 
     return client.call('set_compress_pmd', params)
 
 
+def bdev_compress_set_sw_options(client, level=None, num_workers=None):
+    """Set options of the software compression engine.
+
+    Args:
+        level: ISA-L compression level, 0 (fastest) to 3 (best ratio) (optional)
+        num_workers: number of worker threads, 0 runs operations from the bdev poller (optional)
+    """
+    params = {}
+    if level is not None:
+        params['level'] = level
+    if num_workers is not None:
+        params['num_workers'] = num_workers
+
+    return client.call('bdev_compress_set_sw_options', params)
+
+
 def bdev_compress_get_orphans(client, name=None):
     """Get a list of comp bdevs that do not have a pmem file (aka orphaned).
 
@@ -289,6 +325,35 @@ def bdev_raid_delete(client, name):
     return client.call('bdev_raid_delete', params)
 
 
+def bdev_aio_set_options(client, max_batch=None, batch_latency_us=None, use_eventfd=None):
+    """Set options of the aio bdev module. This is startup command.
+
+    Args:
+        max_batch: most iocbs submitted with a single io_submit() call (optional)
+        batch_latency_us: microseconds an iocb may wait to be batched with later ones (optional)
+        use_eventfd: signal completions on an eventfd so that idle threads can sleep (optional)
+    """
+    params = {}
+
+    if max_batch is not None:
+        params['max_batch'] = max_batch
+    if batch_latency_us is not None:
+        params['batch_latency_us'] = batch_latency_us
+    if use_eventfd is not None:
+        params['use_eventfd'] = use_eventfd
+
+    return client.call('bdev_aio_set_options', params)
+
+
+def bdev_aio_get_stats(client):
+    """Get io_submit() batching statistics of the aio bdev module for each thread.
+
+    Returns:
+        Statistics of every aio group channel.
+    """
+    return client.call('bdev_aio_get_stats')
+
+
 @deprecated_alias('construct_aio_bdev')
 def bdev_aio_create(client, filename, name, block_size=None):
     """Construct a Linux AIO block device.
@@ -321,11 +386,62 @@ def bdev_aio_delete(client, name):
     return client.call('bdev_aio_delete', params)
 
 
+def bdev_uring_set_options(client, sq_poll=None, sq_thread_idle_ms=None, fixed_files=None,
+                           fixed_buffers=None):
+    """Set options of the uring bdev module. This is startup command.
+
+    Args:
+        sq_poll: let a kernel thread poll the submission queues instead of using syscalls (optional)
+        sq_thread_idle_ms: milliseconds without I/O after which the kernel polling thread sleeps (optional)
+        fixed_files: register the files of the bdevs with io_uring (optional)
+        fixed_buffers: register SPDK memory with io_uring and use it as fixed buffers (optional)
+    """
+    params = {}
+
+    if sq_poll is not None:
+        params['sq_poll'] = sq_poll
+    if sq_thread_idle_ms is not None:
+        params['sq_thread_idle_ms'] = sq_thread_idle_ms
+    if fixed_files is not None:
+        params['fixed_files'] = fixed_files
+    if fixed_buffers is not None:
+        params['fixed_buffers'] = fixed_buffers
+
+    return client.call('bdev_uring_set_options', params)
+
+
+def bdev_uring_create(client, filename, name):
+    """Construct a uring block device.
+
+    Args:
+        filename: path to device or file (ex: /dev/nvme0n1)
+        name: name of block device
+
+    Returns:
+        Name of created block device.
+    """
+    params = {'name': name,
+              'filename': filename}
+
+    return client.call('bdev_uring_create', params)
+
+
+def bdev_uring_delete(client, name):
+    """Remove uring bdev from the system.
+
+    Args:
+        name: name of uring bdev to delete
+    """
+    params = {'name': name}
+    return client.call('bdev_uring_delete', params)
+
+
 @deprecated_alias('set_bdev_nvme_options')
 def bdev_nvme_set_options(client, action_on_timeout=None, timeout_us=None, retry_count=None,
                           arbitration_burst=None, low_priority_weight=None,
                           medium_priority_weight=None, high_priority_weight=None,
-                          nvme_adminq_poll_period_us=None, nvme_ioq_poll_period_us=None, io_queue_requests=None):
+                          nvme_adminq_poll_period_us=None, nvme_ioq_poll_period_us=None, io_queue_requests=None,
+                          use_cmb_sqs=None, cmb_zcopy=None, multipath=None):
     """Set options for the bdev nvme. This is startup command.
 
     Args:
@@ -339,6 +455,9 @@ def bdev_nvme_set_options(client, action_on_timeout=None, timeout_us=None, retry
         nvme_adminq_poll_period_us: How often the admin queue is polled for asynchronous events in microseconds (optional)
         nvme_ioq_poll_period_us: How often to poll I/O queues for completions in microseconds (optional)
         io_queue_requests: The number of requests allocated for each NVMe I/O queue. Default: 512 (optional)
+        use_cmb_sqs: Place PCIe submission queues in the controller memory buffer. Default: True (optional)
+        cmb_zcopy: Stage the data of zero copy requests in the controller memory buffer. Default: False (optional)
+        multipath: Combine namespaces reachable through several controllers into one bdev. Default: True (optional)
     """
     params = {}
 
@@ -372,6 +491,15 @@ def bdev_nvme_set_options(client, action_on_timeout=None, timeout_us=None, retry
     if io_queue_requests:
         params['io_queue_requests'] = io_queue_requests
 
+    if use_cmb_sqs is not None:
+        params['use_cmb_sqs'] = use_cmb_sqs
+
+    if cmb_zcopy is not None:
+        params['cmb_zcopy'] = cmb_zcopy
+
+    if multipath is not None:
+        params['multipath'] = multipath
+
     return client.call('bdev_nvme_set_options', params)
 
 
@@ -456,6 +584,33 @@ def bdev_nvme_detach_controller(client, name):
     return client.call('bdev_nvme_detach_controller', params)
 
 
+def bdev_nvme_get_paths(client, name=None):
+    """Get the paths of NVMe bdevs.
+
+    Args:
+        name: NVMe bdev name (optional); if omitted, list the paths of all NVMe bdevs
+
+    Returns:
+        List of NVMe bdevs with their multipath policy and paths.
+    """
+    params = {}
+    if name:
+        params['name'] = name
+    return client.call('bdev_nvme_get_paths', params)
+
+
+def bdev_nvme_set_multipath_policy(client, name, policy):
+    """Set the policy used to select the path of I/O of an NVMe bdev.
+
+    Args:
+        name: NVMe bdev name
+        policy: round_robin or queue_depth
+    """
+    params = {'name': name,
+              'policy': policy}
+    return client.call('bdev_nvme_set_multipath_policy', params)
+
+
 @deprecated_alias('construct_rbd_bdev')
 def bdev_rbd_create(client, pool_name, rbd_name, block_size, name=None, user=None, config=None):
     """Create a Ceph RBD block device.
@@ -663,6 +818,84 @@ def bdev_passthru_delete(client, name):
     return client.call('bdev_passthru_delete', params)
 
 
+def bdev_cache_create(client, name, base_bdev_name, cache_bdev_name, line_size_kb=None, policy=None,
+                      seq_cutoff_kb=None, format=None):
+    """Create a write-back cache bdev.
+
+    Args:
+        name: name of the cache bdev
+        base_bdev_name: name of the slow bdev to cache
+        cache_bdev_name: name of the fast bdev holding the cache
+        line_size_kb: size of a cache line in KiB (optional)
+        policy: replacement policy, lru or arc (optional)
+        seq_cutoff_kb: KiB of sequential I/O after which a stream bypasses the cache, 0 to never bypass (optional)
+        format: format the cache bdev even if it holds a cache (optional)
+
+    Returns:
+        Name of created block device.
+    """
+    params = {
+        'name': name,
+        'base_bdev_name': base_bdev_name,
+        'cache_bdev_name': cache_bdev_name,
+    }
+    if line_size_kb is not None:
+        params['line_size_kb'] = line_size_kb
+    if policy is not None:
+        params['policy'] = policy
+    if seq_cutoff_kb is not None:
+        params['seq_cutoff_kb'] = seq_cutoff_kb
+    if format is not None:
+        params['format'] = format
+    return client.call('bdev_cache_create', params)
+
+
+def bdev_cache_delete(client, name):
+    """Delete a cache bdev. Its dirty data stays on the cache bdev.
+
+    Args:
+        name: name of the cache bdev to delete
+    """
+    params = {'name': name}
+    return client.call('bdev_cache_delete', params)
+
+
+def bdev_dedup_create(client, name, base_bdev_name, chunk_size_kb=None, logical_size_mb=None, format=None):
+    """Create a deduplicating bdev.
+
+    Args:
+        name: name of the dedup bdev
+        base_bdev_name: name of the bdev holding the metadata and the unique chunks
+        chunk_size_kb: size of a deduplicated chunk in KiB (optional)
+        logical_size_mb: size of the dedup bdev in MiB, may exceed the base bdev (optional)
+        format: format the base bdev even if it holds a dedup bdev (optional)
+
+    Returns:
+        Name of created block device.
+    """
+    params = {
+        'name': name,
+        'base_bdev_name': base_bdev_name,
+    }
+    if chunk_size_kb is not None:
+        params['chunk_size_kb'] = chunk_size_kb
+    if logical_size_mb is not None:
+        params['logical_size_mb'] = logical_size_mb
+    if format is not None:
+        params['format'] = format
+    return client.call('bdev_dedup_create', params)
+
+
+def bdev_dedup_delete(client, name):
+    """Delete a dedup bdev. Its data stays on the base bdev.
+
+    Args:
+        name: name of the dedup bdev to delete
+    """
+    params = {'name': name}
+    return client.call('bdev_dedup_delete', params)
+
+
 @deprecated_alias('construct_split_vbdev')
 def bdev_split_create(client, base_bdev, split_count, split_size_mb=None):
     """Create split block devices from a base bdev.
@@ -765,6 +998,15 @@ def bdev_get_iostat(client, name=None):
     return client.call('bdev_get_iostat', params)
 
 
+def bdev_get_io_cache_stats(client):
+    """Get statistics of the per-thread bdev_io caches.
+
+    Returns:
+        Cache size and hit/miss counters of each thread.
+    """
+    return client.call('bdev_get_io_cache_stats')
+
+
 @deprecated_alias('enable_bdev_histogram')
 def bdev_enable_histogram(client, name, enable):
     """Control whether histogram is enabled for specified bdev.
@@ -852,6 +1094,39 @@ def bdev_set_qos_limit(
     return client.call('bdev_set_qos_limit', params)
 
 
+def bdev_set_qos_latency_target(client, name, latency_target_usec):
+    """Set the p99 latency target of high priority I/O on a block device.
+
+    Args:
+        name: name of block device
+        latency_target_usec: target p99 latency in microseconds. 0 removes the target.
+    """
+    params = {'name': name, 'latency_target_usec': latency_target_usec}
+    return client.call('bdev_set_qos_latency_target', params)
+
+
+def bdev_set_qos_priority(client, name, desc_id, priority):
+    """Set the QoS priority class of a descriptor opened on a block device.
+
+    Args:
+        name: name of block device
+        desc_id: descriptor identifier, as reported by bdev_get_qos_latency_stats
+        priority: "high" or "low"
+    """
+    params = {'name': name, 'desc_id': desc_id, 'priority': priority}
+    return client.call('bdev_set_qos_priority', params)
+
+
+def bdev_get_qos_latency_stats(client, name):
+    """Get latency target controller statistics and descriptor priorities of a block device.
+
+    Args:
+        name: name of block device
+    """
+    params = {'name': name}
+    return client.call('bdev_get_qos_latency_stats', params)
+
+
 @deprecated_alias('apply_firmware')
 def bdev_nvme_apply_firmware(client, bdev_name, filename):
     """Download and commit firmware to NVMe device.
@@ -0,0 +1,16 @@
+def copy_set_sw_options(client, large_threshold=None, chunk_size=None):
+    """Set options of the software copy engine.
+
+    Args:
+        large_threshold: copies and fills of at least this many bytes are done in chunks from a poller
+            with non-temporal stores, 0 to disable (optional)
+        chunk_size: bytes of large copies and fills processed by each poller run (optional)
+    """
+    params = {}
+
+    if large_threshold is not None:
+        params['large_threshold'] = large_threshold
+    if chunk_size is not None:
+        params['chunk_size'] = chunk_size
+
+    return client.call('copy_set_sw_options', params)
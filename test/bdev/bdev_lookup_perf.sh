@@ -0,0 +1,90 @@
+#!/usr/bin/env bash
+
+# Measures how bdev name lookup and JSON config replay scale with the
+# number of registered bdevs.
+#
+# Usage: bdev_lookup_perf.sh [number of null bdevs (default 20000)]
+
+testdir=$(readlink -f $(dirname $0))
+rootdir=$(readlink -f $testdir/../..)
+rpc_server=/var/tmp/spdk-lookup.sock
+rpc_py="$rootdir/scripts/rpc.py -s $rpc_server"
+config_file=$testdir/lookup_perf.json
+rpcs_file=$testdir/lookup_rpcs.txt
+
+source $rootdir/test/common/autotest_common.sh
+
+num_bdevs=${1:-20000}
+
+function on_error_exit() {
+	if [ -n "$svc_pid" ]; then
+		killprocess $svc_pid
+	fi
+
+	rm -f $config_file $rpcs_file
+	print_backtrace
+	exit 1
+}
+
+function start_bdev_svc() {
+	$rootdir/test/app/bdev_svc/bdev_svc -r $rpc_server -i 0 &
+	svc_pid=$!
+	waitforlisten $svc_pid $rpc_server
+}
+
+# Runs RPCs from $rpcs_file in a single rpc.py session and prints the elapsed time in ms.
+function time_rpcs() {
+	local start end
+
+	start=$(date +%s%N)
+	$rpc_py < $rpcs_file > /dev/null
+	end=$(date +%s%N)
+
+	echo $(((end - start) / 1000000))
+}
+
+timing_enter bdev_lookup_perf
+trap 'on_error_exit;' ERR
+
+start_bdev_svc
+
+rm -f $rpcs_file
+for ((i = 0; i < num_bdevs; i++)); do
+	echo bdev_null_create Null$i 1 512 >> $rpcs_file
+done
+create_ms=$(time_rpcs)
+
+# Look the bdevs up in reverse registration order, which was the worst case
+# for a linear walk of the bdev list.
+rm -f $rpcs_file
+for ((i = num_bdevs - 1; i >= 0; i--)); do
+	echo bdev_get_bdevs -b Null$i >> $rpcs_file
+done
+lookup_ms=$(time_rpcs)
+
+$rpc_py save_config > $config_file
+killprocess $svc_pid
+
+start_bdev_svc
+
+start=$(date +%s%N)
+$rpc_py load_config < $config_file
+end=$(date +%s%N)
+replay_ms=$(((end - start) / 1000000))
+
+count=$($rpc_py bdev_get_bdevs | jq length)
+if [ $count -ne $num_bdevs ]; then
+	echo "Expected $num_bdevs bdevs after config replay, found $count"
+	false
+fi
+
+killprocess $svc_pid
+
+echo "bdevs: $num_bdevs"
+echo "create: $create_ms ms"
+echo "lookup: $lookup_ms ms ($((lookup_ms * 1000 / num_bdevs)) us per bdev_get_bdevs)"
+echo "config replay: $replay_ms ms"
+
+rm -f $config_file $rpcs_file
+trap - ERR
+timing_exit bdev_lookup_perf
@@ -0,0 +1,86 @@
+#!/usr/bin/env bash
+
+# Compares a slow bdev on its own with the same bdev behind the cache bdev with
+# bdevperf. The slow bdev is a delay bdev on a malloc bdev, the cache a smaller
+# malloc bdev, so that only part of the working set fits in the cache. Prints the
+# IOPS, the average latency derived from them and the read hit rate of the cache.
+#
+# Usage: cache_compare.sh [workload (default randrw)] [read percentage of rw workloads (default 70)]
+
+testdir=$(readlink -f $(dirname $0))
+rootdir=$(readlink -f $testdir/../../..)
+rpc_server=/var/tmp/spdk-bdevperf-cache.sock
+rpc_py="$rootdir/scripts/rpc.py -s $rpc_server"
+log_file=$testdir/cache_compare.log
+
+source $rootdir/test/common/autotest_common.sh
+
+workload=${1:-randrw}
+read_pct=${2:-70}
+io_size=4096
+queue_depth=32
+run_time=10
+base_size_mb=256
+cache_size_mb=128
+# Latency of the slow bdev in microseconds
+base_latency=200
+
+function on_error_exit() {
+	if [ -n "$perf_pid" ]; then
+		killprocess $perf_pid
+	fi
+
+	rm -f $log_file
+	print_backtrace
+	exit 1
+}
+
+# Runs bdevperf on the slow bdev alone, or behind a cache with the given
+# replacement policy, and prints the IOPS, the average latency and the hit rate.
+function run_bdevperf() {
+	local policy=$1
+	local iops hit_rate=- mix=""
+
+	if [[ $workload == *rw ]]; then
+		mix="-M $read_pct"
+	fi
+
+	$testdir/bdevperf -r $rpc_server -m 0x1 -z -q $queue_depth -o $io_size -w $workload $mix \
+		-t $run_time > $log_file 2>&1 &
+	perf_pid=$!
+	waitforlisten $perf_pid $rpc_server
+
+	$rpc_py bdev_malloc_create -b Malloc0 $base_size_mb $io_size
+	$rpc_py bdev_delay_create -b Malloc0 -d Slow0 -r $base_latency -t $base_latency \
+		-w $base_latency -n $base_latency
+	if [ $policy != none ]; then
+		$rpc_py bdev_malloc_create -b Malloc1 $cache_size_mb $io_size
+		$rpc_py bdev_cache_create -b Slow0 -c Malloc1 -n Cache0 -p $policy
+	fi
+
+	PYTHONPATH=$PYTHONPATH:$rootdir/scripts $testdir/bdevperf.py -s $rpc_server perform_tests > /dev/null
+	if [ $policy != none ]; then
+		hit_rate=$($rpc_py bdev_get_bdevs -b Cache0 | jq -r '.[0].driver_specific.cache.stats.read_hit_rate_pct')%
+	fi
+	killprocess $perf_pid
+	perf_pid=
+
+	iops=$(grep "Total" $log_file | awk '{printf "%d\n", $3}')
+	echo "$iops IOPS, $((queue_depth * 1000000 / (iops > 0 ? iops : 1))) us average latency, $hit_rate read hits"
+}
+
+timing_enter cache_compare
+trap 'on_error_exit;' ERR
+
+base_result=$(run_bdevperf none)
+lru_result=$(run_bdevperf lru)
+arc_result=$(run_bdevperf arc)
+
+echo "$workload, $read_pct% reads, $io_size bytes, queue depth $queue_depth"
+echo "${base_size_mb} MiB slow bdev with $base_latency us latency: $base_result"
+echo "${cache_size_mb} MiB LRU cache: $lru_result"
+echo "${cache_size_mb} MiB ARC cache: $arc_result"
+
+rm -f $log_file
+trap - ERR
+timing_exit cache_compare
@@ -0,0 +1,76 @@
+#!/usr/bin/env bash
+
+# Compares funneled and distributed bdev QoS with bdevperf. Every core submits
+# to a single null bdev. Each mode is run once with a rate limit far above what
+# the bdev can reach, which shows the cost of enforcing it, and once with a
+# limit that is reached, which shows how accurately it is kept.
+#
+# Usage: qos_mode_compare.sh [core mask (default 0xF)] [reached limit in IOPS (default 200000)]
+
+testdir=$(readlink -f $(dirname $0))
+rootdir=$(readlink -f $testdir/../../..)
+rpc_server=/var/tmp/spdk-bdevperf-qos.sock
+rpc_py="$rootdir/scripts/rpc.py -s $rpc_server"
+log_file=$testdir/qos_mode_compare.log
+
+source $rootdir/test/common/autotest_common.sh
+
+core_mask=${1:-0xF}
+low_limit=${2:-200000}
+high_limit=100000000
+run_time=10
+
+function on_error_exit() {
+	if [ -n "$perf_pid" ]; then
+		killprocess $perf_pid
+	fi
+
+	rm -f $log_file
+	print_backtrace
+	exit 1
+}
+
+# Runs bdevperf with the given bdev_set_options arguments and IOPS limit (0 for
+# no limit) and prints the total IOPS it reported.
+function run_bdevperf() {
+	local opts=$1
+	local limit=$2
+
+	$testdir/bdevperf -r $rpc_server -m $core_mask -z -C -q 64 -o 4096 -w randread -t $run_time \
+		--wait-for-rpc > $log_file 2>&1 &
+	perf_pid=$!
+	waitforlisten $perf_pid $rpc_server
+
+	$rpc_py bdev_set_options $opts
+	$rpc_py framework_start_init
+	$rpc_py bdev_null_create Null0 1024 4096
+	if [ $limit -ne 0 ]; then
+		$rpc_py bdev_set_qos_limit Null0 --rw_ios_per_sec $limit
+	fi
+
+	PYTHONPATH=$PYTHONPATH:$rootdir/scripts $testdir/bdevperf.py -s $rpc_server perform_tests > /dev/null
+	killprocess $perf_pid
+	perf_pid=
+
+	grep "Total" $log_file | awk '{printf "%d\n", $3}'
+}
+
+timing_enter qos_mode_compare
+trap 'on_error_exit;' ERR
+
+none_iops=$(run_bdevperf "" 0)
+funneled_high_iops=$(run_bdevperf "" $high_limit)
+distributed_high_iops=$(run_bdevperf "--qos-distributed" $high_limit)
+funneled_low_iops=$(run_bdevperf "" $low_limit)
+distributed_low_iops=$(run_bdevperf "--qos-distributed" $low_limit)
+
+echo "core mask: $core_mask"
+echo "no QoS: $none_iops IOPS"
+echo "limit $high_limit IOPS, funneled: $funneled_high_iops IOPS"
+echo "limit $high_limit IOPS, distributed: $distributed_high_iops IOPS"
+echo "limit $low_limit IOPS, funneled: $funneled_low_iops IOPS"
+echo "limit $low_limit IOPS, distributed: $distributed_low_iops IOPS"
+
+rm -f $log_file
+trap - ERR
+timing_exit qos_mode_compare
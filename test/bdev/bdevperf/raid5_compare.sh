@@ -0,0 +1,71 @@
+#!/usr/bin/env bash
+
+# Compares RAID5 with RAID0 over the same malloc bdevs with bdevperf. Full
+# stripe writes show the cost of computing parity, small random writes the cost
+# of read-modify-write, and reads should be on par.
+#
+# Usage: raid5_compare.sh [number of base bdevs (default 4)] [core mask (default 0x1)]
+
+testdir=$(readlink -f $(dirname $0))
+rootdir=$(readlink -f $testdir/../../..)
+rpc_server=/var/tmp/spdk-bdevperf-raid.sock
+rpc_py="$rootdir/scripts/rpc.py -s $rpc_server"
+log_file=$testdir/raid5_compare.log
+
+source $rootdir/test/common/autotest_common.sh
+
+num_base_bdevs=${1:-4}
+core_mask=${2:-0x1}
+strip_size_kb=64
+run_time=10
+
+function on_error_exit() {
+	if [ -n "$perf_pid" ]; then
+		killprocess $perf_pid
+	fi
+
+	rm -f $log_file
+	print_backtrace
+	exit 1
+}
+
+# Runs bdevperf on a raid bdev of the given level with the given workload and
+# I/O size and prints the total IOPS it reported.
+function run_bdevperf() {
+	local level=$1
+	local workload=$2
+	local io_size=$3
+	local base_bdevs=""
+
+	$testdir/bdevperf -r $rpc_server -m $core_mask -z -q 32 -o $io_size -w $workload -t $run_time \
+		> $log_file 2>&1 &
+	perf_pid=$!
+	waitforlisten $perf_pid $rpc_server
+
+	for ((i = 0; i < num_base_bdevs; i++)); do
+		$rpc_py bdev_malloc_create -b Malloc$i 256 4096
+		base_bdevs+="Malloc$i "
+	done
+	$rpc_py bdev_raid_create -n raid -z $strip_size_kb -r $level -b "$base_bdevs"
+
+	PYTHONPATH=$PYTHONPATH:$rootdir/scripts $testdir/bdevperf.py -s $rpc_server perform_tests > /dev/null
+	killprocess $perf_pid
+	perf_pid=
+
+	grep "Total" $log_file | awk '{printf "%d\n", $3}'
+}
+
+timing_enter raid5_compare
+trap 'on_error_exit;' ERR
+
+full_stripe=$((strip_size_kb * 1024 * (num_base_bdevs - 1)))
+for level in 0 5; do
+	echo "raid$level, $num_base_bdevs base bdevs, core mask $core_mask"
+	echo "  full stripe write ($full_stripe bytes): $(run_bdevperf $level write $full_stripe) IOPS"
+	echo "  4k random write: $(run_bdevperf $level randwrite 4096) IOPS"
+	echo "  4k random read: $(run_bdevperf $level randread 4096) IOPS"
+done
+
+rm -f $log_file
+trap - ERR
+timing_exit raid5_compare
@@ -0,0 +1,80 @@
+#!/usr/bin/env bash
+
+# Compares the uring bdev with the aio bdev on the same kernel block device with
+# bdevperf, and the uring bdev with each of its options: fixed files, fixed
+# buffers and SQ polling. SQ polling needs root and fixed buffers a large enough
+# RLIMIT_MEMLOCK, otherwise the uring bdev falls back to the plain mode.
+#
+# Usage: uring_compare.sh <block device> [workload (default randread)] [I/O size (default 4096)]
+
+testdir=$(readlink -f $(dirname $0))
+rootdir=$(readlink -f $testdir/../../..)
+rpc_server=/var/tmp/spdk-bdevperf-uring.sock
+rpc_py="$rootdir/scripts/rpc.py -s $rpc_server"
+log_file=$testdir/uring_compare.log
+
+source $rootdir/test/common/autotest_common.sh
+
+if [ -z "$1" ]; then
+	echo "Usage: $0 <block device> [workload] [I/O size]"
+	exit 1
+fi
+
+dev=$1
+workload=${2:-randread}
+io_size=${3:-4096}
+run_time=10
+
+function on_error_exit() {
+	if [ -n "$perf_pid" ]; then
+		killprocess $perf_pid
+	fi
+
+	rm -f $log_file
+	print_backtrace
+	exit 1
+}
+
+# Runs bdevperf on an aio bdev, or on a uring bdev with the given
+# bdev_uring_set_options arguments, and prints the total IOPS it reported.
+function run_bdevperf() {
+	local type=$1
+	local opts=$2
+
+	$testdir/bdevperf -r $rpc_server -m 0x1 -z -q 128 -o $io_size -w $workload -t $run_time \
+		--wait-for-rpc > $log_file 2>&1 &
+	perf_pid=$!
+	waitforlisten $perf_pid $rpc_server
+
+	if [ $type == uring ]; then
+		$rpc_py bdev_uring_set_options $opts
+	fi
+	$rpc_py framework_start_init
+	$rpc_py bdev_${type}_create $dev ${type}0
+
+	PYTHONPATH=$PYTHONPATH:$rootdir/scripts $testdir/bdevperf.py -s $rpc_server perform_tests > /dev/null
+	killprocess $perf_pid
+	perf_pid=
+
+	grep "Total" $log_file | awk '{printf "%d\n", $3}'
+}
+
+timing_enter uring_compare
+trap 'on_error_exit;' ERR
+
+aio_iops=$(run_bdevperf aio "")
+uring_iops=$(run_bdevperf uring "")
+files_iops=$(run_bdevperf uring "--fixed-files")
+buffers_iops=$(run_bdevperf uring "--fixed-files --fixed-buffers")
+sq_poll_iops=$(run_bdevperf uring "--fixed-buffers --sq-poll")
+
+echo "$dev, $workload, $io_size bytes"
+echo "aio: $aio_iops IOPS"
+echo "uring: $uring_iops IOPS"
+echo "uring, fixed files: $files_iops IOPS"
+echo "uring, fixed files and buffers: $buffers_iops IOPS"
+echo "uring, fixed buffers and SQ polling: $sq_poll_iops IOPS"
+
+rm -f $log_file
+trap - ERR
+timing_exit uring_compare
@@ -45,7 +45,7 @@ DEFINE_STUB(spdk_pci_nvme_get_driver, struct spdk_pci_driver *, (void), NULL)
 DEFINE_STUB(spdk_pci_ioat_get_driver, struct spdk_pci_driver *, (void), NULL)
 DEFINE_STUB(spdk_pci_virtio_get_driver, struct spdk_pci_driver *, (void), NULL)
 DEFINE_STUB(spdk_env_get_first_core, uint32_t, (void), 0);
-DEFINE_STUB(spdk_env_get_next_core, uint32_t, (uint32_t prev_core), 0);
+DEFINE_STUB(spdk_env_get_next_core, uint32_t, (uint32_t prev_core), UINT32_MAX);
 DEFINE_STUB(spdk_env_get_last_core, uint32_t, (void), 1);
 DEFINE_STUB(spdk_env_get_current_core, uint32_t, (void), 0);
 DEFINE_STUB(spdk_env_get_socket_id, uint32_t, (uint32_t core), 0);
@@ -271,6 +271,8 @@ spdk_mempool_get_bulk(struct spdk_mempool *mp, void **ele_arr, size_t count)
 	for (size_t i = 0; i < count; i++) {
 		ele_arr[i] = spdk_mempool_get(mp);
 		if (ele_arr[i] == NULL) {
+			/* Like DPDK, either all elements are retrieved or none. */
+			spdk_mempool_put_bulk(mp, ele_arr, i);
 			return -1;
 		}
 	}
@@ -0,0 +1,485 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+ * Fake block device layer for the unit tests of virtual bdevs stacked on top
+ * of other bdevs. The base bdevs keep their data in memory and queue their I/O
+ * until ut_complete_io() is called.
+ *
+ * Include it after common/lib/ut_multithread.c and the source of the virtual
+ * bdev, with UT_VBDEV_CREATE and UT_VBDEV_DELETE defined to the functions that
+ * create and delete one.
+ */
+
+#ifndef UT_VBDEV_H
+#define UT_VBDEV_H
+
+#include "spdk_cunit.h"
+#include "spdk/bdev_module.h"
+#include "spdk/uuid.h"
+#include "spdk_internal/mock.h"
+
+#define UT_BLOCK_SIZE		512
+#define UT_BASE_BLOCKS		1024
+#define UT_MAX_IOVS		4
+
+struct ut_disk {
+	struct spdk_bdev	bdev;
+	uint8_t			*data;
+	TAILQ_ENTRY(ut_disk)	link;
+};
+
+struct ut_io {
+	struct ut_disk			*disk;
+	bool				write;
+	struct iovec			iovs[UT_MAX_IOVS];
+	int				iovcnt;
+	uint64_t			offset_blocks;
+	uint64_t			num_blocks;
+	spdk_bdev_io_completion_cb	cb;
+	void				*cb_arg;
+	TAILQ_ENTRY(ut_io)		link;
+};
+
+static struct ut_disk g_base;
+static TAILQ_HEAD(, ut_disk) g_disks = TAILQ_HEAD_INITIALIZER(g_disks);
+static TAILQ_HEAD(, ut_io) g_pending = TAILQ_HEAD_INITIALIZER(g_pending);
+static struct spdk_bdev *g_registered;
+static struct spdk_bdev *g_created;
+static int g_create_rc;
+static spdk_bdev_unregister_cb g_unregister_cb;
+static void *g_unregister_cb_arg;
+static int g_delete_rc;
+static uint32_t g_io_done;
+static enum spdk_bdev_io_status g_io_status;
+static struct spdk_thread *g_io_thread;
+static struct spdk_thread *g_complete_thread;
+
+DEFINE_STUB_V(spdk_bdev_module_list_add, (struct spdk_bdev_module *bdev_module));
+DEFINE_STUB(spdk_bdev_module_claim_bdev, int, (struct spdk_bdev *bdev, struct spdk_bdev_desc *desc,
+		struct spdk_bdev_module *module), 0);
+DEFINE_STUB_V(spdk_bdev_module_release_bdev, (struct spdk_bdev *bdev));
+DEFINE_STUB_V(spdk_bdev_close, (struct spdk_bdev_desc *desc));
+DEFINE_STUB(spdk_bdev_io_type_supported, bool, (struct spdk_bdev *bdev,
+		enum spdk_bdev_io_type io_type), false);
+DEFINE_STUB(spdk_bdev_get_md_size, uint32_t, (const struct spdk_bdev *bdev), 0);
+DEFINE_STUB(spdk_bdev_get_buf_align, size_t, (const struct spdk_bdev *bdev), 64);
+DEFINE_STUB(spdk_bdev_queue_io_wait, int, (struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+		struct spdk_bdev_io_wait_entry *entry), 0);
+DEFINE_STUB(spdk_bdev_flush_blocks, int, (struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+		uint64_t offset_blocks, uint64_t num_blocks, spdk_bdev_io_completion_cb cb,
+		void *cb_arg), 0);
+
+const char *
+spdk_bdev_get_name(const struct spdk_bdev *bdev)
+{
+	return bdev->name;
+}
+
+uint64_t
+spdk_bdev_get_num_blocks(const struct spdk_bdev *bdev)
+{
+	return bdev->blockcnt;
+}
+
+uint32_t
+spdk_bdev_get_block_size(const struct spdk_bdev *bdev)
+{
+	return bdev->blocklen;
+}
+
+const struct spdk_uuid *
+spdk_bdev_get_uuid(const struct spdk_bdev *bdev)
+{
+	return &bdev->uuid;
+}
+
+struct spdk_bdev *
+spdk_bdev_get_by_name(const char *bdev_name)
+{
+	struct ut_disk *disk;
+
+	TAILQ_FOREACH(disk, &g_disks, link) {
+		if (strcmp(bdev_name, disk->bdev.name) == 0) {
+			return &disk->bdev;
+		}
+	}
+	if (g_registered != NULL && strcmp(bdev_name, g_registered->name) == 0) {
+		return g_registered;
+	}
+
+	return NULL;
+}
+
+int
+spdk_bdev_open(struct spdk_bdev *bdev, bool write, spdk_bdev_remove_cb_t remove_cb,
+	       void *remove_ctx, struct spdk_bdev_desc **desc)
+{
+	*desc = (struct spdk_bdev_desc *)SPDK_CONTAINEROF(bdev, struct ut_disk, bdev);
+
+	return 0;
+}
+
+struct spdk_bdev *
+spdk_bdev_desc_get_bdev(struct spdk_bdev_desc *desc)
+{
+	return &((struct ut_disk *)desc)->bdev;
+}
+
+struct spdk_io_channel *
+spdk_bdev_get_io_channel(struct spdk_bdev_desc *desc)
+{
+	return spdk_get_io_channel(desc);
+}
+
+int
+spdk_bdev_register(struct spdk_bdev *bdev)
+{
+	g_registered = bdev;
+
+	return 0;
+}
+
+void
+spdk_bdev_unregister(struct spdk_bdev *bdev, spdk_bdev_unregister_cb cb_fn, void *cb_arg)
+{
+	int rc;
+
+	g_unregister_cb = cb_fn;
+	g_unregister_cb_arg = cb_arg;
+	g_registered = NULL;
+
+	rc = bdev->fn_table->destruct(bdev->ctxt);
+	if (rc <= 0 && cb_fn != NULL) {
+		cb_fn(cb_arg, rc);
+	}
+}
+
+void
+spdk_bdev_destruct_done(struct spdk_bdev *bdev, int bdeverrno)
+{
+	if (g_unregister_cb != NULL) {
+		g_unregister_cb(g_unregister_cb_arg, bdeverrno);
+	}
+}
+
+void
+spdk_bdev_io_get_buf(struct spdk_bdev_io *bdev_io, spdk_bdev_io_get_buf_cb cb, uint64_t len)
+{
+	cb(NULL, bdev_io, true);
+}
+
+struct spdk_thread *
+spdk_bdev_io_get_thread(struct spdk_bdev_io *bdev_io)
+{
+	return g_io_thread;
+}
+
+void
+spdk_bdev_io_complete(struct spdk_bdev_io *bdev_io, enum spdk_bdev_io_status status)
+{
+	g_io_done++;
+	g_io_status = status;
+	g_complete_thread = spdk_get_thread();
+}
+
+void
+spdk_bdev_free_io(struct spdk_bdev_io *bdev_io)
+{
+	free(bdev_io);
+}
+
+static int
+ut_queue_io(struct spdk_bdev_desc *desc, bool write, struct iovec *iovs, int iovcnt,
+	    uint64_t offset_blocks, uint64_t num_blocks, spdk_bdev_io_completion_cb cb,
+	    void *cb_arg)
+{
+	struct ut_io *io = calloc(1, sizeof(*io));
+
+	SPDK_CU_ASSERT_FATAL(io != NULL);
+	SPDK_CU_ASSERT_FATAL(iovcnt <= UT_MAX_IOVS);
+	io->disk = (struct ut_disk *)desc;
+	CU_ASSERT(offset_blocks + num_blocks <= io->disk->bdev.blockcnt);
+	io->write = write;
+	memcpy(io->iovs, iovs, iovcnt * sizeof(*iovs));
+	io->iovcnt = iovcnt;
+	io->offset_blocks = offset_blocks;
+	io->num_blocks = num_blocks;
+	io->cb = cb;
+	io->cb_arg = cb_arg;
+	TAILQ_INSERT_TAIL(&g_pending, io, link);
+
+	return 0;
+}
+
+int
+spdk_bdev_readv_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+		       struct iovec *iov, int iovcnt, uint64_t offset_blocks, uint64_t num_blocks,
+		       spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	return ut_queue_io(desc, false, iov, iovcnt, offset_blocks, num_blocks, cb, cb_arg);
+}
+
+int
+spdk_bdev_read_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+		      void *buf, uint64_t offset_blocks, uint64_t num_blocks,
+		      spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = num_blocks * UT_BLOCK_SIZE };
+
+	return ut_queue_io(desc, false, &iov, 1, offset_blocks, num_blocks, cb, cb_arg);
+}
+
+int
+spdk_bdev_writev_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+			struct iovec *iov, int iovcnt, uint64_t offset_blocks, uint64_t num_blocks,
+			spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	return ut_queue_io(desc, true, iov, iovcnt, offset_blocks, num_blocks, cb, cb_arg);
+}
+
+int
+spdk_bdev_write_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+		       void *buf, uint64_t offset_blocks, uint64_t num_blocks,
+		       spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = num_blocks * UT_BLOCK_SIZE };
+
+	return ut_queue_io(desc, true, &iov, 1, offset_blocks, num_blocks, cb, cb_arg);
+}
+
+/* Complete the I/O submitted so far, in order, and return how many there were. */
+static int
+ut_complete_io(void)
+{
+	TAILQ_HEAD(, ut_io) ios = TAILQ_HEAD_INITIALIZER(ios);
+	struct spdk_bdev_io *bdev_io;
+	struct ut_io *io;
+	uint8_t *data;
+	int i, count = 0;
+
+	TAILQ_CONCAT(&ios, &g_pending, link);
+	while ((io = TAILQ_FIRST(&ios))) {
+		TAILQ_REMOVE(&ios, io, link);
+		data = io->disk->data + io->offset_blocks * UT_BLOCK_SIZE;
+		for (i = 0; i < io->iovcnt; i++) {
+			if (io->write) {
+				memcpy(data, io->iovs[i].iov_base, io->iovs[i].iov_len);
+			} else {
+				memcpy(io->iovs[i].iov_base, data, io->iovs[i].iov_len);
+			}
+			data += io->iovs[i].iov_len;
+		}
+
+		bdev_io = calloc(1, sizeof(*bdev_io));
+		SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+		io->cb(bdev_io, true, io->cb_arg);
+		free(io);
+		count++;
+	}
+
+	return count;
+}
+
+static void
+ut_drain(void)
+{
+	do {
+		poll_threads();
+	} while (ut_complete_io() > 0);
+	poll_threads();
+}
+
+/* Let the given time pass, running pollers and completing I/O. */
+static void
+ut_run_for(uint32_t us)
+{
+	uint32_t i;
+
+	for (i = 0; i < us / 100; i++) {
+		spdk_delay_us(100);
+		ut_drain();
+	}
+}
+
+static int
+ut_ch_create_cb(void *io_device, void *ctx_buf)
+{
+	return 0;
+}
+
+static void
+ut_ch_destroy_cb(void *io_device, void *ctx_buf)
+{
+}
+
+/* Set up an empty base bdev that can be opened by name until ut_teardown(). */
+static void
+ut_disk_init(struct ut_disk *disk, const char *name, uint64_t blockcnt)
+{
+	memset(disk, 0, sizeof(*disk));
+	disk->bdev.name = (char *)name;
+	disk->bdev.blocklen = UT_BLOCK_SIZE;
+	disk->bdev.blockcnt = blockcnt;
+	spdk_uuid_generate(&disk->bdev.uuid);
+	disk->data = calloc(blockcnt, UT_BLOCK_SIZE);
+	SPDK_CU_ASSERT_FATAL(disk->data != NULL);
+	spdk_io_device_register(disk, ut_ch_create_cb, ut_ch_destroy_cb, 0, name);
+	TAILQ_INSERT_TAIL(&g_disks, disk, link);
+}
+
+static void
+ut_setup(void)
+{
+	allocate_threads(2);
+	set_thread(0);
+
+	ut_disk_init(&g_base, "base", UT_BASE_BLOCKS);
+}
+
+static void
+ut_teardown(void)
+{
+	struct ut_disk *disk;
+
+	set_thread(0);
+	while ((disk = TAILQ_FIRST(&g_disks))) {
+		TAILQ_REMOVE(&g_disks, disk, link);
+		spdk_io_device_unregister(disk, NULL);
+		poll_threads();
+		free(disk->data);
+	}
+	free_threads();
+}
+
+static void
+ut_create_cb(void *cb_arg, struct spdk_bdev *bdev, int bdeverrno)
+{
+	g_created = bdev;
+	g_create_rc = bdeverrno;
+}
+
+static int
+ut_try_create(const void *opts)
+{
+	g_created = NULL;
+	g_create_rc = 1;
+	UT_VBDEV_CREATE(opts, ut_create_cb, NULL);
+	ut_drain();
+
+	return g_create_rc;
+}
+
+static struct spdk_bdev *
+ut_create(const void *opts)
+{
+	CU_ASSERT(ut_try_create(opts) == 0);
+	SPDK_CU_ASSERT_FATAL(g_created != NULL);
+
+	return g_created;
+}
+
+static void
+ut_delete_cb(void *cb_arg, int bdeverrno)
+{
+	g_delete_rc = bdeverrno;
+}
+
+static void
+ut_delete(struct spdk_bdev *bdev)
+{
+	g_delete_rc = 1;
+	UT_VBDEV_DELETE(bdev, ut_delete_cb, NULL);
+	ut_run_for(2000);
+	CU_ASSERT(g_delete_rc == 0);
+}
+
+/* Submit I/O to the virtual bdev from the given thread without completing anything. */
+static struct spdk_bdev_io *
+ut_submit(struct spdk_bdev *bdev, uintptr_t thread, enum spdk_bdev_io_type type, void *buf,
+	  uint64_t offset_blocks, uint64_t num_blocks)
+{
+	struct spdk_bdev_io *bdev_io;
+	size_t ctx_size = bdev->module->get_ctx_size();
+	struct iovec *iov;
+
+	bdev_io = calloc(1, sizeof(*bdev_io) + ctx_size + sizeof(*iov));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+	iov = (struct iovec *)((uint8_t *)bdev_io->driver_ctx + ctx_size);
+	iov->iov_base = buf;
+	iov->iov_len = num_blocks * UT_BLOCK_SIZE;
+	bdev_io->bdev = bdev;
+	bdev_io->type = type;
+	bdev_io->u.bdev.iovs = iov;
+	bdev_io->u.bdev.iovcnt = 1;
+	bdev_io->u.bdev.offset_blocks = offset_blocks;
+	bdev_io->u.bdev.num_blocks = num_blocks;
+
+	set_thread(thread);
+	g_io_thread = spdk_get_thread();
+	bdev->fn_table->submit_request(NULL, bdev_io);
+	set_thread(0);
+
+	return bdev_io;
+}
+
+/* Submit I/O from thread 0 and run until it completes. */
+static int
+ut_io(struct spdk_bdev *bdev, enum spdk_bdev_io_type type, void *buf, uint64_t offset_blocks,
+      uint64_t num_blocks)
+{
+	struct spdk_bdev_io *bdev_io;
+
+	g_io_done = 0;
+	g_io_status = SPDK_BDEV_IO_STATUS_PENDING;
+	bdev_io = ut_submit(bdev, 0, type, buf, offset_blocks, num_blocks);
+	ut_drain();
+	free(bdev_io);
+	CU_ASSERT(g_io_done == 1);
+
+	return g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS ? 0 : -EIO;
+}
+
+/* Fill each block with a byte that depends on its offset. */
+static void
+ut_fill(void *buf, uint64_t offset_blocks, uint64_t num_blocks, uint8_t seed)
+{
+	uint64_t i;
+
+	for (i = 0; i < num_blocks; i++) {
+		memset((uint8_t *)buf + i * UT_BLOCK_SIZE, (uint8_t)(seed + offset_blocks + i),
+		       UT_BLOCK_SIZE);
+	}
+}
+
+#endif /* UT_VBDEV_H */
@@ -79,6 +79,10 @@ mkdir -p /tmp/pmem
 # per patch bdevperf uses slightly different params than nightly
 run_bdevperf 32 4096 3
 
+# the software engine, on the main thread and on worker threads
+$testdir/sw_perf/sw_perf -t 1
+$testdir/sw_perf/sw_perf -t 1 -w 2
+
 if [ $RUN_NIGHTLY -eq 1 ]; then
 	run_bdevio
 	run_bdevperf 64 16384 30
@@ -0,0 +1,351 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/env.h"
+#include "spdk/string.h"
+#include "spdk/util.h"
+
+/* The engine is not part of a library of its own, so build it in. */
+#include "bdev/compress/vbdev_compress_sw.c"
+
+/*
+ * Measures the software deflate engine of the compress vbdev. For each ISA-L
+ * level it compresses and decompresses a set of chunks for a while, and prints
+ * the throughput in MiB/s of uncompressed data and the compression ratio. The
+ * data is read from a file, or generated with the given share of
+ * compressible bytes.
+ *
+ * With -w, chunks are compressed through the worker threads of the engine
+ * with -q operations outstanding, the way the vbdev uses it.
+ */
+
+#define SW_PERF_NUM_CHUNKS	64
+
+static uint32_t g_chunk_size = 16 * 1024;
+static int g_level = -1;
+static int g_compressible = 50;
+static int g_time_in_sec = 3;
+static uint32_t g_num_workers;
+static uint32_t g_queue_depth = 32;
+static const char *g_file;
+
+static uint8_t *g_data;
+static uint8_t *g_comp;
+static uint32_t g_comp_len[SW_PERF_NUM_CHUNKS];
+
+static void
+usage(const char *prog)
+{
+	printf("usage: %s [options]\n", prog);
+	printf("Options:\n");
+	printf("\t[-f file to read the chunks from]\n");
+	printf("\t[-c percent of compressible bytes of generated data (default 50)]\n");
+	printf("\t[-s chunk size in bytes (default 16384)]\n");
+	printf("\t[-l level, %d to %d (default all)]\n", COMP_SW_LEVEL_MIN, COMP_SW_LEVEL_MAX);
+	printf("\t[-t time in seconds per level (default 3)]\n");
+	printf("\t[-w number of worker threads, 0 runs on the main thread (default 0)]\n");
+	printf("\t[-q operations outstanding to the workers (default 32)]\n");
+}
+
+static int
+fill_data(void)
+{
+	size_t size = (size_t)g_chunk_size * SW_PERF_NUM_CHUNKS;
+	size_t i, len;
+	FILE *f;
+
+	if (g_file != NULL) {
+		f = fopen(g_file, "r");
+		if (f == NULL) {
+			fprintf(stderr, "could not open %s: %s\n", g_file, spdk_strerror(errno));
+			return -errno;
+		}
+		len = fread(g_data, 1, size, f);
+		fclose(f);
+		if (len == 0) {
+			fprintf(stderr, "%s is empty\n", g_file);
+			return -EINVAL;
+		}
+		/* Repeat a short file, which flatters the ratio only across chunks. */
+		for (i = len; i < size; i++) {
+			g_data[i] = g_data[i % len];
+		}
+		return 0;
+	}
+
+	/* Each 64 byte block starts with random bytes and ends with a repeated pattern. */
+	for (i = 0; i < size; i++) {
+		if ((i % 64) < (size_t)(64 * (100 - g_compressible) / 100)) {
+			g_data[i] = rand();
+		} else {
+			g_data[i] = 'a' + (i % 8);
+		}
+	}
+	return 0;
+}
+
+static double
+mib_per_sec(uint64_t bytes, uint64_t ticks)
+{
+	return (double)bytes / (1024 * 1024) / ((double)ticks / spdk_get_ticks_hz());
+}
+
+static int
+run_inline(struct comp_sw_ctx *ctx, uint32_t level)
+{
+	struct iovec src, dst;
+	uint64_t start, ticks, in_bytes = 0, out_bytes = 0, count = 0;
+	uint64_t duration = g_time_in_sec * spdk_get_ticks_hz();
+	uint32_t i;
+	int rc;
+
+	start = spdk_get_ticks();
+	do {
+		i = count++ % SW_PERF_NUM_CHUNKS;
+		src.iov_base = g_data + (size_t)i * g_chunk_size;
+		src.iov_len = g_chunk_size;
+		dst.iov_base = g_comp + (size_t)i * g_chunk_size * 2;
+		dst.iov_len = g_chunk_size * 2;
+		rc = comp_sw_deflate(ctx, level, &src, 1, &dst, 1);
+		if (rc < 0) {
+			fprintf(stderr, "deflate failed: %s\n", spdk_strerror(-rc));
+			return rc;
+		}
+		g_comp_len[i] = rc;
+		in_bytes += g_chunk_size;
+		out_bytes += rc;
+		ticks = spdk_get_ticks() - start;
+	} while (ticks < duration || count < SW_PERF_NUM_CHUNKS);
+
+	printf("level %u: compress %10.1f MiB/s ratio %5.2f", level,
+	       mib_per_sec(in_bytes, ticks), (double)in_bytes / out_bytes);
+
+	in_bytes = 0;
+	count = 0;
+	start = spdk_get_ticks();
+	do {
+		i = count++ % SW_PERF_NUM_CHUNKS;
+		src.iov_base = g_comp + (size_t)i * g_chunk_size * 2;
+		src.iov_len = g_comp_len[i];
+		dst.iov_base = g_data + (size_t)SW_PERF_NUM_CHUNKS * g_chunk_size;
+		dst.iov_len = g_chunk_size;
+		rc = comp_sw_inflate(ctx, &src, 1, &dst, 1);
+		if (rc != (int)g_chunk_size ||
+		    memcmp(dst.iov_base, g_data + (size_t)i * g_chunk_size, g_chunk_size) != 0) {
+			fprintf(stderr, "\ninflate of chunk %u failed: %d\n", i, rc);
+			return -EIO;
+		}
+		in_bytes += g_chunk_size;
+		ticks = spdk_get_ticks() - start;
+	} while (ticks < duration);
+
+	printf(" decompress %10.1f MiB/s\n", mib_per_sec(in_bytes, ticks));
+	return 0;
+}
+
+static int
+run_workers(uint32_t level)
+{
+	struct comp_sw_op *ops, *done[32];
+	struct iovec *iovs;
+	struct spdk_ring *cq;
+	uint64_t start, ticks, in_bytes = 0, out_bytes = 0;
+	uint64_t duration = g_time_in_sec * spdk_get_ticks_hz();
+	uint32_t i, outstanding = 0;
+	size_t n, j;
+	int rc = 0;
+
+	ops = calloc(g_queue_depth, sizeof(*ops));
+	iovs = calloc(g_queue_depth * 2, sizeof(*iovs));
+	cq = spdk_ring_create(SPDK_RING_TYPE_MP_SC, g_queue_depth, SPDK_ENV_SOCKET_ID_ANY);
+	if (ops == NULL || iovs == NULL || cq == NULL) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	start = spdk_get_ticks();
+	for (i = 0; i < g_queue_depth; i++) {
+		iovs[i * 2].iov_base = g_data + (size_t)(i % SW_PERF_NUM_CHUNKS) * g_chunk_size;
+		iovs[i * 2].iov_len = g_chunk_size;
+		/* Each op has a destination of its own, the workers write concurrently. */
+		iovs[i * 2 + 1].iov_base = g_comp + (size_t)i * g_chunk_size * 2;
+		iovs[i * 2 + 1].iov_len = g_chunk_size * 2;
+		ops[i].src_iovs = &iovs[i * 2];
+		ops[i].src_iovcnt = 1;
+		ops[i].dst_iovs = &iovs[i * 2 + 1];
+		ops[i].dst_iovcnt = 1;
+		ops[i].compress = true;
+		ops[i].level = level;
+		ops[i].cq = cq;
+		comp_sw_engine_submit(&ops[i]);
+		outstanding++;
+	}
+
+	do {
+		n = spdk_ring_dequeue(cq, (void **)done, SPDK_COUNTOF(done));
+		ticks = spdk_get_ticks() - start;
+		for (j = 0; j < n; j++) {
+			outstanding--;
+			if (done[j]->result < 0) {
+				fprintf(stderr, "deflate failed: %s\n",
+					spdk_strerror(-done[j]->result));
+				rc = done[j]->result;
+				continue;
+			}
+			in_bytes += g_chunk_size;
+			out_bytes += done[j]->result;
+			if (ticks < duration && rc == 0) {
+				comp_sw_engine_submit(done[j]);
+				outstanding++;
+			}
+		}
+	} while (outstanding > 0);
+
+	if (rc == 0) {
+		printf("level %u: compress %10.1f MiB/s ratio %5.2f with %u workers\n", level,
+		       mib_per_sec(in_bytes, ticks), (double)in_bytes / out_bytes, g_num_workers);
+	}
+out:
+	spdk_ring_free(cq);
+	free(iovs);
+	free(ops);
+	return rc;
+}
+
+int
+main(int argc, char **argv)
+{
+	struct spdk_env_opts opts;
+	struct comp_sw_ctx *ctx = NULL;
+	uint32_t level, num_bufs;
+	int ch;
+	int rc = 0;
+
+	while ((ch = getopt(argc, argv, "c:f:l:q:s:t:w:")) != -1) {
+		switch (ch) {
+		case 'c':
+			g_compressible = spdk_strtol(optarg, 10);
+			break;
+		case 'f':
+			g_file = optarg;
+			break;
+		case 'l':
+			g_level = spdk_strtol(optarg, 10);
+			break;
+		case 'q':
+			g_queue_depth = spdk_strtol(optarg, 10);
+			break;
+		case 's':
+			g_chunk_size = spdk_strtol(optarg, 10);
+			break;
+		case 't':
+			g_time_in_sec = spdk_strtol(optarg, 10);
+			break;
+		case 'w':
+			g_num_workers = spdk_strtol(optarg, 10);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (g_compressible < 0 || g_compressible > 100 || g_level < -1 ||
+	    g_level > COMP_SW_LEVEL_MAX || (int)g_chunk_size <= 0 || g_time_in_sec <= 0 ||
+	    (int)g_queue_depth <= 0 || (int)g_num_workers < 0) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	spdk_env_opts_init(&opts);
+	opts.name = "compress_sw_perf";
+	if (spdk_env_init(&opts)) {
+		fprintf(stderr, "Unable to initialize SPDK env\n");
+		return 1;
+	}
+
+	/* Room for the chunks plus one to decompress into, and for twice the chunk size
+	 * per compressed chunk or per op outstanding to the workers.
+	 */
+	num_bufs = spdk_max(SW_PERF_NUM_CHUNKS, g_queue_depth);
+	g_data = malloc((size_t)g_chunk_size * (SW_PERF_NUM_CHUNKS + 1));
+	g_comp = malloc((size_t)g_chunk_size * 2 * num_bufs);
+	if (g_data == NULL || g_comp == NULL) {
+		fprintf(stderr, "Unable to allocate buffers\n");
+		rc = 1;
+		goto out;
+	}
+
+	if (fill_data()) {
+		rc = 1;
+		goto out;
+	}
+
+	if (g_num_workers == 0) {
+		ctx = comp_sw_ctx_alloc();
+		if (ctx == NULL) {
+			fprintf(stderr, "Unable to allocate the codec context\n");
+			rc = 1;
+			goto out;
+		}
+	} else if (comp_sw_engine_start(g_num_workers)) {
+		fprintf(stderr, "Unable to start the workers\n");
+		rc = 1;
+		goto out;
+	}
+
+	printf("%u byte chunks, %s\n", g_chunk_size, g_file ? g_file : "generated data");
+	for (level = COMP_SW_LEVEL_MIN; level <= COMP_SW_LEVEL_MAX; level++) {
+		if (g_level != -1 && level != (uint32_t)g_level) {
+			continue;
+		}
+		if (g_num_workers == 0) {
+			rc = run_inline(ctx, level);
+		} else {
+			rc = run_workers(level);
+		}
+		if (rc) {
+			rc = 1;
+			break;
+		}
+	}
+
+	comp_sw_engine_stop();
+	comp_sw_ctx_free(ctx);
+out:
+	free(g_comp);
+	free(g_data);
+	return rc;
+}
@@ -8,5 +8,12 @@ timing_enter event
 $testdir/event_perf/event_perf -m 0xF -t 1
 $testdir/reactor/reactor -t 1
 $testdir/reactor_perf/reactor_perf -t 1
+$testdir/interrupt_perf/interrupt_perf -m 0x3 -t 1
+$testdir/interrupt_perf/interrupt_perf -m 0x3 -t 1 -i
+$testdir/msg_perf/msg_perf -m 0x3 -n 4 -t 1
+$testdir/msg_perf/msg_perf -m 0x3 -n 4 -b 8 -t 1
+$testdir/msg_perf/msg_perf -m 0x3 -n 4 -t 1 -l
+$testdir/poller_perf/poller_perf -n 100 -t 1
+$testdir/poller_perf/poller_perf -n 10000 -t 1
 report_test_completion "event"
 timing_exit event
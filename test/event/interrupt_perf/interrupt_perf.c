@@ -0,0 +1,315 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/env.h"
+#include "spdk/event.h"
+#include "spdk/string.h"
+#include "spdk/thread.h"
+
+/*
+ * Sends messages at a fixed rate from the master core to a thread on another
+ * core, which bounces them back, and reports the round trip latency and the
+ * CPU time used by the process. Comparing runs with and without -i shows what
+ * interrupt mode saves at low load and what it costs in latency.
+ */
+
+static int g_time_in_sec;
+static uint64_t g_rate = 1000;
+static bool g_interrupt_mode;
+static uint64_t g_idle_usec;
+
+static struct spdk_thread *g_ping_thread;
+static struct spdk_thread *g_pong_thread;
+static struct spdk_poller *g_ping_poller;
+static struct spdk_poller *g_test_end_poller;
+
+static bool g_in_flight;
+static uint64_t g_sent_tsc;
+static uint64_t *g_latencies;
+static uint64_t g_max_latencies;
+static uint64_t g_latency_count;
+static uint64_t g_skipped;
+
+static bool g_stopped;
+static uint64_t g_start_tsc;
+static struct rusage g_start_usage;
+static double g_ticks_per_usec;
+static double g_wall_sec;
+static double g_cpu_sec;
+
+static double
+timeval_sec(const struct timeval *tv)
+{
+	return tv->tv_sec + tv->tv_usec / 1000000.0;
+}
+
+static void
+pong_done(void *arg)
+{
+	uint64_t latency = spdk_get_ticks() - g_sent_tsc;
+
+	if (g_latency_count < g_max_latencies) {
+		g_latencies[g_latency_count++] = latency;
+	}
+	g_in_flight = false;
+}
+
+static void
+pong(void *arg)
+{
+	spdk_thread_send_msg(g_ping_thread, pong_done, NULL);
+}
+
+static int
+ping(void *arg)
+{
+	if (g_in_flight) {
+		g_skipped++;
+		return 0;
+	}
+
+	g_in_flight = true;
+	g_sent_tsc = spdk_get_ticks();
+	spdk_thread_send_msg(g_pong_thread, pong, NULL);
+
+	return 0;
+}
+
+static void
+pong_exit(void *arg)
+{
+	spdk_thread_exit(spdk_get_thread());
+}
+
+static int
+test_end(void *arg)
+{
+	struct rusage usage;
+
+	if (g_stopped) {
+		return -1;
+	}
+	g_stopped = true;
+
+	getrusage(RUSAGE_SELF, &usage);
+	g_wall_sec = (spdk_get_ticks() - g_start_tsc) / g_ticks_per_usec / 1000000.0;
+	g_cpu_sec = timeval_sec(&usage.ru_utime) - timeval_sec(&g_start_usage.ru_utime) +
+		    timeval_sec(&usage.ru_stime) - timeval_sec(&g_start_usage.ru_stime);
+
+	spdk_poller_unregister(&g_ping_poller);
+	spdk_poller_unregister(&g_test_end_poller);
+	spdk_thread_send_msg(g_pong_thread, pong_exit, NULL);
+	spdk_app_stop(0);
+
+	return -1;
+}
+
+static void
+test_start(void *arg1)
+{
+	struct spdk_cpuset *cpumask;
+	uint32_t core;
+	int rc;
+
+	g_ping_thread = spdk_get_thread();
+
+	core = spdk_env_get_next_core(spdk_env_get_current_core());
+	if (core == UINT32_MAX) {
+		core = spdk_env_get_first_core();
+	}
+	if (core == spdk_env_get_current_core()) {
+		fprintf(stderr, "At least two cores are needed\n");
+		spdk_app_stop(-1);
+		return;
+	}
+
+	cpumask = spdk_cpuset_alloc();
+	if (cpumask == NULL) {
+		spdk_app_stop(-1);
+		return;
+	}
+	spdk_cpuset_set_cpu(cpumask, core, true);
+	g_pong_thread = spdk_thread_create("pong", cpumask);
+	spdk_cpuset_free(cpumask);
+	if (g_pong_thread == NULL) {
+		spdk_app_stop(-1);
+		return;
+	}
+
+	rc = spdk_reactor_set_interrupt_mode(g_interrupt_mode, g_idle_usec);
+	if (rc != 0) {
+		fprintf(stderr, "Unable to set interrupt mode: %s\n", spdk_strerror(-rc));
+		spdk_app_stop(-1);
+		return;
+	}
+
+	printf("Sending %" PRIu64 " messages per second between cores %u and %u, interrupt mode %s\n",
+	       g_rate, spdk_env_get_current_core(), core, g_interrupt_mode ? "on" : "off");
+
+	g_ticks_per_usec = spdk_get_ticks_hz() / 1000000.0;
+	g_start_tsc = spdk_get_ticks();
+	getrusage(RUSAGE_SELF, &g_start_usage);
+
+	g_ping_poller = spdk_poller_register(ping, NULL, 1000000 / g_rate);
+	g_test_end_poller = spdk_poller_register(test_end, NULL, g_time_in_sec * 1000000ULL);
+}
+
+static void
+test_cleanup(void)
+{
+	test_end(NULL);
+}
+
+static int
+latency_cmp(const void *a, const void *b)
+{
+	uint64_t la = *(const uint64_t *)a, lb = *(const uint64_t *)b;
+
+	return la < lb ? -1 : la > lb;
+}
+
+static void
+print_results(void)
+{
+	uint64_t i, total = 0;
+
+	if (g_latency_count == 0) {
+		printf("No messages completed\n");
+		return;
+	}
+
+	qsort(g_latencies, g_latency_count, sizeof(*g_latencies), latency_cmp);
+	for (i = 0; i < g_latency_count; i++) {
+		total += g_latencies[i];
+	}
+
+	printf("Round trips: %" PRIu64 " (%" PRIu64 " skipped while one was in flight)\n",
+	       g_latency_count, g_skipped);
+	printf("Latency (us): avg %.2f, p50 %.2f, p99 %.2f, max %.2f\n",
+	       total / g_ticks_per_usec / g_latency_count,
+	       g_latencies[g_latency_count / 2] / g_ticks_per_usec,
+	       g_latencies[g_latency_count * 99 / 100] / g_ticks_per_usec,
+	       g_latencies[g_latency_count - 1] / g_ticks_per_usec);
+	printf("CPU: %.2f s in %.2f s (%.1f%% of one core)\n", g_cpu_sec, g_wall_sec,
+	       g_wall_sec > 0 ? g_cpu_sec * 100 / g_wall_sec : 0);
+}
+
+static void
+usage(const char *program_name)
+{
+	printf("%s options\n", program_name);
+	printf("\t[-m core mask, at least two cores (default: 0x3)]\n");
+	printf("\t[-r messages per second (default: 1000)]\n");
+	printf("\t[-i enable interrupt mode]\n");
+	printf("\t[-I idle period in microseconds before a reactor blocks]\n");
+	printf("\t[-t time in seconds]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	struct spdk_app_opts opts;
+	int op;
+	int rc;
+	long int val;
+
+	spdk_app_opts_init(&opts);
+	opts.name = "interrupt_perf";
+	opts.reactor_mask = "0x3";
+
+	g_time_in_sec = 0;
+
+	while ((op = getopt(argc, argv, "iI:m:r:t:")) != -1) {
+		switch (op) {
+		case 'i':
+			g_interrupt_mode = true;
+			continue;
+		case 'm':
+			opts.reactor_mask = optarg;
+			continue;
+		case '?':
+			usage(argv[0]);
+			exit(1);
+		default:
+			break;
+		}
+
+		val = spdk_strtol(optarg, 10);
+		if (val < 0) {
+			fprintf(stderr, "Converting a string to integer failed\n");
+			exit(1);
+		}
+		switch (op) {
+		case 'I':
+			g_idle_usec = val;
+			break;
+		case 'r':
+			g_rate = val;
+			break;
+		case 't':
+			g_time_in_sec = val;
+			break;
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (!g_time_in_sec || g_rate == 0 || g_rate > 1000000) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	g_max_latencies = g_rate * g_time_in_sec;
+	g_latencies = calloc(g_max_latencies, sizeof(*g_latencies));
+	if (g_latencies == NULL) {
+		fprintf(stderr, "Unable to allocate memory for latencies\n");
+		exit(1);
+	}
+
+	opts.shutdown_cb = test_cleanup;
+
+	rc = spdk_app_start(&opts, test_start, NULL);
+
+	spdk_app_fini();
+
+	if (rc == 0) {
+		print_results();
+	}
+
+	free(g_latencies);
+
+	return rc;
+}
@@ -0,0 +1,389 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/env.h"
+#include "spdk/event.h"
+#include "spdk/string.h"
+#include "spdk/thread.h"
+
+/*
+ * Measures message passing between SPDK threads. Each worker thread keeps a
+ * number of messages in flight to the next worker, which sends them straight
+ * back. Reports the message rate and the round trip latency. Comparing runs
+ * with different bulk sizes and with -l shows what bulk sends and message
+ * lanes save over single messages through the shared ring.
+ */
+
+struct msg_ctx {
+	struct worker		*origin;
+	uint64_t		tsc;
+};
+
+struct worker {
+	struct spdk_thread	*thread;
+	struct worker		*peer;
+	struct msg_ctx		*ctxs;
+
+	/* Contexts whose round trip completed and that wait for a full bulk. */
+	void			**ready;
+	uint32_t		ready_count;
+	uint32_t		outstanding;
+
+	uint64_t		count;
+	uint64_t		latency_tsc;
+	uint64_t		max_latency_tsc;
+};
+
+static int g_time_in_sec;
+static uint32_t g_num_workers;
+static uint32_t g_queue_depth = 32;
+static uint32_t g_bulk = 1;
+static bool g_lanes = true;
+
+static struct worker *g_workers;
+static struct spdk_thread *g_master_thread;
+static struct spdk_poller *g_test_end_poller;
+static uint32_t g_workers_done;
+
+static bool g_stopped;
+static uint64_t g_start_tsc;
+static double g_ticks_per_usec;
+static double g_elapsed_sec;
+
+static void complete(void *arg);
+
+static void
+echo(void *arg)
+{
+	struct msg_ctx *ctx = arg;
+
+	spdk_thread_send_msg(ctx->origin->thread, complete, ctx);
+}
+
+static void
+worker_submit(struct worker *worker)
+{
+	uint64_t now = spdk_get_ticks();
+	void **ctxs;
+	uint32_t i;
+
+	while (worker->ready_count >= g_bulk) {
+		worker->ready_count -= g_bulk;
+		ctxs = &worker->ready[worker->ready_count];
+
+		for (i = 0; i < g_bulk; i++) {
+			((struct msg_ctx *)ctxs[i])->tsc = now;
+		}
+
+		if (g_bulk == 1) {
+			spdk_thread_send_msg(worker->peer->thread, echo, ctxs[0]);
+		} else if (spdk_thread_send_msg_bulk(worker->peer->thread, echo, ctxs, g_bulk) != g_bulk) {
+			fprintf(stderr, "Unable to send messages\n");
+			abort();
+		}
+		worker->outstanding += g_bulk;
+	}
+}
+
+static void
+worker_exit(void *arg)
+{
+	spdk_thread_exit(spdk_get_thread());
+}
+
+static void
+worker_done(void *arg)
+{
+	uint32_t i;
+
+	if (++g_workers_done < g_num_workers) {
+		return;
+	}
+
+	for (i = 0; i < g_num_workers; i++) {
+		spdk_thread_send_msg(g_workers[i].thread, worker_exit, NULL);
+	}
+	spdk_app_stop(0);
+}
+
+static void
+complete(void *arg)
+{
+	struct msg_ctx *ctx = arg;
+	struct worker *worker = ctx->origin;
+	uint64_t latency;
+
+	worker->outstanding--;
+
+	if (__atomic_load_n(&g_stopped, __ATOMIC_RELAXED)) {
+		if (worker->outstanding == 0) {
+			spdk_thread_send_msg(g_master_thread, worker_done, NULL);
+		}
+		return;
+	}
+
+	latency = spdk_get_ticks() - ctx->tsc;
+	worker->count++;
+	worker->latency_tsc += latency;
+	worker->max_latency_tsc = spdk_max(worker->max_latency_tsc, latency);
+
+	worker->ready[worker->ready_count++] = ctx;
+	worker_submit(worker);
+}
+
+static void
+worker_start(void *arg)
+{
+	struct worker *worker = arg;
+	uint32_t i;
+
+	for (i = 0; i < g_queue_depth; i++) {
+		worker->ctxs[i].origin = worker;
+		worker->ready[i] = &worker->ctxs[i];
+	}
+	worker->ready_count = g_queue_depth;
+
+	worker_submit(worker);
+}
+
+static int
+test_end(void *arg)
+{
+	if (g_stopped) {
+		return -1;
+	}
+
+	g_elapsed_sec = (spdk_get_ticks() - g_start_tsc) / g_ticks_per_usec / 1000000.0;
+	__atomic_store_n(&g_stopped, true, __ATOMIC_RELAXED);
+	spdk_poller_unregister(&g_test_end_poller);
+
+	return -1;
+}
+
+static void
+test_start(void *arg1)
+{
+	struct spdk_cpuset *cpumask;
+	uint32_t core, i;
+
+	g_master_thread = spdk_get_thread();
+	spdk_thread_lib_set_msg_lanes(g_lanes);
+
+	if (g_num_workers == 0) {
+		g_num_workers = spdk_env_get_core_count();
+	}
+	if (g_num_workers < 2) {
+		g_num_workers = 2;
+	}
+
+	g_workers = calloc(g_num_workers, sizeof(*g_workers));
+	cpumask = spdk_cpuset_alloc();
+	if (g_workers == NULL || cpumask == NULL) {
+		fprintf(stderr, "Unable to allocate memory for workers\n");
+		spdk_cpuset_free(cpumask);
+		spdk_app_stop(-1);
+		return;
+	}
+
+	/* Spread the workers over the cores round robin. */
+	core = spdk_env_get_first_core();
+	for (i = 0; i < g_num_workers; i++) {
+		struct worker *worker = &g_workers[i];
+		char name[32];
+
+		worker->ctxs = calloc(g_queue_depth, sizeof(*worker->ctxs));
+		worker->ready = calloc(g_queue_depth, sizeof(*worker->ready));
+		if (worker->ctxs == NULL || worker->ready == NULL) {
+			fprintf(stderr, "Unable to allocate memory for workers\n");
+			spdk_cpuset_free(cpumask);
+			spdk_app_stop(-1);
+			return;
+		}
+
+		spdk_cpuset_zero(cpumask);
+		spdk_cpuset_set_cpu(cpumask, core, true);
+		snprintf(name, sizeof(name), "msg_perf_%u", i);
+		worker->thread = spdk_thread_create(name, cpumask);
+		if (worker->thread == NULL) {
+			fprintf(stderr, "Unable to create thread %s\n", name);
+			spdk_cpuset_free(cpumask);
+			spdk_app_stop(-1);
+			return;
+		}
+
+		core = spdk_env_get_next_core(core);
+		if (core == UINT32_MAX) {
+			core = spdk_env_get_first_core();
+		}
+	}
+	spdk_cpuset_free(cpumask);
+
+	for (i = 0; i < g_num_workers; i++) {
+		g_workers[i].peer = &g_workers[(i + 1) % g_num_workers];
+	}
+
+	printf("%u threads on %u cores, %u messages in flight per thread, bulk size %u, lanes %s\n",
+	       g_num_workers, spdk_env_get_core_count(), g_queue_depth, g_bulk, g_lanes ? "on" : "off");
+
+	g_ticks_per_usec = spdk_get_ticks_hz() / 1000000.0;
+	g_start_tsc = spdk_get_ticks();
+
+	for (i = 0; i < g_num_workers; i++) {
+		spdk_thread_send_msg(g_workers[i].thread, worker_start, &g_workers[i]);
+	}
+
+	g_test_end_poller = spdk_poller_register(test_end, NULL, g_time_in_sec * 1000000ULL);
+}
+
+static void
+test_cleanup(void)
+{
+	test_end(NULL);
+}
+
+static void
+print_results(void)
+{
+	uint64_t count = 0, latency_tsc = 0, max_latency_tsc = 0;
+	uint32_t i;
+
+	for (i = 0; i < g_num_workers; i++) {
+		count += g_workers[i].count;
+		latency_tsc += g_workers[i].latency_tsc;
+		max_latency_tsc = spdk_max(max_latency_tsc, g_workers[i].max_latency_tsc);
+	}
+
+	if (count == 0 || g_elapsed_sec == 0) {
+		printf("No messages completed\n");
+		return;
+	}
+
+	/* Every round trip is two messages. */
+	printf("Messages: %" PRIu64 " (%.0f per second)\n", count * 2, count * 2 / g_elapsed_sec);
+	printf("Round trip latency (us): avg %.2f, max %.2f\n",
+	       latency_tsc / g_ticks_per_usec / count, max_latency_tsc / g_ticks_per_usec);
+}
+
+static void
+usage(const char *program_name)
+{
+	printf("%s options\n", program_name);
+	printf("\t[-m core mask (default: 0x3)]\n");
+	printf("\t[-n number of threads (default: one per core, at least 2)]\n");
+	printf("\t[-q messages in flight per thread (default: 32)]\n");
+	printf("\t[-b bulk size, must divide -q (default: 1, single messages)]\n");
+	printf("\t[-l disable message lanes]\n");
+	printf("\t[-t time in seconds]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	struct spdk_app_opts opts;
+	uint32_t i;
+	int op;
+	int rc;
+	long int val;
+
+	spdk_app_opts_init(&opts);
+	opts.name = "msg_perf";
+	opts.reactor_mask = "0x3";
+
+	g_time_in_sec = 0;
+
+	while ((op = getopt(argc, argv, "b:lm:n:q:t:")) != -1) {
+		switch (op) {
+		case 'l':
+			g_lanes = false;
+			continue;
+		case 'm':
+			opts.reactor_mask = optarg;
+			continue;
+		case '?':
+			usage(argv[0]);
+			exit(1);
+		default:
+			break;
+		}
+
+		val = spdk_strtol(optarg, 10);
+		if (val < 0) {
+			fprintf(stderr, "Converting a string to integer failed\n");
+			exit(1);
+		}
+		switch (op) {
+		case 'b':
+			g_bulk = val;
+			break;
+		case 'n':
+			g_num_workers = val;
+			break;
+		case 'q':
+			g_queue_depth = val;
+			break;
+		case 't':
+			g_time_in_sec = val;
+			break;
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (!g_time_in_sec || g_bulk == 0 || g_queue_depth == 0 || g_queue_depth % g_bulk != 0) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	opts.shutdown_cb = test_cleanup;
+
+	rc = spdk_app_start(&opts, test_start, NULL);
+
+	spdk_app_fini();
+
+	if (rc == 0) {
+		print_results();
+	}
+
+	if (g_workers != NULL) {
+		for (i = 0; i < g_num_workers; i++) {
+			free(g_workers[i].ctxs);
+			free(g_workers[i].ready);
+		}
+		free(g_workers);
+	}
+
+	return rc;
+}
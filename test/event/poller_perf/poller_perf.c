@@ -0,0 +1,202 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/env.h"
+#include "spdk/event.h"
+#include "spdk/string.h"
+#include "spdk/thread.h"
+
+/*
+ * Registers a number of timed pollers with different periods on one thread
+ * and reports how many times they ran and how many ticks the thread spent per
+ * run. The pollers do no work, so the ticks per run are the cost of running
+ * and re-arming a timed poller. Comparing runs with different -n shows how
+ * that cost scales with the number of timed pollers.
+ */
+
+static int g_time_in_sec;
+static uint32_t g_num_pollers = 1000;
+static uint64_t g_period_usec = 1000;
+
+static struct spdk_poller **g_pollers;
+static struct spdk_poller *g_test_end_poller;
+static uint64_t g_run_count;
+static struct spdk_thread_stats g_start_stats;
+static uint64_t g_busy_tsc;
+static bool g_stopped;
+
+static int
+poller_run(void *arg)
+{
+	g_run_count++;
+
+	return 1;
+}
+
+static int
+test_end(void *arg)
+{
+	struct spdk_thread_stats stats;
+	uint32_t i;
+
+	if (g_stopped) {
+		return -1;
+	}
+	g_stopped = true;
+
+	spdk_thread_get_stats(&stats);
+	g_busy_tsc = stats.busy_tsc - g_start_stats.busy_tsc;
+
+	for (i = 0; i < g_num_pollers; i++) {
+		spdk_poller_unregister(&g_pollers[i]);
+	}
+	spdk_poller_unregister(&g_test_end_poller);
+	spdk_app_stop(0);
+
+	return -1;
+}
+
+static void
+test_start(void *arg1)
+{
+	uint64_t spread;
+	uint32_t i;
+
+	/*
+	 * Spread the periods over a range as wide as the base period so that the
+	 * pollers expire in a different order every round.
+	 */
+	spread = spdk_max(g_num_pollers, 1);
+	for (i = 0; i < g_num_pollers; i++) {
+		g_pollers[i] = spdk_poller_register(poller_run, NULL,
+						    g_period_usec + (i * 7919) % spread * g_period_usec / spread);
+		if (g_pollers[i] == NULL) {
+			fprintf(stderr, "Unable to register poller %u\n", i);
+			test_end(NULL);
+			return;
+		}
+	}
+
+	printf("%u timed pollers with periods from %" PRIu64 " to %" PRIu64 " us\n",
+	       g_num_pollers, g_period_usec, g_period_usec * 2);
+
+	spdk_thread_get_stats(&g_start_stats);
+	g_test_end_poller = spdk_poller_register(test_end, NULL, g_time_in_sec * 1000000ULL);
+}
+
+static void
+test_cleanup(void)
+{
+	test_end(NULL);
+}
+
+static void
+usage(const char *program_name)
+{
+	printf("%s options\n", program_name);
+	printf("\t[-n number of timed pollers (default: 1000)]\n");
+	printf("\t[-p base poller period in microseconds (default: 1000)]\n");
+	printf("\t[-t time in seconds]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	struct spdk_app_opts opts;
+	int op;
+	int rc;
+	long int val;
+
+	spdk_app_opts_init(&opts);
+	opts.name = "poller_perf";
+	opts.reactor_mask = "0x1";
+
+	g_time_in_sec = 0;
+
+	while ((op = getopt(argc, argv, "n:p:t:")) != -1) {
+		if (op == '?') {
+			usage(argv[0]);
+			exit(1);
+		}
+		val = spdk_strtol(optarg, 10);
+		if (val < 0) {
+			fprintf(stderr, "Converting a string to integer failed\n");
+			exit(1);
+		}
+		switch (op) {
+		case 'n':
+			g_num_pollers = val;
+			break;
+		case 'p':
+			g_period_usec = val;
+			break;
+		case 't':
+			g_time_in_sec = val;
+			break;
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (!g_time_in_sec || g_period_usec == 0) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	g_pollers = calloc(spdk_max(g_num_pollers, 1), sizeof(*g_pollers));
+	if (g_pollers == NULL) {
+		fprintf(stderr, "Unable to allocate memory for pollers\n");
+		exit(1);
+	}
+
+	opts.shutdown_cb = test_cleanup;
+
+	rc = spdk_app_start(&opts, test_start, NULL);
+
+	spdk_app_fini();
+
+	if (rc == 0) {
+		printf("Poller runs: %" PRIu64 " (%" PRIu64 " per second)\n", g_run_count,
+		       g_run_count / g_time_in_sec);
+		if (g_run_count != 0) {
+			printf("Busy ticks per run: %" PRIu64 "\n", g_busy_tsc / g_run_count);
+		}
+	}
+
+	free(g_pollers);
+
+	return rc;
+}
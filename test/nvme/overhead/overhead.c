@@ -88,6 +88,8 @@ struct ns_entry {
 struct perf_task {
 	void			*buf;
 	uint64_t		submit_tsc;
+	struct iovec		*iovs;
+	uint32_t		iov_pos;
 #if HAVE_LIBAIO
 	struct iocb		iocb;
 #endif
@@ -101,6 +103,7 @@ static struct ns_entry *g_ns = NULL;
 static uint64_t g_tsc_rate;
 
 static uint32_t g_io_size_bytes;
+static uint32_t g_iov_count;
 static int g_time_in_sec;
 
 static int g_aio_optind; /* Index of first AIO filename in argv */
@@ -285,6 +288,31 @@ static void io_complete(void *ctx, const struct spdk_nvme_cpl *completion);
 
 static __thread unsigned int seed = 0;
 
+static void
+reset_sgl(void *ref, uint32_t sgl_offset)
+{
+	struct perf_task *task = ref;
+
+	assert(sgl_offset == 0);
+	task->iov_pos = 0;
+}
+
+static int
+next_sge(void *ref, void **address, uint32_t *length)
+{
+	struct perf_task *task = ref;
+
+	if (task->iov_pos == g_iov_count) {
+		return -1;
+	}
+
+	*address = task->iovs[task->iov_pos].iov_base;
+	*length = task->iovs[task->iov_pos].iov_len;
+	task->iov_pos++;
+
+	return 0;
+}
+
 static void
 submit_single_io(void)
 {
@@ -304,7 +332,12 @@ submit_single_io(void)
 				g_io_size_bytes, offset_in_ios * g_io_size_bytes, g_task);
 	} else
 #endif
-	{
+	if (g_iov_count > 0) {
+		rc = spdk_nvme_ns_cmd_readv(entry->u.nvme.ns, g_ns->u.nvme.qpair,
+					    offset_in_ios * entry->io_size_blocks,
+					    entry->io_size_blocks, io_complete, g_task, 0,
+					    reset_sgl, next_sge);
+	} else {
 		rc = spdk_nvme_ns_cmd_read(entry->u.nvme.ns, g_ns->u.nvme.qpair, g_task->buf,
 					   offset_in_ios * entry->io_size_blocks,
 					   entry->io_size_blocks, io_complete, g_task, 0);
@@ -487,6 +520,7 @@ static void usage(char *program_name)
 	printf("\t[-s io size in bytes]\n");
 	printf("\t[-t time in seconds]\n");
 	printf("\t\t(default: 1)]\n");
+	printf("\t[-v number of 4KiB aligned buffers the I/O is split into (SPDK only)]\n");
 	printf("\t[-H enable histograms]\n");
 }
 
@@ -513,6 +547,7 @@ print_stats(void)
 {
 	double divisor = (double)g_tsc_rate / (1000 * 1000 * 1000);
 
+	printf("%u byte I/O in %u buffer(s)\n", g_io_size_bytes, spdk_max(g_iov_count, 1));
 	printf("submit (in ns)   avg, min, max = %8.1f, %8.1f, %8.1f\n",
 	       (double)g_tsc_submit / g_io_completed / divisor,
 	       (double)g_tsc_submit_min / divisor,
@@ -551,7 +586,7 @@ parse_args(int argc, char **argv)
 	g_io_size_bytes = 0;
 	g_time_in_sec = 0;
 
-	while ((op = getopt(argc, argv, "hs:t:H")) != -1) {
+	while ((op = getopt(argc, argv, "hs:t:v:H")) != -1) {
 		switch (op) {
 		case 'h':
 			usage(argv[0]);
@@ -572,6 +607,14 @@ parse_args(int argc, char **argv)
 				return g_time_in_sec;
 			}
 			break;
+		case 'v':
+			val = spdk_strtol(optarg, 10);
+			if (val <= 0) {
+				fprintf(stderr, "Invalid number of buffers\n");
+				return val < 0 ? val : 1;
+			}
+			g_iov_count = (uint32_t)val;
+			break;
 		case 'H':
 			g_enable_histogram = true;
 			break;
@@ -589,6 +632,10 @@ parse_args(int argc, char **argv)
 		usage(argv[0]);
 		return 1;
 	}
+	if (g_iov_count > 0 && (g_io_size_bytes % (g_iov_count * 0x1000)) != 0) {
+		fprintf(stderr, "io size must be a multiple of 4KiB buffers\n");
+		return 1;
+	}
 
 	g_aio_optind = optind;
 
@@ -668,6 +715,7 @@ cleanup(void)
 int main(int argc, char **argv)
 {
 	int			rc;
+	uint32_t		i, iov_len;
 	struct spdk_env_opts	opts;
 
 	rc = parse_args(argc, argv);
@@ -696,10 +744,29 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
+	if (g_iov_count > 0) {
+		g_task->iovs = calloc(g_iov_count, sizeof(struct iovec));
+		if (g_task->iovs == NULL) {
+			fprintf(stderr, "g_task->iovs alloc failed\n");
+			exit(1);
+		}
+
+		/* Split the buffer in place, so that only the number of elements differs. */
+		iov_len = g_io_size_bytes / g_iov_count;
+		for (i = 0; i < g_iov_count; i++) {
+			g_task->iovs[i].iov_base = (uint8_t *)g_task->buf + i * iov_len;
+			g_task->iovs[i].iov_len = iov_len;
+		}
+	}
+
 	g_tsc_rate = spdk_get_ticks_hz();
 
 #if HAVE_LIBAIO
 	if (g_aio_optind < argc) {
+		if (g_iov_count > 0) {
+			fprintf(stderr, "-v is not supported for AIO devices\n");
+			return 1;
+		}
 		printf("Measuring overhead for AIO device %s.\n", argv[g_aio_optind]);
 		if (register_aio_file(argv[g_aio_optind]) != 0) {
 			cleanup();
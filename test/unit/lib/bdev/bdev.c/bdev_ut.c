@@ -804,6 +804,65 @@ alias_add_del_test(void)
 	free(bdev[2]);
 }
 
+static void
+name_lookup_test(void)
+{
+	struct spdk_bdev *bdev[512];
+	char name[512][16];
+	char alias[32];
+	int i, rc;
+
+	/* Register enough bdevs to force the name index to grow several times */
+	for (i = 0; i < 512; i++) {
+		snprintf(name[i], sizeof(name[i]), "bdev%d", i);
+		bdev[i] = allocate_bdev(name[i]);
+		SPDK_CU_ASSERT_FATAL(bdev[i] != NULL);
+
+		snprintf(alias, sizeof(alias), "alias%d", i);
+		rc = spdk_bdev_alias_add(bdev[i], alias);
+		CU_ASSERT(rc == 0);
+	}
+
+	for (i = 0; i < 512; i++) {
+		CU_ASSERT(spdk_bdev_get_by_name(name[i]) == bdev[i]);
+		snprintf(alias, sizeof(alias), "alias%d", i);
+		CU_ASSERT(spdk_bdev_get_by_name(alias) == bdev[i]);
+	}
+	CU_ASSERT(spdk_bdev_get_by_name("bdev512") == NULL);
+
+	/* An alias cannot shadow a name or alias of another bdev */
+	rc = spdk_bdev_alias_add(bdev[0], "bdev1");
+	CU_ASSERT(rc == -EEXIST);
+	rc = spdk_bdev_alias_add(bdev[0], "alias1");
+	CU_ASSERT(rc == -EEXIST);
+
+	/* Deleted aliases are no longer found and can be reused */
+	rc = spdk_bdev_alias_del(bdev[1], "alias1");
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(spdk_bdev_get_by_name("alias1") == NULL);
+	rc = spdk_bdev_alias_add(bdev[0], "alias1");
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(spdk_bdev_get_by_name("alias1") == bdev[0]);
+
+	/* Unregistering a bdev removes its name and all of its aliases */
+	spdk_bdev_unregister(bdev[0], NULL, NULL);
+	poll_threads();
+	CU_ASSERT(spdk_bdev_get_by_name("bdev0") == NULL);
+	CU_ASSERT(spdk_bdev_get_by_name("alias0") == NULL);
+	CU_ASSERT(spdk_bdev_get_by_name("alias1") == NULL);
+	spdk_bdev_alias_del_all(bdev[0]);
+	free(bdev[0]);
+
+	for (i = 1; i < 512; i++) {
+		spdk_bdev_alias_del_all(bdev[i]);
+		free_bdev(bdev[i]);
+		CU_ASSERT(spdk_bdev_get_by_name(name[i]) == NULL);
+	}
+
+	CU_ASSERT(g_bdev_mgr.names.count == 0);
+	CU_ASSERT(g_bdev_mgr.names.buckets == NULL);
+}
+
 static void
 io_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
 {
@@ -960,6 +1019,219 @@ bdev_io_wait_test(void)
 	poll_threads();
 }
 
+static void
+io_cache_stat_cb(const struct spdk_bdev_io_cache_stat *stat, void *cb_arg)
+{
+	*(struct spdk_bdev_io_cache_stat *)cb_arg = *stat;
+}
+
+static void
+io_cache_stats_done(void *cb_arg, int rc)
+{
+	g_status = rc;
+	g_count++;
+}
+
+static void
+bdev_io_cache_test(void)
+{
+	struct spdk_bdev *bdev;
+	struct spdk_bdev_desc *desc = NULL;
+	struct spdk_io_channel *io_ch;
+	struct spdk_bdev_mgmt_channel *mgmt_ch;
+	struct spdk_bdev_io_cache_stat stat = {};
+	struct spdk_bdev_opts bdev_opts = {
+		.bdev_io_pool_size = 64,
+		.bdev_io_cache_size = 4,
+	};
+	int i, rc;
+
+	rc = spdk_bdev_set_opts(&bdev_opts);
+	CU_ASSERT(rc == 0);
+	spdk_bdev_initialize(bdev_init_cb, NULL);
+	poll_threads();
+
+	bdev = allocate_bdev("bdev0");
+
+	rc = spdk_bdev_open(bdev, true, NULL, NULL, &desc);
+	CU_ASSERT(rc == 0);
+	poll_threads();
+	SPDK_CU_ASSERT_FATAL(desc != NULL);
+	io_ch = spdk_bdev_get_io_channel(desc);
+	CU_ASSERT(io_ch != NULL);
+	mgmt_ch = ((struct spdk_bdev_channel *)spdk_io_channel_get_ctx(io_ch))->shared_resource->mgmt_ch;
+
+	/* The cache is pre-populated with the configured minimum */
+	CU_ASSERT(mgmt_ch->bdev_io_cache_size == 4);
+	CU_ASSERT(mgmt_ch->per_thread_cache_count == 4);
+
+	/* Exceeding the cache refills it from the pool in batches */
+	for (i = 0; i < 20; i++) {
+		rc = spdk_bdev_read_blocks(desc, io_ch, NULL, 0, 1, io_done, NULL);
+		CU_ASSERT(rc == 0);
+	}
+	CU_ASSERT(mgmt_ch->cache_stat.hits > 4);
+	CU_ASSERT(mgmt_ch->cache_stat.misses < 16);
+	CU_ASSERT(mgmt_ch->peak_outstanding_io_count == 20);
+
+	stub_complete_io(20);
+	CU_ASSERT(mgmt_ch->per_thread_cache_count == 4);
+
+	/* The cache grows to fit the peak number of outstanding bdev_ios */
+	spdk_delay_us(SPDK_BDEV_IO_CACHE_ADJUST_PERIOD_USEC);
+	poll_threads();
+	CU_ASSERT(mgmt_ch->bdev_io_cache_size == 20);
+	CU_ASSERT(mgmt_ch->cache_stat.grows == 1);
+
+	for (i = 0; i < 20; i++) {
+		rc = spdk_bdev_read_blocks(desc, io_ch, NULL, 0, 1, io_done, NULL);
+		CU_ASSERT(rc == 0);
+	}
+	stub_complete_io(20);
+	CU_ASSERT(mgmt_ch->per_thread_cache_count == 20);
+
+	/* The growth is capped */
+	for (i = 0; i < 40; i++) {
+		rc = spdk_bdev_read_blocks(desc, io_ch, NULL, 0, 1, io_done, NULL);
+		CU_ASSERT(rc == 0);
+	}
+	stub_complete_io(40);
+	spdk_delay_us(SPDK_BDEV_IO_CACHE_ADJUST_PERIOD_USEC);
+	poll_threads();
+	CU_ASSERT(mgmt_ch->bdev_io_cache_size == 4 * SPDK_BDEV_IO_CACHE_MAX_GROWTH);
+
+	/* Once idle, the cache gradually shrinks back to the minimum */
+	for (i = 0; i < 10; i++) {
+		spdk_delay_us(SPDK_BDEV_IO_CACHE_ADJUST_PERIOD_USEC);
+		poll_threads();
+	}
+	CU_ASSERT(mgmt_ch->bdev_io_cache_size == 4);
+	CU_ASSERT(mgmt_ch->per_thread_cache_count == 4);
+	CU_ASSERT(mgmt_ch->cache_stat.shrinks > 1);
+
+	g_count = 0;
+	spdk_bdev_get_io_cache_stats(io_cache_stat_cb, io_cache_stats_done, &stat);
+	poll_threads();
+	CU_ASSERT(g_count == 1);
+	CU_ASSERT(g_status == 0);
+	CU_ASSERT(stat.cache_size == 4);
+	CU_ASSERT(stat.cache_count == 4);
+	CU_ASSERT(stat.hits == mgmt_ch->cache_stat.hits);
+	CU_ASSERT(stat.misses == mgmt_ch->cache_stat.misses);
+	CU_ASSERT(stat.pool_empty == 0);
+
+	spdk_put_io_channel(io_ch);
+	spdk_bdev_close(desc);
+	free_bdev(bdev);
+	spdk_bdev_finish(bdev_fini_cb, NULL);
+	poll_threads();
+}
+
+static void
+bdev_buf_cache_test(void)
+{
+	struct spdk_bdev *bdev;
+	struct spdk_bdev_desc *desc = NULL;
+	struct spdk_io_channel *io_ch;
+	struct spdk_bdev_mgmt_channel *mgmt_ch;
+	struct spdk_bdev_buf_cache *tiny;
+	struct spdk_bdev_io_cache_stat stat = {};
+	struct spdk_bdev_opts bdev_opts = {
+		.bdev_io_pool_size = 64,
+		.bdev_io_cache_size = 4,
+		.tiny_buf_pool_size = 8,
+		.small_buf_pool_size = 8,
+		.large_buf_pool_size = 8,
+		.huge_buf_pool_size = 8,
+	};
+	int i, rc;
+
+	rc = spdk_bdev_set_opts(&bdev_opts);
+	CU_ASSERT(rc == 0);
+	spdk_bdev_initialize(bdev_init_cb, NULL);
+	poll_threads();
+
+	fn_table.submit_request = stub_submit_request_aligned_buffer;
+	bdev = allocate_bdev("bdev0");
+
+	rc = spdk_bdev_open(bdev, true, NULL, NULL, &desc);
+	CU_ASSERT(rc == 0);
+	poll_threads();
+	SPDK_CU_ASSERT_FATAL(desc != NULL);
+	io_ch = spdk_bdev_get_io_channel(desc);
+	CU_ASSERT(io_ch != NULL);
+	mgmt_ch = ((struct spdk_bdev_channel *)spdk_io_channel_get_ctx(io_ch))->shared_resource->mgmt_ch;
+	tiny = &mgmt_ch->buf_cache[0];
+
+	/* With a single thread, half of each pool may be cached */
+	for (i = 0; i < SPDK_BDEV_NUM_BUF_CLASSES; i++) {
+		CU_ASSERT(g_bdev_mgr.buf_cache_sizes[i] == 4);
+		CU_ASSERT(mgmt_ch->buf_cache[i].count == 0);
+	}
+
+	/* A miss refills the cache from the pool in one batch */
+	rc = spdk_bdev_read_blocks(desc, io_ch, NULL, 0, 1, io_done, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(tiny->stat.misses == 1);
+	CU_ASSERT(tiny->count == 4);
+	CU_ASSERT(spdk_mempool_count(g_bdev_mgr.buf_pools[0]) == 3);
+
+	rc = spdk_bdev_read_blocks(desc, io_ch, NULL, 0, 1, io_done, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(tiny->stat.hits == 1);
+	CU_ASSERT(tiny->count == 3);
+	stub_complete_io(2);
+	CU_ASSERT(tiny->count == 2);
+	CU_ASSERT(spdk_mempool_count(g_bdev_mgr.buf_pools[0]) == 6);
+
+	/* Each size is served from the smallest class that fits it */
+	rc = spdk_bdev_read_blocks(desc, io_ch, NULL, 0, 16, io_done, NULL);
+	CU_ASSERT(rc == 0);
+	rc = spdk_bdev_read_blocks(desc, io_ch, NULL, 0, 128, io_done, NULL);
+	CU_ASSERT(rc == 0);
+	rc = spdk_bdev_read_blocks(desc, io_ch, NULL, 0, 256, io_done, NULL);
+	CU_ASSERT(rc == 0);
+	stub_complete_io(3);
+	for (i = 1; i < SPDK_BDEV_NUM_BUF_CLASSES; i++) {
+		CU_ASSERT(mgmt_ch->buf_cache[i].stat.misses == 1);
+		CU_ASSERT(mgmt_ch->buf_cache[i].count == 2);
+	}
+
+	/* Once the pool is exhausted, I/O waits for a buffer to be returned */
+	for (i = 0; i < 9; i++) {
+		rc = spdk_bdev_read_blocks(desc, io_ch, NULL, 0, 1, io_done, NULL);
+		CU_ASSERT(rc == 0);
+	}
+	CU_ASSERT(tiny->stat.waits == 1);
+	CU_ASSERT(!STAILQ_EMPTY(&tiny->need_buf));
+	CU_ASSERT(mgmt_ch->buf_retry_poller != NULL);
+	CU_ASSERT(stub_complete_io(1) == 1);
+	CU_ASSERT(STAILQ_EMPTY(&tiny->need_buf));
+	stub_complete_io(8);
+
+	/* The retry poller unregisters itself when nothing is waiting */
+	spdk_delay_us(BUF_RETRY_PERIOD_USEC);
+	poll_threads();
+	CU_ASSERT(mgmt_ch->buf_retry_poller == NULL);
+
+	g_count = 0;
+	spdk_bdev_get_io_cache_stats(io_cache_stat_cb, io_cache_stats_done, &stat);
+	poll_threads();
+	CU_ASSERT(g_count == 1);
+	CU_ASSERT(stat.buf[0].buf_size == SPDK_BDEV_TINY_BUF_MAX_SIZE);
+	CU_ASSERT(stat.buf[0].waits == 1);
+	CU_ASSERT(stat.buf[3].buf_size == SPDK_BDEV_HUGE_BUF_MAX_SIZE);
+	CU_ASSERT(stat.buf[3].misses == 1);
+
+	spdk_put_io_channel(io_ch);
+	spdk_bdev_close(desc);
+	free_bdev(bdev);
+	spdk_bdev_finish(bdev_fini_cb, NULL);
+	poll_threads();
+
+	fn_table.submit_request = stub_submit_request;
+}
+
 static void
 bdev_io_spans_boundary_test(void)
 {
@@ -2321,9 +2593,12 @@ main(int argc, char **argv)
 		CU_add_test(suite, "io_valid", io_valid_test) == NULL ||
 		CU_add_test(suite, "open_write", open_write_test) == NULL ||
 		CU_add_test(suite, "alias_add_del", alias_add_del_test) == NULL ||
+		CU_add_test(suite, "name_lookup", name_lookup_test) == NULL ||
 		CU_add_test(suite, "get_device_stat", get_device_stat_test) == NULL ||
 		CU_add_test(suite, "bdev_io_types", bdev_io_types_test) == NULL ||
 		CU_add_test(suite, "bdev_io_wait", bdev_io_wait_test) == NULL ||
+		CU_add_test(suite, "bdev_io_cache", bdev_io_cache_test) == NULL ||
+		CU_add_test(suite, "bdev_buf_cache", bdev_buf_cache_test) == NULL ||
 		CU_add_test(suite, "bdev_io_spans_boundary", bdev_io_spans_boundary_test) == NULL ||
 		CU_add_test(suite, "bdev_io_split", bdev_io_split) == NULL ||
 		CU_add_test(suite, "bdev_io_split_with_io_wait", bdev_io_split_with_io_wait) == NULL ||
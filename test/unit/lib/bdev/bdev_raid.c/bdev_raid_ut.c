@@ -35,8 +35,11 @@
 #include "spdk_cunit.h"
 #include "spdk/env.h"
 #include "spdk_internal/mock.h"
+#include "common/lib/test_env.c"
 #include "bdev/raid/bdev_raid.c"
 #include "bdev/raid/bdev_raid_rpc.c"
+#include "bdev/raid/raid1.c"
+#include "bdev/raid/raid5.c"
 
 #define MAX_BASE_DRIVES 32
 #define MAX_RAIDS 2
@@ -48,6 +51,12 @@ struct spdk_bdev_channel {
 	struct spdk_io_channel *channel;
 };
 
+struct spdk_io_channel_iter {
+	void *ctx;
+	struct spdk_io_channel *ch;
+	spdk_channel_for_each_cpl cpl;
+};
+
 /* Data structure to capture the output of IO for verification */
 struct io_output {
 	struct spdk_bdev_desc       *desc;
@@ -70,6 +79,8 @@ struct io_output *g_io_output = NULL;
 uint32_t g_io_output_index;
 uint32_t g_io_comp_status;
 bool g_child_io_status_flag;
+/* Base bdev whose writes, unmaps and resets fail regardless of g_child_io_status_flag */
+struct spdk_bdev_desc *g_child_io_fail_desc;
 void *g_rpc_req;
 uint32_t g_rpc_req_size;
 TAILQ_HEAD(bdev, spdk_bdev);
@@ -92,6 +103,16 @@ uint8_t g_test_multi_raids;
 struct raid_io_ranges g_io_ranges[MAX_TEST_IO_RANGE];
 uint32_t g_io_range_idx;
 uint64_t g_lba_offset;
+struct spdk_io_channel *g_raid_io_channel;
+/* Size of the contents kept for base bdevs that have them, see backing_store_io() */
+uint64_t g_store_blocks;
+/* Last blocks written to the base bdevs, where raid1 keeps its superblock */
+struct last_block {
+	struct spdk_bdev		*bdev;
+	uint8_t				*buf;
+	TAILQ_ENTRY(last_block)		link;
+};
+TAILQ_HEAD(, last_block) g_last_blocks = TAILQ_HEAD_INITIALIZER(g_last_blocks);
 
 DEFINE_STUB_V(spdk_io_device_register, (void *io_device, spdk_io_channel_create_cb create_cb,
 					spdk_io_channel_destroy_cb destroy_cb, uint32_t ctx_size,
@@ -99,6 +120,7 @@ DEFINE_STUB_V(spdk_io_device_register, (void *io_device, spdk_io_channel_create_
 DEFINE_STUB_V(spdk_io_device_unregister, (void *io_device,
 		spdk_io_device_unregister_cb unregister_cb));
 DEFINE_STUB(spdk_get_io_channel, struct spdk_io_channel *, (void *io_device), NULL);
+DEFINE_STUB(spdk_get_thread, struct spdk_thread *, (void), NULL);
 DEFINE_STUB_V(spdk_bdev_module_examine_done, (struct spdk_bdev_module *module));
 DEFINE_STUB_V(spdk_bdev_module_list_add, (struct spdk_bdev_module *bdev_module));
 DEFINE_STUB(spdk_bdev_register, int, (struct spdk_bdev *bdev), 0);
@@ -138,6 +160,8 @@ DEFINE_STUB(spdk_json_write_null, int, (struct spdk_json_write_ctx *w), 0);
 DEFINE_STUB(spdk_strerror, const char *, (int errnum), NULL);
 DEFINE_STUB(spdk_bdev_queue_io_wait, int, (struct spdk_bdev *bdev, struct spdk_io_channel *ch,
 		struct spdk_bdev_io_wait_entry *entry), 0);
+DEFINE_STUB(spdk_json_write_named_bool, int, (struct spdk_json_write_ctx *w, const char *name,
+		bool val), 0);
 
 static void
 set_test_opts(void)
@@ -182,6 +206,7 @@ set_globals(void)
 	g_rpc_err = 0;
 	g_test_multi_raids = 0;
 	g_child_io_status_flag = true;
+	g_child_io_fail_desc = NULL;
 	TAILQ_INIT(&g_bdev_list);
 	TAILQ_INIT(&g_io_waitq);
 	g_rpc_req = NULL;
@@ -189,6 +214,34 @@ set_globals(void)
 	g_json_decode_obj_err = 0;
 	g_json_decode_obj_create = 0;
 	g_lba_offset = 0;
+	g_raid_io_channel = NULL;
+	g_store_blocks = 0;
+}
+
+static struct last_block *
+find_last_block(struct spdk_bdev *bdev)
+{
+	struct last_block *last;
+
+	TAILQ_FOREACH(last, &g_last_blocks, link) {
+		if (last->bdev == bdev) {
+			break;
+		}
+	}
+
+	return last;
+}
+
+static void
+free_last_block(struct spdk_bdev *bdev)
+{
+	struct last_block *last = find_last_block(bdev);
+
+	if (last != NULL) {
+		TAILQ_REMOVE(&g_last_blocks, last, link);
+		free(last->buf);
+		free(last);
+	}
 }
 
 static void
@@ -199,6 +252,7 @@ base_bdevs_cleanup(void)
 
 	if (!TAILQ_EMPTY(&g_bdev_list)) {
 		TAILQ_FOREACH_SAFE(bdev, &g_bdev_list, internal.link, bdev_next) {
+			free_last_block(bdev);
 			free(bdev->name);
 			TAILQ_REMOVE(&g_bdev_list, bdev, internal.link);
 			free(bdev);
@@ -269,6 +323,62 @@ set_io_output(struct io_output *output,
 	output->iotype = iotype;
 }
 
+/*
+ * Base bdevs whose ctxt points to a buffer of g_store_blocks blocks keep the data
+ * written to them, so that tests can check the contents of the base bdevs. All
+ * base bdevs keep their last block.
+ */
+static void
+backing_store_io(struct spdk_bdev_desc *desc, void *buf, uint64_t offset_blocks,
+		 uint64_t num_blocks, bool write)
+{
+	struct spdk_bdev *bdev = (struct spdk_bdev *)desc;
+	struct last_block *last;
+	uint8_t *store = bdev->ctxt;
+
+	if (offset_blocks == bdev->blockcnt - 1 && num_blocks == 1) {
+		last = find_last_block(bdev);
+		if (write && last == NULL) {
+			last = calloc(1, sizeof(*last));
+			SPDK_CU_ASSERT_FATAL(last != NULL);
+			last->bdev = bdev;
+			last->buf = calloc(1, g_block_len);
+			SPDK_CU_ASSERT_FATAL(last->buf != NULL);
+			TAILQ_INSERT_TAIL(&g_last_blocks, last, link);
+		}
+		if (write) {
+			memcpy(last->buf, buf, g_block_len);
+		} else if (last != NULL) {
+			memcpy(buf, last->buf, g_block_len);
+		}
+		return;
+	}
+
+	if (store == NULL) {
+		return;
+	}
+
+	SPDK_CU_ASSERT_FATAL(offset_blocks + num_blocks <= g_store_blocks);
+	store += offset_blocks * g_block_len;
+	if (write) {
+		memcpy(store, buf, num_blocks * g_block_len);
+	} else {
+		memcpy(buf, store, num_blocks * g_block_len);
+	}
+}
+
+static void
+backing_store_iov(struct spdk_bdev_desc *desc, struct iovec *iov, int iovcnt,
+		  uint64_t offset_blocks, bool write)
+{
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		backing_store_io(desc, iov[i].iov_base, offset_blocks, iov[i].iov_len / g_block_len, write);
+		offset_blocks += iov[i].iov_len / g_block_len;
+	}
+}
+
 /* It will cache the split IOs for verification */
 int
 spdk_bdev_writev_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
@@ -292,10 +402,12 @@ spdk_bdev_writev_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
 		set_io_output(output, desc, ch, offset_blocks, num_blocks, cb, cb_arg,
 			      SPDK_BDEV_IO_TYPE_WRITE);
 		g_io_output_index++;
+		backing_store_iov(desc, iov, iovcnt, offset_blocks, true);
 
 		child_io = calloc(1, sizeof(struct spdk_bdev_io));
 		SPDK_CU_ASSERT_FATAL(child_io != NULL);
-		cb(child_io, g_child_io_status_flag, cb_arg);
+		child_io->bdev = (struct spdk_bdev *)desc;
+		cb(child_io, g_child_io_status_flag && desc != g_child_io_fail_desc, cb_arg);
 	}
 
 	return g_bdev_io_submit_status;
@@ -318,7 +430,8 @@ spdk_bdev_reset(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
 
 		child_io = calloc(1, sizeof(struct spdk_bdev_io));
 		SPDK_CU_ASSERT_FATAL(child_io != NULL);
-		cb(child_io, g_child_io_status_flag, cb_arg);
+		child_io->bdev = (struct spdk_bdev *)desc;
+		cb(child_io, g_child_io_status_flag && desc != g_child_io_fail_desc, cb_arg);
 	}
 
 	return g_bdev_io_submit_status;
@@ -343,7 +456,8 @@ spdk_bdev_unmap_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
 
 		child_io = calloc(1, sizeof(struct spdk_bdev_io));
 		SPDK_CU_ASSERT_FATAL(child_io != NULL);
-		cb(child_io, g_child_io_status_flag, cb_arg);
+		child_io->bdev = (struct spdk_bdev *)desc;
+		cb(child_io, g_child_io_status_flag && desc != g_child_io_fail_desc, cb_arg);
 	}
 
 	return g_bdev_io_submit_status;
@@ -363,14 +477,68 @@ int
 spdk_bdev_open(struct spdk_bdev *bdev, bool write, spdk_bdev_remove_cb_t remove_cb,
 	       void *remove_ctx, struct spdk_bdev_desc **_desc)
 {
-	*_desc = (void *)0x1;
+	/* Tests tell the base bdevs apart by their descriptor */
+	*_desc = (void *)bdev;
 	return 0;
 }
 
 void
 spdk_put_io_channel(struct spdk_io_channel *ch)
 {
-	CU_ASSERT(ch == (void *)1);
+	CU_ASSERT(ch == (void *)1 || ch == g_raid_io_channel);
+}
+
+struct spdk_poller *
+spdk_poller_register_named(spdk_poller_fn fn, void *arg, uint64_t period_microseconds,
+			   const char *name)
+{
+	return calloc(1, 1);
+}
+
+void
+spdk_poller_unregister(struct spdk_poller **ppoller)
+{
+	free(*ppoller);
+	*ppoller = NULL;
+}
+
+/* Iterates over the single raid bdev channel a test set in g_raid_io_channel */
+void
+spdk_for_each_channel(void *io_device, spdk_channel_msg fn, void *ctx,
+		      spdk_channel_for_each_cpl cpl)
+{
+	struct spdk_io_channel_iter *i;
+
+	i = calloc(1, sizeof(*i));
+	SPDK_CU_ASSERT_FATAL(i != NULL);
+	i->ctx = ctx;
+	i->ch = g_raid_io_channel;
+	i->cpl = cpl;
+
+	if (i->ch != NULL) {
+		fn(i);
+	} else {
+		spdk_for_each_channel_continue(i, 0);
+	}
+}
+
+void
+spdk_for_each_channel_continue(struct spdk_io_channel_iter *i, int status)
+{
+	i->cpl(i, status);
+	free(i);
+}
+
+void *
+spdk_io_channel_iter_get_ctx(struct spdk_io_channel_iter *i)
+{
+	return i->ctx;
+}
+
+struct spdk_io_channel *
+spdk_io_channel_iter_get_channel(struct spdk_io_channel_iter *i)
+{
+	return i->ch;
 }
 
 char *
@@ -440,6 +608,7 @@ spdk_bdev_readv_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
 		set_io_output(output, desc, ch, offset_blocks, num_blocks, cb, cb_arg,
 			      SPDK_BDEV_IO_TYPE_READ);
 		g_io_output_index++;
+		backing_store_iov(desc, iov, iovcnt, offset_blocks, false);
 
 		child_io = calloc(1, sizeof(struct spdk_bdev_io));
 		SPDK_CU_ASSERT_FATAL(child_io != NULL);
@@ -449,6 +618,49 @@ spdk_bdev_readv_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
 	return g_bdev_io_submit_status;
 }
 
+int
+spdk_bdev_read_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+		      void *buf, uint64_t offset_blocks, uint64_t num_blocks,
+		      spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct io_output *output = &g_io_output[g_io_output_index];
+	struct spdk_bdev_io *child_io;
+
+	set_io_output(output, desc, ch, offset_blocks, num_blocks, cb, cb_arg,
+		      SPDK_BDEV_IO_TYPE_READ);
+	g_io_output_index++;
+	backing_store_io(desc, buf, offset_blocks, num_blocks, false);
+
+	child_io = calloc(1, sizeof(struct spdk_bdev_io));
+	SPDK_CU_ASSERT_FATAL(child_io != NULL);
+	child_io->bdev = (struct spdk_bdev *)desc;
+	child_io->u.bdev.num_blocks = num_blocks;
+	cb(child_io, g_child_io_status_flag && desc != g_child_io_fail_desc, cb_arg);
+
+	return 0;
+}
+
+int
+spdk_bdev_write_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+		       void *buf, uint64_t offset_blocks, uint64_t num_blocks,
+		       spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct io_output *output = &g_io_output[g_io_output_index];
+	struct spdk_bdev_io *child_io;
+
+	set_io_output(output, desc, ch, offset_blocks, num_blocks, cb, cb_arg,
+		      SPDK_BDEV_IO_TYPE_WRITE);
+	g_io_output_index++;
+	backing_store_io(desc, buf, offset_blocks, num_blocks, true);
+
+	child_io = calloc(1, sizeof(struct spdk_bdev_io));
+	SPDK_CU_ASSERT_FATAL(child_io != NULL);
+	child_io->bdev = (struct spdk_bdev *)desc;
+	cb(child_io, g_child_io_status_flag && desc != g_child_io_fail_desc, cb_arg);
+
+	return 0;
+}
+
 void
 spdk_bdev_module_release_bdev(struct spdk_bdev *bdev)
 {
@@ -967,7 +1179,7 @@ verify_raid_bdev(struct rpc_bdev_raid_create *r, bool presence, uint32_t raid_st
 			CU_ASSERT(pbdev->bdev.blocklen == g_block_len);
 			if (pbdev->num_base_bdevs > 1) {
 				CU_ASSERT(pbdev->bdev.optimal_io_boundary == pbdev->strip_size);
-				CU_ASSERT(pbdev->bdev.split_on_optimal_io_boundary == true);
+				CU_ASSERT(pbdev->bdev.split_on_optimal_io_boundary == false);
 			} else {
 				CU_ASSERT(pbdev->bdev.optimal_io_boundary == 0);
 				CU_ASSERT(pbdev->bdev.split_on_optimal_io_boundary == false);
@@ -1217,7 +1429,7 @@ test_create_raid_invalid_args(void)
 	verify_raid_config_present("raid1", false);
 	verify_raid_bdev_present("raid1", false);
 	create_raid_bdev_create_req(&req, "raid1", 0, true, 0);
-	req.raid_level = 1;
+	req.raid_level = 2;
 	spdk_rpc_bdev_raid_create(NULL, NULL);
 	CU_ASSERT(g_rpc_err == 1);
 	free_test_req(&req);
@@ -2119,14 +2331,14 @@ test_create_raid_from_config_invalid_params(void)
 	verify_raid_bdev_present("raid1", false);
 
 	create_raid_bdev_create_config(&req, "raid1", 0, false);
-	req.raid_level = 1;
+	req.raid_level = 2;
 	CU_ASSERT(raid_bdev_init() != 0);
 	free_test_req(&req);
 	verify_raid_config_present("raid1", false);
 	verify_raid_bdev_present("raid1", false);
 
 	create_raid_bdev_create_config(&req, "raid1", 0, false);
-	req.raid_level = 1;
+	req.raid_level = 2;
 	CU_ASSERT(raid_bdev_init() != 0);
 	free_test_req(&req);
 	verify_raid_config_present("raid1", false);
@@ -2201,6 +2413,1187 @@ test_raid_json_dump_info(void)
 	reset_globals();
 }
 
+static struct raid_bdev *
+create_raid1(struct rpc_bdev_raid_create *req, uint8_t num_base_bdevs)
+{
+	struct raid_bdev *pbdev;
+
+	g_max_base_drives = num_base_bdevs;
+	create_raid_bdev_create_req(req, "raid1", 0, true, 0);
+	req->raid_level = RAID1;
+	spdk_rpc_bdev_raid_create(NULL, NULL);
+	CU_ASSERT(g_rpc_err == 0);
+	verify_raid_config(req, true);
+
+	TAILQ_FOREACH(pbdev, &g_raid_bdev_list, global_link) {
+		if (strcmp(pbdev->bdev.name, "raid1") == 0) {
+			break;
+		}
+	}
+	SPDK_CU_ASSERT_FATAL(pbdev != NULL);
+	CU_ASSERT(pbdev->state == RAID_BDEV_STATE_ONLINE);
+	CU_ASSERT(pbdev->fn_table == &g_raid1_fn_table);
+	CU_ASSERT(pbdev->level_ctx != NULL);
+
+	return pbdev;
+}
+
+static void
+destroy_raid1(struct rpc_bdev_raid_create *req)
+{
+	struct rpc_bdev_raid_delete destroy_req;
+
+	free_test_req(req);
+	create_raid_bdev_delete_req(&destroy_req, "raid1", 0);
+	spdk_rpc_bdev_raid_delete(NULL, NULL);
+	CU_ASSERT(g_rpc_err == 0);
+	verify_raid_config_present("raid1", false);
+	verify_raid_bdev_present("raid1", false);
+
+	raid_bdev_exit();
+	base_bdevs_cleanup();
+	reset_globals();
+	g_max_base_drives = MAX_BASE_DRIVES;
+}
+
+static void
+test_raid1_create(void)
+{
+	struct rpc_bdev_raid_create req;
+	struct raid_bdev *pbdev;
+	struct spdk_bdev *bdev;
+
+	set_globals();
+	CU_ASSERT(raid_bdev_init() == 0);
+
+	/* A mirror needs at least two base bdevs */
+	g_max_base_drives = 1;
+	create_raid_bdev_create_req(&req, "raid1", 0, true, 0);
+	req.raid_level = RAID1;
+	spdk_rpc_bdev_raid_create(NULL, NULL);
+	CU_ASSERT(g_rpc_err == 1);
+	free_test_req(&req);
+	verify_raid_config_present("raid1", false);
+	verify_raid_bdev_present("raid1", false);
+	base_bdevs_cleanup();
+
+	/* The mirror is as large as its smallest base bdev and I/O is not split */
+	g_max_base_drives = 3;
+	create_base_bdevs(0);
+	bdev = TAILQ_LAST(&g_bdev_list, bdev);
+	bdev->blockcnt = BLOCK_CNT - 100;
+	pbdev = create_raid1(&req, 3);
+	CU_ASSERT(pbdev->bdev.blockcnt == BLOCK_CNT - 101);
+	CU_ASSERT(pbdev->bdev.optimal_io_boundary == 0);
+	CU_ASSERT(pbdev->bdev.split_on_optimal_io_boundary == false);
+
+	destroy_raid1(&req);
+}
+
+static void
+test_raid1_io(void)
+{
+	struct rpc_bdev_raid_create req;
+	struct raid_bdev *pbdev;
+	struct spdk_io_channel *ch;
+	struct raid_bdev_io_channel *ch_ctx;
+	struct spdk_io_channel *ch_b;
+	struct spdk_bdev_channel *ch_b_ctx;
+	struct spdk_bdev_io *bdev_io;
+	uint8_t i;
+
+	set_globals();
+	CU_ASSERT(raid_bdev_init() == 0);
+	pbdev = create_raid1(&req, 3);
+
+	ch = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct raid_bdev_io_channel));
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	ch_b = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct spdk_bdev_channel));
+	SPDK_CU_ASSERT_FATAL(ch_b != NULL);
+	ch_b_ctx = spdk_io_channel_get_ctx(ch_b);
+	ch_b_ctx->channel = ch;
+	ch_ctx = spdk_io_channel_get_ctx(ch);
+	CU_ASSERT(raid_bdev_create_cb(pbdev, ch_ctx) == 0);
+
+	/* Writes go to every base bdev, unsplit */
+	bdev_io = calloc(1, sizeof(struct spdk_bdev_io) + sizeof(struct raid_bdev_io));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+	bdev_io_initialize(bdev_io, ch_b, &pbdev->bdev, 10, g_strip_size * 2, SPDK_BDEV_IO_TYPE_WRITE);
+	g_io_output_index = 0;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 3);
+	for (i = 0; i < 3; i++) {
+		CU_ASSERT(g_io_output[i].desc == pbdev->base_bdev_info[i].desc);
+		CU_ASSERT(g_io_output[i].offset_blocks == 10);
+		CU_ASSERT(g_io_output[i].num_blocks == g_strip_size * 2);
+	}
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(ch_ctx->writes_in_epoch[0] == 0 && ch_ctx->writes_in_epoch[1] == 0);
+	bdev_io_cleanup(bdev_io);
+
+	/* Reads go to one base bdev, the one with the fewest reads outstanding */
+	bdev_io = calloc(1, sizeof(struct spdk_bdev_io) + sizeof(struct raid_bdev_io));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+	bdev_io_initialize(bdev_io, ch_b, &pbdev->bdev, 0, 8, SPDK_BDEV_IO_TYPE_READ);
+	g_io_output_index = 0;
+	ch_ctx->base_outstanding[0] = 2;
+	ch_ctx->base_outstanding[1] = 1;
+	ch_ctx->base_outstanding[2] = 3;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 1);
+	CU_ASSERT(g_io_output[0].ch == ch_ctx->base_channel[1]);
+	CU_ASSERT(g_io_output[0].desc == pbdev->base_bdev_info[1].desc);
+	CU_ASSERT(ch_ctx->base_outstanding[1] == 1);
+	CU_ASSERT(g_io_comp_status == true);
+
+	/* A failed read is retried on another base bdev, up to once per base bdev */
+	memset(ch_ctx->base_outstanding, 0, 3 * sizeof(uint32_t));
+	g_child_io_status_flag = false;
+	g_io_output_index = 0;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(g_io_comp_status == false);
+	g_child_io_status_flag = true;
+	bdev_io_cleanup(bdev_io);
+
+	/* Unmap and flush fan out like writes */
+	bdev_io = calloc(1, sizeof(struct spdk_bdev_io) + sizeof(struct raid_bdev_io));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+	bdev_io_initialize(bdev_io, ch_b, &pbdev->bdev, 0, g_strip_size * 4, SPDK_BDEV_IO_TYPE_UNMAP);
+	g_io_output_index = 0;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(g_io_output[2].iotype == SPDK_BDEV_IO_TYPE_UNMAP);
+	CU_ASSERT(g_io_output[2].num_blocks == g_strip_size * 4);
+	CU_ASSERT(g_io_comp_status == true);
+	bdev_io_cleanup(bdev_io);
+
+	raid_bdev_destroy_cb(pbdev, ch_ctx);
+	CU_ASSERT(ch_ctx->base_channel == NULL);
+	CU_ASSERT(ch_ctx->base_outstanding == NULL);
+	free(ch);
+	free(ch_b);
+	destroy_raid1(&req);
+}
+
+static void
+test_raid1_degraded_resync(void)
+{
+	struct rpc_bdev_raid_create req;
+	struct raid_bdev *pbdev;
+	struct raid1_info *raid1;
+	struct spdk_io_channel *ch;
+	struct raid_bdev_io_channel *ch_ctx;
+	struct spdk_io_channel *ch_b;
+	struct spdk_bdev_channel *ch_b_ctx;
+	struct spdk_bdev_io *bdev_io;
+	struct spdk_bdev *removed;
+	int polls;
+
+	set_globals();
+	CU_ASSERT(raid_bdev_init() == 0);
+	pbdev = create_raid1(&req, 3);
+	raid1 = pbdev->level_ctx;
+
+	ch = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct raid_bdev_io_channel));
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	ch_b = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct spdk_bdev_channel));
+	SPDK_CU_ASSERT_FATAL(ch_b != NULL);
+	ch_b_ctx = spdk_io_channel_get_ctx(ch_b);
+	ch_b_ctx->channel = ch;
+	ch_ctx = spdk_io_channel_get_ctx(ch);
+	CU_ASSERT(raid_bdev_create_cb(pbdev, ch_ctx) == 0);
+	g_raid_io_channel = ch;
+
+	/* Hot removing a base bdev leaves the raid bdev online but degraded */
+	removed = pbdev->base_bdev_info[2].bdev;
+	raid_bdev_remove_base_bdev(removed);
+	CU_ASSERT(pbdev->state == RAID_BDEV_STATE_ONLINE);
+	CU_ASSERT(pbdev->num_base_bdevs_discovered == 2);
+	CU_ASSERT(pbdev->base_bdev_info[2].bdev == NULL);
+	CU_ASSERT(pbdev->base_bdev_info[2].remove_scheduled == false);
+	CU_ASSERT(pbdev->base_bdev_info[2].resyncing == true);
+	CU_ASSERT(ch_ctx->base_channel[2] == NULL);
+	CU_ASSERT(raid_bdev_io_type_supported(pbdev, SPDK_BDEV_IO_TYPE_UNMAP) == true);
+
+	/* Writes skip the missing base bdev and set its regions dirty */
+	bdev_io = calloc(1, sizeof(struct spdk_bdev_io) + sizeof(struct raid_bdev_io));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+	bdev_io_initialize(bdev_io, ch_b, &pbdev->bdev, g_strip_size * 3 + 1, g_strip_size,
+			   SPDK_BDEV_IO_TYPE_WRITE);
+	g_io_output_index = 0;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 2);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(raid1->dirty_maps[2][0] == ((1ULL << 3) | (1ULL << 4)));
+	CU_ASSERT(raid1->dirty_maps[0][0] == 0);
+	bdev_io_cleanup(bdev_io);
+
+	/* The base bdev comes back and only the dirty regions are copied to it */
+	MOCK_SET(spdk_get_io_channel, ch);
+	raid_bdev_examine(removed);
+	CU_ASSERT(pbdev->num_base_bdevs_discovered == 3);
+	CU_ASSERT(pbdev->base_bdev_info[2].bdev == removed);
+	CU_ASSERT(ch_ctx->base_channel[2] == (void *)1);
+	SPDK_CU_ASSERT_FATAL(raid1->resync_poller != NULL);
+
+	g_io_output_index = 0;
+	for (polls = 0; raid1->resync_poller != NULL && polls < 100; polls++) {
+		raid1_resync_poll(raid1);
+	}
+	CU_ASSERT(raid1->resync_poller == NULL);
+	CU_ASSERT(pbdev->base_bdev_info[2].resyncing == false);
+	CU_ASSERT(raid1->dirty_maps[2][0] == 0);
+	CU_ASSERT(g_io_output_index == 7);
+	CU_ASSERT(g_io_output[0].iotype == SPDK_BDEV_IO_TYPE_READ);
+	CU_ASSERT(g_io_output[0].offset_blocks == g_strip_size * 3);
+	CU_ASSERT(g_io_output[1].iotype == SPDK_BDEV_IO_TYPE_WRITE);
+	CU_ASSERT(g_io_output[1].ch == ch_ctx->base_channel[2]);
+	CU_ASSERT(g_io_output[1].offset_blocks == g_strip_size * 3);
+	CU_ASSERT(g_io_output[1].num_blocks == g_strip_size);
+	CU_ASSERT(g_io_output[3].offset_blocks == g_strip_size * 4);
+	/* Once in sync, its superblock is written along with the others */
+	CU_ASSERT(g_io_output[6].iotype == SPDK_BDEV_IO_TYPE_WRITE);
+	CU_ASSERT(g_io_output[6].offset_blocks == BLOCK_CNT - 1);
+	CU_ASSERT(raid1->sb_slots == 0x7);
+	CU_ASSERT(raid1->left_slots == 0);
+
+	/*
+	 * With base bdev 0 the only one in sync, a write that fails on it fails even
+	 * though the resyncing base bdevs completed it.
+	 */
+	pbdev->base_bdev_info[1].resyncing = true;
+	pbdev->base_bdev_info[2].resyncing = true;
+	raid1_sb_update(raid1);
+	CU_ASSERT(raid1->sb_slots == 0x1);
+	bdev_io = calloc(1, sizeof(struct spdk_bdev_io) + sizeof(struct raid_bdev_io));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+	bdev_io_initialize(bdev_io, ch_b, &pbdev->bdev, 0, 8, SPDK_BDEV_IO_TYPE_WRITE);
+	g_child_io_fail_desc = pbdev->base_bdev_info[0].desc;
+	g_io_output_index = 0;
+	g_io_comp_status = true;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(g_io_comp_status == false);
+	CU_ASSERT(pbdev->base_bdev_info[0].resyncing == false);
+	CU_ASSERT(raid1->dirty_maps[1][0] == 1);
+	CU_ASSERT(raid1->dirty_maps[2][0] == 1);
+
+	/* A write that fails on a resyncing base bdev still succeeds */
+	g_child_io_fail_desc = pbdev->base_bdev_info[1].desc;
+	g_io_output_index = 0;
+	g_io_comp_status = false;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(g_io_comp_status == true);
+
+	/*
+	 * So does one that fails on one of two in-sync base bdevs, which is then resynced
+	 * after the superblock of the other one was written
+	 */
+	pbdev->base_bdev_info[1].resyncing = false;
+	g_child_io_fail_desc = NULL;
+	raid1_sb_update(raid1);
+	CU_ASSERT(raid1->sb_slots == 0x3);
+	g_child_io_fail_desc = pbdev->base_bdev_info[1].desc;
+	g_io_output_index = 0;
+	g_io_comp_status = false;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 4);
+	CU_ASSERT(g_io_output[2].offset_blocks == BLOCK_CNT - 1);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(pbdev->base_bdev_info[1].resyncing == true);
+	CU_ASSERT(raid1->sb_slots == 0x1);
+	CU_ASSERT(raid1->left_slots == 0x6);
+	g_child_io_fail_desc = NULL;
+	bdev_io_cleanup(bdev_io);
+	pbdev->base_bdev_info[1].resyncing = false;
+	pbdev->base_bdev_info[2].resyncing = false;
+	raid1->dirty_maps[1][0] = 0;
+	raid1->dirty_maps[2][0] = 0;
+	MOCK_CLEAR(spdk_get_io_channel);
+
+	/* Losing the last in-sync base bdev takes the raid bdev offline */
+	raid_bdev_remove_base_bdev(pbdev->base_bdev_info[0].bdev);
+	CU_ASSERT(pbdev->state == RAID_BDEV_STATE_ONLINE);
+	raid_bdev_remove_base_bdev(pbdev->base_bdev_info[1].bdev);
+	CU_ASSERT(pbdev->state == RAID_BDEV_STATE_ONLINE);
+	CU_ASSERT(pbdev->num_base_bdevs_discovered == 1);
+	raid_bdev_destroy_cb(pbdev, ch_ctx);
+	g_raid_io_channel = NULL;
+	raid_bdev_remove_base_bdev(pbdev->base_bdev_info[2].bdev);
+	verify_raid_bdev_present("raid1", false);
+
+	free(ch);
+	free(ch_b);
+	destroy_raid1(&req);
+}
+
+/* Rewrites the raid1 superblock of a base bdev, foreign flips its UUID or flips it back */
+static void
+forge_raid1_sb(struct spdk_bdev *bdev, uint64_t events, bool foreign)
+{
+	struct last_block *last = find_last_block(bdev);
+	struct raid1_sb *sb;
+
+	SPDK_CU_ASSERT_FATAL(last != NULL);
+	sb = (struct raid1_sb *)last->buf;
+	sb->events = events;
+	if (foreign) {
+		sb->uuid.u.raw[0] ^= 0xff;
+	}
+	sb->crc = 0;
+	sb->crc = spdk_crc32c_update(sb, sizeof(*sb), ~0);
+}
+
+static void
+resync_raid1(struct raid1_info *raid1)
+{
+	int polls;
+
+	raid1_resync_start(raid1);
+	for (polls = 0; raid1->resync_poller != NULL && polls < 100; polls++) {
+		raid1_resync_poll(raid1);
+	}
+	CU_ASSERT(raid1->resync_poller == NULL);
+}
+
+static void
+test_raid1_superblock(void)
+{
+	struct rpc_bdev_raid_create req;
+	struct rpc_bdev_raid_delete destroy_req;
+	struct raid_bdev *pbdev;
+	struct raid1_info *raid1;
+	struct spdk_io_channel *ch;
+	struct raid_bdev_io_channel *ch_ctx;
+	struct raid1_channel *r1ch;
+	struct spdk_io_channel *ch_b;
+	struct spdk_bdev_channel *ch_b_ctx;
+	struct spdk_bdev_io *bdev_io;
+	struct spdk_bdev *bdev, *removed;
+	struct last_block *last;
+	struct raid1_sb *sb;
+	uint64_t events;
+	uint8_t i;
+
+	set_globals();
+	CU_ASSERT(raid_bdev_init() == 0);
+	g_max_base_drives = 3;
+	create_base_bdevs(0);
+	TAILQ_FOREACH(bdev, &g_bdev_list, internal.link) {
+		bdev->blockcnt = g_strip_size * 4 + 1;
+	}
+	pbdev = create_raid1(&req, 3);
+	raid1 = pbdev->level_ctx;
+
+	/* A new raid bdev writes the same UUID to the last block of every base bdev */
+	CU_ASSERT(pbdev->bdev.blockcnt == g_strip_size * 4);
+	CU_ASSERT(raid1->loading == false);
+	CU_ASSERT(raid1->events == 1);
+	CU_ASSERT(raid1->sb_slots == 0x7);
+	for (i = 0; i < 3; i++) {
+		last = find_last_block(pbdev->base_bdev_info[i].bdev);
+		SPDK_CU_ASSERT_FATAL(last != NULL);
+		sb = (struct raid1_sb *)last->buf;
+		CU_ASSERT(raid1_sb_valid(sb));
+		CU_ASSERT(spdk_uuid_compare(&sb->uuid, &raid1->uuid) == 0);
+		CU_ASSERT(sb->events == 1);
+	}
+
+	ch = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct raid_bdev_io_channel));
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	ch_b = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct spdk_bdev_channel));
+	SPDK_CU_ASSERT_FATAL(ch_b != NULL);
+	ch_b_ctx = spdk_io_channel_get_ctx(ch_b);
+	ch_b_ctx->channel = ch;
+	ch_ctx = spdk_io_channel_get_ctx(ch);
+	CU_ASSERT(raid_bdev_create_cb(pbdev, ch_ctx) == 0);
+	r1ch = ch_ctx->level_ctx;
+	g_raid_io_channel = ch;
+	MOCK_SET(spdk_get_io_channel, ch);
+
+	/* I/O submitted while the superblocks are read waits for them */
+	bdev_io = calloc(1, sizeof(struct spdk_bdev_io) + sizeof(struct raid_bdev_io));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+	bdev_io_initialize(bdev_io, ch_b, &pbdev->bdev, 0, 8, SPDK_BDEV_IO_TYPE_WRITE);
+	raid1->loading = true;
+	raid1->sb_writing = true;
+	raid1->sb_round_slots = raid1->sb_slots;
+	g_io_output_index = 0;
+	g_io_comp_status = false;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 0);
+	CU_ASSERT(TAILQ_FIRST(&r1ch->waiting_ios) == bdev_io);
+	raid1->sb_writes = 1;
+	raid1_sb_write_put(raid1);
+	CU_ASSERT(raid1->loading == false);
+	CU_ASSERT(TAILQ_EMPTY(&r1ch->waiting_ios));
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(g_io_comp_status == true);
+
+	/*
+	 * A write that a base bdev failed is held until the superblocks of the others
+	 * no longer list it in sync
+	 */
+	raid1->sb_writing = true;
+	g_child_io_fail_desc = pbdev->base_bdev_info[1].desc;
+	g_io_comp_status = false;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(TAILQ_FIRST(&r1ch->held_ios) == bdev_io);
+	CU_ASSERT(g_io_comp_status == false);
+	CU_ASSERT(raid1->sb_again == true);
+	g_child_io_fail_desc = NULL;
+	events = raid1->events;
+	raid1->sb_writes = 1;
+	raid1_sb_write_put(raid1);
+	CU_ASSERT(TAILQ_EMPTY(&r1ch->held_ios));
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(raid1->events == events + 1);
+	CU_ASSERT(raid1->sb_slots == 0x5);
+	CU_ASSERT(raid1->left_slots == 0x2);
+	CU_ASSERT(raid1->left_events[1] == events);
+	bdev_io_cleanup(bdev_io);
+
+	/* Once resynced, it is listed again */
+	resync_raid1(raid1);
+	CU_ASSERT(pbdev->base_bdev_info[1].resyncing == false);
+	CU_ASSERT(raid1->sb_slots == 0x7);
+	CU_ASSERT(raid1->left_slots == 0);
+	sb = (struct raid1_sb *)find_last_block(pbdev->base_bdev_info[1].bdev)->buf;
+	CU_ASSERT(sb->events == raid1->events);
+
+	/* A base bdev with the superblock of another raid bdev is not taken back */
+	removed = pbdev->base_bdev_info[2].bdev;
+	raid_bdev_remove_base_bdev(removed);
+	CU_ASSERT(raid1->sb_slots == 0x3);
+	CU_ASSERT(raid1->left_slots == 0x4);
+	CU_ASSERT(raid1->left_events[2] == raid1->events - 1);
+	events = raid1->events;
+	forge_raid1_sb(removed, raid1->left_events[2], true);
+	raid_bdev_examine(removed);
+	CU_ASSERT(pbdev->base_bdev_info[2].bdev == NULL);
+	CU_ASSERT(pbdev->num_base_bdevs_discovered == 2);
+	CU_ASSERT(ch_ctx->base_channel[2] == NULL);
+
+	/* One that comes back unchanged is resynced from its dirty map only */
+	forge_raid1_sb(removed, raid1->left_events[2], true);
+	raid_bdev_examine(removed);
+	CU_ASSERT(pbdev->base_bdev_info[2].bdev == removed);
+	CU_ASSERT(pbdev->base_bdev_info[2].resyncing == true);
+	CU_ASSERT(ch_ctx->base_channel[2] == (void *)1);
+	CU_ASSERT(raid1->dirty_maps[2][0] == 0);
+	g_io_output_index = 0;
+	resync_raid1(raid1);
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(raid1->events == events + 1);
+	CU_ASSERT(raid1->sb_slots == 0x7);
+
+	/* One that was written elsewhere in the meantime, or lost its superblock, in full */
+	raid_bdev_remove_base_bdev(removed);
+	forge_raid1_sb(removed, raid1->left_events[2] + 1, false);
+	raid_bdev_examine(removed);
+	CU_ASSERT(raid1->dirty_maps[2][0] == 0xf);
+	resync_raid1(raid1);
+	CU_ASSERT(raid1->dirty_maps[2][0] == 0);
+	raid_bdev_remove_base_bdev(removed);
+	free_last_block(removed);
+	raid_bdev_examine(removed);
+	CU_ASSERT(raid1->dirty_maps[2][0] == 0xf);
+	g_io_output_index = 0;
+	resync_raid1(raid1);
+	CU_ASSERT(g_io_output_index == 4 * 2 + 3);
+	CU_ASSERT(pbdev->base_bdev_info[2].resyncing == false);
+
+	raid_bdev_destroy_cb(pbdev, ch_ctx);
+	g_raid_io_channel = NULL;
+	MOCK_CLEAR(spdk_get_io_channel);
+
+	/* After a restart, a base bdev with an older event counter is resynced in full */
+	events = raid1->events;
+	forge_raid1_sb(pbdev->base_bdev_info[1].bdev, events - 1, false);
+	free_test_req(&req);
+	create_raid_bdev_delete_req(&destroy_req, "raid1", 0);
+	spdk_rpc_bdev_raid_delete(NULL, NULL);
+	CU_ASSERT(g_rpc_err == 0);
+	create_raid_bdev_create_req(&req, "raid1", 0, false, 0);
+	req.raid_level = RAID1;
+	spdk_rpc_bdev_raid_create(NULL, NULL);
+	CU_ASSERT(g_rpc_err == 0);
+	pbdev = TAILQ_FIRST(&g_raid_bdev_list);
+	SPDK_CU_ASSERT_FATAL(pbdev != NULL);
+	raid1 = pbdev->level_ctx;
+	CU_ASSERT(raid1->events == events + 1);
+	CU_ASSERT(raid1->sb_slots == 0x5);
+	CU_ASSERT(pbdev->base_bdev_info[0].resyncing == false);
+	CU_ASSERT(pbdev->base_bdev_info[1].resyncing == true);
+	CU_ASSERT(raid1->dirty_maps[1][0] == 0xf);
+	CU_ASSERT(raid1->dirty_maps[0][0] == 0);
+
+	free(ch);
+	free(ch_b);
+	destroy_raid1(&req);
+}
+
+/* Gives the base bdevs contents of num_blocks blocks */
+static void
+create_base_bdev_stores(uint64_t num_blocks)
+{
+	struct spdk_bdev *bdev;
+
+	g_store_blocks = num_blocks;
+	TAILQ_FOREACH(bdev, &g_bdev_list, internal.link) {
+		bdev->ctxt = calloc(num_blocks, g_block_len);
+		SPDK_CU_ASSERT_FATAL(bdev->ctxt != NULL);
+	}
+}
+
+static void
+free_base_bdev_stores(void)
+{
+	struct spdk_bdev *bdev;
+
+	TAILQ_FOREACH(bdev, &g_bdev_list, internal.link) {
+		free(bdev->ctxt);
+		bdev->ctxt = NULL;
+	}
+}
+
+static struct raid_bdev *
+create_raid5(struct rpc_bdev_raid_create *req, uint8_t num_base_bdevs)
+{
+	struct raid_bdev *pbdev;
+
+	g_max_base_drives = num_base_bdevs;
+	create_raid_bdev_create_req(req, "raid5", 0, true, 0);
+	req->raid_level = RAID5;
+	spdk_rpc_bdev_raid_create(NULL, NULL);
+	CU_ASSERT(g_rpc_err == 0);
+	verify_raid_config(req, true);
+
+	TAILQ_FOREACH(pbdev, &g_raid_bdev_list, global_link) {
+		if (strcmp(pbdev->bdev.name, "raid5") == 0) {
+			break;
+		}
+	}
+	SPDK_CU_ASSERT_FATAL(pbdev != NULL);
+	CU_ASSERT(pbdev->state == RAID_BDEV_STATE_ONLINE);
+	CU_ASSERT(pbdev->fn_table == &g_raid5_fn_table);
+	CU_ASSERT(pbdev->level_ctx != NULL);
+
+	return pbdev;
+}
+
+static void
+destroy_raid5(struct rpc_bdev_raid_create *req)
+{
+	struct rpc_bdev_raid_delete destroy_req;
+
+	free_test_req(req);
+	create_raid_bdev_delete_req(&destroy_req, "raid5", 0);
+	spdk_rpc_bdev_raid_delete(NULL, NULL);
+	CU_ASSERT(g_rpc_err == 0);
+	verify_raid_config_present("raid5", false);
+	verify_raid_bdev_present("raid5", false);
+
+	free_base_bdev_stores();
+	raid_bdev_exit();
+	base_bdevs_cleanup();
+	reset_globals();
+	g_max_base_drives = MAX_BASE_DRIVES;
+}
+
+
+/* Checks that num_blocks blocks of a base bdev, starting at offset_blocks, are filled with val */
+static bool
+raid5_store_filled(struct raid_bdev *raid_bdev, uint8_t slot, uint64_t offset_blocks,
+		   uint64_t num_blocks, uint8_t val)
+{
+	struct spdk_bdev *bdev = (struct spdk_bdev *)raid_bdev->base_bdev_info[slot].desc;
+	uint8_t *store = bdev->ctxt;
+	uint64_t i;
+
+	for (i = offset_blocks * g_block_len; i < (offset_blocks + num_blocks) * g_block_len; i++) {
+		if (store[i] != val) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static struct spdk_bdev_io *
+raid5_submit(struct spdk_io_channel *ch, struct spdk_io_channel *ch_b, struct raid_bdev *raid_bdev,
+	     uint64_t lba, uint64_t blocks, int16_t iotype, uint8_t val)
+{
+	struct spdk_bdev_io *bdev_io;
+
+	bdev_io = calloc(1, sizeof(struct spdk_bdev_io) + sizeof(struct raid_bdev_io));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+	bdev_io_initialize(bdev_io, ch_b, &raid_bdev->bdev, lba, blocks, iotype);
+	if (iotype == SPDK_BDEV_IO_TYPE_WRITE) {
+		memset(bdev_io->u.bdev.iovs->iov_base, val, blocks * g_block_len);
+	}
+	raid_bdev_submit_request(ch, bdev_io);
+
+	return bdev_io;
+}
+
+static bool
+raid5_buf_filled(struct spdk_bdev_io *bdev_io, uint8_t val)
+{
+	uint8_t *buf = bdev_io->u.bdev.iovs->iov_base;
+	size_t i;
+
+	for (i = 0; i < bdev_io->u.bdev.iovs->iov_len; i++) {
+		if (buf[i] != val) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void
+test_raid5_create(void)
+{
+	struct rpc_bdev_raid_create req;
+	struct raid_bdev *pbdev;
+	struct spdk_bdev *bdev;
+
+	set_globals();
+	CU_ASSERT(raid_bdev_init() == 0);
+
+	/* Parity needs at least two data strips */
+	g_max_base_drives = 2;
+	create_raid_bdev_create_req(&req, "raid5", 0, true, 0);
+	req.raid_level = RAID5;
+	spdk_rpc_bdev_raid_create(NULL, NULL);
+	CU_ASSERT(g_rpc_err == 1);
+	free_test_req(&req);
+	verify_raid_config_present("raid5", false);
+	verify_raid_bdev_present("raid5", false);
+	base_bdevs_cleanup();
+
+	/* Every stripe of the smallest base bdev holds num_base_bdevs - 1 strips of data */
+	g_max_base_drives = 4;
+	create_base_bdevs(0);
+	bdev = TAILQ_LAST(&g_bdev_list, bdev);
+	bdev->blockcnt = BLOCK_CNT - 100;
+	pbdev = create_raid5(&req, 4);
+	CU_ASSERT(pbdev->bdev.blockcnt == ((BLOCK_CNT - 100) / g_strip_size) * g_strip_size * 3);
+	CU_ASSERT(pbdev->bdev.optimal_io_boundary == g_strip_size);
+	CU_ASSERT(pbdev->bdev.split_on_optimal_io_boundary == true);
+	CU_ASSERT(raid_bdev_io_type_supported(pbdev, SPDK_BDEV_IO_TYPE_UNMAP) == false);
+	CU_ASSERT(raid_bdev_io_type_supported(pbdev, SPDK_BDEV_IO_TYPE_FLUSH) == true);
+	CU_ASSERT(raid_bdev_io_type_supported(pbdev, SPDK_BDEV_IO_TYPE_RESET) == true);
+
+	destroy_raid5(&req);
+}
+
+static void
+test_raid5_io(void)
+{
+	struct rpc_bdev_raid_create req;
+	struct raid_bdev *pbdev;
+	struct spdk_io_channel *ch;
+	struct raid_bdev_io_channel *ch_ctx;
+	struct spdk_io_channel *ch_b;
+	struct spdk_bdev_channel *ch_b_ctx;
+	struct spdk_bdev_io *bdev_io, *bdev_io2;
+	struct raid5_channel *r5ch;
+	uint64_t stripe_blocks = g_strip_size * 2;
+
+	set_globals();
+	CU_ASSERT(raid_bdev_init() == 0);
+	pbdev = create_raid5(&req, 3);
+	create_base_bdev_stores(g_strip_size * 4);
+
+	ch = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct raid_bdev_io_channel));
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	ch_b = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct spdk_bdev_channel));
+	SPDK_CU_ASSERT_FATAL(ch_b != NULL);
+	ch_b_ctx = spdk_io_channel_get_ctx(ch_b);
+	ch_b_ctx->channel = ch;
+	ch_ctx = spdk_io_channel_get_ctx(ch);
+	CU_ASSERT(raid_bdev_create_cb(pbdev, ch_ctx) == 0);
+	r5ch = ch_ctx->level_ctx;
+	SPDK_CU_ASSERT_FATAL(r5ch != NULL);
+
+	/*
+	 * Stripe 1 has its parity on base bdev 1 and its data strips on base bdevs 2
+	 * and 0. The first write waits in the stripe buffer, the second one fills the
+	 * stripe, which is written out without reads.
+	 */
+	g_io_output_index = 0;
+	g_io_comp_status = false;
+	bdev_io = raid5_submit(ch, ch_b, pbdev, stripe_blocks, g_strip_size, SPDK_BDEV_IO_TYPE_WRITE,
+			       0xA5);
+	CU_ASSERT(g_io_output_index == 0);
+	CU_ASSERT(g_io_comp_status == false);
+	bdev_io2 = raid5_submit(ch, ch_b, pbdev, stripe_blocks + g_strip_size, g_strip_size,
+				SPDK_BDEV_IO_TYPE_WRITE, 0x3C);
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(g_io_output[0].iotype == SPDK_BDEV_IO_TYPE_WRITE);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(raid5_store_filled(pbdev, 2, g_strip_size, g_strip_size, 0xA5));
+	CU_ASSERT(raid5_store_filled(pbdev, 0, g_strip_size, g_strip_size, 0x3C));
+	CU_ASSERT(raid5_store_filled(pbdev, 1, g_strip_size, g_strip_size, 0xA5 ^ 0x3C));
+	bdev_io_cleanup(bdev_io);
+	bdev_io_cleanup(bdev_io2);
+
+	/* A partial stripe is written by the poller with read-modify-write */
+	g_io_output_index = 0;
+	g_io_comp_status = false;
+	bdev_io = raid5_submit(ch, ch_b, pbdev, stripe_blocks + 4, 8, SPDK_BDEV_IO_TYPE_WRITE, 0x0F);
+	raid5_channel_poll(r5ch);
+	CU_ASSERT(g_io_output_index == 0);
+	raid5_channel_poll(r5ch);
+	CU_ASSERT(g_io_output_index == 4);
+	CU_ASSERT(g_io_output[0].iotype == SPDK_BDEV_IO_TYPE_READ);
+	CU_ASSERT(g_io_output[0].desc == pbdev->base_bdev_info[2].desc);
+	CU_ASSERT(g_io_output[0].offset_blocks == g_strip_size + 4);
+	CU_ASSERT(g_io_output[0].num_blocks == 8);
+	CU_ASSERT(g_io_output[1].iotype == SPDK_BDEV_IO_TYPE_READ);
+	CU_ASSERT(g_io_output[1].desc == pbdev->base_bdev_info[1].desc);
+	CU_ASSERT(g_io_output[2].iotype == SPDK_BDEV_IO_TYPE_WRITE);
+	CU_ASSERT(g_io_output[3].iotype == SPDK_BDEV_IO_TYPE_WRITE);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(raid5_store_filled(pbdev, 2, g_strip_size + 4, 8, 0x0F));
+	CU_ASSERT(raid5_store_filled(pbdev, 2, g_strip_size + 12, 4, 0xA5));
+	CU_ASSERT(raid5_store_filled(pbdev, 1, g_strip_size + 4, 8, 0x0F ^ 0x3C));
+	CU_ASSERT(raid5_store_filled(pbdev, 1, g_strip_size, 4, 0xA5 ^ 0x3C));
+	CU_ASSERT(raid5_store_filled(pbdev, 1, g_strip_size + 12, 4, 0xA5 ^ 0x3C));
+	bdev_io_cleanup(bdev_io);
+
+	/* Reads go straight to the base bdev holding the strip */
+	g_io_output_index = 0;
+	bdev_io = raid5_submit(ch, ch_b, pbdev, stripe_blocks + g_strip_size + 8, 8,
+			       SPDK_BDEV_IO_TYPE_READ, 0);
+	CU_ASSERT(g_io_output_index == 1);
+	CU_ASSERT(g_io_output[0].desc == pbdev->base_bdev_info[0].desc);
+	CU_ASSERT(g_io_output[0].offset_blocks == g_strip_size + 8);
+	CU_ASSERT(raid5_buf_filled(bdev_io, 0x3C));
+	bdev_io_cleanup(bdev_io);
+
+	/* Unmap is not supported, the parity of unmapped blocks would be undefined */
+	g_io_output_index = 0;
+	g_io_comp_status = true;
+	bdev_io = raid5_submit(ch, ch_b, pbdev, 0, 8, SPDK_BDEV_IO_TYPE_UNMAP, 0);
+	CU_ASSERT(g_io_output_index == 0);
+	CU_ASSERT(g_io_comp_status == false);
+	bdev_io_cleanup(bdev_io);
+
+	raid_bdev_destroy_cb(pbdev, ch_ctx);
+	CU_ASSERT(ch_ctx->level_ctx == NULL);
+	free(ch);
+	free(ch_b);
+	destroy_raid5(&req);
+}
+
+static void
+test_raid5_degraded(void)
+{
+	struct rpc_bdev_raid_create req;
+	struct raid_bdev *pbdev;
+	struct raid5_info *raid5;
+	struct spdk_io_channel *ch;
+	struct raid_bdev_io_channel *ch_ctx;
+	struct spdk_io_channel *ch_b;
+	struct spdk_bdev_channel *ch_b_ctx;
+	struct spdk_bdev_io *bdev_io, *bdev_io2;
+	struct raid5_channel *r5ch;
+
+	set_globals();
+	CU_ASSERT(raid_bdev_init() == 0);
+	pbdev = create_raid5(&req, 3);
+	raid5 = pbdev->level_ctx;
+	create_base_bdev_stores(g_strip_size * 4);
+
+	ch = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct raid_bdev_io_channel));
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	ch_b = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct spdk_bdev_channel));
+	SPDK_CU_ASSERT_FATAL(ch_b != NULL);
+	ch_b_ctx = spdk_io_channel_get_ctx(ch_b);
+	ch_b_ctx->channel = ch;
+	ch_ctx = spdk_io_channel_get_ctx(ch);
+	CU_ASSERT(raid_bdev_create_cb(pbdev, ch_ctx) == 0);
+	r5ch = ch_ctx->level_ctx;
+	g_raid_io_channel = ch;
+
+	/* Stripe 0 has its data strips on base bdevs 0 and 1 and its parity on base bdev 2 */
+	bdev_io = raid5_submit(ch, ch_b, pbdev, 0, g_strip_size, SPDK_BDEV_IO_TYPE_WRITE, 0x11);
+	bdev_io2 = raid5_submit(ch, ch_b, pbdev, g_strip_size, g_strip_size, SPDK_BDEV_IO_TYPE_WRITE,
+				0x22);
+	CU_ASSERT(raid5_store_filled(pbdev, 2, 0, g_strip_size, 0x33));
+	bdev_io_cleanup(bdev_io);
+	bdev_io_cleanup(bdev_io2);
+
+	/* Hot removing a base bdev leaves the raid bdev online but degraded */
+	raid_bdev_remove_base_bdev(pbdev->base_bdev_info[0].bdev);
+	CU_ASSERT(pbdev->state == RAID_BDEV_STATE_ONLINE);
+	CU_ASSERT(pbdev->num_base_bdevs_discovered == 2);
+	CU_ASSERT(pbdev->base_bdev_info[0].bdev == NULL);
+	CU_ASSERT(ch_ctx->base_channel[0] == NULL);
+	CU_ASSERT(raid5->missing == 0);
+
+	/* Reads of the missing strip are rebuilt from the other strip and the parity */
+	g_io_output_index = 0;
+	bdev_io = raid5_submit(ch, ch_b, pbdev, 8, 8, SPDK_BDEV_IO_TYPE_READ, 0);
+	CU_ASSERT(g_io_output_index == 2);
+	CU_ASSERT(g_io_output[0].desc == pbdev->base_bdev_info[1].desc);
+	CU_ASSERT(g_io_output[0].offset_blocks == 8);
+	CU_ASSERT(g_io_output[1].desc == pbdev->base_bdev_info[2].desc);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(raid5_buf_filled(bdev_io, 0x11));
+	bdev_io_cleanup(bdev_io);
+
+	/* Writes to the missing strip only update the parity */
+	g_io_output_index = 0;
+	bdev_io = raid5_submit(ch, ch_b, pbdev, 0, 4, SPDK_BDEV_IO_TYPE_WRITE, 0x44);
+	raid5_channel_poll(r5ch);
+	raid5_channel_poll(r5ch);
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(g_io_output[2].iotype == SPDK_BDEV_IO_TYPE_WRITE);
+	CU_ASSERT(g_io_output[2].desc == pbdev->base_bdev_info[2].desc);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(raid5_store_filled(pbdev, 2, 0, 4, 0x44 ^ 0x22));
+	CU_ASSERT(raid5_store_filled(pbdev, 2, 4, g_strip_size - 4, 0x33));
+	CU_ASSERT(raid5_store_filled(pbdev, 1, 0, g_strip_size, 0x22));
+	bdev_io_cleanup(bdev_io);
+
+	g_io_output_index = 0;
+	bdev_io = raid5_submit(ch, ch_b, pbdev, 2, 4, SPDK_BDEV_IO_TYPE_READ, 0);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(memcmp(bdev_io->u.bdev.iovs->iov_base, "\x44\x44", 2) == 0);
+	CU_ASSERT(*((uint8_t *)bdev_io->u.bdev.iovs->iov_base + 2 * g_block_len) == 0x11);
+	bdev_io_cleanup(bdev_io);
+
+	/* Resets go to the remaining base bdevs */
+	g_io_output_index = 0;
+	g_io_comp_status = false;
+	bdev_io = raid5_submit(ch, ch_b, pbdev, 0, 1, SPDK_BDEV_IO_TYPE_RESET, 0);
+	CU_ASSERT(g_io_output_index == 2);
+	CU_ASSERT(g_io_comp_status == true);
+	bdev_io_cleanup(bdev_io);
+
+	/* A second missing base bdev takes the raid bdev offline */
+	raid_bdev_destroy_cb(pbdev, ch_ctx);
+	g_raid_io_channel = NULL;
+	raid_bdev_remove_base_bdev(pbdev->base_bdev_info[1].bdev);
+	CU_ASSERT(pbdev->state == RAID_BDEV_STATE_OFFLINE);
+
+	free(ch);
+	free(ch_b);
+	destroy_raid5(&req);
+}
+
+static void
+test_raid5_write_fail(void)
+{
+	struct rpc_bdev_raid_create req;
+	struct raid_bdev *pbdev;
+	struct raid5_info *raid5;
+	struct spdk_io_channel *ch;
+	struct raid_bdev_io_channel *ch_ctx;
+	struct spdk_io_channel *ch_b;
+	struct spdk_bdev_channel *ch_b_ctx;
+	struct spdk_bdev_io *bdev_io, *bdev_io2;
+	struct raid5_channel *r5ch;
+
+	set_globals();
+	CU_ASSERT(raid_bdev_init() == 0);
+	pbdev = create_raid5(&req, 3);
+	raid5 = pbdev->level_ctx;
+	create_base_bdev_stores(g_strip_size * 4);
+
+	ch = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct raid_bdev_io_channel));
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	ch_b = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct spdk_bdev_channel));
+	SPDK_CU_ASSERT_FATAL(ch_b != NULL);
+	ch_b_ctx = spdk_io_channel_get_ctx(ch_b);
+	ch_b_ctx->channel = ch;
+	ch_ctx = spdk_io_channel_get_ctx(ch);
+	CU_ASSERT(raid_bdev_create_cb(pbdev, ch_ctx) == 0);
+	r5ch = ch_ctx->level_ctx;
+	g_raid_io_channel = ch;
+
+	/* Stripe 0 has its data strips on base bdevs 0 and 1 and its parity on base bdev 2 */
+	bdev_io = raid5_submit(ch, ch_b, pbdev, 0, g_strip_size, SPDK_BDEV_IO_TYPE_WRITE, 0x11);
+	bdev_io2 = raid5_submit(ch, ch_b, pbdev, g_strip_size, g_strip_size, SPDK_BDEV_IO_TYPE_WRITE,
+				0x22);
+	bdev_io_cleanup(bdev_io);
+	bdev_io_cleanup(bdev_io2);
+
+	/*
+	 * A base bdev that fails a write is taken out of the raid bdev. The parity
+	 * covers its strip, so the write still succeeds.
+	 */
+	g_child_io_fail_desc = pbdev->base_bdev_info[1].desc;
+	g_io_comp_status = false;
+	bdev_io = raid5_submit(ch, ch_b, pbdev, 0, g_strip_size, SPDK_BDEV_IO_TYPE_WRITE, 0x55);
+	bdev_io2 = raid5_submit(ch, ch_b, pbdev, g_strip_size, g_strip_size, SPDK_BDEV_IO_TYPE_WRITE,
+				0x66);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(raid5->missing == 1);
+	CU_ASSERT(ch_ctx->base_channel[1] == NULL);
+	CU_ASSERT(pbdev->base_bdev_info[1].bdev != NULL);
+	CU_ASSERT(pbdev->state == RAID_BDEV_STATE_ONLINE);
+	CU_ASSERT(raid5_store_filled(pbdev, 2, 0, g_strip_size, 0x55 ^ 0x66));
+	bdev_io_cleanup(bdev_io);
+	bdev_io_cleanup(bdev_io2);
+	g_child_io_fail_desc = NULL;
+
+	/* Its stale strip is not read anymore, it is rebuilt from the parity */
+	g_io_output_index = 0;
+	bdev_io = raid5_submit(ch, ch_b, pbdev, g_strip_size, 8, SPDK_BDEV_IO_TYPE_READ, 0);
+	CU_ASSERT(g_io_output_index == 2);
+	CU_ASSERT(g_io_output[0].desc == pbdev->base_bdev_info[0].desc);
+	CU_ASSERT(g_io_output[1].desc == pbdev->base_bdev_info[2].desc);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(raid5_buf_filled(bdev_io, 0x66));
+	bdev_io_cleanup(bdev_io);
+
+	/* Later writes to its strip only update the parity */
+	g_io_output_index = 0;
+	bdev_io = raid5_submit(ch, ch_b, pbdev, g_strip_size, 4, SPDK_BDEV_IO_TYPE_WRITE, 0x77);
+	raid5_channel_poll(r5ch);
+	raid5_channel_poll(r5ch);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(raid5_store_filled(pbdev, 2, 0, 4, 0x55 ^ 0x77));
+	CU_ASSERT(raid5_store_filled(pbdev, 2, 4, g_strip_size - 4, 0x55 ^ 0x66));
+	bdev_io_cleanup(bdev_io);
+
+	/* A write failing on another base bdev fails, only one may be missing */
+	g_child_io_fail_desc = pbdev->base_bdev_info[0].desc;
+	g_io_comp_status = true;
+	bdev_io = raid5_submit(ch, ch_b, pbdev, 0, 4, SPDK_BDEV_IO_TYPE_WRITE, 0x88);
+	raid5_channel_poll(r5ch);
+	raid5_channel_poll(r5ch);
+	CU_ASSERT(g_io_comp_status == false);
+	CU_ASSERT(raid5->missing == 1);
+	CU_ASSERT(ch_ctx->base_channel[0] != NULL);
+	bdev_io_cleanup(bdev_io);
+	g_child_io_fail_desc = NULL;
+
+	/* Removing the failed base bdev releases it, the raid bdev stays degraded */
+	raid_bdev_remove_base_bdev(pbdev->base_bdev_info[1].bdev);
+	CU_ASSERT(pbdev->state == RAID_BDEV_STATE_ONLINE);
+	CU_ASSERT(pbdev->base_bdev_info[1].bdev == NULL);
+	CU_ASSERT(raid5->missing == 1);
+
+	raid_bdev_destroy_cb(pbdev, ch_ctx);
+	g_raid_io_channel = NULL;
+	raid_bdev_remove_base_bdev(pbdev->base_bdev_info[0].bdev);
+	CU_ASSERT(pbdev->state == RAID_BDEV_STATE_OFFLINE);
+
+	free(ch);
+	free(ch_b);
+	destroy_raid5(&req);
+}
+
+static void
+test_raid0_multi_strip_io(void)
+{
+	struct rpc_bdev_raid_create req;
+	struct rpc_bdev_raid_delete destroy_req;
+	struct raid_bdev *pbdev;
+	struct spdk_io_channel *ch;
+	struct raid_bdev_io_channel *ch_ctx;
+	struct spdk_io_channel *ch_b;
+	struct spdk_bdev_channel *ch_b_ctx;
+	struct spdk_bdev_io *bdev_io;
+	struct spdk_bdev *base_bdev;
+	struct iovec iovs[3], *iov;
+	struct iovec many_iovs[RAID0_SPLIT_IO_POOL_IOVS + 1];
+	struct spdk_bdev_io *bdev_io2, *child_io;
+	struct raid0_channel *r0ch;
+	struct raid0_split_io *split;
+	STAILQ_HEAD(, raid0_split_io) taken;
+	uint64_t lba = g_strip_size / 2;
+	uint64_t num_blocks = g_strip_size * 5;
+	uint64_t block, strip, pd_block;
+	uint8_t *buf, *store;
+	uint8_t pd_idx;
+	bool match;
+	int i;
+
+	set_globals();
+	CU_ASSERT(raid_bdev_init() == 0);
+	g_max_base_drives = 3;
+	create_raid_bdev_create_req(&req, "raid0", 0, true, 0);
+	spdk_rpc_bdev_raid_create(NULL, NULL);
+	CU_ASSERT(g_rpc_err == 0);
+	TAILQ_FOREACH(pbdev, &g_raid_bdev_list, global_link) {
+		if (strcmp(pbdev->bdev.name, "raid0") == 0) {
+			break;
+		}
+	}
+	SPDK_CU_ASSERT_FATAL(pbdev != NULL);
+	CU_ASSERT(pbdev->bdev.split_on_optimal_io_boundary == false);
+	create_base_bdev_stores(g_strip_size * 2);
+
+	ch = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct raid_bdev_io_channel));
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	ch_b = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct spdk_bdev_channel));
+	SPDK_CU_ASSERT_FATAL(ch_b != NULL);
+	ch_b_ctx = spdk_io_channel_get_ctx(ch_b);
+	ch_b_ctx->channel = ch;
+	ch_ctx = spdk_io_channel_get_ctx(ch);
+	CU_ASSERT(raid_bdev_create_cb(pbdev, ch_ctx) == 0);
+
+	/*
+	 * A write over strips 0 to 5 is sent as one request per base bdev, each
+	 * covering the two strips of the I/O it holds.
+	 */
+	bdev_io = calloc(1, sizeof(struct spdk_bdev_io) + sizeof(struct raid_bdev_io));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+	bdev_io_initialize(bdev_io, ch_b, &pbdev->bdev, lba, num_blocks, SPDK_BDEV_IO_TYPE_WRITE);
+	buf = bdev_io->u.bdev.iovs->iov_base;
+	for (block = 0; block < num_blocks; block++) {
+		memset(buf + block * g_block_len, (uint8_t)(lba + block), g_block_len);
+	}
+	g_io_output_index = 0;
+	g_io_comp_status = false;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(g_io_output[0].desc == pbdev->base_bdev_info[0].desc);
+	CU_ASSERT(g_io_output[0].offset_blocks == g_strip_size / 2);
+	CU_ASSERT(g_io_output[0].num_blocks == g_strip_size + g_strip_size / 2);
+	CU_ASSERT(g_io_output[1].desc == pbdev->base_bdev_info[1].desc);
+	CU_ASSERT(g_io_output[1].offset_blocks == 0);
+	CU_ASSERT(g_io_output[1].num_blocks == g_strip_size * 2);
+	CU_ASSERT(g_io_output[2].desc == pbdev->base_bdev_info[2].desc);
+	CU_ASSERT(g_io_output[2].offset_blocks == 0);
+	CU_ASSERT(g_io_output[2].num_blocks == g_strip_size + g_strip_size / 2);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(((struct raid_bdev_io *)bdev_io->driver_ctx)->split == NULL);
+
+	match = true;
+	for (block = lba; block < lba + num_blocks; block++) {
+		strip = block / g_strip_size;
+		pd_idx = strip % 3;
+		pd_block = (strip / 3) * g_strip_size + block % g_strip_size;
+		base_bdev = (struct spdk_bdev *)pbdev->base_bdev_info[pd_idx].desc;
+		store = base_bdev->ctxt;
+		if (store[pd_block * g_block_len] != (uint8_t)block) {
+			match = false;
+		}
+	}
+	CU_ASSERT(match == true);
+
+	/* Reading it back into three buffers that don't line up with the strips */
+	memset(buf, 0, num_blocks * g_block_len);
+	iov = bdev_io->u.bdev.iovs;
+	iovs[0].iov_base = buf;
+	iovs[0].iov_len = 10 * g_block_len;
+	iovs[1].iov_base = buf + 10 * g_block_len;
+	iovs[1].iov_len = 200 * g_block_len;
+	iovs[2].iov_base = buf + 210 * g_block_len;
+	iovs[2].iov_len = (num_blocks - 210) * g_block_len;
+	bdev_io->type = SPDK_BDEV_IO_TYPE_READ;
+	bdev_io->u.bdev.iovs = iovs;
+	bdev_io->u.bdev.iovcnt = 3;
+	g_io_output_index = 0;
+	g_io_comp_status = false;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(g_io_output[1].iotype == SPDK_BDEV_IO_TYPE_READ);
+	CU_ASSERT(g_io_comp_status == true);
+
+	match = true;
+	for (block = 0; block < num_blocks; block++) {
+		if (buf[block * g_block_len] != (uint8_t)(lba + block)) {
+			match = false;
+		}
+	}
+	CU_ASSERT(match == true);
+
+	/* A failed member disk request fails the parent I/O */
+	g_child_io_status_flag = false;
+	g_io_output_index = 0;
+	g_io_comp_status = true;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(g_io_comp_status == false);
+	g_child_io_status_flag = true;
+
+	/*
+	 * Split I/O contexts come from the pool of the channel. With the pool drained,
+	 * I/O waits for the one in flight to give its context back.
+	 */
+	r0ch = ch_ctx->level_ctx;
+	SPDK_CU_ASSERT_FATAL(r0ch != NULL);
+	STAILQ_INIT(&taken);
+	for (i = 0; i < RAID0_SPLIT_IO_POOL_SIZE - 1; i++) {
+		split = STAILQ_FIRST(&r0ch->free_splits);
+		SPDK_CU_ASSERT_FATAL(split != NULL);
+		STAILQ_REMOVE_HEAD(&r0ch->free_splits, link);
+		STAILQ_INSERT_TAIL(&taken, split, link);
+	}
+	g_ignore_io_output = 1;
+	raid_bdev_submit_request(ch, bdev_io);
+	split = ((struct raid_bdev_io *)bdev_io->driver_ctx)->split;
+	SPDK_CU_ASSERT_FATAL(split != NULL);
+	CU_ASSERT(split->pooled == true);
+	CU_ASSERT(STAILQ_EMPTY(&r0ch->free_splits));
+
+	bdev_io2 = calloc(1, sizeof(struct spdk_bdev_io) + sizeof(struct raid_bdev_io));
+	SPDK_CU_ASSERT_FATAL(bdev_io2 != NULL);
+	bdev_io_initialize(bdev_io2, ch_b, &pbdev->bdev, lba, num_blocks, SPDK_BDEV_IO_TYPE_WRITE);
+	raid_bdev_submit_request(ch, bdev_io2);
+	CU_ASSERT(TAILQ_FIRST(&r0ch->waiting_ios) == bdev_io2);
+	CU_ASSERT(((struct raid_bdev_io *)bdev_io2->driver_ctx)->split == NULL);
+
+	g_ignore_io_output = 0;
+	g_io_output_index = 0;
+	for (i = 0; i < 3; i++) {
+		child_io = calloc(1, sizeof(struct spdk_bdev_io));
+		SPDK_CU_ASSERT_FATAL(child_io != NULL);
+		raid0_split_io_completion(child_io, true, bdev_io);
+	}
+	CU_ASSERT(TAILQ_EMPTY(&r0ch->waiting_ios));
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(g_io_output[0].iotype == SPDK_BDEV_IO_TYPE_WRITE);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(STAILQ_FIRST(&r0ch->free_splits) == split);
+	bdev_io_cleanup(bdev_io2);
+
+	/* A payload too fragmented for a pooled context gets one of its own */
+	bdev_io->u.bdev.iovs = many_iovs;
+	bdev_io->u.bdev.iovcnt = RAID0_SPLIT_IO_POOL_IOVS + 1;
+	for (i = 0; i < RAID0_SPLIT_IO_POOL_IOVS + 1; i++) {
+		many_iovs[i].iov_base = buf + i * g_block_len;
+		many_iovs[i].iov_len = g_block_len;
+	}
+	many_iovs[i - 1].iov_len = (num_blocks - i + 1) * g_block_len;
+	g_io_output_index = 0;
+	g_io_comp_status = false;
+	raid_bdev_submit_request(ch, bdev_io);
+	CU_ASSERT(g_io_output_index == 3);
+	CU_ASSERT(g_io_comp_status == true);
+	CU_ASSERT(STAILQ_FIRST(&r0ch->free_splits) == split);
+	STAILQ_CONCAT(&r0ch->free_splits, &taken);
+
+	free(buf);
+	free(iov);
+	free(bdev_io);
+	raid_bdev_destroy_cb(pbdev, ch_ctx);
+	free(ch);
+	free(ch_b);
+	free_base_bdev_stores();
+	free_test_req(&req);
+	create_raid_bdev_delete_req(&destroy_req, "raid0", 0);
+	spdk_rpc_bdev_raid_delete(NULL, NULL);
+	CU_ASSERT(g_rpc_err == 0);
+	verify_raid_bdev_present("raid0", false);
+
+	raid_bdev_exit();
+	base_bdevs_cleanup();
+	reset_globals();
+	g_max_base_drives = MAX_BASE_DRIVES;
+}
+
 static void
 test_context_size(void)
 {
@@ -2242,7 +3635,16 @@ int main(int argc, char **argv)
 		CU_add_test(suite, "test_create_raid_from_config_invalid_params",
 			    test_create_raid_from_config_invalid_params) == NULL ||
 		CU_add_test(suite, "test_raid_json_dump_info", test_raid_json_dump_info) == NULL ||
-		CU_add_test(suite, "test_context_size", test_context_size) == NULL
+		CU_add_test(suite, "test_context_size", test_context_size) == NULL ||
+		CU_add_test(suite, "test_raid1_create", test_raid1_create) == NULL ||
+		CU_add_test(suite, "test_raid1_io", test_raid1_io) == NULL ||
+		CU_add_test(suite, "test_raid1_degraded_resync", test_raid1_degraded_resync) == NULL ||
+		CU_add_test(suite, "test_raid1_superblock", test_raid1_superblock) == NULL ||
+		CU_add_test(suite, "test_raid5_create", test_raid5_create) == NULL ||
+		CU_add_test(suite, "test_raid5_io", test_raid5_io) == NULL ||
+		CU_add_test(suite, "test_raid5_degraded", test_raid5_degraded) == NULL ||
+		CU_add_test(suite, "test_raid5_write_fail", test_raid5_write_fail) == NULL ||
+		CU_add_test(suite, "test_raid0_multi_strip_io", test_raid0_multi_strip_io) == NULL
 	) {
 		CU_cleanup_registry();
 		return CU_get_error();
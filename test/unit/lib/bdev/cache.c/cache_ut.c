@@ -0,0 +1,582 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk_cunit.h"
+
+#include "common/lib/ut_multithread.c"
+#include "unit/lib/json_mock.c"
+
+#include "bdev/vbdev_md.c"
+#include "bdev/cache/vbdev_cache.c"
+
+#define UT_VBDEV_CREATE	vbdev_cache_create
+#define UT_VBDEV_DELETE	vbdev_cache_delete
+#include "common/lib/ut_vbdev.h"
+
+#define UT_CACHE_BLOCKS		256
+#define UT_LINE_BLOCKS		8
+
+static struct ut_disk g_cachedev;
+
+static void
+ut_cache_setup(void)
+{
+	ut_setup();
+	ut_disk_init(&g_cachedev, "fast", UT_CACHE_BLOCKS);
+}
+
+static struct vbdev_cache *
+ut_cache_create(enum vbdev_cache_policy policy, bool format)
+{
+	struct vbdev_cache_opts opts = {
+		.name = "cache0",
+		.base_bdev_name = "base",
+		.cache_bdev_name = "fast",
+		.line_size = UT_LINE_BLOCKS * UT_BLOCK_SIZE,
+		.policy = policy,
+		.seq_cutoff = 4 * UT_LINE_BLOCKS * UT_BLOCK_SIZE,
+		.format = format,
+	};
+
+	return SPDK_CONTAINEROF(ut_create(&opts), struct vbdev_cache, bdev);
+}
+
+static void
+test_geometry(void)
+{
+	struct cache_geometry geo;
+	int rc;
+
+	rc = cache_compute_geometry(UT_CACHE_BLOCKS, UT_BLOCK_SIZE, UT_LINE_BLOCKS, &geo);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(geo.entries_per_page == 15);
+	CU_ASSERT(geo.md_offset == 1);
+	CU_ASSERT(geo.num_lines == 31);
+	CU_ASSERT(geo.md_blocks == 3);
+	CU_ASSERT(geo.data_offset == 8);
+
+	/* The metadata pushes the lines out of a bdev that exactly fits them. */
+	rc = cache_compute_geometry(1 + 64 * 16, 4096, 64, &geo);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(geo.data_offset % 64 == 0);
+	CU_ASSERT(geo.md_blocks * geo.entries_per_page >= geo.num_lines);
+	CU_ASSERT(geo.data_offset + geo.num_lines * 64 <= 1 + 64 * 16);
+	CU_ASSERT(geo.num_lines == 15);
+
+	rc = cache_compute_geometry(UT_LINE_BLOCKS, UT_BLOCK_SIZE, UT_LINE_BLOCKS, &geo);
+	CU_ASSERT(rc == -ENOSPC);
+	rc = cache_compute_geometry(UT_CACHE_BLOCKS, 32, UT_LINE_BLOCKS, &geo);
+	CU_ASSERT(rc == -EINVAL);
+}
+
+static struct vbdev_cache *
+ut_cache_state(enum vbdev_cache_policy policy, uint64_t num_lines)
+{
+	struct vbdev_cache *cache = calloc(1, sizeof(*cache));
+	int rc;
+
+	SPDK_CU_ASSERT_FATAL(cache != NULL);
+	cache->policy = policy;
+	cache->block_size = UT_BLOCK_SIZE;
+	cache->base_bdev = &g_base.bdev;
+	cache->cache_bdev = &g_cachedev.bdev;
+	cache->geo.line_blocks = UT_LINE_BLOCKS;
+	cache->geo.num_lines = num_lines;
+	cache->geo.entries_per_page = (UT_BLOCK_SIZE - sizeof(struct cache_md_hdr)) /
+				      sizeof(struct cache_md_entry);
+	cache->geo.md_blocks = spdk_divide_round_up(num_lines, cache->geo.entries_per_page);
+	rc = spdk_vbdev_md_init(&cache->md, &cache_md_ops, cache, "ut_cache",
+				(struct spdk_bdev_desc *)&g_cachedev, NULL);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	rc = cache_init_state(cache);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+
+	return cache;
+}
+
+static void
+ut_cache_state_free(struct vbdev_cache *cache)
+{
+	cache->bdev.name = NULL;
+	cache_free(cache);
+}
+
+static void
+test_lru(void)
+{
+	struct vbdev_cache *cache;
+	struct cache_line *line;
+	uint64_t i;
+
+	ut_cache_setup();
+	cache = ut_cache_state(VBDEV_CACHE_POLICY_LRU, 4);
+
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT(cache_policy_alloc(cache, i) != NULL);
+	}
+	CU_ASSERT(cache->list_len[CACHE_LIST_FREE] == 0);
+
+	/* Line 1 is the least recently used one after line 0 was hit. */
+	cache_policy_hit(cache, cache_find_resident(cache, 0));
+	CU_ASSERT(cache_policy_alloc(cache, 4) != NULL);
+	CU_ASSERT(cache_find_resident(cache, 1) == NULL);
+	CU_ASSERT(cache_find_resident(cache, 0) != NULL);
+	CU_ASSERT(cache->stats.evictions == 1);
+
+	/* Dirty and referenced lines are not evicted. */
+	cache_find_resident(cache, 2)->dirty = 1;
+	cache_find_resident(cache, 3)->refcnt = 1;
+	CU_ASSERT(cache_policy_alloc(cache, 5) != NULL);
+	CU_ASSERT(cache_find_resident(cache, 0) == NULL);
+	CU_ASSERT(cache_find_resident(cache, 2) != NULL);
+	CU_ASSERT(cache_find_resident(cache, 3) != NULL);
+
+	cache_find_resident(cache, 4)->dirty = 1;
+	cache_find_resident(cache, 5)->dirty = 1;
+	CU_ASSERT(cache_policy_alloc(cache, 6) == NULL);
+	CU_ASSERT(cache->alloc_failed == true);
+
+	/* No ghosts with LRU */
+	for (i = 0; i < 8; i++) {
+		line = cache_hash_find(cache, i);
+		CU_ASSERT(line == NULL || cache_line_is_resident(line));
+	}
+
+	ut_cache_state_free(cache);
+	ut_teardown();
+}
+
+static void
+test_arc(void)
+{
+	struct vbdev_cache *cache;
+	struct cache_line *line;
+	uint64_t i;
+
+	ut_cache_setup();
+	cache = ut_cache_state(VBDEV_CACHE_POLICY_ARC, 4);
+
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT(cache_policy_alloc(cache, i) != NULL);
+	}
+	CU_ASSERT(cache->list_len[CACHE_LIST_T1] == 4);
+
+	/* Lines accessed twice move to T2. */
+	cache_policy_hit(cache, cache_find_resident(cache, 0));
+	cache_policy_hit(cache, cache_find_resident(cache, 1));
+	CU_ASSERT(cache->list_len[CACHE_LIST_T1] == 2);
+	CU_ASSERT(cache->list_len[CACHE_LIST_T2] == 2);
+
+	/* T1 is above its target size, so its LRU line becomes a ghost. */
+	CU_ASSERT(cache_policy_alloc(cache, 4) != NULL);
+	line = cache_hash_find(cache, 2);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	CU_ASSERT(line->list == CACHE_LIST_B1);
+	CU_ASSERT(cache_line_idx(cache, line) >= 4);
+
+	/* A hit in B1 grows the target size of T1 and brings the line back into T2. */
+	line = cache_policy_alloc(cache, 2);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	CU_ASSERT(line->list == CACHE_LIST_T2);
+	CU_ASSERT(cache->arc_p == 1);
+	line = cache_hash_find(cache, 3);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	CU_ASSERT(line->list == CACHE_LIST_B1);
+	CU_ASSERT(cache->list_len[CACHE_LIST_T1] == 1);
+	CU_ASSERT(cache->list_len[CACHE_LIST_T2] == 3);
+
+	/* T1 is at its target size now, so a new line replaces the LRU line of T2. */
+	CU_ASSERT(cache_policy_alloc(cache, 5) != NULL);
+	line = cache_hash_find(cache, 0);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	CU_ASSERT(line->list == CACHE_LIST_B2);
+
+	/* A hit in B2 shrinks the target size of T1. */
+	line = cache_policy_alloc(cache, 0);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	CU_ASSERT(line->list == CACHE_LIST_T2);
+	CU_ASSERT(cache->arc_p == 0);
+
+	/* The directory never holds more than twice the number of lines. */
+	for (i = 10; i < 40; i++) {
+		CU_ASSERT(cache_policy_alloc(cache, i) != NULL);
+		CU_ASSERT(cache->list_len[CACHE_LIST_T1] + cache->list_len[CACHE_LIST_T2] == 4);
+		CU_ASSERT(cache->list_len[CACHE_LIST_T1] + cache->list_len[CACHE_LIST_B1] <= 4);
+		CU_ASSERT(cache->list_len[CACHE_LIST_B1] + cache->list_len[CACHE_LIST_B2] <= 4);
+	}
+
+	ut_cache_state_free(cache);
+	ut_teardown();
+}
+
+static void
+test_md_page(void)
+{
+	struct vbdev_cache *cache, *loaded;
+	struct cache_line *line;
+	uint8_t buf[UT_BLOCK_SIZE];
+	int rc;
+
+	ut_cache_setup();
+	cache = ut_cache_state(VBDEV_CACHE_POLICY_LRU, 20);
+
+	line = cache_policy_alloc(cache, 7);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	line->valid = 0xff;
+	line->dirty = 0x0c;
+	line = cache_policy_alloc(cache, 9);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	line->valid = 0x0f;
+	cache_md_serialize_page(cache, 0, buf);
+	CU_ASSERT(cache->lines[0].md_snap == 0x0c);
+
+	/* After a clean shutdown all lines are loaded. */
+	loaded = ut_cache_state(VBDEV_CACHE_POLICY_LRU, 20);
+	rc = cache_md_parse_page(loaded, 0, buf, true);
+	CU_ASSERT(rc == 0);
+	line = cache_find_resident(loaded, 7);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	CU_ASSERT(line->valid == 0xff);
+	CU_ASSERT(line->dirty == 0x0c);
+	CU_ASSERT(line->md_dirty == 0x0c);
+	CU_ASSERT(line->on_dirty_list);
+	line = cache_find_resident(loaded, 9);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	CU_ASSERT(line->valid == 0x0f);
+	CU_ASSERT(loaded->num_dirty == 1);
+	ut_cache_state_free(loaded);
+
+	/* After a crash only the dirty blocks are. */
+	cache_md_serialize_page(cache, 0, buf);
+	loaded = ut_cache_state(VBDEV_CACHE_POLICY_LRU, 20);
+	rc = cache_md_parse_page(loaded, 0, buf, false);
+	CU_ASSERT(rc == 0);
+	line = cache_find_resident(loaded, 7);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	CU_ASSERT(line->valid == 0x0c);
+	CU_ASSERT(line->dirty == 0x0c);
+	CU_ASSERT(cache_find_resident(loaded, 9) == NULL);
+	ut_cache_state_free(loaded);
+
+	/* Corrupted page */
+	cache_md_serialize_page(cache, 0, buf);
+	buf[100] ^= 1;
+	loaded = ut_cache_state(VBDEV_CACHE_POLICY_LRU, 20);
+	rc = cache_md_parse_page(loaded, 0, buf, true);
+	CU_ASSERT(rc == -EILSEQ);
+	ut_cache_state_free(loaded);
+
+	ut_cache_state_free(cache);
+	ut_teardown();
+}
+
+static void
+test_stream(void)
+{
+	struct vbdev_cache cache = {};
+	uint64_t i;
+
+	cache.block_size = UT_BLOCK_SIZE;
+	cache.seq_cutoff = 4 * UT_BLOCK_SIZE;
+
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT(cache_stream_update(&cache, 100 + i, 1) == false);
+		/* Interleaved random I/O doesn't break the stream. */
+		CU_ASSERT(cache_stream_update(&cache, 500 + 17 * i, 1) == false);
+	}
+	CU_ASSERT(cache_stream_update(&cache, 104, 1) == true);
+	CU_ASSERT(cache_stream_update(&cache, 105, 8) == true);
+	CU_ASSERT(cache_stream_update(&cache, 300, 2) == false);
+
+	cache.seq_cutoff = 0;
+	CU_ASSERT(cache_stream_update(&cache, 113, 64) == false);
+}
+
+static void
+test_write_back(void)
+{
+	struct vbdev_cache *cache;
+	struct spdk_bdev_io *bdev_io;
+	struct cache_line *line;
+	uint8_t *buf, *rbuf;
+	uint64_t offset;
+	int rc;
+
+	ut_cache_setup();
+	buf = calloc(UT_LINE_BLOCKS, UT_BLOCK_SIZE);
+	rbuf = calloc(UT_LINE_BLOCKS, UT_BLOCK_SIZE);
+	SPDK_CU_ASSERT_FATAL(buf != NULL && rbuf != NULL);
+
+	/* The cache bdev holds no cache, so it gets formatted. */
+	cache = ut_cache_create(VBDEV_CACHE_POLICY_ARC, false);
+	CU_ASSERT(memcmp(g_cachedev.data, CACHE_SB_MAGIC, 8) == 0);
+	CU_ASSERT(cache->geo.num_lines == 31);
+	CU_ASSERT(cache->bdev.optimal_io_boundary == UT_LINE_BLOCKS);
+	CU_ASSERT(cache->bdev.split_on_optimal_io_boundary == true);
+
+	/* Write from another thread. It completes after both data and metadata are written. */
+	ut_fill(buf, 19, 2, 0x40);
+	g_io_done = 0;
+	g_io_status = SPDK_BDEV_IO_STATUS_PENDING;
+	bdev_io = ut_submit(&cache->bdev, 1, SPDK_BDEV_IO_TYPE_WRITE, buf, 19, 2);
+	poll_threads();
+	CU_ASSERT(ut_complete_io() == 1);
+	poll_threads();
+	CU_ASSERT(g_io_done == 0);
+	CU_ASSERT(ut_complete_io() == 1);
+	poll_threads();
+	CU_ASSERT(g_io_done == 1);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(g_complete_thread == g_ut_threads[1].thread);
+	free(bdev_io);
+
+	line = cache_find_resident(cache, 2);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	CU_ASSERT(line->dirty == 0x18);
+	CU_ASSERT(line->md_dirty == 0x18);
+	offset = cache_line_offset(cache, line, 3);
+	CU_ASSERT(memcmp(g_cachedev.data + offset * UT_BLOCK_SIZE, buf, 2 * UT_BLOCK_SIZE) == 0);
+	CU_ASSERT(spdk_mem_all_zero(g_base.data + 19 * UT_BLOCK_SIZE, 2 * UT_BLOCK_SIZE));
+
+	/* Rewriting dirty blocks needs no metadata update. */
+	rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_WRITE, buf, 19, 1);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(cache->md.writes == 1);
+	CU_ASSERT(cache->stats.write_hits == 1);
+	CU_ASSERT(cache->stats.write_misses == 1);
+
+	/* Read the dirty blocks back from the cache. */
+	rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_READ, rbuf, 19, 2);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(memcmp(rbuf, buf, 2 * UT_BLOCK_SIZE) == 0);
+	CU_ASSERT(cache->stats.read_hits == 1);
+
+	/* Mix dirty blocks from the cache with data from the base bdev. */
+	ut_fill(g_base.data + 16 * UT_BLOCK_SIZE, 16, 8, 0x80);
+	rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_READ, rbuf, 17, 5);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(cache->stats.read_partial_hits == 1);
+	CU_ASSERT(memcmp(rbuf, g_base.data + 17 * UT_BLOCK_SIZE, 2 * UT_BLOCK_SIZE) == 0);
+	CU_ASSERT(memcmp(rbuf + 2 * UT_BLOCK_SIZE, buf, 2 * UT_BLOCK_SIZE) == 0);
+	CU_ASSERT(memcmp(rbuf + 4 * UT_BLOCK_SIZE, g_base.data + 21 * UT_BLOCK_SIZE,
+			 UT_BLOCK_SIZE) == 0);
+
+	/*
+	 * Once the dirty blocks reach the end of the line and the next line is dirty from
+	 * its first block, both are destaged with one write.
+	 */
+	ut_fill(buf, 21, 3, 0x40);
+	rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_WRITE, buf, 21, 3);
+	CU_ASSERT(rc == 0);
+	ut_fill(buf, 24, 4, 0x40);
+	rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_WRITE, buf, 24, 4);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(cache->num_dirty == 2);
+
+	ut_run_for(1000);
+	CU_ASSERT(cache->num_dirty == 0);
+	CU_ASSERT(cache->stats.destage_ios == 1);
+	CU_ASSERT(cache->stats.destaged_blocks == 9);
+	ut_fill(buf, 19, UT_LINE_BLOCKS, 0x40);
+	CU_ASSERT(memcmp(g_base.data + 19 * UT_BLOCK_SIZE, buf, 5 * UT_BLOCK_SIZE) == 0);
+	ut_fill(buf, 24, 4, 0x40);
+	CU_ASSERT(memcmp(g_base.data + 24 * UT_BLOCK_SIZE, buf, 4 * UT_BLOCK_SIZE) == 0);
+	CU_ASSERT(line->dirty == 0 && line->md_dirty == 0);
+	CU_ASSERT(!line->on_dirty_list);
+
+	ut_delete(&cache->bdev);
+	free(buf);
+	free(rbuf);
+	ut_teardown();
+}
+
+static void
+test_read_fill(void)
+{
+	struct vbdev_cache *cache;
+	struct cache_line *line;
+	uint8_t *buf;
+	uint64_t i;
+	int rc;
+
+	ut_cache_setup();
+	buf = calloc(UT_LINE_BLOCKS, UT_BLOCK_SIZE);
+	SPDK_CU_ASSERT_FATAL(buf != NULL);
+	ut_fill(g_base.data, 0, UT_BASE_BLOCKS, 0);
+	cache = ut_cache_create(VBDEV_CACHE_POLICY_LRU, true);
+
+	/* A read miss is copied into the cache, so the next read hits. */
+	rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_READ, buf, 500, 4);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(cache->stats.read_misses == 1);
+	CU_ASSERT(cache->stats.fills == 1);
+	line = cache_find_resident(cache, 500 / UT_LINE_BLOCKS);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	CU_ASSERT(line->valid == cache_mask(500 % UT_LINE_BLOCKS, 4));
+	CU_ASSERT(line->dirty == 0);
+
+	memset(g_base.data + 500 * UT_BLOCK_SIZE, 0xff, 4 * UT_BLOCK_SIZE);
+	memset(buf, 0, 4 * UT_BLOCK_SIZE);
+	rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_READ, buf, 500, 4);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(cache->stats.read_hits == 1);
+	CU_ASSERT(buf[0] == (uint8_t)500);
+	ut_fill(g_base.data + 500 * UT_BLOCK_SIZE, 500, 4, 0);
+
+	/* A sequential stream bypasses the cache once it is longer than the cutoff. */
+	for (i = 0; i < 8; i++) {
+		rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_READ, buf, 640 + i * UT_LINE_BLOCKS,
+			   UT_LINE_BLOCKS);
+		CU_ASSERT(rc == 0);
+		CU_ASSERT(buf[0] == (uint8_t)(640 + i * UT_LINE_BLOCKS));
+	}
+	CU_ASSERT(cache->stats.bypassed == 4);
+	CU_ASSERT(cache->stats.fills == 5);
+	CU_ASSERT(cache_find_resident(cache, 640 / UT_LINE_BLOCKS + 7) == NULL);
+
+	/* Sequential writes of lines not in the cache go to the base bdev. */
+	memset(buf, 0x33, UT_LINE_BLOCKS * UT_BLOCK_SIZE);
+	rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_WRITE, buf, 640 + 8 * UT_LINE_BLOCKS,
+		   UT_LINE_BLOCKS);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(cache->stats.bypassed == 5);
+	CU_ASSERT(g_base.data[(640 + 8 * UT_LINE_BLOCKS) * UT_BLOCK_SIZE] == 0x33);
+	CU_ASSERT(cache->num_dirty == 0);
+
+	ut_delete(&cache->bdev);
+	free(buf);
+	ut_teardown();
+}
+
+static void
+test_recovery(void)
+{
+	struct vbdev_cache_opts opts = {
+		.name = "cache0",
+		.base_bdev_name = "base",
+		.cache_bdev_name = "fast",
+	};
+	struct vbdev_cache *cache;
+	struct cache_line *line;
+	uint8_t *buf, *snapshot;
+	int rc;
+
+	ut_cache_setup();
+	buf = calloc(UT_LINE_BLOCKS, UT_BLOCK_SIZE);
+	snapshot = calloc(UT_CACHE_BLOCKS, UT_BLOCK_SIZE);
+	SPDK_CU_ASSERT_FATAL(buf != NULL && snapshot != NULL);
+
+	cache = ut_cache_create(VBDEV_CACHE_POLICY_ARC, true);
+	ut_fill(buf, 40, 4, 0x10);
+	rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_WRITE, buf, 40, 4);
+	CU_ASSERT(rc == 0);
+	rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_READ, buf, 80, 2);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(cache_find_resident(cache, 10) != NULL);
+
+	/* Crash right after the write completed. */
+	memcpy(snapshot, g_cachedev.data, UT_CACHE_BLOCKS * UT_BLOCK_SIZE);
+	CU_ASSERT(((struct cache_sb *)snapshot)->clean == 0);
+	ut_delete(&cache->bdev);
+	CU_ASSERT(((struct cache_sb *)g_cachedev.data)->clean == 1);
+	memcpy(g_cachedev.data, snapshot, UT_CACHE_BLOCKS * UT_BLOCK_SIZE);
+
+	/* Only the dirty line comes back, and its data is read from the cache. */
+	cache = ut_cache_create(VBDEV_CACHE_POLICY_ARC, false);
+	line = cache_find_resident(cache, 5);
+	SPDK_CU_ASSERT_FATAL(line != NULL);
+	CU_ASSERT(line->dirty == 0x0f);
+	CU_ASSERT(cache_find_resident(cache, 10) == NULL);
+	CU_ASSERT(cache->num_dirty == 1);
+	memset(buf, 0, 4 * UT_BLOCK_SIZE);
+	rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_READ, buf, 40, 4);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(buf[0] == 0x10 + 40);
+	CU_ASSERT(cache->stats.read_hits == 1);
+	CU_ASSERT(spdk_mem_all_zero(g_base.data + 40 * UT_BLOCK_SIZE, 4 * UT_BLOCK_SIZE));
+	ut_delete(&cache->bdev);
+
+	/* After a clean shutdown, clean lines come back too. */
+	cache = ut_cache_create(VBDEV_CACHE_POLICY_ARC, false);
+	CU_ASSERT(cache_find_resident(cache, 5) != NULL);
+	rc = ut_io(&cache->bdev, SPDK_BDEV_IO_TYPE_READ, buf, 40, 4);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(cache->stats.read_hits == 1);
+	ut_delete(&cache->bdev);
+
+	/* The cache doesn't belong to another base bdev. */
+	spdk_uuid_generate(&g_base.bdev.uuid);
+	CU_ASSERT(ut_try_create(&opts) == -EINVAL);
+	CU_ASSERT(g_created == NULL);
+
+	free(buf);
+	free(snapshot);
+	ut_teardown();
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("cache", NULL, NULL);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (
+		CU_add_test(suite, "test_geometry", test_geometry) == NULL ||
+		CU_add_test(suite, "test_lru", test_lru) == NULL ||
+		CU_add_test(suite, "test_arc", test_arc) == NULL ||
+		CU_add_test(suite, "test_md_page", test_md_page) == NULL ||
+		CU_add_test(suite, "test_stream", test_stream) == NULL ||
+		CU_add_test(suite, "test_write_back", test_write_back) == NULL ||
+		CU_add_test(suite, "test_read_fill", test_read_fill) == NULL ||
+		CU_add_test(suite, "test_recovery", test_recovery) == NULL
+	) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+	return num_failures;
+}
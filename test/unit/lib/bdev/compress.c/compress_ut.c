@@ -294,6 +294,20 @@ DEFINE_STUB_V(spdk_reduce_vol_load, (struct spdk_reduce_backing_dev *backing_dev
 DEFINE_STUB(spdk_reduce_vol_get_params, const struct spdk_reduce_vol_params *,
 	    (struct spdk_reduce_vol *vol), NULL);
 
+/* Software engine stubs */
+DEFINE_STUB(comp_sw_ctx_alloc, struct comp_sw_ctx *, (void), NULL);
+DEFINE_STUB_V(comp_sw_ctx_free, (struct comp_sw_ctx *ctx));
+DEFINE_STUB(comp_sw_engine_start, int, (uint32_t num_workers), 0);
+DEFINE_STUB_V(comp_sw_engine_stop, (void));
+DEFINE_STUB_V(comp_sw_engine_submit, (struct comp_sw_op *op));
+
+static int ut_sw_result;
+void
+comp_sw_op_execute(struct comp_sw_ctx *ctx, struct comp_sw_op *op)
+{
+	op->result = ut_sw_result;
+}
+
 /* DPDK stubs */
 DEFINE_STUB(rte_socket_id, unsigned, (void), 0);
 DEFINE_STUB(rte_eal_get_configuration, struct rte_config *, (void), NULL);
@@ -1008,10 +1022,10 @@ test_initdrivers(void)
 	/* This is not an error condition, we already have one */
 	CU_ASSERT(rc == 0);
 
-	/* error */
+	/* error, not fatal as the software engine still works */
 	MOCK_SET(rte_vdev_init, -2);
 	rc = vbdev_init_compress_drivers();
-	CU_ASSERT(rc == -EINVAL);
+	CU_ASSERT(rc == 0);
 	CU_ASSERT(g_mbuf_mp == NULL);
 	CU_ASSERT(g_comp_op_mp == NULL);
 
@@ -1075,6 +1089,100 @@ test_initdrivers(void)
 	spdk_mempool_free((struct spdk_mempool *)g_mbuf_mp);
 }
 
+static void
+test_sw_operation(void)
+{
+	struct vbdev_compress comp_bdev = {};
+	struct comp_sw_op op = {};
+	struct comp_sw_op *op_ptr = &op;
+	struct compress_sw_opts opts;
+	struct spdk_reduce_vol_cb_args cb_args = { .cb_fn = _compress_done };
+	struct iovec src_iov = { .iov_base = (void *)0x10000000, .iov_len = 0x1000 };
+	struct iovec dst_iov = { .iov_base = (void *)0x20000000, .iov_len = 0x1000 };
+	int rc;
+
+	/* Without a compressdev, auto selects the software engine and starts it. */
+	g_opts = COMPRESS_PMD_AUTO;
+	g_qat_available = false;
+	g_isal_available = false;
+	CU_ASSERT(_set_pmd(&comp_bdev) == true);
+	CU_ASSERT(strcmp(comp_bdev.drv_name, SW_ENGINE) == 0);
+	CU_ASSERT(comp_bdev.sw == true);
+	CU_ASSERT(g_sw_engine_started == true);
+
+	/* The number of workers can't change anymore, the level can. */
+	get_compress_sw_opts(&opts);
+	opts.level = 3;
+	opts.num_workers++;
+	rc = set_compress_sw_opts(&opts);
+	CU_ASSERT(rc == -EBUSY);
+	opts.level = COMP_SW_LEVEL_MAX + 1;
+	opts.num_workers--;
+	rc = set_compress_sw_opts(&opts);
+	CU_ASSERT(rc == -EINVAL);
+	opts.level = 3;
+	rc = set_compress_sw_opts(&opts);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_sw_opts.level == 3);
+
+	/* Without workers, the op is run by the poller, not on submission. */
+	comp_bdev.sw_ctx = (struct comp_sw_ctx *)0xDEADBEEF;
+	TAILQ_INIT(&comp_bdev.sw_free_ops);
+	TAILQ_INIT(&comp_bdev.sw_pending_ops);
+	TAILQ_INIT(&comp_bdev.queued_comp_ops);
+	TAILQ_INSERT_TAIL(&comp_bdev.sw_free_ops, &op, link);
+	rc = _compress_operation(&comp_bdev.backing_dev, &src_iov, 1, &dst_iov, 1, true, &cb_args);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(TAILQ_FIRST(&comp_bdev.sw_pending_ops) == &op);
+	CU_ASSERT(op.compress == true);
+	CU_ASSERT(op.level == 3);
+
+	/* Out of ops, the next one is queued. */
+	rc = _compress_operation(&comp_bdev.backing_dev, &dst_iov, 1, &src_iov, 1, false, &cb_args);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(TAILQ_EMPTY(&comp_bdev.queued_comp_ops) == false);
+
+	/* Completing the first op resubmits the queued one. */
+	done_count = 1;
+	ut_sw_result = 0x800;
+	ut_compress_done[0] = 0x800;
+	rc = comp_sw_poller(&comp_bdev);
+	CU_ASSERT(rc == 1);
+	CU_ASSERT(TAILQ_EMPTY(&comp_bdev.queued_comp_ops) == true);
+	CU_ASSERT(TAILQ_FIRST(&comp_bdev.sw_pending_ops) == &op);
+	CU_ASSERT(op.compress == false);
+
+	/* Errors are passed on to reduce. */
+	ut_sw_result = -EIO;
+	ut_compress_done[0] = -EIO;
+	rc = comp_sw_poller(&comp_bdev);
+	CU_ASSERT(rc == 1);
+	CU_ASSERT(TAILQ_FIRST(&comp_bdev.sw_free_ops) == &op);
+	CU_ASSERT(TAILQ_EMPTY(&comp_bdev.sw_pending_ops) == true);
+
+	/* With workers, the op completes through the ring. */
+	comp_bdev.sw_ctx = NULL;
+	comp_bdev.sw_cq = spdk_ring_create(SPDK_RING_TYPE_MP_SC, 1, SPDK_ENV_SOCKET_ID_ANY);
+	SPDK_CU_ASSERT_FATAL(comp_bdev.sw_cq != NULL);
+	rc = _compress_operation(&comp_bdev.backing_dev, &src_iov, 1, &dst_iov, 1, true, &cb_args);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(TAILQ_EMPTY(&comp_bdev.sw_free_ops) == true);
+	CU_ASSERT(TAILQ_EMPTY(&comp_bdev.sw_pending_ops) == true);
+	CU_ASSERT(op.cq == comp_bdev.sw_cq);
+	rc = comp_sw_poller(&comp_bdev);
+	CU_ASSERT(rc == 0);
+	op.result = 0x400;
+	ut_compress_done[0] = 0x400;
+	CU_ASSERT(spdk_ring_enqueue(comp_bdev.sw_cq, (void **)&op_ptr, 1, NULL) == 1);
+	rc = comp_sw_poller(&comp_bdev);
+	CU_ASSERT(rc == 1);
+	CU_ASSERT(TAILQ_FIRST(&comp_bdev.sw_free_ops) == &op);
+
+	spdk_ring_free(comp_bdev.sw_cq);
+	g_sw_engine_started = false;
+	g_sw_opts.level = COMP_SW_LEVEL_DEFAULT;
+}
+
 static void
 test_supported_io(void)
 {
@@ -1111,6 +1219,8 @@ main(int argc, char **argv)
 			test_supported_io) == NULL ||
 	    CU_add_test(suite, "test_poller",
 			test_poller) == NULL ||
+	    CU_add_test(suite, "test_sw_operation",
+			test_sw_operation) == NULL ||
 	    CU_add_test(suite, "test_reset",
 			test_reset) == NULL
 	   ) {
@@ -0,0 +1,186 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk_cunit.h"
+#include "common/lib/test_env.c"
+#include "spdk_internal/mock.h"
+
+#include "bdev/compress/vbdev_compress_sw.c"
+
+DEFINE_STUB(spdk_call_unaffinitized, void *, (void *cb(void *arg), void *arg), NULL);
+
+#define UT_DATA_LEN	(16 * 1024)
+
+static uint8_t g_src[UT_DATA_LEN];
+static uint8_t g_src2[UT_DATA_LEN];
+static uint8_t g_comp[2][UT_DATA_LEN * 2];
+static uint8_t g_decomp[UT_DATA_LEN];
+
+static void
+fill_data(uint8_t *buf, size_t len, uint32_t seed)
+{
+	size_t i;
+
+	/* Four random bits per byte, so the data compresses to about half */
+	for (i = 0; i < len; i++) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = (seed >> 16) & 0x0f;
+	}
+}
+
+static void
+check_round_trip(struct comp_sw_ctx *ctx, uint8_t *comp, int comp_len, const uint8_t *orig)
+{
+	struct iovec src_iov = { .iov_base = comp, .iov_len = comp_len };
+	struct iovec dst_iov = { .iov_base = g_decomp, .iov_len = sizeof(g_decomp) };
+
+	memset(g_decomp, 0, sizeof(g_decomp));
+	CU_ASSERT(comp_sw_inflate(ctx, &src_iov, 1, &dst_iov, 1) == UT_DATA_LEN);
+	CU_ASSERT(memcmp(g_decomp, orig, UT_DATA_LEN) == 0);
+}
+
+static void
+test_deflate_reuse_ctx(void)
+{
+	struct comp_sw_ctx *ctx;
+	struct iovec src_iov, dst_iovs[2];
+	int len, len2;
+
+	ctx = comp_sw_ctx_alloc();
+	SPDK_CU_ASSERT_FATAL(ctx != NULL);
+	fill_data(g_src, sizeof(g_src), 3);
+	fill_data(g_src2, sizeof(g_src2), 5);
+
+	/* A large destination buffer is left with room once the first deflate is done */
+	src_iov.iov_base = g_src;
+	src_iov.iov_len = sizeof(g_src);
+	dst_iovs[0].iov_base = g_comp[0];
+	dst_iovs[0].iov_len = sizeof(g_comp[0]);
+	len = comp_sw_deflate(ctx, COMP_SW_LEVEL_DEFAULT, &src_iov, 1, dst_iovs, 1);
+	SPDK_CU_ASSERT_FATAL(len > 0);
+
+	/* The second deflate on the context writes only to its own, smaller buffers */
+	memset(g_comp[1], 0, sizeof(g_comp[1]));
+	src_iov.iov_base = g_src2;
+	dst_iovs[0].iov_base = g_comp[1];
+	dst_iovs[0].iov_len = 100;
+	dst_iovs[1].iov_base = g_comp[1] + 100;
+	dst_iovs[1].iov_len = sizeof(g_comp[1]) - 100;
+	len2 = comp_sw_deflate(ctx, COMP_SW_LEVEL_DEFAULT, &src_iov, 1, dst_iovs, 2);
+	SPDK_CU_ASSERT_FATAL(len2 > 100);
+
+	check_round_trip(ctx, g_comp[0], len, g_src);
+	check_round_trip(ctx, g_comp[1], len2, g_src2);
+
+	/* A deflate that ran out of room doesn't leave its buffers to the next one */
+	dst_iovs[0].iov_base = g_comp[1];
+	dst_iovs[0].iov_len = 16;
+	CU_ASSERT(comp_sw_deflate(ctx, COMP_SW_LEVEL_DEFAULT, &src_iov, 1, dst_iovs, 1) == -ENOSPC);
+	memset(g_comp[0], 0, sizeof(g_comp[0]));
+	src_iov.iov_base = g_src;
+	dst_iovs[0].iov_base = g_comp[0];
+	dst_iovs[0].iov_len = sizeof(g_comp[0]);
+	len = comp_sw_deflate(ctx, COMP_SW_LEVEL_MAX, &src_iov, 1, dst_iovs, 1);
+	SPDK_CU_ASSERT_FATAL(len > 0);
+	check_round_trip(ctx, g_comp[0], len, g_src);
+
+	comp_sw_ctx_free(ctx);
+}
+
+static void
+test_inflate_reuse_ctx(void)
+{
+	struct comp_sw_ctx *ctx;
+	struct iovec src_iov, dst_iovs[2];
+	int len;
+
+	ctx = comp_sw_ctx_alloc();
+	SPDK_CU_ASSERT_FATAL(ctx != NULL);
+	fill_data(g_src, sizeof(g_src), 7);
+
+	src_iov.iov_base = g_src;
+	src_iov.iov_len = sizeof(g_src);
+	dst_iovs[0].iov_base = g_comp[0];
+	dst_iovs[0].iov_len = sizeof(g_comp[0]);
+	len = comp_sw_deflate(ctx, COMP_SW_LEVEL_DEFAULT, &src_iov, 1, dst_iovs, 1);
+	SPDK_CU_ASSERT_FATAL(len > 0);
+
+	/* An inflate that ran out of room leaves room in a buffer the next one doesn't own */
+	src_iov.iov_base = g_comp[0];
+	src_iov.iov_len = len;
+	dst_iovs[0].iov_base = g_comp[1];
+	dst_iovs[0].iov_len = UT_DATA_LEN / 2;
+	CU_ASSERT(comp_sw_inflate(ctx, &src_iov, 1, dst_iovs, 1) == -ENOSPC);
+
+	memset(g_decomp, 0, sizeof(g_decomp));
+	dst_iovs[0].iov_base = g_decomp;
+	dst_iovs[0].iov_len = 512;
+	dst_iovs[1].iov_base = g_decomp + 512;
+	dst_iovs[1].iov_len = sizeof(g_decomp) - 512;
+	CU_ASSERT(comp_sw_inflate(ctx, &src_iov, 1, dst_iovs, 2) == UT_DATA_LEN);
+	CU_ASSERT(memcmp(g_decomp, g_src, UT_DATA_LEN) == 0);
+
+	comp_sw_ctx_free(ctx);
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("compress_sw", NULL, NULL);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (CU_add_test(suite, "test_deflate_reuse_ctx",
+			test_deflate_reuse_ctx) == NULL ||
+	    CU_add_test(suite, "test_inflate_reuse_ctx",
+			test_inflate_reuse_ctx) == NULL
+	   ) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+	return num_failures;
+}
@@ -0,0 +1,672 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk_cunit.h"
+
+#include "common/lib/ut_multithread.c"
+#include "unit/lib/json_mock.c"
+
+#include "bdev/vbdev_md.c"
+#include "bdev/dedup/vbdev_dedup.c"
+
+#define UT_VBDEV_CREATE	vbdev_dedup_create
+#define UT_VBDEV_DELETE	vbdev_dedup_delete
+#include "common/lib/ut_vbdev.h"
+
+#define UT_CHUNK_BLOCKS		8
+#define UT_CHUNK_SIZE		(UT_CHUNK_BLOCKS * UT_BLOCK_SIZE)
+
+static void
+ut_dedup_opts(struct vbdev_dedup_opts *opts, uint64_t logical_chunks, bool format)
+{
+	memset(opts, 0, sizeof(*opts));
+	opts->name = "dedup0";
+	opts->base_bdev_name = "base";
+	opts->chunk_size = UT_CHUNK_SIZE;
+	opts->logical_size = logical_chunks * UT_CHUNK_SIZE;
+	opts->format = format;
+}
+
+static int
+ut_dedup_try_create(uint64_t logical_chunks, bool format)
+{
+	struct vbdev_dedup_opts opts;
+
+	ut_dedup_opts(&opts, logical_chunks, format);
+
+	return ut_try_create(&opts);
+}
+
+static struct vbdev_dedup *
+ut_dedup_create(uint64_t logical_chunks, bool format)
+{
+	struct vbdev_dedup_opts opts;
+
+	ut_dedup_opts(&opts, logical_chunks, format);
+
+	return SPDK_CONTAINEROF(ut_create(&opts), struct vbdev_dedup, bdev);
+}
+
+/* Write a whole chunk filled with the seed. */
+static int
+ut_write_chunk(struct vbdev_dedup *dedup, uint64_t lchunk, uint8_t seed)
+{
+	uint8_t buf[UT_CHUNK_SIZE];
+
+	ut_fill(buf, 0, UT_CHUNK_BLOCKS, seed);
+
+	return ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_WRITE, buf, lchunk * UT_CHUNK_BLOCKS,
+		     UT_CHUNK_BLOCKS);
+}
+
+/* Check that a whole chunk reads back as filled with the seed. */
+static bool
+ut_check_chunk(struct vbdev_dedup *dedup, uint64_t lchunk, uint8_t seed)
+{
+	uint8_t buf[UT_CHUNK_SIZE], expected[UT_CHUNK_SIZE];
+
+	ut_fill(expected, 0, UT_CHUNK_BLOCKS, seed);
+	memset(buf, 0xff, sizeof(buf));
+	if (ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_READ, buf, lchunk * UT_CHUNK_BLOCKS,
+		  UT_CHUNK_BLOCKS) != 0) {
+		return false;
+	}
+
+	return memcmp(buf, expected, sizeof(buf)) == 0;
+}
+
+static uint64_t
+ut_used_chunks(struct vbdev_dedup *dedup)
+{
+	return dedup->geo.num_pchunks - dedup->num_free;
+}
+
+static uint32_t
+ut_refcnt(struct vbdev_dedup *dedup, uint64_t lchunk)
+{
+	uint32_t ref = dedup->map[lchunk];
+
+	return ref == 0 ? 0 : dedup->pchunks[ref - 1].refcnt;
+}
+
+static void
+test_fingerprint(void)
+{
+	uint8_t buf[UT_CHUNK_SIZE];
+	struct iovec iovs[3];
+	struct dedup_fp fp, fp_split, fp_other;
+	uint32_t lanes[DEDUP_FP_LANES];
+	uint64_t word;
+	size_t i;
+
+	for (i = 0; i < sizeof(buf); i++) {
+		buf[i] = (uint8_t)(rand() >> 7);
+	}
+
+	iovs[0].iov_base = buf;
+	iovs[0].iov_len = sizeof(buf);
+	dedup_fingerprint(iovs, 1, sizeof(buf), &fp);
+
+	/* Each lane is a plain CRC32C of every fourth 64-bit word. */
+	memcpy(lanes, g_fp_seeds, sizeof(lanes));
+	for (i = 0; i < sizeof(buf) / sizeof(word); i++) {
+		memcpy(&word, buf + i * sizeof(word), sizeof(word));
+		lanes[i % DEDUP_FP_LANES] = spdk_crc32c_update(&word, sizeof(word),
+					    lanes[i % DEDUP_FP_LANES]);
+	}
+	CU_ASSERT(memcmp(lanes, fp.lane, sizeof(lanes)) == 0);
+
+	/* Splitting the data doesn't change the fingerprint. */
+	iovs[0].iov_len = 512;
+	iovs[1].iov_base = buf + 512;
+	iovs[1].iov_len = 1024;
+	iovs[2].iov_base = buf + 1536;
+	iovs[2].iov_len = sizeof(buf) - 1536;
+	dedup_fingerprint(iovs, 3, sizeof(buf), &fp_split);
+	CU_ASSERT(dedup_fp_equal(&fp, &fp_split));
+
+	/* Neither does data past the length. */
+	iovs[2].iov_len += 512;
+	dedup_fingerprint(iovs, 3, sizeof(buf), &fp_split);
+	CU_ASSERT(dedup_fp_equal(&fp, &fp_split));
+
+	/* Any change of a word shows up. */
+	buf[sizeof(buf) - 1] ^= 1;
+	iovs[0].iov_base = buf;
+	iovs[0].iov_len = sizeof(buf);
+	dedup_fingerprint(iovs, 1, sizeof(buf), &fp_other);
+	CU_ASSERT(!dedup_fp_equal(&fp, &fp_other));
+	CU_ASSERT(memcmp(fp.lane, fp_other.lane, 3 * sizeof(uint32_t)) == 0);
+}
+
+static void
+test_geometry(void)
+{
+	struct dedup_geometry geo;
+	int rc;
+
+	/* 1 block of map, 4 of fingerprints, data aligned to a chunk */
+	rc = dedup_compute_geometry(UT_BASE_BLOCKS, UT_BLOCK_SIZE, UT_CHUNK_BLOCKS, 0, &geo);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(geo.map_offset == 1);
+	CU_ASSERT(geo.map_blocks == 1);
+	CU_ASSERT(geo.fp_offset == 2);
+	CU_ASSERT(geo.fp_blocks == 4);
+	CU_ASSERT(geo.data_offset == 8);
+	CU_ASSERT(geo.num_pchunks == 127);
+	CU_ASSERT(geo.num_lchunks == 127);
+	CU_ASSERT(geo.data_offset + geo.num_pchunks * UT_CHUNK_BLOCKS <= UT_BASE_BLOCKS);
+
+	/* A larger logical size takes more map blocks */
+	rc = dedup_compute_geometry(UT_BASE_BLOCKS, UT_BLOCK_SIZE, UT_CHUNK_BLOCKS, 1000, &geo);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(geo.num_lchunks == 1000);
+	CU_ASSERT(geo.map_blocks == 8);
+	CU_ASSERT(geo.fp_offset == 9);
+	CU_ASSERT(geo.data_offset == 16);
+	CU_ASSERT(geo.num_pchunks == 126);
+
+	/* Too small for a single chunk */
+	rc = dedup_compute_geometry(8, UT_BLOCK_SIZE, UT_CHUNK_BLOCKS, 0, &geo);
+	CU_ASSERT(rc == -ENOSPC);
+	rc = dedup_compute_geometry(UT_BASE_BLOCKS, UT_BLOCK_SIZE, UT_CHUNK_BLOCKS, 1000000, &geo);
+	CU_ASSERT(rc == -ENOSPC);
+}
+
+static void
+test_dedup(void)
+{
+	struct vbdev_dedup *dedup;
+	int rc;
+
+	ut_setup();
+	dedup = ut_dedup_create(0, true);
+	CU_ASSERT(dedup->bdev.blockcnt == 127 * UT_CHUNK_BLOCKS);
+	CU_ASSERT(dedup->bdev.optimal_io_boundary == UT_CHUNK_BLOCKS);
+	CU_ASSERT(ut_used_chunks(dedup) == 0);
+
+	/* The same data written twice takes one chunk. */
+	rc = ut_write_chunk(dedup, 0, 0x10);
+	CU_ASSERT(rc == 0);
+	rc = ut_write_chunk(dedup, 1, 0x10);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->map[0] != 0);
+	CU_ASSERT(dedup->map[0] == dedup->map[1]);
+	CU_ASSERT(ut_refcnt(dedup, 0) == 2);
+	CU_ASSERT(ut_used_chunks(dedup) == 1);
+	CU_ASSERT(dedup->mapped_chunks == 2);
+	CU_ASSERT(dedup->stats.dedup_hits == 1);
+	CU_ASSERT(dedup->stats.chunk_writes == 1);
+	CU_ASSERT(ut_check_chunk(dedup, 0, 0x10));
+	CU_ASSERT(ut_check_chunk(dedup, 1, 0x10));
+
+	/* The map is on the base bdev. */
+	CU_ASSERT(((uint32_t *)(g_base.data + UT_BLOCK_SIZE))[0] == dedup->map[0]);
+	CU_ASSERT(((uint32_t *)(g_base.data + UT_BLOCK_SIZE))[1] == dedup->map[0]);
+
+	/* Writing the same data again changes nothing. */
+	rc = ut_write_chunk(dedup, 1, 0x10);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(ut_refcnt(dedup, 0) == 2);
+	CU_ASSERT(ut_used_chunks(dedup) == 1);
+
+	/* Overwriting one of them leaves the other alone. */
+	rc = ut_write_chunk(dedup, 1, 0x20);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->map[0] != dedup->map[1]);
+	CU_ASSERT(ut_refcnt(dedup, 0) == 1);
+	CU_ASSERT(ut_refcnt(dedup, 1) == 1);
+	CU_ASSERT(ut_used_chunks(dedup) == 2);
+	CU_ASSERT(ut_check_chunk(dedup, 0, 0x10));
+	CU_ASSERT(ut_check_chunk(dedup, 1, 0x20));
+
+	/* Overwriting the last reference frees the chunk. */
+	rc = ut_write_chunk(dedup, 0, 0x20);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->map[0] == dedup->map[1]);
+	CU_ASSERT(ut_refcnt(dedup, 0) == 2);
+	CU_ASSERT(ut_used_chunks(dedup) == 1);
+	CU_ASSERT(dedup->stats.dedup_hits == 3);
+	CU_ASSERT(ut_check_chunk(dedup, 0, 0x20));
+
+	ut_delete(&dedup->bdev);
+	ut_teardown();
+}
+
+static void
+test_zeroes(void)
+{
+	struct vbdev_dedup *dedup;
+	uint8_t buf[UT_CHUNK_SIZE];
+	int rc;
+
+	ut_setup();
+	dedup = ut_dedup_create(0, true);
+
+	/* Unwritten chunks read as zeroes. */
+	memset(buf, 0xff, sizeof(buf));
+	rc = ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_READ, buf, 5 * UT_CHUNK_BLOCKS, 2);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(spdk_mem_all_zero(buf, 2 * UT_BLOCK_SIZE));
+
+	/* A chunk of zeroes takes no space. */
+	memset(buf, 0, sizeof(buf));
+	rc = ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_WRITE, buf, 0, UT_CHUNK_BLOCKS);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->map[0] == 0);
+	CU_ASSERT(dedup->stats.zero_chunks == 1);
+	CU_ASSERT(ut_used_chunks(dedup) == 0);
+
+	/* Writing zeroes over data frees the chunk. */
+	rc = ut_write_chunk(dedup, 1, 0x30);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(ut_used_chunks(dedup) == 1);
+	rc = ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_WRITE, buf, UT_CHUNK_BLOCKS, UT_CHUNK_BLOCKS);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->map[1] == 0);
+	CU_ASSERT(ut_used_chunks(dedup) == 0);
+	CU_ASSERT(dedup->mapped_chunks == 0);
+
+	/*
+	 * Unmap of chunks 2 and 3 and the first half of chunk 4. The unmapped chunks are
+	 * freed, the rest of chunk 4 is kept in a new chunk.
+	 */
+	rc = ut_write_chunk(dedup, 2, 0x40);
+	CU_ASSERT(rc == 0);
+	rc = ut_write_chunk(dedup, 3, 0x50);
+	CU_ASSERT(rc == 0);
+	rc = ut_write_chunk(dedup, 4, 0x60);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(ut_used_chunks(dedup) == 3);
+	rc = ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_UNMAP, NULL, 2 * UT_CHUNK_BLOCKS,
+		   2 * UT_CHUNK_BLOCKS + UT_CHUNK_BLOCKS / 2);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->map[2] == 0);
+	CU_ASSERT(dedup->map[3] == 0);
+	CU_ASSERT(dedup->map[4] != 0);
+	CU_ASSERT(ut_used_chunks(dedup) == 1);
+	CU_ASSERT(dedup->stats.merges == 1);
+	memset(buf, 0xff, sizeof(buf));
+	rc = ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_READ, buf, 4 * UT_CHUNK_BLOCKS, UT_CHUNK_BLOCKS);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(spdk_mem_all_zero(buf, UT_CHUNK_SIZE / 2));
+	CU_ASSERT(buf[UT_CHUNK_SIZE / 2] == 0x60 + UT_CHUNK_BLOCKS / 2);
+	CU_ASSERT(buf[UT_CHUNK_SIZE - 1] == 0x60 + UT_CHUNK_BLOCKS - 1);
+
+	/* Write zeroes of the rest frees the last chunk. */
+	rc = ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_WRITE_ZEROES, NULL,
+		   4 * UT_CHUNK_BLOCKS + UT_CHUNK_BLOCKS / 2, UT_CHUNK_BLOCKS / 2);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->map[4] == 0);
+	CU_ASSERT(ut_used_chunks(dedup) == 0);
+
+	ut_delete(&dedup->bdev);
+	ut_teardown();
+}
+
+static void
+test_partial_write(void)
+{
+	struct vbdev_dedup *dedup;
+	uint8_t buf[UT_CHUNK_SIZE];
+	uint32_t shared;
+	int rc;
+
+	ut_setup();
+	dedup = ut_dedup_create(0, true);
+
+	/* A partial write of an unwritten chunk fills the rest with zeroes. */
+	ut_fill(buf, 0, 2, 0x70);
+	rc = ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_WRITE, buf, 3, 2);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(ut_used_chunks(dedup) == 1);
+	memset(buf, 0xff, sizeof(buf));
+	rc = ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_READ, buf, 0, UT_CHUNK_BLOCKS);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(spdk_mem_all_zero(buf, 3 * UT_BLOCK_SIZE));
+	CU_ASSERT(buf[3 * UT_BLOCK_SIZE] == 0x70);
+	CU_ASSERT(buf[5 * UT_BLOCK_SIZE - 1] == 0x71);
+	CU_ASSERT(spdk_mem_all_zero(buf + 5 * UT_BLOCK_SIZE, 3 * UT_BLOCK_SIZE));
+
+	/* A partial write of a shared chunk moves only that logical chunk. */
+	rc = ut_write_chunk(dedup, 1, 0x80);
+	CU_ASSERT(rc == 0);
+	rc = ut_write_chunk(dedup, 2, 0x80);
+	CU_ASSERT(rc == 0);
+	shared = dedup->map[1];
+	CU_ASSERT(dedup->map[2] == shared);
+	ut_fill(buf, 0, 1, 0x01);
+	rc = ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_WRITE, buf, 2 * UT_CHUNK_BLOCKS + 7, 1);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->map[1] == shared);
+	CU_ASSERT(dedup->map[2] != shared);
+	CU_ASSERT(ut_check_chunk(dedup, 1, 0x80));
+	memset(buf, 0xff, sizeof(buf));
+	rc = ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_READ, buf, 2 * UT_CHUNK_BLOCKS + 6, 2);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(buf[0] == 0x80 + 6);
+	CU_ASSERT(buf[UT_BLOCK_SIZE] == 0x01);
+
+	/* Changing it back to the shared content maps it to the shared chunk again. */
+	ut_fill(buf, 0, 1, 0x80 + 7);
+	rc = ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_WRITE, buf, 2 * UT_CHUNK_BLOCKS + 7, 1);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->map[2] == shared);
+	CU_ASSERT(ut_refcnt(dedup, 1) == 2);
+	CU_ASSERT(ut_used_chunks(dedup) == 2);
+
+	ut_delete(&dedup->bdev);
+	ut_teardown();
+}
+
+static void
+test_collision(void)
+{
+	struct vbdev_dedup *dedup;
+	uint8_t buf[UT_CHUNK_SIZE];
+	struct iovec iov = { .iov_base = buf, .iov_len = sizeof(buf) };
+	struct dedup_fp fp;
+	uint32_t pchunk;
+	int rc;
+
+	ut_setup();
+	dedup = ut_dedup_create(0, true);
+
+	rc = ut_write_chunk(dedup, 0, 0x10);
+	CU_ASSERT(rc == 0);
+	pchunk = dedup->map[0] - 1;
+
+	/* Make the chunk look like it holds the data written next. */
+	ut_fill(buf, 0, UT_CHUNK_BLOCKS, 0x20);
+	dedup_fingerprint(&iov, 1, sizeof(buf), &fp);
+	dedup_index_remove(dedup, pchunk);
+	dedup->pchunks[pchunk].fp = fp;
+	dedup_index_insert(dedup, pchunk);
+
+	/* The data is compared, so the write still gets a chunk of its own. */
+	rc = ut_write_chunk(dedup, 1, 0x20);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->stats.fp_mismatches == 1);
+	CU_ASSERT(dedup->stats.dedup_hits == 0);
+	CU_ASSERT(dedup->map[1] != dedup->map[0]);
+	CU_ASSERT(ut_refcnt(dedup, 0) == 1);
+	CU_ASSERT(ut_refcnt(dedup, 1) == 1);
+	CU_ASSERT(ut_check_chunk(dedup, 0, 0x10));
+	CU_ASSERT(ut_check_chunk(dedup, 1, 0x20));
+
+	/* Both chunks are indexed with that fingerprint, the newer one is found first. */
+	rc = ut_write_chunk(dedup, 2, 0x20);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->map[2] == dedup->map[1]);
+
+	ut_delete(&dedup->bdev);
+	ut_teardown();
+}
+
+static void
+test_no_space(void)
+{
+	struct vbdev_dedup *dedup;
+	uint64_t i;
+	int rc;
+
+	ut_setup();
+
+	/* Twice as many logical chunks as physical ones */
+	dedup = ut_dedup_create(252, true);
+	CU_ASSERT(dedup->geo.num_pchunks == 127);
+	CU_ASSERT(dedup->bdev.blockcnt == 252 * UT_CHUNK_BLOCKS);
+
+	for (i = 0; i < 252; i++) {
+		rc = ut_write_chunk(dedup, i, (uint8_t)(i % 32) * 8);
+		CU_ASSERT(rc == 0);
+	}
+	CU_ASSERT(ut_used_chunks(dedup) == 32);
+	CU_ASSERT(dedup->mapped_chunks == 252);
+
+	/* Unique data fails once the physical chunks run out, the old data stays. */
+	for (i = 0; i < 126; i++) {
+		rc = ut_write_chunk(dedup, i, (uint8_t)i * 2 + 1);
+		if (rc != 0) {
+			break;
+		}
+	}
+	CU_ASSERT(rc == -EIO);
+	CU_ASSERT(i == 127 - 32);
+	CU_ASSERT(dedup->stats.no_space == 1);
+	CU_ASSERT(dedup->num_free == 0);
+	CU_ASSERT(ut_check_chunk(dedup, i, (uint8_t)(i % 32) * 8));
+
+	/* Freeing a chunk makes room again. */
+	rc = ut_io(&dedup->bdev, SPDK_BDEV_IO_TYPE_UNMAP, NULL, 0, UT_CHUNK_BLOCKS);
+	CU_ASSERT(rc == 0);
+	rc = ut_write_chunk(dedup, i, (uint8_t)i * 2 + 1);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(ut_check_chunk(dedup, i, (uint8_t)i * 2 + 1));
+
+	ut_delete(&dedup->bdev);
+
+	/* A dedup bdev is not created on a base bdev that is too small. */
+	g_base.bdev.blockcnt = UT_CHUNK_BLOCKS;
+	CU_ASSERT(ut_dedup_try_create(0, true) == -ENOSPC);
+	CU_ASSERT(g_created == NULL);
+	g_base.bdev.blockcnt = UT_BASE_BLOCKS;
+
+	ut_teardown();
+}
+
+static void
+test_concurrent(void)
+{
+	struct vbdev_dedup *dedup;
+	struct spdk_bdev_io *bdev_io[4];
+	uint8_t *bufs[4];
+	uint64_t num_blocks = 2 * DEDUP_OPS * UT_CHUNK_BLOCKS;
+	int i, rc;
+
+	ut_setup();
+	dedup = ut_dedup_create(2 * DEDUP_OPS + 1, true);
+
+	for (i = 0; i < 4; i++) {
+		bufs[i] = calloc(1, UT_CHUNK_SIZE);
+		SPDK_CU_ASSERT_FATAL(bufs[i] != NULL);
+		ut_fill(bufs[i], 0, UT_CHUNK_BLOCKS, 0x10 * (i + 1));
+	}
+
+	/* Writes of the same chunk from another thread complete in order. */
+	g_io_done = 0;
+	g_io_status = SPDK_BDEV_IO_STATUS_PENDING;
+	bdev_io[0] = ut_submit(&dedup->bdev, 1, SPDK_BDEV_IO_TYPE_WRITE, bufs[0], 0,
+			       UT_CHUNK_BLOCKS);
+	bdev_io[1] = ut_submit(&dedup->bdev, 1, SPDK_BDEV_IO_TYPE_WRITE, bufs[1], 0,
+			       UT_CHUNK_BLOCKS);
+	bdev_io[2] = ut_submit(&dedup->bdev, 1, SPDK_BDEV_IO_TYPE_WRITE, bufs[0], 0,
+			       UT_CHUNK_BLOCKS);
+	bdev_io[3] = ut_submit(&dedup->bdev, 1, SPDK_BDEV_IO_TYPE_WRITE, bufs[2], UT_CHUNK_BLOCKS,
+			       UT_CHUNK_BLOCKS);
+	ut_drain();
+	CU_ASSERT(g_io_done == 4);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(g_complete_thread == g_ut_threads[1].thread);
+	CU_ASSERT(ut_check_chunk(dedup, 0, 0x10));
+	CU_ASSERT(ut_check_chunk(dedup, 1, 0x30));
+	CU_ASSERT(ut_used_chunks(dedup) == 2);
+	CU_ASSERT(dedup->stats.chunk_writes == 4);
+	for (i = 0; i < 4; i++) {
+		free(bdev_io[i]);
+	}
+
+	/* Unmap of more chunks than there are ops, next to another write. */
+	for (i = 0; i < 2 * DEDUP_OPS + 1; i++) {
+		rc = ut_write_chunk(dedup, i, 0x40);
+		CU_ASSERT(rc == 0);
+	}
+	CU_ASSERT(ut_used_chunks(dedup) == 1);
+	g_io_done = 0;
+	bdev_io[0] = ut_submit(&dedup->bdev, 0, SPDK_BDEV_IO_TYPE_UNMAP, NULL, UT_CHUNK_BLOCKS,
+			       num_blocks);
+	CU_ASSERT(TAILQ_EMPTY(&dedup->free_ops));
+	CU_ASSERT(!TAILQ_EMPTY(&dedup->op_waiters));
+	bdev_io[1] = ut_submit(&dedup->bdev, 0, SPDK_BDEV_IO_TYPE_WRITE, bufs[3], 0,
+			       UT_CHUNK_BLOCKS);
+	ut_drain();
+	CU_ASSERT(g_io_done == 2);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(TAILQ_EMPTY(&dedup->op_waiters));
+	CU_ASSERT(TAILQ_EMPTY(&dedup->active_ops));
+	CU_ASSERT(dedup->mapped_chunks == 1);
+	CU_ASSERT(ut_check_chunk(dedup, 0, 0x40));
+	CU_ASSERT(ut_used_chunks(dedup) == 1);
+	free(bdev_io[0]);
+	free(bdev_io[1]);
+
+	/* Unmap of unwritten chunks completes inline. */
+	g_io_done = 0;
+	bdev_io[0] = ut_submit(&dedup->bdev, 0, SPDK_BDEV_IO_TYPE_UNMAP, NULL, UT_CHUNK_BLOCKS,
+			       num_blocks);
+	CU_ASSERT(g_io_done == 1);
+	free(bdev_io[0]);
+
+	ut_delete(&dedup->bdev);
+	for (i = 0; i < 4; i++) {
+		free(bufs[i]);
+	}
+	ut_teardown();
+}
+
+static void
+test_reload(void)
+{
+	struct vbdev_dedup *dedup;
+	struct spdk_uuid uuid;
+	uint32_t map0, map2;
+	int rc;
+
+	ut_setup();
+	dedup = ut_dedup_create(0, true);
+	rc = ut_write_chunk(dedup, 0, 0x10);
+	CU_ASSERT(rc == 0);
+	rc = ut_write_chunk(dedup, 1, 0x10);
+	CU_ASSERT(rc == 0);
+	rc = ut_write_chunk(dedup, 2, 0x20);
+	CU_ASSERT(rc == 0);
+	map0 = dedup->map[0];
+	map2 = dedup->map[2];
+	spdk_uuid_copy(&uuid, &dedup->bdev.uuid);
+	ut_delete(&dedup->bdev);
+
+	/* The map comes back and the reference counts are rebuilt from it. */
+	dedup = ut_dedup_create(0, false);
+	CU_ASSERT(spdk_uuid_compare(&uuid, &dedup->bdev.uuid) == 0);
+	CU_ASSERT(dedup->map[0] == map0);
+	CU_ASSERT(dedup->map[1] == map0);
+	CU_ASSERT(dedup->map[2] == map2);
+	CU_ASSERT(ut_refcnt(dedup, 0) == 2);
+	CU_ASSERT(ut_refcnt(dedup, 2) == 1);
+	CU_ASSERT(ut_used_chunks(dedup) == 2);
+	CU_ASSERT(dedup->mapped_chunks == 3);
+	CU_ASSERT(ut_check_chunk(dedup, 1, 0x10));
+	CU_ASSERT(ut_check_chunk(dedup, 2, 0x20));
+
+	/* So do the fingerprints. */
+	rc = ut_write_chunk(dedup, 3, 0x20);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->map[3] == map2);
+	CU_ASSERT(dedup->stats.dedup_hits == 1);
+
+	/* Freed chunks are reused. */
+	rc = ut_write_chunk(dedup, 0, 0x30);
+	CU_ASSERT(rc == 0);
+	rc = ut_write_chunk(dedup, 1, 0x30);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(dedup->map[0] == dedup->map[1]);
+	CU_ASSERT(ut_used_chunks(dedup) == 2);
+	ut_delete(&dedup->bdev);
+
+	/* Another geometry is refused without format. */
+	CU_ASSERT(ut_dedup_try_create(64, false) == -EINVAL);
+	CU_ASSERT(g_created == NULL);
+
+	/* A corrupted map entry is detected. */
+	((uint32_t *)(g_base.data + UT_BLOCK_SIZE))[5] = 1000;
+	CU_ASSERT(ut_dedup_try_create(0, false) == -EILSEQ);
+	CU_ASSERT(g_created == NULL);
+
+	/* Format starts over. */
+	dedup = ut_dedup_create(64, true);
+	CU_ASSERT(spdk_uuid_compare(&uuid, &dedup->bdev.uuid) != 0);
+	CU_ASSERT(dedup->mapped_chunks == 0);
+	CU_ASSERT(ut_used_chunks(dedup) == 0);
+	CU_ASSERT(ut_check_chunk(dedup, 0, 0x30) == false);
+	ut_delete(&dedup->bdev);
+
+	ut_teardown();
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("dedup", NULL, NULL);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (
+		CU_add_test(suite, "test_fingerprint", test_fingerprint) == NULL ||
+		CU_add_test(suite, "test_geometry", test_geometry) == NULL ||
+		CU_add_test(suite, "test_dedup", test_dedup) == NULL ||
+		CU_add_test(suite, "test_zeroes", test_zeroes) == NULL ||
+		CU_add_test(suite, "test_partial_write", test_partial_write) == NULL ||
+		CU_add_test(suite, "test_collision", test_collision) == NULL ||
+		CU_add_test(suite, "test_no_space", test_no_space) == NULL ||
+		CU_add_test(suite, "test_concurrent", test_concurrent) == NULL ||
+		CU_add_test(suite, "test_reload", test_reload) == NULL
+	) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+	return num_failures;
+}
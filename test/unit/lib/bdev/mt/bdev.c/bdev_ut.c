@@ -1400,6 +1400,254 @@ qos_dynamic_enable(void)
 	teardown_test();
 }
 
+static void
+qos_latency_target(void)
+{
+	struct spdk_io_channel *io_ch;
+	struct spdk_bdev_channel *bdev_ch;
+	struct spdk_bdev_desc *desc_low = NULL;
+	struct spdk_bdev_qos *qos;
+	struct spdk_bdev_qos_latency_stat stat;
+	struct spdk_bdev *bdev;
+	enum spdk_bdev_io_status status[10];
+	int i, rc, status_cb;
+
+	setup_test();
+	set_thread(0);
+	bdev = &g_bdev.bdev;
+
+	rc = spdk_bdev_open(bdev, true, NULL, NULL, &desc_low);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(desc_low != NULL);
+	CU_ASSERT(spdk_bdev_desc_get_qos_priority(desc_low) == SPDK_BDEV_QOS_PRIORITY_HIGH);
+	rc = spdk_bdev_set_qos_priority_by_desc_id(bdev, desc_low->id, SPDK_BDEV_QOS_PRIORITY_LOW);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(spdk_bdev_desc_get_qos_priority(desc_low) == SPDK_BDEV_QOS_PRIORITY_LOW);
+	CU_ASSERT(spdk_bdev_desc_get_qos_priority(g_desc) == SPDK_BDEV_QOS_PRIORITY_HIGH);
+	rc = spdk_bdev_set_qos_priority_by_desc_id(bdev, desc_low->id + 1, SPDK_BDEV_QOS_PRIORITY_LOW);
+	CU_ASSERT(rc == -ENOENT);
+
+	io_ch = spdk_bdev_get_io_channel(g_desc);
+	bdev_ch = spdk_io_channel_get_ctx(io_ch);
+
+	/* Setting a latency target enables QoS */
+	status_cb = 1;
+	spdk_bdev_set_qos_latency_target(bdev, 100, qos_dynamic_enable_done, &status_cb);
+	poll_threads();
+	CU_ASSERT(status_cb == 0);
+	CU_ASSERT((bdev_ch->flags & BDEV_CH_QOS_ENABLED) != 0);
+	qos = bdev->internal.qos;
+	SPDK_CU_ASSERT_FATAL(qos != NULL);
+	CU_ASSERT(qos->ch == bdev_ch);
+
+	/* The first timeslice starts the latency measurement */
+	spdk_delay_us(SPDK_BDEV_QOS_TIMESLICE_IN_USEC);
+	poll_threads();
+	SPDK_CU_ASSERT_FATAL(qos->latency.histogram != NULL);
+
+	/* Low priority I/O is not throttled until the target is missed */
+	for (i = 0; i < 10; i++) {
+		status[i] = SPDK_BDEV_IO_STATUS_PENDING;
+		rc = spdk_bdev_read_blocks(desc_low, io_ch, NULL, 0, 1, io_during_io_done, &status[i]);
+		CU_ASSERT(rc == 0);
+	}
+	poll_threads();
+	CU_ASSERT(stub_complete_io(g_bdev.io_target, 0) == 10);
+	poll_threads();
+
+	/* High priority I/O taking 1ms misses the 100us target */
+	for (i = 0; i < 4; i++) {
+		status[i] = SPDK_BDEV_IO_STATUS_PENDING;
+		rc = spdk_bdev_read_blocks(g_desc, io_ch, NULL, 0, 1, io_during_io_done, &status[i]);
+		CU_ASSERT(rc == 0);
+	}
+	poll_threads();
+	spdk_delay_us(1000);
+	CU_ASSERT(stub_complete_io(g_bdev.io_target, 0) == 4);
+	poll_threads();
+	CU_ASSERT(qos->latency.limit == 0);
+
+	spdk_delay_us(SPDK_BDEV_QOS_LATENCY_WINDOW_IN_USEC);
+	poll_threads();
+	CU_ASSERT(qos->latency.limit == SPDK_BDEV_QOS_MIN_IOS_PER_SEC);
+	CU_ASSERT(qos->latency.max_per_timeslice == 1);
+
+	spdk_bdev_get_qos_latency_stat(bdev, &stat);
+	CU_ASSERT(stat.latency_target_usec == 100);
+	CU_ASSERT(stat.p99_latency_usec >= 1000);
+	CU_ASSERT(stat.low_priority_ios_per_sec == SPDK_BDEV_QOS_MIN_IOS_PER_SEC);
+	CU_ASSERT(stat.windows == 1);
+	CU_ASSERT(stat.violations == 1);
+
+	/* Now only one low priority I/O goes out per timeslice, while high priority I/O is not held */
+	for (i = 0; i < 3; i++) {
+		status[i] = SPDK_BDEV_IO_STATUS_PENDING;
+		rc = spdk_bdev_read_blocks(desc_low, io_ch, NULL, 0, 1, io_during_io_done, &status[i]);
+		CU_ASSERT(rc == 0);
+	}
+	status[3] = SPDK_BDEV_IO_STATUS_PENDING;
+	rc = spdk_bdev_read_blocks(g_desc, io_ch, NULL, 0, 1, io_during_io_done, &status[3]);
+	CU_ASSERT(rc == 0);
+	poll_threads();
+	CU_ASSERT(bdev_io_tailq_cnt(&qos->latency.queued) == 2);
+	CU_ASSERT(stub_complete_io(g_bdev.io_target, 0) == 2);
+	poll_threads();
+	CU_ASSERT(status[0] == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(status[1] == SPDK_BDEV_IO_STATUS_PENDING);
+	CU_ASSERT(status[3] == SPDK_BDEV_IO_STATUS_SUCCESS);
+
+	for (i = 0; i < 2; i++) {
+		spdk_delay_us(SPDK_BDEV_QOS_TIMESLICE_IN_USEC);
+		poll_threads();
+		CU_ASSERT(stub_complete_io(g_bdev.io_target, 0) == 1);
+		poll_threads();
+	}
+	CU_ASSERT(status[2] == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(TAILQ_EMPTY(&qos->latency.queued));
+
+	/* Once the target is met and low priority I/O slows down, the throttle is lifted */
+	spdk_delay_us(SPDK_BDEV_QOS_LATENCY_WINDOW_IN_USEC);
+	poll_threads();
+	CU_ASSERT(qos->latency.limit == 0);
+	spdk_bdev_get_qos_latency_stat(bdev, &stat);
+	CU_ASSERT(stat.windows == 2);
+	CU_ASSERT(stat.violations == 1);
+	CU_ASSERT(stat.low_priority_ios_per_sec == 0);
+
+	/* Removing the target with no rate limits set disables QoS */
+	status_cb = 1;
+	spdk_bdev_set_qos_latency_target(bdev, 0, qos_dynamic_enable_done, &status_cb);
+	poll_threads();
+	CU_ASSERT(status_cb == 0);
+	CU_ASSERT((bdev_ch->flags & BDEV_CH_QOS_ENABLED) == 0);
+	CU_ASSERT(bdev->internal.qos == NULL);
+
+	spdk_put_io_channel(io_ch);
+	spdk_bdev_close(desc_low);
+	poll_threads();
+
+	teardown_test();
+}
+
+static void
+qos_distributed(void)
+{
+	struct spdk_io_channel *io_ch[2];
+	struct spdk_bdev_channel *bdev_ch[2];
+	struct spdk_bdev *bdev;
+	enum spdk_bdev_io_status status[4], other_status[3];
+	uint64_t limits[SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES];
+	int i, rc, status_cb;
+
+	setup_test();
+	MOCK_SET(spdk_get_ticks, 0);
+	g_bdev_opts.qos_distributed = true;
+
+	bdev = &g_bdev.bdev;
+	g_get_io_channel = true;
+
+	set_thread(0);
+	io_ch[0] = spdk_bdev_get_io_channel(g_desc);
+	bdev_ch[0] = spdk_io_channel_get_ctx(io_ch[0]);
+	set_thread(1);
+	io_ch[1] = spdk_bdev_get_io_channel(g_desc);
+	bdev_ch[1] = spdk_io_channel_get_ctx(io_ch[1]);
+
+	/* 4000 read/write I/O per second, or 4 per millisecond */
+	for (i = 0; i < SPDK_BDEV_QOS_NUM_RATE_LIMIT_TYPES; i++) {
+		limits[i] = UINT64_MAX;
+	}
+	limits[SPDK_BDEV_QOS_RW_IOPS_RATE_LIMIT] = 4000;
+	set_thread(0);
+	status_cb = 1;
+	spdk_bdev_set_qos_rate_limits(bdev, limits, qos_dynamic_enable_done, &status_cb);
+	poll_threads();
+	CU_ASSERT(status_cb == 0);
+	CU_ASSERT(bdev_ch[0]->flags == BDEV_CH_QOS_DISTRIBUTED);
+	CU_ASSERT(bdev_ch[1]->flags == BDEV_CH_QOS_DISTRIBUTED);
+	SPDK_CU_ASSERT_FATAL(bdev->internal.qos != NULL);
+	CU_ASSERT(bdev->internal.qos->distributed == true);
+
+	/* The latency target needs funneled QoS */
+	status_cb = 1;
+	spdk_bdev_set_qos_latency_target(bdev, 100, qos_dynamic_enable_done, &status_cb);
+	poll_threads();
+	CU_ASSERT(status_cb == -ENOTSUP);
+
+	/*
+	 * Each channel issues its I/O on its own thread. Thread 1 takes three of the
+	 *  four I/O allowed in this timeslice, so only one of thread 0's goes out.
+	 */
+	set_thread(1);
+	for (i = 0; i < 3; i++) {
+		other_status[i] = SPDK_BDEV_IO_STATUS_PENDING;
+		rc = spdk_bdev_read_blocks(g_desc, io_ch[1], NULL, 0, 1, io_during_io_done, &other_status[i]);
+		CU_ASSERT(rc == 0);
+	}
+	set_thread(0);
+	for (i = 0; i < 3; i++) {
+		status[i] = SPDK_BDEV_IO_STATUS_PENDING;
+		rc = spdk_bdev_read_blocks(g_desc, io_ch[0], NULL, 0, 1, io_during_io_done, &status[i]);
+		CU_ASSERT(rc == 0);
+	}
+	poll_threads();
+	set_thread(1);
+	CU_ASSERT(stub_complete_io(g_bdev.io_target, 0) == 3);
+	set_thread(0);
+	CU_ASSERT(stub_complete_io(g_bdev.io_target, 0) == 1);
+	poll_threads();
+	CU_ASSERT(other_status[2] == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(status[0] == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(bdev_io_tailq_cnt(&bdev_ch[0]->qos_queued) == 2);
+	CU_ASSERT(bdev_ch[0]->qos_poller != NULL);
+
+	/* The queued I/O goes out once the shared budget is refilled */
+	spdk_delay_us(SPDK_BDEV_QOS_TIMESLICE_IN_USEC);
+	poll_threads();
+	CU_ASSERT(stub_complete_io(g_bdev.io_target, 0) == 2);
+	poll_threads();
+	CU_ASSERT(status[1] == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(status[2] == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(TAILQ_EMPTY(&bdev_ch[0]->qos_queued));
+	CU_ASSERT(bdev_ch[0]->qos_poller == NULL);
+
+	/* Two I/O are left in this timeslice, the others wait on thread 1 */
+	set_thread(1);
+	for (i = 0; i < 4; i++) {
+		status[i] = SPDK_BDEV_IO_STATUS_PENDING;
+		rc = spdk_bdev_read_blocks(g_desc, io_ch[1], NULL, 0, 1, io_during_io_done, &status[i]);
+		CU_ASSERT(rc == 0);
+	}
+	CU_ASSERT(bdev_io_tailq_cnt(&bdev_ch[1]->qos_queued) == 2);
+
+	/* Disabling QoS resubmits the queued I/O on its own channel */
+	set_thread(0);
+	limits[SPDK_BDEV_QOS_RW_IOPS_RATE_LIMIT] = 0;
+	status_cb = 1;
+	spdk_bdev_set_qos_rate_limits(bdev, limits, qos_dynamic_enable_done, &status_cb);
+	poll_threads();
+	CU_ASSERT(status_cb == 0);
+	CU_ASSERT(bdev_ch[0]->flags == 0);
+	CU_ASSERT(bdev_ch[1]->flags == 0);
+	CU_ASSERT(bdev->internal.qos == NULL);
+	set_thread(1);
+	CU_ASSERT(stub_complete_io(g_bdev.io_target, 0) == 4);
+	poll_threads();
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT(status[i] == SPDK_BDEV_IO_STATUS_SUCCESS);
+	}
+	CU_ASSERT(bdev_ch[1]->qos_poller == NULL);
+
+	set_thread(1);
+	spdk_put_io_channel(io_ch[1]);
+	set_thread(0);
+	spdk_put_io_channel(io_ch[0]);
+	poll_threads();
+
+	g_bdev_opts.qos_distributed = false;
+	teardown_test();
+}
+
 static void
 histogram_status_cb(void *cb_arg, int status)
 {
@@ -1541,6 +1789,8 @@ main(int argc, char **argv)
 		CU_add_test(suite, "enomem_multi_bdev", enomem_multi_bdev) == NULL ||
 		CU_add_test(suite, "enomem_multi_io_target", enomem_multi_io_target) == NULL ||
 		CU_add_test(suite, "qos_dynamic_enable", qos_dynamic_enable) == NULL ||
+		CU_add_test(suite, "qos_latency_target", qos_latency_target) == NULL ||
+		CU_add_test(suite, "qos_distributed", qos_distributed) == NULL ||
 		CU_add_test(suite, "bdev_histograms_mt", bdev_histograms_mt) == NULL
 	) {
 		CU_cleanup_registry();
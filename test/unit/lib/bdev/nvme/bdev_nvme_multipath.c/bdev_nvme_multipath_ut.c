@@ -0,0 +1,328 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "spdk_cunit.h"
+
+#include "common/lib/ut_multithread.c"
+
+#include "bdev/nvme/bdev_nvme_multipath.c"
+
+#define UT_NUM_PATHS	3
+
+struct ut_path {
+	struct nvme_bdev_ns	nvme_ns;
+	struct nvme_io_path	io_path;
+	struct nvme_io_channel	*nvme_ch;
+};
+
+static struct nvme_bdev g_nbdev;
+static struct nvme_bdev_channel g_nbdev_ch;
+static struct ut_path g_paths[UT_NUM_PATHS];
+/* Any non-NULL qpair marks a path as connected. */
+static struct spdk_nvme_qpair *g_qpair = (struct spdk_nvme_qpair *)0x1;
+
+static int
+ut_ctrlr_ch_create_cb(void *io_device, void *ctx_buf)
+{
+	struct nvme_io_channel *nvme_ch = ctx_buf;
+
+	nvme_ch->qpair = g_qpair;
+
+	return 0;
+}
+
+static void
+ut_ctrlr_ch_destroy_cb(void *io_device, void *ctx_buf)
+{
+}
+
+static void
+ut_setup(uint32_t num_paths, enum nvme_bdev_mp_policy policy)
+{
+	struct ut_path *path;
+	uint32_t i;
+
+	memset(&g_nbdev, 0, sizeof(g_nbdev));
+	memset(&g_nbdev_ch, 0, sizeof(g_nbdev_ch));
+	memset(g_paths, 0, sizeof(g_paths));
+
+	g_nbdev.mp_policy = policy;
+	TAILQ_INIT(&g_nbdev_ch.io_paths);
+
+	for (i = 0; i < num_paths; i++) {
+		path = &g_paths[i];
+		path->nvme_ns.ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+		path->nvme_ns.bdev = &g_nbdev;
+		spdk_io_device_register(path, ut_ctrlr_ch_create_cb, ut_ctrlr_ch_destroy_cb,
+					sizeof(struct nvme_io_channel), "ut_ctrlr");
+		path->io_path.nvme_ns = &path->nvme_ns;
+		path->io_path.ctrlr_ch = spdk_get_io_channel(path);
+		SPDK_CU_ASSERT_FATAL(path->io_path.ctrlr_ch != NULL);
+		path->nvme_ch = spdk_io_channel_get_ctx(path->io_path.ctrlr_ch);
+		TAILQ_INSERT_TAIL(&g_nbdev_ch.io_paths, &path->io_path, tailq);
+		g_nbdev_ch.num_paths++;
+	}
+}
+
+static void
+ut_teardown(void)
+{
+	struct nvme_io_path *io_path;
+	struct ut_path *path;
+
+	while ((io_path = TAILQ_FIRST(&g_nbdev_ch.io_paths))) {
+		TAILQ_REMOVE(&g_nbdev_ch.io_paths, io_path, tailq);
+		path = SPDK_CONTAINEROF(io_path, struct ut_path, io_path);
+		spdk_put_io_channel(io_path->ctrlr_ch);
+		spdk_io_device_unregister(path, NULL);
+	}
+	poll_threads();
+}
+
+static struct ut_path *
+ut_find(void)
+{
+	struct nvme_io_path *io_path = nvme_bdev_find_io_path(&g_nbdev, &g_nbdev_ch);
+
+	if (io_path == NULL) {
+		return NULL;
+	}
+
+	return SPDK_CONTAINEROF(io_path, struct ut_path, io_path);
+}
+
+static void
+ut_cpl(struct spdk_nvme_cpl *cpl, uint16_t sct, uint16_t sc)
+{
+	memset(cpl, 0, sizeof(*cpl));
+	cpl->status.sct = sct;
+	cpl->status.sc = sc;
+}
+
+static void
+test_round_robin(void)
+{
+	int i;
+
+	/* All paths are optimized, so every one gets its turn. */
+	ut_setup(UT_NUM_PATHS, NVME_BDEV_MP_POLICY_ROUND_ROBIN);
+	for (i = 0; i < 2 * UT_NUM_PATHS; i++) {
+		CU_ASSERT(ut_find() == &g_paths[i % UT_NUM_PATHS]);
+	}
+
+	/* A disconnected path is left out of the rotation. */
+	g_paths[1].nvme_ch->qpair = NULL;
+	CU_ASSERT(ut_find() == &g_paths[0]);
+	CU_ASSERT(ut_find() == &g_paths[2]);
+	CU_ASSERT(ut_find() == &g_paths[0]);
+	ut_teardown();
+
+	/* A single path is used as long as it is connected. */
+	ut_setup(1, NVME_BDEV_MP_POLICY_ROUND_ROBIN);
+	CU_ASSERT(ut_find() == &g_paths[0]);
+	CU_ASSERT(ut_find() == &g_paths[0]);
+	g_paths[0].nvme_ch->qpair = NULL;
+	CU_ASSERT(ut_find() == NULL);
+	ut_teardown();
+}
+
+static void
+test_queue_depth(void)
+{
+	ut_setup(UT_NUM_PATHS, NVME_BDEV_MP_POLICY_QUEUE_DEPTH);
+	g_paths[0].io_path.outstanding = 4;
+	g_paths[1].io_path.outstanding = 1;
+	g_paths[2].io_path.outstanding = 2;
+	CU_ASSERT(ut_find() == &g_paths[1]);
+	CU_ASSERT(ut_find() == &g_paths[1]);
+
+	g_paths[1].io_path.outstanding = 3;
+	CU_ASSERT(ut_find() == &g_paths[2]);
+
+	/* The ANA state goes before the queue depth. */
+	g_paths[2].nvme_ns.ana_state = SPDK_NVME_ANA_NON_OPTIMIZED_STATE;
+	CU_ASSERT(ut_find() == &g_paths[1]);
+	ut_teardown();
+}
+
+static void
+test_non_optimized(void)
+{
+	int i;
+
+	/* The optimized path is used as long as there is one. */
+	ut_setup(UT_NUM_PATHS, NVME_BDEV_MP_POLICY_ROUND_ROBIN);
+	g_paths[0].nvme_ns.ana_state = SPDK_NVME_ANA_NON_OPTIMIZED_STATE;
+	g_paths[2].nvme_ns.ana_state = SPDK_NVME_ANA_NON_OPTIMIZED_STATE;
+	for (i = 0; i < UT_NUM_PATHS; i++) {
+		CU_ASSERT(ut_find() == &g_paths[1]);
+	}
+
+	/* Without one, I/O falls back to the non-optimized paths, in turn. */
+	g_paths[1].nvme_ns.ana_state = SPDK_NVME_ANA_INACCESSIBLE_STATE;
+	CU_ASSERT(ut_find() == &g_paths[2]);
+	CU_ASSERT(ut_find() == &g_paths[0]);
+	CU_ASSERT(ut_find() == &g_paths[2]);
+
+	/* So it does when the optimized path is disconnected. */
+	g_paths[1].nvme_ns.ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	g_paths[1].nvme_ch->qpair = NULL;
+	CU_ASSERT(ut_find() == &g_paths[0]);
+	CU_ASSERT(ut_find() == &g_paths[2]);
+
+	g_paths[1].nvme_ch->qpair = g_qpair;
+	CU_ASSERT(ut_find() == &g_paths[1]);
+	ut_teardown();
+}
+
+static void
+test_skip_unavailable(void)
+{
+	int i;
+
+	/* Inaccessible paths and paths in change are skipped. */
+	ut_setup(UT_NUM_PATHS, NVME_BDEV_MP_POLICY_ROUND_ROBIN);
+	g_paths[0].nvme_ns.ana_state = SPDK_NVME_ANA_INACCESSIBLE_STATE;
+	g_paths[1].nvme_ns.ana_state = SPDK_NVME_ANA_CHANGE_STATE;
+	for (i = 0; i < UT_NUM_PATHS; i++) {
+		CU_ASSERT(ut_find() == &g_paths[2]);
+	}
+
+	/* They are only tried when nothing better is left, paths in change first. */
+	g_paths[2].nvme_ns.ana_state = SPDK_NVME_ANA_PERSISTENT_LOSS_STATE;
+	CU_ASSERT(ut_find() == &g_paths[1]);
+	g_paths[1].nvme_ns.ana_state = SPDK_NVME_ANA_PERSISTENT_LOSS_STATE;
+	CU_ASSERT(ut_find() == &g_paths[0]);
+
+	/* Paths in persistent loss state are never used. */
+	g_paths[0].nvme_ns.ana_state = SPDK_NVME_ANA_PERSISTENT_LOSS_STATE;
+	CU_ASSERT(ut_find() == NULL);
+	CU_ASSERT(g_nbdev_ch.rr_path == NULL);
+	ut_teardown();
+}
+
+static void
+test_failover(void)
+{
+	struct spdk_nvme_cpl cpl;
+	struct ut_path *path;
+
+	ut_setup(2, NVME_BDEV_MP_POLICY_ROUND_ROBIN);
+
+	/* A path error moves the path out of the way and the I/O to the other path. */
+	path = ut_find();
+	CU_ASSERT(path == &g_paths[0]);
+	ut_cpl(&cpl, SPDK_NVME_SCT_PATH, SPDK_NVME_SC_ASYMMETRIC_ACCESS_INACCESSIBLE);
+	CU_ASSERT(nvme_bdev_io_path_failover(&g_nbdev_ch, &path->io_path, &cpl, 0) == true);
+	CU_ASSERT(g_paths[0].nvme_ns.ana_state == SPDK_NVME_ANA_INACCESSIBLE_STATE);
+	CU_ASSERT(ut_find() == &g_paths[1]);
+	CU_ASSERT(ut_find() == &g_paths[1]);
+
+	/* Once every path was tried, the error is returned. */
+	ut_cpl(&cpl, SPDK_NVME_SCT_PATH, SPDK_NVME_SC_ASYMMETRIC_ACCESS_TRANSITION);
+	CU_ASSERT(nvme_bdev_io_path_failover(&g_nbdev_ch, &g_paths[1].io_path, &cpl, 2) == false);
+	CU_ASSERT(g_paths[1].nvme_ns.ana_state == SPDK_NVME_ANA_CHANGE_STATE);
+
+	/* Requests aborted with their qpair are retried, without changing the ANA state. */
+	g_paths[0].nvme_ns.ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	g_paths[1].nvme_ns.ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	ut_cpl(&cpl, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_ABORTED_SQ_DELETION);
+	CU_ASSERT(nvme_bdev_io_path_failover(&g_nbdev_ch, &g_paths[0].io_path, &cpl, 0) == true);
+	CU_ASSERT(g_paths[0].nvme_ns.ana_state == SPDK_NVME_ANA_OPTIMIZED_STATE);
+
+	/* A removed path is left alone, but the request is still retried. */
+	g_paths[0].io_path.removed = true;
+	ut_cpl(&cpl, SPDK_NVME_SCT_PATH, SPDK_NVME_SC_ASYMMETRIC_ACCESS_PERSISTENT_LOSS);
+	CU_ASSERT(nvme_bdev_io_path_failover(&g_nbdev_ch, &g_paths[0].io_path, &cpl, 1) == true);
+	CU_ASSERT(g_paths[0].nvme_ns.ana_state == SPDK_NVME_ANA_OPTIMIZED_STATE);
+	g_paths[0].io_path.removed = false;
+
+	/* Requests failing for another reason, or succeeding, are not. */
+	ut_cpl(&cpl, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_INVALID_FIELD);
+	CU_ASSERT(nvme_bdev_io_path_failover(&g_nbdev_ch, &g_paths[0].io_path, &cpl, 0) == false);
+	ut_cpl(&cpl, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_SUCCESS);
+	CU_ASSERT(nvme_bdev_io_path_failover(&g_nbdev_ch, &g_paths[0].io_path, &cpl, 0) == false);
+
+	/* Without a path, as when none could be found at submission, too. */
+	ut_cpl(&cpl, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_ABORTED_BY_REQUEST);
+	CU_ASSERT(nvme_bdev_io_path_failover(&g_nbdev_ch, NULL, &cpl, 0) == true);
+	ut_teardown();
+
+	/* There is nowhere to go with a single path. */
+	ut_setup(1, NVME_BDEV_MP_POLICY_ROUND_ROBIN);
+	ut_cpl(&cpl, SPDK_NVME_SCT_PATH, SPDK_NVME_SC_ASYMMETRIC_ACCESS_INACCESSIBLE);
+	CU_ASSERT(nvme_bdev_io_path_failover(&g_nbdev_ch, &g_paths[0].io_path, &cpl, 0) == false);
+	CU_ASSERT(g_paths[0].nvme_ns.ana_state == SPDK_NVME_ANA_INACCESSIBLE_STATE);
+	ut_teardown();
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("bdev_nvme_multipath", NULL, NULL);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (
+		CU_add_test(suite, "test_round_robin", test_round_robin) == NULL ||
+		CU_add_test(suite, "test_queue_depth", test_queue_depth) == NULL ||
+		CU_add_test(suite, "test_non_optimized", test_non_optimized) == NULL ||
+		CU_add_test(suite, "test_skip_unavailable", test_skip_unavailable) == NULL ||
+		CU_add_test(suite, "test_failover", test_failover) == NULL
+	) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	allocate_threads(1);
+	set_thread(0);
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+
+	free_threads();
+
+	return num_failures;
+}
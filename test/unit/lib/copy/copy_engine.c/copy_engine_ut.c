@@ -0,0 +1,543 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk_cunit.h"
+
+#include "common/lib/ut_multithread.c"
+#include "unit/lib/json_mock.c"
+
+#include "spdk/crc32.h"
+
+#include "copy/copy_engine.c"
+
+#define UT_BUF_SIZE	4096
+#define UT_MAX_TASKS	8
+
+static struct spdk_io_channel *g_ch;
+static void *g_tasks[UT_MAX_TASKS];
+static int g_task_status[UT_MAX_TASKS];
+static int g_completed[UT_MAX_TASKS];
+static int g_num_completed;
+static int g_batch_status;
+static int g_batch_done;
+static bool g_fini_done;
+
+/* Hardware engine offering only copies and fills, which it queues until flush */
+static void *g_hw_queued[UT_MAX_TASKS];
+static spdk_copy_completion_cb g_hw_queued_cb[UT_MAX_TASKS];
+static int g_hw_num_queued;
+static int g_hw_copies;
+static int g_hw_fills;
+static int g_hw_flushes;
+
+static int
+hw_copy(void *cb_arg, struct spdk_io_channel *ch, void *dst, void *src, uint64_t nbytes,
+	spdk_copy_completion_cb cb)
+{
+	g_hw_copies++;
+	memcpy(dst, src, nbytes);
+	cb(mem_copy_task(cb_arg), 0);
+	return 0;
+}
+
+static int
+hw_fill(void *cb_arg, struct spdk_io_channel *ch, void *dst, uint8_t fill, uint64_t nbytes,
+	spdk_copy_completion_cb cb)
+{
+	g_hw_fills++;
+	memset(dst, fill, nbytes);
+	cb(mem_copy_task(cb_arg), 0);
+	return 0;
+}
+
+static int
+hw_build_copy(void *cb_arg, struct spdk_io_channel *ch, void *dst, void *src, uint64_t nbytes,
+	      spdk_copy_completion_cb cb)
+{
+	SPDK_CU_ASSERT_FATAL(g_hw_num_queued < UT_MAX_TASKS);
+	g_hw_copies++;
+	memcpy(dst, src, nbytes);
+	g_hw_queued[g_hw_num_queued] = cb_arg;
+	g_hw_queued_cb[g_hw_num_queued++] = cb;
+	return 0;
+}
+
+static void
+hw_flush(struct spdk_io_channel *ch)
+{
+	int i, num_queued = g_hw_num_queued;
+
+	g_hw_flushes++;
+	g_hw_num_queued = 0;
+	for (i = 0; i < num_queued; i++) {
+		g_hw_queued_cb[i](mem_copy_task(g_hw_queued[i]), 0);
+	}
+}
+
+static struct spdk_io_channel *hw_get_io_channel(void);
+
+static struct spdk_copy_engine g_hw_engine = {
+	.copy		= hw_copy,
+	.fill		= hw_fill,
+	.build_copy	= hw_build_copy,
+	.flush		= hw_flush,
+	.get_io_channel	= hw_get_io_channel,
+};
+
+static int
+hw_create_cb(void *io_device, void *ctx_buf)
+{
+	return 0;
+}
+
+static void
+hw_destroy_cb(void *io_device, void *ctx_buf)
+{
+}
+
+static struct spdk_io_channel *
+hw_get_io_channel(void)
+{
+	return spdk_get_io_channel(&g_hw_engine);
+}
+
+static void
+task_done(void *ref, int status)
+{
+	int i;
+
+	for (i = 0; i < UT_MAX_TASKS; i++) {
+		if (g_tasks[i] == ref) {
+			g_task_status[i] = status;
+			break;
+		}
+	}
+	SPDK_CU_ASSERT_FATAL(i < UT_MAX_TASKS);
+	g_completed[g_num_completed++] = i;
+}
+
+static void
+batch_done(void *cb_arg, int status)
+{
+	/* All operations complete before the batch */
+	CU_ASSERT(g_num_completed == (int)(uintptr_t)cb_arg);
+	g_batch_status = status;
+	g_batch_done++;
+}
+
+static void
+fini_done(void *cb_arg)
+{
+	g_fini_done = true;
+}
+
+static void
+ut_init(bool hw)
+{
+	int i;
+
+	if (hw) {
+		spdk_io_device_register(&g_hw_engine, hw_create_cb, hw_destroy_cb, 0,
+					"ut_hw_engine");
+		spdk_copy_engine_register(&g_hw_engine);
+	}
+
+	CU_ASSERT(spdk_copy_engine_initialize() == 0);
+	g_ch = spdk_copy_engine_get_io_channel();
+	SPDK_CU_ASSERT_FATAL(g_ch != NULL);
+
+	for (i = 0; i < UT_MAX_TASKS; i++) {
+		g_tasks[i] = calloc(1, spdk_copy_task_size());
+		SPDK_CU_ASSERT_FATAL(g_tasks[i] != NULL);
+		g_task_status[i] = 1;
+	}
+	g_num_completed = 0;
+	g_batch_status = 1;
+	g_batch_done = 0;
+	g_hw_copies = g_hw_fills = g_hw_flushes = 0;
+}
+
+static void
+ut_fini(void)
+{
+	int i;
+
+	for (i = 0; i < UT_MAX_TASKS; i++) {
+		free(g_tasks[i]);
+		g_tasks[i] = NULL;
+	}
+
+	spdk_put_io_channel(g_ch);
+	poll_threads();
+
+	g_fini_done = false;
+	spdk_copy_engine_finish(fini_done, NULL);
+	poll_threads();
+	CU_ASSERT(g_fini_done);
+
+	if (hw_copy_engine != NULL) {
+		hw_copy_engine = NULL;
+		spdk_io_device_unregister(&g_hw_engine, NULL);
+		poll_threads();
+	}
+}
+
+static void
+sw_ops(void)
+{
+	uint8_t src[UT_BUF_SIZE], dst[UT_BUF_SIZE], dst2[UT_BUF_SIZE];
+	uint32_t crc = 0, crc2 = 0;
+	int rc;
+
+	ut_init(false);
+	memset(src, 0x5a, sizeof(src));
+	src[100] = 0x01;
+
+	memset(dst, 0, sizeof(dst));
+	rc = spdk_copy_submit(g_tasks[0], g_ch, dst, src, sizeof(src), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_task_status[0] == 0);
+	CU_ASSERT(memcmp(dst, src, sizeof(src)) == 0);
+
+	rc = spdk_copy_submit_fill(g_tasks[1], g_ch, dst, 0xa5, sizeof(dst), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_task_status[1] == 0);
+	CU_ASSERT(dst[0] == 0xa5 && dst[sizeof(dst) - 1] == 0xa5);
+
+	rc = spdk_copy_submit_crc32c(g_tasks[2], g_ch, &crc, src, 0xffffffff, sizeof(src),
+				     task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_task_status[2] == 0);
+	CU_ASSERT(crc == spdk_crc32c_update(src, sizeof(src), 0xffffffff));
+
+	memset(dst, 0, sizeof(dst));
+	rc = spdk_copy_submit_copy_crc32c(g_tasks[3], g_ch, dst, src, &crc2, 0xffffffff,
+					  sizeof(src), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_task_status[3] == 0);
+	CU_ASSERT(crc2 == crc);
+	CU_ASSERT(memcmp(dst, src, sizeof(src)) == 0);
+
+	rc = spdk_copy_submit_compare(g_tasks[4], g_ch, dst, src, sizeof(src), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_task_status[4] == 0);
+
+	dst[sizeof(dst) - 1] ^= 0xff;
+	rc = spdk_copy_submit_compare(g_tasks[4], g_ch, dst, src, sizeof(src), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_task_status[4] == -EILSEQ);
+
+	memset(dst, 0, sizeof(dst));
+	memset(dst2, 0, sizeof(dst2));
+	rc = spdk_copy_submit_dualcast(g_tasks[5], g_ch, dst, dst2, src, sizeof(src), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_task_status[5] == 0);
+	CU_ASSERT(memcmp(dst, src, sizeof(src)) == 0);
+	CU_ASSERT(memcmp(dst2, src, sizeof(src)) == 0);
+
+	ut_fini();
+}
+
+static void
+sw_large_ops(void)
+{
+	struct spdk_copy_sw_opts opts, saved_opts;
+	uint8_t src[UT_BUF_SIZE], dst[UT_BUF_SIZE];
+	int rc;
+
+	spdk_copy_engine_get_sw_opts(&saved_opts);
+	opts.large_threshold = UT_BUF_SIZE;
+	opts.chunk_size = 0;
+	CU_ASSERT(spdk_copy_engine_set_sw_opts(&opts) == -EINVAL);
+	opts.chunk_size = 1000;
+	CU_ASSERT(spdk_copy_engine_set_sw_opts(&opts) == 0);
+
+	ut_init(false);
+	memset(src, 0x3c, sizeof(src));
+	memset(dst, 0, sizeof(dst));
+
+	/* Large copies and fills are carried out in chunks by the poller */
+	rc = spdk_copy_submit(g_tasks[0], g_ch, dst, src, sizeof(src), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_num_completed == 0);
+	poll_threads();
+	CU_ASSERT(g_num_completed == 1);
+	CU_ASSERT(g_task_status[0] == 0);
+	CU_ASSERT(memcmp(dst, src, sizeof(src)) == 0);
+
+	rc = spdk_copy_submit_fill(g_tasks[1], g_ch, dst, 0x11, sizeof(dst), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_num_completed == 1);
+	poll_threads();
+	CU_ASSERT(g_num_completed == 2);
+	CU_ASSERT(g_task_status[1] == 0);
+	CU_ASSERT(dst[0] == 0x11 && dst[sizeof(dst) - 1] == 0x11);
+
+	/* Smaller ones still complete inline */
+	rc = spdk_copy_submit(g_tasks[2], g_ch, dst, src, sizeof(src) - 1, task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_num_completed == 3);
+
+	ut_fini();
+	CU_ASSERT(spdk_copy_engine_set_sw_opts(&saved_opts) == 0);
+}
+
+static void
+batch_ops(void)
+{
+	struct spdk_copy_batch *batch;
+	uint8_t src[UT_BUF_SIZE], dst[UT_BUF_SIZE], dst2[UT_BUF_SIZE];
+	uint32_t crc = 0;
+	int rc;
+
+	ut_init(false);
+	memset(src, 0x77, sizeof(src));
+
+	/* An empty batch can't be submitted */
+	batch = spdk_copy_batch_create(g_ch);
+	SPDK_CU_ASSERT_FATAL(batch != NULL);
+	rc = spdk_copy_batch_submit(batch, batch_done, NULL);
+	CU_ASSERT(rc == -EINVAL);
+	spdk_copy_batch_cancel(batch);
+
+	batch = spdk_copy_batch_create(g_ch);
+	SPDK_CU_ASSERT_FATAL(batch != NULL);
+	CU_ASSERT(spdk_copy_batch_prep_copy(batch, g_tasks[0], dst, src, sizeof(src),
+					    task_done) == 0);
+	CU_ASSERT(spdk_copy_batch_prep_crc32c(batch, g_tasks[1], &crc, src, 0, sizeof(src),
+					      task_done) == 0);
+	CU_ASSERT(spdk_copy_batch_prep_dualcast(batch, g_tasks[2], dst2, dst, src, sizeof(src),
+						task_done) == 0);
+	CU_ASSERT(spdk_copy_batch_prep_fill(batch, g_tasks[3], dst2, 0xee, sizeof(dst2),
+					    task_done) == 0);
+
+	/* Nothing runs before the batch is submitted */
+	CU_ASSERT(g_num_completed == 0);
+	rc = spdk_copy_batch_submit(batch, batch_done, (void *)(uintptr_t)4);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_batch_done == 1);
+	CU_ASSERT(g_batch_status == 0);
+
+	/* The operations complete in the order they were prepared */
+	CU_ASSERT(g_num_completed == 4);
+	CU_ASSERT(g_completed[0] == 0);
+	CU_ASSERT(g_completed[1] == 1);
+	CU_ASSERT(g_completed[2] == 2);
+	CU_ASSERT(g_completed[3] == 3);
+	CU_ASSERT(crc == spdk_crc32c_update(src, sizeof(src), 0));
+	CU_ASSERT(memcmp(dst, src, sizeof(src)) == 0);
+	CU_ASSERT(dst2[0] == 0xee && dst2[sizeof(dst2) - 1] == 0xee);
+
+	/* The batch reports the first failure, after every operation completed */
+	g_num_completed = 0;
+	dst[0] ^= 0xff;
+	batch = spdk_copy_batch_create(g_ch);
+	SPDK_CU_ASSERT_FATAL(batch != NULL);
+	CU_ASSERT(spdk_copy_batch_prep_compare(batch, g_tasks[0], src, src, sizeof(src),
+					       task_done) == 0);
+	CU_ASSERT(spdk_copy_batch_prep_compare(batch, g_tasks[1], dst, src, sizeof(src),
+					       task_done) == 0);
+	CU_ASSERT(spdk_copy_batch_prep_copy(batch, g_tasks[2], dst, src, sizeof(src),
+					    task_done) == 0);
+	rc = spdk_copy_batch_submit(batch, batch_done, (void *)(uintptr_t)3);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_batch_done == 2);
+	CU_ASSERT(g_batch_status == -EILSEQ);
+	CU_ASSERT(g_task_status[0] == 0);
+	CU_ASSERT(g_task_status[1] == -EILSEQ);
+	CU_ASSERT(g_task_status[2] == 0);
+
+	/* Operations can only be added to a batch */
+	CU_ASSERT(spdk_copy_batch_prep_copy(NULL, g_tasks[0], dst, src, sizeof(src), task_done) ==
+		  -EINVAL);
+
+	ut_fini();
+}
+
+static void
+batch_exhaustion(void)
+{
+	struct spdk_copy_batch *batches[COPY_CHANNEL_BATCHES];
+	struct spdk_copy_batch *batch;
+	uint8_t src[UT_BUF_SIZE], dst[UT_BUF_SIZE];
+	int i, rc;
+
+	ut_init(false);
+	memset(src, 0x42, sizeof(src));
+
+	for (i = 0; i < COPY_CHANNEL_BATCHES; i++) {
+		batches[i] = spdk_copy_batch_create(g_ch);
+		SPDK_CU_ASSERT_FATAL(batches[i] != NULL);
+	}
+
+	/* All batches of the channel are in use */
+	CU_ASSERT(spdk_copy_batch_create(g_ch) == NULL);
+
+	/* A submitted batch is released before its callback is called */
+	CU_ASSERT(spdk_copy_batch_prep_copy(batches[0], g_tasks[0], dst, src, sizeof(src),
+					    task_done) == 0);
+	rc = spdk_copy_batch_submit(batches[0], batch_done, (void *)(uintptr_t)1);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_batch_done == 1);
+	batch = spdk_copy_batch_create(g_ch);
+	CU_ASSERT(batch == batches[0]);
+	CU_ASSERT(spdk_copy_batch_create(g_ch) == NULL);
+
+	/* Cancelled batches can be reused */
+	for (i = 0; i < COPY_CHANNEL_BATCHES; i++) {
+		spdk_copy_batch_cancel(batches[i]);
+	}
+	for (i = 0; i < COPY_CHANNEL_BATCHES; i++) {
+		batches[i] = spdk_copy_batch_create(g_ch);
+		CU_ASSERT(batches[i] != NULL);
+	}
+	CU_ASSERT(spdk_copy_batch_create(g_ch) == NULL);
+	for (i = 0; i < COPY_CHANNEL_BATCHES; i++) {
+		spdk_copy_batch_cancel(batches[i]);
+	}
+
+	ut_fini();
+}
+
+static void
+hw_fallback(void)
+{
+	struct spdk_copy_batch *batch;
+	uint8_t src[UT_BUF_SIZE], dst[UT_BUF_SIZE], dst2[UT_BUF_SIZE];
+	uint32_t crc = 0;
+	int rc;
+
+	ut_init(true);
+	memset(src, 0x99, sizeof(src));
+
+	/* Operations the engine offers go to it */
+	rc = spdk_copy_submit(g_tasks[0], g_ch, dst, src, sizeof(src), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_task_status[0] == 0);
+	CU_ASSERT(g_hw_copies == 1);
+
+	rc = spdk_copy_submit_fill(g_tasks[1], g_ch, dst, 0, sizeof(dst), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_task_status[1] == 0);
+	CU_ASSERT(g_hw_fills == 1);
+
+	/* The others are carried out by the software engine */
+	rc = spdk_copy_submit_crc32c(g_tasks[2], g_ch, &crc, src, 0, sizeof(src), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_task_status[2] == 0);
+	CU_ASSERT(crc == spdk_crc32c_update(src, sizeof(src), 0));
+
+	rc = spdk_copy_submit_compare(g_tasks[3], g_ch, src, src, sizeof(src), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_task_status[3] == 0);
+
+	rc = spdk_copy_submit_dualcast(g_tasks[4], g_ch, dst, dst2, src, sizeof(src), task_done);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_task_status[4] == 0);
+	CU_ASSERT(memcmp(dst2, src, sizeof(src)) == 0);
+	CU_ASSERT(g_hw_copies == 1);
+	CU_ASSERT(g_hw_fills == 1);
+
+	/*
+	 * In a batch, the copies are queued and handed to the hardware with one flush
+	 * after the software engine ran the rest. A fill without build_fill is issued
+	 * right away.
+	 */
+	g_num_completed = 0;
+	batch = spdk_copy_batch_create(g_ch);
+	SPDK_CU_ASSERT_FATAL(batch != NULL);
+	CU_ASSERT(spdk_copy_batch_prep_copy(batch, g_tasks[0], dst, src, sizeof(src),
+					    task_done) == 0);
+	CU_ASSERT(spdk_copy_batch_prep_crc32c(batch, g_tasks[1], &crc, src, 0, sizeof(src),
+					      task_done) == 0);
+	CU_ASSERT(spdk_copy_batch_prep_copy(batch, g_tasks[2], dst2, src, sizeof(src),
+					    task_done) == 0);
+	CU_ASSERT(spdk_copy_batch_prep_fill(batch, g_tasks[3], dst, 0, sizeof(dst),
+					    task_done) == 0);
+	rc = spdk_copy_batch_submit(batch, batch_done, (void *)(uintptr_t)4);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_hw_flushes == 1);
+	CU_ASSERT(g_hw_copies == 3);
+	CU_ASSERT(g_hw_fills == 2);
+	CU_ASSERT(g_batch_done == 1);
+	CU_ASSERT(g_batch_status == 0);
+	CU_ASSERT(g_num_completed == 4);
+	CU_ASSERT(g_completed[0] == 1);
+	CU_ASSERT(g_completed[1] == 3);
+	CU_ASSERT(g_completed[2] == 0);
+	CU_ASSERT(g_completed[3] == 2);
+
+	ut_fini();
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("copy_engine", NULL, NULL);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (
+		CU_add_test(suite, "sw_ops", sw_ops) == NULL ||
+		CU_add_test(suite, "sw_large_ops", sw_large_ops) == NULL ||
+		CU_add_test(suite, "batch_ops", batch_ops) == NULL ||
+		CU_add_test(suite, "batch_exhaustion", batch_exhaustion) == NULL ||
+		CU_add_test(suite, "hw_fallback", hw_fallback) == NULL
+	) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	allocate_threads(1);
+	set_thread(0);
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+
+	free_threads();
+
+	return num_failures;
+}
@@ -0,0 +1,337 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk_cunit.h"
+#include "common/lib/test_env.c"
+#include "event/reactor.c"
+#include "event/scheduler.c"
+
+DEFINE_STUB(spdk_env_get_core_count, uint32_t, (void), 1);
+DEFINE_STUB(spdk_env_thread_launch_pinned, int, (uint32_t core, thread_start_fn fn, void *arg), 0);
+DEFINE_STUB_V(spdk_env_thread_wait_all, (void));
+
+static void
+test_balance(void)
+{
+	struct spdk_scheduler_core_info cores[2] = {};
+	struct spdk_scheduler_thread_info threads[4] = {};
+	uint32_t i;
+
+	cores[0].lcore = 0;
+	cores[0].busy_tsc = 700;
+	cores[0].thread_count = 4;
+	cores[1].lcore = 1;
+
+	for (i = 0; i < 4; i++) {
+		threads[i].id = i;
+		threads[i].lcore = 0;
+		threads[i].new_lcore = 0;
+		spdk_cpuset_set_cpu(&threads[i].cpumask, 0, true);
+		spdk_cpuset_set_cpu(&threads[i].cpumask, 1, true);
+	}
+	threads[0].busy_tsc = 300;
+	threads[1].busy_tsc = 200;
+	threads[2].busy_tsc = 100;
+	/* The last thread may only run on core 0. */
+	threads[3].busy_tsc = 100;
+	spdk_cpuset_set_cpu(&threads[3].cpumask, 1, false);
+
+	/* The 300 thread evens out the cores best. Nothing narrows the gap after that. */
+	scheduler_balanced.balance(cores, 2, threads, 4);
+	CU_ASSERT(threads[0].new_lcore == 1);
+	CU_ASSERT(threads[1].new_lcore == 0);
+	CU_ASSERT(threads[2].new_lcore == 0);
+	CU_ASSERT(threads[3].new_lcore == 0);
+	CU_ASSERT(cores[0].busy_tsc == 400);
+	CU_ASSERT(cores[1].busy_tsc == 300);
+
+	/* A thread that is not allowed on the idle core stays put. */
+	memset(threads, 0, sizeof(threads));
+	cores[0].busy_tsc = 500;
+	cores[1].busy_tsc = 0;
+	threads[0].busy_tsc = 500;
+	threads[0].lcore = 0;
+	threads[0].new_lcore = 0;
+	spdk_cpuset_set_cpu(&threads[0].cpumask, 0, true);
+
+	scheduler_balanced.balance(cores, 2, threads, 1);
+	CU_ASSERT(threads[0].new_lcore == 0);
+}
+
+static void
+test_set_scheduler(void)
+{
+	struct spdk_reactor_scheduler_info info;
+
+	spdk_reactor_get_scheduler_info(&info);
+	CU_ASSERT(strcmp(info.name, "static") == 0);
+	CU_ASSERT(info.period_usec == SPDK_SCHEDULER_PERIOD_USEC);
+
+	CU_ASSERT(spdk_reactor_set_scheduler("invalid", 0) == -ENOENT);
+
+	CU_ASSERT(spdk_reactor_set_scheduler("work_stealing", 1000) == 0);
+	spdk_reactor_get_scheduler_info(&info);
+	CU_ASSERT(strcmp(info.name, "work_stealing") == 0);
+	CU_ASSERT(info.period_usec == 1000);
+
+	/* A period of 0 keeps the current one. */
+	CU_ASSERT(spdk_reactor_set_scheduler("static", 0) == 0);
+	spdk_reactor_get_scheduler_info(&info);
+	CU_ASSERT(strcmp(info.name, "static") == 0);
+	CU_ASSERT(info.period_usec == 1000);
+
+	spdk_reactor_set_scheduler("static", SPDK_SCHEDULER_PERIOD_USEC);
+}
+
+static void
+test_migrate_thread(void)
+{
+	struct spdk_thread *thread, *pinned;
+	struct spdk_lw_thread *lw_thread, *lw_pinned;
+	struct spdk_reactor *reactor0, *reactor1;
+	struct spdk_reactor_migration migrations[4];
+	struct spdk_reactor_scheduler_info info;
+	struct spdk_cpuset cpumask = {};
+
+	CU_ASSERT(spdk_reactors_init() == 0);
+	/* The env stubs only report core 0, so bring up the second reactor by hand. */
+	spdk_reactor_construct(&g_reactors[1], 1);
+	g_reactor_state = SPDK_REACTOR_STATE_RUNNING;
+	reactor0 = spdk_reactor_get(0);
+	reactor1 = spdk_reactor_get(1);
+
+	MOCK_SET(spdk_env_get_current_core, 0);
+	thread = spdk_thread_create("migrating", NULL);
+	SPDK_CU_ASSERT_FATAL(thread != NULL);
+	spdk_cpuset_set_cpu(&cpumask, 0, true);
+	pinned = spdk_thread_create("pinned", &cpumask);
+	SPDK_CU_ASSERT_FATAL(pinned != NULL);
+	_spdk_event_queue_run_batch(reactor0);
+
+	lw_thread = spdk_thread_get_ctx(thread);
+	lw_pinned = spdk_thread_get_ctx(pinned);
+	CU_ASSERT(TAILQ_FIRST(&reactor0->threads) == lw_thread);
+	CU_ASSERT(TAILQ_NEXT(lw_thread, link) == lw_pinned);
+
+	/* The pinned thread is not allowed on core 1. */
+	_spdk_reactor_migrate_thread(reactor0, lw_pinned, 1, false);
+	CU_ASSERT(TAILQ_NEXT(lw_thread, link) == lw_pinned);
+	CU_ASSERT(spdk_reactor_get_migrations(migrations, 4) == 0);
+
+	_spdk_reactor_migrate_thread(reactor0, lw_thread, 1, true);
+	CU_ASSERT(TAILQ_FIRST(&reactor0->threads) == lw_pinned);
+	CU_ASSERT(TAILQ_EMPTY(&reactor1->threads));
+
+	MOCK_SET(spdk_env_get_current_core, 1);
+	_spdk_event_queue_run_batch(reactor1);
+	CU_ASSERT(TAILQ_FIRST(&reactor1->threads) == lw_thread);
+
+	CU_ASSERT(spdk_reactor_get_migrations(migrations, 4) == 1);
+	CU_ASSERT(strcmp(migrations[0].thread_name, "migrating") == 0);
+	CU_ASSERT(migrations[0].src_lcore == 0);
+	CU_ASSERT(migrations[0].dst_lcore == 1);
+	CU_ASSERT(migrations[0].stolen == true);
+
+	spdk_reactor_get_scheduler_info(&info);
+	CU_ASSERT(info.migrations == 0);
+	CU_ASSERT(info.steals == 1);
+
+	spdk_set_thread(thread);
+	spdk_thread_exit(thread);
+	spdk_thread_destroy(thread);
+	spdk_set_thread(pinned);
+	spdk_thread_exit(pinned);
+	spdk_thread_destroy(pinned);
+
+	spdk_ring_free(reactor1->events);
+	spdk_reactors_fini();
+	MOCK_CLEAR(spdk_env_get_current_core);
+}
+
+static void *
+reactor_sleep(void *arg)
+{
+	struct spdk_reactor *reactor = arg;
+
+	_spdk_reactor_sleep(reactor, spdk_get_ticks());
+
+	return NULL;
+}
+
+static void
+wait_for_sleep(struct spdk_reactor *reactor)
+{
+	while (!__atomic_load_n(&reactor->sleeping, __ATOMIC_SEQ_CST)) {
+		usleep(100);
+	}
+	/* Give the reactor time to get from the flag into epoll_wait(). */
+	usleep(10 * 1000);
+}
+
+static int
+busy_poll(void *arg)
+{
+	return 0;
+}
+
+static void
+nop_msg(void *arg)
+{
+}
+
+static void
+test_interrupt_mode(void)
+{
+	struct spdk_reactor *reactor;
+	struct spdk_reactor_interrupt_stats stats;
+	struct spdk_thread *thread;
+	struct spdk_poller *poller;
+	struct spdk_event *event;
+	pthread_t tid;
+	uint64_t idle_usec;
+	int fds[2];
+
+	CU_ASSERT(spdk_reactors_init() == 0);
+	g_reactor_state = SPDK_REACTOR_STATE_RUNNING;
+	reactor = spdk_reactor_get(0);
+	SPDK_CU_ASSERT_FATAL(reactor->epoll_fd >= 0);
+
+	CU_ASSERT(spdk_reactor_set_interrupt_mode(true, 500) == 0);
+	CU_ASSERT(spdk_reactor_get_interrupt_mode(&idle_usec) == true);
+	CU_ASSERT(idle_usec == 500);
+
+	MOCK_SET(spdk_env_get_current_core, 0);
+	thread = spdk_thread_create("interrupt", NULL);
+	SPDK_CU_ASSERT_FATAL(thread != NULL);
+	_spdk_event_queue_run_batch(reactor);
+	spdk_set_thread(thread);
+
+	/* A message wakes the reactor up. */
+	pthread_create(&tid, NULL, reactor_sleep, reactor);
+	wait_for_sleep(reactor);
+	spdk_thread_send_msg(thread, nop_msg, NULL);
+	pthread_join(tid, NULL);
+	CU_ASSERT(reactor->sleeping == false);
+	CU_ASSERT(spdk_reactor_get_interrupt_stats(0, &stats) == 0);
+	CU_ASSERT(stats.sleep_count == 1);
+	spdk_thread_poll(thread, 0, 0);
+
+	/* So does an event. */
+	pthread_create(&tid, NULL, reactor_sleep, reactor);
+	wait_for_sleep(reactor);
+	event = spdk_event_allocate(0, NULL, NULL, NULL);
+	SPDK_CU_ASSERT_FATAL(event != NULL);
+	spdk_event_call(event);
+	pthread_join(tid, NULL);
+	CU_ASSERT(reactor->sleep_count == 2);
+	CU_ASSERT(spdk_ring_dequeue(reactor->events, (void **)&event, 1) == 1);
+	spdk_mempool_put(g_spdk_event_mempool, event);
+
+	/* And the wakeup fd of a poller. */
+	CU_ASSERT(pipe(fds) == 0);
+	poller = spdk_poller_register(busy_poll, NULL, 0);
+	SPDK_CU_ASSERT_FATAL(poller != NULL);
+	CU_ASSERT(spdk_poller_set_wakeup_fd(poller, fds[0]) == 0);
+	pthread_create(&tid, NULL, reactor_sleep, reactor);
+	wait_for_sleep(reactor);
+	CU_ASSERT(write(fds[1], "x", 1) == 1);
+	pthread_join(tid, NULL);
+	CU_ASSERT(reactor->sleep_count == 3);
+	spdk_poller_unregister(&poller);
+	close(fds[0]);
+	close(fds[1]);
+
+	/* A timed poller wakes the reactor up when it expires. */
+	poller = spdk_poller_register(busy_poll, NULL, 1000);
+	SPDK_CU_ASSERT_FATAL(poller != NULL);
+	_spdk_reactor_sleep(reactor, spdk_get_ticks());
+	CU_ASSERT(reactor->sleep_count == 4);
+	spdk_poller_unregister(&poller);
+
+	/* A poller without a wakeup fd keeps the reactor polling. */
+	poller = spdk_poller_register(busy_poll, NULL, 0);
+	SPDK_CU_ASSERT_FATAL(poller != NULL);
+	_spdk_reactor_sleep(reactor, spdk_get_ticks());
+	CU_ASSERT(reactor->sleep_count == 4);
+	CU_ASSERT(reactor->sleeping == false);
+	spdk_poller_unregister(&poller);
+
+	CU_ASSERT(spdk_reactor_set_interrupt_mode(false, 0) == 0);
+	CU_ASSERT(spdk_reactor_get_interrupt_mode(&idle_usec) == false);
+	CU_ASSERT(idle_usec == 500);
+
+	spdk_thread_exit(thread);
+	spdk_thread_poll(thread, 0, 0);
+	_spdk_reactor_remove_thread(reactor, spdk_thread_get_ctx(thread));
+	spdk_thread_destroy(thread);
+
+	spdk_reactor_set_interrupt_mode(false, SPDK_REACTOR_INTERRUPT_IDLE_USEC);
+	spdk_reactors_fini();
+	MOCK_CLEAR(spdk_env_get_current_core);
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite suite = NULL;
+	unsigned int num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("reactor_suite", NULL, NULL);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (
+		CU_add_test(suite, "test_balance", test_balance) == NULL ||
+		CU_add_test(suite, "test_set_scheduler", test_set_scheduler) == NULL ||
+		CU_add_test(suite, "test_migrate_thread", test_migrate_thread) == NULL ||
+		CU_add_test(suite, "test_interrupt_mode", test_interrupt_mode) == NULL
+	) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+
+	return num_failures;
+}
@@ -67,6 +67,7 @@ DEFINE_STUB(nvme_ctrlr_cmd_set_host_id, int,
 	    (struct spdk_nvme_ctrlr *ctrlr, void *host_id, uint32_t host_id_size,
 	     spdk_nvme_cmd_cb cb_fn, void *cb_arg), 0);
 DEFINE_STUB_V(nvme_ns_set_identify_data, (struct spdk_nvme_ns *ns));
+DEFINE_STUB(nvme_poll_group_remove_qpair, int, (struct spdk_nvme_qpair *qpair), 0);
 
 struct spdk_nvme_ctrlr *nvme_transport_ctrlr_construct(const struct spdk_nvme_transport_id *trid,
 		const struct spdk_nvme_ctrlr_opts *opts,
@@ -1288,6 +1289,40 @@ test_alloc_io_qpair_rr_1(void)
 	cleanup_qpairs(&ctrlr);
 }
 
+static void
+test_alloc_io_qpair_create_only(void)
+{
+	struct spdk_nvme_io_qpair_opts opts;
+	struct spdk_nvme_ctrlr ctrlr = {};
+	struct spdk_nvme_qpair *q0;
+
+	setup_qpairs(&ctrlr, 1);
+	g_ut_nvme_regs.cc.bits.ams = SPDK_NVME_CC_AMS_RR;
+
+	spdk_nvme_ctrlr_get_default_io_qpair_opts(&ctrlr, &opts, sizeof(opts));
+	CU_ASSERT(opts.create_only == false);
+
+	/* A qpair allocated with create_only stays disabled until it is connected. */
+	opts.create_only = true;
+	q0 = spdk_nvme_ctrlr_alloc_io_qpair(&ctrlr, &opts, sizeof(opts));
+	SPDK_CU_ASSERT_FATAL(q0 != NULL);
+	CU_ASSERT(nvme_qpair_state_equals(q0, NVME_QPAIR_DISABLED));
+
+	CU_ASSERT(spdk_nvme_ctrlr_connect_io_qpair(&ctrlr, q0) == 0);
+	CU_ASSERT(nvme_qpair_state_equals(q0, NVME_QPAIR_CONNECTED));
+	CU_ASSERT(spdk_nvme_ctrlr_connect_io_qpair(&ctrlr, q0) == -EISCONN);
+	CU_ASSERT(spdk_nvme_ctrlr_connect_io_qpair(&ctrlr, NULL) == -EINVAL);
+	SPDK_CU_ASSERT_FATAL(spdk_nvme_ctrlr_free_io_qpair(q0) == 0);
+
+	/* Without create_only, the qpair comes back connected. */
+	q0 = spdk_nvme_ctrlr_alloc_io_qpair(&ctrlr, NULL, 0);
+	SPDK_CU_ASSERT_FATAL(q0 != NULL);
+	CU_ASSERT(nvme_qpair_state_equals(q0, NVME_QPAIR_CONNECTED));
+	SPDK_CU_ASSERT_FATAL(spdk_nvme_ctrlr_free_io_qpair(q0) == 0);
+
+	cleanup_qpairs(&ctrlr);
+}
+
 static void
 test_alloc_io_qpair_wrr_1(void)
 {
@@ -1866,6 +1901,7 @@ int main(int argc, char **argv)
 		|| CU_add_test(suite, "test_nvme_ctrlr_init_delay",
 			       test_nvme_ctrlr_init_delay) == NULL
 		|| CU_add_test(suite, "alloc_io_qpair_rr 1", test_alloc_io_qpair_rr_1) == NULL
+		|| CU_add_test(suite, "alloc_io_qpair_create_only", test_alloc_io_qpair_create_only) == NULL
 		|| CU_add_test(suite, "get_default_ctrlr_opts", test_ctrlr_get_default_ctrlr_opts) == NULL
 		|| CU_add_test(suite, "get_default_io_qpair_opts", test_ctrlr_get_default_io_qpair_opts) == NULL
 		|| CU_add_test(suite, "alloc_io_qpair_wrr 1", test_alloc_io_qpair_wrr_1) == NULL
@@ -35,6 +35,7 @@
 
 #include "spdk_cunit.h"
 
+#define UNIT_TEST_NO_VTOPHYS
 #include "common/lib/test_env.c"
 
 #include "nvme/nvme_pcie.c"
@@ -53,6 +54,34 @@ struct nvme_driver *g_spdk_nvme_driver = &_g_nvme_driver;
 
 struct nvme_request *g_request = NULL;
 
+/*
+ * Size of the physically contiguous regions of the emulated memory, 0 for a single region.
+ *  Region n is mapped at twice its virtual address, so that neighbouring regions are
+ *  not contiguous.
+ */
+static uint64_t g_vtophys_region_size;
+static uint32_t g_vtophys_calls;
+
+DEFINE_RETURN_MOCK(spdk_vtophys, uint64_t);
+uint64_t
+spdk_vtophys(void *buf, uint64_t *size)
+{
+	uint64_t vaddr = (uintptr_t)buf;
+
+	g_vtophys_calls++;
+	HANDLE_RETURN_MOCK(spdk_vtophys);
+
+	if (g_vtophys_region_size == 0) {
+		return vaddr;
+	}
+
+	if (size != NULL) {
+		*size = spdk_min(*size, g_vtophys_region_size - vaddr % g_vtophys_region_size);
+	}
+
+	return vaddr + vaddr / g_vtophys_region_size * g_vtophys_region_size;
+}
+
 extern bool ut_fail_vtophys;
 
 bool fail_next_sge = false;
@@ -799,6 +828,44 @@ test_prp_list_append(void)
 					    (NVME_MAX_PRP_LIST_ENTRIES + 1) * 0x1000, 0x1000) == -EINVAL);
 }
 
+static void
+test_prp_list_append_contiguous_regions(void)
+{
+	struct nvme_request req;
+	struct nvme_tracker tr;
+	uint32_t prp_index, i;
+
+	g_vtophys_region_size = 0x200000;
+
+	/* 128K buffer within one region is translated once */
+	prp_list_prep(&tr, &req, &prp_index);
+	g_vtophys_calls = 0;
+	CU_ASSERT(nvme_pcie_prp_list_append(&tr, &prp_index, (void *)0x200000, 0x20000, 0x1000) == 0);
+	CU_ASSERT(g_vtophys_calls == 1);
+	CU_ASSERT(prp_index == 32);
+	CU_ASSERT(req.cmd.dptr.prp.prp1 == 0x400000);
+	CU_ASSERT(req.cmd.dptr.prp.prp2 == tr.prp_sgl_bus_addr);
+	for (i = 0; i < 31; i++) {
+		CU_ASSERT(tr.u.prp[i] == 0x401000 + i * 0x1000);
+	}
+
+	/* 128K buffer, non-4K aligned, crossing into the next region is translated per region */
+	prp_list_prep(&tr, &req, &prp_index);
+	g_vtophys_calls = 0;
+	CU_ASSERT(nvme_pcie_prp_list_append(&tr, &prp_index, (void *)0x3f0800, 0x20000, 0x1000) == 0);
+	CU_ASSERT(g_vtophys_calls == 2);
+	CU_ASSERT(prp_index == 33);
+	CU_ASSERT(req.cmd.dptr.prp.prp1 == 0x5f0800);
+	for (i = 0; i < 15; i++) {
+		CU_ASSERT(tr.u.prp[i] == 0x5f1000 + i * 0x1000);
+	}
+	for (i = 15; i < 32; i++) {
+		CU_ASSERT(tr.u.prp[i] == 0x800000 + (i - 15) * 0x1000);
+	}
+
+	g_vtophys_region_size = 0;
+}
+
 static void test_shadow_doorbell_update(void)
 {
 	bool ret;
@@ -811,6 +878,139 @@ static void test_shadow_doorbell_update(void)
 	CU_ASSERT(ret == true);
 }
 
+static void
+ut_adaptive_submit(struct nvme_pcie_qpair *pqpair, struct nvme_tracker *tr,
+		   struct nvme_request *req)
+{
+	tr->req = req;
+	TAILQ_INSERT_TAIL(&pqpair->outstanding_tr, tr, tq_list);
+	nvme_pcie_qpair_submit_tracker(&pqpair->qpair, tr);
+}
+
+static void
+test_adaptive_sq_doorbell(void)
+{
+	struct nvme_pcie_ctrlr			pctrlr = {};
+	struct nvme_pcie_qpair			pqpair = {};
+	/* Commands are copied with 64-byte aligned stores */
+	struct spdk_nvme_cmd			cmd[8] __attribute__((aligned(64))) = {};
+	struct nvme_tracker			tr[5] = {};
+	struct nvme_request			req __attribute__((aligned(64))) = {};
+	struct spdk_nvme_qpair_doorbell_stats	stats;
+	uint32_t				sq_tdbl = 0;
+
+	pctrlr.ctrlr.trid.trtype = SPDK_NVME_TRANSPORT_PCIE;
+	pqpair.qpair.trtype = SPDK_NVME_TRANSPORT_PCIE;
+	pqpair.qpair.ctrlr = &pctrlr.ctrlr;
+	pqpair.num_entries = SPDK_COUNTOF(cmd);
+	pqpair.cmd = cmd;
+	pqpair.sq_tdbl = &sq_tdbl;
+	pqpair.flags.adaptive_doorbell = 1;
+	TAILQ_INIT(&pqpair.outstanding_tr);
+
+	/* The doorbell for a command submitted to an idle queue is rung right away */
+	ut_adaptive_submit(&pqpair, &tr[0], &req);
+	CU_ASSERT(sq_tdbl == 1);
+	CU_ASSERT(pqpair.last_sq_tail == 1);
+
+	/* Without a latency budget, commands behind it wait for the next completion poll */
+	ut_adaptive_submit(&pqpair, &tr[1], &req);
+	CU_ASSERT(sq_tdbl == 1);
+	CU_ASSERT(pqpair.last_sq_tail == 1);
+	nvme_pcie_qpair_ring_sq_doorbell(&pqpair.qpair);
+	CU_ASSERT(sq_tdbl == 2);
+
+	/* With a budget, the doorbell is rung once the oldest waiting command exceeds it */
+	pqpair.doorbell_budget_ticks = 10;
+	MOCK_SET(spdk_get_ticks, 100);
+	ut_adaptive_submit(&pqpair, &tr[2], &req);
+	CU_ASSERT(sq_tdbl == 2);
+	MOCK_SET(spdk_get_ticks, 105);
+	ut_adaptive_submit(&pqpair, &tr[3], &req);
+	CU_ASSERT(sq_tdbl == 2);
+	MOCK_SET(spdk_get_ticks, 110);
+	ut_adaptive_submit(&pqpair, &tr[4], &req);
+	CU_ASSERT(sq_tdbl == 5);
+	CU_ASSERT(pqpair.last_sq_tail == 5);
+	MOCK_CLEAR(spdk_get_ticks);
+
+	CU_ASSERT(nvme_pcie_qpair_get_doorbell_stats(&pqpair.qpair, &stats) == 0);
+	CU_ASSERT(stats.submitted == 5);
+	CU_ASSERT(stats.sq_doorbell_writes == 3);
+	CU_ASSERT(stats.cq_doorbell_writes == 0);
+}
+
+static void
+test_cmb_io_buffer(void)
+{
+	struct nvme_pcie_ctrlr	pctrlr = {};
+	struct spdk_nvme_ctrlr	*ctrlr = &pctrlr.ctrlr;
+	uint8_t			*cmb;
+	void			*a, *b, *c, *d;
+	uint64_t		offset;
+
+	/* Emulate a CMB of 16 chunks starting 4KiB into the BAR */
+	cmb = calloc(1, 0x11000);
+	SPDK_CU_ASSERT_FATAL(cmb != NULL);
+	ctrlr->trid.trtype = SPDK_NVME_TRANSPORT_PCIE;
+	pctrlr.cmb_bar_virt_addr = cmb;
+	pctrlr.cmb_base_offset = 0x1000;
+	pctrlr.cmb_max_offset = 0x11000;
+	pctrlr.cmb_io_data_supported = true;
+	CU_ASSERT(nvme_pcie_ctrlr_init_cmb_chunks(&pctrlr) == 0);
+	CU_ASSERT(spdk_bit_array_capacity(pctrlr.cmb_chunks) == 16);
+
+	a = nvme_pcie_ctrlr_alloc_cmb_io_buffer(ctrlr, 0x1000);
+	b = nvme_pcie_ctrlr_alloc_cmb_io_buffer(ctrlr, 0x2000);
+	c = nvme_pcie_ctrlr_alloc_cmb_io_buffer(ctrlr, 0x1000);
+	CU_ASSERT(a == cmb + 0x1000);
+	CU_ASSERT(b == cmb + 0x2000);
+	CU_ASSERT(c == cmb + 0x4000);
+	CU_ASSERT(spdk_bit_array_count_set(pctrlr.cmb_chunks) == 4);
+	CU_ASSERT(nvme_pcie_ctrlr_alloc_cmb_io_buffer(ctrlr, 0xd000) == NULL);
+
+	/* Freed chunks are reused first */
+	CU_ASSERT(nvme_pcie_ctrlr_free_cmb_io_buffer(ctrlr, b, 0x2000) == 0);
+	d = nvme_pcie_ctrlr_alloc_cmb_io_buffer(ctrlr, 0x1000);
+	CU_ASSERT(d == cmb + 0x2000);
+	CU_ASSERT(spdk_bit_array_count_set(pctrlr.cmb_chunks) == 3);
+
+	/* A buffer which doesn't fit in a hole goes after it, and the hole stays usable */
+	b = nvme_pcie_ctrlr_alloc_cmb_io_buffer(ctrlr, 0x2000);
+	CU_ASSERT(b == cmb + 0x5000);
+	CU_ASSERT(nvme_pcie_ctrlr_alloc_cmb_io_buffer(ctrlr, 0x1000) == cmb + 0x3000);
+	CU_ASSERT(nvme_pcie_ctrlr_free_cmb_io_buffer(ctrlr, cmb + 0x3000, 0x1000) == 0);
+
+	/* Buffers are made of whole chunks */
+	CU_ASSERT(nvme_pcie_ctrlr_free_cmb_io_buffer(ctrlr, a, 0x1000) == 0);
+	a = nvme_pcie_ctrlr_alloc_cmb_io_buffer(ctrlr, 0x100);
+	CU_ASSERT(a == cmb + 0x1000);
+	CU_ASSERT(nvme_pcie_ctrlr_alloc_cmb_io_buffer(ctrlr, 0x100) == cmb + 0x3000);
+	CU_ASSERT(nvme_pcie_ctrlr_free_cmb_io_buffer(ctrlr, cmb + 0x3000, 0x100) == 0);
+
+	/* Aligned allocations skip chunks which are free but not aligned */
+	CU_ASSERT(nvme_pcie_ctrlr_alloc_cmb(ctrlr, 0x1000, 0x4000, &offset) == 0);
+	CU_ASSERT(offset == 0x8000);
+	CU_ASSERT(nvme_pcie_ctrlr_free_cmb(ctrlr, offset, 0x1000) == 0);
+
+	/* Any number of holes is tracked, nothing is lost */
+	CU_ASSERT(nvme_pcie_ctrlr_free_cmb_io_buffer(ctrlr, a, 0x100) == 0);
+	CU_ASSERT(nvme_pcie_ctrlr_free_cmb_io_buffer(ctrlr, c, 0x1000) == 0);
+	CU_ASSERT(spdk_bit_array_count_set(pctrlr.cmb_chunks) == 3);
+	CU_ASSERT(nvme_pcie_ctrlr_free_cmb_io_buffer(ctrlr, b, 0x2000) == 0);
+	CU_ASSERT(nvme_pcie_ctrlr_free_cmb_io_buffer(ctrlr, d, 0x1000) == 0);
+	CU_ASSERT(spdk_bit_array_count_set(pctrlr.cmb_chunks) == 0);
+	CU_ASSERT(nvme_pcie_ctrlr_alloc_cmb_io_buffer(ctrlr, 0x10000) == cmb + 0x1000);
+
+	/* Buffers which aren't allocated or outside of the CMB are rejected */
+	CU_ASSERT(nvme_pcie_ctrlr_free_cmb_io_buffer(ctrlr, cmb + 0x1000, 0x10000) == 0);
+	CU_ASSERT(nvme_pcie_ctrlr_free_cmb_io_buffer(ctrlr, cmb + 0x8000, 0x1000) == -EINVAL);
+	CU_ASSERT(nvme_pcie_ctrlr_free_cmb_io_buffer(ctrlr, cmb + 0x10000, 0x2000) == -EINVAL);
+
+	spdk_bit_array_free(&pctrlr.cmb_chunks);
+	free(cmb);
+}
+
 int main(int argc, char **argv)
 {
 	CU_pSuite	suite = NULL;
@@ -827,8 +1027,12 @@ int main(int argc, char **argv)
 	}
 
 	if (CU_add_test(suite, "prp_list_append", test_prp_list_append) == NULL
+	    || CU_add_test(suite, "prp_list_append_contiguous_regions",
+			   test_prp_list_append_contiguous_regions) == NULL
 	    || CU_add_test(suite, "shadow_doorbell_update",
-			   test_shadow_doorbell_update) == NULL) {
+			   test_shadow_doorbell_update) == NULL
+	    || CU_add_test(suite, "adaptive_sq_doorbell", test_adaptive_sq_doorbell) == NULL
+	    || CU_add_test(suite, "cmb_io_buffer", test_cmb_io_buffer) == NULL) {
 		CU_cleanup_registry();
 		return CU_get_error();
 	}
@@ -0,0 +1,303 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk_cunit.h"
+
+#include "common/lib/test_env.c"
+
+#include "nvme/nvme_poll_group.c"
+
+struct ut_transport_poll_group {
+	struct nvme_transport_poll_group	group;
+	int64_t					completions;
+};
+
+static int g_tgroups_created;
+static int g_tgroups_destroyed;
+static int g_transport_add_rc;
+static int g_transport_remove_rc;
+static int g_disconnected_qpairs;
+static struct spdk_nvme_qpair *g_qpair_to_free;
+
+struct nvme_transport_poll_group *
+nvme_transport_poll_group_create(enum spdk_nvme_transport_type trtype)
+{
+	struct ut_transport_poll_group *group;
+
+	group = calloc(1, sizeof(*group));
+	SPDK_CU_ASSERT_FATAL(group != NULL);
+	g_tgroups_created++;
+
+	return &group->group;
+}
+
+int
+nvme_transport_poll_group_add(struct nvme_transport_poll_group *tgroup,
+			      struct spdk_nvme_qpair *qpair)
+{
+	return g_transport_add_rc;
+}
+
+int
+nvme_transport_poll_group_remove(struct nvme_transport_poll_group *tgroup,
+				 struct spdk_nvme_qpair *qpair)
+{
+	return g_transport_remove_rc;
+}
+
+int64_t
+nvme_transport_poll_group_process_completions(struct nvme_transport_poll_group *tgroup,
+		uint32_t completions_per_qpair, spdk_nvme_disconnected_qpair_cb disconnected_qpair_cb)
+{
+	struct ut_transport_poll_group *group = SPDK_CONTAINEROF(tgroup,
+						struct ut_transport_poll_group, group);
+	struct spdk_nvme_qpair *qpair;
+
+	CU_ASSERT(tgroup->group->in_completion_context);
+
+	TAILQ_FOREACH(qpair, &tgroup->qpairs, poll_group_tailq) {
+		if (qpair->transport_qp_is_failed) {
+			disconnected_qpair_cb(qpair, tgroup->group->ctx);
+		}
+	}
+
+	/* Freeing a qpair from a completion callback must be deferred. */
+	if (g_qpair_to_free != NULL) {
+		CU_ASSERT(spdk_nvme_ctrlr_free_io_qpair(g_qpair_to_free) == 0);
+		CU_ASSERT(g_qpair_to_free->poll_group != NULL);
+		g_qpair_to_free = NULL;
+	}
+
+	return group->completions;
+}
+
+int
+nvme_transport_poll_group_destroy(struct nvme_transport_poll_group *tgroup)
+{
+	g_tgroups_destroyed++;
+	free(tgroup);
+	return 0;
+}
+
+int
+spdk_nvme_ctrlr_free_io_qpair(struct spdk_nvme_qpair *qpair)
+{
+	if (qpair->poll_group != NULL) {
+		if (qpair->poll_group->group->in_completion_context) {
+			qpair->delete_after_completion_context = 1;
+			qpair->poll_group->group->has_deferred_deletes = true;
+			return 0;
+		}
+
+		nvme_poll_group_remove_qpair(qpair);
+	}
+
+	qpair->delete_after_completion_context = 0;
+	return 0;
+}
+
+static void
+disconnected_qpair_cb(struct spdk_nvme_qpair *qpair, void *poll_group_ctx)
+{
+	CU_ASSERT(poll_group_ctx == &g_disconnected_qpairs);
+	g_disconnected_qpairs++;
+}
+
+static void
+ut_qpair_init(struct spdk_nvme_qpair *qpair, uint16_t id, enum spdk_nvme_transport_type trtype)
+{
+	memset(qpair, 0, sizeof(*qpair));
+	qpair->id = id;
+	qpair->trtype = trtype;
+}
+
+static void
+test_spdk_nvme_poll_group_create(void)
+{
+	struct spdk_nvme_poll_group *group;
+
+	group = spdk_nvme_poll_group_create(&g_disconnected_qpairs);
+	SPDK_CU_ASSERT_FATAL(group != NULL);
+	CU_ASSERT(spdk_nvme_poll_group_get_ctx(group) == &g_disconnected_qpairs);
+	CU_ASSERT(STAILQ_EMPTY(&group->tgroups));
+	CU_ASSERT(spdk_nvme_poll_group_destroy(group) == 0);
+}
+
+static void
+test_spdk_nvme_poll_group_add_remove(void)
+{
+	struct spdk_nvme_poll_group *group, *other;
+	struct spdk_nvme_qpair qpair1, qpair2, qpair3, admin;
+	struct nvme_transport_poll_group *tgroup;
+
+	g_tgroups_created = 0;
+	g_tgroups_destroyed = 0;
+	group = spdk_nvme_poll_group_create(NULL);
+	SPDK_CU_ASSERT_FATAL(group != NULL);
+	other = spdk_nvme_poll_group_create(NULL);
+	SPDK_CU_ASSERT_FATAL(other != NULL);
+
+	ut_qpair_init(&qpair1, 1, SPDK_NVME_TRANSPORT_PCIE);
+	ut_qpair_init(&qpair2, 2, SPDK_NVME_TRANSPORT_PCIE);
+	ut_qpair_init(&qpair3, 1, SPDK_NVME_TRANSPORT_TCP);
+	ut_qpair_init(&admin, 0, SPDK_NVME_TRANSPORT_PCIE);
+
+	/* Admin qpairs are polled by their controller. */
+	CU_ASSERT(spdk_nvme_poll_group_add(group, &admin) == -EINVAL);
+
+	/* Qpairs of the same transport share a transport poll group. */
+	CU_ASSERT(spdk_nvme_poll_group_add(group, &qpair1) == 0);
+	CU_ASSERT(spdk_nvme_poll_group_add(group, &qpair2) == 0);
+	CU_ASSERT(spdk_nvme_poll_group_add(group, &qpair3) == 0);
+	CU_ASSERT(g_tgroups_created == 2);
+	CU_ASSERT(qpair1.poll_group == qpair2.poll_group);
+	CU_ASSERT(qpair1.poll_group != qpair3.poll_group);
+	tgroup = STAILQ_FIRST(&group->tgroups);
+	SPDK_CU_ASSERT_FATAL(tgroup != NULL);
+	CU_ASSERT(tgroup->trtype == SPDK_NVME_TRANSPORT_PCIE);
+	CU_ASSERT(tgroup->group == group);
+
+	/* A qpair belongs to one group at a time. */
+	CU_ASSERT(spdk_nvme_poll_group_add(group, &qpair1) == -EINVAL);
+	CU_ASSERT(spdk_nvme_poll_group_add(other, &qpair1) == -EINVAL);
+	CU_ASSERT(spdk_nvme_poll_group_remove(other, &qpair1) == -ENOENT);
+
+	/* Groups holding qpairs can't be destroyed. */
+	CU_ASSERT(spdk_nvme_poll_group_destroy(group) == -EBUSY);
+
+	/* A failing transport leaves the qpair out of the group. */
+	g_transport_remove_rc = -EBUSY;
+	CU_ASSERT(spdk_nvme_poll_group_remove(group, &qpair3) == -EBUSY);
+	CU_ASSERT(qpair3.poll_group != NULL);
+	g_transport_remove_rc = 0;
+	CU_ASSERT(spdk_nvme_poll_group_remove(group, &qpair3) == 0);
+	CU_ASSERT(qpair3.poll_group == NULL);
+	g_transport_add_rc = -ENOMEM;
+	CU_ASSERT(spdk_nvme_poll_group_add(other, &qpair3) == -ENOMEM);
+	CU_ASSERT(qpair3.poll_group == NULL);
+	g_transport_add_rc = 0;
+
+	CU_ASSERT(spdk_nvme_poll_group_remove(group, &qpair1) == 0);
+	CU_ASSERT(spdk_nvme_poll_group_remove(group, &qpair1) == -ENOENT);
+	CU_ASSERT(spdk_nvme_poll_group_remove(group, &qpair2) == 0);
+	CU_ASSERT(TAILQ_EMPTY(&tgroup->qpairs));
+
+	CU_ASSERT(spdk_nvme_poll_group_destroy(group) == 0);
+	CU_ASSERT(spdk_nvme_poll_group_destroy(other) == 0);
+	CU_ASSERT(g_tgroups_destroyed == g_tgroups_created);
+}
+
+static void
+test_spdk_nvme_poll_group_process_completions(void)
+{
+	struct spdk_nvme_poll_group *group;
+	struct spdk_nvme_qpair qpair1, qpair2, qpair3;
+	struct nvme_transport_poll_group *tgroup;
+	struct ut_transport_poll_group *ut_group;
+
+	group = spdk_nvme_poll_group_create(&g_disconnected_qpairs);
+	SPDK_CU_ASSERT_FATAL(group != NULL);
+
+	/* An empty group has nothing to poll. */
+	CU_ASSERT(spdk_nvme_poll_group_process_completions(group, 0, disconnected_qpair_cb) == 0);
+
+	ut_qpair_init(&qpair1, 1, SPDK_NVME_TRANSPORT_PCIE);
+	ut_qpair_init(&qpair2, 2, SPDK_NVME_TRANSPORT_PCIE);
+	ut_qpair_init(&qpair3, 1, SPDK_NVME_TRANSPORT_TCP);
+	CU_ASSERT(spdk_nvme_poll_group_add(group, &qpair1) == 0);
+	CU_ASSERT(spdk_nvme_poll_group_add(group, &qpair2) == 0);
+	CU_ASSERT(spdk_nvme_poll_group_add(group, &qpair3) == 0);
+
+	/* Completions of all transports add up. */
+	STAILQ_FOREACH(tgroup, &group->tgroups, link) {
+		ut_group = SPDK_CONTAINEROF(tgroup, struct ut_transport_poll_group, group);
+		ut_group->completions = tgroup->trtype == SPDK_NVME_TRANSPORT_PCIE ? 5 : 3;
+	}
+	CU_ASSERT(spdk_nvme_poll_group_process_completions(group, 0, disconnected_qpair_cb) == 8);
+	CU_ASSERT(!group->in_completion_context);
+
+	/* Disconnected qpairs are reported with the context of the group. */
+	g_disconnected_qpairs = 0;
+	qpair2.transport_qp_is_failed = true;
+	spdk_nvme_poll_group_process_completions(group, 0, disconnected_qpair_cb);
+	CU_ASSERT(g_disconnected_qpairs == 1);
+	qpair2.transport_qp_is_failed = false;
+
+	/* A qpair freed while polling leaves the group once the poll is over. */
+	g_qpair_to_free = &qpair1;
+	spdk_nvme_poll_group_process_completions(group, 0, disconnected_qpair_cb);
+	CU_ASSERT(g_qpair_to_free == NULL);
+	CU_ASSERT(qpair1.poll_group == NULL);
+	CU_ASSERT(qpair1.delete_after_completion_context == 0);
+	CU_ASSERT(!group->has_deferred_deletes);
+	CU_ASSERT(qpair2.poll_group != NULL);
+
+	CU_ASSERT(spdk_nvme_poll_group_remove(group, &qpair2) == 0);
+	CU_ASSERT(spdk_nvme_poll_group_remove(group, &qpair3) == 0);
+	CU_ASSERT(spdk_nvme_poll_group_destroy(group) == 0);
+}
+
+int main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	if (CU_initialize_registry() != CUE_SUCCESS) {
+		return CU_get_error();
+	}
+
+	suite = CU_add_suite("nvme_poll_group", NULL, NULL);
+	if (suite == NULL) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	if (CU_add_test(suite, "spdk_nvme_poll_group_create",
+			test_spdk_nvme_poll_group_create) == NULL
+	    || CU_add_test(suite, "spdk_nvme_poll_group_add_remove",
+			   test_spdk_nvme_poll_group_add_remove) == NULL
+	    || CU_add_test(suite, "spdk_nvme_poll_group_process_completions",
+			   test_spdk_nvme_poll_group_process_completions) == NULL
+	   ) {
+		CU_cleanup_registry();
+		return CU_get_error();
+	}
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+	return num_failures;
+}
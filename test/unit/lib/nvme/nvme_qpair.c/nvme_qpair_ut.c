@@ -76,6 +76,13 @@ nvme_transport_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t
 	return 0;
 }
 
+int
+nvme_transport_qpair_get_doorbell_stats(struct spdk_nvme_qpair *qpair,
+					struct spdk_nvme_qpair_doorbell_stats *stats)
+{
+	return -ENOTSUP;
+}
+
 int
 spdk_nvme_ctrlr_free_io_qpair(struct spdk_nvme_qpair *qpair)
 {
@@ -179,6 +179,460 @@ thread_poller(void)
 	free_threads();
 }
 
+static int
+poller_busy_every_other(void *ctx)
+{
+	uint32_t	*run_count = ctx;
+
+	(*run_count)++;
+	spdk_delay_us(10);
+
+	return *run_count % 2;
+}
+
+static void
+poller_stats(void)
+{
+	struct spdk_poller	*active, *timed, *poller;
+	struct spdk_poller_stats stats;
+	struct spdk_thread	*thread;
+	uint32_t		active_runs = 0, timed_runs = 0, count = 0;
+	int			i;
+
+	allocate_threads(1);
+	set_thread(0);
+	thread = spdk_get_thread();
+
+	active = SPDK_POLLER_REGISTER(poller_busy_every_other, &active_runs, 0);
+	SPDK_CU_ASSERT_FATAL(active != NULL);
+	timed = spdk_poller_register_named(poller_busy_every_other, &timed_runs, 1000, "timed");
+	SPDK_CU_ASSERT_FATAL(timed != NULL);
+
+	CU_ASSERT(strcmp(spdk_poller_get_name(active), "poller_busy_every_other") == 0);
+	CU_ASSERT(strcmp(spdk_poller_get_name(timed), "timed") == 0);
+	CU_ASSERT(spdk_poller_get_period_ticks(active) == 0);
+	CU_ASSERT(spdk_poller_get_period_ticks(timed) == 1000);
+
+	/* Both the active and the timed poller are found when iterating. */
+	for (poller = spdk_thread_get_first_poller(thread); poller != NULL;
+	     poller = spdk_thread_get_next_poller(poller)) {
+		CU_ASSERT(poller == active || poller == timed);
+		count++;
+	}
+	CU_ASSERT(count == 2);
+
+	/* Every run takes 10 ticks and every other run is busy. */
+	for (i = 0; i < 4; i++) {
+		spdk_thread_poll(thread, 0, 0);
+	}
+	spdk_delay_us(1000);
+	spdk_thread_poll(thread, 0, 0);
+
+	spdk_poller_get_stats(active, &stats);
+	CU_ASSERT(active_runs == 5);
+	CU_ASSERT(stats.run_count == 5);
+	CU_ASSERT(stats.busy_count == 3);
+	CU_ASSERT(stats.run_tsc == 50);
+	CU_ASSERT(stats.busy_tsc == 30);
+
+	spdk_poller_get_stats(timed, &stats);
+	CU_ASSERT(timed_runs == 1);
+	CU_ASSERT(stats.run_count == 1);
+	CU_ASSERT(stats.busy_count == 1);
+	CU_ASSERT(stats.run_tsc == 10);
+	CU_ASSERT(stats.busy_tsc == 10);
+
+	/* Unregistered pollers are skipped. */
+	spdk_poller_unregister(&active);
+	CU_ASSERT(spdk_thread_get_first_poller(thread) == timed);
+	CU_ASSERT(spdk_thread_get_next_poller(timed) == NULL);
+	spdk_poller_unregister(&timed);
+	CU_ASSERT(spdk_thread_get_first_poller(thread) == NULL);
+
+	free_threads();
+}
+
+#define TIMED_POLLER_COUNT 100
+
+struct timed_poller_ctx {
+	struct spdk_poller	*poller;
+	uint64_t		period_us;
+	uint32_t		run_count;
+	uint32_t		id;
+};
+
+static uint64_t g_last_run_tick;
+static bool g_timer_order_broken;
+static uint32_t g_run_order[TIMED_POLLER_COUNT];
+static uint32_t g_run_order_count;
+
+static int
+timed_poller_run(void *arg)
+{
+	struct timed_poller_ctx *ctx = arg;
+
+	if (ctx->poller->next_run_tick < g_last_run_tick) {
+		g_timer_order_broken = true;
+	}
+	g_last_run_tick = ctx->poller->next_run_tick;
+	ctx->run_count++;
+
+	if (g_run_order_count < TIMED_POLLER_COUNT) {
+		g_run_order[g_run_order_count++] = ctx->id;
+	}
+
+	return 1;
+}
+
+static int
+timed_poller_unregister(void *arg)
+{
+	struct timed_poller_ctx *ctx = arg;
+
+	spdk_poller_unregister(&ctx->poller);
+
+	return 1;
+}
+
+static void
+thread_timed_pollers(void)
+{
+	struct timed_poller_ctx ctxs[TIMED_POLLER_COUNT] = {}, unreg_ctx = {};
+	struct spdk_thread *thread;
+	struct spdk_poller *unreg_poller;
+	uint32_t i;
+
+	allocate_threads(1);
+	set_thread(0);
+	thread = spdk_get_thread();
+	MOCK_SET(spdk_get_ticks, 0);
+
+	g_last_run_tick = 0;
+	g_timer_order_broken = false;
+
+	for (i = 0; i < TIMED_POLLER_COUNT; i++) {
+		ctxs[i].id = i;
+		ctxs[i].period_us = (i * 37 % TIMED_POLLER_COUNT + 1) * 10;
+		ctxs[i].poller = spdk_poller_register(timed_poller_run, &ctxs[i], ctxs[i].period_us);
+		SPDK_CU_ASSERT_FATAL(ctxs[i].poller != NULL);
+	}
+	CU_ASSERT(thread->timer_poller_count == TIMED_POLLER_COUNT);
+	CU_ASSERT(spdk_thread_next_poller_expiration(thread) == 10);
+
+	/* Every poller runs once per period, in order of expiration. */
+	for (i = 0; i < 1000; i++) {
+		spdk_delay_us(10);
+		poll_threads();
+	}
+	CU_ASSERT(!g_timer_order_broken);
+	for (i = 0; i < TIMED_POLLER_COUNT; i++) {
+		CU_ASSERT(ctxs[i].run_count == 10000 / ctxs[i].period_us);
+	}
+
+	/* A timed poller unregistered by another one is freed on the next poll. */
+	unreg_ctx.poller = ctxs[0].poller;
+	unreg_poller = spdk_poller_register(timed_poller_unregister, &unreg_ctx, 5);
+	SPDK_CU_ASSERT_FATAL(unreg_poller != NULL);
+	spdk_delay_us(5);
+	poll_threads();
+	CU_ASSERT(unreg_ctx.poller == NULL);
+	spdk_delay_us(10);
+	poll_threads();
+	CU_ASSERT(thread->timer_poller_count == TIMED_POLLER_COUNT);
+
+	for (i = 1; i < TIMED_POLLER_COUNT; i++) {
+		spdk_poller_unregister(&ctxs[i].poller);
+	}
+	spdk_poller_unregister(&unreg_poller);
+	spdk_delay_us(1000);
+	poll_threads();
+	CU_ASSERT(thread->timer_poller_count == 0);
+	CU_ASSERT(spdk_thread_next_poller_expiration(thread) == 0);
+
+	/* Pollers expiring on the same tick run in the order they were armed. */
+	g_run_order_count = 0;
+	for (i = 0; i < 3; i++) {
+		ctxs[i].poller = spdk_poller_register(timed_poller_run, &ctxs[i], 100);
+		SPDK_CU_ASSERT_FATAL(ctxs[i].poller != NULL);
+	}
+	spdk_delay_us(100);
+	poll_threads();
+	spdk_delay_us(100);
+	poll_threads();
+	CU_ASSERT(g_run_order_count == 6);
+	for (i = 0; i < 6; i++) {
+		CU_ASSERT(g_run_order[i] == i % 3);
+	}
+
+	for (i = 0; i < 3; i++) {
+		spdk_poller_unregister(&ctxs[i].poller);
+	}
+
+	free_threads();
+}
+
+static bool
+wakeup_fd_readable(struct spdk_thread *thread)
+{
+	struct pollfd pfd = {};
+
+	pfd.fd = spdk_thread_get_wakeup_fd(thread);
+	pfd.events = POLLIN;
+
+	return poll(&pfd, 1, 0) == 1;
+}
+
+static void
+thread_wakeup(void)
+{
+	struct spdk_thread *thread0;
+	struct spdk_poller *poller;
+	bool done = false;
+	int fds[2];
+
+	allocate_threads(2);
+	set_thread(0);
+	thread0 = spdk_get_thread();
+	SPDK_CU_ASSERT_FATAL(spdk_thread_get_wakeup_fd(thread0) >= 0);
+
+	/* A message sent to a waiting thread makes its wakeup fd readable. */
+	CU_ASSERT(spdk_thread_wait_begin(thread0) == true);
+	CU_ASSERT(!wakeup_fd_readable(thread0));
+	set_thread(1);
+	spdk_thread_send_msg(thread0, send_msg_cb, &done);
+	CU_ASSERT(wakeup_fd_readable(thread0));
+	spdk_thread_wait_end(thread0);
+	CU_ASSERT(!wakeup_fd_readable(thread0));
+
+	/* A thread with a message queued cannot wait. */
+	CU_ASSERT(spdk_thread_wait_begin(thread0) == false);
+	spdk_thread_wait_end(thread0);
+	poll_thread(0);
+	CU_ASSERT(done);
+
+	/* Nor can a thread with a poller that has no wakeup fd. */
+	set_thread(0);
+	poller = spdk_poller_register(poller_run_done, &done, 0);
+	SPDK_CU_ASSERT_FATAL(poller != NULL);
+	CU_ASSERT(spdk_thread_wait_begin(thread0) == false);
+	spdk_thread_wait_end(thread0);
+
+	/* Once it has one, the thread is woken up through it. */
+	CU_ASSERT(pipe(fds) == 0);
+	CU_ASSERT(spdk_poller_set_wakeup_fd(poller, fds[0]) == 0);
+	CU_ASSERT(spdk_thread_wait_begin(thread0) == true);
+	CU_ASSERT(!wakeup_fd_readable(thread0));
+	CU_ASSERT(write(fds[1], "x", 1) == 1);
+	CU_ASSERT(wakeup_fd_readable(thread0));
+	spdk_thread_wait_end(thread0);
+
+	spdk_poller_unregister(&poller);
+	CU_ASSERT(!wakeup_fd_readable(thread0));
+	close(fds[0]);
+	close(fds[1]);
+
+	free_threads();
+}
+
+static uint32_t g_msg_seq;
+static bool g_msg_out_of_order;
+
+static void
+ordered_msg_cb(void *ctx)
+{
+	if ((uintptr_t)ctx != g_msg_seq) {
+		g_msg_out_of_order = true;
+	}
+	g_msg_seq++;
+}
+
+static void
+thread_msg_lanes(void)
+{
+	struct spdk_thread *thread0, *thread1;
+	uint32_t i, count = SPDK_MSG_LANE_SIZE * 2 + 10;
+
+	allocate_threads(2);
+	set_thread(0);
+	thread0 = spdk_get_thread();
+	set_thread(1);
+	thread1 = spdk_get_thread();
+
+	g_msg_seq = 0;
+	g_msg_out_of_order = false;
+
+	/* More messages than fit into the lane. The rest go through the ring of thread 0. */
+	for (i = 0; i < count; i++) {
+		spdk_thread_send_msg(thread0, ordered_msg_cb, (void *)(uintptr_t)i);
+	}
+	CU_ASSERT(thread0->in_lanes != NULL);
+	CU_ASSERT(spdk_ring_count(thread0->messages) == count - SPDK_MSG_LANE_SIZE);
+	CU_ASSERT(spdk_thread_wait_begin(thread0) == false);
+	spdk_thread_wait_end(thread0);
+
+	/* Room freed in the lane is used again before the ring is drained. */
+	spdk_thread_poll(thread0, 1, 0);
+	set_thread(1);
+	spdk_thread_send_msg(thread0, ordered_msg_cb, (void *)(uintptr_t)count);
+	CU_ASSERT(spdk_ring_count(thread0->messages) == count - SPDK_MSG_LANE_SIZE);
+
+	poll_thread(0);
+	CU_ASSERT(g_msg_seq == count + 1);
+	CU_ASSERT(!g_msg_out_of_order);
+	CU_ASSERT(spdk_thread_is_idle(thread0));
+
+	/* With lanes disabled, messages to new destinations go through the ring. */
+	spdk_thread_lib_set_msg_lanes(false);
+	set_thread(0);
+	g_msg_seq = 0;
+	spdk_thread_send_msg(thread1, ordered_msg_cb, (void *)(uintptr_t)0);
+	CU_ASSERT(thread1->in_lanes == NULL);
+	CU_ASSERT(spdk_ring_count(thread1->messages) == 1);
+	poll_threads();
+	CU_ASSERT(g_msg_seq == 1);
+	spdk_thread_lib_set_msg_lanes(true);
+
+	/* The choice is kept for destinations that were already sent to. */
+	spdk_thread_send_msg(thread1, ordered_msg_cb, (void *)(uintptr_t)1);
+	CU_ASSERT(spdk_ring_count(thread1->messages) == 1);
+	poll_threads();
+	CU_ASSERT(g_msg_seq == 2);
+	CU_ASSERT(!g_msg_out_of_order);
+
+	free_threads();
+}
+
+static void
+thread_send_msg_bulk(void)
+{
+	struct spdk_thread *thread0;
+	void *ctxs[100];
+	uint32_t i;
+
+	allocate_threads(2);
+	set_thread(0);
+	thread0 = spdk_get_thread();
+
+	for (i = 0; i < SPDK_COUNTOF(ctxs); i++) {
+		ctxs[i] = (void *)(uintptr_t)i;
+	}
+
+	g_msg_seq = 0;
+	g_msg_out_of_order = false;
+
+	/* From another SPDK thread, through a lane. */
+	set_thread(1);
+	CU_ASSERT(spdk_thread_send_msg_bulk(thread0, ordered_msg_cb, ctxs, 50) == 50);
+	CU_ASSERT(spdk_thread_send_msg_bulk(thread0, ordered_msg_cb, &ctxs[50], 50) == 50);
+	poll_threads();
+	CU_ASSERT(g_msg_seq == 100);
+
+	/* From a non-SPDK thread, through the ring. */
+	g_msg_seq = 0;
+	set_thread(INVALID_THREAD);
+	CU_ASSERT(spdk_thread_send_msg_bulk(thread0, ordered_msg_cb, ctxs, 100) == 100);
+	CU_ASSERT(spdk_ring_count(thread0->messages) == 100);
+	poll_threads();
+	CU_ASSERT(g_msg_seq == 100);
+	CU_ASSERT(!g_msg_out_of_order);
+
+	CU_ASSERT(spdk_thread_send_msg_bulk(thread0, ordered_msg_cb, ctxs, 0) == 0);
+
+	free_threads();
+}
+
+static void
+thread_msg_lane_src_exit(void)
+{
+	struct spdk_thread *thread0, *src;
+	uint32_t i, count = SPDK_MSG_LANE_SIZE + 20;
+
+	allocate_threads(1);
+	set_thread(0);
+	thread0 = spdk_get_thread();
+
+	src = spdk_thread_create("src", NULL);
+	SPDK_CU_ASSERT_FATAL(src != NULL);
+	spdk_set_thread(src);
+
+	g_msg_seq = 0;
+	g_msg_out_of_order = false;
+
+	for (i = 0; i < count; i++) {
+		spdk_thread_send_msg(thread0, ordered_msg_cb, (void *)(uintptr_t)i);
+	}
+
+	/* The messages stay in the lane and on the ring of thread 0. */
+	spdk_thread_exit(src);
+	spdk_thread_destroy(src);
+	SPDK_CU_ASSERT_FATAL(thread0->in_lanes != NULL);
+	CU_ASSERT(thread0->in_lanes->src_gone);
+	CU_ASSERT(spdk_ring_count(thread0->messages) == count - SPDK_MSG_LANE_SIZE);
+	CU_ASSERT(!spdk_thread_is_idle(thread0));
+
+	poll_threads();
+	CU_ASSERT(g_msg_seq == count);
+	CU_ASSERT(!g_msg_out_of_order);
+	CU_ASSERT(spdk_thread_is_idle(thread0));
+
+	free_threads();
+}
+
+static void
+forward_msg_cb(void *ctx)
+{
+	struct spdk_thread *thread = ctx;
+
+	spdk_thread_send_msg(thread, ordered_msg_cb, (void *)(uintptr_t)1);
+}
+
+static void
+thread_msg_causal_order(void)
+{
+	struct spdk_thread *thread0, *thread2;
+
+	allocate_threads(3);
+	set_thread(0);
+	thread0 = spdk_get_thread();
+	set_thread(2);
+	thread2 = spdk_get_thread();
+
+	g_msg_seq = 0;
+	g_msg_out_of_order = false;
+
+	/* Thread 2 forwards a message to thread 0 after thread 1 sent its own. */
+	set_thread(1);
+	spdk_thread_send_msg(thread0, ordered_msg_cb, (void *)(uintptr_t)0);
+	spdk_thread_send_msg(thread2, forward_msg_cb, thread0);
+	poll_thread(2);
+	poll_thread(0);
+	CU_ASSERT(g_msg_seq == 2);
+	CU_ASSERT(!g_msg_out_of_order);
+
+	/* A message on the ring does not overtake one sent before it through a lane. */
+	g_msg_seq = 0;
+	set_thread(1);
+	spdk_thread_send_msg(thread0, ordered_msg_cb, (void *)(uintptr_t)0);
+	set_thread(INVALID_THREAD);
+	spdk_thread_send_msg(thread0, ordered_msg_cb, (void *)(uintptr_t)1);
+	CU_ASSERT(spdk_ring_count(thread0->messages) == 1);
+	poll_thread(0);
+	CU_ASSERT(g_msg_seq == 2);
+	CU_ASSERT(!g_msg_out_of_order);
+
+	/* Nor does a message through a lane overtake one on the ring. */
+	g_msg_seq = 0;
+	spdk_thread_send_msg(thread0, ordered_msg_cb, (void *)(uintptr_t)0);
+	set_thread(1);
+	spdk_thread_send_msg(thread0, ordered_msg_cb, (void *)(uintptr_t)1);
+	poll_thread(0);
+	CU_ASSERT(g_msg_seq == 2);
+	CU_ASSERT(!g_msg_out_of_order);
+	CU_ASSERT(spdk_thread_is_idle(thread0));
+
+	free_threads();
+}
+
 static void
 for_each_cb(void *ctx)
 {
@@ -456,11 +910,13 @@ channel(void)
 
 	spdk_io_device_register(&device1, create_cb_1, destroy_cb_1, sizeof(ctx1), NULL);
 	spdk_io_device_register(&device2, create_cb_2, destroy_cb_2, sizeof(ctx2), NULL);
+	CU_ASSERT(!spdk_thread_has_io_channels(spdk_get_thread()));
 
 	g_create_cb_calls = 0;
 	ch1 = spdk_get_io_channel(&device1);
 	CU_ASSERT(g_create_cb_calls == 1);
 	SPDK_CU_ASSERT_FATAL(ch1 != NULL);
+	CU_ASSERT(spdk_thread_has_io_channels(spdk_get_thread()));
 
 	g_create_cb_calls = 0;
 	ch2 = spdk_get_io_channel(&device1);
@@ -489,8 +945,10 @@ channel(void)
 
 	g_destroy_cb_calls = 0;
 	spdk_put_io_channel(ch2);
+	CU_ASSERT(spdk_thread_has_io_channels(spdk_get_thread()));
 	poll_threads();
 	CU_ASSERT(g_destroy_cb_calls == 1);
+	CU_ASSERT(!spdk_thread_has_io_channels(spdk_get_thread()));
 
 	ch1 = spdk_get_io_channel(&device3);
 	CU_ASSERT(ch1 == NULL);
@@ -579,6 +1037,13 @@ main(int argc, char **argv)
 		CU_add_test(suite, "thread_alloc", thread_alloc) == NULL ||
 		CU_add_test(suite, "thread_send_msg", thread_send_msg) == NULL ||
 		CU_add_test(suite, "thread_poller", thread_poller) == NULL ||
+		CU_add_test(suite, "thread_timed_pollers", thread_timed_pollers) == NULL ||
+		CU_add_test(suite, "poller_stats", poller_stats) == NULL ||
+		CU_add_test(suite, "thread_wakeup", thread_wakeup) == NULL ||
+		CU_add_test(suite, "thread_msg_lanes", thread_msg_lanes) == NULL ||
+		CU_add_test(suite, "thread_send_msg_bulk", thread_send_msg_bulk) == NULL ||
+		CU_add_test(suite, "thread_msg_lane_src_exit", thread_msg_lane_src_exit) == NULL ||
+		CU_add_test(suite, "thread_msg_causal_order", thread_msg_causal_order) == NULL ||
 		CU_add_test(suite, "thread_for_each", thread_for_each) == NULL ||
 		CU_add_test(suite, "for_each_channel_remove", for_each_channel_remove) == NULL ||
 		CU_add_test(suite, "for_each_channel_unreg", for_each_channel_unreg) == NULL ||
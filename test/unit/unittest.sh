@@ -56,9 +56,12 @@ $valgrind $testdir/include/spdk/histogram_data.h/histogram_ut
 
 $valgrind $testdir/lib/bdev/bdev.c/bdev_ut
 $valgrind $testdir/lib/bdev/bdev_raid.c/bdev_raid_ut
+$valgrind $testdir/lib/bdev/cache.c/cache_ut
+$valgrind $testdir/lib/bdev/dedup.c/dedup_ut
 $valgrind $testdir/lib/bdev/part.c/part_ut
 $valgrind $testdir/lib/bdev/scsi_nvme.c/scsi_nvme_ut
 $valgrind $testdir/lib/bdev/gpt/gpt.c/gpt_ut
+$valgrind $testdir/lib/bdev/nvme/bdev_nvme_multipath.c/bdev_nvme_multipath_ut
 $valgrind $testdir/lib/bdev/vbdev_lvol.c/vbdev_lvol_ut
 
 if grep -q '#define SPDK_CONFIG_CRYPTO 1' $rootdir/include/spdk/config.h; then
@@ -67,6 +70,7 @@ fi
 
 if grep -q '#define SPDK_CONFIG_REDUCE 1' $rootdir/include/spdk/config.h; then
         $valgrind $testdir/lib/bdev/compress.c/compress_ut
+        $valgrind $testdir/lib/bdev/compress_sw.c/compress_sw_ut
 fi
 
 if grep -q '#define SPDK_CONFIG_PMDK 1' $rootdir/include/spdk/config.h; then
@@ -83,8 +87,11 @@ $valgrind $testdir/lib/blobfs/blobfs_async_ut/blobfs_async_ut
 $testdir/lib/blobfs/blobfs_sync_ut/blobfs_sync_ut
 $valgrind $testdir/lib/blobfs/blobfs_bdev.c/blobfs_bdev_ut
 
+$valgrind $testdir/lib/copy/copy_engine.c/copy_engine_ut
+
 $valgrind $testdir/lib/event/subsystem.c/subsystem_ut
 $valgrind $testdir/lib/event/app.c/app_ut
+$valgrind $testdir/lib/event/reactor.c/reactor_ut
 
 $valgrind $testdir/lib/sock/sock.c/sock_ut
 
@@ -97,6 +104,7 @@ $valgrind $testdir/lib/nvme/nvme_ns_cmd.c/nvme_ns_cmd_ut
 $valgrind $testdir/lib/nvme/nvme_ns_ocssd_cmd.c/nvme_ns_ocssd_cmd_ut
 $valgrind $testdir/lib/nvme/nvme_qpair.c/nvme_qpair_ut
 $valgrind $testdir/lib/nvme/nvme_pcie.c/nvme_pcie_ut
+$valgrind $testdir/lib/nvme/nvme_poll_group.c/nvme_poll_group_ut
 $valgrind $testdir/lib/nvme/nvme_quirks.c/nvme_quirks_ut
 $valgrind $testdir/lib/nvme/nvme_tcp.c/nvme_tcp_ut
 if grep -q '#define SPDK_CONFIG_RDMA 1' $rootdir/include/spdk/config.h; then